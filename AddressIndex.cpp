@@ -0,0 +1,1360 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: AddressIndex
+//
+// File: AddressIndex.cpp
+//
+// Comment: In-memory inverted index of the words of the employee addresses.
+//
+// Functions:
+//			1. Build the posting lists of the address words from a scan
+//			2. Read again the employees changed by the write paths
+//			3. Intersect the posting lists of the words of a query
+//
+// Notes:
+//			A word is a run of letters and digits, compared in lower case.
+//			The posting lists are delta coded and carry a skip entry every
+//			ADDRESS_INDEX_SKIP_INTERVAL postings. A search walks the
+//			shortest list and advances a cursor on each other list to the
+//			next candidate, skipping whole blocks it doesn't need to decode.
+//
+//			A changed employee is listed as removed, so its compressed
+//			postings are ignored, and its words as read again go to the
+//			uncompressed added lists. Compact folds both back into the
+//			compressed lists once ADDRESS_INDEX_MAX_PENDING employees
+//			changed.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "BatchLookup.h"
+#include "AddressIndex.h"
+
+AddressIndex	g_AddressIndex;						// Address words of the application database
+
+// Columns read by the index. Build binds all of them; the batch lookup of
+// the changed employees binds EmployeeID itself and takes the others.
+//
+static WCHAR* s_rgpwszAddressColumns[] =	{
+												L"EmployeeID",
+												L"Address",
+												L"City",
+												L"Region",
+												L"PostalCode"
+											};
+
+#define ADDRESS_INDEX_FIELDS	(sizeof(s_rgpwszAddressColumns)/sizeof(s_rgpwszAddressColumns[0]) - 1)
+
+////////////////////////////////////////////////////////////////////////////////
+// Position in a compressed posting list
+//
+typedef struct tagPOSTING_CURSOR
+{
+	const ADDRESS_INDEX_TERM	*pTerm;
+	DWORD						iNext;				// Index of the next posting to decode
+	DWORD						obNext;
+	DWORD						dwID;				// Last posting decoded, valid if iNext > 0
+} POSTING_CURSOR;
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompareIDs
+//
+// Description: qsort and bsearch callback, orders EmployeeIDs.
+//
+////////////////////////////////////////////////////////////////////////////////
+static int __cdecl CompareIDs(const void *pv1, const void *pv2)
+{
+	DWORD dwID1 = *(const DWORD *)pv1;
+	DWORD dwID2 = *(const DWORD *)pv2;
+
+	return (dwID1 < dwID2) ? -1 : (dwID1 > dwID2);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: NextToken
+//
+// Description: Copy the next word of a text in lower case, truncated to
+//				ADDRESS_INDEX_MAX_TOKEN characters.
+//
+// Returns: The text after the word, NULL if there is no word left
+//
+////////////////////////////////////////////////////////////////////////////////
+static LPCWSTR NextToken(LPCWSTR pwszText, WCHAR *pwszToken)
+{
+	DWORD cch = 0;
+
+	while (*pwszText && !iswalnum(*pwszText))
+	{
+		++pwszText;
+	}
+
+	if (WCHAR('\0') == *pwszText)
+	{
+		return NULL;
+	}
+
+	for (; iswalnum(*pwszText); ++pwszText)
+	{
+		if (cch < ADDRESS_INDEX_MAX_TOKEN)
+		{
+			pwszToken[cch++] = towlower(*pwszText);
+		}
+	}
+
+	pwszToken[cch] = WCHAR('\0');
+
+	return pwszText;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: HashToken
+//
+// Description: Returns the FNV-1a hash of a word.
+//
+////////////////////////////////////////////////////////////////////////////////
+static DWORD HashToken(LPCWSTR pwszToken)
+{
+	DWORD dwHash = 2166136261;
+
+	for (; *pwszToken; ++pwszToken)
+	{
+		dwHash ^= *pwszToken;
+		dwHash *= 16777619;
+	}
+
+	return dwHash;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CursorNext
+//
+// Description: Decode the next posting of a cursor into dwID.
+//
+// Returns: FALSE at the end of the list
+//
+////////////////////////////////////////////////////////////////////////////////
+static BOOL CursorNext(POSTING_CURSOR *pCursor)
+{
+	const BYTE	*pbPostings = pCursor->pTerm->pbPostings;
+	DWORD		dwDelta		= 0;
+	DWORD		dwShift		= 0;
+	BYTE		b;
+
+	if (pCursor->iNext >= pCursor->pTerm->cPostings)
+	{
+		return FALSE;
+	}
+
+	do
+	{
+		b			= pbPostings[pCursor->obNext++];
+		dwDelta	   |= (DWORD)(b & 0x7F) << dwShift;
+		dwShift	   += 7;
+	}
+	while (b & 0x80);
+
+	pCursor->dwID += dwDelta;
+	++pCursor->iNext;
+
+	return TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CursorSeek
+//
+// Description: Move a cursor forward to the first posting not below an
+//				EmployeeID, jumping to the last block that starts below it.
+//
+// Returns: FALSE if every posting is below the EmployeeID
+//
+////////////////////////////////////////////////////////////////////////////////
+static BOOL CursorSeek(POSTING_CURSOR *pCursor, DWORD dwEmployeeID)
+{
+	const ADDRESS_INDEX_TERM	*pTerm = pCursor->pTerm;
+	DWORD						iLow;
+	DWORD						iHigh;
+	DWORD						iMiddle;
+
+	if (pCursor->iNext > 0 && pCursor->dwID >= dwEmployeeID)
+	{
+		return TRUE;
+	}
+
+	// Last skip entry whose block starts below the EmployeeID
+	//
+	iLow  = pCursor->iNext / ADDRESS_INDEX_SKIP_INTERVAL;
+	iHigh = pTerm->cSkips;
+
+	if (iLow < iHigh && pTerm->rgSkip[iLow].dwBaseID < dwEmployeeID)
+	{
+		while (iHigh - iLow > 1)
+		{
+			iMiddle = (iLow + iHigh) / 2;
+
+			if (pTerm->rgSkip[iMiddle].dwBaseID < dwEmployeeID)
+			{
+				iLow = iMiddle;
+			}
+			else
+			{
+				iHigh = iMiddle;
+			}
+		}
+
+		if (iLow * ADDRESS_INDEX_SKIP_INTERVAL > pCursor->iNext)
+		{
+			pCursor->iNext	= iLow * ADDRESS_INDEX_SKIP_INTERVAL;
+			pCursor->obNext	= pTerm->rgSkip[iLow].obPosting;
+			pCursor->dwID	= pTerm->rgSkip[iLow].dwBaseID;
+		}
+	}
+
+	while (CursorNext(pCursor))
+	{
+		if (pCursor->dwID >= dwEmployeeID)
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddressIndex::AddressIndex()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+AddressIndex::AddressIndex() : m_fBuilt(FALSE),
+							   m_rgTerms(NULL),
+							   m_cTerms(0),
+							   m_cMaxTerms(0),
+							   m_rgdwBucket(NULL),
+							   m_cBuckets(0),
+							   m_pwszTokens(NULL),
+							   m_cchTokens(0),
+							   m_cchMaxTokens(0),
+							   m_rgdwChanged(NULL),
+							   m_cChanged(0),
+							   m_cMaxChanged(0),
+							   m_rgdwRemoved(NULL),
+							   m_cRemoved(0),
+							   m_cMaxRemoved(0)
+{
+	InitializeCriticalSection(&m_cs);
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddressIndex::~AddressIndex()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+AddressIndex::~AddressIndex()
+{
+	FreeTerms();
+
+	DeleteCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddressIndex::Clear()
+//
+// Description: Free the index. The next search builds it again.
+//
+////////////////////////////////////////////////////////////////////////////////
+void AddressIndex::Clear()
+{
+	EnterCriticalSection(&m_cs);
+
+	FreeTerms();
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddressIndex::MarkChanged()
+//
+// Description: Note that a write changed an employee. Called by the write
+//				paths after their transaction is committed.
+//
+////////////////////////////////////////////////////////////////////////////////
+void AddressIndex::MarkChanged(DWORD dwEmployeeID)
+{
+	DWORD *rgdwGrown;
+
+	EnterCriticalSection(&m_cs);
+
+	if (!m_fBuilt)
+	{
+		goto Exit;
+	}
+
+	// Past this many changes a scan costs less than the lookups
+	//
+	if (m_cChanged >= ADDRESS_INDEX_MAX_PENDING)
+	{
+		m_fBuilt = FALSE;
+		goto Exit;
+	}
+
+	if (m_cChanged == m_cMaxChanged)
+	{
+		rgdwGrown = (DWORD*)CoTaskMemRealloc(m_rgdwChanged, sizeof(DWORD)*(m_cMaxChanged ? 2 * m_cMaxChanged : 64));
+		if (NULL == rgdwGrown)
+		{
+			m_fBuilt = FALSE;
+			goto Exit;
+		}
+
+		m_rgdwChanged	= rgdwGrown;
+		m_cMaxChanged	= m_cMaxChanged ? 2 * m_cMaxChanged : 64;
+	}
+
+	m_rgdwChanged[m_cChanged++] = dwEmployeeID;
+
+Exit:
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddressIndex::MarkAllChanged()
+//
+// Description: Note a write that may have changed any employee. The next
+//				search builds the index again.
+//
+////////////////////////////////////////////////////////////////////////////////
+void AddressIndex::MarkAllChanged()
+{
+	EnterCriticalSection(&m_cs);
+
+	m_fBuilt = FALSE;
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddressIndex::GetStats()
+//
+// Description: Returns the index statistics.
+//
+////////////////////////////////////////////////////////////////////////////////
+void AddressIndex::GetStats(ADDRESS_INDEX_STATS *pStats)
+{
+	if (NULL == pStats)
+	{
+		return;
+	}
+
+	EnterCriticalSection(&m_cs);
+
+	*pStats				= m_Stats;
+	pStats->cTerms		= m_cTerms;
+	pStats->cPending	= m_cRemoved + m_cChanged;
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddressIndex::Build()
+//
+// Description: Build the index from a scan of PK_Employees.
+//
+// Parameters:
+//			pISession	- Session on the application database
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT AddressIndex::Build(IOpenRowset *pISession)
+{
+	HRESULT			hr					= NOERROR;
+	HRESULT			hrFetch				= NOERROR;
+	IRowset			*pIRowset			= NULL;				// Provider Interface Pointer
+	IAccessor		*pIAccessor			= NULL;				// Provider Interface Pointer
+	HACCESSOR		hAccessor			= DB_NULL_HACCESSOR;// Accessor handle
+	DBBINDING		*prgBinding			= NULL;				// Binding used to create accessor
+	DWORD			cBindings			= 0;
+	DWORD			cbRowSize			= 0;
+	BYTE			*pData				= NULL;				// Record data
+	HROW			rghRows[ADDRESS_INDEX_SCAN_ROWS];
+	HROW			*prghRows			= rghRows;
+	ULONG			cRowsObtained		= 0;
+	DWORD			dwStartMs			= GetTickCount();
+
+	if (NULL == pISession)
+	{
+		return E_INVALIDARG;
+	}
+
+	EnterCriticalSection(&m_cs);
+
+	FreeTerms();
+
+	m_Stats.cEmployees	= 0;
+	m_Stats.cPostings	= 0;
+	m_Stats.cbPostings	= 0;
+
+	// PK_Employees returns the employees in ascending EmployeeID, the order
+	// the postings are appended in
+	//
+	hr = OpenEmployeesRowset(pISession, 0, IID_IRowset, (IUnknown**)&pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = CreateColumnBindings(pIRowset,
+							  s_rgpwszAddressColumns,
+							  sizeof(s_rgpwszAddressColumns)/sizeof(s_rgpwszAddressColumns[0]),
+							  NULL,
+							  &prgBinding,
+							  &cBindings,
+							  &cbRowSize);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, cBindings, prgBinding, cbRowSize, &hAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	pData = (BYTE*)CoTaskMemAlloc(cbRowSize);
+	if (NULL == pData)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	while (DB_S_ENDOFROWSET != hrFetch)
+	{
+		hrFetch = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, ADDRESS_INDEX_SCAN_ROWS, &cRowsObtained, &prghRows);
+		if (FAILED(hrFetch))
+		{
+			hr = hrFetch;
+			goto Exit;
+		}
+
+		if (0 == cRowsObtained)
+		{
+			break;
+		}
+
+		for (ULONG iRow = 0; iRow < cRowsObtained; ++iRow)
+		{
+			memset(pData, 0, cbRowSize);
+
+			hr = pIRowset->GetData(rghRows[iRow], hAccessor, pData);
+			if (FAILED(hr))
+			{
+				break;
+			}
+
+			if (DBSTATUS_S_OK != *(DBSTATUS *)(pData+prgBinding[0].obStatus))
+			{
+				continue;
+			}
+
+			hr = IndexEmployee(*(LONG*)(pData+prgBinding[0].obValue), pData, prgBinding, FALSE);
+			if (FAILED(hr))
+			{
+				break;
+			}
+
+			++m_Stats.cEmployees;
+		}
+
+		pIRowset->ReleaseRows(cRowsObtained, rghRows, NULL, NULL, NULL);
+
+		if (FAILED(hr))
+		{
+			goto Exit;
+		}
+	}
+
+	hr					= NOERROR;
+	m_fBuilt			= TRUE;
+	m_Stats.dwBuildMs	= GetTickCount() - dwStartMs;
+	++m_Stats.cBuilds;
+
+Exit:
+	if (FAILED(hr))
+	{
+		FreeTerms();
+	}
+
+	LeaveCriticalSection(&m_cs);
+
+	if (pData)
+	{
+		CoTaskMemFree(pData);
+	}
+
+	if (pIAccessor)
+	{
+		if (DB_NULL_HACCESSOR != hAccessor)
+		{
+			pIAccessor->ReleaseAccessor(hAccessor, NULL);
+		}
+		pIAccessor->Release();
+	}
+
+	if (prgBinding)
+	{
+		FreeColumnBindings(prgBinding);
+	}
+
+	if (pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddressIndex::Search()
+//
+// Description: Find the employees whose address holds every word of a
+//				query. The index is built or brought up to date first.
+//
+// Parameters:
+//			pISession		- Session on the application database
+//			pwszQuery		- Words to find, in any order and case
+//			rgdwEmployeeID	- Receives the matching EmployeeIDs, ascending
+//			cMaxIDs			- Size of rgdwEmployeeID
+//			pcIDs			- Number of matches, may exceed cMaxIDs
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT AddressIndex::Search(IOpenRowset	*pISession,
+							 LPCWSTR		pwszQuery,
+							 DWORD			*rgdwEmployeeID,
+							 DWORD			cMaxIDs,
+							 DWORD			*pcIDs)
+{
+	HRESULT				hr					= NOERROR;
+	WCHAR				wszToken[ADDRESS_INDEX_MAX_TOKEN + 1];
+	DWORD				rgiTerm[ADDRESS_INDEX_MAX_QUERY_TERMS];
+	POSTING_CURSOR		rgCursor[ADDRESS_INDEX_MAX_QUERY_TERMS];
+	DWORD				cTerms				= 0;
+	DWORD				iTerm;
+	DWORD				iDriver				= 0;
+	const ADDRESS_INDEX_TERM *pDriver;
+	const ADDRESS_INDEX_TERM *pTerm;
+	DWORD				iAdded				= 0;
+	DWORD				iRemoved			= 0;
+	BOOL				fCompressed;						// The driver cursor holds a candidate
+	BOOL				fFromAdded;
+	BOOL				fMatch;
+	DWORD				dwCandidate;
+	DWORD				cIDs				= 0;
+	DWORD				dwStartMs			= GetTickCount();
+
+	if (NULL == pISession || NULL == pwszQuery || (NULL == rgdwEmployeeID && cMaxIDs) || NULL == pcIDs)
+	{
+		return E_INVALIDARG;
+	}
+
+	*pcIDs = 0;
+
+	EnterCriticalSection(&m_cs);
+
+	++m_Stats.cSearches;
+
+	if (!m_fBuilt)
+	{
+		hr = Build(pISession);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+	}
+
+	if (m_cChanged)
+	{
+		hr = Refresh(pISession);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+	}
+
+	// Look up the words of the query, a word no address holds matches none
+	//
+	while (NULL != (pwszQuery = NextToken(pwszQuery, wszToken)))
+	{
+		if (S_FALSE == FindTerm(wszToken, FALSE, &rgiTerm[cTerms]))
+		{
+			goto Exit;
+		}
+
+		for (iTerm = 0; iTerm < cTerms; ++iTerm)
+		{
+			if (rgiTerm[iTerm] == rgiTerm[cTerms])
+			{
+				break;
+			}
+		}
+
+		if (iTerm == cTerms)
+		{
+			if (cTerms == ADDRESS_INDEX_MAX_QUERY_TERMS)
+			{
+				hr = E_INVALIDARG;
+				goto Exit;
+			}
+
+			++cTerms;
+		}
+	}
+
+	if (0 == cTerms)
+	{
+		goto Exit;
+	}
+
+	// Walk the shortest list
+	//
+	for (iTerm = 0; iTerm < cTerms; ++iTerm)
+	{
+		rgCursor[iTerm].pTerm	= &m_rgTerms[rgiTerm[iTerm]];
+		rgCursor[iTerm].iNext	= 0;
+		rgCursor[iTerm].obNext	= 0;
+		rgCursor[iTerm].dwID	= 0;
+
+		if (rgCursor[iTerm].pTerm->cPostings + rgCursor[iTerm].pTerm->cAdded <
+			rgCursor[iDriver].pTerm->cPostings + rgCursor[iDriver].pTerm->cAdded)
+		{
+			iDriver = iTerm;
+		}
+	}
+
+	pDriver		= rgCursor[iDriver].pTerm;
+	fCompressed	= CursorNext(&rgCursor[iDriver]);
+
+	for (;;)
+	{
+		// Skip the compressed postings of changed employees
+		//
+		while (fCompressed)
+		{
+			while (iRemoved < m_cRemoved && m_rgdwRemoved[iRemoved] < rgCursor[iDriver].dwID)
+			{
+				++iRemoved;
+			}
+
+			if (iRemoved == m_cRemoved || m_rgdwRemoved[iRemoved] != rgCursor[iDriver].dwID)
+			{
+				break;
+			}
+
+			fCompressed = CursorNext(&rgCursor[iDriver]);
+		}
+
+		// Next candidate of the driver, the compressed and added postings
+		// of an employee never both hold it
+		//
+		if (fCompressed && (iAdded == pDriver->cAdded || rgCursor[iDriver].dwID < pDriver->rgdwAdded[iAdded]))
+		{
+			dwCandidate	= rgCursor[iDriver].dwID;
+			fFromAdded	= FALSE;
+			fCompressed	= CursorNext(&rgCursor[iDriver]);
+		}
+		else if (iAdded < pDriver->cAdded)
+		{
+			dwCandidate	= pDriver->rgdwAdded[iAdded++];
+			fFromAdded	= TRUE;
+		}
+		else
+		{
+			break;
+		}
+
+		// A changed employee is only in the added lists, the others only
+		// in the compressed lists
+		//
+		fMatch = TRUE;
+
+		for (iTerm = 0; iTerm < cTerms && fMatch; ++iTerm)
+		{
+			if (iTerm == iDriver)
+			{
+				continue;
+			}
+
+			pTerm = rgCursor[iTerm].pTerm;
+
+			if (fFromAdded)
+			{
+				fMatch = (NULL != bsearch(&dwCandidate, pTerm->rgdwAdded, pTerm->cAdded, sizeof(DWORD), CompareIDs));
+			}
+			else
+			{
+				fMatch = CursorSeek(&rgCursor[iTerm], dwCandidate) && rgCursor[iTerm].dwID == dwCandidate;
+			}
+		}
+
+		if (fMatch)
+		{
+			if (cIDs < cMaxIDs)
+			{
+				rgdwEmployeeID[cIDs] = dwCandidate;
+			}
+			++cIDs;
+		}
+	}
+
+	*pcIDs = cIDs;
+
+Exit:
+	m_Stats.dwLastSearchMs = GetTickCount() - dwStartMs;
+
+	LeaveCriticalSection(&m_cs);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddressIndex::Refresh()
+//
+// Description: Read again the employees marked by the write paths, in one
+//				batch lookup, and index their words as added postings.
+//				Called with the critical section held.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT AddressIndex::Refresh(IOpenRowset *pISession)
+{
+	HRESULT				hr				= NOERROR;
+	EmployeeBatchLookup	BatchLookup;
+	const DBBINDING		*prgBinding;
+	DWORD				cBindings;
+	BYTE				*pData;
+	DWORD				*rgdwRemoved	= NULL;
+	DWORD				cRemoved		= 0;
+	DWORD				cChanged		= 0;
+	DWORD				iChanged;
+	DWORD				iRemoved;
+	DWORD				iTerm;
+	DWORD				iAdded;
+	DWORD				cAdded;
+	ADDRESS_INDEX_TERM	*pTerm;
+
+	// Sort and deduplicate the changed employees
+	//
+	qsort(m_rgdwChanged, m_cChanged, sizeof(DWORD), CompareIDs);
+
+	for (iChanged = 0; iChanged < m_cChanged; ++iChanged)
+	{
+		if (0 == cChanged || m_rgdwChanged[cChanged - 1] != m_rgdwChanged[iChanged])
+		{
+			m_rgdwChanged[cChanged++] = m_rgdwChanged[iChanged];
+		}
+	}
+
+	m_cChanged = cChanged;
+
+	hr = BatchLookup.Lookup(pISession, m_rgdwChanged, cChanged, s_rgpwszAddressColumns + 1, ADDRESS_INDEX_FIELDS);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	prgBinding = BatchLookup.GetBindings(&cBindings);
+
+	// Merge the changed employees into the removed ones
+	//
+	rgdwRemoved = (DWORD*)CoTaskMemAlloc(sizeof(DWORD)*(m_cRemoved + cChanged));
+	if (NULL == rgdwRemoved)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	for (iRemoved = 0, iChanged = 0; iRemoved < m_cRemoved || iChanged < cChanged; )
+	{
+		if (iChanged == cChanged || (iRemoved < m_cRemoved && m_rgdwRemoved[iRemoved] < m_rgdwChanged[iChanged]))
+		{
+			rgdwRemoved[cRemoved++] = m_rgdwRemoved[iRemoved++];
+		}
+		else
+		{
+			if (iRemoved < m_cRemoved && m_rgdwRemoved[iRemoved] == m_rgdwChanged[iChanged])
+			{
+				++iRemoved;
+			}
+
+			rgdwRemoved[cRemoved++] = m_rgdwChanged[iChanged++];
+		}
+	}
+
+	// Drop what the employees changed again held in the added lists
+	//
+	for (iTerm = 0; iTerm < m_cTerms; ++iTerm)
+	{
+		pTerm	= &m_rgTerms[iTerm];
+		cAdded	= 0;
+
+		for (iAdded = 0, iChanged = 0; iAdded < pTerm->cAdded; ++iAdded)
+		{
+			while (iChanged < cChanged && m_rgdwChanged[iChanged] < pTerm->rgdwAdded[iAdded])
+			{
+				++iChanged;
+			}
+
+			if (iChanged == cChanged || m_rgdwChanged[iChanged] != pTerm->rgdwAdded[iAdded])
+			{
+				pTerm->rgdwAdded[cAdded++] = pTerm->rgdwAdded[iAdded];
+			}
+		}
+
+		pTerm->cAdded = cAdded;
+	}
+
+	if (m_rgdwRemoved)
+	{
+		CoTaskMemFree(m_rgdwRemoved);
+	}
+
+	m_rgdwRemoved	= rgdwRemoved;
+	m_cRemoved		= cRemoved;
+	m_cMaxRemoved	= m_cRemoved;
+	rgdwRemoved		= NULL;
+
+	// Index the employees as they are now, deleted employees have no row
+	//
+	for (iChanged = 0; iChanged < cChanged; ++iChanged)
+	{
+		if (NOERROR == BatchLookup.GetRow(iChanged, &pData))
+		{
+			hr = IndexEmployee(m_rgdwChanged[iChanged], pData, prgBinding, TRUE);
+			if(FAILED(hr))
+			{
+				goto Exit;
+			}
+		}
+	}
+
+	m_cChanged = 0;
+
+	if (m_cRemoved > ADDRESS_INDEX_MAX_PENDING)
+	{
+		hr = Compact();
+	}
+
+Exit:
+	if (rgdwRemoved)
+	{
+		CoTaskMemFree(rgdwRemoved);
+	}
+
+	// A half applied refresh leaves the index inconsistent
+	//
+	if (FAILED(hr))
+	{
+		m_fBuilt = FALSE;
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddressIndex::Compact()
+//
+// Description: Fold the removed employees and the added postings back into
+//				the compressed lists. Called with the critical section held.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT AddressIndex::Compact()
+{
+	HRESULT				hr			= NOERROR;
+	DWORD				*rgdwIDs	= NULL;
+	DWORD				*rgdwGrown;
+	DWORD				cMaxIDs		= 0;
+	DWORD				cIDs;
+	DWORD				iID;
+	DWORD				iTerm;
+	DWORD				iAdded;
+	DWORD				iRemoved;
+	BOOL				fCompressed;
+	POSTING_CURSOR		Cursor;
+	ADDRESS_INDEX_TERM	*pTerm;
+
+	for (iTerm = 0; iTerm < m_cTerms; ++iTerm)
+	{
+		pTerm = &m_rgTerms[iTerm];
+
+		if (pTerm->cPostings + pTerm->cAdded > cMaxIDs)
+		{
+			rgdwGrown = (DWORD*)CoTaskMemRealloc(rgdwIDs, sizeof(DWORD)*(pTerm->cPostings + pTerm->cAdded));
+			if (NULL == rgdwGrown)
+			{
+				hr = E_OUTOFMEMORY;
+				goto Exit;
+			}
+
+			rgdwIDs = rgdwGrown;
+			cMaxIDs = pTerm->cPostings + pTerm->cAdded;
+		}
+
+		// Merge the postings still valid with the added ones
+		//
+		Cursor.pTerm	= pTerm;
+		Cursor.iNext	= 0;
+		Cursor.obNext	= 0;
+		Cursor.dwID		= 0;
+
+		cIDs			= 0;
+		iAdded			= 0;
+		iRemoved		= 0;
+		fCompressed		= CursorNext(&Cursor);
+
+		while (fCompressed || iAdded < pTerm->cAdded)
+		{
+			if (fCompressed && (iAdded == pTerm->cAdded || Cursor.dwID < pTerm->rgdwAdded[iAdded]))
+			{
+				while (iRemoved < m_cRemoved && m_rgdwRemoved[iRemoved] < Cursor.dwID)
+				{
+					++iRemoved;
+				}
+
+				if (iRemoved == m_cRemoved || m_rgdwRemoved[iRemoved] != Cursor.dwID)
+				{
+					rgdwIDs[cIDs++] = Cursor.dwID;
+				}
+
+				fCompressed = CursorNext(&Cursor);
+			}
+			else
+			{
+				rgdwIDs[cIDs++] = pTerm->rgdwAdded[iAdded++];
+			}
+		}
+
+		// Code them again
+		//
+		m_Stats.cPostings  -= pTerm->cPostings;
+		m_Stats.cbPostings -= pTerm->cbPostings;
+
+		pTerm->cbPostings	= 0;
+		pTerm->cPostings	= 0;
+		pTerm->cSkips		= 0;
+		pTerm->dwLastID		= 0;
+		pTerm->cAdded		= 0;
+
+		for (iID = 0; iID < cIDs; ++iID)
+		{
+			hr = AppendPosting(pTerm, rgdwIDs[iID]);
+			if(FAILED(hr))
+			{
+				goto Exit;
+			}
+		}
+	}
+
+	m_cRemoved = 0;
+	++m_Stats.cCompactions;
+
+Exit:
+	if (rgdwIDs)
+	{
+		CoTaskMemFree(rgdwIDs);
+	}
+
+	if (FAILED(hr))
+	{
+		m_fBuilt = FALSE;
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddressIndex::IndexEmployee()
+//
+// Description: Add the words of the address of an employee to the index.
+//
+// Parameters:
+//			dwEmployeeID	- Employee
+//			pData			- Row, binding i + 1 is the i-th address column
+//			prgBinding		- Bindings of the row
+//			fAdded			- Add to the added lists instead of appending
+//							  to the compressed lists
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT AddressIndex::IndexEmployee(DWORD dwEmployeeID, BYTE *pData, const DBBINDING *prgBinding, BOOL fAdded)
+{
+	HRESULT	hr		= NOERROR;
+	WCHAR	wszToken[ADDRESS_INDEX_MAX_TOKEN + 1];
+	LPCWSTR	pwszText;
+	DWORD	iField;
+	DWORD	iTerm;
+
+	for (iField = 1; iField <= ADDRESS_INDEX_FIELDS; ++iField)
+	{
+		if (DBSTATUS_S_OK != *(DBSTATUS *)(pData+prgBinding[iField].obStatus))
+		{
+			continue;
+		}
+
+		pwszText = (WCHAR*)(pData+prgBinding[iField].obValue);
+
+		while (NULL != (pwszText = NextToken(pwszText, wszToken)))
+		{
+			hr = FindTerm(wszToken, TRUE, &iTerm);
+			if(FAILED(hr))
+			{
+				return hr;
+			}
+
+			if (fAdded)
+			{
+				hr = AddPosting(&m_rgTerms[iTerm], dwEmployeeID);
+			}
+			else
+			{
+				hr = AppendPosting(&m_rgTerms[iTerm], dwEmployeeID);
+			}
+
+			if(FAILED(hr))
+			{
+				return hr;
+			}
+		}
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddressIndex::FindTerm()
+//
+// Description: Find a word in the dictionary, adding it if asked to.
+//
+// Returns: NOERROR if found or added, S_FALSE if not found
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT AddressIndex::FindTerm(LPCWSTR pwszToken, BOOL fCreate, DWORD *piTerm)
+{
+	HRESULT				hr;
+	DWORD				dwHash		= HashToken(pwszToken);
+	DWORD				iBucket;
+	DWORD				cchToken;
+	DWORD				cNewMax;
+	ADDRESS_INDEX_TERM	*rgGrown;
+	WCHAR				*pwszGrown;
+
+	if (fCreate && 2 * (m_cTerms + 1) > m_cBuckets)
+	{
+		hr = GrowBuckets();
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+	}
+
+	if (0 == m_cBuckets)
+	{
+		return S_FALSE;
+	}
+
+	for (iBucket = dwHash & (m_cBuckets - 1); m_rgdwBucket[iBucket]; iBucket = (iBucket + 1) & (m_cBuckets - 1))
+	{
+		if (m_rgTerms[m_rgdwBucket[iBucket] - 1].dwHash == dwHash &&
+			0 == wcscmp(m_pwszTokens + m_rgTerms[m_rgdwBucket[iBucket] - 1].obToken, pwszToken))
+		{
+			*piTerm = m_rgdwBucket[iBucket] - 1;
+			return NOERROR;
+		}
+	}
+
+	if (!fCreate)
+	{
+		return S_FALSE;
+	}
+
+	if (m_cTerms == m_cMaxTerms)
+	{
+		cNewMax = m_cMaxTerms ? 2 * m_cMaxTerms : 256;
+
+		rgGrown = (ADDRESS_INDEX_TERM*)CoTaskMemRealloc(m_rgTerms, sizeof(ADDRESS_INDEX_TERM)*cNewMax);
+		if (NULL == rgGrown)
+		{
+			return E_OUTOFMEMORY;
+		}
+
+		m_rgTerms	= rgGrown;
+		m_cMaxTerms	= cNewMax;
+	}
+
+	cchToken = wcslen(pwszToken) + 1;
+
+	if (m_cchTokens + cchToken > m_cchMaxTokens)
+	{
+		cNewMax = m_cchMaxTokens ? 2 * m_cchMaxTokens : 4096;
+
+		pwszGrown = (WCHAR*)CoTaskMemRealloc(m_pwszTokens, sizeof(WCHAR)*cNewMax);
+		if (NULL == pwszGrown)
+		{
+			return E_OUTOFMEMORY;
+		}
+
+		m_pwszTokens	= pwszGrown;
+		m_cchMaxTokens	= cNewMax;
+	}
+
+	memcpy(m_pwszTokens + m_cchTokens, pwszToken, sizeof(WCHAR)*cchToken);
+
+	memset(&m_rgTerms[m_cTerms], 0, sizeof(ADDRESS_INDEX_TERM));
+	m_rgTerms[m_cTerms].dwHash	= dwHash;
+	m_rgTerms[m_cTerms].obToken	= m_cchTokens;
+
+	m_cchTokens				   += cchToken;
+	m_rgdwBucket[iBucket]		= m_cTerms + 1;
+	*piTerm						= m_cTerms++;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddressIndex::GrowBuckets()
+//
+// Description: Double the hash table of the dictionary.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT AddressIndex::GrowBuckets()
+{
+	DWORD	cBuckets	= m_cBuckets ? 2 * m_cBuckets : 1024;
+	DWORD	*rgdwBucket;
+	DWORD	iTerm;
+	DWORD	iBucket;
+
+	rgdwBucket = (DWORD*)CoTaskMemAlloc(sizeof(DWORD)*cBuckets);
+	if (NULL == rgdwBucket)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	memset(rgdwBucket, 0, sizeof(DWORD)*cBuckets);
+
+	for (iTerm = 0; iTerm < m_cTerms; ++iTerm)
+	{
+		for (iBucket = m_rgTerms[iTerm].dwHash & (cBuckets - 1); rgdwBucket[iBucket]; iBucket = (iBucket + 1) & (cBuckets - 1))
+		{
+		}
+
+		rgdwBucket[iBucket] = iTerm + 1;
+	}
+
+	if (m_rgdwBucket)
+	{
+		CoTaskMemFree(m_rgdwBucket);
+	}
+
+	m_rgdwBucket	= rgdwBucket;
+	m_cBuckets		= cBuckets;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddressIndex::AppendPosting()
+//
+// Description: Append an employee to a compressed list. Employees are
+//				appended in ascending EmployeeID; an employee already last
+//				in the list is not added again.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT AddressIndex::AppendPosting(ADDRESS_INDEX_TERM *pTerm, DWORD dwEmployeeID)
+{
+	DWORD				dwDelta;
+	DWORD				cbPosting;
+	DWORD				cNewMax;
+	BYTE				*pbGrown;
+	ADDRESS_INDEX_SKIP	*rgSkipGrown;
+
+	if (pTerm->cPostings && dwEmployeeID <= pTerm->dwLastID)
+	{
+		return (dwEmployeeID == pTerm->dwLastID) ? NOERROR : E_UNEXPECTED;
+	}
+
+	if (0 == pTerm->cPostings % ADDRESS_INDEX_SKIP_INTERVAL)
+	{
+		if (pTerm->cSkips == pTerm->cMaxSkips)
+		{
+			cNewMax = pTerm->cMaxSkips ? 2 * pTerm->cMaxSkips : 4;
+
+			rgSkipGrown = (ADDRESS_INDEX_SKIP*)CoTaskMemRealloc(pTerm->rgSkip, sizeof(ADDRESS_INDEX_SKIP)*cNewMax);
+			if (NULL == rgSkipGrown)
+			{
+				return E_OUTOFMEMORY;
+			}
+
+			pTerm->rgSkip		= rgSkipGrown;
+			pTerm->cMaxSkips	= cNewMax;
+		}
+
+		pTerm->rgSkip[pTerm->cSkips].dwBaseID	= pTerm->cPostings ? pTerm->dwLastID : 0;
+		pTerm->rgSkip[pTerm->cSkips].obPosting	= pTerm->cbPostings;
+		++pTerm->cSkips;
+	}
+
+	// A DWORD takes 5 bytes at most
+	//
+	if (pTerm->cbPostings + 5 > pTerm->cbMaxPostings)
+	{
+		cNewMax = pTerm->cbMaxPostings ? 2 * pTerm->cbMaxPostings : 16;
+
+		pbGrown = (BYTE*)CoTaskMemRealloc(pTerm->pbPostings, cNewMax);
+		if (NULL == pbGrown)
+		{
+			return E_OUTOFMEMORY;
+		}
+
+		pTerm->pbPostings		= pbGrown;
+		pTerm->cbMaxPostings	= cNewMax;
+	}
+
+	dwDelta		= dwEmployeeID - (pTerm->cPostings ? pTerm->dwLastID : 0);
+	cbPosting	= pTerm->cbPostings;
+
+	while (dwDelta >= 0x80)
+	{
+		pTerm->pbPostings[pTerm->cbPostings++] = (BYTE)(dwDelta | 0x80);
+		dwDelta >>= 7;
+	}
+	pTerm->pbPostings[pTerm->cbPostings++] = (BYTE)dwDelta;
+
+	pTerm->dwLastID = dwEmployeeID;
+	++pTerm->cPostings;
+
+	++m_Stats.cPostings;
+	m_Stats.cbPostings += pTerm->cbPostings - cbPosting;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddressIndex::AddPosting()
+//
+// Description: Insert an employee in the added list of a word.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT AddressIndex::AddPosting(ADDRESS_INDEX_TERM *pTerm, DWORD dwEmployeeID)
+{
+	DWORD	iLow	= 0;
+	DWORD	iHigh	= pTerm->cAdded;
+	DWORD	iMiddle;
+	DWORD	cNewMax;
+	DWORD	*rgdwGrown;
+
+	while (iLow < iHigh)
+	{
+		iMiddle = (iLow + iHigh) / 2;
+
+		if (pTerm->rgdwAdded[iMiddle] < dwEmployeeID)
+		{
+			iLow = iMiddle + 1;
+		}
+		else
+		{
+			iHigh = iMiddle;
+		}
+	}
+
+	if (iLow < pTerm->cAdded && pTerm->rgdwAdded[iLow] == dwEmployeeID)
+	{
+		return NOERROR;
+	}
+
+	if (pTerm->cAdded == pTerm->cMaxAdded)
+	{
+		cNewMax = pTerm->cMaxAdded ? 2 * pTerm->cMaxAdded : 4;
+
+		rgdwGrown = (DWORD*)CoTaskMemRealloc(pTerm->rgdwAdded, sizeof(DWORD)*cNewMax);
+		if (NULL == rgdwGrown)
+		{
+			return E_OUTOFMEMORY;
+		}
+
+		pTerm->rgdwAdded	= rgdwGrown;
+		pTerm->cMaxAdded	= cNewMax;
+	}
+
+	memmove(pTerm->rgdwAdded + iLow + 1, pTerm->rgdwAdded + iLow, sizeof(DWORD)*(pTerm->cAdded - iLow));
+	pTerm->rgdwAdded[iLow] = dwEmployeeID;
+	++pTerm->cAdded;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddressIndex::FreeTerms()
+//
+// Description: Free the dictionary and the posting lists.
+//				Called with the critical section held.
+//
+////////////////////////////////////////////////////////////////////////////////
+void AddressIndex::FreeTerms()
+{
+	for (DWORD iTerm = 0; iTerm < m_cTerms; ++iTerm)
+	{
+		CoTaskMemFree(m_rgTerms[iTerm].pbPostings);
+		CoTaskMemFree(m_rgTerms[iTerm].rgSkip);
+		CoTaskMemFree(m_rgTerms[iTerm].rgdwAdded);
+	}
+
+	CoTaskMemFree(m_rgTerms);
+	CoTaskMemFree(m_rgdwBucket);
+	CoTaskMemFree(m_pwszTokens);
+	CoTaskMemFree(m_rgdwChanged);
+	CoTaskMemFree(m_rgdwRemoved);
+
+	m_rgTerms		= NULL;
+	m_cTerms		= 0;
+	m_cMaxTerms		= 0;
+	m_rgdwBucket	= NULL;
+	m_cBuckets		= 0;
+	m_pwszTokens	= NULL;
+	m_cchTokens		= 0;
+	m_cchMaxTokens	= 0;
+	m_rgdwChanged	= NULL;
+	m_cChanged		= 0;
+	m_cMaxChanged	= 0;
+	m_rgdwRemoved	= NULL;
+	m_cRemoved		= 0;
+	m_cMaxRemoved	= 0;
+	m_fBuilt		= FALSE;
+}
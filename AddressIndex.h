@@ -0,0 +1,137 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: AddressIndex
+//
+// File: AddressIndex.h
+//
+// Comment: In-memory inverted index of the words of the employee addresses.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_ADDRESSINDEX_H__5B0E3D7A_2F6C_4E81_9A47_D3C81F6B20E9__INCLUDED_)
+#define AFX_ADDRESSINDEX_H__5B0E3D7A_2F6C_4E81_9A47_D3C81F6B20E9__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define ADDRESS_INDEX_MAX_TOKEN			32				// Characters kept of a word
+#define ADDRESS_INDEX_MAX_QUERY_TERMS	8
+#define ADDRESS_INDEX_SKIP_INTERVAL		64				// Postings between two skip entries
+#define ADDRESS_INDEX_MAX_PENDING		4096			// Changed employees before a compaction
+#define ADDRESS_INDEX_SCAN_ROWS			64				// Rows fetched per GetNextRows by Build
+
+////////////////////////////////////////////////////////////////////////////////
+// Skip entry of a posting list: the block of postings at obPosting starts
+// after dwBaseID
+//
+typedef struct tagADDRESS_INDEX_SKIP
+{
+	DWORD		dwBaseID;
+	DWORD		obPosting;
+} ADDRESS_INDEX_SKIP;
+
+////////////////////////////////////////////////////////////////////////////////
+// A word and the employees whose address holds it. The postings are the
+// EmployeeIDs in ascending order, each coded as its difference to the
+// previous one in 7 bit groups. Employees changed since the last compaction
+// are in rgdwAdded, uncompressed.
+//
+typedef struct tagADDRESS_INDEX_TERM
+{
+	DWORD				dwHash;
+	DWORD				obToken;						// Characters into the token pool
+	BYTE				*pbPostings;
+	DWORD				cbPostings;
+	DWORD				cbMaxPostings;
+	DWORD				cPostings;
+	DWORD				dwLastID;						// Last EmployeeID of pbPostings
+	ADDRESS_INDEX_SKIP	*rgSkip;
+	DWORD				cSkips;
+	DWORD				cMaxSkips;
+	DWORD				*rgdwAdded;						// Ascending
+	DWORD				cAdded;
+	DWORD				cMaxAdded;
+} ADDRESS_INDEX_TERM;
+
+////////////////////////////////////////////////////////////////////////////////
+// Address index statistics
+//
+typedef struct tagADDRESS_INDEX_STATS
+{
+	DWORD		cEmployees;								// Indexed by the last build
+	DWORD		cTerms;
+	DWORD		cPostings;								// Compressed postings
+	DWORD		cbPostings;								// Bytes of the compressed postings
+	DWORD		cPending;								// Employees changed since the last compaction
+	DWORD		cBuilds;
+	DWORD		cCompactions;
+	DWORD		cSearches;
+	DWORD		dwBuildMs;
+	DWORD		dwLastSearchMs;
+} ADDRESS_INDEX_STATS;
+
+////////////////////////////////////////////////////////////////////////////////
+// Finds employees by the words of their Address, City, Region and
+// PostalCode. The index is built by a scan of PK_Employees on the first
+// search. The write paths mark the employees they change; the next search
+// reads those rows again in one batch lookup before it runs. A search
+// matches the employees whose address holds every word of the query.
+//
+class AddressIndex
+{
+public:
+	AddressIndex();
+	~AddressIndex();
+
+	HRESULT Build(IOpenRowset *pISession);
+	void	Clear();
+
+	void	MarkChanged(DWORD dwEmployeeID);
+	void	MarkAllChanged();
+
+	HRESULT Search(IOpenRowset	*pISession,
+				   LPCWSTR		pwszQuery,
+				   DWORD		*rgdwEmployeeID,
+				   DWORD		cMaxIDs,
+				   DWORD		*pcIDs);
+
+	void	GetStats(ADDRESS_INDEX_STATS *pStats);
+
+private:
+	HRESULT Refresh(IOpenRowset *pISession);
+	HRESULT Compact();
+	HRESULT IndexEmployee(DWORD dwEmployeeID, BYTE *pData, const DBBINDING *prgBinding, BOOL fAdded);
+	HRESULT FindTerm(LPCWSTR pwszToken, BOOL fCreate, DWORD *piTerm);
+	HRESULT GrowBuckets();
+	HRESULT AppendPosting(ADDRESS_INDEX_TERM *pTerm, DWORD dwEmployeeID);
+	HRESULT AddPosting(ADDRESS_INDEX_TERM *pTerm, DWORD dwEmployeeID);
+	void	FreeTerms();
+
+	CRITICAL_SECTION	m_cs;
+	BOOL				m_fBuilt;
+	ADDRESS_INDEX_TERM	*m_rgTerms;
+	DWORD				m_cTerms;
+	DWORD				m_cMaxTerms;
+	DWORD				*m_rgdwBucket;					// Term index + 1, 0 if empty
+	DWORD				m_cBuckets;						// Power of 2
+	WCHAR				*m_pwszTokens;					// Token pool, null terminated tokens
+	DWORD				m_cchTokens;
+	DWORD				m_cchMaxTokens;
+	DWORD				*m_rgdwChanged;					// Marked by the writes, not read again yet
+	DWORD				m_cChanged;
+	DWORD				m_cMaxChanged;
+	DWORD				*m_rgdwRemoved;					// Compressed postings are stale, ascending
+	DWORD				m_cRemoved;
+	DWORD				m_cMaxRemoved;
+	ADDRESS_INDEX_STATS	m_Stats;
+};
+
+extern AddressIndex	g_AddressIndex;
+
+#endif // !defined(AFX_ADDRESSINDEX_H__5B0E3D7A_2F6C_4E81_9A47_D3C81F6B20E9__INCLUDED_)
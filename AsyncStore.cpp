@@ -0,0 +1,834 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: EmployeeAsyncStore
+//
+// File: AsyncStore.cpp
+//
+// Comment: Employee reads and writes run as scheduled tasks.
+//
+// Functions:
+//			1. Begin loads, saves, name scans, photo reads and bulk updates
+//			   as tasks of g_TaskScheduler
+//			2. Wait for, cancel and time out the requests
+//			3. End the requests with their typed results
+//
+// Notes:
+//			Requests are cancelled through their own flag rather than the
+//			one of the scheduler task, so that a cancelled request still
+//			runs, completes at once and calls its pfnDone. The flag of the
+//			task is only set when the scheduler stops.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "ChangeLog.h"
+#include "BatchLookup.h"
+#include "BulkUpdate.h"
+#include "EmployeeSchema.h"
+#include "SessionPool.h"
+#include "EmployeeStore.h"
+#include "TaskScheduler.h"
+#include "AsyncStore.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::EmployeeAsyncStore()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeeAsyncStore::EmployeeAsyncStore() : m_pIDBCreateSession(NULL)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::~EmployeeAsyncStore()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeeAsyncStore::~EmployeeAsyncStore()
+{
+	Close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::Open()
+//
+// Description: Use an open data source. g_TaskScheduler runs the requests
+//				and is started by the application.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeAsyncStore::Open(IDBCreateSession *pIDBCreateSession)
+{
+	if (NULL == pIDBCreateSession)
+	{
+		return E_INVALIDARG;
+	}
+
+	Close();
+
+	m_pIDBCreateSession = pIDBCreateSession;
+	m_pIDBCreateSession->AddRef();
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::Close()
+//
+// Description: Release the data source. The requests are ended first.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeeAsyncStore::Close()
+{
+	if (m_pIDBCreateSession)
+	{
+		m_pIDBCreateSession->Release();
+		m_pIDBCreateSession = NULL;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::BeginLoad()
+//
+// Description: Begin EmployeeStore::Load.
+//
+// Parameters
+//		dwEmployeeID	- Employee
+//		pCall			- How the request is run, NULL for the defaults
+//		ppRequest		- Receives the request, ended with EndLoad
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeAsyncStore::BeginLoad(DWORD dwEmployeeID, const ASYNC_CALL *pCall, ASYNC_REQUEST **ppRequest)
+{
+	HRESULT			hr			= NOERROR;
+	ASYNC_REQUEST	*pRequest	= NewRequest(ASYNC_OP_LOAD);
+
+	if (NULL == pRequest)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	pRequest->dwEmployeeID = dwEmployeeID;
+
+	hr = Begin(pRequest, pCall, ppRequest);
+	if(FAILED(hr))
+	{
+		FreeRequest(pRequest);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::EndLoad()
+//
+// Description: Wait for a load and free the request.
+//
+// Parameters
+//		pRequest	- Request of BeginLoad
+//		pRecord		- Receives the employee
+//
+// Returns: NOERROR if succesfull, S_FALSE if the employee does not exist
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeAsyncStore::EndLoad(ASYNC_REQUEST *pRequest, EmployeeRecord *pRecord)
+{
+	HRESULT hr;
+
+	if (NULL == pRequest || ASYNC_OP_LOAD != pRequest->dwOperation)
+	{
+		return E_INVALIDARG;
+	}
+
+	hr = Wait(pRequest, INFINITE);
+
+	if (NOERROR == hr && pRecord)
+	{
+		pRecord->Attach(pRequest->pRecord);
+		pRequest->pRecord = NULL;
+	}
+
+	FreeRequest(pRequest);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::BeginSave()
+//
+// Description: Begin EmployeeStore::Save. The record is handed over to the
+//				request and handed back by EndSave.
+//
+// Parameters
+//		pRecord		- Employee to write, empty on return
+//		pCall		- How the request is run, NULL for the defaults
+//		ppRequest	- Receives the request, ended with EndSave
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeAsyncStore::BeginSave(EmployeeRecord *pRecord, const ASYNC_CALL *pCall, ASYNC_REQUEST **ppRequest)
+{
+	HRESULT			hr			= NOERROR;
+	ASYNC_REQUEST	*pRequest;
+
+	if (NULL == pRecord || pRecord->IsEmpty())
+	{
+		return E_INVALIDARG;
+	}
+
+	pRequest = NewRequest(ASYNC_OP_SAVE);
+	if (NULL == pRequest)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	pRequest->pRecord = pRecord->Detach();
+
+	hr = Begin(pRequest, pCall, ppRequest);
+	if(FAILED(hr))
+	{
+		// Hand the record back
+		//
+		pRecord->Attach(pRequest->pRecord);
+		pRequest->pRecord = NULL;
+
+		FreeRequest(pRequest);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::EndSave()
+//
+// Description: Wait for a save and free the request.
+//
+// Parameters
+//		pRequest	- Request of BeginSave
+//		pRecord		- Receives the record back, with the version written
+//
+// Returns: NOERROR if succesfull, S_FALSE if the employee does not exist,
+//			DB_E_CONCURRENCYVIOLATION if the row changed since it was read
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeAsyncStore::EndSave(ASYNC_REQUEST *pRequest, EmployeeRecord *pRecord)
+{
+	HRESULT hr;
+
+	if (NULL == pRequest || ASYNC_OP_SAVE != pRequest->dwOperation)
+	{
+		return E_INVALIDARG;
+	}
+
+	hr = Wait(pRequest, INFINITE);
+
+	if (pRecord && pRequest->pRecord)
+	{
+		pRecord->Attach(pRequest->pRecord);
+		pRequest->pRecord = NULL;
+	}
+
+	FreeRequest(pRequest);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::BeginScanNames()
+//
+// Description: Begin EmployeeStore::ScanNames. The names reach pfnName on
+//				the worker thread.
+//
+// Parameters
+//		pfnName		- Receives each name
+//		pvContext	- Passed to pfnName
+//		pCall		- How the request is run, NULL for the defaults
+//		ppRequest	- Receives the request, ended with EndScanNames
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeAsyncStore::BeginScanNames(PFN_EMPLOYEE_NAME pfnName, LPVOID pvContext, const ASYNC_CALL *pCall, ASYNC_REQUEST **ppRequest)
+{
+	HRESULT			hr			= NOERROR;
+	ASYNC_REQUEST	*pRequest;
+
+	if (NULL == pfnName)
+	{
+		return E_INVALIDARG;
+	}
+
+	pRequest = NewRequest(ASYNC_OP_SCAN_NAMES);
+	if (NULL == pRequest)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	pRequest->pfnName	= pfnName;
+	pRequest->pvName	= pvContext;
+
+	hr = Begin(pRequest, pCall, ppRequest);
+	if(FAILED(hr))
+	{
+		FreeRequest(pRequest);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::EndScanNames()
+//
+// Description: Wait for a scan and free the request.
+//
+// Returns: NOERROR if succesfull, E_ABORT or HRESULT_FROM_WIN32(ERROR_TIMEOUT)
+//			if the scan was stopped
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeAsyncStore::EndScanNames(ASYNC_REQUEST *pRequest)
+{
+	HRESULT hr;
+
+	if (NULL == pRequest || ASYNC_OP_SCAN_NAMES != pRequest->dwOperation)
+	{
+		return E_INVALIDARG;
+	}
+
+	hr = Wait(pRequest, INFINITE);
+
+	FreeRequest(pRequest);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::BeginReadPhoto()
+//
+// Description: Begin reading the photo of an employee, decoded to 24 bit
+//				bitmap bits.
+//
+// Parameters
+//		dwEmployeeID	- Employee
+//		pCall			- How the request is run, NULL for the defaults
+//		ppRequest		- Receives the request, ended with EndReadPhoto
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeAsyncStore::BeginReadPhoto(DWORD dwEmployeeID, const ASYNC_CALL *pCall, ASYNC_REQUEST **ppRequest)
+{
+	HRESULT			hr			= NOERROR;
+	ASYNC_REQUEST	*pRequest	= NewRequest(ASYNC_OP_READ_PHOTO);
+
+	if (NULL == pRequest)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	pRequest->dwEmployeeID = dwEmployeeID;
+
+	hr = Begin(pRequest, pCall, ppRequest);
+	if(FAILED(hr))
+	{
+		FreeRequest(pRequest);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::EndReadPhoto()
+//
+// Description: Wait for a photo read and free the request.
+//
+// Parameters
+//		pRequest	- Request of BeginReadPhoto
+//		pbmiPhoto	- Receives the bitmap info header
+//		ppPhotoBits	- Receives the bits, freed with CoTaskMemFree
+//
+// Returns: NOERROR if succesfull, S_FALSE if the employee does not exist or
+//			has no photo
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeAsyncStore::EndReadPhoto(ASYNC_REQUEST *pRequest, BITMAPINFOHEADER *pbmiPhoto, BYTE **ppPhotoBits)
+{
+	HRESULT hr;
+
+	if (NULL == pRequest || ASYNC_OP_READ_PHOTO != pRequest->dwOperation)
+	{
+		return E_INVALIDARG;
+	}
+
+	hr = Wait(pRequest, INFINITE);
+
+	if (ppPhotoBits)
+	{
+		*ppPhotoBits = NULL;
+	}
+
+	if (NOERROR == hr && pbmiPhoto && ppPhotoBits)
+	{
+		*pbmiPhoto				= pRequest->bmiPhoto;
+		*ppPhotoBits			= pRequest->pPhotoBits;
+		pRequest->pPhotoBits	= NULL;
+	}
+
+	FreeRequest(pRequest);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::BeginBulkUpdate()
+//
+// Description: Begin EmployeeBulkUpdate::Apply. The columns and the
+//				changes are used in place and kept until the request ends.
+//
+// Parameters
+//		rgpwszColumns	- Columns the changes set, as for EmployeeBulkUpdate::Open
+//		cColumns		- Number of columns
+//		rgChanges		- Changes
+//		cChanges		- Number of changes
+//		cTxnRows		- Changes per transaction, 0 for the default
+//		pCall			- How the request is run, NULL for the defaults
+//		ppRequest		- Receives the request, ended with EndBulkUpdate
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeAsyncStore::BeginBulkUpdate(WCHAR						**rgpwszColumns,
+											DWORD						cColumns,
+											const BULK_UPDATE_CHANGE	*rgChanges,
+											DWORD						cChanges,
+											DWORD						cTxnRows,
+											const ASYNC_CALL			*pCall,
+											ASYNC_REQUEST				**ppRequest)
+{
+	HRESULT			hr			= NOERROR;
+	ASYNC_REQUEST	*pRequest;
+
+	if (NULL == rgpwszColumns || 0 == cColumns || (cChanges && NULL == rgChanges))
+	{
+		return E_INVALIDARG;
+	}
+
+	pRequest = NewRequest(ASYNC_OP_BULK_UPDATE);
+	if (NULL == pRequest)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	pRequest->rgpwszColumns	= rgpwszColumns;
+	pRequest->cColumns		= cColumns;
+	pRequest->rgChanges		= rgChanges;
+	pRequest->cChanges		= cChanges;
+	pRequest->cTxnRows		= cTxnRows ? cTxnRows : BULK_UPDATE_TXN_ROWS;
+
+	hr = Begin(pRequest, pCall, ppRequest);
+	if(FAILED(hr))
+	{
+		FreeRequest(pRequest);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::EndBulkUpdate()
+//
+// Description: Wait for a bulk update and free the request.
+//
+// Parameters
+//		pRequest	- Request of BeginBulkUpdate
+//		pStats		- Optionally receives the statistics of the update
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeAsyncStore::EndBulkUpdate(ASYNC_REQUEST *pRequest, BULK_UPDATE_STATS *pStats)
+{
+	HRESULT hr;
+
+	if (NULL == pRequest || ASYNC_OP_BULK_UPDATE != pRequest->dwOperation)
+	{
+		return E_INVALIDARG;
+	}
+
+	hr = Wait(pRequest, INFINITE);
+
+	if (pStats)
+	{
+		*pStats = pRequest->BulkStats;
+	}
+
+	FreeRequest(pRequest);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::Wait()
+//
+// Description: Wait for a request to complete, without ending it.
+//
+// Returns: the result of the request, HRESULT_FROM_WIN32(ERROR_TIMEOUT) if
+//			it did not complete in time
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeAsyncStore::Wait(ASYNC_REQUEST *pRequest, DWORD dwTimeoutMs)
+{
+	if (NULL == pRequest)
+	{
+		return E_INVALIDARG;
+	}
+
+	if (pRequest->fComplete)
+	{
+		return pRequest->hr;
+	}
+
+	return g_TaskScheduler.Wait(pRequest->pTask, dwTimeoutMs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::Cancel()
+//
+// Description: Cancel a request. It still has to be ended.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeeAsyncStore::Cancel(ASYNC_REQUEST *pRequest)
+{
+	if (pRequest)
+	{
+		InterlockedExchange(&pRequest->fCancel, TRUE);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::RequestTask()
+//
+// Description: PFN_SCHEDULER_TASK running a request.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CALLBACK EmployeeAsyncStore::RequestTask(LPVOID pvContext, const SCHEDULER_TASK_CONTEXT *pTaskContext)
+{
+	ASYNC_REQUEST	*pRequest	= (ASYNC_REQUEST*)pvContext;
+	PFN_ASYNC_DONE	pfnDone		= pRequest->Call.pfnDone;
+	LPVOID			pvDone		= pRequest->Call.pvContext;
+	HRESULT			hr;
+
+	pRequest->pfTaskCancel = pTaskContext->pfCancel;
+
+	hr = pRequest->pThis->RunRequest(pRequest, pTaskContext->pSession);
+
+	// The request may be ended as soon as it is complete
+	//
+	pRequest->hr = hr;
+	InterlockedExchange(&pRequest->fComplete, TRUE);
+
+	if (pfnDone)
+	{
+		pfnDone(pvDone, pRequest, hr);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::RunRequest()
+//
+// Description: Run the operation of a request on the worker thread.
+//
+// Parameters
+//		pRequest	- the request
+//		pSession	- session of the worker, NULL if the scheduler has no
+//					  session pool
+//
+// Returns: the result of the operation
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeAsyncStore::RunRequest(ASYNC_REQUEST *pRequest, POOLED_SESSION *pSession)
+{
+	HRESULT					hr				= NOERROR;
+	EmployeeStore			Store;
+	EmployeeRecord			Record;
+	EmployeeBulkUpdate		BulkUpdate;
+	const BITMAPINFOHEADER	*pbmiPhoto;
+	const BYTE				*pPhotoBits		= NULL;
+	IOpenRowset				*pISession		= pSession ? pSession->pISession : NULL;
+	IOpenRowset				*pIOpenRowset	= NULL;		// Session of the request without a pool
+
+	hr = CheckAbandoned(pRequest);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	if (NULL == pISession)
+	{
+		hr = m_pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pIOpenRowset);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+
+		pISession = pIOpenRowset;
+	}
+
+	if (ASYNC_OP_BULK_UPDATE != pRequest->dwOperation)
+	{
+		hr = pSession ? Store.Open(pSession) : Store.Open(pISession);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+	}
+
+	switch (pRequest->dwOperation)
+	{
+	case ASYNC_OP_LOAD:
+		hr = Store.Load(pRequest->dwEmployeeID, &Record);
+		if (NOERROR == hr)
+		{
+			pRequest->pRecord = Record.Detach();
+		}
+		break;
+
+	case ASYNC_OP_SAVE:
+		Record.Attach(pRequest->pRecord);
+		pRequest->pRecord = NULL;
+
+		hr = Store.Save(&Record);
+
+		pRequest->pRecord = Record.Detach();
+		break;
+
+	case ASYNC_OP_SCAN_NAMES:
+		hr = Store.ScanNames(ScanName, pRequest);
+		if (SUCCEEDED(hr))
+		{
+			// A scan ended by ScanName reports why
+			//
+			hr = CheckAbandoned(pRequest);
+		}
+		break;
+
+	case ASYNC_OP_READ_PHOTO:
+		hr = Store.Load(pRequest->dwEmployeeID, &Record);
+		if (NOERROR != hr)
+		{
+			break;
+		}
+
+		pbmiPhoto = Record.GetPhoto(&pPhotoBits);
+		if (NULL == pbmiPhoto)
+		{
+			hr = S_FALSE;
+			break;
+		}
+
+		pRequest->pPhotoBits = (BYTE*)CoTaskMemAlloc(pbmiPhoto->biSizeImage);
+		if (NULL == pRequest->pPhotoBits)
+		{
+			hr = E_OUTOFMEMORY;
+			break;
+		}
+
+		memcpy(pRequest->pPhotoBits, pPhotoBits, pbmiPhoto->biSizeImage);
+		pRequest->bmiPhoto = *pbmiPhoto;
+		break;
+
+	case ASYNC_OP_BULK_UPDATE:
+		hr = BulkUpdate.Open(pISession, pRequest->rgpwszColumns, pRequest->cColumns);
+		if(FAILED(hr))
+		{
+			break;
+		}
+
+		hr = BulkUpdate.Apply(pRequest->rgChanges, pRequest->cChanges, pRequest->cTxnRows, NULL);
+
+		BulkUpdate.GetStats(&pRequest->BulkStats);
+		break;
+
+	default:
+		hr = E_UNEXPECTED;
+		break;
+	}
+
+Exit:
+	BulkUpdate.Close();
+	Store.Close();
+
+	if (pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::ScanName()
+//
+// Description: PFN_EMPLOYEE_NAME passing the names of a scan on, until the
+//				request is cancelled or times out.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CALLBACK EmployeeAsyncStore::ScanName(LPVOID pvContext, DWORD dwEmployeeID, LPCWSTR pwszName)
+{
+	ASYNC_REQUEST *pRequest = (ASYNC_REQUEST*)pvContext;
+
+	if (FAILED(CheckAbandoned(pRequest)))
+	{
+		return S_FALSE;
+	}
+
+	return pRequest->pfnName(pRequest->pvName, dwEmployeeID, pwszName);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::CheckAbandoned()
+//
+// Description: Check whether a request is still wanted.
+//
+// Returns: NOERROR if it is, E_ABORT if it was cancelled,
+//			HRESULT_FROM_WIN32(ERROR_TIMEOUT) if it ran out of time
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeAsyncStore::CheckAbandoned(const ASYNC_REQUEST *pRequest)
+{
+	if (pRequest->fCancel || (pRequest->pfTaskCancel && *pRequest->pfTaskCancel))
+	{
+		return E_ABORT;
+	}
+
+	if (INFINITE != pRequest->Call.dwTimeoutMs &&
+		GetTickCount() - pRequest->dwBeginMs >= pRequest->Call.dwTimeoutMs)
+	{
+		return HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::NewRequest()
+//
+// Description: Allocate an empty request.
+//
+// Returns: the request, NULL if out of memory
+//
+////////////////////////////////////////////////////////////////////////////////
+ASYNC_REQUEST* EmployeeAsyncStore::NewRequest(DWORD dwOperation)
+{
+	ASYNC_REQUEST *pRequest = (ASYNC_REQUEST*)CoTaskMemAlloc(sizeof(ASYNC_REQUEST));
+
+	if (pRequest)
+	{
+		memset(pRequest, 0, sizeof(ASYNC_REQUEST));
+
+		pRequest->pThis			= this;
+		pRequest->dwOperation	= dwOperation;
+		pRequest->hr			= E_PENDING;
+	}
+
+	return pRequest;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::Begin()
+//
+// Description: Queue a request to g_TaskScheduler. The caller frees a
+//				request that can't be queued.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeAsyncStore::Begin(ASYNC_REQUEST *pRequest, const ASYNC_CALL *pCall, ASYNC_REQUEST **ppRequest)
+{
+	HRESULT hr = NOERROR;
+
+	if (NULL == ppRequest)
+	{
+		return E_INVALIDARG;
+	}
+
+	*ppRequest = NULL;
+
+	if (NULL == m_pIDBCreateSession)
+	{
+		return E_UNEXPECTED;
+	}
+
+	if (pCall)
+	{
+		pRequest->Call = *pCall;
+	}
+	else
+	{
+		pRequest->Call.dwPriority	= SCHEDULER_PRIORITY_INTERACTIVE;
+		pRequest->Call.iAffinity	= SCHEDULER_NO_AFFINITY;
+		pRequest->Call.dwTimeoutMs	= INFINITE;
+	}
+
+	pRequest->dwBeginMs = GetTickCount();
+
+	hr = g_TaskScheduler.Submit(RequestTask,
+								pRequest,
+								pRequest->Call.dwPriority,
+								pRequest->Call.iAffinity,
+								&pRequest->pTask);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	*ppRequest = pRequest;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeAsyncStore::FreeRequest()
+//
+// Description: Free a request and the results nobody took.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeeAsyncStore::FreeRequest(ASYNC_REQUEST *pRequest)
+{
+	if (NULL == pRequest)
+	{
+		return;
+	}
+
+	if (pRequest->pTask)
+	{
+		g_TaskScheduler.CloseTask(pRequest->pTask);
+	}
+
+	if (pRequest->pRecord)
+	{
+		CoTaskMemFree(pRequest->pRecord);
+	}
+
+	if (pRequest->pPhotoBits)
+	{
+		CoTaskMemFree(pRequest->pPhotoBits);
+	}
+
+	CoTaskMemFree(pRequest);
+}
@@ -0,0 +1,142 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: EmployeeAsyncStore
+//
+// File: AsyncStore.h
+//
+// Comment: Employee reads and writes run as scheduled tasks.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_ASYNCSTORE_H__C4E92B07_5A1F_4D36_8E0B_7F23D6A91E58__INCLUDED_)
+#define AFX_ASYNCSTORE_H__C4E92B07_5A1F_4D36_8E0B_7F23D6A91E58__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+// Operations of a request
+//
+#define ASYNC_OP_LOAD				1
+#define ASYNC_OP_SAVE				2
+#define ASYNC_OP_SCAN_NAMES			3
+#define ASYNC_OP_READ_PHOTO			4
+#define ASYNC_OP_BULK_UPDATE		5
+
+////////////////////////////////////////////////////////////////////////////////
+// Called on the worker thread when a request completes, with its result.
+// The request stays valid until it is ended; the call must not end it.
+//
+typedef void (CALLBACK *PFN_ASYNC_DONE)(LPVOID pvContext, struct tagASYNC_REQUEST *pRequest, HRESULT hr);
+
+////////////////////////////////////////////////////////////////////////////////
+// How a request is run, NULL for an interactive request without timeout
+//
+typedef struct tagASYNC_CALL
+{
+	DWORD				dwPriority;				// SCHEDULER_PRIORITY_*
+	DWORD				iAffinity;				// Worker, SCHEDULER_NO_AFFINITY for any
+	DWORD				dwTimeoutMs;			// From Begin to completion, INFINITE for none
+	PFN_ASYNC_DONE		pfnDone;				// Optional
+	LPVOID				pvContext;				// Passed to pfnDone
+} ASYNC_CALL;
+
+////////////////////////////////////////////////////////////////////////////////
+// A request in flight, from Begin to End
+//
+typedef struct tagASYNC_REQUEST
+{
+	class EmployeeAsyncStore	*pThis;
+	DWORD						dwOperation;			// ASYNC_OP_*
+	ASYNC_CALL					Call;
+	DWORD						dwBeginMs;
+	SCHEDULER_TASK				*pTask;
+	volatile LONG				*pfTaskCancel;			// Cancel flag of the task, set when it runs
+	volatile LONG				fCancel;
+	volatile LONG				fComplete;				// hr and the results are set
+	HRESULT						hr;
+
+	// Arguments
+	//
+	DWORD						dwEmployeeID;			// Load, read photo
+	PFN_EMPLOYEE_NAME			pfnName;				// Scan names
+	LPVOID						pvName;
+	WCHAR						**rgpwszColumns;		// Bulk update
+	DWORD						cColumns;
+	const BULK_UPDATE_CHANGE	*rgChanges;
+	DWORD						cChanges;
+	DWORD						cTxnRows;
+
+	// Results
+	//
+	EMPLOYEE_INFO_RECORD		*pRecord;				// Load, and save both ways
+	BITMAPINFOHEADER			bmiPhoto;				// Read photo
+	BYTE						*pPhotoBits;
+	BULK_UPDATE_STATS			BulkStats;				// Bulk update
+} ASYNC_REQUEST;
+
+////////////////////////////////////////////////////////////////////////////////
+// Runs the EmployeeStore and EmployeeBulkUpdate operations as tasks of
+// g_TaskScheduler, so that one thread can have many of them in flight.
+// Each Begin queues a request and returns at once; the matching End waits
+// for it, returns its result and frees it. Every request is ended, also
+// when cancelled or timed out.
+//
+// Cancel and the timeout complete a request that has not started with
+// E_ABORT or HRESULT_FROM_WIN32(ERROR_TIMEOUT). A scan also stops between
+// rows; a load, save or bulk update that has started runs to its end.
+// Wait gives up on a request without cancelling it.
+//
+class EmployeeAsyncStore
+{
+public:
+	EmployeeAsyncStore();
+	~EmployeeAsyncStore();
+
+	HRESULT Open(IDBCreateSession *pIDBCreateSession);
+	void	Close();
+
+	HRESULT BeginLoad(DWORD dwEmployeeID, const ASYNC_CALL *pCall, ASYNC_REQUEST **ppRequest);
+	HRESULT EndLoad(ASYNC_REQUEST *pRequest, EmployeeRecord *pRecord);
+
+	HRESULT BeginSave(EmployeeRecord *pRecord, const ASYNC_CALL *pCall, ASYNC_REQUEST **ppRequest);
+	HRESULT EndSave(ASYNC_REQUEST *pRequest, EmployeeRecord *pRecord);
+
+	HRESULT BeginScanNames(PFN_EMPLOYEE_NAME pfnName, LPVOID pvContext, const ASYNC_CALL *pCall, ASYNC_REQUEST **ppRequest);
+	HRESULT EndScanNames(ASYNC_REQUEST *pRequest);
+
+	HRESULT BeginReadPhoto(DWORD dwEmployeeID, const ASYNC_CALL *pCall, ASYNC_REQUEST **ppRequest);
+	HRESULT EndReadPhoto(ASYNC_REQUEST *pRequest, BITMAPINFOHEADER *pbmiPhoto, BYTE **ppPhotoBits);
+
+	HRESULT BeginBulkUpdate(WCHAR						**rgpwszColumns,
+							DWORD						cColumns,
+							const BULK_UPDATE_CHANGE	*rgChanges,
+							DWORD						cChanges,
+							DWORD						cTxnRows,
+							const ASYNC_CALL			*pCall,
+							ASYNC_REQUEST				**ppRequest);
+	HRESULT EndBulkUpdate(ASYNC_REQUEST *pRequest, BULK_UPDATE_STATS *pStats);
+
+	HRESULT Wait(ASYNC_REQUEST *pRequest, DWORD dwTimeoutMs);
+	void	Cancel(ASYNC_REQUEST *pRequest);
+
+private:
+	static HRESULT CALLBACK RequestTask(LPVOID pvContext, const SCHEDULER_TASK_CONTEXT *pTaskContext);
+	static HRESULT CALLBACK ScanName(LPVOID pvContext, DWORD dwEmployeeID, LPCWSTR pwszName);
+	static HRESULT	CheckAbandoned(const ASYNC_REQUEST *pRequest);
+
+	ASYNC_REQUEST*	NewRequest(DWORD dwOperation);
+	HRESULT Begin(ASYNC_REQUEST *pRequest, const ASYNC_CALL *pCall, ASYNC_REQUEST **ppRequest);
+	void	FreeRequest(ASYNC_REQUEST *pRequest);
+
+	HRESULT RunRequest(ASYNC_REQUEST *pRequest, POOLED_SESSION *pSession);
+
+	IDBCreateSession	*m_pIDBCreateSession;
+};
+
+#endif // !defined(AFX_ASYNCSTORE_H__C4E92B07_5A1F_4D36_8E0B_7F23D6A91E58__INCLUDED_)
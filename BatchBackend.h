@@ -0,0 +1,165 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: BatchBackend
+//
+// File: BatchBackend.h
+//
+// Comment: The data layer the batch driver runs its commands against.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_BATCHBACKEND_H__9A4E27D3_61C8_4B5F_B0D2_3F8C15E9A764__INCLUDED_)
+#define AFX_BATCHBACKEND_H__9A4E27D3_61C8_4B5F_B0D2_3F8C15E9A764__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+////////////////////////////////////////////////////////////////////////////////
+// Rows of text to insert. The fields of a row follow each other, cColumns
+// per row; a NULL field is a NULL value.
+//
+typedef struct tagBATCH_ROWS
+{
+	WCHAR		**rgpwszColumns;				// Column names, from the header
+	DWORD		cColumns;
+	DWORD		iKey;							// The EmployeeID column
+	LPCWSTR		*rgpwszFields;
+} BATCH_ROWS;
+
+////////////////////////////////////////////////////////////////////////////////
+// A change of update, the new values of the columns given to OpenUpdate
+//
+typedef struct tagBATCH_CHANGE
+{
+	DWORD		dwEmployeeID;
+	LPCWSTR		*rgpwszValues;
+} BATCH_CHANGE;
+
+////////////////////////////////////////////////////////////////////////////////
+// What a load read
+//
+typedef struct tagBATCH_LOAD
+{
+	DWORD		cbRecord;
+	BOOL		fPhoto;
+} BATCH_LOAD;
+
+////////////////////////////////////////////////////////////////////////////////
+// Result of compact
+//
+typedef struct tagBATCH_COMPACT_STATS
+{
+	ULONGLONG	cbBefore;
+	ULONGLONG	cbAfter;
+	DWORD		dwElapsedMs;
+	ULONG		ulChangesDroppedTo;				// Change log entries up to it were dropped, 0 if none
+} BATCH_COMPACT_STATS;
+
+////////////////////////////////////////////////////////////////////////////////
+// A command a backend runs by itself, beyond those of the driver
+//
+typedef struct tagBATCH_BACKEND_COMMAND
+{
+	LPCWSTR		pwszName;
+	LPCWSTR		pwszUsage;
+} BATCH_BACKEND_COMMAND;
+
+////////////////////////////////////////////////////////////////////////////////
+// Receive the rows of export, the column names first, the EmployeeIDs of a
+// name scan and the sequence numbers of the change log. A failure stops the
+// scan and is returned by it.
+//
+typedef HRESULT (CALLBACK *PFN_BATCH_ROW)(LPVOID pvContext, LPCWSTR *rgpwszValues, DWORD cValues);
+typedef HRESULT (CALLBACK *PFN_BATCH_ID)(LPVOID pvContext, DWORD dwEmployeeID);
+typedef HRESULT (CALLBACK *PFN_BATCH_SEQUENCE)(LPVOID pvContext, ULONG ulSequence);
+
+////////////////////////////////////////////////////////////////////////////////
+// The connection of one worker. A session is used by one thread at a time.
+//
+class BatchSession
+{
+public:
+	virtual ~BatchSession() {}
+
+	// Insert rows iFirst to iLast, cTxnRows per transaction. Rows the store
+	// refuses, duplicate keys for instance, are counted and left out.
+	//
+	virtual HRESULT Insert(const BATCH_ROWS	*pRows,
+						   DWORD			iFirst,
+						   DWORD			iLast,
+						   DWORD			cTxnRows,
+						   DWORD			*pcInserted,
+						   DWORD			*pcRejected) = 0;
+
+	// Prepare updates of columns, kept until the session is checked in, then
+	// apply changes cTxnRows per transaction. Changes of employees that don't
+	// exist are counted and left out.
+	//
+	virtual HRESULT OpenUpdate(WCHAR **rgpwszColumns, DWORD cColumns) = 0;
+	virtual HRESULT Update(const BATCH_CHANGE	*rgChanges,
+						   DWORD				cChanges,
+						   DWORD				cTxnRows,
+						   DWORD				*pcApplied,
+						   DWORD				*pcMissing) = 0;
+
+	// Load an employee. Returns S_FALSE if it doesn't exist.
+	//
+	virtual HRESULT Load(DWORD dwEmployeeID, BATCH_LOAD *pLoad) = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// A database the driver opens, and the sessions of its workers. Every
+// session a command needs is checked out before its workers start.
+//
+class BatchBackend
+{
+public:
+	virtual ~BatchBackend() {}
+
+	virtual LPCWSTR	GetDefaultDatabase() = 0;
+	virtual DWORD	GetCommands(const BATCH_BACKEND_COMMAND **prgCommands) = 0;
+
+	// Open the database of the options. Close is called also after a failed
+	// Open, and returns a failure to write back what the backend holds.
+	//
+	virtual HRESULT Open(const BATCH_OPTIONS *pOptions) = 0;
+	virtual HRESULT Close() = 0;
+
+	virtual HRESULT CheckOut(BatchSession **ppSession) = 0;
+	virtual void	CheckIn(BatchSession *pSession, BOOL fDiscard) = 0;
+
+	// Every employee in EmployeeID order, photo left out
+	//
+	virtual HRESULT Export(PFN_BATCH_ROW pfnRow, LPVOID pvContext) = 0;
+
+	// The employees with a name, and the count of all the employees
+	//
+	virtual HRESULT ScanNames(PFN_BATCH_ID pfnID, LPVOID pvContext, DWORD *pcEmployees) = 0;
+
+	virtual HRESULT ScanChangeLog(PFN_BATCH_SEQUENCE pfnSequence, LPVOID pvContext) = 0;
+
+	// Drop the change log entries beyond the newest pOptions->cKeepChanges,
+	// then compact the database now. Returns S_FALSE if it is in use.
+	//
+	virtual HRESULT Compact(const BATCH_OPTIONS *pOptions, BATCH_COMPACT_STATS *pStats) = 0;
+
+	// Benchmark the paths of the backend beyond the loads of the driver,
+	// over the employees of a name scan
+	//
+	virtual HRESULT Benchmark(const BATCH_OPTIONS *pOptions, const DWORD *rgdwEmployeeID, DWORD cEmployees) = 0;
+
+	virtual HRESULT RunCommand(DWORD iCommand, const BATCH_OPTIONS *pOptions) = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Create the backend linked into the executable
+//
+HRESULT CreateBatchBackend(BatchBackend **ppBackend);
+
+#endif // !defined(AFX_BATCHBACKEND_H__9A4E27D3_61C8_4B5F_B0D2_3F8C15E9A764__INCLUDED_)
@@ -0,0 +1,1901 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: BatchDriver
+//
+// File: BatchDriver.cpp
+//
+// Comment: Non-interactive bulk operations selected on the command line, run
+//			against a BatchBackend.
+//
+// Functions:
+//			1. import, export and update employees as tab separated text
+//			2. verify the employees and the change log
+//			3. compact the database file and the change log
+//			4. benchmark employee loads on threads, then the paths of the
+//			   backend
+//			5. the commands of the backend
+//
+// Notes:
+//			northwindbatch <command> [-db file] [-in file] [-out file]
+//									 [-workers n] [-txn n] [-count n] [-cache]
+//									 [-budget KB] [-where condition] [-migrate]
+//									 [-keep n]
+//
+//			The driver uses the C runtime and BatchPlatform only; the data
+//			layer is behind BatchBackend, and the backend linked into the
+//			executable is the one CreateBatchBackend returns.
+//
+//			"-" or no file reads the standard input or writes the standard
+//			output. Input is read BATCH_CHUNK_ROWS lines at a time, and the
+//			lines of a chunk are split between the workers, each on a
+//			session checked out of the backend. Timing and throughput go to
+//			the standard error.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "BatchPlatform.h"
+#include "BatchDriver.h"
+#include "BatchBackend.h"
+
+#define BATCH_NULL_FIELD		0xFFFFFFFF		// Offset of a NULL field in a chunk
+
+////////////////////////////////////////////////////////////////////////////////
+// Lines of input, split into fields. The fields are kept in one character
+// pool and located by their offset while the chunk is read, then by
+// pointer.
+//
+typedef struct tagBATCH_CHUNK
+{
+	WCHAR		*pwszPool;
+	DWORD		cchPool;
+	DWORD		cchMaxPool;
+	DWORD		*rgobField;						// cColumns offsets per row
+	LPCWSTR		*rgpwszField;					// cColumns fields per row, NULL for NULL
+	DWORD		cColumns;
+	DWORD		cRows;
+	DWORD		cLines;							// Lines read from the input so far
+	ULONGLONG	cbRead;							// Bytes read from the input so far
+} BATCH_CHUNK;
+
+////////////////////////////////////////////////////////////////////////////////
+// The slice of a command run by one worker and its results
+//
+typedef struct tagBATCH_WORKER
+{
+	BatchSession				*pSession;				// Checked out of the backend
+	const BATCH_OPTIONS			*pOptions;
+	const BATCH_ROWS			*pRows;					// import
+	const BATCH_CHANGE			*rgChanges;				// update
+	const DWORD					*rgdwEmployeeID;		// verify and benchmark
+	DWORD						cEmployees;				// verify and benchmark
+	DWORD						iFirst;					// First row, change or load
+	DWORD						iLast;					// Past the last one
+	HRESULT						hr;
+	DWORD						cDone;
+	DWORD						cRejected;				// Rows refused, or employees gone
+	DWORD						cFailed;				// verify, employees that can't be loaded
+	DWORD						cNoPhoto;				// verify
+	ULONGLONG					cbBytes;				// Bytes of the records loaded
+} BATCH_WORKER;
+
+////////////////////////////////////////////////////////////////////////////////
+// Employee IDs collected by a name scan
+//
+typedef struct tagBATCH_ID_LIST
+{
+	DWORD		*rgdwEmployeeID;
+	DWORD		cIDs;
+	DWORD		cMaxIDs;
+} BATCH_ID_LIST;
+
+////////////////////////////////////////////////////////////////////////////////
+// A change of update, located in its chunk
+//
+typedef struct tagBATCH_UPDATE_KEY
+{
+	DWORD		dwEmployeeID;
+	DWORD		iRow;
+} BATCH_UPDATE_KEY;
+
+////////////////////////////////////////////////////////////////////////////////
+// Output of export
+//
+typedef struct tagBATCH_TEXT_OUTPUT
+{
+	FILE		*pFile;
+	BOOL		fHeader;						// The header was written
+	DWORD		cRows;
+	ULONGLONG	cbBytes;
+} BATCH_TEXT_OUTPUT;
+
+////////////////////////////////////////////////////////////////////////////////
+// Order of the change log, checked by verify
+//
+typedef struct tagBATCH_SEQUENCE_CHECK
+{
+	DWORD		cChanges;
+	DWORD		cOutOfOrder;
+	ULONG		ulLastSequence;
+} BATCH_SEQUENCE_CHECK;
+
+typedef HRESULT (*PFN_BATCH_COMMAND)(BatchBackend *pBackend, const BATCH_OPTIONS *pOptions);
+
+typedef struct tagBATCH_COMMAND
+{
+	LPCWSTR				pwszName;
+	PFN_BATCH_COMMAND	pfnCommand;
+	LPCWSTR				pwszUsage;
+} BATCH_COMMAND;
+
+static HRESULT ImportCommand(BatchBackend *pBackend, const BATCH_OPTIONS *pOptions);
+static HRESULT ExportCommand(BatchBackend *pBackend, const BATCH_OPTIONS *pOptions);
+static HRESULT UpdateCommand(BatchBackend *pBackend, const BATCH_OPTIONS *pOptions);
+static HRESULT VerifyCommand(BatchBackend *pBackend, const BATCH_OPTIONS *pOptions);
+static HRESULT CompactCommand(BatchBackend *pBackend, const BATCH_OPTIONS *pOptions);
+static HRESULT BenchmarkCommand(BatchBackend *pBackend, const BATCH_OPTIONS *pOptions);
+
+static const BATCH_COMMAND s_rgBatchCommands[] =	{
+														{ L"import",	ImportCommand,		L"[-in file] [-workers n] [-txn n]" },
+														{ L"export",	ExportCommand,		L"[-out file]" },
+														{ L"update",	UpdateCommand,		L"[-in file] [-workers n] [-txn n]" },
+														{ L"verify",	VerifyCommand,		L"[-workers n]" },
+														{ L"compact",	CompactCommand,		L"[-keep n]" },
+														{ L"benchmark",	BenchmarkCommand,	L"[-count n] [-workers n] [-cache]" }
+													};
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FindBatchCommand
+//
+// Description: Find a command of the driver, or else of the backend.
+//
+// Parameters:
+//			pBackend		- Backend of the commands
+//			pwszName		- Name of the command
+//			ppCommand		- Receives the command of the driver, NULL if
+//							  it is a command of the backend
+//			piCommand		- Receives the index of the backend command
+//
+// Returns: FALSE if there is no command of the name
+//
+////////////////////////////////////////////////////////////////////////////////
+static BOOL FindBatchCommand(BatchBackend *pBackend, LPCWSTR pwszName, const BATCH_COMMAND **ppCommand, DWORD *piCommand)
+{
+	const BATCH_BACKEND_COMMAND	*rgCommands;
+	DWORD						cCommands;
+	DWORD						iCommand;
+
+	*ppCommand = NULL;
+
+	for (iCommand = 0; iCommand < sizeof(s_rgBatchCommands)/sizeof(s_rgBatchCommands[0]); ++iCommand)
+	{
+		if (0 == _wcsicmp(pwszName, s_rgBatchCommands[iCommand].pwszName))
+		{
+			*ppCommand = &s_rgBatchCommands[iCommand];
+			return TRUE;
+		}
+	}
+
+	cCommands = pBackend->GetCommands(&rgCommands);
+
+	for (iCommand = 0; iCommand < cCommands; ++iCommand)
+	{
+		if (0 == _wcsicmp(pwszName, rgCommands[iCommand].pwszName))
+		{
+			*piCommand = iCommand;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PrintUsage
+//
+// Description: Print the commands of the driver and of the backend, and
+//				their options, to the standard error.
+//
+////////////////////////////////////////////////////////////////////////////////
+static void PrintUsage(BatchBackend *pBackend)
+{
+	const BATCH_BACKEND_COMMAND	*rgCommands;
+	DWORD						cCommands;
+	DWORD						iCommand;
+
+	fwprintf(stderr, L"usage: northwindbatch <command> [-db file] [options]\n");
+
+	for (iCommand = 0; iCommand < sizeof(s_rgBatchCommands)/sizeof(s_rgBatchCommands[0]); ++iCommand)
+	{
+		fwprintf(stderr, L"  %-11ls %ls\n", s_rgBatchCommands[iCommand].pwszName, s_rgBatchCommands[iCommand].pwszUsage);
+	}
+
+	cCommands = pBackend->GetCommands(&rgCommands);
+
+	for (iCommand = 0; iCommand < cCommands; ++iCommand)
+	{
+		fwprintf(stderr, L"  %-11ls %ls\n", rgCommands[iCommand].pwszName, rgCommands[iCommand].pwszUsage);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PrintBatchSummary
+//
+// Description: Print the row count, time and throughput of a command. A
+//				command faster than the tick count shows no throughput.
+//
+////////////////////////////////////////////////////////////////////////////////
+void PrintBatchSummary(LPCWSTR pwszWhat, DWORD cRows, ULONGLONG cbBytes, DWORD dwElapsedMs)
+{
+	DWORD dwRowsPerSec;
+	DWORD dwMBps100;
+
+	if (0 == dwElapsedMs)
+	{
+		fwprintf(stderr, L"%ls: %u rows in 0 ms, n/a rows/s, n/a MB/s\n", pwszWhat, cRows);
+		return;
+	}
+
+	dwRowsPerSec = (DWORD)((ULONGLONG)cRows * 1000 / dwElapsedMs);
+
+	// bytes * 100 * 1000 / (ms * 1024 * 1024)
+	//
+	dwMBps100 = (DWORD)((cbBytes * 100000) / ((ULONGLONG)dwElapsedMs * 1024 * 1024));
+
+	fwprintf(stderr,
+			 L"%ls: %u rows in %u ms, %u rows/s, %u.%02u MB/s\n",
+			 pwszWhat,
+			 cRows,
+			 dwElapsedMs,
+			 dwRowsPerSec,
+			 dwMBps100 / 100,
+			 dwMBps100 % 100);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SplitCommandLine
+//
+// Description: Split a command line in place at blanks. A double quoted
+//				argument may hold blanks.
+//
+////////////////////////////////////////////////////////////////////////////////
+static DWORD SplitCommandLine(WCHAR *pwszCmdLine, LPWSTR *rgpwszArgs, DWORD cMaxArgs)
+{
+	WCHAR	*pwch	= pwszCmdLine;
+	DWORD	cArgs	= 0;
+
+	for (;;)
+	{
+		while (L' ' == *pwch || L'\t' == *pwch)
+		{
+			++pwch;
+		}
+
+		if (L'\0' == *pwch || cArgs == cMaxArgs)
+		{
+			break;
+		}
+
+		if (L'"' == *pwch)
+		{
+			rgpwszArgs[cArgs++] = ++pwch;
+
+			while (*pwch && L'"' != *pwch)
+			{
+				++pwch;
+			}
+		}
+		else
+		{
+			rgpwszArgs[cArgs++] = pwch;
+
+			while (*pwch && L' ' != *pwch && L'\t' != *pwch)
+			{
+				++pwch;
+			}
+		}
+
+		if (*pwch)
+		{
+			*pwch++ = L'\0';
+		}
+	}
+
+	return cArgs;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ParseBatchOptions
+//
+// Description: Parse the command and the arguments that follow it. The
+//				database is left NULL if -db isn't given.
+//
+// Returns: FALSE if an option is unknown or has no valid value
+//
+////////////////////////////////////////////////////////////////////////////////
+static BOOL ParseBatchOptions(LPWSTR *rgpwszArgs, DWORD cArgs, BATCH_OPTIONS *pOptions)
+{
+	DWORD	iArg;
+	LPCWSTR	pwszValue;
+
+	memset(pOptions, 0, sizeof(BATCH_OPTIONS));
+
+	pOptions->cWorkers		= 1;
+	pOptions->cTxnRows		= BATCH_TXN_ROWS;
+	pOptions->cLoads		= BATCH_DEFAULT_LOADS;
+	pOptions->cKeepChanges	= BATCH_KEEP_CHANGES;
+
+	if (0 == cArgs)
+	{
+		return FALSE;
+	}
+
+	pOptions->pwszCommand = rgpwszArgs[0];
+
+	for (iArg = 1; iArg < cArgs; ++iArg)
+	{
+		if (0 == _wcsicmp(rgpwszArgs[iArg], L"-cache"))
+		{
+			pOptions->fCache = TRUE;
+			continue;
+		}
+
+		if (0 == _wcsicmp(rgpwszArgs[iArg], L"-migrate"))
+		{
+			pOptions->fMigrate = TRUE;
+			continue;
+		}
+
+		// The other options take a value
+		//
+		if (iArg + 1 == cArgs)
+		{
+			return FALSE;
+		}
+
+		pwszValue = rgpwszArgs[++iArg];
+
+		if (0 == _wcsicmp(rgpwszArgs[iArg - 1], L"-db"))
+		{
+			pOptions->pwszDatabase = pwszValue;
+		}
+		else if (0 == _wcsicmp(rgpwszArgs[iArg - 1], L"-in"))
+		{
+			pOptions->pwszInput = pwszValue;
+		}
+		else if (0 == _wcsicmp(rgpwszArgs[iArg - 1], L"-out"))
+		{
+			pOptions->pwszOutput = pwszValue;
+		}
+		else if (0 == _wcsicmp(rgpwszArgs[iArg - 1], L"-workers"))
+		{
+			pOptions->cWorkers = _wtoi(pwszValue);
+			if (0 == pOptions->cWorkers || pOptions->cWorkers > BATCH_MAX_WORKERS)
+			{
+				return FALSE;
+			}
+		}
+		else if (0 == _wcsicmp(rgpwszArgs[iArg - 1], L"-txn"))
+		{
+			pOptions->cTxnRows = _wtoi(pwszValue);
+			if (0 == pOptions->cTxnRows)
+			{
+				return FALSE;
+			}
+		}
+		else if (0 == _wcsicmp(rgpwszArgs[iArg - 1], L"-count"))
+		{
+			pOptions->cLoads = _wtoi(pwszValue);
+			if (0 == pOptions->cLoads)
+			{
+				return FALSE;
+			}
+		}
+		else if (0 == _wcsicmp(rgpwszArgs[iArg - 1], L"-where"))
+		{
+			if (BATCH_MAX_WHERE == pOptions->cWhere)
+			{
+				return FALSE;
+			}
+
+			pOptions->rgpwszWhere[pOptions->cWhere++] = pwszValue;
+		}
+		else if (0 == _wcsicmp(rgpwszArgs[iArg - 1], L"-keep"))
+		{
+			pOptions->cKeepChanges = _wtoi(pwszValue);
+			if (0 == pOptions->cKeepChanges && 0 != wcscmp(pwszValue, L"0"))
+			{
+				return FALSE;
+			}
+		}
+		else if (0 == _wcsicmp(rgpwszArgs[iArg - 1], L"-budget"))
+		{
+			pOptions->cbJoinBudget = 1024 * _wtoi(pwszValue);
+			if (0 == pOptions->cbJoinBudget)
+			{
+				return FALSE;
+			}
+		}
+		else
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: OpenBatchStream
+//
+// Description: Open the input or output of a command. NULL or "-" is the
+//				standard input or output.
+//
+////////////////////////////////////////////////////////////////////////////////
+FILE* OpenBatchStream(LPCWSTR pwszFile, BOOL fWrite)
+{
+	FILE *pFile;
+
+	if (NULL == pwszFile || 0 == wcscmp(pwszFile, L"-"))
+	{
+		return fWrite ? stdout : stdin;
+	}
+
+	pFile = _wfopen(pwszFile, fWrite ? L"w" : L"r");
+	if (NULL == pFile)
+	{
+		fwprintf(stderr, L"cannot open %ls\n", pwszFile);
+	}
+
+	return pFile;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CloseBatchStream
+//
+// Description: Close a stream opened by OpenBatchStream.
+//
+////////////////////////////////////////////////////////////////////////////////
+void CloseBatchStream(FILE *pFile)
+{
+	if (stdin == pFile || stdout == pFile)
+	{
+		fflush(pFile);
+	}
+	else if (pFile)
+	{
+		fclose(pFile);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ReadBatchLine
+//
+// Description: Read a line of BATCH_MAX_LINE characters at most, without
+//				its line break.
+//
+// Returns: NOERROR if a line was read, S_FALSE at the end of the input
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ReadBatchLine(FILE *pFile, WCHAR *pwszLine)
+{
+	DWORD cch;
+
+	if (NULL == fgetws(pwszLine, BATCH_MAX_LINE, pFile))
+	{
+		return ferror(pFile) ? E_FAIL : S_FALSE;
+	}
+
+	cch = wcslen(pwszLine);
+
+	if (cch && L'\n' == pwszLine[cch - 1])
+	{
+		pwszLine[--cch] = L'\0';
+	}
+	else if (!feof(pFile))
+	{
+		return HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
+	}
+
+	if (cch && L'\r' == pwszLine[cch - 1])
+	{
+		pwszLine[--cch] = L'\0';
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SplitBatchLine
+//
+// Description: Split a line in place at tabs and remove the escapes of its
+//				fields. A \N field is returned as NULL.
+//
+// Returns: NOERROR if succesfull, E_INVALIDARG if the line has more than
+//			cMaxFields fields
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT SplitBatchLine(WCHAR *pwszLine, LPWSTR *rgpwszFields, DWORD cMaxFields, DWORD *pcFields)
+{
+	WCHAR	*pwchRead	= pwszLine;
+	WCHAR	*pwchWrite	= pwszLine;
+	WCHAR	*pwszField	= pwszLine;
+	BOOL	fNull		= FALSE;
+	DWORD	cFields		= 0;
+	WCHAR	wch;
+
+	for (;;)
+	{
+		wch = *pwchRead++;
+
+		if (L'\t' == wch || L'\0' == wch)
+		{
+			if (cFields == cMaxFields)
+			{
+				return E_INVALIDARG;
+			}
+
+			*pwchWrite++ = L'\0';
+			rgpwszFields[cFields++] = fNull ? NULL : pwszField;
+
+			if (L'\0' == wch)
+			{
+				break;
+			}
+
+			pwszField	= pwchWrite;
+			fNull		= FALSE;
+			continue;
+		}
+
+		if (L'\\' == wch && *pwchRead)
+		{
+			wch = *pwchRead++;
+
+			switch (wch)
+			{
+			case L't':
+				wch = L'\t';
+				break;
+
+			case L'n':
+				wch = L'\n';
+				break;
+
+			case L'r':
+				wch = L'\r';
+				break;
+
+			case L'N':
+				fNull = TRUE;
+				continue;
+			}
+		}
+
+		*pwchWrite++ = wch;
+	}
+
+	*pcFields = cFields;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: WriteBatchField
+//
+// Description: Write a field, escaped, without its separator.
+//
+// Returns: The number of bytes of the value
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD WriteBatchField(FILE *pFile, LPCWSTR pwszValue)
+{
+	LPCWSTR pwch;
+
+	if (NULL == pwszValue)
+	{
+		fputws(L"\\N", pFile);
+		return 0;
+	}
+
+	for (pwch = pwszValue; *pwch; ++pwch)
+	{
+		switch (*pwch)
+		{
+		case L'\t':
+			fputws(L"\\t", pFile);
+			break;
+
+		case L'\n':
+			fputws(L"\\n", pFile);
+			break;
+
+		case L'\r':
+			fputws(L"\\r", pFile);
+			break;
+
+		case L'\\':
+			fputws(L"\\\\", pFile);
+			break;
+
+		default:
+			fputwc(*pwch, pFile);
+			break;
+		}
+	}
+
+	return sizeof(WCHAR) * (pwch - pwszValue);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: InitBatchChunk
+//
+// Description: Allocate a chunk for lines of cColumns fields.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT InitBatchChunk(BATCH_CHUNK *pChunk, DWORD cColumns)
+{
+	memset(pChunk, 0, sizeof(BATCH_CHUNK));
+
+	pChunk->cColumns	= cColumns;
+	pChunk->rgobField	= (DWORD*)CoTaskMemAlloc(sizeof(DWORD) * BATCH_CHUNK_ROWS * cColumns);
+	pChunk->rgpwszField	= (LPCWSTR*)CoTaskMemAlloc(sizeof(LPCWSTR) * BATCH_CHUNK_ROWS * cColumns);
+	if (NULL == pChunk->rgobField || NULL == pChunk->rgpwszField)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FreeBatchChunk
+//
+// Description: Free the buffers of a chunk.
+//
+////////////////////////////////////////////////////////////////////////////////
+static void FreeBatchChunk(BATCH_CHUNK *pChunk)
+{
+	if (pChunk->pwszPool)
+	{
+		CoTaskMemFree(pChunk->pwszPool);
+		pChunk->pwszPool = NULL;
+	}
+
+	if (pChunk->rgobField)
+	{
+		CoTaskMemFree(pChunk->rgobField);
+		pChunk->rgobField = NULL;
+	}
+
+	if (pChunk->rgpwszField)
+	{
+		CoTaskMemFree(pChunk->rgpwszField);
+		pChunk->rgpwszField = NULL;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetChunkField
+//
+// Description: Returns a field of a row of a chunk, NULL for a NULL field.
+//
+////////////////////////////////////////////////////////////////////////////////
+static LPCWSTR GetChunkField(const BATCH_CHUNK *pChunk, DWORD iRow, DWORD iColumn)
+{
+	return pChunk->rgpwszField[iRow * pChunk->cColumns + iColumn];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ReadBatchChunk
+//
+// Description: Read the next BATCH_CHUNK_ROWS lines at most. Blank lines
+//				are skipped.
+//
+// Parameters:
+//			pFile		- Input
+//			pwszLine	- Buffer of BATCH_MAX_LINE characters
+//			pChunk		- Receives the lines
+//
+// Returns: NOERROR if lines were read, S_FALSE at the end of the input
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT ReadBatchChunk(FILE *pFile, WCHAR *pwszLine, BATCH_CHUNK *pChunk)
+{
+	HRESULT	hr			= NOERROR;
+	LPWSTR	rgpwszFields[BATCH_MAX_COLUMNS];
+	DWORD	cFields;
+	DWORD	iField;
+	DWORD	cchField;
+	DWORD	cchMaxPool;
+	WCHAR	*pwszPool;
+	DWORD	obField;
+
+	pChunk->cRows	= 0;
+	pChunk->cchPool	= 0;
+
+	while (pChunk->cRows < BATCH_CHUNK_ROWS)
+	{
+		hr = ReadBatchLine(pFile, pwszLine);
+		if (NOERROR != hr)
+		{
+			break;
+		}
+
+		++pChunk->cLines;
+		pChunk->cbRead += sizeof(WCHAR) * (wcslen(pwszLine) + 1);
+
+		if (L'\0' == pwszLine[0])
+		{
+			continue;
+		}
+
+		hr = SplitBatchLine(pwszLine, rgpwszFields, BATCH_MAX_COLUMNS, &cFields);
+		if (SUCCEEDED(hr) && cFields != pChunk->cColumns)
+		{
+			hr = E_INVALIDARG;
+		}
+
+		if(FAILED(hr))
+		{
+			break;
+		}
+
+		// Append the fields to the pool, it grows by doubling
+		//
+		for (iField = 0; iField < cFields; ++iField)
+		{
+			if (NULL == rgpwszFields[iField])
+			{
+				pChunk->rgobField[pChunk->cRows * pChunk->cColumns + iField] = BATCH_NULL_FIELD;
+				continue;
+			}
+
+			cchField = wcslen(rgpwszFields[iField]) + 1;
+
+			if (pChunk->cchPool + cchField > pChunk->cchMaxPool)
+			{
+				cchMaxPool = pChunk->cchMaxPool ? 2 * pChunk->cchMaxPool : BATCH_MAX_LINE;
+				while (pChunk->cchPool + cchField > cchMaxPool)
+				{
+					cchMaxPool *= 2;
+				}
+
+				pwszPool = (WCHAR*)CoTaskMemRealloc(pChunk->pwszPool, sizeof(WCHAR) * cchMaxPool);
+				if (NULL == pwszPool)
+				{
+					return E_OUTOFMEMORY;
+				}
+
+				pChunk->pwszPool	= pwszPool;
+				pChunk->cchMaxPool	= cchMaxPool;
+			}
+
+			pChunk->rgobField[pChunk->cRows * pChunk->cColumns + iField] = pChunk->cchPool;
+			memcpy(pChunk->pwszPool + pChunk->cchPool, rgpwszFields[iField], sizeof(WCHAR) * cchField);
+			pChunk->cchPool += cchField;
+		}
+
+		++pChunk->cRows;
+	}
+
+	if(FAILED(hr))
+	{
+		fwprintf(stderr, L"line %u: %ls\n", pChunk->cLines,
+				 HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER) == hr ? L"too long" : L"bad number of fields");
+		return hr;
+	}
+
+	// The pool doesn't move any more, the fields are located by pointer
+	//
+	for (iField = 0; iField < pChunk->cRows * pChunk->cColumns; ++iField)
+	{
+		obField = pChunk->rgobField[iField];
+
+		pChunk->rgpwszField[iField] = (BATCH_NULL_FIELD == obField) ? NULL : pChunk->pwszPool + obField;
+	}
+
+	return pChunk->cRows ? NOERROR : S_FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ReadBatchHeader
+//
+// Description: Read the header line of the input, the column names.
+//
+// Parameters:
+//			pFile			- Input
+//			pwszHeader		- Buffer of BATCH_MAX_LINE characters, holds
+//							  the names afterwards
+//			rgpwszColumns	- Receives BATCH_MAX_COLUMNS names at most
+//			pcColumns		- Receives the number of names
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT ReadBatchHeader(FILE *pFile, WCHAR *pwszHeader, LPWSTR *rgpwszColumns, DWORD *pcColumns)
+{
+	HRESULT hr;
+	DWORD	iColumn;
+
+	hr = ReadBatchLine(pFile, pwszHeader);
+	if (NOERROR == hr)
+	{
+		hr = SplitBatchLine(pwszHeader, rgpwszColumns, BATCH_MAX_COLUMNS, pcColumns);
+	}
+	else if (S_FALSE == hr)
+	{
+		hr = E_INVALIDARG;
+	}
+
+	for (iColumn = 0; SUCCEEDED(hr) && iColumn < *pcColumns; ++iColumn)
+	{
+		if (NULL == rgpwszColumns[iColumn] || L'\0' == rgpwszColumns[iColumn][0])
+		{
+			hr = E_INVALIDARG;
+		}
+	}
+
+	if(FAILED(hr))
+	{
+		fwprintf(stderr, L"line 1: a header of column names is expected\n");
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SliceWork
+//
+// Description: Split cItems items in contiguous slices, one per worker.
+//
+// Returns: The number of workers with a slice
+//
+////////////////////////////////////////////////////////////////////////////////
+static DWORD SliceWork(BATCH_WORKER *rgWorker, DWORD cWorkers, DWORD cItems)
+{
+	DWORD iWorker;
+
+	if (cWorkers > cItems)
+	{
+		cWorkers = cItems ? cItems : 1;
+	}
+
+	for (iWorker = 0; iWorker < cWorkers; ++iWorker)
+	{
+		rgWorker[iWorker].iFirst	= (DWORD)((ULONGLONG)cItems * iWorker / cWorkers);
+		rgWorker[iWorker].iLast		= (DWORD)((ULONGLONG)cItems * (iWorker + 1) / cWorkers);
+		rgWorker[iWorker].pSession	= NULL;
+		rgWorker[iWorker].hr		= NOERROR;
+	}
+
+	return cWorkers;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RunWorkers
+//
+// Description: Run a worker procedure for each slice, on the calling thread
+//				if there is one slice. Workers without a session get one
+//				of the backend for the run, all checked out before any
+//				worker starts.
+//
+// Returns: NOERROR if succesfull, else the first failure of a worker
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT RunWorkers(BatchBackend *pBackend, LPTHREAD_START_ROUTINE pfnWorker, BATCH_WORKER *rgWorker, DWORD cWorkers)
+{
+	HRESULT	hr			= NOERROR;
+	HANDLE	rghThread[BATCH_MAX_WORKERS];
+	BOOL	rgfCheckedOut[BATCH_MAX_WORKERS];
+	DWORD	cThreads	= 0;
+	DWORD	iWorker;
+
+	for (iWorker = 0; iWorker < cWorkers; ++iWorker)
+	{
+		rgfCheckedOut[iWorker] = FALSE;
+	}
+
+	for (iWorker = 0; iWorker < cWorkers; ++iWorker)
+	{
+		if (NULL == rgWorker[iWorker].pSession)
+		{
+			hr = pBackend->CheckOut(&rgWorker[iWorker].pSession);
+			if(FAILED(hr))
+			{
+				goto Exit;
+			}
+
+			rgfCheckedOut[iWorker] = TRUE;
+		}
+	}
+
+	if (1 == cWorkers)
+	{
+		pfnWorker(&rgWorker[0]);
+		hr = rgWorker[0].hr;
+		goto Exit;
+	}
+
+	// Fan out
+	//
+	for (iWorker = 0; iWorker < cWorkers; ++iWorker)
+	{
+		rghThread[cThreads] = CreateThread(NULL, 0, pfnWorker, &rgWorker[iWorker], 0, NULL);
+		if (NULL == rghThread[cThreads])
+		{
+			hr = HRESULT_FROM_WIN32(GetLastError());
+			break;
+		}
+
+		++cThreads;
+	}
+
+	if (cThreads)
+	{
+		WaitForMultipleObjects(cThreads, rghThread, TRUE, INFINITE);
+	}
+
+	for (iWorker = 0; iWorker < cThreads; ++iWorker)
+	{
+		CloseHandle(rghThread[iWorker]);
+
+		if (SUCCEEDED(hr) && FAILED(rgWorker[iWorker].hr))
+		{
+			hr = rgWorker[iWorker].hr;
+		}
+	}
+
+Exit:
+	for (iWorker = 0; iWorker < cWorkers; ++iWorker)
+	{
+		if (rgfCheckedOut[iWorker])
+		{
+			pBackend->CheckIn(rgWorker[iWorker].pSession, FAILED(rgWorker[iWorker].hr));
+			rgWorker[iWorker].pSession = NULL;
+		}
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ImportProc
+//
+// Description: Worker thread of import. Inserts the rows of its slice.
+//
+////////////////////////////////////////////////////////////////////////////////
+static DWORD WINAPI ImportProc(LPVOID lpParameter)
+{
+	BATCH_WORKER	*pWorker	= (BATCH_WORKER*)lpParameter;
+	BOOL			fCoInit		= SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+
+	pWorker->hr = pWorker->pSession->Insert(pWorker->pRows,
+											pWorker->iFirst,
+											pWorker->iLast,
+											pWorker->pOptions->cTxnRows,
+											&pWorker->cDone,
+											&pWorker->cRejected);
+
+	if (fCoInit)
+	{
+		CoUninitialize();
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ImportCommand
+//
+// Description: Insert employees from text. The header names the columns,
+//				which include EmployeeID.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT ImportCommand(BatchBackend *pBackend, const BATCH_OPTIONS *pOptions)
+{
+	HRESULT			hr				= NOERROR;
+	FILE			*pFile			= NULL;
+	WCHAR			wszHeader[BATCH_MAX_LINE];
+	WCHAR			wszLine[BATCH_MAX_LINE];
+	LPWSTR			rgpwszColumns[BATCH_MAX_COLUMNS];
+	DWORD			cColumns		= 0;
+	DWORD			iKey;
+	BATCH_CHUNK		Chunk;
+	BATCH_ROWS		Rows;
+	BATCH_WORKER	rgWorker[BATCH_MAX_WORKERS];
+	DWORD			cWorkers;
+	DWORD			iWorker;
+	DWORD			cRows			= 0;
+	DWORD			cRejected		= 0;
+	DWORD			dwStartMs;
+
+	memset(&Chunk, 0, sizeof(Chunk));
+
+	pFile = OpenBatchStream(pOptions->pwszInput, FALSE);
+	if (NULL == pFile)
+	{
+		return STG_E_FILENOTFOUND;
+	}
+
+	hr = ReadBatchHeader(pFile, wszHeader, rgpwszColumns, &cColumns);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	for (iKey = 0; iKey < cColumns; ++iKey)
+	{
+		if (0 == _wcsicmp(rgpwszColumns[iKey], L"EmployeeID"))
+		{
+			break;
+		}
+	}
+
+	if (iKey == cColumns)
+	{
+		fwprintf(stderr, L"import: the header has no EmployeeID column\n");
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+	hr = InitBatchChunk(&Chunk, cColumns);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	Rows.rgpwszColumns	= rgpwszColumns;
+	Rows.cColumns		= cColumns;
+	Rows.iKey			= iKey;
+	Rows.rgpwszFields	= Chunk.rgpwszField;
+
+	Chunk.cLines = 1;
+	dwStartMs = GetTickCount();
+
+	while (NOERROR == (hr = ReadBatchChunk(pFile, wszLine, &Chunk)))
+	{
+		cWorkers = SliceWork(rgWorker, pOptions->cWorkers, Chunk.cRows);
+
+		for (iWorker = 0; iWorker < cWorkers; ++iWorker)
+		{
+			rgWorker[iWorker].pOptions			= pOptions;
+			rgWorker[iWorker].pRows				= &Rows;
+			rgWorker[iWorker].cDone				= 0;
+			rgWorker[iWorker].cRejected			= 0;
+		}
+
+		hr = RunWorkers(pBackend, ImportProc, rgWorker, cWorkers);
+
+		for (iWorker = 0; iWorker < cWorkers; ++iWorker)
+		{
+			cRows		+= rgWorker[iWorker].cDone;
+			cRejected	+= rgWorker[iWorker].cRejected;
+		}
+
+		if(FAILED(hr))
+		{
+			break;
+		}
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		hr = NOERROR;
+	}
+
+	PrintBatchSummary(L"import", cRows, Chunk.cbRead, GetTickCount() - dwStartMs);
+
+	if (cRejected)
+	{
+		fwprintf(stderr, L"import: %u rows refused\n", cRejected);
+	}
+
+Exit:
+	FreeBatchChunk(&Chunk);
+	CloseBatchStream(pFile);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: WriteExportRow
+//
+// Description: PFN_BATCH_ROW of export, writing the header, then each row,
+//				as a line of text.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT CALLBACK WriteExportRow(LPVOID pvContext, LPCWSTR *rgpwszValues, DWORD cValues)
+{
+	BATCH_TEXT_OUTPUT	*pOutput = (BATCH_TEXT_OUTPUT*)pvContext;
+	DWORD				cbRow	= 0;
+	DWORD				iValue;
+
+	for (iValue = 0; iValue < cValues; ++iValue)
+	{
+		if (iValue)
+		{
+			fputwc(L'\t', pOutput->pFile);
+		}
+
+		cbRow += WriteBatchField(pOutput->pFile, rgpwszValues[iValue]);
+	}
+
+	fputwc(L'\n', pOutput->pFile);
+
+	if (pOutput->fHeader)
+	{
+		pOutput->cbBytes += cbRow;
+		++pOutput->cRows;
+	}
+
+	pOutput->fHeader = TRUE;
+
+	return ferror(pOutput->pFile) ? STG_E_WRITEFAULT : NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ExportCommand
+//
+// Description: Write every employee as text in EmployeeID order. The photo
+//				is left out.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT ExportCommand(BatchBackend *pBackend, const BATCH_OPTIONS *pOptions)
+{
+	HRESULT				hr;
+	BATCH_TEXT_OUTPUT	Output;
+	DWORD				dwStartMs		= GetTickCount();
+
+	memset(&Output, 0, sizeof(Output));
+
+	Output.pFile = OpenBatchStream(pOptions->pwszOutput, TRUE);
+	if (NULL == Output.pFile)
+	{
+		return STG_E_FILENOTFOUND;
+	}
+
+	hr = pBackend->Export(WriteExportRow, &Output);
+	if (SUCCEEDED(hr))
+	{
+		hr = ferror(Output.pFile) ? STG_E_WRITEFAULT : NOERROR;
+
+		PrintBatchSummary(L"export", Output.cRows, Output.cbBytes, GetTickCount() - dwStartMs);
+	}
+
+	CloseBatchStream(Output.pFile);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompareUpdateKeys
+//
+// Description: qsort comparison of the changes of update, in EmployeeID
+//				order, then input order.
+//
+////////////////////////////////////////////////////////////////////////////////
+static int CompareUpdateKeys(const void *pv1, const void *pv2)
+{
+	const BATCH_UPDATE_KEY *pKey1 = (const BATCH_UPDATE_KEY*)pv1;
+	const BATCH_UPDATE_KEY *pKey2 = (const BATCH_UPDATE_KEY*)pv2;
+
+	if (pKey1->dwEmployeeID != pKey2->dwEmployeeID)
+	{
+		return (pKey1->dwEmployeeID < pKey2->dwEmployeeID) ? -1 : 1;
+	}
+
+	return (pKey1->iRow < pKey2->iRow) ? -1 : (pKey1->iRow > pKey2->iRow);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: UpdateProc
+//
+// Description: Worker thread of update. Applies the changes of its slice.
+//
+////////////////////////////////////////////////////////////////////////////////
+static DWORD WINAPI UpdateProc(LPVOID lpParameter)
+{
+	BATCH_WORKER	*pWorker	= (BATCH_WORKER*)lpParameter;
+	BOOL			fCoInit		= SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+
+	pWorker->hr = pWorker->pSession->Update(pWorker->rgChanges + pWorker->iFirst,
+											pWorker->iLast - pWorker->iFirst,
+											pWorker->pOptions->cTxnRows,
+											&pWorker->cDone,
+											&pWorker->cRejected);
+
+	if (fCoInit)
+	{
+		CoUninitialize();
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: UpdateCommand
+//
+// Description: Update employees from text. The first column of the header
+//				is EmployeeID, the others are the columns updated.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT UpdateCommand(BatchBackend *pBackend, const BATCH_OPTIONS *pOptions)
+{
+	HRESULT				hr				= NOERROR;
+	FILE				*pFile			= NULL;
+	WCHAR				wszHeader[BATCH_MAX_LINE];
+	WCHAR				wszLine[BATCH_MAX_LINE];
+	LPWSTR				rgpwszColumns[BATCH_MAX_COLUMNS];
+	DWORD				cColumns		= 0;
+	BATCH_CHUNK			Chunk;
+	BatchSession		*rgpSession[BATCH_MAX_WORKERS];
+	BATCH_WORKER		rgWorker[BATCH_MAX_WORKERS];
+	BATCH_UPDATE_KEY	*rgKeys			= NULL;
+	BATCH_CHANGE		*rgChanges		= NULL;
+	LPCWSTR				pwszKey;
+	DWORD				cWorkers;
+	DWORD				iWorker;
+	DWORD				iRow;
+	DWORD				cApplied		= 0;
+	DWORD				cMissing		= 0;
+	DWORD				dwStartMs;
+
+	memset(&Chunk, 0, sizeof(Chunk));
+	memset(rgpSession, 0, sizeof(rgpSession));
+
+	pFile = OpenBatchStream(pOptions->pwszInput, FALSE);
+	if (NULL == pFile)
+	{
+		return STG_E_FILENOTFOUND;
+	}
+
+	hr = ReadBatchHeader(pFile, wszHeader, rgpwszColumns, &cColumns);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	if (cColumns < 2 || _wcsicmp(rgpwszColumns[0], L"EmployeeID"))
+	{
+		fwprintf(stderr, L"update: the header is EmployeeID, then the columns updated\n");
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+	hr = InitBatchChunk(&Chunk, cColumns);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	rgKeys		= (BATCH_UPDATE_KEY*)CoTaskMemAlloc(sizeof(BATCH_UPDATE_KEY) * BATCH_CHUNK_ROWS);
+	rgChanges	= (BATCH_CHANGE*)CoTaskMemAlloc(sizeof(BATCH_CHANGE) * BATCH_CHUNK_ROWS);
+	if (NULL == rgKeys || NULL == rgChanges)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	// Each worker updates through a session of its own, kept for the
+	// whole command with what it prepared for the columns
+	//
+	for (iWorker = 0; iWorker < pOptions->cWorkers; ++iWorker)
+	{
+		hr = pBackend->CheckOut(&rgpSession[iWorker]);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		hr = rgpSession[iWorker]->OpenUpdate(rgpwszColumns + 1, cColumns - 1);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+	}
+
+	Chunk.cLines = 1;
+	dwStartMs = GetTickCount();
+
+	while (NOERROR == (hr = ReadBatchChunk(pFile, wszLine, &Chunk)))
+	{
+		for (iRow = 0; iRow < Chunk.cRows; ++iRow)
+		{
+			pwszKey = GetChunkField(&Chunk, iRow, 0);
+			if (NULL == pwszKey)
+			{
+				fwprintf(stderr, L"update: a change has no EmployeeID\n");
+				hr = E_INVALIDARG;
+				break;
+			}
+
+			rgKeys[iRow].dwEmployeeID	= _wtoi(pwszKey);
+			rgKeys[iRow].iRow			= iRow;
+		}
+
+		if(FAILED(hr))
+		{
+			break;
+		}
+
+		// In EmployeeID order, so that each worker gets a range of keys and
+		// the changes of an employee stay in one worker, in input order
+		//
+		qsort(rgKeys, Chunk.cRows, sizeof(BATCH_UPDATE_KEY), CompareUpdateKeys);
+
+		for (iRow = 0; iRow < Chunk.cRows; ++iRow)
+		{
+			rgChanges[iRow].dwEmployeeID	= rgKeys[iRow].dwEmployeeID;
+			rgChanges[iRow].rgpwszValues	= Chunk.rgpwszField + rgKeys[iRow].iRow * cColumns + 1;
+		}
+
+		cWorkers = SliceWork(rgWorker, pOptions->cWorkers, Chunk.cRows);
+
+		for (iWorker = 0; iWorker < cWorkers; ++iWorker)
+		{
+			if (iWorker)
+			{
+				// Move the start of the slice past the changes of the
+				// employee the previous slice ends with
+				//
+				rgWorker[iWorker].iFirst = rgWorker[iWorker - 1].iLast;
+				while (rgWorker[iWorker].iFirst < Chunk.cRows &&
+					   rgChanges[rgWorker[iWorker].iFirst].dwEmployeeID == rgChanges[rgWorker[iWorker].iFirst - 1].dwEmployeeID)
+				{
+					++rgWorker[iWorker].iFirst;
+				}
+
+				rgWorker[iWorker - 1].iLast = rgWorker[iWorker].iFirst;
+
+				if (rgWorker[iWorker].iLast < rgWorker[iWorker].iFirst)
+				{
+					rgWorker[iWorker].iLast = rgWorker[iWorker].iFirst;
+				}
+			}
+
+			rgWorker[iWorker].pSession	= rgpSession[iWorker];
+			rgWorker[iWorker].pOptions	= pOptions;
+			rgWorker[iWorker].rgChanges	= rgChanges;
+			rgWorker[iWorker].cDone		= 0;
+			rgWorker[iWorker].cRejected	= 0;
+		}
+
+		hr = RunWorkers(pBackend, UpdateProc, rgWorker, cWorkers);
+
+		for (iWorker = 0; iWorker < cWorkers; ++iWorker)
+		{
+			cApplied	+= rgWorker[iWorker].cDone;
+			cMissing	+= rgWorker[iWorker].cRejected;
+		}
+
+		if(FAILED(hr))
+		{
+			break;
+		}
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		hr = NOERROR;
+	}
+
+	PrintBatchSummary(L"update", cApplied, Chunk.cbRead, GetTickCount() - dwStartMs);
+
+	if (cMissing)
+	{
+		fwprintf(stderr, L"update: %u changes of employees that don't exist\n", cMissing);
+	}
+
+Exit:
+	for (iWorker = 0; iWorker < pOptions->cWorkers; ++iWorker)
+	{
+		if (rgpSession[iWorker])
+		{
+			pBackend->CheckIn(rgpSession[iWorker], FAILED(hr));
+		}
+	}
+
+	if (rgKeys)
+	{
+		CoTaskMemFree(rgKeys);
+	}
+
+	if (rgChanges)
+	{
+		CoTaskMemFree(rgChanges);
+	}
+
+	FreeBatchChunk(&Chunk);
+	CloseBatchStream(pFile);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CollectEmployeeID
+//
+// Description: PFN_BATCH_ID adding the EmployeeIDs of a scan to a
+//				BATCH_ID_LIST.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT CALLBACK CollectEmployeeID(LPVOID pvContext, DWORD dwEmployeeID)
+{
+	BATCH_ID_LIST	*pList = (BATCH_ID_LIST*)pvContext;
+	DWORD			*rgdwEmployeeID;
+	DWORD			cMaxIDs;
+
+	if (pList->cIDs == pList->cMaxIDs)
+	{
+		cMaxIDs = pList->cMaxIDs ? 2 * pList->cMaxIDs : BATCH_CHUNK_ROWS;
+
+		rgdwEmployeeID = (DWORD*)CoTaskMemRealloc(pList->rgdwEmployeeID, sizeof(DWORD) * cMaxIDs);
+		if (NULL == rgdwEmployeeID)
+		{
+			return E_OUTOFMEMORY;
+		}
+
+		pList->rgdwEmployeeID	= rgdwEmployeeID;
+		pList->cMaxIDs			= cMaxIDs;
+	}
+
+	pList->rgdwEmployeeID[pList->cIDs++] = dwEmployeeID;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CheckSequence
+//
+// Description: PFN_BATCH_SEQUENCE counting the change log entries and those
+//				out of sequence order.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT CALLBACK CheckSequence(LPVOID pvContext, ULONG ulSequence)
+{
+	BATCH_SEQUENCE_CHECK *pCheck = (BATCH_SEQUENCE_CHECK*)pvContext;
+
+	if (pCheck->cChanges && ulSequence <= pCheck->ulLastSequence)
+	{
+		++pCheck->cOutOfOrder;
+	}
+
+	pCheck->ulLastSequence = ulSequence;
+	++pCheck->cChanges;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: VerifyProc
+//
+// Description: Worker thread of verify. Loads the employees of its slice.
+//
+////////////////////////////////////////////////////////////////////////////////
+static DWORD WINAPI VerifyProc(LPVOID lpParameter)
+{
+	BATCH_WORKER	*pWorker	= (BATCH_WORKER*)lpParameter;
+	BOOL			fCoInit		= SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+	BATCH_LOAD		Load;
+	DWORD			iEmployee;
+	HRESULT			hr;
+
+	for (iEmployee = pWorker->iFirst; iEmployee < pWorker->iLast; ++iEmployee)
+	{
+		hr = pWorker->pSession->Load(pWorker->rgdwEmployeeID[iEmployee], &Load);
+		if (NOERROR == hr)
+		{
+			++pWorker->cDone;
+			pWorker->cbBytes += Load.cbRecord;
+
+			if (!Load.fPhoto)
+			{
+				++pWorker->cNoPhoto;
+			}
+		}
+		else if (S_FALSE == hr)
+		{
+			++pWorker->cRejected;
+		}
+		else
+		{
+			++pWorker->cFailed;
+			fwprintf(stderr, L"verify: employee %u can't be loaded, error 0x%08X\n", pWorker->rgdwEmployeeID[iEmployee], hr);
+		}
+	}
+
+	if (fCoInit)
+	{
+		CoUninitialize();
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: VerifyCommand
+//
+// Description: Check that every employee has a name and can be loaded, and
+//				that the change log is in sequence order.
+//
+// Returns: NOERROR if succesfull, S_FALSE if problems were found
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT VerifyCommand(BatchBackend *pBackend, const BATCH_OPTIONS *pOptions)
+{
+	HRESULT					hr				= NOERROR;
+	BATCH_ID_LIST			List;
+	BATCH_WORKER			rgWorker[BATCH_MAX_WORKERS];
+	BATCH_SEQUENCE_CHECK	Check;
+	DWORD					cEmployees		= 0;
+	DWORD					cWorkers;
+	DWORD					iWorker;
+	DWORD					cLoaded			= 0;
+	DWORD					cGone			= 0;
+	DWORD					cFailed			= 0;
+	DWORD					cNoPhoto		= 0;
+	ULONGLONG				cbBytes			= 0;
+	DWORD					dwStartMs		= GetTickCount();
+
+	memset(&List, 0, sizeof(List));
+	memset(&Check, 0, sizeof(Check));
+
+	hr = pBackend->ScanNames(CollectEmployeeID, &List, &cEmployees);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	cWorkers = SliceWork(rgWorker, pOptions->cWorkers, List.cIDs);
+
+	for (iWorker = 0; iWorker < cWorkers; ++iWorker)
+	{
+		rgWorker[iWorker].pOptions			= pOptions;
+		rgWorker[iWorker].rgdwEmployeeID	= List.rgdwEmployeeID;
+		rgWorker[iWorker].cEmployees		= List.cIDs;
+		rgWorker[iWorker].cDone				= 0;
+		rgWorker[iWorker].cRejected			= 0;
+		rgWorker[iWorker].cFailed			= 0;
+		rgWorker[iWorker].cNoPhoto			= 0;
+		rgWorker[iWorker].cbBytes			= 0;
+	}
+
+	hr = RunWorkers(pBackend, VerifyProc, rgWorker, cWorkers);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	for (iWorker = 0; iWorker < cWorkers; ++iWorker)
+	{
+		cLoaded		+= rgWorker[iWorker].cDone;
+		cGone		+= rgWorker[iWorker].cRejected;
+		cFailed		+= rgWorker[iWorker].cFailed;
+		cNoPhoto	+= rgWorker[iWorker].cNoPhoto;
+		cbBytes		+= rgWorker[iWorker].cbBytes;
+	}
+
+	// The change log is in sequence order
+	//
+	hr = pBackend->ScanChangeLog(CheckSequence, &Check);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	PrintBatchSummary(L"verify", cLoaded, cbBytes, GetTickCount() - dwStartMs);
+
+	fwprintf(stderr,
+			 L"verify: %u employees, %u without a name, %u failed to load, %u deleted meanwhile, %u without a photo\n",
+			 cEmployees,
+			 cEmployees > List.cIDs ? cEmployees - List.cIDs : 0,
+			 cFailed,
+			 cGone,
+			 cNoPhoto);
+	fwprintf(stderr, L"verify: %u change log entries, %u out of order\n", Check.cChanges, Check.cOutOfOrder);
+
+	hr = (cEmployees > List.cIDs || cFailed || Check.cOutOfOrder) ? S_FALSE : NOERROR;
+
+Exit:
+	if (List.rgdwEmployeeID)
+	{
+		CoTaskMemFree(List.rgdwEmployeeID);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactCommand
+//
+// Description: Drop the change log entries beyond those -keep keeps, then
+//				compact the database file now.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT CompactCommand(BatchBackend *pBackend, const BATCH_OPTIONS *pOptions)
+{
+	HRESULT				hr;
+	BATCH_COMPACT_STATS	Stats;
+
+	memset(&Stats, 0, sizeof(Stats));
+
+	hr = pBackend->Compact(pOptions, &Stats);
+	if (NOERROR == hr)
+	{
+		fwprintf(stderr,
+				 L"compact: %u KB to %u KB in %u ms\n",
+				 (DWORD)(Stats.cbBefore / 1024),
+				 (DWORD)(Stats.cbAfter / 1024),
+				 Stats.dwElapsedMs);
+
+		if (Stats.ulChangesDroppedTo)
+		{
+			fwprintf(stderr, L"compact: change log entries up to %u dropped\n", Stats.ulChangesDroppedTo);
+		}
+	}
+	else if (S_FALSE == hr)
+	{
+		fwprintf(stderr, L"compact: the database is in use\n");
+		hr = HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: BenchmarkProc
+//
+// Description: Worker thread of benchmark. Loads the employees of a slice
+//				of the benchmark loads, spread over all the employees.
+//
+////////////////////////////////////////////////////////////////////////////////
+static DWORD WINAPI BenchmarkProc(LPVOID lpParameter)
+{
+	BATCH_WORKER	*pWorker	= (BATCH_WORKER*)lpParameter;
+	BOOL			fCoInit		= SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+	BATCH_LOAD		Load;
+	DWORD			iLoad;
+	DWORD			dwEmployeeID;
+
+	for (iLoad = pWorker->iFirst; SUCCEEDED(pWorker->hr) && iLoad < pWorker->iLast; ++iLoad)
+	{
+		dwEmployeeID = pWorker->rgdwEmployeeID[(DWORD)((ULONGLONG)iLoad * BATCH_LOAD_STRIDE % pWorker->cEmployees)];
+
+		pWorker->hr = pWorker->pSession->Load(dwEmployeeID, &Load);
+		if (NOERROR == pWorker->hr)
+		{
+			++pWorker->cDone;
+			pWorker->cbBytes += Load.cbRecord;
+		}
+	}
+
+	if (fCoInit)
+	{
+		CoUninitialize();
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: BenchmarkCommand
+//
+// Description: Time a scan of the employee names, then -count employee
+//				loads split between the workers, then the paths of the
+//				backend over the same employees.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT BenchmarkCommand(BatchBackend *pBackend, const BATCH_OPTIONS *pOptions)
+{
+	HRESULT				hr				= NOERROR;
+	BATCH_ID_LIST		List;
+	BATCH_WORKER		rgWorker[BATCH_MAX_WORKERS];
+	DWORD				cEmployees		= 0;
+	DWORD				cWorkers;
+	DWORD				iWorker;
+	DWORD				cLoaded			= 0;
+	ULONGLONG			cbBytes			= 0;
+	DWORD				dwStartMs;
+	DWORD				dwElapsedMs;
+
+	memset(&List, 0, sizeof(List));
+
+	dwStartMs = GetTickCount();
+
+	hr = pBackend->ScanNames(CollectEmployeeID, &List, &cEmployees);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	PrintBatchSummary(L"benchmark scan", List.cIDs, 0, GetTickCount() - dwStartMs);
+
+	if (0 == List.cIDs)
+	{
+		fwprintf(stderr, L"benchmark: no employees\n");
+		goto Exit;
+	}
+
+	cWorkers = SliceWork(rgWorker, pOptions->cWorkers, pOptions->cLoads);
+
+	for (iWorker = 0; iWorker < cWorkers; ++iWorker)
+	{
+		rgWorker[iWorker].pOptions			= pOptions;
+		rgWorker[iWorker].rgdwEmployeeID	= List.rgdwEmployeeID;
+		rgWorker[iWorker].cEmployees		= List.cIDs;
+		rgWorker[iWorker].cDone				= 0;
+		rgWorker[iWorker].cbBytes			= 0;
+	}
+
+	dwStartMs = GetTickCount();
+
+	hr = RunWorkers(pBackend, BenchmarkProc, rgWorker, cWorkers);
+
+	dwElapsedMs = GetTickCount() - dwStartMs;
+
+	for (iWorker = 0; iWorker < cWorkers; ++iWorker)
+	{
+		cLoaded	+= rgWorker[iWorker].cDone;
+		cbBytes	+= rgWorker[iWorker].cbBytes;
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		hr = NOERROR;
+	}
+
+	PrintBatchSummary(L"benchmark load", cLoaded, cbBytes, dwElapsedMs);
+
+	if (cLoaded)
+	{
+		fwprintf(stderr,
+				 L"benchmark load: %u workers, %u us per load\n",
+				 cWorkers,
+				 (DWORD)((ULONGLONG)dwElapsedMs * 1000 * cWorkers / cLoaded));
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		hr = pBackend->Benchmark(pOptions, List.rgdwEmployeeID, List.cIDs);
+	}
+
+Exit:
+	if (List.rgdwEmployeeID)
+	{
+		CoTaskMemFree(List.rgdwEmployeeID);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RunBatchCommand
+//
+// Description: Open the database in the backend, run the command of the
+//				arguments and report its result on the standard error.
+//
+// Parameters:
+//			rgpwszArgs	- The command, then its options
+//			cArgs		- Number of arguments
+//
+// Returns: BATCH_EXIT_*
+//
+////////////////////////////////////////////////////////////////////////////////
+int RunBatchCommand(LPWSTR *rgpwszArgs, DWORD cArgs)
+{
+	HRESULT				hr					= NOERROR;
+	HRESULT				hrClose;
+	BATCH_OPTIONS		Options;
+	BatchBackend		*pBackend			= NULL;
+	const BATCH_COMMAND	*pCommand			= NULL;
+	DWORD				iCommand			= 0;
+	BOOL				fCoInit;
+	int					nExit;
+
+	hr = CreateBatchBackend(&pBackend);
+	if(FAILED(hr))
+	{
+		fwprintf(stderr, L"no backend, error 0x%08X\n", hr);
+		return BATCH_EXIT_FAILED;
+	}
+
+	if (!ParseBatchOptions(rgpwszArgs, cArgs, &Options) ||
+		!FindBatchCommand(pBackend, Options.pwszCommand, &pCommand, &iCommand))
+	{
+		PrintUsage(pBackend);
+		delete pBackend;
+		return BATCH_EXIT_USAGE;
+	}
+
+	if (NULL == Options.pwszDatabase)
+	{
+		Options.pwszDatabase = pBackend->GetDefaultDatabase();
+	}
+
+	fCoInit = SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+
+	hr = pBackend->Open(&Options);
+	if (SUCCEEDED(hr))
+	{
+		hr = pCommand ? pCommand->pfnCommand(pBackend, &Options) : pBackend->RunCommand(iCommand, &Options);
+	}
+	else
+	{
+		fwprintf(stderr, L"cannot open %ls\n", Options.pwszDatabase);
+	}
+
+	hrClose = pBackend->Close();
+	if (SUCCEEDED(hr) && FAILED(hrClose))
+	{
+		hr = hrClose;
+	}
+
+	if(FAILED(hr))
+	{
+		fwprintf(stderr, L"%ls failed, error 0x%08X\n", Options.pwszCommand, hr);
+		nExit = BATCH_EXIT_FAILED;
+	}
+	else
+	{
+		nExit = (S_FALSE == hr) ? BATCH_EXIT_INVALID : BATCH_EXIT_OK;
+	}
+
+	delete pBackend;
+
+	if (fCoInit)
+	{
+		CoUninitialize();
+	}
+
+	return nExit;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RunBatchCommandLine
+//
+// Description: Run the batch command of a command line.
+//
+// Returns: BATCH_EXIT_*
+//
+////////////////////////////////////////////////////////////////////////////////
+int RunBatchCommandLine(LPCWSTR pwszCmdLine)
+{
+	WCHAR	*pwszArgs	= NULL;
+	LPWSTR	rgpwszArgs[BATCH_MAX_ARGS];
+	DWORD	cArgs;
+	int		nExit;
+
+	// The arguments are split in a copy of the command line
+	//
+	pwszArgs = (WCHAR*)CoTaskMemAlloc(sizeof(WCHAR) * (wcslen(pwszCmdLine) + 1));
+	if (NULL == pwszArgs)
+	{
+		return BATCH_EXIT_FAILED;
+	}
+
+	wcscpy(pwszArgs, pwszCmdLine);
+
+	cArgs = SplitCommandLine(pwszArgs, rgpwszArgs, BATCH_MAX_ARGS);
+
+	nExit = RunBatchCommand(rgpwszArgs, cArgs);
+
+	CoTaskMemFree(pwszArgs);
+
+	return nExit;
+}
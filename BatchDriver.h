@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: BatchDriver
+//
+// File: BatchDriver.h
+//
+// Comment: Non-interactive bulk operations selected on the command line, run
+//			against a BatchBackend.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_BATCHDRIVER_H__71D5C0B8_3E9A_4F26_8D41_B6A0E257C39F__INCLUDED_)
+#define AFX_BATCHDRIVER_H__71D5C0B8_3E9A_4F26_8D41_B6A0E257C39F__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define BATCH_MAX_ARGS				32
+#define BATCH_MAX_LINE				2048			// Characters of an input line
+#define BATCH_MAX_COLUMNS			32
+#define BATCH_MAX_VALUE				64				// Characters of a value that isn't a string column
+#define BATCH_MAX_WORKERS			8
+#define BATCH_CHUNK_ROWS			1024			// Input lines read before the workers run
+#define BATCH_FETCH_ROWS			64				// Row handles fetched per GetNextRows
+#define BATCH_TXN_ROWS				256				// Default rows per transaction of import and update
+#define BATCH_DEFAULT_LOADS			1000			// Employees loaded by benchmark
+#define BATCH_TASK_LOADS			16				// Loads of a benchmark task
+#define BATCH_MAX_WHERE				8				// Conditions of select
+#define BATCH_LOAD_STRIDE			7919			// Spreads the benchmark loads over the employees
+#define BATCH_KEEP_CHANGES			4096			// Default change log entries kept by compact
+
+// Process exit codes
+//
+#define BATCH_EXIT_OK				0
+#define BATCH_EXIT_USAGE			1				// Bad command line
+#define BATCH_EXIT_FAILED			2				// The command failed
+#define BATCH_EXIT_INVALID			3				// verify found problems
+
+////////////////////////////////////////////////////////////////////////////////
+// A parsed command line
+//
+typedef struct tagBATCH_OPTIONS
+{
+	LPCWSTR		pwszCommand;
+	LPCWSTR		pwszDatabase;
+	LPCWSTR		pwszInput;						// NULL or "-" reads the standard input
+	LPCWSTR		pwszOutput;						// NULL or "-" writes the standard output
+	DWORD		cWorkers;
+	DWORD		cTxnRows;						// Rows per transaction of import and update
+	DWORD		cLoads;							// Employees loaded by benchmark
+	BOOL		fCache;							// benchmark loads through the cache of the backend
+	BOOL		fMigrate;						// photos moves the photos kept in the rows
+	DWORD		cbJoinBudget;					// Memory of join before it spills, 0 for the default
+	DWORD		cKeepChanges;					// Change log entries compact keeps, 0 keeps them all
+	LPCWSTR		rgpwszWhere[BATCH_MAX_WHERE];	// Conditions of select
+	DWORD		cWhere;
+} BATCH_OPTIONS;
+
+////////////////////////////////////////////////////////////////////////////////
+// Text streams of the commands, shared with the backends. The text has a
+// header line of column names, then one line per row, fields separated by
+// tabs; \t, \n, \r and \\ escape those characters and \N is a NULL field.
+//
+FILE*	OpenBatchStream(LPCWSTR pwszFile, BOOL fWrite);
+void	CloseBatchStream(FILE *pFile);
+HRESULT ReadBatchLine(FILE *pFile, WCHAR *pwszLine);
+HRESULT SplitBatchLine(WCHAR *pwszLine, LPWSTR *rgpwszFields, DWORD cMaxFields, DWORD *pcFields);
+DWORD	WriteBatchField(FILE *pFile, LPCWSTR pwszValue);
+
+////////////////////////////////////////////////////////////////////////////////
+// Print the row count, time and throughput of a command to the standard
+// error
+//
+void PrintBatchSummary(LPCWSTR pwszWhat, DWORD cRows, ULONGLONG cbBytes, DWORD dwElapsedMs);
+
+////////////////////////////////////////////////////////////////////////////////
+// Run the batch command of the arguments, or of a command line, and return
+// the process exit code
+//
+int RunBatchCommand(LPWSTR *rgpwszArgs, DWORD cArgs);
+int RunBatchCommandLine(LPCWSTR pwszCmdLine);
+
+#endif // !defined(AFX_BATCHDRIVER_H__71D5C0B8_3E9A_4F26_8D41_B6A0E257C39F__INCLUDED_)
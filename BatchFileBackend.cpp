@@ -0,0 +1,1819 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: BatchFileBackend
+//
+// File: BatchFileBackend.cpp
+//
+// Comment: Stand-in batch backend keeping the employees in a text file.
+//
+// Functions:
+//			1. Read the file at open, write it back at close
+//			2. Insert and update rows in staged transactions
+//			3. Load, export and scan the rows
+//			4. Number the changes into the change log file
+//			5. Compact by rewriting the file and trimming the change log
+//
+// Notes:
+//			Linked into northwindbatch in place of BatchOleDbBackend where
+//			there is no SQL Server Compact. The rows are read whole; the
+//			file is meant for test databases.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "BatchPlatform.h"
+#include "BatchDriver.h"
+#include "BatchBackend.h"
+#include "BatchFileBackend.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CreateBatchBackend
+//
+// Description: Create the backend of the executable, the file backend.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CreateBatchBackend(BatchBackend **ppBackend)
+{
+	*ppBackend = new BatchFileBackend;
+
+	return *ppBackend ? NOERROR : E_OUTOFMEMORY;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: BatchFileSession
+//
+// Description: Constructor.
+//
+////////////////////////////////////////////////////////////////////////////////
+BatchFileSession::BatchFileSession(BatchFileBackend *pBackend)
+{
+	m_pBackend			= pBackend;
+	m_cUpdateColumns	= 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Insert
+//
+// Description: Insert rows, cTxnRows per transaction.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileSession::Insert(const BATCH_ROWS	*pRows,
+								 DWORD				iFirst,
+								 DWORD				iLast,
+								 DWORD				cTxnRows,
+								 DWORD				*pcInserted,
+								 DWORD				*pcRejected)
+{
+	return m_pBackend->InsertRows(pRows, iFirst, iLast, cTxnRows, pcInserted, pcRejected);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: OpenUpdate
+//
+// Description: Find the columns of the updates of the session.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileSession::OpenUpdate(WCHAR **rgpwszColumns, DWORD cColumns)
+{
+	HRESULT hr;
+
+	hr = m_pBackend->FindColumns(rgpwszColumns, cColumns, TRUE, m_rgiUpdateColumn);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	m_cUpdateColumns = cColumns;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Update
+//
+// Description: Apply changes to the columns of OpenUpdate, cTxnRows per
+//				transaction.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileSession::Update(const BATCH_CHANGE	*rgChanges,
+								 DWORD				cChanges,
+								 DWORD				cTxnRows,
+								 DWORD				*pcApplied,
+								 DWORD				*pcMissing)
+{
+	if (0 == m_cUpdateColumns)
+	{
+		return E_UNEXPECTED;
+	}
+
+	return m_pBackend->UpdateRows(m_rgiUpdateColumn, m_cUpdateColumns, rgChanges, cChanges, cTxnRows, pcApplied, pcMissing);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Load
+//
+// Description: Load an employee.
+//
+// Returns: NOERROR if succesfull, S_FALSE if it doesn't exist
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileSession::Load(DWORD dwEmployeeID, BATCH_LOAD *pLoad)
+{
+	return m_pBackend->LoadRow(dwEmployeeID, pLoad);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: BatchFileBackend
+//
+// Description: Constructor.
+//
+////////////////////////////////////////////////////////////////////////////////
+BatchFileBackend::BatchFileBackend()
+{
+	InitializeCriticalSection(&m_cs);
+
+	m_wszFile[0]		= L'\0';
+	m_wszLog[0]			= L'\0';
+	m_wszTemp[0]		= L'\0';
+	m_wszLogTemp[0]		= L'\0';
+	m_cColumns			= 0;
+	m_iKey				= BATCH_FILE_NO_COLUMN;
+	m_iLastName			= BATCH_FILE_NO_COLUMN;
+	m_iPhoto			= BATCH_FILE_NO_COLUMN;
+	m_rgpRow			= NULL;
+	m_cRows				= 0;
+	m_cMaxRows			= 0;
+	m_fDirty			= FALSE;
+	m_rgChange			= NULL;
+	m_cChanges			= 0;
+	m_cMaxChanges		= 0;
+	m_ulLastSequence	= 0;
+	m_cSessions			= 0;
+	m_fOpen				= FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ~BatchFileBackend
+//
+// Description: Destructor. What wasn't written by Close is lost.
+//
+////////////////////////////////////////////////////////////////////////////////
+BatchFileBackend::~BatchFileBackend()
+{
+	FreeTable();
+
+	DeleteCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetDefaultDatabase
+//
+// Description: Returns the file opened without -db.
+//
+////////////////////////////////////////////////////////////////////////////////
+LPCWSTR BatchFileBackend::GetDefaultDatabase()
+{
+	return BATCH_FILE_DATABASE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetCommands
+//
+// Description: The file backend has no commands of its own.
+//
+// Returns: 0
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD BatchFileBackend::GetCommands(const BATCH_BACKEND_COMMAND **prgCommands)
+{
+	*prgCommands = NULL;
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Open
+//
+// Description: Read the database file, if there is one, and the last
+//				sequence number of its change log.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::Open(const BATCH_OPTIONS *pOptions)
+{
+	HRESULT hr;
+
+	if (m_fOpen)
+	{
+		return E_UNEXPECTED;
+	}
+
+	if (wcslen(pOptions->pwszDatabase) + wcslen(BATCH_FILE_LOG_SUFFIX) + wcslen(BATCH_FILE_TEMP_SUFFIX) >= MAX_PATH)
+	{
+		return E_INVALIDARG;
+	}
+
+	wcscpy(m_wszFile, pOptions->pwszDatabase);
+
+	wcscpy(m_wszLog, m_wszFile);
+	wcscat(m_wszLog, BATCH_FILE_LOG_SUFFIX);
+
+	wcscpy(m_wszTemp, m_wszFile);
+	wcscat(m_wszTemp, BATCH_FILE_TEMP_SUFFIX);
+
+	wcscpy(m_wszLogTemp, m_wszLog);
+	wcscat(m_wszLogTemp, BATCH_FILE_TEMP_SUFFIX);
+
+	hr = ReadTable();
+	if (SUCCEEDED(hr))
+	{
+		hr = ReadLastSequence();
+	}
+
+	if(FAILED(hr))
+	{
+		FreeTable();
+		return hr;
+	}
+
+	m_fOpen = TRUE;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Close
+//
+// Description: Write the rows back to the file if they changed, then the
+//				new change log entries, and free them.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::Close()
+{
+	HRESULT hr = NOERROR;
+
+	if (m_fOpen)
+	{
+		if (m_fDirty)
+		{
+			hr = WriteTable();
+		}
+
+		if (SUCCEEDED(hr))
+		{
+			hr = WriteChangeLog();
+		}
+	}
+
+	FreeTable();
+
+	m_fOpen = FALSE;
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CheckOut
+//
+// Description: Returns a new session.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::CheckOut(BatchSession **ppSession)
+{
+	*ppSession = new BatchFileSession(this);
+	if (NULL == *ppSession)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	EnterCriticalSection(&m_cs);
+	++m_cSessions;
+	LeaveCriticalSection(&m_cs);
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CheckIn
+//
+// Description: Free a session. A session holds no rows, so there is nothing
+//				to discard.
+//
+////////////////////////////////////////////////////////////////////////////////
+void BatchFileBackend::CheckIn(BatchSession *pSession, BOOL /* fDiscard */)
+{
+	if (NULL == pSession)
+	{
+		return;
+	}
+
+	delete pSession;
+
+	EnterCriticalSection(&m_cs);
+	--m_cSessions;
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Export
+//
+// Description: Give the column names, then every row in EmployeeID order,
+//				to a callback. The Photo column is left out.
+//
+// Returns: NOERROR if succesfull, else the failure of the callback
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::Export(PFN_BATCH_ROW pfnRow, LPVOID pvContext)
+{
+	HRESULT	hr			= NOERROR;
+	LPCWSTR	rgpwszValues[BATCH_MAX_COLUMNS];
+	DWORD	cValues		= 0;
+	DWORD	iColumn;
+	DWORD	iRow;
+
+	EnterCriticalSection(&m_cs);
+
+	// A database without columns has nothing to export, not even a header
+	//
+	if (0 == m_cColumns)
+	{
+		goto Exit;
+	}
+
+	for (iColumn = 0; iColumn < m_cColumns; ++iColumn)
+	{
+		if (iColumn != m_iPhoto)
+		{
+			rgpwszValues[cValues++] = m_rgpwszColumns[iColumn];
+		}
+	}
+
+	hr = pfnRow(pvContext, rgpwszValues, cValues);
+
+	for (iRow = 0; SUCCEEDED(hr) && iRow < m_cRows; ++iRow)
+	{
+		cValues = 0;
+
+		for (iColumn = 0; iColumn < m_cColumns; ++iColumn)
+		{
+			if (iColumn != m_iPhoto)
+			{
+				rgpwszValues[cValues++] = m_rgpRow[iRow]->rgpwszValues[iColumn];
+			}
+		}
+
+		hr = pfnRow(pvContext, rgpwszValues, cValues);
+	}
+
+Exit:
+	LeaveCriticalSection(&m_cs);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ScanNames
+//
+// Description: Give the EmployeeID of every employee with a last name to a
+//				callback, in EmployeeID order.
+//
+// Parameters:
+//			pfnID			- Receives the EmployeeIDs
+//			pvContext		- Context of the callback
+//			pcEmployees		- Receives the number of all the employees
+//
+// Returns: NOERROR if succesfull, else the failure of the callback
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::ScanNames(PFN_BATCH_ID pfnID, LPVOID pvContext, DWORD *pcEmployees)
+{
+	HRESULT	hr		= NOERROR;
+	LPCWSTR	pwszName;
+	DWORD	iRow;
+
+	EnterCriticalSection(&m_cs);
+
+	*pcEmployees = m_cRows;
+
+	for (iRow = 0; SUCCEEDED(hr) && iRow < m_cRows && BATCH_FILE_NO_COLUMN != m_iLastName; ++iRow)
+	{
+		pwszName = m_rgpRow[iRow]->rgpwszValues[m_iLastName];
+
+		if (pwszName && pwszName[0])
+		{
+			hr = pfnID(pvContext, m_rgpRow[iRow]->dwEmployeeID);
+		}
+	}
+
+	LeaveCriticalSection(&m_cs);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ScanChangeLog
+//
+// Description: Give the sequence numbers of the change log file, then of
+//				the entries not yet written, to a callback.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::ScanChangeLog(PFN_BATCH_SEQUENCE pfnSequence, LPVOID pvContext)
+{
+	HRESULT	hr			= NOERROR;
+	FILE	*pFile;
+	WCHAR	wszLine[BATCH_MAX_LINE];
+	WCHAR	*pwszEnd;
+	ULONG	ulSequence;
+	DWORD	cLines		= 0;
+	DWORD	iChange;
+
+	EnterCriticalSection(&m_cs);
+
+	pFile = _wfopen(m_wszLog, L"r");
+	if (pFile)
+	{
+		while (NOERROR == (hr = ReadBatchLine(pFile, wszLine)))
+		{
+			++cLines;
+
+			ulSequence = wcstoul(wszLine, &pwszEnd, 10);
+			if (pwszEnd == wszLine || L'\t' != *pwszEnd)
+			{
+				fwprintf(stderr, L"%ls line %u: bad change log entry\n", m_wszLog, cLines);
+				hr = E_FAIL;
+				break;
+			}
+
+			hr = pfnSequence(pvContext, ulSequence);
+			if(FAILED(hr))
+			{
+				break;
+			}
+		}
+
+		fclose(pFile);
+
+		if (SUCCEEDED(hr))
+		{
+			hr = NOERROR;
+		}
+	}
+
+	for (iChange = 0; SUCCEEDED(hr) && iChange < m_cChanges; ++iChange)
+	{
+		hr = pfnSequence(pvContext, m_rgChange[iChange].ulSequence);
+	}
+
+	LeaveCriticalSection(&m_cs);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Compact
+//
+// Description: Rewrite the database file from the rows, which drops blank
+//				lines and the space of edits made to it by hand, and keep
+//				the newest pOptions->cKeepChanges entries of the change log.
+//
+// Returns: NOERROR if succesfull, S_FALSE if a session is checked out
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::Compact(const BATCH_OPTIONS *pOptions, BATCH_COMPACT_STATS *pStats)
+{
+	HRESULT	hr			= NOERROR;
+	DWORD	dwStartMs	= GetTickCount();
+
+	EnterCriticalSection(&m_cs);
+
+	if (m_cSessions)
+	{
+		hr = S_FALSE;
+		goto Exit;
+	}
+
+	pStats->cbBefore = GetFileSize(m_wszFile);
+
+	hr = WriteTable();
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	if (pOptions->cKeepChanges)
+	{
+		hr = WriteChangeLog();
+		if (SUCCEEDED(hr))
+		{
+			hr = TrimChangeLog(pOptions->cKeepChanges, &pStats->ulChangesDroppedTo);
+		}
+
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+	}
+
+	pStats->cbAfter		= GetFileSize(m_wszFile);
+	pStats->dwElapsedMs	= GetTickCount() - dwStartMs;
+
+Exit:
+	LeaveCriticalSection(&m_cs);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Benchmark
+//
+// Description: The file backend has no paths beyond the loads of the
+//				driver.
+//
+// Returns: NOERROR
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::Benchmark(const BATCH_OPTIONS *pOptions, const DWORD * /* rgdwEmployeeID */, DWORD /* cEmployees */)
+{
+	if (pOptions->fCache)
+	{
+		fwprintf(stderr, L"benchmark: the file backend has no cache, -cache is ignored\n");
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RunCommand
+//
+// Description: The file backend has no commands of its own.
+//
+// Returns: E_NOTIMPL
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::RunCommand(DWORD /* iCommand */, const BATCH_OPTIONS * /* pOptions */)
+{
+	return E_NOTIMPL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: InsertRows
+//
+// Description: Insert rows, cTxnRows per transaction. The rows of a
+//				transaction are made first, then merged into the table at
+//				once. Rows without a valid EmployeeID, or with one that is
+//				already taken, are refused. The first import into a new file
+//				sets its columns.
+//
+// Parameters:
+//			pRows		- Rows and their columns
+//			iFirst		- First row to insert
+//			iLast		- Past the last row to insert
+//			cTxnRows	- Rows per transaction
+//			pcInserted	- Incremented by the rows inserted
+//			pcRejected	- Incremented by the rows refused
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::InsertRows(const BATCH_ROWS	*pRows,
+									 DWORD				iFirst,
+									 DWORD				iLast,
+									 DWORD				cTxnRows,
+									 DWORD				*pcInserted,
+									 DWORD				*pcRejected)
+{
+	HRESULT			hr				= NOERROR;
+	DWORD			rgiTable[BATCH_MAX_COLUMNS];		// Table column of each input column
+	DWORD			rgiInput[BATCH_MAX_COLUMNS];		// Input column of each table column
+	LPCWSTR			rgpwszValues[BATCH_MAX_COLUMNS];
+	const LPCWSTR	*rgpwszFields;
+	BATCH_FILE_ROW	**rgpStaged		= NULL;
+	DWORD			cStaged			= 0;
+	DWORD			cKept;
+	DWORD			dwEmployeeID;
+	DWORD			iColumn;
+	DWORD			iRow;
+	DWORD			iStaged;
+
+	if (iFirst == iLast)
+	{
+		return NOERROR;
+	}
+
+	EnterCriticalSection(&m_cs);
+
+	if (0 == m_cColumns)
+	{
+		hr = SetColumns(pRows->rgpwszColumns, pRows->cColumns);
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		hr = FindColumns(pRows->rgpwszColumns, pRows->cColumns, FALSE, rgiTable);
+	}
+
+	LeaveCriticalSection(&m_cs);
+
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	for (iColumn = 0; iColumn < m_cColumns; ++iColumn)
+	{
+		rgiInput[iColumn] = BATCH_FILE_NO_COLUMN;
+	}
+
+	for (iColumn = 0; iColumn < pRows->cColumns; ++iColumn)
+	{
+		rgiInput[rgiTable[iColumn]] = iColumn;
+	}
+
+	if (cTxnRows > iLast - iFirst)
+	{
+		cTxnRows = iLast - iFirst;
+	}
+
+	rgpStaged = (BATCH_FILE_ROW**)CoTaskMemAlloc(sizeof(BATCH_FILE_ROW*) * cTxnRows);
+	if (NULL == rgpStaged)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	for (iRow = iFirst; iRow < iLast; )
+	{
+		// Make the rows of the transaction
+		//
+		for (cStaged = 0; iRow < iLast && cStaged < cTxnRows; ++iRow)
+		{
+			rgpwszFields = pRows->rgpwszFields + iRow * pRows->cColumns;
+
+			if (!ParseEmployeeID(rgpwszFields[pRows->iKey], &dwEmployeeID))
+			{
+				++*pcRejected;
+				continue;
+			}
+
+			for (iColumn = 0; iColumn < m_cColumns; ++iColumn)
+			{
+				rgpwszValues[iColumn] = (BATCH_FILE_NO_COLUMN == rgiInput[iColumn]) ? NULL : rgpwszFields[rgiInput[iColumn]];
+			}
+
+			rgpStaged[cStaged] = NewRow(dwEmployeeID, rgpwszValues);
+			if (NULL == rgpStaged[cStaged])
+			{
+				hr = E_OUTOFMEMORY;
+				goto Exit;
+			}
+
+			++cStaged;
+		}
+
+		// One row of an EmployeeID given twice in the transaction stays
+		//
+		qsort(rgpStaged, cStaged, sizeof(BATCH_FILE_ROW*), CompareRows);
+
+		for (iStaged = 0, cKept = 0; iStaged < cStaged; ++iStaged)
+		{
+			if (cKept && rgpStaged[cKept - 1]->dwEmployeeID == rgpStaged[iStaged]->dwEmployeeID)
+			{
+				CoTaskMemFree(rgpStaged[iStaged]);
+				++*pcRejected;
+				continue;
+			}
+
+			rgpStaged[cKept++] = rgpStaged[iStaged];
+		}
+
+		cStaged = cKept;
+
+		// Commit
+		//
+		EnterCriticalSection(&m_cs);
+		hr = MergeRows(rgpStaged, cStaged, pcInserted, pcRejected);
+		LeaveCriticalSection(&m_cs);
+
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		cStaged = 0;
+	}
+
+Exit:
+	for (iStaged = 0; iStaged < cStaged; ++iStaged)
+	{
+		CoTaskMemFree(rgpStaged[iStaged]);
+	}
+
+	CoTaskMemFree(rgpStaged);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FindColumns
+//
+// Description: Find the table column of each of a list of names.
+//
+// Parameters:
+//			rgpwszColumns	- Column names
+//			cColumns		- Number of names
+//			fUpdate			- TRUE if the columns are updated, which the key
+//							  can't be
+//			rgiColumn		- Receives the table column of each name
+//
+// Returns: NOERROR if succesfull, E_INVALIDARG if a name isn't a column or
+//			is given twice
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::FindColumns(WCHAR **rgpwszColumns, DWORD cColumns, BOOL fUpdate, DWORD *rgiColumn)
+{
+	HRESULT	hr		= NOERROR;
+	DWORD	iColumn;
+	DWORD	iOther;
+
+	if (cColumns > BATCH_MAX_COLUMNS)
+	{
+		return E_INVALIDARG;
+	}
+
+	EnterCriticalSection(&m_cs);
+
+	for (iColumn = 0; iColumn < cColumns; ++iColumn)
+	{
+		rgiColumn[iColumn] = FindColumn(rgpwszColumns[iColumn]);
+		if (BATCH_FILE_NO_COLUMN == rgiColumn[iColumn])
+		{
+			fwprintf(stderr, L"no column %ls\n", rgpwszColumns[iColumn]);
+			hr = E_INVALIDARG;
+			break;
+		}
+
+		if (fUpdate && m_iKey == rgiColumn[iColumn])
+		{
+			fwprintf(stderr, L"column %ls is the key\n", rgpwszColumns[iColumn]);
+			hr = E_INVALIDARG;
+			break;
+		}
+
+		for (iOther = 0; iOther < iColumn; ++iOther)
+		{
+			if (rgiColumn[iOther] == rgiColumn[iColumn])
+			{
+				fwprintf(stderr, L"column %ls is given twice\n", rgpwszColumns[iColumn]);
+				hr = E_INVALIDARG;
+				break;
+			}
+		}
+
+		if(FAILED(hr))
+		{
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&m_cs);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: UpdateRows
+//
+// Description: Apply changes, cTxnRows per transaction. The changes of a
+//				transaction replace their rows one by one, while the
+//				critical section is held, and the rows replaced are kept
+//				until the transaction is done, to be put back if it fails.
+//
+// Parameters:
+//			rgiColumn	- Table column of each value of a change
+//			cColumns	- Values of a change
+//			rgChanges	- The changes
+//			cChanges	- Number of changes
+//			cTxnRows	- Changes per transaction
+//			pcApplied	- Incremented by the changes applied
+//			pcMissing	- Incremented by the changes of employees that
+//						  don't exist
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::UpdateRows(const DWORD			*rgiColumn,
+									 DWORD					cColumns,
+									 const BATCH_CHANGE		*rgChanges,
+									 DWORD					cChanges,
+									 DWORD					cTxnRows,
+									 DWORD					*pcApplied,
+									 DWORD					*pcMissing)
+{
+	HRESULT			hr				= NOERROR;
+	LPCWSTR			rgpwszValues[BATCH_MAX_COLUMNS];
+	DWORD			*rgiRow			= NULL;
+	BATCH_FILE_ROW	**rgpOld		= NULL;
+	BATCH_FILE_ROW	*pNew;
+	DWORD			cStaged;
+	DWORD			cMissing;
+	DWORD			iChange			= 0;
+	DWORD			iTxnEnd;
+	DWORD			iRow;
+	DWORD			iColumn;
+	DWORD			iStaged;
+	BOOL			fFound;
+
+	if (0 == cChanges)
+	{
+		return NOERROR;
+	}
+
+	if (cTxnRows > cChanges)
+	{
+		cTxnRows = cChanges;
+	}
+
+	rgiRow = (DWORD*)CoTaskMemAlloc(sizeof(DWORD) * cTxnRows);
+	rgpOld = (BATCH_FILE_ROW**)CoTaskMemAlloc(sizeof(BATCH_FILE_ROW*) * cTxnRows);
+	if (NULL == rgiRow || NULL == rgpOld)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	while (iChange < cChanges)
+	{
+		iTxnEnd		= (cChanges - iChange > cTxnRows) ? iChange + cTxnRows : cChanges;
+		cStaged		= 0;
+		cMissing	= 0;
+
+		EnterCriticalSection(&m_cs);
+
+		hr = ReserveChanges(m_cChanges + (iTxnEnd - iChange));
+
+		for (; SUCCEEDED(hr) && iChange < iTxnEnd; ++iChange)
+		{
+			iRow = FindRow(rgChanges[iChange].dwEmployeeID, &fFound);
+			if (!fFound)
+			{
+				++cMissing;
+				continue;
+			}
+
+			memcpy(rgpwszValues, m_rgpRow[iRow]->rgpwszValues, sizeof(LPCWSTR) * m_cColumns);
+
+			for (iColumn = 0; iColumn < cColumns; ++iColumn)
+			{
+				rgpwszValues[rgiColumn[iColumn]] = rgChanges[iChange].rgpwszValues[iColumn];
+			}
+
+			pNew = NewRow(rgChanges[iChange].dwEmployeeID, rgpwszValues);
+			if (NULL == pNew)
+			{
+				hr = E_OUTOFMEMORY;
+				break;
+			}
+
+			rgiRow[cStaged]		= iRow;
+			rgpOld[cStaged++]	= m_rgpRow[iRow];
+			m_rgpRow[iRow]		= pNew;
+		}
+
+		if(FAILED(hr))
+		{
+			// Abort, newest first so that an employee changed twice gets
+			// its first row back
+			//
+			for (iStaged = cStaged; iStaged > 0; --iStaged)
+			{
+				CoTaskMemFree(m_rgpRow[rgiRow[iStaged - 1]]);
+				m_rgpRow[rgiRow[iStaged - 1]] = rgpOld[iStaged - 1];
+			}
+		}
+		else
+		{
+			for (iStaged = 0; iStaged < cStaged; ++iStaged)
+			{
+				CoTaskMemFree(rgpOld[iStaged]);
+				LogChange(m_rgpRow[rgiRow[iStaged]]->dwEmployeeID, BATCH_FILE_OP_UPDATE);
+			}
+
+			if (cStaged)
+			{
+				m_fDirty = TRUE;
+			}
+
+			*pcApplied += cStaged;
+			*pcMissing += cMissing;
+		}
+
+		LeaveCriticalSection(&m_cs);
+
+		if(FAILED(hr))
+		{
+			break;
+		}
+	}
+
+Exit:
+	if (rgiRow)
+	{
+		CoTaskMemFree(rgiRow);
+	}
+
+	if (rgpOld)
+	{
+		CoTaskMemFree(rgpOld);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: LoadRow
+//
+// Description: Measure an employee as a load would read it.
+//
+// Returns: NOERROR if succesfull, S_FALSE if it doesn't exist
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::LoadRow(DWORD dwEmployeeID, BATCH_LOAD *pLoad)
+{
+	HRESULT			hr		= NOERROR;
+	BATCH_FILE_ROW	*pRow;
+	DWORD			iRow;
+	DWORD			iColumn;
+	BOOL			fFound;
+
+	EnterCriticalSection(&m_cs);
+
+	iRow = FindRow(dwEmployeeID, &fFound);
+	if (!fFound)
+	{
+		hr = S_FALSE;
+		goto Exit;
+	}
+
+	pRow = m_rgpRow[iRow];
+
+	pLoad->cbRecord	= 0;
+	pLoad->fPhoto	= BATCH_FILE_NO_COLUMN != m_iPhoto && NULL != pRow->rgpwszValues[m_iPhoto];
+
+	for (iColumn = 0; iColumn < m_cColumns; ++iColumn)
+	{
+		if (pRow->rgpwszValues[iColumn])
+		{
+			pLoad->cbRecord += sizeof(WCHAR) * wcslen(pRow->rgpwszValues[iColumn]);
+		}
+	}
+
+Exit:
+	LeaveCriticalSection(&m_cs);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ReadTable
+//
+// Description: Read the rows of the database file. A file that doesn't
+//				exist, or is empty, is a database without columns.
+//
+// Returns: NOERROR if succesfull, E_FAIL if the file is wrong
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::ReadTable()
+{
+	HRESULT			hr			= NOERROR;
+	FILE			*pFile;
+	WCHAR			wszLine[BATCH_MAX_LINE];
+	LPWSTR			rgpwszFields[BATCH_MAX_COLUMNS];
+	DWORD			cFields;
+	DWORD			cLines		= 1;
+	DWORD			dwEmployeeID;
+	BATCH_FILE_ROW	*pRow;
+	DWORD			iRow;
+
+	pFile = _wfopen(m_wszFile, L"r");
+	if (NULL == pFile)
+	{
+		return NOERROR;
+	}
+
+	hr = ReadBatchLine(pFile, wszLine);
+	if (S_FALSE == hr)
+	{
+		hr = NOERROR;
+		goto Exit;
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		hr = SplitBatchLine(wszLine, rgpwszFields, BATCH_MAX_COLUMNS, &cFields);
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		hr = SetColumns(rgpwszFields, cFields);
+	}
+
+	if(FAILED(hr))
+	{
+		fwprintf(stderr, L"%ls line 1: a header of column names with EmployeeID is expected\n", m_wszFile);
+		goto Exit;
+	}
+
+	while (NOERROR == (hr = ReadBatchLine(pFile, wszLine)))
+	{
+		++cLines;
+
+		if (L'\0' == wszLine[0])
+		{
+			continue;
+		}
+
+		hr = SplitBatchLine(wszLine, rgpwszFields, BATCH_MAX_COLUMNS, &cFields);
+		if (SUCCEEDED(hr) && cFields != m_cColumns)
+		{
+			hr = E_INVALIDARG;
+		}
+
+		if (SUCCEEDED(hr) && !ParseEmployeeID(rgpwszFields[m_iKey], &dwEmployeeID))
+		{
+			hr = E_INVALIDARG;
+		}
+
+		if(FAILED(hr))
+		{
+			fwprintf(stderr, L"%ls line %u: bad row\n", m_wszFile, cLines);
+			goto Exit;
+		}
+
+		hr = ReserveRows(m_cRows + 1);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		pRow = NewRow(dwEmployeeID, (const LPCWSTR*)rgpwszFields);
+		if (NULL == pRow)
+		{
+			hr = E_OUTOFMEMORY;
+			goto Exit;
+		}
+
+		m_rgpRow[m_cRows++] = pRow;
+	}
+
+	if(FAILED(hr))
+	{
+		fwprintf(stderr, L"%ls line %u: cannot be read\n", m_wszFile, cLines + 1);
+		goto Exit;
+	}
+
+	// The file is in EmployeeID order when written here, not necessarily
+	// when edited by hand
+	//
+	qsort(m_rgpRow, m_cRows, sizeof(BATCH_FILE_ROW*), CompareRows);
+
+	for (iRow = 1; iRow < m_cRows; ++iRow)
+	{
+		if (m_rgpRow[iRow - 1]->dwEmployeeID == m_rgpRow[iRow]->dwEmployeeID)
+		{
+			fwprintf(stderr, L"%ls: EmployeeID %u is given twice\n", m_wszFile, m_rgpRow[iRow]->dwEmployeeID);
+			hr = E_FAIL;
+			goto Exit;
+		}
+	}
+
+	hr = NOERROR;
+
+Exit:
+	fclose(pFile);
+
+	return FAILED(hr) ? E_FAIL : hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: WriteTable
+//
+// Description: Write the rows to a new file, then put it in the place of
+//				the database file, so that a failed write loses nothing.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::WriteTable()
+{
+	HRESULT	hr;
+	FILE	*pFile;
+	DWORD	iColumn;
+	DWORD	iRow;
+	BOOL	fFailed;
+
+	if (0 == m_cColumns)
+	{
+		return NOERROR;
+	}
+
+	pFile = _wfopen(m_wszTemp, L"w");
+	if (NULL == pFile)
+	{
+		fwprintf(stderr, L"cannot write %ls\n", m_wszTemp);
+		return STG_E_WRITEFAULT;
+	}
+
+	for (iColumn = 0; iColumn < m_cColumns; ++iColumn)
+	{
+		if (iColumn)
+		{
+			fputwc(L'\t', pFile);
+		}
+
+		WriteBatchField(pFile, m_rgpwszColumns[iColumn]);
+	}
+
+	fputwc(L'\n', pFile);
+
+	for (iRow = 0; iRow < m_cRows; ++iRow)
+	{
+		for (iColumn = 0; iColumn < m_cColumns; ++iColumn)
+		{
+			if (iColumn)
+			{
+				fputwc(L'\t', pFile);
+			}
+
+			WriteBatchField(pFile, m_rgpRow[iRow]->rgpwszValues[iColumn]);
+		}
+
+		fputwc(L'\n', pFile);
+	}
+
+	fFailed = ferror(pFile);
+
+	if (0 != fclose(pFile) || fFailed)
+	{
+		fwprintf(stderr, L"cannot write %ls\n", m_wszTemp);
+		return STG_E_WRITEFAULT;
+	}
+
+	hr = ReplaceBatchFile(m_wszTemp, m_wszFile);
+	if(FAILED(hr))
+	{
+		fwprintf(stderr, L"cannot replace %ls\n", m_wszFile);
+		return hr;
+	}
+
+	m_fDirty = FALSE;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ReadLastSequence
+//
+// Description: Find the highest sequence number of the change log file,
+//				where the numbering goes on.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::ReadLastSequence()
+{
+	HRESULT	hr;
+	FILE	*pFile;
+	WCHAR	wszLine[BATCH_MAX_LINE];
+	ULONG	ulSequence;
+
+	pFile = _wfopen(m_wszLog, L"r");
+	if (NULL == pFile)
+	{
+		return NOERROR;
+	}
+
+	while (NOERROR == (hr = ReadBatchLine(pFile, wszLine)))
+	{
+		ulSequence = wcstoul(wszLine, NULL, 10);
+
+		if (ulSequence > m_ulLastSequence)
+		{
+			m_ulLastSequence = ulSequence;
+		}
+	}
+
+	fclose(pFile);
+
+	return SUCCEEDED(hr) ? NOERROR : hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: WriteChangeLog
+//
+// Description: Append the change log entries not yet written to the log
+//				file, a line of sequence number, EmployeeID and operation
+//				each.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::WriteChangeLog()
+{
+	FILE	*pFile;
+	DWORD	iChange;
+	BOOL	fFailed;
+
+	if (0 == m_cChanges)
+	{
+		return NOERROR;
+	}
+
+	pFile = _wfopen(m_wszLog, L"a");
+	if (NULL == pFile)
+	{
+		fwprintf(stderr, L"cannot write %ls\n", m_wszLog);
+		return STG_E_WRITEFAULT;
+	}
+
+	for (iChange = 0; iChange < m_cChanges; ++iChange)
+	{
+		fwprintf(pFile,
+				 L"%u\t%u\t%ls\n",
+				 m_rgChange[iChange].ulSequence,
+				 m_rgChange[iChange].dwEmployeeID,
+				 BATCH_FILE_OP_INSERT == m_rgChange[iChange].dwOp ? L"insert" : L"update");
+	}
+
+	fFailed = ferror(pFile);
+
+	if (0 != fclose(pFile) || fFailed)
+	{
+		fwprintf(stderr, L"cannot write %ls\n", m_wszLog);
+		return STG_E_WRITEFAULT;
+	}
+
+	m_cChanges = 0;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TrimChangeLog
+//
+// Description: Rewrite the change log file with its newest cKeep entries.
+//				The newest entry is always kept, so ReadLastSequence still
+//				finds where the numbering goes on.
+//
+// Parameters:
+//			cKeep			- Entries kept, at least 1
+//			pulDroppedTo	- Receives the sequence of the newest entry
+//							  dropped, 0 if none
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::TrimChangeLog(DWORD cKeep, ULONG *pulDroppedTo)
+{
+	HRESULT	hr			= NOERROR;
+	FILE	*pIn		= NULL;
+	FILE	*pOut		= NULL;
+	WCHAR	wszLine[BATCH_MAX_LINE];
+	DWORD	cLines		= 0;
+	DWORD	iLine		= 0;
+	BOOL	fFailed;
+
+	*pulDroppedTo = 0;
+
+	pIn = _wfopen(m_wszLog, L"r");
+	if (NULL == pIn)
+	{
+		goto Exit;
+	}
+
+	while (NOERROR == (hr = ReadBatchLine(pIn, wszLine)))
+	{
+		++cLines;
+	}
+
+	if (FAILED(hr) || cLines <= cKeep)
+	{
+		goto Exit;
+	}
+
+	rewind(pIn);
+
+	pOut = _wfopen(m_wszLogTemp, L"w");
+	if (NULL == pOut)
+	{
+		fwprintf(stderr, L"cannot write %ls\n", m_wszLogTemp);
+		hr = STG_E_WRITEFAULT;
+		goto Exit;
+	}
+
+	while (NOERROR == (hr = ReadBatchLine(pIn, wszLine)))
+	{
+		if (iLine++ < cLines - cKeep)
+		{
+			*pulDroppedTo = wcstoul(wszLine, NULL, 10);
+			continue;
+		}
+
+		fwprintf(pOut, L"%ls\n", wszLine);
+	}
+
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	fFailed = ferror(pOut);
+	fFailed = (0 != fclose(pOut)) || fFailed;
+	pOut	= NULL;
+
+	if (fFailed)
+	{
+		fwprintf(stderr, L"cannot write %ls\n", m_wszLogTemp);
+		hr = STG_E_WRITEFAULT;
+		goto Exit;
+	}
+
+	fclose(pIn);
+	pIn = NULL;
+
+	hr = ReplaceBatchFile(m_wszLogTemp, m_wszLog);
+	if(FAILED(hr))
+	{
+		fwprintf(stderr, L"cannot replace %ls\n", m_wszLog);
+	}
+
+Exit:
+	if (pOut)
+	{
+		fclose(pOut);
+	}
+
+	if (pIn)
+	{
+		fclose(pIn);
+	}
+
+	if (FAILED(hr))
+	{
+		*pulDroppedTo = 0;
+		return hr;
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SetColumns
+//
+// Description: Set the columns of the table, copied into the header
+//				buffer.
+//
+// Returns: NOERROR if succesfull, E_INVALIDARG if there is no EmployeeID
+//			column, or a name is empty or given twice
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::SetColumns(WCHAR **rgpwszColumns, DWORD cColumns)
+{
+	DWORD	cchColumns	= 0;
+	DWORD	cchName;
+	DWORD	iColumn;
+
+	m_cColumns = 0;
+
+	for (iColumn = 0; iColumn < cColumns; ++iColumn)
+	{
+		if (NULL == rgpwszColumns[iColumn] || L'\0' == rgpwszColumns[iColumn][0] ||
+			BATCH_FILE_NO_COLUMN != FindColumn(rgpwszColumns[iColumn]))
+		{
+			return E_INVALIDARG;
+		}
+
+		cchName = wcslen(rgpwszColumns[iColumn]) + 1;
+		if (cchColumns + cchName > BATCH_MAX_LINE)
+		{
+			return E_INVALIDARG;
+		}
+
+		m_rgpwszColumns[iColumn] = m_wszColumns + cchColumns;
+		memcpy(m_rgpwszColumns[iColumn], rgpwszColumns[iColumn], sizeof(WCHAR) * cchName);
+
+		cchColumns += cchName;
+		m_cColumns = iColumn + 1;
+	}
+
+	m_iKey		= FindColumn(L"EmployeeID");
+	m_iLastName	= FindColumn(L"LastName");
+	m_iPhoto	= FindColumn(L"Photo");
+
+	if (BATCH_FILE_NO_COLUMN == m_iKey)
+	{
+		m_cColumns = 0;
+		return E_INVALIDARG;
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FindColumn
+//
+// Description: Returns the table column of a name, BATCH_FILE_NO_COLUMN if
+//				there is none.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD BatchFileBackend::FindColumn(LPCWSTR pwszColumn)
+{
+	DWORD iColumn;
+
+	for (iColumn = 0; iColumn < m_cColumns; ++iColumn)
+	{
+		if (0 == _wcsicmp(m_rgpwszColumns[iColumn], pwszColumn))
+		{
+			return iColumn;
+		}
+	}
+
+	return BATCH_FILE_NO_COLUMN;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: NewRow
+//
+// Description: Allocate a row and copy its values into it.
+//
+// Returns: The row, NULL if out of memory
+//
+////////////////////////////////////////////////////////////////////////////////
+BATCH_FILE_ROW* BatchFileBackend::NewRow(DWORD dwEmployeeID, const LPCWSTR *rgpwszValues)
+{
+	BATCH_FILE_ROW	*pRow;
+	WCHAR			*pwch;
+	DWORD			cchValues	= 0;
+	DWORD			cchValue;
+	DWORD			iColumn;
+
+	for (iColumn = 0; iColumn < m_cColumns; ++iColumn)
+	{
+		if (rgpwszValues[iColumn])
+		{
+			cchValues += wcslen(rgpwszValues[iColumn]) + 1;
+		}
+	}
+
+	pRow = (BATCH_FILE_ROW*)CoTaskMemAlloc(sizeof(BATCH_FILE_ROW) + sizeof(LPCWSTR) * m_cColumns + sizeof(WCHAR) * cchValues);
+	if (NULL == pRow)
+	{
+		return NULL;
+	}
+
+	pRow->dwEmployeeID	= dwEmployeeID;
+	pRow->rgpwszValues	= (LPCWSTR*)(pRow + 1);
+
+	pwch = (WCHAR*)(pRow->rgpwszValues + m_cColumns);
+
+	for (iColumn = 0; iColumn < m_cColumns; ++iColumn)
+	{
+		if (NULL == rgpwszValues[iColumn])
+		{
+			pRow->rgpwszValues[iColumn] = NULL;
+			continue;
+		}
+
+		cchValue = wcslen(rgpwszValues[iColumn]) + 1;
+
+		memcpy(pwch, rgpwszValues[iColumn], sizeof(WCHAR) * cchValue);
+		pRow->rgpwszValues[iColumn] = pwch;
+		pwch += cchValue;
+	}
+
+	return pRow;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FindRow
+//
+// Description: Binary search of the rows for an EmployeeID.
+//
+// Returns: The index of the row, or where it would be inserted if not found
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD BatchFileBackend::FindRow(DWORD dwEmployeeID, BOOL *pfFound)
+{
+	DWORD iLow	= 0;
+	DWORD iHigh	= m_cRows;
+	DWORD iMid;
+
+	while (iLow < iHigh)
+	{
+		iMid = iLow + (iHigh - iLow) / 2;
+
+		if (m_rgpRow[iMid]->dwEmployeeID < dwEmployeeID)
+		{
+			iLow = iMid + 1;
+		}
+		else
+		{
+			iHigh = iMid;
+		}
+	}
+
+	*pfFound = iLow < m_cRows && m_rgpRow[iLow]->dwEmployeeID == dwEmployeeID;
+
+	return iLow;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeRows
+//
+// Description: Merge the rows of a transaction, in EmployeeID order, into
+//				the table. Rows of an EmployeeID already taken are freed and
+//				refused. Called with the critical section held.
+//
+// Returns: NOERROR if succesfull; if it fails, the rows are left to the
+//			caller and the table is unchanged
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::MergeRows(BATCH_FILE_ROW **rgpRow, DWORD cRows, DWORD *pcInserted, DWORD *pcRejected)
+{
+	HRESULT	hr;
+	DWORD	cKept	= 0;
+	DWORD	iTable;
+	DWORD	iNew;
+	DWORD	iOut;
+	BOOL	fFound;
+
+	hr = ReserveRows(m_cRows + cRows);
+	if (SUCCEEDED(hr))
+	{
+		hr = ReserveChanges(m_cChanges + cRows);
+	}
+
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	for (iNew = 0; iNew < cRows; ++iNew)
+	{
+		FindRow(rgpRow[iNew]->dwEmployeeID, &fFound);
+		if (fFound)
+		{
+			CoTaskMemFree(rgpRow[iNew]);
+			++*pcRejected;
+			continue;
+		}
+
+		rgpRow[cKept++] = rgpRow[iNew];
+	}
+
+	// Merge from the end, in place
+	//
+	iTable	= m_cRows;
+	iNew	= cKept;
+	iOut	= m_cRows + cKept;
+
+	while (iNew)
+	{
+		if (iTable && m_rgpRow[iTable - 1]->dwEmployeeID > rgpRow[iNew - 1]->dwEmployeeID)
+		{
+			m_rgpRow[--iOut] = m_rgpRow[--iTable];
+		}
+		else
+		{
+			m_rgpRow[--iOut] = rgpRow[--iNew];
+		}
+	}
+
+	m_cRows += cKept;
+
+	for (iNew = 0; iNew < cKept; ++iNew)
+	{
+		LogChange(rgpRow[iNew]->dwEmployeeID, BATCH_FILE_OP_INSERT);
+	}
+
+	if (cKept)
+	{
+		m_fDirty = TRUE;
+	}
+
+	*pcInserted += cKept;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ReserveRows
+//
+// Description: Grow the row array, by doubling, to hold cRows rows.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::ReserveRows(DWORD cRows)
+{
+	BATCH_FILE_ROW	**rgpRow;
+	DWORD			cMaxRows;
+
+	if (cRows <= m_cMaxRows)
+	{
+		return NOERROR;
+	}
+
+	cMaxRows = m_cMaxRows ? m_cMaxRows : BATCH_CHUNK_ROWS;
+	while (cMaxRows < cRows)
+	{
+		cMaxRows *= 2;
+	}
+
+	rgpRow = (BATCH_FILE_ROW**)CoTaskMemRealloc(m_rgpRow, sizeof(BATCH_FILE_ROW*) * cMaxRows);
+	if (NULL == rgpRow)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	m_rgpRow	= rgpRow;
+	m_cMaxRows	= cMaxRows;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ReserveChanges
+//
+// Description: Grow the change log entries, by doubling, to hold cChanges
+//				entries, so that LogChange can't fail.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BatchFileBackend::ReserveChanges(DWORD cChanges)
+{
+	BATCH_FILE_CHANGE	*rgChange;
+	DWORD				cMaxChanges;
+
+	if (cChanges <= m_cMaxChanges)
+	{
+		return NOERROR;
+	}
+
+	cMaxChanges = m_cMaxChanges ? m_cMaxChanges : BATCH_CHUNK_ROWS;
+	while (cMaxChanges < cChanges)
+	{
+		cMaxChanges *= 2;
+	}
+
+	rgChange = (BATCH_FILE_CHANGE*)CoTaskMemRealloc(m_rgChange, sizeof(BATCH_FILE_CHANGE) * cMaxChanges);
+	if (NULL == rgChange)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	m_rgChange		= rgChange;
+	m_cMaxChanges	= cMaxChanges;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: LogChange
+//
+// Description: Number a change into the change log. Room for it is
+//				reserved by ReserveChanges.
+//
+////////////////////////////////////////////////////////////////////////////////
+void BatchFileBackend::LogChange(DWORD dwEmployeeID, DWORD dwOp)
+{
+	BATCH_FILE_CHANGE *pChange = &m_rgChange[m_cChanges++];
+
+	pChange->ulSequence		= ++m_ulLastSequence;
+	pChange->dwEmployeeID	= dwEmployeeID;
+	pChange->dwOp			= dwOp;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FreeTable
+//
+// Description: Free the rows, the columns and the change log entries.
+//
+////////////////////////////////////////////////////////////////////////////////
+void BatchFileBackend::FreeTable()
+{
+	DWORD iRow;
+
+	for (iRow = 0; iRow < m_cRows; ++iRow)
+	{
+		CoTaskMemFree(m_rgpRow[iRow]);
+	}
+
+	if (m_rgpRow)
+	{
+		CoTaskMemFree(m_rgpRow);
+	}
+
+	if (m_rgChange)
+	{
+		CoTaskMemFree(m_rgChange);
+	}
+
+	m_rgpRow			= NULL;
+	m_cRows				= 0;
+	m_cMaxRows			= 0;
+	m_rgChange			= NULL;
+	m_cChanges			= 0;
+	m_cMaxChanges		= 0;
+	m_ulLastSequence	= 0;
+	m_cColumns			= 0;
+	m_iKey				= BATCH_FILE_NO_COLUMN;
+	m_iLastName			= BATCH_FILE_NO_COLUMN;
+	m_iPhoto			= BATCH_FILE_NO_COLUMN;
+	m_fDirty			= FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ParseEmployeeID
+//
+// Description: Parse an EmployeeID, a positive number.
+//
+// Returns: FALSE if the value is NULL or isn't one
+//
+////////////////////////////////////////////////////////////////////////////////
+BOOL BatchFileBackend::ParseEmployeeID(LPCWSTR pwszValue, DWORD *pdwEmployeeID)
+{
+	WCHAR			*pwszEnd;
+	unsigned long	ulValue;
+
+	if (NULL == pwszValue || pwszValue[0] < L'0' || pwszValue[0] > L'9')
+	{
+		return FALSE;
+	}
+
+	ulValue = wcstoul(pwszValue, &pwszEnd, 10);
+	if (L'\0' != *pwszEnd || 0 == ulValue || ulValue > 0x7FFFFFFF)
+	{
+		return FALSE;
+	}
+
+	*pdwEmployeeID = (DWORD)ulValue;
+
+	return TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompareRows
+//
+// Description: qsort comparison of rows in EmployeeID order.
+//
+////////////////////////////////////////////////////////////////////////////////
+int BatchFileBackend::CompareRows(const void *pv1, const void *pv2)
+{
+	DWORD dwEmployeeID1 = (*(BATCH_FILE_ROW* const*)pv1)->dwEmployeeID;
+	DWORD dwEmployeeID2 = (*(BATCH_FILE_ROW* const*)pv2)->dwEmployeeID;
+
+	return (dwEmployeeID1 < dwEmployeeID2) ? -1 : (dwEmployeeID1 > dwEmployeeID2);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetFileSize
+//
+// Description: Returns the size of a file, 0 if it doesn't exist.
+//
+////////////////////////////////////////////////////////////////////////////////
+ULONGLONG BatchFileBackend::GetFileSize(LPCWSTR pwszFile)
+{
+	FILE	*pFile;
+	long	cbFile;
+
+	pFile = _wfopen(pwszFile, L"rb");
+	if (NULL == pFile)
+	{
+		return 0;
+	}
+
+	cbFile = (0 == fseek(pFile, 0, SEEK_END)) ? ftell(pFile) : 0;
+
+	fclose(pFile);
+
+	return (cbFile > 0) ? (ULONGLONG)cbFile : 0;
+}
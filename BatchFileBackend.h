@@ -0,0 +1,171 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: BatchFileBackend
+//
+// File: BatchFileBackend.h
+//
+// Comment: Stand-in batch backend keeping the employees in a text file.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_BATCHFILEBACKEND_H__E27B9C45_0D16_4A8F_93B1_C58D2A7E6F03__INCLUDED_)
+#define AFX_BATCHFILEBACKEND_H__E27B9C45_0D16_4A8F_93B1_C58D2A7E6F03__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define BATCH_FILE_DATABASE			L"northwind.tsv"
+#define BATCH_FILE_LOG_SUFFIX		L".log"			// Change log beside the database
+#define BATCH_FILE_TEMP_SUFFIX		L".tmp"			// Written, then renamed over the database
+#define BATCH_FILE_NO_COLUMN		0xFFFFFFFF
+
+#define BATCH_FILE_OP_INSERT		1
+#define BATCH_FILE_OP_UPDATE		2
+
+////////////////////////////////////////////////////////////////////////////////
+// An employee, with its values in the same allocation
+//
+typedef struct tagBATCH_FILE_ROW
+{
+	DWORD		dwEmployeeID;
+	LPCWSTR		*rgpwszValues;					// One per column, NULL for NULL
+} BATCH_FILE_ROW;
+
+////////////////////////////////////////////////////////////////////////////////
+// A change log entry not yet written to the log file
+//
+typedef struct tagBATCH_FILE_CHANGE
+{
+	ULONG		ulSequence;
+	DWORD		dwEmployeeID;
+	DWORD		dwOp;							// BATCH_FILE_OP_*
+} BATCH_FILE_CHANGE;
+
+class BatchFileBackend;
+
+////////////////////////////////////////////////////////////////////////////////
+// A session of the file backend, the columns of its updates
+//
+class BatchFileSession : public BatchSession
+{
+public:
+	BatchFileSession(BatchFileBackend *pBackend);
+
+	HRESULT Insert(const BATCH_ROWS *pRows, DWORD iFirst, DWORD iLast, DWORD cTxnRows, DWORD *pcInserted, DWORD *pcRejected);
+	HRESULT OpenUpdate(WCHAR **rgpwszColumns, DWORD cColumns);
+	HRESULT Update(const BATCH_CHANGE *rgChanges, DWORD cChanges, DWORD cTxnRows, DWORD *pcApplied, DWORD *pcMissing);
+	HRESULT Load(DWORD dwEmployeeID, BATCH_LOAD *pLoad);
+
+private:
+	BatchFileBackend	*m_pBackend;
+	DWORD				m_rgiUpdateColumn[BATCH_MAX_COLUMNS];	// Table column of each value of a change
+	DWORD				m_cUpdateColumns;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Keeps the employees of a tab separated text file in memory, in
+// EmployeeID order, and writes them back when closed. It stands in for the
+// database where there is no SQL Server Compact, to run the driver on other
+// platforms.
+//
+// The file is the text of export: a header of column names, EmployeeID
+// among them, then one line per employee. A file that doesn't exist is
+// created with the columns of the first import.
+//
+// The sessions share the rows under one critical section. Each transaction
+// is staged, then applied while the section is held, so that other
+// sessions see all of it or none of it; rows and changes that fail leave
+// the transaction out. Changes are numbered into the log file beside the
+// database. There are no photos: an employee has one if its Photo column
+// isn't NULL.
+//
+class BatchFileBackend : public BatchBackend
+{
+public:
+	BatchFileBackend();
+	~BatchFileBackend();
+
+	LPCWSTR	GetDefaultDatabase();
+	DWORD	GetCommands(const BATCH_BACKEND_COMMAND **prgCommands);
+
+	HRESULT Open(const BATCH_OPTIONS *pOptions);
+	HRESULT Close();
+
+	HRESULT CheckOut(BatchSession **ppSession);
+	void	CheckIn(BatchSession *pSession, BOOL fDiscard);
+
+	HRESULT Export(PFN_BATCH_ROW pfnRow, LPVOID pvContext);
+	HRESULT ScanNames(PFN_BATCH_ID pfnID, LPVOID pvContext, DWORD *pcEmployees);
+	HRESULT ScanChangeLog(PFN_BATCH_SEQUENCE pfnSequence, LPVOID pvContext);
+	HRESULT Compact(const BATCH_OPTIONS *pOptions, BATCH_COMPACT_STATS *pStats);
+	HRESULT Benchmark(const BATCH_OPTIONS *pOptions, const DWORD *rgdwEmployeeID, DWORD cEmployees);
+	HRESULT RunCommand(DWORD iCommand, const BATCH_OPTIONS *pOptions);
+
+	// Work of the sessions
+	//
+	HRESULT InsertRows(const BATCH_ROWS *pRows, DWORD iFirst, DWORD iLast, DWORD cTxnRows, DWORD *pcInserted, DWORD *pcRejected);
+	HRESULT FindColumns(WCHAR **rgpwszColumns, DWORD cColumns, BOOL fUpdate, DWORD *rgiColumn);
+	HRESULT UpdateRows(const DWORD			*rgiColumn,
+					   DWORD				cColumns,
+					   const BATCH_CHANGE	*rgChanges,
+					   DWORD				cChanges,
+					   DWORD				cTxnRows,
+					   DWORD				*pcApplied,
+					   DWORD				*pcMissing);
+	HRESULT LoadRow(DWORD dwEmployeeID, BATCH_LOAD *pLoad);
+
+private:
+	HRESULT ReadTable();
+	HRESULT WriteTable();
+	HRESULT ReadLastSequence();
+	HRESULT WriteChangeLog();
+	HRESULT TrimChangeLog(DWORD cKeep, ULONG *pulDroppedTo);
+	HRESULT SetColumns(WCHAR **rgpwszColumns, DWORD cColumns);
+	DWORD	FindColumn(LPCWSTR pwszColumn);
+
+	BATCH_FILE_ROW* NewRow(DWORD dwEmployeeID, const LPCWSTR *rgpwszValues);
+	DWORD	FindRow(DWORD dwEmployeeID, BOOL *pfFound);
+	HRESULT MergeRows(BATCH_FILE_ROW **rgpRow, DWORD cRows, DWORD *pcInserted, DWORD *pcRejected);
+	HRESULT ReserveRows(DWORD cRows);
+	HRESULT ReserveChanges(DWORD cChanges);
+	void	LogChange(DWORD dwEmployeeID, DWORD dwOp);
+	void	FreeTable();
+
+	static BOOL ParseEmployeeID(LPCWSTR pwszValue, DWORD *pdwEmployeeID);
+	static int	CompareRows(const void *pv1, const void *pv2);
+	static ULONGLONG GetFileSize(LPCWSTR pwszFile);
+
+	CRITICAL_SECTION	m_cs;					// Guards the rows, the columns and the change log
+	WCHAR				m_wszFile[MAX_PATH];
+	WCHAR				m_wszLog[MAX_PATH];
+	WCHAR				m_wszTemp[MAX_PATH];
+	WCHAR				m_wszLogTemp[MAX_PATH];
+
+	WCHAR				m_wszColumns[BATCH_MAX_LINE];	// The header, split into the names
+	LPWSTR				m_rgpwszColumns[BATCH_MAX_COLUMNS];
+	DWORD				m_cColumns;				// 0 until the file or the first import sets them
+	DWORD				m_iKey;					// The EmployeeID column
+	DWORD				m_iLastName;			// BATCH_FILE_NO_COLUMN if there is none
+	DWORD				m_iPhoto;				// BATCH_FILE_NO_COLUMN if there is none
+
+	BATCH_FILE_ROW		**m_rgpRow;				// In EmployeeID order
+	DWORD				m_cRows;
+	DWORD				m_cMaxRows;
+	BOOL				m_fDirty;				// Changed since read or written
+
+	BATCH_FILE_CHANGE	*m_rgChange;
+	DWORD				m_cChanges;
+	DWORD				m_cMaxChanges;
+	ULONG				m_ulLastSequence;
+
+	DWORD				m_cSessions;			// Checked out
+	BOOL				m_fOpen;
+};
+
+#endif // !defined(AFX_BATCHFILEBACKEND_H__E27B9C45_0D16_4A8F_93B1_C58D2A7E6F03__INCLUDED_)
@@ -0,0 +1,536 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: BatchLookup
+//
+// File: BatchLookup.cpp
+//
+// Comment: Lookup of a list of employees in one ordered walk of PK_Employees.
+//
+// Functions:
+//			1. Sort and deduplicate the requested EmployeeIDs
+//			2. Walk PK_Employees once, seeking over large gaps
+//			3. Return the rows in the order of the request
+//
+// Notes:
+//			Calling LoadEmployeeInfo for each employee of a report opens a
+//			rowset and seeks once per employee. The batch lookup reads the
+//			same rows through one rowset, in index order, so neighbouring
+//			IDs cost a forward read instead of a seek.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "BatchLookup.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompareLookupKeys
+//
+// Description: qsort callback, orders the keys by EmployeeID and then by
+//				position in the request.
+//
+////////////////////////////////////////////////////////////////////////////////
+static int __cdecl CompareLookupKeys(const void *pv1, const void *pv2)
+{
+	const BATCH_LOOKUP_KEY *pKey1 = (const BATCH_LOOKUP_KEY *)pv1;
+	const BATCH_LOOKUP_KEY *pKey2 = (const BATCH_LOOKUP_KEY *)pv2;
+
+	if (pKey1->dwEmployeeID != pKey2->dwEmployeeID)
+	{
+		return (pKey1->dwEmployeeID < pKey2->dwEmployeeID) ? -1 : 1;
+	}
+
+	return (pKey1->iID < pKey2->iID) ? -1 : (pKey1->iID > pKey2->iID);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SortLookupKeys
+//
+// Description: Sort keys by EmployeeID. Keys with the same EmployeeID stay
+//				in the order of the request.
+//
+////////////////////////////////////////////////////////////////////////////////
+void SortLookupKeys(BATCH_LOOKUP_KEY *rgKeys, DWORD cKeys)
+{
+	qsort(rgKeys, cKeys, sizeof(BATCH_LOOKUP_KEY), CompareLookupKeys);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBatchLookup::EmployeeBatchLookup()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeeBatchLookup::EmployeeBatchLookup() : m_prgBinding(NULL),
+											 m_cBindings(0),
+											 m_cbRowSize(0),
+											 m_pRows(NULL),
+											 m_rgfFound(NULL),
+											 m_cIDs(0)
+{
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBatchLookup::~EmployeeBatchLookup()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeeBatchLookup::~EmployeeBatchLookup()
+{
+	Clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBatchLookup::Clear()
+//
+// Description: Free the rows of the last lookup.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeeBatchLookup::Clear()
+{
+	if (m_pRows)
+	{
+		CoTaskMemFree(m_pRows);
+		m_pRows = NULL;
+	}
+
+	if (m_rgfFound)
+	{
+		CoTaskMemFree(m_rgfFound);
+		m_rgfFound = NULL;
+	}
+
+	FreeColumnBindings(m_prgBinding);
+
+	m_prgBinding	= NULL;
+	m_cBindings		= 0;
+	m_cbRowSize		= 0;
+	m_cIDs			= 0;
+
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBatchLookup::Lookup()
+//
+// Description: Look up a list of employees.
+//
+// Parameters
+//		pISession		- session on the database
+//		rgdwEmployeeID	- the employees, in any order, duplicates allowed
+//		cIDs			- number of employees
+//		rgpwszColumns	- columns to read, besides EmployeeID
+//		cColumns		- number of columns
+//
+// Returns: NOERROR if succesfull. Employees that don't exist are reported
+//			by GetRow.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeBatchLookup::Lookup(IOpenRowset	*pISession,
+									const DWORD	*rgdwEmployeeID,
+									DWORD		cIDs,
+									WCHAR		**rgpwszColumns,
+									DWORD		cColumns)
+{
+	HRESULT				hr				= NOERROR;
+	IRowsetIndex		*pIRowsetIndex	= NULL;			// Provider Interface Pointer
+	IRowset				*pIRowset		= NULL;			// Provider Interface Pointer
+	IAccessor			*pIAccessor		= NULL;			// Provider Interface Pointer
+	WCHAR				**rgpwszBound	= NULL;			// EmployeeID and the requested columns
+	BATCH_LOOKUP_KEY	*rgKeys			= NULL;
+	DWORD				iID;
+
+	if (NULL == pISession || NULL == rgdwEmployeeID || 0 == cIDs || (cColumns && NULL == rgpwszColumns))
+	{
+		return E_INVALIDARG;
+	}
+
+	Clear();
+
+	// Sort the requested IDs, remembering where each one goes
+	//
+	rgKeys = (BATCH_LOOKUP_KEY*)CoTaskMemAlloc(cIDs * sizeof(BATCH_LOOKUP_KEY));
+	if (NULL == rgKeys)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	for (iID = 0; iID < cIDs; ++iID)
+	{
+		rgKeys[iID].dwEmployeeID	= rgdwEmployeeID[iID];
+		rgKeys[iID].iID				= iID;
+	}
+
+	SortLookupKeys(rgKeys, cIDs);
+
+	m_Stats.cIDs = cIDs;
+
+	for (iID = 0; iID < cIDs; ++iID)
+	{
+		if (0 == iID || rgKeys[iID].dwEmployeeID != rgKeys[iID - 1].dwEmployeeID)
+		{
+			++m_Stats.cDistinctIDs;
+		}
+	}
+
+	hr = OpenEmployeesRowset(pISession, ROWSET_OPT_INDEX, IID_IRowsetIndex, (IUnknown**)&pIRowsetIndex);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowsetIndex->QueryInterface(IID_IRowset, (void**)&pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// EmployeeID is bound first, it is both the seek key and the row key
+	//
+	rgpwszBound = (WCHAR**)CoTaskMemAlloc((cColumns + 1) * sizeof(WCHAR*));
+	if (NULL == rgpwszBound)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	rgpwszBound[0] = L"EmployeeID";
+	for (DWORD iCol = 0; iCol < cColumns; ++iCol)
+	{
+		rgpwszBound[iCol + 1] = rgpwszColumns[iCol];
+	}
+
+	hr = CreateColumnBindings(pIRowset, rgpwszBound, cColumns + 1, NULL, &m_prgBinding, &m_cBindings, &m_cbRowSize);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	if (m_cBindings != cColumns + 1 || DBTYPE_IUNKNOWN == m_prgBinding[0].wType)
+	{
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+	for (DWORD iBinding = 1; iBinding < m_cBindings; ++iBinding)
+	{
+		if (DBTYPE_IUNKNOWN == m_prgBinding[iBinding].wType)
+		{
+			hr = E_INVALIDARG;
+			goto Exit;
+		}
+	}
+
+	m_pRows		= (BYTE*)CoTaskMemAlloc(cIDs * m_cbRowSize);
+	m_rgfFound	= (BOOL*)CoTaskMemAlloc(cIDs * sizeof(BOOL));
+	if (NULL == m_pRows || NULL == m_rgfFound)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	memset(m_pRows, 0, cIDs * m_cbRowSize);
+	memset(m_rgfFound, 0, cIDs * sizeof(BOOL));
+	m_cIDs = cIDs;
+
+	hr = Walk(pIRowsetIndex, pIRowset, pIAccessor, rgKeys);
+
+Exit:
+	if (rgKeys)
+	{
+		CoTaskMemFree(rgKeys);
+	}
+
+	if (rgpwszBound)
+	{
+		CoTaskMemFree(rgpwszBound);
+	}
+
+	if (pIAccessor)
+	{
+		pIAccessor->Release();
+	}
+
+	if (pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	if (pIRowsetIndex)
+	{
+		pIRowsetIndex->Release();
+	}
+
+	if (FAILED(hr))
+	{
+		Clear();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBatchLookup::Walk()
+//
+// Description: Read the sorted keys in one pass over PK_Employees.
+//				A key far ahead of the current row is found with a
+//				DBSEEK_GE seek, a key close to it by reading forward. Only
+//				EmployeeID is read from the rows that are stepped over.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeBatchLookup::Walk(IRowsetIndex *pIRowsetIndex, IRowset *pIRowset, IAccessor *pIAccessor, const BATCH_LOOKUP_KEY *rgKeys)
+{
+	HRESULT		hr				= NOERROR;
+	HACCESSOR	hKeyAccessor	= DB_NULL_HACCESSOR;	// EmployeeID only
+	HACCESSOR	hRowAccessor	= DB_NULL_HACCESSOR;	// All the bound columns
+	BYTE		*pKey			= NULL;					// Seek key and EmployeeID of the current row
+	HROW		rghRows[1];								// Current row
+	HROW		*prghRows		= rghRows;
+	ULONG		cRowsObtained	= 0;
+	BOOL		fPositioned		= FALSE;
+	BOOL		fHaveRow		= FALSE;
+	DWORD		dwRowID			= 0;
+	DWORD		dwTarget;
+	DWORD		iKey			= 0;
+	DWORD		iFirst;
+	BYTE		*pFirst;
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, 1, m_prgBinding, m_cbRowSize, &hKeyAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, m_cBindings, m_prgBinding, m_cbRowSize, &hRowAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	pKey = (BYTE*)CoTaskMemAlloc(m_cbRowSize);
+	if (NULL == pKey)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	while (iKey < m_cIDs)
+	{
+		dwTarget = rgKeys[iKey].dwEmployeeID;
+
+		// Seek when the next key is too far ahead to read forward to it
+		//
+		if (!fPositioned || (fHaveRow && dwRowID < dwTarget && dwTarget - dwRowID > BATCH_LOOKUP_SEEK_GAP))
+		{
+			if (fHaveRow)
+			{
+				pIRowset->ReleaseRows(1, rghRows, NULL, NULL, NULL);
+				fHaveRow = FALSE;
+			}
+
+			memset(pKey, 0, m_cbRowSize);
+			*(ULONG*)(pKey+m_prgBinding[0].obLength)	= 4;
+			*(DBSTATUS*)(pKey+m_prgBinding[0].obStatus)	= DBSTATUS_S_OK;
+			*(int*)(pKey+m_prgBinding[0].obValue)		= dwTarget;
+
+			hr = pIRowsetIndex->Seek(hKeyAccessor, 1, pKey, DBSEEK_GE);
+			++m_Stats.cSeeks;
+
+			// No employee at or after the key, the remaining keys are missing
+			//
+			if (DB_E_NOTFOUND == hr)
+			{
+				hr = NOERROR;
+				break;
+			}
+
+			if(FAILED(hr))
+			{
+				goto Exit;
+			}
+
+			fPositioned = TRUE;
+		}
+
+		// Step to the next row until it reaches the key
+		//
+		if (!fHaveRow || dwRowID < dwTarget)
+		{
+			if (fHaveRow)
+			{
+				pIRowset->ReleaseRows(1, rghRows, NULL, NULL, NULL);
+				fHaveRow = FALSE;
+			}
+
+			hr = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, 1, &cRowsObtained, &prghRows);
+			if(FAILED(hr))
+			{
+				goto Exit;
+			}
+
+			if (0 == cRowsObtained)
+			{
+				hr = NOERROR;
+				break;
+			}
+
+			fHaveRow = TRUE;
+			++m_Stats.cRowsRead;
+
+			memset(pKey, 0, m_cbRowSize);
+
+			hr = pIRowset->GetData(rghRows[0], hKeyAccessor, pKey);
+			if(FAILED(hr))
+			{
+				goto Exit;
+			}
+
+			dwRowID = *(int*)(pKey+m_prgBinding[0].obValue);
+			continue;
+		}
+
+		// The row is at or past the key. Fill every request of the key.
+		//
+		iFirst = iKey;
+
+		if (dwRowID == dwTarget)
+		{
+			pFirst = m_pRows + rgKeys[iFirst].iID * m_cbRowSize;
+
+			hr = pIRowset->GetData(rghRows[0], hRowAccessor, pFirst);
+			if(FAILED(hr))
+			{
+				goto Exit;
+			}
+
+			m_rgfFound[rgKeys[iFirst].iID] = TRUE;
+			++m_Stats.cFound;
+
+			// BLOBs are not bound, so a row is copied by value
+			//
+			for (++iKey; iKey < m_cIDs && rgKeys[iKey].dwEmployeeID == dwTarget; ++iKey)
+			{
+				memcpy(m_pRows + rgKeys[iKey].iID * m_cbRowSize, pFirst, m_cbRowSize);
+				m_rgfFound[rgKeys[iKey].iID] = TRUE;
+				++m_Stats.cFound;
+			}
+		}
+		else
+		{
+			while (iKey < m_cIDs && rgKeys[iKey].dwEmployeeID == dwTarget)
+			{
+				++iKey;
+			}
+		}
+	}
+
+Exit:
+	if (fHaveRow)
+	{
+		pIRowset->ReleaseRows(1, rghRows, NULL, NULL, NULL);
+	}
+
+	if (pKey)
+	{
+		CoTaskMemFree(pKey);
+	}
+
+	if (DB_NULL_HACCESSOR != hRowAccessor)
+	{
+		pIAccessor->ReleaseAccessor(hRowAccessor, NULL);
+	}
+
+	if (DB_NULL_HACCESSOR != hKeyAccessor)
+	{
+		pIAccessor->ReleaseAccessor(hKeyAccessor, NULL);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBatchLookup::GetCount()
+//
+// Description: Returns the number of IDs of the last lookup.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD EmployeeBatchLookup::GetCount()
+{
+	return m_cIDs;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBatchLookup::GetRow()
+//
+// Description: Returns the row of the iID-th requested employee, laid out
+//				as described by GetBindings.
+//
+// Returns: NOERROR if found, S_FALSE if the employee does not exist
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeBatchLookup::GetRow(DWORD iID, BYTE **ppData)
+{
+	if (NULL == ppData || iID >= m_cIDs)
+	{
+		return E_INVALIDARG;
+	}
+
+	*ppData = NULL;
+
+	if (!m_rgfFound[iID])
+	{
+		return S_FALSE;
+	}
+
+	*ppData = m_pRows + iID * m_cbRowSize;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBatchLookup::GetBindings()
+//
+// Description: Returns the bindings of the rows of the last lookup.
+//
+////////////////////////////////////////////////////////////////////////////////
+const DBBINDING* EmployeeBatchLookup::GetBindings(DWORD *pcBindings)
+{
+	if (pcBindings)
+	{
+		*pcBindings = m_cBindings;
+	}
+
+	return m_prgBinding;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBatchLookup::GetStats()
+//
+// Description: Returns the statistics of the last lookup.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeeBatchLookup::GetStats(BATCH_LOOKUP_STATS *pStats)
+{
+	if (pStats)
+	{
+		*pStats = m_Stats;
+	}
+}
@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: BatchLookup
+//
+// File: BatchLookup.h
+//
+// Comment: Lookup of a list of employees in one ordered walk of PK_Employees.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_BATCHLOOKUP_H__8D2E4B71_C6A0_4F39_B5D8_7E13A09C64F2__INCLUDED_)
+#define AFX_BATCHLOOKUP_H__8D2E4B71_C6A0_4F39_B5D8_7E13A09C64F2__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+// Gap between two wanted EmployeeIDs above which the walk seeks instead of
+// reading forward. EmployeeID is unique, so a gap of n reads at most n rows.
+//
+#define BATCH_LOOKUP_SEEK_GAP		32
+
+////////////////////////////////////////////////////////////////////////////////
+// A requested ID and its position in the caller's list
+//
+typedef struct tagBATCH_LOOKUP_KEY
+{
+	DWORD		dwEmployeeID;
+	DWORD		iID;
+} BATCH_LOOKUP_KEY;
+
+////////////////////////////////////////////////////////////////////////////////
+// Sort keys by EmployeeID, keeping the order of the request for equal IDs
+//
+void SortLookupKeys(BATCH_LOOKUP_KEY *rgKeys, DWORD cKeys);
+
+////////////////////////////////////////////////////////////////////////////////
+// Batch lookup statistics
+//
+typedef struct tagBATCH_LOOKUP_STATS
+{
+	DWORD		cIDs;									// IDs requested
+	DWORD		cDistinctIDs;
+	DWORD		cFound;									// Requested IDs found, duplicates included
+	DWORD		cSeeks;
+	DWORD		cRowsRead;								// Rows fetched by the forward reads
+} BATCH_LOOKUP_STATS;
+
+////////////////////////////////////////////////////////////////////////////////
+// Looks up a list of employees. The IDs are sorted and deduplicated, and
+// PK_Employees is walked once in key order with DBSEEK_GE seeks over large
+// gaps and forward reads over small ones. The rows are returned in the order
+// of the caller's list.
+//
+// Binding 0 is always EmployeeID; binding i + 1 is the i-th requested column.
+// BLOB columns are not supported.
+//
+class EmployeeBatchLookup
+{
+public:
+	EmployeeBatchLookup();
+	~EmployeeBatchLookup();
+
+	HRESULT Lookup(IOpenRowset	*pISession,
+				   const DWORD	*rgdwEmployeeID,
+				   DWORD		cIDs,
+				   WCHAR		**rgpwszColumns,
+				   DWORD		cColumns);
+	void	Clear();
+
+	DWORD	GetCount();
+	HRESULT GetRow(DWORD iID, BYTE **ppData);
+	const DBBINDING* GetBindings(DWORD *pcBindings);
+	void	GetStats(BATCH_LOOKUP_STATS *pStats);
+
+private:
+	HRESULT Walk(IRowsetIndex *pIRowsetIndex, IRowset *pIRowset, IAccessor *pIAccessor, const BATCH_LOOKUP_KEY *rgKeys);
+
+	DBBINDING			*m_prgBinding;
+	DWORD				m_cBindings;
+	DWORD				m_cbRowSize;
+	BYTE				*m_pRows;						// m_cIDs rows of m_cbRowSize bytes
+	BOOL				*m_rgfFound;
+	DWORD				m_cIDs;
+	BATCH_LOOKUP_STATS	m_Stats;
+};
+
+#endif // !defined(AFX_BATCHLOOKUP_H__8D2E4B71_C6A0_4F39_B5D8_7E13A09C64F2__INCLUDED_)
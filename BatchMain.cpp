@@ -0,0 +1,110 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: BatchMain
+//
+// File: BatchMain.cpp
+//
+// Comment: Entry point of northwindbatch, the batch driver executable.
+//
+// Functions:
+//			1. WinMain on Windows CE
+//			2. main elsewhere
+//
+// Notes:
+//			northwindbatch <command> [-db file] [options]
+//
+//			The exit code is BATCH_EXIT_*.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "BatchPlatform.h"
+#include "BatchDriver.h"
+
+#if defined(_WIN32)
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: WinMain
+//
+// Description: Run the batch command of the command line.
+//
+// Returns: BATCH_EXIT_*
+//
+////////////////////////////////////////////////////////////////////////////////
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPTSTR lpCmdLine, int nCmdShow)
+{
+	return RunBatchCommandLine(lpCmdLine);
+}
+
+#else
+
+#include <locale.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: main
+//
+// Description: Convert the arguments to wide characters in the locale of
+//				the environment and run the batch command.
+//
+// Returns: BATCH_EXIT_*
+//
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char *argv[])
+{
+	LPWSTR	rgpwszArgs[BATCH_MAX_ARGS];
+	DWORD	cArgs	= 0;
+	size_t	cch;
+	int		iArg;
+	int		nExit;
+
+	// File names and text are converted in the locale of the environment;
+	// without one, UTF-8
+	//
+	if (NULL == setlocale(LC_CTYPE, "") || 1 == MB_CUR_MAX)
+	{
+		setlocale(LC_CTYPE, "C.UTF-8");
+	}
+
+	for (iArg = 1; iArg < argc && cArgs < BATCH_MAX_ARGS; ++iArg)
+	{
+		cch = mbstowcs(NULL, argv[iArg], 0);
+		if ((size_t)-1 == cch)
+		{
+			fwprintf(stderr, L"bad argument %d\n", iArg);
+			nExit = BATCH_EXIT_USAGE;
+			goto Exit;
+		}
+
+		rgpwszArgs[cArgs] = (LPWSTR)CoTaskMemAlloc(sizeof(WCHAR) * (cch + 1));
+		if (NULL == rgpwszArgs[cArgs])
+		{
+			nExit = BATCH_EXIT_FAILED;
+			goto Exit;
+		}
+
+		mbstowcs(rgpwszArgs[cArgs++], argv[iArg], cch + 1);
+	}
+
+	if (iArg < argc)
+	{
+		fwprintf(stderr, L"more than %d arguments\n", BATCH_MAX_ARGS);
+		nExit = BATCH_EXIT_USAGE;
+		goto Exit;
+	}
+
+	nExit = RunBatchCommand(rgpwszArgs, cArgs);
+
+Exit:
+	while (cArgs)
+	{
+		CoTaskMemFree(rgpwszArgs[--cArgs]);
+	}
+
+	return nExit;
+}
+
+#endif // defined(_WIN32)
@@ -0,0 +1,2594 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: BatchOleDbBackend
+//
+// File: BatchOleDbBackend.cpp
+//
+// Comment: Batch backend over the SQL Server Compact database.
+//
+// Functions:
+//			1. insert rows through text bindings, update through
+//			   EmployeeBulkUpdate and load through EmployeeStore
+//			2. export the Employees rowset, scan the names and the change
+//			   log
+//			3. compact the change log and the database file through
+//			   CompactScheduler
+//			4. benchmark a parallel scan, scheduled tasks and asynchronous
+//			   requests
+//			5. join the orders to their employees
+//			6. select the employees passing conditions on their columns and
+//			   holding words in their address
+//			7. collect the photo store and move photos to it
+//			8. import employee photos from a directory of bitmap files
+//			9. build the template database cloned on first run
+//			10. export the Employees table to a compressed column file
+//			11. merge the Employees table with a stand-in publisher
+//			12. refresh Employees and Orders from a stand-in RDA server
+//			13. list the names of employees split across shard databases
+//
+// Notes:
+//			Linked into northwindbatch on Windows CE. Each worker of the
+//			driver checks out a session of g_SessionPool.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include <stdio.h>
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "ChangeLog.h"
+#include "BatchLookup.h"
+#include "BulkUpdate.h"
+#include "CompactScheduler.h"
+#include "ResultCache.h"
+#include "AddressIndex.h"
+#include "SessionPool.h"
+#include "EmployeeStore.h"
+#include "HashJoin.h"
+#include "EmployeeSchema.h"
+#include "BlockScan.h"
+#include "ParallelScan.h"
+#include "TaskScheduler.h"
+#include "AsyncStore.h"
+#include "PhotoStore.h"
+#include "PhotoImport.h"
+#include "TemplateDatabase.h"
+#include "ColumnarExport.h"
+#include "MergeSync.h"
+#include "RdaPull.h"
+#include "EmployeeShards.h"
+#include "BatchPlatform.h"
+#include "BatchDriver.h"
+#include "BatchBackend.h"
+#include "BatchOleDbBackend.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// A slice of the benchmark loads, run as a task or on a thread
+//
+typedef struct tagOLEDB_BATCH_LOADS
+{
+	POOLED_SESSION		*pSession;
+	const DWORD			*rgdwEmployeeID;
+	DWORD				cEmployees;
+	DWORD				iFirst;					// First load
+	DWORD				iLast;					// Past the last one
+	HRESULT				hr;
+	DWORD				cDone;
+	ULONGLONG			cbBytes;				// Bytes of the records loaded
+} OLEDB_BATCH_LOADS;
+
+////////////////////////////////////////////////////////////////////////////////
+// A scan callback of the driver, called from a callback of the data layer
+//
+typedef struct tagOLEDB_BATCH_SCAN
+{
+	PFN_BATCH_ID		pfnID;
+	LPVOID				pvContext;
+} OLEDB_BATCH_SCAN;
+
+////////////////////////////////////////////////////////////////////////////////
+// Output of join and select
+//
+typedef struct tagOLEDB_BATCH_OUTPUT
+{
+	FILE		*pFile;
+	DWORD		cRows;
+	ULONGLONG	cbBytes;
+} OLEDB_BATCH_OUTPUT;
+
+// Employees is held in the hash table, Orders looked up in it. The columns
+// of Orders are those of the shipped Northwind database.
+//
+static WCHAR* s_rgpwszJoinEmployeeColumns[]	= { L"EmployeeID", L"LastName", L"FirstName" };
+static WCHAR* s_rgpwszJoinOrderColumns[]	= { L"Employee ID", L"Order ID", L"Customer ID", L"Order Date" };
+
+////////////////////////////////////////////////////////////////////////////////
+// Conditions of select, parsed from -where options
+//
+typedef struct tagBATCH_WHERE
+{
+	BLOCK_PREDICATE	rgPredicate[BATCH_MAX_WHERE];
+	WCHAR			rgwszLow[BATCH_MAX_WHERE][BLOCK_SCAN_MAX_TEXT + 1];
+	WCHAR			rgwszHigh[BATCH_MAX_WHERE][BLOCK_SCAN_MAX_TEXT + 1];
+	DWORD			cPredicates;
+	LPCWSTR			pwszAddressWords;					// Looked up in g_AddressIndex, NULL if none
+} BATCH_WHERE;
+
+////////////////////////////////////////////////////////////////////////////////
+// Output of select, and the employees the address words matched
+//
+typedef struct tagBATCH_SELECT_OUTPUT
+{
+	OLEDB_BATCH_OUTPUT	Output;
+	const DWORD			*rgdwEmployeeID;				// Ascending, NULL selects every employee
+	DWORD				cEmployees;
+} BATCH_SELECT_OUTPUT;
+
+////////////////////////////////////////////////////////////////////////////////
+// The connection given up during a compaction
+//
+typedef struct tagBATCH_CONNECTION
+{
+	LPCWSTR				pwszDatabase;
+	IDBCreateSession	**ppIDBCreateSession;
+} BATCH_CONNECTION;
+
+typedef HRESULT (*PFN_OLEDB_BATCH_COMMAND)(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession);
+
+static HRESULT JoinCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession);
+static HRESULT SelectCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession);
+static HRESULT PhotosCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession);
+static HRESULT PhotoImportCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession);
+static HRESULT TemplateCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession);
+static HRESULT ColumnarCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession);
+static HRESULT MergeCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession);
+static HRESULT RdaPullCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession);
+static HRESULT ShardsCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession);
+
+// The commands and their procedures, in the same order
+//
+static const BATCH_BACKEND_COMMAND s_rgOleDbCommands[] =	{
+																{ L"join",			L"[-out file] [-budget KB]" },
+																{ L"select",		L"[-out file] [-where column=value|column^prefix|column=low..high|Address~words]..." },
+																{ L"photos",		L"[-migrate]" },
+																{ L"photoimport",	L"-in directory [-out thumbnail directory] [-txn n]" },
+																{ L"template",		L"[-out file]" },
+																{ L"columnar",		L"-out file [-workers n]" },
+																{ L"merge",			L"-in publisher database" },
+																{ L"rdapull",		L"-in server database [-workers n]" },
+																{ L"shards",		L"[-in shard list] [-out file]" }
+															};
+
+static const PFN_OLEDB_BATCH_COMMAND s_rgpfnOleDbCommands[] =	{
+																	JoinCommand,
+																	SelectCommand,
+																	PhotosCommand,
+																	PhotoImportCommand,
+																	TemplateCommand,
+																	ColumnarCommand,
+																	MergeCommand,
+																	RdaPullCommand,
+																	ShardsCommand
+																};
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CreateBatchBackend
+//
+// Description: Create the backend of the executable, the OLE DB backend.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CreateBatchBackend(BatchBackend **ppBackend)
+{
+	*ppBackend = new OleDbBatchBackend;
+
+	return *ppBackend ? NOERROR : E_OUTOFMEMORY;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StartBatchSessions
+//
+// Description: Start g_SessionPool on the connection of the backend. The
+//				sessions are opened as the workers need them.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT StartBatchSessions(IDBCreateSession *pIDBCreateSession)
+{
+	SESSION_POOL_SETTINGS	Settings;
+
+	Settings.pIDBCreateSession	= pIDBCreateSession;
+	Settings.cMinSessions		= 0;
+	Settings.cMaxSessions		= SESSION_POOL_MAX_SESSIONS;
+	Settings.dwIdleTimeoutMs	= BATCH_SESSION_IDLE_TIMEOUT;
+
+	return g_SessionPool.Start(&Settings);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: BindTextColumns
+//
+// Description: Bind columns of the Employees rowset as text: those of a
+//				list of names, or without names all but the bookmark and
+//				the binary ones.
+//
+// Parameters:
+//			pDBColumnInfo	- Columns of the rowset
+//			ulNumCols		- Number of columns of the rowset
+//			rgpwszColumns	- Names of the columns to bind, or NULL
+//			cColumns		- Number of names
+//			rgBinding		- Receives the bindings
+//			rgiColumn		- Receives the rowset column of each binding
+//			pcBindings		- Receives the number of bindings
+//			pcbRowSize		- Receives the size of the row buffer
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT BindTextColumns(const DBCOLUMNINFO	*pDBColumnInfo,
+							   ULONG				ulNumCols,
+							   WCHAR				**rgpwszColumns,
+							   DWORD				cColumns,
+							   DBBINDING			*rgBinding,
+							   DWORD				*rgiColumn,
+							   DWORD				*pcBindings,
+							   DWORD				*pcbRowSize)
+{
+	DWORD	cBindings	= 0;
+	DWORD	dwOffset	= 0;
+	DWORD	dwIndex;
+	ULONG	ulCol;
+
+	for (dwIndex = 0; dwIndex < (rgpwszColumns ? cColumns : ulNumCols); ++dwIndex)
+	{
+		if (rgpwszColumns)
+		{
+			for (ulCol = 0; ulCol < ulNumCols; ++ulCol)
+			{
+				if (pDBColumnInfo[ulCol].pwszName && 0 == _wcsicmp(pDBColumnInfo[ulCol].pwszName, rgpwszColumns[dwIndex]))
+				{
+					break;
+				}
+			}
+
+			if (ulCol == ulNumCols)
+			{
+				fwprintf(stderr, L"no column %ls\n", rgpwszColumns[dwIndex]);
+				return DB_E_BADCOLUMNID;
+			}
+
+			if (DBTYPE_BYTES == pDBColumnInfo[ulCol].wType)
+			{
+				fwprintf(stderr, L"column %ls is binary\n", rgpwszColumns[dwIndex]);
+				return E_INVALIDARG;
+			}
+		}
+		else
+		{
+			ulCol = dwIndex;
+
+			if (0 == pDBColumnInfo[ulCol].iOrdinal || DBTYPE_BYTES == pDBColumnInfo[ulCol].wType)
+			{
+				continue;
+			}
+		}
+
+		if (cBindings == BATCH_MAX_COLUMNS)
+		{
+			return E_INVALIDARG;
+		}
+
+		rgBinding[cBindings].iOrdinal	= pDBColumnInfo[ulCol].iOrdinal;
+		rgBinding[cBindings].pTypeInfo	= NULL;
+		rgBinding[cBindings].pObject	= NULL;
+		rgBinding[cBindings].pBindExt	= NULL;
+		rgBinding[cBindings].dwMemOwner	= DBMEMOWNER_CLIENTOWNED;
+		rgBinding[cBindings].dwFlags	= 0;
+		rgBinding[cBindings].bPrecision	= pDBColumnInfo[ulCol].bPrecision;
+		rgBinding[cBindings].bScale		= pDBColumnInfo[ulCol].bScale;
+		rgBinding[cBindings].dwPart		= DBPART_VALUE | DBPART_STATUS | DBPART_LENGTH;
+		rgBinding[cBindings].obLength	= dwOffset;
+		rgBinding[cBindings].obStatus	= rgBinding[cBindings].obLength + sizeof(ULONG);
+		rgBinding[cBindings].obValue	= rgBinding[cBindings].obStatus + sizeof(DBSTATUS);
+		rgBinding[cBindings].wType		= DBTYPE_WSTR;
+
+		if (DBTYPE_WSTR == pDBColumnInfo[ulCol].wType)
+		{
+			rgBinding[cBindings].cbMaxLen = sizeof(WCHAR)*(pDBColumnInfo[ulCol].ulColumnSize + 1);	// Extra buffer for null terminator
+		}
+		else
+		{
+			rgBinding[cBindings].cbMaxLen = sizeof(WCHAR)*(BATCH_MAX_VALUE + 1);
+		}
+
+		// Calculate the offset, and properly align it
+		//
+		dwOffset = rgBinding[cBindings].obValue + rgBinding[cBindings].cbMaxLen;
+		dwOffset = ROUND_UP(dwOffset, COLUMN_ALIGNVAL);
+
+		rgiColumn[cBindings++] = ulCol;
+	}
+
+	*pcBindings = cBindings;
+	*pcbRowSize = dwOffset;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SetTextValue
+//
+// Description: Set a column bound as text, cut to the size of the binding.
+//
+////////////////////////////////////////////////////////////////////////////////
+static void SetTextValue(BYTE *pData, const DBBINDING *pBinding, LPCWSTR pwszValue)
+{
+	DWORD cch;
+
+	if (NULL == pwszValue)
+	{
+		*(ULONG*)(pData+pBinding->obLength)		= 0;
+		*(DBSTATUS*)(pData+pBinding->obStatus)	= DBSTATUS_S_ISNULL;
+		return;
+	}
+
+	cch = wcslen(pwszValue);
+	if (cch > pBinding->cbMaxLen / sizeof(WCHAR) - 1)
+	{
+		cch = pBinding->cbMaxLen / sizeof(WCHAR) - 1;
+	}
+
+	memcpy(pData+pBinding->obValue, pwszValue, cch*sizeof(WCHAR));
+	((WCHAR*)(pData+pBinding->obValue))[cch] = L'\0';
+
+	*(ULONG*)(pData+pBinding->obLength)		= cch*sizeof(WCHAR);
+	*(DBSTATUS*)(pData+pBinding->obStatus)	= DBSTATUS_S_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: OleDbBatchSession
+//
+// Description: Constructor.
+//
+////////////////////////////////////////////////////////////////////////////////
+OleDbBatchSession::OleDbBatchSession(POOLED_SESSION *pSession)
+{
+	m_pSession			= pSession;
+	m_cUpdateColumns	= 0;
+	m_fStoreOpen		= FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ~OleDbBatchSession
+//
+// Description: Destructor. The pooled session is checked in by the
+//				backend.
+//
+////////////////////////////////////////////////////////////////////////////////
+OleDbBatchSession::~OleDbBatchSession()
+{
+	m_Update.Close();
+	m_Store.Close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetPooledSession
+//
+// Description: Returns the session of g_SessionPool.
+//
+////////////////////////////////////////////////////////////////////////////////
+POOLED_SESSION* OleDbBatchSession::GetPooledSession()
+{
+	return m_pSession;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MarkEmployeesChanged
+//
+// Description: Drop the cached results and address index entries of the
+//				employees a committed transaction inserted.
+//
+////////////////////////////////////////////////////////////////////////////////
+static void MarkEmployeesChanged(const DWORD *rgdwEmployeeID, DWORD cEmployees)
+{
+	for (DWORD iEmployee = 0; iEmployee < cEmployees; ++iEmployee)
+	{
+		g_ResultCache.InvalidateEmployee(rgdwEmployeeID[iEmployee]);
+		g_AddressIndex.MarkChanged(rgdwEmployeeID[iEmployee]);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Insert
+//
+// Description: Insert rows iFirst to iLast, cTxnRows per transaction, with
+//				their change log entries. Rows the provider refuses,
+//				duplicate keys for instance, are counted and left out.
+//				Rows are counted as inserted once their transaction
+//				commits, and their employees are marked changed in
+//				g_ResultCache and g_AddressIndex.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT OleDbBatchSession::Insert(const BATCH_ROWS	*pRows,
+								  DWORD				iFirst,
+								  DWORD				iLast,
+								  DWORD				cTxnRows,
+								  DWORD				*pcInserted,
+								  DWORD				*pcRejected)
+{
+	HRESULT				hr					= NOERROR;
+	DBBINDING			rgBinding[BATCH_MAX_COLUMNS];
+	DWORD				rgiColumn[BATCH_MAX_COLUMNS];
+	DWORD				cBindings			= 0;
+	DWORD				cbRowSize			= 0;
+	DBCOLUMNINFO		*pDBColumnInfo		= NULL;
+	WCHAR				*pStringsBuffer		= NULL;
+	ULONG				ulNumCols			= 0;
+	BYTE				*pData				= NULL;
+	ChangeLogWriter		ChangeLog;
+	const LPCWSTR		*rgpwszFields;
+	DWORD				iRow;
+	DWORD				iColumn;
+	DWORD				cInTransaction		= 0;
+	DWORD				*rgdwInTransaction	= NULL;				// EmployeeIDs inserted by the open transaction
+	LPCWSTR				pwszKey;
+	POOLED_ROWSET		*pRowset;								// Employees, cached by the session
+
+	IOpenRowset			*pIOpenRowset		= NULL;				// Provider Interface Pointer
+	ITransactionLocal	*pITxnLocal			= NULL;				// Provider Interface Pointer
+	IRowsetChange		*pIRowsetChange		= NULL;				// Provider Interface Pointer
+	IColumnsInfo		*pIColumnsInfo		= NULL;				// Provider Interface Pointer
+	HACCESSOR			hAccessor			= DB_NULL_HACCESSOR;// Accessor handle, cached by the session
+
+	pIOpenRowset = m_pSession->pISession;
+	pIOpenRowset->AddRef();
+
+	hr = pIOpenRowset->QueryInterface(IID_ITransactionLocal, (void**)&pITxnLocal);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = g_SessionPool.GetRowset(m_pSession, TABLE_EMPLOYEE, L"PK_Employees", ROWSET_OPT_CHANGE, &pRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pRowset->pIRowset->QueryInterface(IID_IRowsetChange, (void**)&pIRowsetChange);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// The column metadata is kept for the change log
+	//
+	hr = pIRowsetChange->QueryInterface(IID_IColumnsInfo, (void**)&pIColumnsInfo);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIColumnsInfo->GetColumnInfo(&ulNumCols, &pDBColumnInfo, &pStringsBuffer);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = BindTextColumns(pDBColumnInfo,
+						 ulNumCols,
+						 pRows->rgpwszColumns,
+						 pRows->cColumns,
+						 rgBinding,
+						 rgiColumn,
+						 &cBindings,
+						 &cbRowSize);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = g_SessionPool.GetAccessor(pRowset, cBindings, rgBinding, &hAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	pData = (BYTE*)CoTaskMemAlloc(cbRowSize);
+	if (NULL == pData)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	rgdwInTransaction = new DWORD[(cTxnRows && cTxnRows < iLast - iFirst) ? cTxnRows : iLast - iFirst + 1];
+	if (NULL == rgdwInTransaction)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	// Open the change log on this session, so that its entries are part
+	// of the transactions
+	//
+	hr = ChangeLog.Open(pIOpenRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pITxnLocal->StartTransaction(ISOLATIONLEVEL_READCOMMITTED, 0, NULL, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	for (iRow = iFirst; iRow < iLast; ++iRow)
+	{
+		rgpwszFields = pRows->rgpwszFields + iRow * pRows->cColumns;
+
+		memset(pData, 0, cbRowSize);
+
+		for (iColumn = 0; iColumn < cBindings; ++iColumn)
+		{
+			SetTextValue(pData, &rgBinding[iColumn], rgpwszFields[iColumn]);
+		}
+
+		hr = pIRowsetChange->InsertRow(DB_NULL_HCHAPTER, hAccessor, pData, NULL);
+		if (DB_E_INTEGRITYVIOLATION == hr || DB_E_ERRORSOCCURRED == hr)
+		{
+			++*pcRejected;
+			hr = NOERROR;
+			continue;
+		}
+
+		if(FAILED(hr))
+		{
+			goto Abort;
+		}
+
+		pwszKey = rgpwszFields[pRows->iKey];
+
+		rgdwInTransaction[cInTransaction] = pwszKey ? _wtoi(pwszKey) : 0;
+
+		hr = ChangeLog.AppendRowChanges(rgdwInTransaction[cInTransaction],
+										CHANGE_OP_INSERT,
+										rgBinding,
+										cBindings,
+										pDBColumnInfo,
+										NULL,
+										pData);
+		if(FAILED(hr))
+		{
+			goto Abort;
+		}
+
+		// Commit every cTxnRows rows
+		//
+		if (++cInTransaction == cTxnRows && iRow + 1 < iLast)
+		{
+			hr = pITxnLocal->Commit(FALSE, XACTTC_SYNC, 0);
+			if(FAILED(hr))
+			{
+				goto Abort;
+			}
+
+			ChangeLog.EndTransaction();
+			MarkEmployeesChanged(rgdwInTransaction, cInTransaction);
+
+			*pcInserted += cInTransaction;
+
+			hr = pITxnLocal->StartTransaction(ISOLATIONLEVEL_READCOMMITTED, 0, NULL, NULL);
+			if(FAILED(hr))
+			{
+				goto Exit;
+			}
+
+			cInTransaction = 0;
+		}
+	}
+
+	hr = pITxnLocal->Commit(FALSE, XACTTC_SYNC, 0);
+	if(FAILED(hr))
+	{
+		goto Abort;
+	}
+
+	MarkEmployeesChanged(rgdwInTransaction, cInTransaction);
+
+	*pcInserted += cInTransaction;
+
+	goto Exit;
+
+Abort:
+	// Abort the transaction
+	//
+	pITxnLocal->Abort(NULL, FALSE, FALSE);
+
+Exit:
+	ChangeLog.Close();
+
+	delete [] rgdwInTransaction;
+
+	if (pData)
+	{
+		CoTaskMemFree(pData);
+	}
+
+	if (pDBColumnInfo)
+	{
+		CoTaskMemFree(pDBColumnInfo);
+	}
+
+	if (pStringsBuffer)
+	{
+		CoTaskMemFree(pStringsBuffer);
+	}
+
+	if (pIColumnsInfo)
+	{
+		pIColumnsInfo->Release();
+	}
+
+	if (pIRowsetChange)
+	{
+		pIRowsetChange->Release();
+	}
+
+	if (pITxnLocal)
+	{
+		pITxnLocal->Release();
+	}
+
+	if (pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: OpenUpdate
+//
+// Description: Open the updater of the session on the columns updated. It
+//				keeps its rowset and accessor until the session is checked
+//				in.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT OleDbBatchSession::OpenUpdate(WCHAR **rgpwszColumns, DWORD cColumns)
+{
+	HRESULT hr;
+
+	if (cColumns > BULK_UPDATE_MAX_COLUMNS)
+	{
+		fwprintf(stderr, L"update: %u columns at most\n", BULK_UPDATE_MAX_COLUMNS);
+		return E_INVALIDARG;
+	}
+
+	hr = m_Update.Open(m_pSession->pISession, rgpwszColumns, cColumns);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	m_cUpdateColumns = cColumns;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Update
+//
+// Description: Apply changes through the updater of the session, cTxnRows
+//				per transaction.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT OleDbBatchSession::Update(const BATCH_CHANGE	*rgChanges,
+								  DWORD					cChanges,
+								  DWORD					cTxnRows,
+								  DWORD					*pcApplied,
+								  DWORD					*pcMissing)
+{
+	HRESULT				hr;
+	BULK_UPDATE_CHANGE	*rgBulkChanges;
+	BULK_UPDATE_STATS	Before;
+	BULK_UPDATE_STATS	After;
+	DWORD				iChange;
+	DWORD				iColumn;
+
+	if (0 == m_cUpdateColumns)
+	{
+		return E_UNEXPECTED;
+	}
+
+	if (0 == cChanges)
+	{
+		return NOERROR;
+	}
+
+	rgBulkChanges = (BULK_UPDATE_CHANGE*)CoTaskMemAlloc(sizeof(BULK_UPDATE_CHANGE) * cChanges);
+	if (NULL == rgBulkChanges)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	for (iChange = 0; iChange < cChanges; ++iChange)
+	{
+		memset(&rgBulkChanges[iChange], 0, sizeof(BULK_UPDATE_CHANGE));
+
+		rgBulkChanges[iChange].dwEmployeeID = rgChanges[iChange].dwEmployeeID;
+
+		for (iColumn = 0; iColumn < m_cUpdateColumns; ++iColumn)
+		{
+			rgBulkChanges[iChange].rgpwszValues[iColumn] = rgChanges[iChange].rgpwszValues[iColumn];
+		}
+	}
+
+	// The statistics of the updater add up over the calls
+	//
+	m_Update.GetStats(&Before);
+
+	hr = m_Update.Apply(rgBulkChanges, cChanges, cTxnRows, NULL);
+
+	m_Update.GetStats(&After);
+
+	*pcApplied += After.cApplied - Before.cApplied;
+	*pcMissing += After.cMissing - Before.cMissing;
+
+	CoTaskMemFree(rgBulkChanges);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Load
+//
+// Description: Load an employee through EmployeeStore, on the session.
+//
+// Returns: NOERROR if succesfull, S_FALSE if it doesn't exist
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT OleDbBatchSession::Load(DWORD dwEmployeeID, BATCH_LOAD *pLoad)
+{
+	HRESULT			hr;
+	EmployeeRecord	Record;
+	const BYTE		*pPhotoBits;
+
+	if (!m_fStoreOpen)
+	{
+		hr = m_Store.Open(m_pSession);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+
+		m_fStoreOpen = TRUE;
+	}
+
+	hr = m_Store.Load(dwEmployeeID, &Record);
+	if (NOERROR == hr)
+	{
+		pLoad->cbRecord	= Record.GetData()->cbRecord;
+		pLoad->fPhoto	= NULL != Record.GetPhoto(&pPhotoBits);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: OleDbBatchBackend
+//
+// Description: Constructor.
+//
+////////////////////////////////////////////////////////////////////////////////
+OleDbBatchBackend::OleDbBatchBackend()
+{
+	m_pwszDatabase		= NULL;
+	m_pIDBCreateSession	= NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ~OleDbBatchBackend
+//
+// Description: Destructor. The database is closed by Close.
+//
+////////////////////////////////////////////////////////////////////////////////
+OleDbBatchBackend::~OleDbBatchBackend()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetDefaultDatabase
+//
+// Description: Returns the database opened without -db.
+//
+////////////////////////////////////////////////////////////////////////////////
+LPCWSTR OleDbBatchBackend::GetDefaultDatabase()
+{
+	return DATABASE_NORTHWIND;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetCommands
+//
+// Description: Returns the commands of the backend.
+//
+// Returns: The number of commands
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD OleDbBatchBackend::GetCommands(const BATCH_BACKEND_COMMAND **prgCommands)
+{
+	*prgCommands = s_rgOleDbCommands;
+
+	return sizeof(s_rgOleDbCommands)/sizeof(s_rgOleDbCommands[0]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Open
+//
+// Description: Open the database, bring it to the current schema version
+//				and start g_SessionPool on it. Loads read the photos of the
+//				store, if the database has one, and read the database, not
+//				results cached by an earlier load, unless -cache is given.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT OleDbBatchBackend::Open(const BATCH_OPTIONS *pOptions)
+{
+	HRESULT hr;
+
+	m_pwszDatabase = pOptions->pwszDatabase;
+
+	hr = OpenDataSource(m_pwszDatabase, &m_pIDBCreateSession);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	// Databases created by earlier versions need the newer tables and the
+	// row version column of the schema
+	//
+	hr = UpgradeSchema(m_pIDBCreateSession);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	hr = StartBatchSessions(m_pIDBCreateSession);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	g_PhotoStore.Open(m_pwszDatabase, FALSE);
+
+	if (!pOptions->fCache)
+	{
+		g_ResultCache.Configure(0, 0);
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Close
+//
+// Description: Stop g_SessionPool, which holds sessions and a reference on
+//				the data source, and close the database.
+//
+// Returns: NOERROR
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT OleDbBatchBackend::Close()
+{
+	g_PhotoStore.Close();
+	g_SessionPool.Stop();
+	ReleaseDataSource(&m_pIDBCreateSession);
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CheckOut
+//
+// Description: Check a session out of g_SessionPool, waiting for one if
+//				they are all in use.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT OleDbBatchBackend::CheckOut(BatchSession **ppSession)
+{
+	HRESULT			hr;
+	POOLED_SESSION	*pSession	= NULL;
+
+	hr = g_SessionPool.CheckOut(INFINITE, &pSession);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	*ppSession = new OleDbBatchSession(pSession);
+	if (NULL == *ppSession)
+	{
+		g_SessionPool.CheckIn(pSession, FALSE);
+		return E_OUTOFMEMORY;
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CheckIn
+//
+// Description: Give a session back to g_SessionPool. A session that failed
+//				is discarded rather than reused.
+//
+////////////////////////////////////////////////////////////////////////////////
+void OleDbBatchBackend::CheckIn(BatchSession *pSession, BOOL fDiscard)
+{
+	POOLED_SESSION *pPooled;
+
+	if (NULL == pSession)
+	{
+		return;
+	}
+
+	pPooled = ((OleDbBatchSession*)pSession)->GetPooledSession();
+
+	// The updater and the store release their rowsets first
+	//
+	delete pSession;
+
+	g_SessionPool.CheckIn(pPooled, fDiscard);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Export
+//
+// Description: Give the column names, then every employee, to a callback.
+//				Columns are read as text; the photo is left out.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT OleDbBatchBackend::Export(PFN_BATCH_ROW pfnRow, LPVOID pvContext)
+{
+	HRESULT				hr					= NOERROR;
+	DBBINDING			rgBinding[BATCH_MAX_COLUMNS];
+	DWORD				rgiColumn[BATCH_MAX_COLUMNS];
+	LPCWSTR				rgpwszValues[BATCH_MAX_COLUMNS];
+	DWORD				cBindings			= 0;
+	DWORD				cbRowSize			= 0;
+	DBCOLUMNINFO		*pDBColumnInfo		= NULL;
+	WCHAR				*pStringsBuffer		= NULL;
+	ULONG				ulNumCols			= 0;
+	BYTE				*pData				= NULL;
+	HROW				rghRows[BATCH_FETCH_ROWS];				// Array of row handles obtained from the rowset object
+	HROW				*prghRows			= rghRows;			// Row handle(s) pointer
+	ULONG				cRowsObtained		= 0;
+	ULONG				iRow;
+	DWORD				iColumn;
+	DBSTATUS			dwStatus;
+
+	IOpenRowset			*pIOpenRowset		= NULL;				// Provider Interface Pointer
+	IRowset				*pIRowset			= NULL;				// Provider Interface Pointer
+	IColumnsInfo		*pIColumnsInfo		= NULL;				// Provider Interface Pointer
+	IAccessor			*pIAccessor			= NULL;				// Provider Interface Pointer
+	HACCESSOR			hAccessor			= DB_NULL_HACCESSOR;// Accessor handle
+
+	hr = m_pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pIOpenRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = OpenEmployeesRowset(pIOpenRowset, 0, IID_IRowset, (IUnknown**)&pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->QueryInterface(IID_IColumnsInfo, (void**)&pIColumnsInfo);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIColumnsInfo->GetColumnInfo(&ulNumCols, &pDBColumnInfo, &pStringsBuffer);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = BindTextColumns(pDBColumnInfo, ulNumCols, NULL, 0, rgBinding, rgiColumn, &cBindings, &cbRowSize);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, cBindings, rgBinding, 0, &hAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	pData = (BYTE*)CoTaskMemAlloc(cbRowSize);
+	if (NULL == pData)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	// Header of column names
+	//
+	for (iColumn = 0; iColumn < cBindings; ++iColumn)
+	{
+		rgpwszValues[iColumn] = pDBColumnInfo[rgiColumn[iColumn]].pwszName;
+	}
+
+	hr = pfnRow(pvContext, rgpwszValues, cBindings);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	do
+	{
+		hr = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, BATCH_FETCH_ROWS, &cRowsObtained, &prghRows);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		for (iRow = 0; iRow < cRowsObtained && SUCCEEDED(hr); ++iRow)
+		{
+			memset(pData, 0, cbRowSize);
+
+			hr = pIRowset->GetData(prghRows[iRow], hAccessor, pData);
+			if(FAILED(hr))
+			{
+				break;
+			}
+
+			for (iColumn = 0; iColumn < cBindings; ++iColumn)
+			{
+				dwStatus = *(DBSTATUS*)(pData+rgBinding[iColumn].obStatus);
+				if (DBSTATUS_S_ISNULL == dwStatus)
+				{
+					rgpwszValues[iColumn] = NULL;
+				}
+				else if (DBSTATUS_S_OK == dwStatus)
+				{
+					rgpwszValues[iColumn] = (WCHAR*)(pData+rgBinding[iColumn].obValue);
+				}
+				else
+				{
+					hr = DB_E_ERRORSOCCURRED;
+					break;
+				}
+			}
+
+			if (SUCCEEDED(hr))
+			{
+				hr = pfnRow(pvContext, rgpwszValues, cBindings);
+			}
+		}
+
+		// Release the rows
+		//
+		if (cRowsObtained)
+		{
+			pIRowset->ReleaseRows(cRowsObtained, prghRows, NULL, NULL, NULL);
+		}
+
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+	}
+	while (DB_S_ENDOFROWSET != hr && cRowsObtained);
+
+	hr = NOERROR;
+
+Exit:
+	if (pData)
+	{
+		CoTaskMemFree(pData);
+	}
+
+	if (pDBColumnInfo)
+	{
+		CoTaskMemFree(pDBColumnInfo);
+	}
+
+	if (pStringsBuffer)
+	{
+		CoTaskMemFree(pStringsBuffer);
+	}
+
+	if (pIAccessor)
+	{
+		pIAccessor->ReleaseAccessor(hAccessor, NULL);
+		pIAccessor->Release();
+	}
+
+	if (pIColumnsInfo)
+	{
+		pIColumnsInfo->Release();
+	}
+
+	if (pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	if (pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ForwardEmployeeID
+//
+// Description: PFN_EMPLOYEE_NAME passing the EmployeeIDs of a name scan to
+//				the callback of the driver.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT CALLBACK ForwardEmployeeID(LPVOID pvContext, DWORD dwEmployeeID, LPCWSTR pwszName)
+{
+	OLEDB_BATCH_SCAN *pScan = (OLEDB_BATCH_SCAN*)pvContext;
+
+	return pScan->pfnID(pScan->pvContext, dwEmployeeID);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ScanNames
+//
+// Description: Count the employees, then scan the names through
+//				EmployeeStore.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT OleDbBatchBackend::ScanNames(PFN_BATCH_ID pfnID, LPVOID pvContext, DWORD *pcEmployees)
+{
+	HRESULT				hr;
+	EmployeeStore		Store;
+	OLEDB_BATCH_SCAN	Scan;
+	IOpenRowset			*pIOpenRowset	= NULL;				// Provider Interface Pointer
+	LONG				lRows			= 0;
+	BOOL				fNull			= FALSE;
+
+	hr = m_pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pIOpenRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = ExecuteScalar(pIOpenRowset, L"SELECT COUNT(*) FROM Employees", &lRows, &fNull);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	*pcEmployees = (DWORD)lRows;
+
+	hr = Store.Open(m_pIDBCreateSession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	Scan.pfnID		= pfnID;
+	Scan.pvContext	= pvContext;
+
+	hr = Store.ScanNames(ForwardEmployeeID, &Scan);
+
+Exit:
+	if (pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ScanChangeLog
+//
+// Description: Give the sequence numbers of the change log to a callback.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT OleDbBatchBackend::ScanChangeLog(PFN_BATCH_SEQUENCE pfnSequence, LPVOID pvContext)
+{
+	HRESULT			hr;
+	ChangeLogCursor	Cursor;
+	CHANGE_RECORD	Change;
+	BOOL			fTruncated	= FALSE;
+
+	hr = Cursor.Open(m_pIDBCreateSession, 0, &fTruncated);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	while (NOERROR == (hr = Cursor.Next(&Change)))
+	{
+		hr = pfnSequence(pvContext, Change.ulSequence);
+		if(FAILED(hr))
+		{
+			break;
+		}
+	}
+
+	Cursor.Close();
+
+	return FAILED(hr) ? hr : NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: BatchConnections
+//
+// Description: PFN_COMPACT_CONNECTIONS of compact. The backend holds one
+//				connection and the sessions of g_SessionPool, given up
+//				while the file is compacted.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT CALLBACK BatchConnections(LPVOID pvContext, DWORD dwRequest)
+{
+	BATCH_CONNECTION	*pConnection = (BATCH_CONNECTION*)pvContext;
+	HRESULT				hr;
+
+	if (COMPACT_RELEASE_CONNECTIONS == dwRequest)
+	{
+		g_SessionPool.Stop();
+		ReleaseDataSource(pConnection->ppIDBCreateSession);
+		return NOERROR;
+	}
+
+	hr = OpenDataSource(pConnection->pwszDatabase, pConnection->ppIDBCreateSession);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	return StartBatchSessions(*pConnection->ppIDBCreateSession);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Compact
+//
+// Description: Compact the change log and the database file now, through
+//				CompactScheduler.
+//
+// Returns: NOERROR if succesfull, S_FALSE if the database is in use
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT OleDbBatchBackend::Compact(const BATCH_OPTIONS *pOptions, BATCH_COMPACT_STATS *pStats)
+{
+	HRESULT				hr;
+	CompactScheduler	Scheduler;
+	COMPACT_SETTINGS	Settings;
+	COMPACT_STATS		Stats;
+	BATCH_CONNECTION	Connection;
+
+	Connection.pwszDatabase			= m_pwszDatabase;
+	Connection.ppIDBCreateSession	= &m_pIDBCreateSession;
+
+	// The scheduler thread never wakes up, the compaction runs here
+	//
+	memset(&Settings, 0, sizeof(Settings));
+
+	Settings.pwszDatabase		= m_pwszDatabase;
+	Settings.dwCheckIntervalMs	= INFINITE;
+	Settings.dwIdleMs			= INFINITE;
+	Settings.cChangeLogEntries	= pOptions->cKeepChanges;
+	Settings.pfnConnections		= BatchConnections;
+	Settings.pvContext			= &Connection;
+
+	hr = Scheduler.Start(&Settings);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	hr = Scheduler.CompactNow();
+
+	Scheduler.Stop();
+
+	if (NOERROR == hr)
+	{
+		Scheduler.GetStats(&Stats);
+
+		pStats->cbBefore			= Stats.cbLastBefore;
+		pStats->cbAfter				= Stats.cbLastAfter;
+		pStats->dwElapsedMs			= Stats.dwLastCompactMs;
+		pStats->ulChangesDroppedTo	= Stats.ulChangeLogCompactedTo;
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: LoadSlice
+//
+// Description: Load the employees of a slice of the benchmark loads,
+//				spread over all the employees.
+//
+////////////////////////////////////////////////////////////////////////////////
+static void LoadSlice(OLEDB_BATCH_LOADS *pLoads)
+{
+	EmployeeStore	Store;
+	EmployeeRecord	Record;
+	DWORD			iLoad;
+	DWORD			dwEmployeeID;
+
+	pLoads->hr = Store.Open(pLoads->pSession->pISession);
+
+	for (iLoad = pLoads->iFirst; SUCCEEDED(pLoads->hr) && iLoad < pLoads->iLast; ++iLoad)
+	{
+		dwEmployeeID = pLoads->rgdwEmployeeID[(DWORD)((ULONGLONG)iLoad * BATCH_LOAD_STRIDE % pLoads->cEmployees)];
+
+		pLoads->hr = Store.Load(dwEmployeeID, &Record);
+		if (NOERROR == pLoads->hr)
+		{
+			++pLoads->cDone;
+			pLoads->cbBytes += Record.GetData()->cbRecord;
+		}
+
+		Record.Clear();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: BenchmarkTask
+//
+// Description: PFN_SCHEDULER_TASK of benchmark, loading a slice of
+//				BATCH_TASK_LOADS employees on the session of the worker.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT CALLBACK BenchmarkTask(LPVOID pvContext, const SCHEDULER_TASK_CONTEXT *pTaskContext)
+{
+	OLEDB_BATCH_LOADS *pLoads = (OLEDB_BATCH_LOADS*)pvContext;
+
+	if (*pTaskContext->pfCancel)
+	{
+		return E_ABORT;
+	}
+
+	pLoads->pSession = pTaskContext->pSession;
+
+	LoadSlice(pLoads);
+
+	pLoads->pSession = NULL;
+
+	return pLoads->hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: BenchmarkAsync
+//
+// Description: Run the benchmark loads again as asynchronous requests,
+//				all in flight at once, then end them in order.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT BenchmarkAsync(const BATCH_OPTIONS	*pOptions,
+							  IDBCreateSession		*pIDBCreateSession,
+							  const DWORD			*rgdwEmployeeID,
+							  DWORD					cEmployees)
+{
+	HRESULT				hr			= NOERROR;
+	HRESULT				hrLoad;
+	EmployeeAsyncStore	AsyncStore;
+	EmployeeRecord		Record;
+	ASYNC_REQUEST		**rgpRequest	= NULL;
+	DWORD				cBegun		= 0;
+	DWORD				cLoaded		= 0;
+	ULONGLONG			cbBytes		= 0;
+	DWORD				dwStartMs;
+	DWORD				iLoad;
+
+	if (0 == pOptions->cLoads)
+	{
+		return NOERROR;
+	}
+
+	rgpRequest = (ASYNC_REQUEST**)CoTaskMemAlloc(pOptions->cLoads * sizeof(ASYNC_REQUEST*));
+	if (NULL == rgpRequest)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	hr = AsyncStore.Open(pIDBCreateSession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	dwStartMs = GetTickCount();
+
+	for (iLoad = 0; iLoad < pOptions->cLoads; ++iLoad)
+	{
+		hr = AsyncStore.BeginLoad(rgdwEmployeeID[(DWORD)((ULONGLONG)iLoad * BATCH_LOAD_STRIDE % cEmployees)],
+								  NULL,
+								  &rgpRequest[cBegun]);
+		if(FAILED(hr))
+		{
+			break;
+		}
+
+		++cBegun;
+	}
+
+	// Every request begun is ended, also after a failure
+	//
+	for (iLoad = 0; iLoad < cBegun; ++iLoad)
+	{
+		if(FAILED(hr))
+		{
+			AsyncStore.Cancel(rgpRequest[iLoad]);
+		}
+
+		hrLoad = AsyncStore.EndLoad(rgpRequest[iLoad], &Record);
+		if (NOERROR == hrLoad)
+		{
+			++cLoaded;
+			cbBytes += Record.GetData()->cbRecord;
+		}
+		else if (FAILED(hrLoad) && SUCCEEDED(hr))
+		{
+			hr = hrLoad;
+		}
+
+		Record.Clear();
+	}
+
+	PrintBatchSummary(L"benchmark async", cLoaded, cbBytes, GetTickCount() - dwStartMs);
+
+Exit:
+	CoTaskMemFree(rgpRequest);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: BenchmarkTasks
+//
+// Description: Run the benchmark loads again as tasks of g_TaskScheduler,
+//				BATCH_TASK_LOADS at a time, hinted to the workers in turn.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT BenchmarkTasks(const BATCH_OPTIONS *pOptions, const DWORD *rgdwEmployeeID, DWORD cEmployees)
+{
+	HRESULT				hr			= NOERROR;
+	OLEDB_BATCH_LOADS	*rgTask		= NULL;
+	SCHEDULER_STATS		Stats;
+	DWORD				cTasks		= (pOptions->cLoads + BATCH_TASK_LOADS - 1) / BATCH_TASK_LOADS;
+	DWORD				cSubmitted	= 0;
+	DWORD				cLoaded		= 0;
+	ULONGLONG			cbBytes		= 0;
+	DWORD				dwStartMs;
+	DWORD				iTask;
+
+	if (0 == cTasks)
+	{
+		return NOERROR;
+	}
+
+	rgTask = (OLEDB_BATCH_LOADS*)CoTaskMemAlloc(cTasks * sizeof(OLEDB_BATCH_LOADS));
+	if (NULL == rgTask)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	memset(rgTask, 0, cTasks * sizeof(OLEDB_BATCH_LOADS));
+
+	hr = g_TaskScheduler.Start(&g_SessionPool, pOptions->cWorkers);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	dwStartMs = GetTickCount();
+
+	for (iTask = 0; iTask < cTasks; ++iTask)
+	{
+		rgTask[iTask].rgdwEmployeeID	= rgdwEmployeeID;
+		rgTask[iTask].cEmployees		= cEmployees;
+		rgTask[iTask].iFirst			= iTask * BATCH_TASK_LOADS;
+		rgTask[iTask].iLast				= rgTask[iTask].iFirst + BATCH_TASK_LOADS;
+
+		if (rgTask[iTask].iLast > pOptions->cLoads)
+		{
+			rgTask[iTask].iLast = pOptions->cLoads;
+		}
+
+		hr = g_TaskScheduler.Submit(BenchmarkTask,
+									&rgTask[iTask],
+									SCHEDULER_PRIORITY_INTERACTIVE,
+									iTask % g_TaskScheduler.GetWorkerCount(),
+									NULL);
+		if(FAILED(hr))
+		{
+			break;
+		}
+
+		++cSubmitted;
+	}
+
+	g_TaskScheduler.WaitIdle(INFINITE);
+
+	for (iTask = 0; iTask < cSubmitted; ++iTask)
+	{
+		if (SUCCEEDED(hr) && FAILED(rgTask[iTask].hr))
+		{
+			hr = rgTask[iTask].hr;
+		}
+
+		cLoaded	+= rgTask[iTask].cDone;
+		cbBytes	+= rgTask[iTask].cbBytes;
+	}
+
+	PrintBatchSummary(L"benchmark tasks", cLoaded, cbBytes, GetTickCount() - dwStartMs);
+
+	g_TaskScheduler.GetStats(&Stats);
+
+	fwprintf(stderr,
+			 L"benchmark tasks: %u workers, %u steals, %u affinity misses, %u ms longest wait\n",
+			 Stats.cWorkers,
+			 Stats.cSteals,
+			 Stats.cAffinityMisses,
+			 Stats.rgdwMaxWaitMs[SCHEDULER_PRIORITY_INTERACTIVE]);
+
+Exit:
+	g_TaskScheduler.Stop();
+
+	CoTaskMemFree(rgTask);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CountParallelRow
+//
+// Description: PFN_PARALLEL_SCAN_ROW counting the rows of an ordered scan.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT CALLBACK CountParallelRow(LPVOID pvContext, DWORD iPartition, const EMPLOYEE_ROW *pRow)
+{
+	++*(DWORD*)pvContext;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Benchmark
+//
+// Description: Report the loads of the driver served by g_ResultCache,
+//				then time the scan of the employee names split into
+//				-workers key ranges, and the loads of the driver as
+//				scheduled tasks and as asynchronous requests.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT OleDbBatchBackend::Benchmark(const BATCH_OPTIONS *pOptions, const DWORD *rgdwEmployeeID, DWORD cEmployees)
+{
+	HRESULT					hr;
+	RESULT_CACHE_STATS		CacheStats;
+	EmployeeParallelScan	ParallelScan;
+	PARALLEL_SCAN_STATS		ScanStats;
+	DWORD					rgiNameColumn[]	= { EMPLOYEE_COL_EMPLOYEE_ID, EMPLOYEE_COL_LAST_NAME, EMPLOYEE_COL_FIRST_NAME };
+	DWORD					cScanned		= 0;
+
+	if (pOptions->fCache)
+	{
+		g_ResultCache.GetStats(&CacheStats);
+
+		fwprintf(stderr, L"benchmark load: %u of %u loads from the cache\n", CacheStats.cHits, CacheStats.cLookups);
+	}
+
+	hr = ParallelScan.Scan(&g_SessionPool,
+						   rgiNameColumn,
+						   sizeof(rgiNameColumn) / sizeof(rgiNameColumn[0]),
+						   pOptions->cWorkers,
+						   PARALLEL_SCAN_ORDERED,
+						   CountParallelRow,
+						   &cScanned,
+						   &ScanStats);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	PrintBatchSummary(L"benchmark parallel scan", cScanned, 0, ScanStats.dwElapsedMs);
+
+	fwprintf(stderr,
+			 L"benchmark parallel scan: %u partitions, %u ms planning\n",
+			 ScanStats.cPartitions,
+			 ScanStats.dwPlanMs);
+
+	hr = BenchmarkTasks(pOptions, rgdwEmployeeID, cEmployees);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	return BenchmarkAsync(pOptions, m_pIDBCreateSession, rgdwEmployeeID, cEmployees);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RunCommand
+//
+// Description: Run a command of GetCommands.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT OleDbBatchBackend::RunCommand(DWORD iCommand, const BATCH_OPTIONS *pOptions)
+{
+	if (iCommand >= sizeof(s_rgpfnOleDbCommands)/sizeof(s_rgpfnOleDbCommands[0]))
+	{
+		return E_INVALIDARG;
+	}
+
+	return s_rgpfnOleDbCommands[iCommand](pOptions, &m_pIDBCreateSession);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: WriteJoinRow
+//
+// Description: PFN_HASH_JOIN_ROW writing a joined row as a line of text.
+//				The key of Orders repeats the one of Employees and is left
+//				out.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT CALLBACK WriteJoinRow(LPVOID pvContext, LPCWSTR *rgpwszBuild, LPCWSTR *rgpwszProbe)
+{
+	OLEDB_BATCH_OUTPUT	*pOutput = (OLEDB_BATCH_OUTPUT*)pvContext;
+	DWORD				iColumn;
+
+	for (iColumn = 0; iColumn < sizeof(s_rgpwszJoinEmployeeColumns)/sizeof(s_rgpwszJoinEmployeeColumns[0]); ++iColumn)
+	{
+		pOutput->cbBytes += WriteBatchField(pOutput->pFile, rgpwszBuild[iColumn]);
+		fputwc(L'\t', pOutput->pFile);
+	}
+
+	for (iColumn = 1; iColumn < sizeof(s_rgpwszJoinOrderColumns)/sizeof(s_rgpwszJoinOrderColumns[0]); ++iColumn)
+	{
+		if (iColumn > 1)
+		{
+			fputwc(L'\t', pOutput->pFile);
+		}
+
+		pOutput->cbBytes += WriteBatchField(pOutput->pFile, rgpwszProbe[iColumn]);
+	}
+
+	fputwc(L'\n', pOutput->pFile);
+	++pOutput->cRows;
+
+	return ferror(pOutput->pFile) ? STG_E_WRITEFAULT : NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: JoinCommand
+//
+// Description: Write the orders with the name of their employee, joined
+//				on the client by HashJoin. The build and probe times go to
+//				the standard error.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT JoinCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession)
+{
+	HRESULT				hr;
+	HashJoin			Join;
+	HASH_JOIN_INPUT		Build;
+	HASH_JOIN_INPUT		Probe;
+	HASH_JOIN_STATS		Stats;
+	OLEDB_BATCH_OUTPUT	Output;
+	DWORD				iColumn;
+	DWORD				dwStartMs			= GetTickCount();
+
+	Build.pwszTable		= TABLE_EMPLOYEE;
+	Build.pwszIndex		= NULL;
+	Build.rgpwszColumns	= s_rgpwszJoinEmployeeColumns;
+	Build.cColumns		= sizeof(s_rgpwszJoinEmployeeColumns)/sizeof(s_rgpwszJoinEmployeeColumns[0]);
+
+	Probe.pwszTable		= L"Orders";
+	Probe.pwszIndex		= NULL;
+	Probe.rgpwszColumns	= s_rgpwszJoinOrderColumns;
+	Probe.cColumns		= sizeof(s_rgpwszJoinOrderColumns)/sizeof(s_rgpwszJoinOrderColumns[0]);
+
+	memset(&Output, 0, sizeof(Output));
+
+	Output.pFile = OpenBatchStream(pOptions->pwszOutput, TRUE);
+	if (NULL == Output.pFile)
+	{
+		return STG_E_FILENOTFOUND;
+	}
+
+	// Header of column names
+	//
+	for (iColumn = 0; iColumn < Build.cColumns; ++iColumn)
+	{
+		WriteBatchField(Output.pFile, Build.rgpwszColumns[iColumn]);
+		fputwc(L'\t', Output.pFile);
+	}
+
+	for (iColumn = 1; iColumn < Probe.cColumns; ++iColumn)
+	{
+		if (iColumn > 1)
+		{
+			fputwc(L'\t', Output.pFile);
+		}
+
+		WriteBatchField(Output.pFile, Probe.rgpwszColumns[iColumn]);
+	}
+
+	fputwc(L'\n', Output.pFile);
+
+	Join.SetMemoryBudget(pOptions->cbJoinBudget);
+
+	hr = Join.Execute(*ppIDBCreateSession, &Build, &Probe, WriteJoinRow, &Output, &Stats);
+	if (SUCCEEDED(hr))
+	{
+		fwprintf(stderr,
+				 L"join build: %u rows in %u ms, probe: %u rows in %u ms\n",
+				 Stats.cBuildRows,
+				 Stats.dwBuildMs,
+				 Stats.cProbeRows,
+				 Stats.dwProbeMs);
+
+		fwprintf(stderr,
+				 L"join memory: %u KB peak, %u partitions spilled, %u KB spilled\n",
+				 Stats.cbPeakMemory / 1024,
+				 Stats.cPartitionsSpilled,
+				 (DWORD)(Stats.cbSpilled / 1024));
+
+		PrintBatchSummary(L"join", Output.cRows, Output.cbBytes, GetTickCount() - dwStartMs);
+	}
+
+	CloseBatchStream(Output.pFile);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ParseWhere
+//
+// Description: Parse a -where condition into a predicate of the block scan.
+//				column=value is equality, column^prefix a prefix and
+//				column=low..high a range, where low or high may be left
+//				out for a string column. Address~words is not a predicate:
+//				the words are searched in g_AddressIndex, which indexes the
+//				Address, City, Region and PostalCode columns.
+//
+// Returns: NOERROR if succesfull, E_INVALIDARG if the condition is wrong
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT ParseWhere(LPCWSTR pwszCondition, BATCH_WHERE *pWhere)
+{
+	BLOCK_PREDICATE	*pPredicate	= &pWhere->rgPredicate[pWhere->cPredicates];
+	WCHAR			*pwszLow	= pWhere->rgwszLow[pWhere->cPredicates];
+	WCHAR			*pwszHigh	= pWhere->rgwszHigh[pWhere->cPredicates];
+	LPCWSTR			pwszOp;
+	LPCWSTR			pwszRange;
+	DWORD			cchName;
+	DWORD			cchLow;
+
+	pwszOp = wcspbrk(pwszCondition, L"=^~");
+	if (NULL == pwszOp || pwszOp == pwszCondition || BATCH_MAX_WHERE == pWhere->cPredicates)
+	{
+		return E_INVALIDARG;
+	}
+
+	memset(pPredicate, 0, sizeof(BLOCK_PREDICATE));
+
+	// The column, by name
+	//
+	cchName = pwszOp - pwszCondition;
+
+	for (pPredicate->iColumn = 0; pPredicate->iColumn < EMPLOYEE_SCHEMA_SIZE; ++pPredicate->iColumn)
+	{
+		if (cchName == wcslen(g_rgEmployeeSchema[pPredicate->iColumn].pwszName) &&
+			0 == _wcsnicmp(pwszCondition, g_rgEmployeeSchema[pPredicate->iColumn].pwszName, cchName))
+		{
+			break;
+		}
+	}
+
+	if (EMPLOYEE_SCHEMA_SIZE == pPredicate->iColumn)
+	{
+		return E_INVALIDARG;
+	}
+
+	if (L'~' == *pwszOp)
+	{
+		if (EMPLOYEE_COL_ADDRESS != pPredicate->iColumn || pWhere->pwszAddressWords)
+		{
+			return E_INVALIDARG;
+		}
+
+		pWhere->pwszAddressWords = pwszOp + 1;
+
+		return NOERROR;
+	}
+
+	// The value, or the bounds of a range
+	//
+	pwszRange	= wcsstr(pwszOp + 1, L"..");
+	cchLow		= pwszRange ? pwszRange - (pwszOp + 1) : wcslen(pwszOp + 1);
+
+	if (cchLow > BLOCK_SCAN_MAX_TEXT || (pwszRange && wcslen(pwszRange + 2) > BLOCK_SCAN_MAX_TEXT))
+	{
+		return E_INVALIDARG;
+	}
+
+	wcsncpy(pwszLow, pwszOp + 1, cchLow);
+	pwszLow[cchLow] = WCHAR('\0');
+
+	if (L'^' == *pwszOp)
+	{
+		pPredicate->dwOp = BLOCK_PRED_PREFIX;
+	}
+	else if (pwszRange)
+	{
+		pPredicate->dwOp = BLOCK_PRED_RANGE;
+		wcscpy(pwszHigh, pwszRange + 2);
+	}
+	else
+	{
+		pPredicate->dwOp = BLOCK_PRED_EQUAL;
+	}
+
+	if (DBTYPE_I4 == g_rgEmployeeSchema[pPredicate->iColumn].wType)
+	{
+		if (WCHAR('\0') == pwszLow[0] || (pwszRange && WCHAR('\0') == pwszHigh[0]))
+		{
+			return E_INVALIDARG;
+		}
+
+		pPredicate->lLow	= _wtoi(pwszLow);
+		pPredicate->lHigh	= pwszRange ? _wtoi(pwszHigh) : pPredicate->lLow;
+	}
+	else
+	{
+		pPredicate->pwszLow		= (pwszRange && WCHAR('\0') == pwszLow[0]) ? NULL : pwszLow;
+		pPredicate->pwszHigh	= (pwszRange && WCHAR('\0') != pwszHigh[0]) ? pwszHigh : NULL;
+	}
+
+	++pWhere->cPredicates;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: WriteSelectRow
+//
+// Description: PFN_BLOCK_SCAN_ROW writing an employee, photo left out, as a
+//				line of text.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT CALLBACK WriteSelectRow(LPVOID pvContext, const EMPLOYEE_ROW *pRow)
+{
+	BATCH_SELECT_OUTPUT	*pSelect = (BATCH_SELECT_OUTPUT*)pvContext;
+	OLEDB_BATCH_OUTPUT	*pOutput = &pSelect->Output;
+	WCHAR				wszValue[BATCH_MAX_VALUE + 1];
+	DWORD				iColumn;
+	DWORD				iLow;
+	DWORD				iHigh;
+	DWORD				iMiddle;
+
+	// Left out if the address words did not match it
+	//
+	if (pSelect->rgdwEmployeeID)
+	{
+		for (iLow = 0, iHigh = pSelect->cEmployees; iLow < iHigh; )
+		{
+			iMiddle = (iLow + iHigh) / 2;
+
+			if (pSelect->rgdwEmployeeID[iMiddle] < (DWORD)pRow->EmployeeID)
+			{
+				iLow = iMiddle + 1;
+			}
+			else
+			{
+				iHigh = iMiddle;
+			}
+		}
+
+		if (iLow == pSelect->cEmployees || pSelect->rgdwEmployeeID[iLow] != (DWORD)pRow->EmployeeID)
+		{
+			return NOERROR;
+		}
+	}
+
+	for (iColumn = 0; iColumn < EMPLOYEE_COL_PHOTO; ++iColumn)
+	{
+		if (iColumn)
+		{
+			fputwc(L'\t', pOutput->pFile);
+		}
+
+		if (DBSTATUS_S_ISNULL == EMPLOYEE_ROW_STATUS(pRow, iColumn))
+		{
+			WriteBatchField(pOutput->pFile, NULL);
+		}
+		else if (DBTYPE_I4 == g_rgEmployeeSchema[iColumn].wType)
+		{
+			wsprintf(wszValue, L"%d", *(LONG*)EMPLOYEE_ROW_VALUE(pRow, iColumn));
+			pOutput->cbBytes += WriteBatchField(pOutput->pFile, wszValue);
+		}
+		else
+		{
+			pOutput->cbBytes += WriteBatchField(pOutput->pFile, (LPCWSTR)EMPLOYEE_ROW_VALUE(pRow, iColumn));
+		}
+	}
+
+	fputwc(L'\n', pOutput->pFile);
+	++pOutput->cRows;
+
+	return ferror(pOutput->pFile) ? STG_E_WRITEFAULT : NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SelectCommand
+//
+// Description: Write the employees passing the -where conditions as text,
+//				in EmployeeID order. The photo is left out. Address words
+//				are looked up in g_AddressIndex before the scan.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT SelectCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession)
+{
+	HRESULT				hr					= NOERROR;
+	EmployeeBlockScan	Scan;
+	BLOCK_SCAN_STATS	Stats;
+	BATCH_WHERE			Where;
+	BATCH_SELECT_OUTPUT	Select;
+	IOpenRowset			*pIOpenRowset		= NULL;
+	DWORD				*rgdwEmployeeID		= NULL;
+	DWORD				cEmployees			= 0;
+	DWORD				rgiColumn[EMPLOYEE_SCHEMA_SIZE];
+	DWORD				iColumn;
+
+	memset(&Where, 0, sizeof(Where));
+	memset(&Select, 0, sizeof(Select));
+
+	for (DWORD iWhere = 0; iWhere < pOptions->cWhere; ++iWhere)
+	{
+		hr = ParseWhere(pOptions->rgpwszWhere[iWhere], &Where);
+		if(FAILED(hr))
+		{
+			fwprintf(stderr, L"select: bad condition %ls\n", pOptions->rgpwszWhere[iWhere]);
+			return hr;
+		}
+	}
+
+	hr = Scan.Compile(Where.rgPredicate, Where.cPredicates);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	// Employees holding the address words, counted by a first search
+	//
+	if (Where.pwszAddressWords)
+	{
+		hr = (*ppIDBCreateSession)->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pIOpenRowset);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		hr = g_AddressIndex.Search(pIOpenRowset, Where.pwszAddressWords, NULL, 0, &cEmployees);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		rgdwEmployeeID = new DWORD[cEmployees + 1];
+		if (NULL == rgdwEmployeeID)
+		{
+			hr = E_OUTOFMEMORY;
+			goto Exit;
+		}
+
+		hr = g_AddressIndex.Search(pIOpenRowset, Where.pwszAddressWords, rgdwEmployeeID, cEmployees + 1, &cEmployees);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		Select.rgdwEmployeeID	= rgdwEmployeeID;
+		Select.cEmployees		= cEmployees;
+
+		fwprintf(stderr, L"select: %u employees hold \"%ls\"\n", cEmployees, Where.pwszAddressWords);
+	}
+
+	Select.Output.pFile = OpenBatchStream(pOptions->pwszOutput, TRUE);
+	if (NULL == Select.Output.pFile)
+	{
+		hr = STG_E_FILENOTFOUND;
+		goto Exit;
+	}
+
+	// Header of column names
+	//
+	for (iColumn = 0; iColumn < EMPLOYEE_COL_PHOTO; ++iColumn)
+	{
+		if (iColumn)
+		{
+			fputwc(L'\t', Select.Output.pFile);
+		}
+
+		WriteBatchField(Select.Output.pFile, g_rgEmployeeSchema[iColumn].pwszName);
+		rgiColumn[iColumn] = iColumn;
+	}
+
+	fputwc(L'\n', Select.Output.pFile);
+
+	hr = Scan.Scan(*ppIDBCreateSession, rgiColumn, EMPLOYEE_COL_PHOTO, WriteSelectRow, &Select, &Stats);
+	if (SUCCEEDED(hr))
+	{
+		fwprintf(stderr,
+				 L"select: %u of %u rows in %u blocks\n",
+				 Select.Output.cRows,
+				 Stats.cRowsScanned,
+				 Stats.cBlocks);
+
+		PrintBatchSummary(L"select", Stats.cRowsScanned, Select.Output.cbBytes, Stats.dwElapsedMs);
+	}
+
+	CloseBatchStream(Select.Output.pFile);
+
+Exit:
+	delete [] rgdwEmployeeID;
+
+	if (pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotosCommand
+//
+// Description: Create the photo store of the database if it has none,
+//				copy the live photos to a new store file and delete the
+//				old files. -migrate also moves the photos kept in the rows.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT PhotosCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession)
+{
+	HRESULT				hr;
+	PHOTO_STORE_STATS	Stats;
+
+	hr = g_PhotoStore.Open(pOptions->pwszDatabase, TRUE);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	hr = g_PhotoStore.Collect(*ppIDBCreateSession, pOptions->fMigrate);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	g_PhotoStore.GetStats(&Stats);
+
+	fwprintf(stderr,
+			 L"photos: %u moved, %u migrated, %u KB reclaimed, %u KB in %u files in %u ms\n",
+			 Stats.cMoved,
+			 Stats.cMigrated,
+			 (DWORD)(Stats.cbReclaimed / 1024),
+			 (DWORD)(Stats.cbFiles / 1024),
+			 Stats.cFiles,
+			 Stats.dwLastCollectMs);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: WriteThumbnail
+//
+// Description: PFN_PHOTO_THUMBNAIL of photoimport, writing the thumbnail
+//				as <EmployeeID>.bmp in the -out directory.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT CALLBACK WriteThumbnail(LPVOID					pvContext,
+									   DWORD					dwEmployeeID,
+									   LPCWSTR					pwszFile,
+									   const BITMAPINFOHEADER	*pbmiThumbnail,
+									   const BYTE				*pThumbnailBits)
+{
+	LPCWSTR				pwszDirectory	= (LPCWSTR)pvContext;
+	WCHAR				wszPath[MAX_PATH];
+	HANDLE				hFile;
+	BITMAPFILEHEADER	bmpFileHeader;
+	DWORD				cbWritten;
+	BOOL				fWritten;
+
+	if (wcslen(pwszDirectory) + 16 > MAX_PATH)
+	{
+		return E_INVALIDARG;
+	}
+
+	wsprintf(wszPath, L"%s\\%u.bmp", pwszDirectory, dwEmployeeID);
+
+	hFile = CreateFile(wszPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == hFile)
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	memset(&bmpFileHeader, 0, sizeof(bmpFileHeader));
+
+	bmpFileHeader.bfType	= 0x4D42;				// "BM"
+	bmpFileHeader.bfOffBits	= sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
+	bmpFileHeader.bfSize	= bmpFileHeader.bfOffBits + pbmiThumbnail->biSizeImage;
+
+	fWritten = WriteFile(hFile, &bmpFileHeader, sizeof(bmpFileHeader), &cbWritten, NULL) &&
+			   WriteFile(hFile, pbmiThumbnail, sizeof(BITMAPINFOHEADER), &cbWritten, NULL) &&
+			   WriteFile(hFile, pThumbnailBits, pbmiThumbnail->biSizeImage, &cbWritten, NULL) &&
+			   pbmiThumbnail->biSizeImage == cbWritten;
+
+	CloseHandle(hFile);
+
+	return fWritten ? NOERROR : STG_E_WRITEFAULT;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoImportCommand
+//
+// Description: Set the photos of the employees from the bitmap files of
+//				the -in directory, through the photo store if the database
+//				has one. With -out the thumbnails are written there.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT PhotoImportCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession)
+{
+	HRESULT				hr;
+	EmployeePhotoImport	Import;
+	PHOTO_IMPORT_STATS	Stats;
+
+	if (NULL == pOptions->pwszInput)
+	{
+		fwprintf(stderr, L"photoimport: -in directory is missing\n");
+		return E_INVALIDARG;
+	}
+
+	hr = Import.Import(*ppIDBCreateSession,
+					   pOptions->pwszInput,
+					   pOptions->cTxnRows,
+					   pOptions->pwszOutput ? WriteThumbnail : NULL,
+					   (LPVOID)pOptions->pwszOutput,
+					   &Stats);
+
+	fwprintf(stderr,
+			 L"photoimport: %u files, %u rejected, %u unmatched, %u written in %u transactions\n",
+			 Stats.cFiles,
+			 Stats.cRejected,
+			 Stats.cUnmatched,
+			 Stats.cWritten,
+			 Stats.cTransactions);
+
+	fwprintf(stderr,
+			 L"photoimport: busy %u ms reading, %u ms decoding, %u ms writing\n",
+			 Stats.dwReadMs,
+			 Stats.dwDecodeMs,
+			 Stats.dwWriteMs);
+
+	PrintBatchSummary(L"photoimport", Stats.cWritten, Stats.cbRead, Stats.dwElapsedMs);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TemplateCommand
+//
+// Description: Write the database, brought to the current schema version,
+//				as the template cloned on first run. The template goes to
+//				-out, or next to the executable.
+//
+// Returns: NOERROR if succesfull
+//
+// Notes: Clones have no photo store, so the photos must be in the rows.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT TemplateCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession)
+{
+	HRESULT		hr;
+	WCHAR		wszTemplate[MAX_PATH];
+	LPCWSTR		pwszTemplate	= pOptions->pwszOutput;
+	ULONGLONG	cbTemplate		= 0;
+
+	if (g_PhotoStore.IsOpen())
+	{
+		fwprintf(stderr, L"template: the photos of %ls are in a photo store\n", pOptions->pwszDatabase);
+		return E_INVALIDARG;
+	}
+
+	if (NULL == pwszTemplate)
+	{
+		if (!GetTemplateDatabasePath(wszTemplate, MAX_PATH))
+		{
+			return E_FAIL;
+		}
+
+		pwszTemplate = wszTemplate;
+	}
+
+	hr = UpgradeSchema(*ppIDBCreateSession);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	// The engine copies closed databases only
+	//
+	g_SessionPool.Stop();
+	ReleaseDataSource(ppIDBCreateSession);
+
+	hr = BuildTemplateDatabase(pOptions->pwszDatabase, pwszTemplate);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	GetDatabaseFileSize(pwszTemplate, &cbTemplate);
+
+	fwprintf(stderr, L"template: %ls, %u KB\n", pwszTemplate, (DWORD)(cbTemplate / 1024));
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ColumnarCommand
+//
+// Description: Export the Employees table, photos included, to the
+//				compressed column file -out, compressing the columns of a
+//				row group on -workers threads.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT ColumnarCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession)
+{
+	HRESULT				hr;
+	ColumnarExporter	Exporter;
+	EXPORT_STATS		Stats;
+
+	if (NULL == pOptions->pwszOutput || 0 == wcscmp(pOptions->pwszOutput, L"-"))
+	{
+		fwprintf(stderr, L"columnar: -out must name a file\n");
+		return E_INVALIDARG;
+	}
+
+	Exporter.SetWorkerCount(pOptions->cWorkers);
+
+	hr = Exporter.Export(*ppIDBCreateSession, pOptions->pwszOutput, &Stats);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	PrintBatchSummary(L"columnar", Stats.cRows, Stats.cbSource, Stats.dwElapsedMs);
+
+	fwprintf(stderr,
+			 L"columnar: %u row groups, %u KB written, %u ms compressing\n",
+			 Stats.cRowGroups,
+			 (DWORD)(Stats.cbWritten / 1024),
+			 Stats.dwCompressMs);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeCommand
+//
+// Description: Merge the Employees table of the database both ways with
+//				the database -in, standing in for the publisher, and print
+//				the statistics the status reporter kept of each table.
+//
+// Returns: NOERROR if succesfull
+//
+// Notes: A missing stand-in is seeded with a copy of the database, which
+//		  must be closed for the copy.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT MergeCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession)
+{
+	HRESULT					hr;
+	MergeSync				Sync;
+	MergeStatusReporter		*pReporter;
+	MERGE_SYNC_SETTINGS		Settings;
+	MERGE_SYNC_RESULT		Result;
+	MERGE_TABLE_STATS		Stats;
+	LPCWSTR					rgpwszTables[]	= { TABLE_EMPLOYEE };
+
+	if (NULL == pOptions->pwszInput || 0 == wcscmp(pOptions->pwszInput, L"-"))
+	{
+		fwprintf(stderr, L"merge: -in must name the publisher database\n");
+		return E_INVALIDARG;
+	}
+
+	pReporter = new MergeStatusReporter;
+	if (NULL == pReporter)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	memset(&Settings, 0, sizeof(Settings));
+
+	Settings.pwszSubscriberDatabase	= pOptions->pwszDatabase;
+	Settings.eExchangeType			= BIDIRECTIONAL;
+	Settings.rgpwszTables			= rgpwszTables;
+	Settings.cTables				= sizeof(rgpwszTables)/sizeof(rgpwszTables[0]);
+	Settings.pwszLocalPublisher		= pOptions->pwszInput;
+
+	// The run opens the database itself
+	//
+	g_SessionPool.Stop();
+	ReleaseDataSource(ppIDBCreateSession);
+
+	hr = Sync.Run(&Settings, pReporter, &Result);
+	if (SUCCEEDED(hr))
+	{
+		for (DWORD dwTable = 0; pReporter->GetTableStats(dwTable, &Stats); ++dwTable)
+		{
+			fwprintf(stderr,
+					 L"merge: %ls %ls, %u rows, %u KB in %u ms\n",
+					 Stats.wszTable,
+					 MERGE_UPLOAD == Stats.dwDirection ? L"upload" : L"download",
+					 Stats.cRows,
+					 (DWORD)(Stats.cbBytes / 1024),
+					 Stats.dwElapsedMs);
+		}
+
+		PrintBatchSummary(L"merge", Result.cRows, Result.cbBytes, Result.dwElapsedMs);
+	}
+
+	pReporter->Release();
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RdaPullCommand
+//
+// Description: Refresh the Employees and Orders tables of the database from
+//				the database -in, standing in for the RDA server, pulling on
+//				-workers threads, and print the statistics of each table.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT RdaPullCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession)
+{
+	HRESULT					hr;
+	RdaPullCoordinator		Coordinator;
+	RDA_PULL_SETTINGS		Settings;
+	RDA_PULL_TABLE			rgTables[2];
+	RDA_TABLE_STATS			rgStats[2];
+	LPCWSTR					rgpwszEmployeeIndexes[]	= { EMPLOYEE_SCHEMA_INDEX_DDL };
+	DWORD					dwElapsedMs				= 0;
+	DWORD					cRows					= 0;
+	ULONGLONG				cbBytes					= 0;
+
+	if (NULL == pOptions->pwszInput || 0 == wcscmp(pOptions->pwszInput, L"-"))
+	{
+		fwprintf(stderr, L"rdapull: -in must name the server database\n");
+		return E_INVALIDARG;
+	}
+
+	memset(rgTables, 0, sizeof(rgTables));
+
+	rgTables[0].pwszLocalTable	= TABLE_EMPLOYEE;
+	rgTables[0].pwszSelect		= L"SELECT * FROM Employees";
+	rgTables[0].eTrackOption	= TRACKINGOFF;
+	rgTables[0].rgpwszIndexes	= rgpwszEmployeeIndexes;
+	rgTables[0].cIndexes		= sizeof(rgpwszEmployeeIndexes)/sizeof(rgpwszEmployeeIndexes[0]);
+
+	rgTables[1].pwszLocalTable	= L"Orders";
+	rgTables[1].pwszSelect		= L"SELECT * FROM Orders";
+	rgTables[1].eTrackOption	= TRACKINGOFF;
+
+	memset(&Settings, 0, sizeof(Settings));
+
+	Settings.pwszLocalDatabase	= pOptions->pwszDatabase;
+	Settings.cMaxConcurrent		= pOptions->cWorkers;
+	Settings.rgTables			= rgTables;
+	Settings.cTables			= sizeof(rgTables)/sizeof(rgTables[0]);
+	Settings.pwszLocalEndpoint	= pOptions->pwszInput;
+
+	// The pull drops the tables, which the sessions of the backend must
+	// not hold open
+	//
+	g_SessionPool.Stop();
+	ReleaseDataSource(ppIDBCreateSession);
+
+	hr = Coordinator.Run(&Settings, rgStats, &dwElapsedMs);
+
+	for (DWORD dwTable = 0; dwTable < Settings.cTables; ++dwTable)
+	{
+		fwprintf(stderr,
+				 L"rdapull: %ls %ls, %u rows, pull %u ms, index %u ms, ready after %u ms\n",
+				 rgTables[dwTable].pwszLocalTable,
+				 RDA_TABLE_DONE == rgStats[dwTable].dwState ? L"done" : L"failed",
+				 rgStats[dwTable].cRows,
+				 rgStats[dwTable].dwPullMs,
+				 rgStats[dwTable].dwIndexMs,
+				 rgStats[dwTable].dwTotalMs);
+
+		cRows	+= rgStats[dwTable].cRows;
+		cbBytes	+= rgStats[dwTable].cbBytes;
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		PrintBatchSummary(L"rdapull", cRows, cbBytes, dwElapsedMs);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: WriteShardName
+//
+// Description: PFN_SHARD_NAME writing a name of the shards as a line of
+//				text.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT CALLBACK WriteShardName(LPVOID pvContext, const EMPLOYEE_NAME *pName)
+{
+	OLEDB_BATCH_OUTPUT	*pOutput = (OLEDB_BATCH_OUTPUT*)pvContext;
+	WCHAR				wszID[16];
+
+	wsprintf(wszID, L"%u", pName->dwEmployeeID);
+
+	pOutput->cbBytes += WriteBatchField(pOutput->pFile, wszID);
+	fputwc(L'\t', pOutput->pFile);
+	pOutput->cbBytes += WriteBatchField(pOutput->pFile, pName->wszName);
+	fputwc(L'\n', pOutput->pFile);
+
+	++pOutput->cRows;
+
+	return ferror(pOutput->pFile) ? STG_E_WRITEFAULT : NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ShardsCommand
+//
+// Description: Open the shards of the list -in, a header line then one
+//				line of FirstID, LastID and database per shard, and write
+//				the names of all their employees in EmployeeID order. The
+//				shards are scanned in parallel and their names merged.
+//
+// Returns: NOERROR if succesfull
+//
+// Notes: A shard database that is missing is created empty.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT ShardsCommand(const BATCH_OPTIONS *pOptions, IDBCreateSession **ppIDBCreateSession)
+{
+	HRESULT				hr					= NOERROR;
+	EmployeeShards		Shards;
+	EMPLOYEE_SHARD		rgShards[SHARD_MAX_SHARDS];
+	WCHAR				rgwszDatabase[SHARD_MAX_SHARDS][MAX_PATH];
+	DWORD				cShards				= 0;
+	WCHAR				wszLine[BATCH_MAX_LINE];
+	LPWSTR				rgpwszFields[3];
+	DWORD				cFields;
+	OLEDB_BATCH_OUTPUT	Output;
+	FILE				*pInput;
+	DWORD				dwStartMs;
+
+	memset(&Output, 0, sizeof(Output));
+
+	pInput = OpenBatchStream(pOptions->pwszInput, FALSE);
+	if (NULL == pInput)
+	{
+		return STG_E_FILENOTFOUND;
+	}
+
+	// Skip the header, then read the shards
+	//
+	hr = ReadBatchLine(pInput, wszLine);
+
+	while (NOERROR == hr && NOERROR == (hr = ReadBatchLine(pInput, wszLine)))
+	{
+		hr = SplitBatchLine(wszLine, rgpwszFields, 3, &cFields);
+		if (FAILED(hr) || 3 != cFields || NULL == rgpwszFields[0] || NULL == rgpwszFields[1] ||
+			NULL == rgpwszFields[2] || wcslen(rgpwszFields[2]) >= MAX_PATH || SHARD_MAX_SHARDS == cShards)
+		{
+			fwprintf(stderr, L"shards: bad shard %u\n", cShards + 1);
+			hr = E_INVALIDARG;
+			break;
+		}
+
+		wcscpy(rgwszDatabase[cShards], rgpwszFields[2]);
+
+		rgShards[cShards].dwFirstID		= _wtoi(rgpwszFields[0]);
+		rgShards[cShards].dwLastID		= _wtoi(rgpwszFields[1]);
+		rgShards[cShards].pwszDatabase	= rgwszDatabase[cShards];
+		++cShards;
+	}
+
+	CloseBatchStream(pInput);
+
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	hr = Shards.Open(rgShards, cShards);
+	if(FAILED(hr))
+	{
+		fwprintf(stderr, L"shards: cannot open the %u shards\n", cShards);
+		return hr;
+	}
+
+	Output.pFile = OpenBatchStream(pOptions->pwszOutput, TRUE);
+	if (NULL == Output.pFile)
+	{
+		return STG_E_FILENOTFOUND;
+	}
+
+	fputws(L"EmployeeID\tName\n", Output.pFile);
+
+	dwStartMs = GetTickCount();
+
+	hr = Shards.ScanNames(WriteShardName, &Output);
+	if (SUCCEEDED(hr))
+	{
+		PrintBatchSummary(L"shards", Output.cRows, Output.cbBytes, GetTickCount() - dwStartMs);
+	}
+
+	CloseBatchStream(Output.pFile);
+
+	return hr;
+}
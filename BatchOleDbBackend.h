@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: BatchOleDbBackend
+//
+// File: BatchOleDbBackend.h
+//
+// Comment: Batch backend over the SQL Server Compact database.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_BATCHOLEDBBACKEND_H__4C81E6A2_9B37_4D50_A6F4_2E0B7D93C1A5__INCLUDED_)
+#define AFX_BATCHOLEDBBACKEND_H__4C81E6A2_9B37_4D50_A6F4_2E0B7D93C1A5__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define BATCH_SESSION_IDLE_TIMEOUT	30000			// Pooled sessions of the workers closed after this idle time
+
+////////////////////////////////////////////////////////////////////////////////
+// A session checked out of g_SessionPool, with the updater and the store
+// of the worker using it
+//
+class OleDbBatchSession : public BatchSession
+{
+public:
+	OleDbBatchSession(POOLED_SESSION *pSession);
+	~OleDbBatchSession();
+
+	HRESULT Insert(const BATCH_ROWS *pRows, DWORD iFirst, DWORD iLast, DWORD cTxnRows, DWORD *pcInserted, DWORD *pcRejected);
+	HRESULT OpenUpdate(WCHAR **rgpwszColumns, DWORD cColumns);
+	HRESULT Update(const BATCH_CHANGE *rgChanges, DWORD cChanges, DWORD cTxnRows, DWORD *pcApplied, DWORD *pcMissing);
+	HRESULT Load(DWORD dwEmployeeID, BATCH_LOAD *pLoad);
+
+	POOLED_SESSION* GetPooledSession();
+
+private:
+	POOLED_SESSION		*m_pSession;
+	EmployeeBulkUpdate	m_Update;
+	DWORD				m_cUpdateColumns;		// 0 until OpenUpdate
+	EmployeeStore		m_Store;
+	BOOL				m_fStoreOpen;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// The application database, opened through OLE DB. The workers get the
+// sessions of g_SessionPool, started on the connection of the backend;
+// loads go through g_ResultCache and read the photos of g_PhotoStore.
+// join, select, photos, photoimport and template are commands of this
+// backend.
+//
+class OleDbBatchBackend : public BatchBackend
+{
+public:
+	OleDbBatchBackend();
+	~OleDbBatchBackend();
+
+	LPCWSTR	GetDefaultDatabase();
+	DWORD	GetCommands(const BATCH_BACKEND_COMMAND **prgCommands);
+
+	HRESULT Open(const BATCH_OPTIONS *pOptions);
+	HRESULT Close();
+
+	HRESULT CheckOut(BatchSession **ppSession);
+	void	CheckIn(BatchSession *pSession, BOOL fDiscard);
+
+	HRESULT Export(PFN_BATCH_ROW pfnRow, LPVOID pvContext);
+	HRESULT ScanNames(PFN_BATCH_ID pfnID, LPVOID pvContext, DWORD *pcEmployees);
+	HRESULT ScanChangeLog(PFN_BATCH_SEQUENCE pfnSequence, LPVOID pvContext);
+	HRESULT Compact(const BATCH_OPTIONS *pOptions, BATCH_COMPACT_STATS *pStats);
+	HRESULT Benchmark(const BATCH_OPTIONS *pOptions, const DWORD *rgdwEmployeeID, DWORD cEmployees);
+	HRESULT RunCommand(DWORD iCommand, const BATCH_OPTIONS *pOptions);
+
+private:
+	LPCWSTR				m_pwszDatabase;
+	IDBCreateSession	*m_pIDBCreateSession;	// Given up and reopened by compact and template
+};
+
+#endif // !defined(AFX_BATCHOLEDBBACKEND_H__4C81E6A2_9B37_4D50_A6F4_2E0B7D93C1A5__INCLUDED_)
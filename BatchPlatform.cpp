@@ -0,0 +1,314 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: BatchPlatform
+//
+// File: BatchPlatform.cpp
+//
+// Comment: The Win32 subset the batch driver and its file backend use, over
+//			POSIX where there is no Win32.
+//
+// Functions:
+//			1. threads and critical sections over pthreads
+//			2. a millisecond tick count over the monotonic clock
+//			3. files opened by wide name
+//			4. a file replaced by another
+//
+// Notes:
+//			Only ReplaceBatchFile is built on Windows, the rest is Win32.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "BatchPlatform.h"
+
+#if !defined(_WIN32)
+
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// A thread, what its handle points to
+//
+typedef struct tagBATCH_THREAD
+{
+	pthread_t				Thread;
+	LPTHREAD_START_ROUTINE	pfnStart;
+	LPVOID					lpParameter;
+	BOOL					fJoined;
+} BATCH_THREAD;
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ToMultiByte
+//
+// Description: Convert a file name or mode to the multibyte characters of
+//				the locale.
+//
+// Returns: FALSE if it doesn't fit or can't be converted
+//
+////////////////////////////////////////////////////////////////////////////////
+static BOOL ToMultiByte(LPCWSTR pwsz, char *psz, size_t cbMax)
+{
+	size_t cb = wcstombs(psz, pwsz, cbMax);
+
+	if ((size_t)-1 == cb || cb == cbMax)
+	{
+		errno = EINVAL;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ThreadStart
+//
+// Description: pthread start routine running the routine of a thread.
+//
+////////////////////////////////////////////////////////////////////////////////
+static void* ThreadStart(void *pvThread)
+{
+	BATCH_THREAD *pThread = (BATCH_THREAD*)pvThread;
+
+	pThread->pfnStart(pThread->lpParameter);
+
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CreateThread
+//
+// Description: Start a thread. The attributes, stack size and flags are
+//				ignored.
+//
+// Returns: The handle of the thread, NULL if it can't be started
+//
+////////////////////////////////////////////////////////////////////////////////
+HANDLE CreateThread(LPVOID /* lpThreadAttributes */, DWORD /* dwStackSize */, LPTHREAD_START_ROUTINE lpStartAddress,
+					LPVOID lpParameter, DWORD /* dwCreationFlags */, DWORD *lpThreadId)
+{
+	BATCH_THREAD	*pThread;
+	int				nError;
+
+	pThread = (BATCH_THREAD*)malloc(sizeof(BATCH_THREAD));
+	if (NULL == pThread)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	pThread->pfnStart		= lpStartAddress;
+	pThread->lpParameter	= lpParameter;
+	pThread->fJoined		= FALSE;
+
+	nError = pthread_create(&pThread->Thread, NULL, ThreadStart, pThread);
+	if (nError)
+	{
+		free(pThread);
+		errno = nError;
+		return NULL;
+	}
+
+	if (lpThreadId)
+	{
+		*lpThreadId = 0;
+	}
+
+	return pThread;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: WaitForMultipleObjects
+//
+// Description: Wait for threads to end. Only a wait for all of them without
+//				a timeout is supported.
+//
+// Returns: 0, WAIT_OBJECT_0
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD WaitForMultipleObjects(DWORD nCount, const HANDLE *lpHandles, BOOL /* bWaitAll */, DWORD /* dwMilliseconds */)
+{
+	BATCH_THREAD	*pThread;
+	DWORD			iHandle;
+
+	for (iHandle = 0; iHandle < nCount; ++iHandle)
+	{
+		pThread = (BATCH_THREAD*)lpHandles[iHandle];
+
+		if (!pThread->fJoined)
+		{
+			pthread_join(pThread->Thread, NULL);
+			pThread->fJoined = TRUE;
+		}
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CloseHandle
+//
+// Description: Free the handle of a thread. A thread still running goes on
+//				detached.
+//
+////////////////////////////////////////////////////////////////////////////////
+BOOL CloseHandle(HANDLE hObject)
+{
+	BATCH_THREAD *pThread = (BATCH_THREAD*)hObject;
+
+	if (NULL == pThread)
+	{
+		return FALSE;
+	}
+
+	if (!pThread->fJoined)
+	{
+		pthread_detach(pThread->Thread);
+	}
+
+	free(pThread);
+
+	return TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetLastError
+//
+// Description: Returns the error of the last call that failed, an errno
+//				value.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD GetLastError()
+{
+	return errno;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetTickCount
+//
+// Description: Returns the milliseconds of the monotonic clock, wrapping
+//				like the Win32 tick count.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD GetTickCount()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (DWORD)((ULONGLONG)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: InitializeCriticalSection
+//
+// Description: Initialize a critical section, a recursive mutex like the
+//				Win32 one.
+//
+////////////////////////////////////////////////////////////////////////////////
+void InitializeCriticalSection(CRITICAL_SECTION *pcs)
+{
+	pthread_mutexattr_t Attr;
+
+	pthread_mutexattr_init(&Attr);
+	pthread_mutexattr_settype(&Attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(pcs, &Attr);
+	pthread_mutexattr_destroy(&Attr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: DeleteCriticalSection
+//
+// Description: Free a critical section.
+//
+////////////////////////////////////////////////////////////////////////////////
+void DeleteCriticalSection(CRITICAL_SECTION *pcs)
+{
+	pthread_mutex_destroy(pcs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EnterCriticalSection
+//
+// Description: Wait for and own a critical section.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EnterCriticalSection(CRITICAL_SECTION *pcs)
+{
+	pthread_mutex_lock(pcs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: LeaveCriticalSection
+//
+// Description: Give up a critical section.
+//
+////////////////////////////////////////////////////////////////////////////////
+void LeaveCriticalSection(CRITICAL_SECTION *pcs)
+{
+	pthread_mutex_unlock(pcs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: _wfopen
+//
+// Description: Open a file by wide name.
+//
+// Returns: The stream, NULL if the file can't be opened
+//
+////////////////////////////////////////////////////////////////////////////////
+FILE* _wfopen(LPCWSTR pwszFile, LPCWSTR pwszMode)
+{
+	char szFile[MB_LEN_MAX * MAX_PATH];
+	char szMode[8];
+
+	if (!ToMultiByte(pwszFile, szFile, sizeof(szFile)) || !ToMultiByte(pwszMode, szMode, sizeof(szMode)))
+	{
+		return NULL;
+	}
+
+	return fopen(szFile, szMode);
+}
+
+#endif // !defined(_WIN32)
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ReplaceBatchFile
+//
+// Description: Rename a new file over another. On POSIX the rename is
+//				atomic; Windows CE has no rename over a file, the old one is
+//				deleted first.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ReplaceBatchFile(LPCWSTR pwszNewFile, LPCWSTR pwszFile)
+{
+#if defined(_WIN32)
+	if (!DeleteFile(pwszFile) && ERROR_FILE_NOT_FOUND != GetLastError())
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	if (!MoveFile(pwszNewFile, pwszFile))
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+#else
+	char szNewFile[MB_LEN_MAX * MAX_PATH];
+	char szFile[MB_LEN_MAX * MAX_PATH];
+
+	if (!ToMultiByte(pwszNewFile, szNewFile, sizeof(szNewFile)) ||
+		!ToMultiByte(pwszFile, szFile, sizeof(szFile)) ||
+		0 != rename(szNewFile, szFile))
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+#endif
+
+	return NOERROR;
+}
@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: BatchPlatform
+//
+// File: BatchPlatform.h
+//
+// Comment: The Win32 subset the batch driver and its file backend use, over
+//			POSIX where there is no Win32.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_BATCHPLATFORM_H__0C6E3A91_5B27_4D84_9F13_A2E8D70B46C5__INCLUDED_)
+#define AFX_BATCHPLATFORM_H__0C6E3A91_5B27_4D84_9F13_A2E8D70B46C5__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#if defined(_WIN32)
+
+#include "stdafx.h"
+#include <stdio.h>
+
+#else // !defined(_WIN32)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <pthread.h>
+
+typedef unsigned int		DWORD;
+typedef int					LONG;
+typedef unsigned int		ULONG;
+typedef int					BOOL;
+typedef unsigned char		BYTE;
+typedef unsigned long long	ULONGLONG;
+typedef wchar_t				WCHAR;
+typedef WCHAR				*LPWSTR;
+typedef const WCHAR			*LPCWSTR;
+typedef void				*LPVOID;
+typedef void				*HANDLE;
+typedef LONG				HRESULT;
+
+#define TRUE						1
+#define FALSE						0
+#define WINAPI
+#define CALLBACK
+#define MAX_PATH					260
+#define INFINITE					0xFFFFFFFF
+
+#define NOERROR						0
+#define S_OK						((HRESULT)0x00000000L)
+#define S_FALSE						((HRESULT)0x00000001L)
+#define E_NOTIMPL					((HRESULT)0x80004001L)
+#define E_ABORT						((HRESULT)0x80004004L)
+#define E_FAIL						((HRESULT)0x80004005L)
+#define E_OUTOFMEMORY				((HRESULT)0x8007000EL)
+#define E_INVALIDARG				((HRESULT)0x80070057L)
+#define E_UNEXPECTED				((HRESULT)0x8000FFFFL)
+#define STG_E_FILENOTFOUND			((HRESULT)0x80030002L)
+#define STG_E_WRITEFAULT			((HRESULT)0x8003001DL)
+#define STG_E_READFAULT				((HRESULT)0x8003001EL)
+
+#define SUCCEEDED(hr)				((HRESULT)(hr) >= 0)
+#define FAILED(hr)					((HRESULT)(hr) < 0)
+#define HRESULT_FROM_WIN32(x)		((HRESULT)(x) <= 0 ? (HRESULT)(x) : (HRESULT)(((x) & 0x0000FFFF) | 0x80070000))
+
+#define ERROR_FILE_NOT_FOUND		2L
+#define ERROR_SHARING_VIOLATION		32L
+#define ERROR_INSUFFICIENT_BUFFER	122L
+
+#define COINIT_MULTITHREADED		0
+
+typedef DWORD (WINAPI *LPTHREAD_START_ROUTINE)(LPVOID lpParameter);
+
+typedef pthread_mutex_t		CRITICAL_SECTION;
+
+////////////////////////////////////////////////////////////////////////////////
+// Threads. WaitForMultipleObjects waits for all the threads, without a
+// timeout; that is the only wait the driver does.
+//
+HANDLE	CreateThread(LPVOID lpThreadAttributes, DWORD dwStackSize, LPTHREAD_START_ROUTINE lpStartAddress,
+					 LPVOID lpParameter, DWORD dwCreationFlags, DWORD *lpThreadId);
+DWORD	WaitForMultipleObjects(DWORD nCount, const HANDLE *lpHandles, BOOL bWaitAll, DWORD dwMilliseconds);
+BOOL	CloseHandle(HANDLE hObject);
+DWORD	GetLastError();
+DWORD	GetTickCount();
+
+void	InitializeCriticalSection(CRITICAL_SECTION *pcs);
+void	DeleteCriticalSection(CRITICAL_SECTION *pcs);
+void	EnterCriticalSection(CRITICAL_SECTION *pcs);
+void	LeaveCriticalSection(CRITICAL_SECTION *pcs);
+
+////////////////////////////////////////////////////////////////////////////////
+// Files by wide name, converted with the locale of the process
+//
+FILE*	_wfopen(LPCWSTR pwszFile, LPCWSTR pwszMode);
+
+////////////////////////////////////////////////////////////////////////////////
+// COM is not there, the task allocator is the C heap
+//
+inline HRESULT	CoInitializeEx(LPVOID /* pvReserved */, DWORD /* dwCoInit */)	{ return S_OK; }
+inline void		CoUninitialize()									{ }
+inline LPVOID	CoTaskMemAlloc(size_t cb)							{ return malloc(cb); }
+inline LPVOID	CoTaskMemRealloc(LPVOID pv, size_t cb)				{ return realloc(pv, cb); }
+inline void		CoTaskMemFree(LPVOID pv)							{ free(pv); }
+
+inline int		_wcsicmp(LPCWSTR pwsz1, LPCWSTR pwsz2)				{ return wcscasecmp(pwsz1, pwsz2); }
+inline int		_wtoi(LPCWSTR pwsz)									{ return (int)wcstol(pwsz, NULL, 10); }
+
+#endif // !defined(_WIN32)
+
+////////////////////////////////////////////////////////////////////////////////
+// Put a new file in the place of another, which may not exist
+//
+HRESULT ReplaceBatchFile(LPCWSTR pwszNewFile, LPCWSTR pwszFile);
+
+#endif // !defined(AFX_BATCHPLATFORM_H__0C6E3A91_5B27_4D84_9F13_A2E8D70B46C5__INCLUDED_)
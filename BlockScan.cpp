@@ -0,0 +1,604 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: EmployeeBlockScan
+//
+// File: BlockScan.cpp
+//
+// Comment: Scan of Employees filtered a block of rows at a time.
+//
+// Functions:
+//			1. Compile predicates against the columns they read
+//			2. Stage the predicate columns of a block of rows, one array
+//			   per column
+//			3. Narrow a selection vector with each predicate in turn
+//			4. Fetch the requested columns of the selected rows only
+//
+// Notes:
+//			The loops over a staged column are short and free of calls so
+//			the compiler keeps them in registers; the integer test is a
+//			single unsigned compare and writes the selection vector
+//			without a branch. Rows that fail are never bound to the
+//			record the callback sees.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "EmployeeSchema.h"
+#include "BlockScan.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBlockScan::EmployeeBlockScan()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeeBlockScan::EmployeeBlockScan() :	m_cStages(0),
+											m_cTests(0)
+{
+	memset(m_rgStage, 0, sizeof(m_rgStage));
+	memset(m_rgTest, 0, sizeof(m_rgTest));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBlockScan::~EmployeeBlockScan()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeeBlockScan::~EmployeeBlockScan()
+{
+	FreeStages();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Compile
+//
+// Description: Check the predicates of the next scans and set up the
+//				staging of the columns they read. No predicates selects
+//				every row.
+//
+// Parameters
+//		rgPredicate	- predicates, all of which a row must pass
+//		cPredicates	- number of predicates
+//
+// Returns: NOERROR if succesfull, E_INVALIDARG if a predicate doesn't
+//			apply to its column
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeBlockScan::Compile(const BLOCK_PREDICATE *rgPredicate, DWORD cPredicates)
+{
+	HRESULT					hr			= NOERROR;
+	const BLOCK_PREDICATE	*pPredicate;
+	BLOCK_SCAN_TEST			*pTest;
+	BLOCK_SCAN_COLUMN		*pStage;
+	DBTYPE					wType;
+	BOOL					fString;
+	DWORD					iStage;
+
+	FreeStages();
+
+	if (cPredicates > BLOCK_SCAN_MAX_PREDICATES || (cPredicates && NULL == rgPredicate))
+	{
+		return E_INVALIDARG;
+	}
+
+	// Integer tests are cheaper, they run first and leave fewer rows to
+	// the string tests
+	//
+	for (DWORD dwPass = 0; dwPass < 2; ++dwPass)
+	{
+		for (DWORD dwPred = 0; dwPred < cPredicates; ++dwPred)
+		{
+			pPredicate = &rgPredicate[dwPred];
+
+			if (pPredicate->iColumn >= EMPLOYEE_SCHEMA_SIZE)
+			{
+				hr = E_INVALIDARG;
+				goto Exit;
+			}
+
+			wType	= g_rgEmployeeSchema[pPredicate->iColumn].wType;
+			fString	= (DBTYPE_WSTR == wType);
+
+			if (DBTYPE_I4 != wType && !fString)
+			{
+				hr = E_INVALIDARG;
+				goto Exit;
+			}
+
+			if ((1 == dwPass) != fString)
+			{
+				continue;
+			}
+
+			// One staged column serves all the predicates on it
+			//
+			for (iStage = 0; iStage < m_cStages; ++iStage)
+			{
+				if (m_rgStage[iStage].iColumn == pPredicate->iColumn)
+				{
+					break;
+				}
+			}
+
+			if (iStage == m_cStages)
+			{
+				pStage = &m_rgStage[m_cStages++];
+
+				pStage->iColumn		= pPredicate->iColumn;
+				pStage->cchStride	= fString ? g_rgEmployeeSchema[pPredicate->iColumn].ulColumnSize + 1 : 0;
+
+				if (fString)
+				{
+					pStage->pwchValues = (WCHAR*)CoTaskMemAlloc(sizeof(WCHAR) * pStage->cchStride * BLOCK_SCAN_ROWS);
+					if (NULL == pStage->pwchValues)
+					{
+						hr = E_OUTOFMEMORY;
+						goto Exit;
+					}
+				}
+			}
+
+			pTest = &m_rgTest[m_cTests++];
+
+			memset(pTest, 0, sizeof(BLOCK_SCAN_TEST));
+			pTest->dwOp		= pPredicate->dwOp;
+			pTest->iStage	= iStage;
+			pTest->fString	= fString;
+
+			if (!fString)
+			{
+				// Equality is the range of one value
+				//
+				if (BLOCK_PRED_EQUAL == pPredicate->dwOp)
+				{
+					pTest->lLow		= pPredicate->lLow;
+					pTest->dwSpan	= 0;
+				}
+				else if (BLOCK_PRED_RANGE == pPredicate->dwOp && pPredicate->lLow <= pPredicate->lHigh)
+				{
+					pTest->lLow		= pPredicate->lLow;
+					pTest->dwSpan	= (DWORD)pPredicate->lHigh - (DWORD)pPredicate->lLow;
+				}
+				else
+				{
+					hr = E_INVALIDARG;
+					goto Exit;
+				}
+
+				continue;
+			}
+
+			if ((BLOCK_PRED_EQUAL == pPredicate->dwOp || BLOCK_PRED_PREFIX == pPredicate->dwOp) && NULL == pPredicate->pwszLow)
+			{
+				hr = E_INVALIDARG;
+				goto Exit;
+			}
+
+			if ((BLOCK_PRED_EQUAL != pPredicate->dwOp &&
+				 BLOCK_PRED_PREFIX != pPredicate->dwOp &&
+				 BLOCK_PRED_RANGE != pPredicate->dwOp) ||
+				(pPredicate->pwszLow && wcslen(pPredicate->pwszLow) > BLOCK_SCAN_MAX_TEXT) ||
+				(pPredicate->pwszHigh && wcslen(pPredicate->pwszHigh) > BLOCK_SCAN_MAX_TEXT))
+			{
+				hr = E_INVALIDARG;
+				goto Exit;
+			}
+
+			if (pPredicate->pwszLow)
+			{
+				wcscpy(pTest->wszLow, pPredicate->pwszLow);
+				pTest->cchLow	= (WORD)wcslen(pTest->wszLow);
+				pTest->fLow		= TRUE;
+			}
+
+			if (BLOCK_PRED_RANGE == pPredicate->dwOp && pPredicate->pwszHigh)
+			{
+				wcscpy(pTest->wszHigh, pPredicate->pwszHigh);
+				pTest->fHigh = TRUE;
+			}
+		}
+	}
+
+Exit:
+	if(FAILED(hr))
+	{
+		FreeStages();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Scan
+//
+// Description: Scan Employees in key order and pass the rows passing the
+//				compiled predicates to a callback.
+//
+// Parameters
+//		pIDBCreateSession	- connection to the database
+//		rgiColumn			- columns bound for the callback, EMPLOYEE_COL_*
+//		cColumns			- number of columns
+//		pfnRow				- receives the selected rows
+//		pvContext			- passed to pfnRow
+//		pStats				- optionally receives the scan statistics
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeBlockScan::Scan(IDBCreateSession	*pIDBCreateSession,
+								const DWORD			*rgiColumn,
+								DWORD				cColumns,
+								PFN_BLOCK_SCAN_ROW	pfnRow,
+								LPVOID				pvContext,
+								BLOCK_SCAN_STATS	*pStats)
+{
+	HRESULT				hr					= NOERROR;			// Error code reporting
+	HRESULT				hrFetch				= NOERROR;			// Result of the last GetNextRows
+	HROW				rghRows[BLOCK_SCAN_ROWS];				// Array of row handles obtained from the rowset object
+	HROW				*prghRows			= rghRows;			// Row handle(s) pointer
+	ULONG				cRowsObtained		= 0;				// Number of rows obtained from the rowset object
+	DBBINDING			rgStageBinding[BLOCK_SCAN_MAX_PREDICATES];
+	DBBINDING			rgBinding[EMPLOYEE_SCHEMA_SIZE];
+	DWORD				rgiStageColumn[BLOCK_SCAN_MAX_PREDICATES];
+	BLOCK_SCAN_STATS	Stats;
+	DWORD				dwStart				= GetTickCount();
+	DWORD				cSelected;
+	DWORD				dwIndex;
+	BOOL				fStop				= FALSE;
+
+	IOpenRowset			*pIOpenRowset		= NULL;				// Provider Interface Pointer
+	IRowset				*pIRowset			= NULL;				// Provider Interface Pointer
+	IAccessor			*pIAccessor			= NULL;				// Provider Interface Pointer
+	HACCESSOR			hStageAccessor		= DB_NULL_HACCESSOR;// Accessor of the predicate columns
+	HACCESSOR			hRowAccessor		= DB_NULL_HACCESSOR;// Accessor of the columns of the callback
+
+	if (NULL == pIDBCreateSession || NULL == rgiColumn || NULL == pfnRow || 0 == cColumns || cColumns > EMPLOYEE_SCHEMA_SIZE)
+	{
+		return E_INVALIDARG;
+	}
+
+	for (dwIndex = 0; dwIndex < cColumns; ++dwIndex)
+	{
+		if (rgiColumn[dwIndex] >= EMPLOYEE_SCHEMA_SIZE || DBTYPE_IUNKNOWN == g_rgEmployeeSchema[rgiColumn[dwIndex]].wBindType)
+		{
+			return E_INVALIDARG;
+		}
+	}
+
+	memset(&Stats, 0, sizeof(Stats));
+
+    // Create a session object and open the table in key order
+    //
+    hr = pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pIOpenRowset);
+    if(FAILED(hr))
+    {
+        goto Exit;
+    }
+
+	hr = CheckEmployeeSchema(pIOpenRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = OpenEmployeesRowset(pIOpenRowset, 0, IID_IRowset, (IUnknown**)&pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Every row is read through the accessor of the predicate columns,
+	// the selected ones through the accessor of the callback columns
+	//
+	if (m_cStages)
+	{
+		for (dwIndex = 0; dwIndex < m_cStages; ++dwIndex)
+		{
+			rgiStageColumn[dwIndex] = m_rgStage[dwIndex].iColumn;
+		}
+
+		BindEmployeeColumns(rgiStageColumn, m_cStages, NULL, rgStageBinding);
+
+		hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, m_cStages, rgStageBinding, 0, &hStageAccessor, NULL);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+	}
+
+	BindEmployeeColumns(rgiColumn, cColumns, NULL, rgBinding);
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, cColumns, rgBinding, 0, &hRowAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	do
+	{
+		hrFetch = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, BLOCK_SCAN_ROWS, &cRowsObtained, &prghRows);
+		if (FAILED(hrFetch))
+		{
+			hr = hrFetch;
+			goto Exit;
+		}
+
+		if (0 == cRowsObtained)
+		{
+			break;
+		}
+
+		++Stats.cBlocks;
+		Stats.cRowsScanned += cRowsObtained;
+
+		hr = m_cStages ? StageBlock(pIRowset, hStageAccessor, rghRows, cRowsObtained) : NOERROR;
+		if (SUCCEEDED(hr))
+		{
+			cSelected = SelectRows(cRowsObtained);
+			Stats.cRowsSelected += cSelected;
+
+			// Only the selected rows are materialized
+			//
+			for (dwIndex = 0; dwIndex < cSelected; ++dwIndex)
+			{
+				hr = pIRowset->GetData(rghRows[m_rgiSelected[dwIndex]], hRowAccessor, &m_Row);
+				if(FAILED(hr))
+				{
+					break;
+				}
+
+				hr = pfnRow(pvContext, &m_Row);
+				if(FAILED(hr))
+				{
+					break;
+				}
+
+				if (S_FALSE == hr)
+				{
+					hr		= NOERROR;
+					fStop	= TRUE;
+					break;
+				}
+			}
+		}
+
+		pIRowset->ReleaseRows(cRowsObtained, rghRows, NULL, NULL, NULL);
+
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+	}
+	while (DB_S_ENDOFROWSET != hrFetch && !fStop);
+
+	hr = NOERROR;
+
+	Stats.dwElapsedMs = GetTickCount() - dwStart;
+
+	if (pStats)
+	{
+		*pStats = Stats;
+	}
+
+Exit:
+	if(pIAccessor)
+	{
+		if (DB_NULL_HACCESSOR != hStageAccessor)
+		{
+			pIAccessor->ReleaseAccessor(hStageAccessor, NULL);
+		}
+
+		if (DB_NULL_HACCESSOR != hRowAccessor)
+		{
+			pIAccessor->ReleaseAccessor(hRowAccessor, NULL);
+		}
+
+		pIAccessor->Release();
+	}
+
+	if(pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	if(pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StageBlock
+//
+// Description: Read the predicate columns of a block of rows into the
+//				staged columns.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeBlockScan::StageBlock(IRowset *pIRowset, HACCESSOR hAccessor, HROW *rghRows, ULONG cRows)
+{
+	HRESULT				hr;
+	BLOCK_SCAN_COLUMN	*pStage;
+	DBSTATUS			dwStatus;
+	WCHAR				*pwchValue;
+	DWORD				cch;
+
+	for (ULONG ulRow = 0; ulRow < cRows; ++ulRow)
+	{
+		hr = pIRowset->GetData(rghRows[ulRow], hAccessor, &m_Row);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+
+		for (DWORD iStage = 0; iStage < m_cStages; ++iStage)
+		{
+			pStage		= &m_rgStage[iStage];
+			dwStatus	= EMPLOYEE_ROW_STATUS(&m_Row, pStage->iColumn);
+
+			if (DBSTATUS_S_ISNULL == dwStatus)
+			{
+				pStage->rgfNull[ulRow]	= TRUE;
+				pStage->rglValue[ulRow]	= 0;
+				pStage->rgcch[ulRow]	= 0;
+				continue;
+			}
+
+			if (DBSTATUS_S_OK != dwStatus)
+			{
+				return DB_E_ERRORSOCCURRED;
+			}
+
+			pStage->rgfNull[ulRow] = FALSE;
+
+			if (0 == pStage->cchStride)
+			{
+				pStage->rglValue[ulRow] = *(LONG*)EMPLOYEE_ROW_VALUE(&m_Row, pStage->iColumn);
+				continue;
+			}
+
+			cch = EMPLOYEE_ROW_LENGTH(&m_Row, pStage->iColumn) / sizeof(WCHAR);
+			if (cch >= pStage->cchStride)
+			{
+				cch = pStage->cchStride - 1;
+			}
+
+			pwchValue = pStage->pwchValues + ulRow*pStage->cchStride;
+
+			memcpy(pwchValue, EMPLOYEE_ROW_VALUE(&m_Row, pStage->iColumn), cch*sizeof(WCHAR));
+			pwchValue[cch]			= WCHAR('\0');
+			pStage->rgcch[ulRow]	= (WORD)cch;
+		}
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SelectRows
+//
+// Description: Run the compiled predicates over the staged block. Each one
+//				keeps the indexes of the rows it passes at the front of the
+//				selection vector.
+//
+// Returns: The number of selected rows, their indexes in m_rgiSelected
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD EmployeeBlockScan::SelectRows(ULONG cRows)
+{
+	const BLOCK_SCAN_TEST	*pTest;
+	const BLOCK_SCAN_COLUMN	*pStage;
+	const WCHAR				*pwchValue;
+	DWORD					cSelected	= cRows;
+	DWORD					cKept;
+	DWORD					dwIndex;
+	BYTE					iRow;
+
+	for (dwIndex = 0; dwIndex < cRows; ++dwIndex)
+	{
+		m_rgiSelected[dwIndex] = (BYTE)dwIndex;
+	}
+
+	for (DWORD iTest = 0; iTest < m_cTests && cSelected; ++iTest)
+	{
+		pTest	= &m_rgTest[iTest];
+		pStage	= &m_rgStage[pTest->iStage];
+		cKept	= 0;
+
+		if (!pTest->fString)
+		{
+			// The index is always written and kept if the row passes
+			//
+			for (dwIndex = 0; dwIndex < cSelected; ++dwIndex)
+			{
+				iRow = m_rgiSelected[dwIndex];
+
+				m_rgiSelected[cKept] = iRow;
+				cKept += ((DWORD)pStage->rglValue[iRow] - (DWORD)pTest->lLow <= pTest->dwSpan) & !pStage->rgfNull[iRow];
+			}
+		}
+		else if (BLOCK_PRED_EQUAL == pTest->dwOp)
+		{
+			for (dwIndex = 0; dwIndex < cSelected; ++dwIndex)
+			{
+				iRow		= m_rgiSelected[dwIndex];
+				pwchValue	= pStage->pwchValues + iRow*pStage->cchStride;
+
+				m_rgiSelected[cKept] = iRow;
+				cKept += (!pStage->rgfNull[iRow] &&
+						  pStage->rgcch[iRow] == pTest->cchLow &&
+						  0 == memcmp(pwchValue, pTest->wszLow, pTest->cchLow*sizeof(WCHAR)));
+			}
+		}
+		else if (BLOCK_PRED_PREFIX == pTest->dwOp)
+		{
+			for (dwIndex = 0; dwIndex < cSelected; ++dwIndex)
+			{
+				iRow		= m_rgiSelected[dwIndex];
+				pwchValue	= pStage->pwchValues + iRow*pStage->cchStride;
+
+				m_rgiSelected[cKept] = iRow;
+				cKept += (!pStage->rgfNull[iRow] &&
+						  pStage->rgcch[iRow] >= pTest->cchLow &&
+						  0 == memcmp(pwchValue, pTest->wszLow, pTest->cchLow*sizeof(WCHAR)));
+			}
+		}
+		else
+		{
+			for (dwIndex = 0; dwIndex < cSelected; ++dwIndex)
+			{
+				iRow		= m_rgiSelected[dwIndex];
+				pwchValue	= pStage->pwchValues + iRow*pStage->cchStride;
+
+				m_rgiSelected[cKept] = iRow;
+				cKept += (!pStage->rgfNull[iRow] &&
+						  (!pTest->fLow || wcscmp(pwchValue, pTest->wszLow) >= 0) &&
+						  (!pTest->fHigh || wcscmp(pwchValue, pTest->wszHigh) <= 0));
+			}
+		}
+
+		cSelected = cKept;
+	}
+
+	return cSelected;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FreeStages
+//
+// Description: Drop the compiled predicates and their staged columns.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeeBlockScan::FreeStages()
+{
+	for (DWORD iStage = 0; iStage < m_cStages; ++iStage)
+	{
+		if (m_rgStage[iStage].pwchValues)
+		{
+			CoTaskMemFree(m_rgStage[iStage].pwchValues);
+		}
+	}
+
+	memset(m_rgStage, 0, sizeof(m_rgStage));
+
+	m_cStages	= 0;
+	m_cTests	= 0;
+}
@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: EmployeeBlockScan
+//
+// File: BlockScan.h
+//
+// Comment: Scan of Employees filtered a block of rows at a time.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_BLOCKSCAN_H__5E0A9C37_D4B2_4C81_A6F3_18E7B29D0C54__INCLUDED_)
+#define AFX_BLOCKSCAN_H__5E0A9C37_D4B2_4C81_A6F3_18E7B29D0C54__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define BLOCK_SCAN_ROWS				64				// Row handles fetched and tested per block
+#define BLOCK_SCAN_MAX_PREDICATES	8
+#define BLOCK_SCAN_MAX_TEXT			64				// Characters of a string constant
+
+// Predicate operators
+//
+#define BLOCK_PRED_EQUAL			0				// Column = value
+#define BLOCK_PRED_PREFIX			1				// Column starts with value, strings only
+#define BLOCK_PRED_RANGE			2				// Low <= column <= high
+
+////////////////////////////////////////////////////////////////////////////////
+// A condition on a column of Employees. A row passes a scan when it passes
+// all of them. NULL passes nothing. Strings are compared by character
+// code, case included.
+//
+typedef struct tagBLOCK_PREDICATE
+{
+	DWORD		iColumn;						// EMPLOYEE_COL_*, an I4 or WSTR column
+	DWORD		dwOp;							// BLOCK_PRED_*
+	LONG		lLow;							// I4 value, or low bound of a range
+	LONG		lHigh;							// I4 high bound of a range
+	LPCWSTR		pwszLow;						// WSTR value, or low bound of a range, NULL for none
+	LPCWSTR		pwszHigh;						// WSTR high bound of a range, NULL for none
+} BLOCK_PREDICATE;
+
+////////////////////////////////////////////////////////////////////////////////
+// Receives the rows passing a scan in EmployeeID order, with the columns
+// asked for bound. Returning S_FALSE ends the scan.
+//
+typedef HRESULT (CALLBACK *PFN_BLOCK_SCAN_ROW)(LPVOID pvContext, const EMPLOYEE_ROW *pRow);
+
+////////////////////////////////////////////////////////////////////////////////
+// Scan statistics
+//
+typedef struct tagBLOCK_SCAN_STATS
+{
+	DWORD		cBlocks;						// Blocks of rows fetched
+	DWORD		cRowsScanned;					// Rows tested
+	DWORD		cRowsSelected;					// Rows passing the predicates
+	DWORD		dwElapsedMs;
+} BLOCK_SCAN_STATS;
+
+////////////////////////////////////////////////////////////////////////////////
+// A column the predicates read, staged for a block of rows. Each value has
+// the same place in every array.
+//
+typedef struct tagBLOCK_SCAN_COLUMN
+{
+	DWORD		iColumn;						// EMPLOYEE_COL_*
+	DWORD		cchStride;						// Characters per string value, terminator included
+	LONG		rglValue[BLOCK_SCAN_ROWS];		// I4 values
+	WORD		rgcch[BLOCK_SCAN_ROWS];			// String lengths
+	BYTE		rgfNull[BLOCK_SCAN_ROWS];
+	WCHAR		*pwchValues;					// String values, cchStride each
+} BLOCK_SCAN_COLUMN;
+
+////////////////////////////////////////////////////////////////////////////////
+// A predicate compiled against its staged column
+//
+typedef struct tagBLOCK_SCAN_TEST
+{
+	DWORD		dwOp;
+	DWORD		iStage;							// Index of the staged column
+	BOOL		fString;
+	LONG		lLow;
+	DWORD		dwSpan;							// lHigh - lLow, compared unsigned
+	BOOL		fLow;							// String bounds present
+	BOOL		fHigh;
+	WCHAR		wszLow[BLOCK_SCAN_MAX_TEXT + 1];
+	WORD		cchLow;
+	WCHAR		wszHigh[BLOCK_SCAN_MAX_TEXT + 1];
+} BLOCK_SCAN_TEST;
+
+////////////////////////////////////////////////////////////////////////////////
+// Scans Employees in key order a block of row handles at a time. Only the
+// columns the predicates read are fetched for every row, into one array
+// per column. Each predicate runs over the whole block and narrows a
+// selection vector of row indexes; integer predicates run before string
+// predicates. The columns asked for are fetched for the selected rows
+// only.
+//
+class EmployeeBlockScan
+{
+public:
+	EmployeeBlockScan();
+	~EmployeeBlockScan();
+
+	HRESULT Compile(const BLOCK_PREDICATE *rgPredicate, DWORD cPredicates);
+
+	HRESULT Scan(IDBCreateSession		*pIDBCreateSession,
+				 const DWORD			*rgiColumn,
+				 DWORD					cColumns,
+				 PFN_BLOCK_SCAN_ROW		pfnRow,
+				 LPVOID					pvContext,
+				 BLOCK_SCAN_STATS		*pStats);
+
+private:
+	HRESULT StageBlock(IRowset *pIRowset, HACCESSOR hAccessor, HROW *rghRows, ULONG cRows);
+	DWORD	SelectRows(ULONG cRows);
+	void	FreeStages();
+
+	BLOCK_SCAN_COLUMN	m_rgStage[BLOCK_SCAN_MAX_PREDICATES];
+	DWORD				m_cStages;
+	BLOCK_SCAN_TEST		m_rgTest[BLOCK_SCAN_MAX_PREDICATES];
+	DWORD				m_cTests;
+	BYTE				m_rgiSelected[BLOCK_SCAN_ROWS];		// Selection vector
+	EMPLOYEE_ROW		m_Row;
+};
+
+#endif // !defined(AFX_BLOCKSCAN_H__5E0A9C37_D4B2_4C81_A6F3_18E7B29D0C54__INCLUDED_)
@@ -0,0 +1,729 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: BulkUpdate
+//
+// File: BulkUpdate.cpp
+//
+// Comment: Keyed update of many employees in one ordered walk of PK_Employees.
+//
+// Functions:
+//			1. Bind the updated columns once
+//			2. Sort the changes by EmployeeID
+//			3. Merge the sorted changes with PK_Employees, one transaction
+//			   per batch of changes
+//			4. Report progress and throughput
+//
+// Notes:
+//			The values are bound as text and converted by the provider, so
+//			the changes of any scalar column can be given the way they are
+//			typed in the employees dialog.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "ChangeLog.h"
+#include "BatchLookup.h"
+#include "BulkUpdate.h"
+#include "ResultCache.h"
+#include "AddressIndex.h"
+#include "CompactScheduler.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBulkUpdate::EmployeeBulkUpdate()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeeBulkUpdate::EmployeeBulkUpdate() : m_pISession(NULL),
+										   m_pITxnLocal(NULL),
+										   m_pDBColumnInfo(NULL),
+										   m_pStringsBuffer(NULL),
+										   m_cBindings(0),
+										   m_cbRowSize(0),
+										   m_pData(NULL),
+										   m_pOldData(NULL)
+{
+	memset(m_rgBinding, 0, sizeof(m_rgBinding));
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBulkUpdate::~EmployeeBulkUpdate()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeeBulkUpdate::~EmployeeBulkUpdate()
+{
+	Close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBulkUpdate::Open()
+//
+// Description: Bind the columns to update.
+//
+// Parameters
+//		pISession		- session the changes are written on, used by one
+//						  thread at a time until Close
+//		rgpwszColumns	- Employees columns to update. BLOB columns and
+//						  EmployeeID can't be updated.
+//		cColumns		- number of columns
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeBulkUpdate::Open(IOpenRowset *pISession, WCHAR **rgpwszColumns, DWORD cColumns)
+{
+	HRESULT			hr				= NOERROR;
+	IColumnsInfo	*pIColumnsInfo	= NULL;			// Provider Interface Pointer
+	ULONG			ulNumCols		= 0;
+	ULONG			ulCol;
+	DWORD			dwOffset		= 0;
+	DWORD			dwIndex;
+	LPCWSTR			pwszColumn;
+
+	if (NULL == pISession || NULL == rgpwszColumns || 0 == cColumns || cColumns > BULK_UPDATE_MAX_COLUMNS)
+	{
+		return E_INVALIDARG;
+	}
+
+	if (m_pISession)
+	{
+		return E_UNEXPECTED;
+	}
+
+	memset(&m_Stats, 0, sizeof(m_Stats));
+
+	m_pISession = pISession;
+	m_pISession->AddRef();
+
+	hr = m_pISession->QueryInterface(IID_ITransactionLocal, (void**)&m_pITxnLocal);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// The column metadata of the index rowset is kept for the change log
+	//
+	hr = OpenEmployeesRowset(m_pISession, ROWSET_OPT_INDEX, IID_IColumnsInfo, (IUnknown**)&pIColumnsInfo);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIColumnsInfo->GetColumnInfo(&ulNumCols, &m_pDBColumnInfo, &m_pStringsBuffer);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// EmployeeID is bound first for the seek and the key of the rows read.
+	// The updated columns are bound as text.
+	//
+	for (dwIndex = 0; dwIndex <= cColumns; ++dwIndex)
+	{
+		pwszColumn = (0 == dwIndex) ? L"EmployeeID" : rgpwszColumns[dwIndex - 1];
+
+		if (NULL == pwszColumn || (dwIndex && 0 == _wcsicmp(pwszColumn, L"EmployeeID")))
+		{
+			hr = E_INVALIDARG;
+			goto Exit;
+		}
+
+		for (ulCol = 0; ulCol < ulNumCols; ++ulCol)
+		{
+			if (m_pDBColumnInfo[ulCol].pwszName && 0 == _wcsicmp(m_pDBColumnInfo[ulCol].pwszName, pwszColumn))
+			{
+				break;
+			}
+		}
+
+		if (ulCol == ulNumCols)
+		{
+			hr = E_FAIL;
+			goto Exit;
+		}
+
+		if (DBTYPE_BYTES == m_pDBColumnInfo[ulCol].wType)
+		{
+			hr = E_INVALIDARG;
+			goto Exit;
+		}
+
+		m_rgBinding[dwIndex].iOrdinal	= m_pDBColumnInfo[ulCol].iOrdinal;
+		m_rgBinding[dwIndex].pTypeInfo	= NULL;
+		m_rgBinding[dwIndex].pObject	= NULL;
+		m_rgBinding[dwIndex].pBindExt	= NULL;
+		m_rgBinding[dwIndex].dwMemOwner	= DBMEMOWNER_CLIENTOWNED;
+		m_rgBinding[dwIndex].dwFlags	= 0;
+		m_rgBinding[dwIndex].bPrecision	= m_pDBColumnInfo[ulCol].bPrecision;
+		m_rgBinding[dwIndex].bScale		= m_pDBColumnInfo[ulCol].bScale;
+		m_rgBinding[dwIndex].dwPart		= DBPART_VALUE | DBPART_STATUS | DBPART_LENGTH;
+		m_rgBinding[dwIndex].obLength	= dwOffset;
+		m_rgBinding[dwIndex].obStatus	= m_rgBinding[dwIndex].obLength + sizeof(ULONG);
+		m_rgBinding[dwIndex].obValue	= m_rgBinding[dwIndex].obStatus + sizeof(DBSTATUS);
+
+		if (0 == dwIndex)
+		{
+			m_rgBinding[dwIndex].wType		= m_pDBColumnInfo[ulCol].wType;
+			m_rgBinding[dwIndex].cbMaxLen	= m_pDBColumnInfo[ulCol].ulColumnSize;
+		}
+		else if (DBTYPE_WSTR == m_pDBColumnInfo[ulCol].wType)
+		{
+			m_rgBinding[dwIndex].wType		= DBTYPE_WSTR;
+			m_rgBinding[dwIndex].cbMaxLen	= sizeof(WCHAR)*(m_pDBColumnInfo[ulCol].ulColumnSize + 1);	// Extra buffer for null terminator
+		}
+		else
+		{
+			m_rgBinding[dwIndex].wType		= DBTYPE_WSTR;
+			m_rgBinding[dwIndex].cbMaxLen	= sizeof(WCHAR)*(BULK_UPDATE_MAX_VALUE + 1);
+		}
+
+		// Calculate the offset, and properly align it
+		//
+		dwOffset = m_rgBinding[dwIndex].obValue + m_rgBinding[dwIndex].cbMaxLen;
+		dwOffset = ROUND_UP(dwOffset, COLUMN_ALIGNVAL);
+	}
+
+	m_cBindings = cColumns + 1;
+	m_cbRowSize = dwOffset;
+
+	m_pData		= (BYTE*)CoTaskMemAlloc(m_cbRowSize);
+	m_pOldData	= (BYTE*)CoTaskMemAlloc(m_cbRowSize);
+	if (NULL == m_pData || NULL == m_pOldData)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+Exit:
+	if (pIColumnsInfo)
+	{
+		pIColumnsInfo->Release();
+	}
+
+	if (FAILED(hr))
+	{
+		Close();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBulkUpdate::Close()
+//
+// Description: Release the session and the bindings.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeeBulkUpdate::Close()
+{
+	if (m_pData)
+	{
+		CoTaskMemFree(m_pData);
+		m_pData = NULL;
+	}
+
+	if (m_pOldData)
+	{
+		CoTaskMemFree(m_pOldData);
+		m_pOldData = NULL;
+	}
+
+	if (m_pDBColumnInfo)
+	{
+		CoTaskMemFree(m_pDBColumnInfo);
+		m_pDBColumnInfo = NULL;
+	}
+
+	if (m_pStringsBuffer)
+	{
+		CoTaskMemFree(m_pStringsBuffer);
+		m_pStringsBuffer = NULL;
+	}
+
+	if (m_pITxnLocal)
+	{
+		m_pITxnLocal->Release();
+		m_pITxnLocal = NULL;
+	}
+
+	if (m_pISession)
+	{
+		m_pISession->Release();
+		m_pISession = NULL;
+	}
+
+	m_cBindings = 0;
+	m_cbRowSize = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBulkUpdate::Apply()
+//
+// Description: Apply a list of changes.
+//
+// Parameters
+//		rgChanges		- the changes, in any order
+//		cChanges		- number of changes
+//		cTxnRows		- changes per transaction, 0 for BULK_UPDATE_TXN_ROWS
+//		hWndProgress	- window receiving WM_BULK_UPDATE_PROGRESS, or NULL
+//
+// Returns: NOERROR if succesfull. The transactions committed before a
+//			failure stay committed. Changes of employees that don't exist
+//			are counted in the statistics.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeBulkUpdate::Apply(const BULK_UPDATE_CHANGE *rgChanges, DWORD cChanges, DWORD cTxnRows, HWND hWndProgress)
+{
+	HRESULT				hr			= NOERROR;
+	BATCH_LOOKUP_KEY	*rgKeys		= NULL;
+	DWORD				dwStartMs	= GetTickCount();
+	DWORD				dwElapsedMs;
+	DWORD				dwTxnStartMs;
+	DWORD				cDone		= 0;
+	DWORD				cKeys;
+	DWORD				dwIndex;
+	LPCWSTR				pwszValue;
+
+	if (NULL == rgChanges || 0 == cChanges)
+	{
+		return E_INVALIDARG;
+	}
+
+	if (NULL == m_pISession)
+	{
+		return E_UNEXPECTED;
+	}
+
+	if (0 == cTxnRows)
+	{
+		cTxnRows = BULK_UPDATE_TXN_ROWS;
+	}
+
+	// Refuse values that would be truncated before anything is written
+	//
+	for (DWORD iChange = 0; iChange < cChanges; ++iChange)
+	{
+		for (dwIndex = 1; dwIndex < m_cBindings; ++dwIndex)
+		{
+			pwszValue = rgChanges[iChange].rgpwszValues[dwIndex - 1];
+			if (pwszValue && (wcslen(pwszValue) + 1) * sizeof(WCHAR) > m_rgBinding[dwIndex].cbMaxLen)
+			{
+				return E_INVALIDARG;
+			}
+		}
+	}
+
+	rgKeys = (BATCH_LOOKUP_KEY*)CoTaskMemAlloc(cChanges * sizeof(BATCH_LOOKUP_KEY));
+	if (NULL == rgKeys)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	for (DWORD iKey = 0; iKey < cChanges; ++iKey)
+	{
+		rgKeys[iKey].dwEmployeeID	= rgChanges[iKey].dwEmployeeID;
+		rgKeys[iKey].iID			= iKey;
+	}
+
+	SortLookupKeys(rgKeys, cChanges);
+
+	m_Stats.cChanges += cChanges;
+
+	while (cDone < cChanges)
+	{
+		cKeys = (cChanges - cDone < cTxnRows) ? cChanges - cDone : cTxnRows;
+
+		dwTxnStartMs = GetTickCount();
+
+		hr = ApplyTransaction(rgChanges, rgKeys + cDone, cKeys);
+
+		// Keeps the compaction away while updates run
+		//
+		g_CompactScheduler.NoteForegroundActivity(GetTickCount() - dwTxnStartMs);
+
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		cDone += cKeys;
+		++m_Stats.cTransactions;
+
+		dwElapsedMs = GetTickCount() - dwStartMs;
+
+		if (hWndProgress)
+		{
+			PostMessage(hWndProgress,
+						WM_BULK_UPDATE_PROGRESS,
+						(WPARAM)(cDone * 100 / cChanges),
+						(LPARAM)(dwElapsedMs ? (ULONGLONG)cDone * 1000 / dwElapsedMs : cDone));
+		}
+	}
+
+Exit:
+	m_Stats.dwElapsedMs		+= GetTickCount() - dwStartMs;
+	m_Stats.dwRowsPerSecond	 = m_Stats.dwElapsedMs ? (DWORD)((ULONGLONG)m_Stats.cApplied * 1000 / m_Stats.dwElapsedMs) : m_Stats.cApplied;
+
+	if (rgKeys)
+	{
+		CoTaskMemFree(rgKeys);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBulkUpdate::ApplyTransaction()
+//
+// Description: Apply a run of sorted changes in one transaction.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeBulkUpdate::ApplyTransaction(const BULK_UPDATE_CHANGE *rgChanges, const BATCH_LOOKUP_KEY *rgKeys, DWORD cKeys)
+{
+	HRESULT				hr					= NOERROR;
+	IRowsetIndex		*pIRowsetIndex		= NULL;					// Provider Interface Pointer
+	IRowset				*pIRowset			= NULL;					// Provider Interface Pointer
+	IRowsetChange		*pIRowsetChange		= NULL;					// Provider Interface Pointer
+	IAccessor			*pIAccessor			= NULL;					// Provider Interface Pointer
+	HACCESSOR			hKeyAccessor		= DB_NULL_HACCESSOR;	// EmployeeID only
+	HACCESSOR			hUpdateAccessor		= DB_NULL_HACCESSOR;	// The updated columns only
+	ChangeLogWriter		ChangeLog;									// Change log entries of the updates
+	BOOL				fStarted			= FALSE;
+	DWORD				cApplied			= m_Stats.cApplied;
+	DWORD				cMissing			= m_Stats.cMissing;
+	DWORD				iKey;
+
+	// Open the change log on this session, so that its entries are part
+	// of the transaction
+	//
+	hr = ChangeLog.Open(m_pISession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = m_pITxnLocal->StartTransaction(ISOLATIONLEVEL_READCOMMITTED | ISOLATIONLEVEL_CURSORSTABILITY, 0, NULL, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	fStarted = TRUE;
+
+	hr = OpenEmployeesRowset(m_pISession, ROWSET_OPT_INDEX | ROWSET_OPT_CHANGE, IID_IRowsetIndex, (IUnknown**)&pIRowsetIndex);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowsetIndex->QueryInterface(IID_IRowset, (void**)&pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->QueryInterface(IID_IRowsetChange, (void**)&pIRowsetChange);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, 1, m_rgBinding, m_cbRowSize, &hKeyAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, m_cBindings - 1, m_rgBinding + 1, m_cbRowSize, &hUpdateAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = Walk(pIRowsetIndex, pIRowset, pIRowsetChange, hKeyAccessor, hUpdateAccessor, &ChangeLog, rgChanges, rgKeys, cKeys);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = m_pITxnLocal->Commit(FALSE, XACTTC_SYNC, 0);
+	if(SUCCEEDED(hr))
+	{
+		fStarted = FALSE;
+
+		for (iKey = 0; iKey < cKeys; ++iKey)
+		{
+			g_ResultCache.InvalidateEmployee(rgKeys[iKey].dwEmployeeID);
+			g_AddressIndex.MarkChanged(rgKeys[iKey].dwEmployeeID);
+		}
+	}
+
+Exit:
+	if (fStarted)
+	{
+		m_pITxnLocal->Abort(NULL, FALSE, FALSE);
+	}
+
+	// Nothing of an aborted transaction was applied
+	//
+	if (FAILED(hr))
+	{
+		m_Stats.cApplied = cApplied;
+		m_Stats.cMissing = cMissing;
+	}
+
+	if (DB_NULL_HACCESSOR != hUpdateAccessor)
+	{
+		pIAccessor->ReleaseAccessor(hUpdateAccessor, NULL);
+	}
+
+	if (DB_NULL_HACCESSOR != hKeyAccessor)
+	{
+		pIAccessor->ReleaseAccessor(hKeyAccessor, NULL);
+	}
+
+	if (pIAccessor)
+	{
+		pIAccessor->Release();
+	}
+
+	if (pIRowsetChange)
+	{
+		pIRowsetChange->Release();
+	}
+
+	if (pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	if (pIRowsetIndex)
+	{
+		pIRowsetIndex->Release();
+	}
+
+	ChangeLog.Close();
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBulkUpdate::Walk()
+//
+// Description: Merge the sorted changes with PK_Employees. A change far
+//				ahead of the current row is found with a DBSEEK_GE seek, a
+//				change close to it by reading forward. Only EmployeeID is
+//				read from the rows that are stepped over.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeBulkUpdate::Walk(IRowsetIndex	*pIRowsetIndex,
+								 IRowset		*pIRowset,
+								 IRowsetChange	*pIRowsetChange,
+								 HACCESSOR		hKeyAccessor,
+								 HACCESSOR		hUpdateAccessor,
+								 ChangeLogWriter *pChangeLog,
+								 const BULK_UPDATE_CHANGE *rgChanges,
+								 const BATCH_LOOKUP_KEY *rgKeys,
+								 DWORD			cKeys)
+{
+	HRESULT		hr				= NOERROR;
+	HROW		rghRows[1];								// Current row
+	HROW		*prghRows		= rghRows;
+	ULONG		cRowsObtained	= 0;
+	BOOL		fPositioned		= FALSE;
+	BOOL		fHaveRow		= FALSE;
+	DWORD		dwRowID			= 0;
+	DWORD		dwTarget;
+	DWORD		iKey			= 0;
+	DWORD		dwIndex;
+	LPCWSTR		pwszValue;
+
+	while (iKey < cKeys)
+	{
+		dwTarget = rgKeys[iKey].dwEmployeeID;
+
+		// Seek when the next change is too far ahead to read forward to it
+		//
+		if (!fPositioned || (fHaveRow && dwRowID < dwTarget && dwTarget - dwRowID > BATCH_LOOKUP_SEEK_GAP))
+		{
+			if (fHaveRow)
+			{
+				pIRowset->ReleaseRows(1, rghRows, NULL, NULL, NULL);
+				fHaveRow = FALSE;
+			}
+
+			memset(m_pData, 0, m_cbRowSize);
+			*(ULONG*)(m_pData+m_rgBinding[0].obLength)		= 4;
+			*(DBSTATUS*)(m_pData+m_rgBinding[0].obStatus)	= DBSTATUS_S_OK;
+			*(int*)(m_pData+m_rgBinding[0].obValue)			= dwTarget;
+
+			hr = pIRowsetIndex->Seek(hKeyAccessor, 1, m_pData, DBSEEK_GE);
+			++m_Stats.cSeeks;
+
+			// No employee at or after the key, the remaining changes are missing
+			//
+			if (DB_E_NOTFOUND == hr)
+			{
+				hr = NOERROR;
+				break;
+			}
+
+			if(FAILED(hr))
+			{
+				goto Exit;
+			}
+
+			fPositioned = TRUE;
+		}
+
+		// Step to the next row until it reaches the key
+		//
+		if (!fHaveRow || dwRowID < dwTarget)
+		{
+			if (fHaveRow)
+			{
+				pIRowset->ReleaseRows(1, rghRows, NULL, NULL, NULL);
+				fHaveRow = FALSE;
+			}
+
+			hr = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, 1, &cRowsObtained, &prghRows);
+			if(FAILED(hr))
+			{
+				goto Exit;
+			}
+
+			if (0 == cRowsObtained)
+			{
+				hr = NOERROR;
+				break;
+			}
+
+			fHaveRow = TRUE;
+			++m_Stats.cRowsRead;
+
+			memset(m_pData, 0, m_cbRowSize);
+
+			hr = pIRowset->GetData(rghRows[0], hKeyAccessor, m_pData);
+			if(FAILED(hr))
+			{
+				goto Exit;
+			}
+
+			dwRowID = *(int*)(m_pData+m_rgBinding[0].obValue);
+			continue;
+		}
+
+		// The row is past the key, the employee doesn't exist
+		//
+		if (dwRowID != dwTarget)
+		{
+			while (iKey < cKeys && rgKeys[iKey].dwEmployeeID == dwTarget)
+			{
+				++m_Stats.cMissing;
+				++iKey;
+			}
+			continue;
+		}
+
+		// Apply every change of the employee, in the order given
+		//
+		for (; iKey < cKeys && rgKeys[iKey].dwEmployeeID == dwTarget; ++iKey)
+		{
+			memset(m_pOldData, 0, m_cbRowSize);
+
+			hr = pIRowset->GetData(rghRows[0], hUpdateAccessor, m_pOldData);
+			if(FAILED(hr))
+			{
+				goto Exit;
+			}
+
+			memset(m_pData, 0, m_cbRowSize);
+
+			for (dwIndex = 1; dwIndex < m_cBindings; ++dwIndex)
+			{
+				pwszValue = rgChanges[rgKeys[iKey].iID].rgpwszValues[dwIndex - 1];
+
+				if (NULL == pwszValue)
+				{
+					*(ULONG*)(m_pData+m_rgBinding[dwIndex].obLength)	= 0;
+					*(DBSTATUS*)(m_pData+m_rgBinding[dwIndex].obStatus)	= DBSTATUS_S_ISNULL;
+					continue;
+				}
+
+				wcscpy((WCHAR*)(m_pData+m_rgBinding[dwIndex].obValue), pwszValue);
+				*(ULONG*)(m_pData+m_rgBinding[dwIndex].obLength)	= wcslen(pwszValue)*sizeof(WCHAR);
+				*(DBSTATUS*)(m_pData+m_rgBinding[dwIndex].obStatus)	= DBSTATUS_S_OK;
+			}
+
+			hr = pIRowsetChange->SetData(rghRows[0], hUpdateAccessor, m_pData);
+			if(FAILED(hr))
+			{
+				goto Exit;
+			}
+
+			// Log the columns that changed
+			//
+			hr = pChangeLog->AppendRowChanges(dwTarget,
+											  CHANGE_OP_UPDATE,
+											  m_rgBinding + 1,
+											  m_cBindings - 1,
+											  m_pDBColumnInfo,
+											  m_pOldData,
+											  m_pData);
+			if(FAILED(hr))
+			{
+				goto Exit;
+			}
+
+			++m_Stats.cApplied;
+		}
+	}
+
+	// Changes left when the index ran out are of missing employees
+	//
+	m_Stats.cMissing += cKeys - iKey;
+
+Exit:
+	if (fHaveRow)
+	{
+		pIRowset->ReleaseRows(1, rghRows, NULL, NULL, NULL);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeBulkUpdate::GetStats()
+//
+// Description: Returns the statistics of the changes applied so far.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeeBulkUpdate::GetStats(BULK_UPDATE_STATS *pStats)
+{
+	if (pStats)
+	{
+		*pStats = m_Stats;
+	}
+}
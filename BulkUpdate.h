@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: BulkUpdate
+//
+// File: BulkUpdate.h
+//
+// Comment: Keyed update of many employees in one ordered walk of PK_Employees.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_BULKUPDATE_H__2C7A9F40_8B13_4D6E_A51F_C09E3B6D7148__INCLUDED_)
+#define AFX_BULKUPDATE_H__2C7A9F40_8B13_4D6E_A51F_C09E3B6D7148__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define BULK_UPDATE_MAX_COLUMNS		16
+#define BULK_UPDATE_MAX_VALUE		255				// Characters of a value that isn't a string column
+#define BULK_UPDATE_TXN_ROWS		256				// Default changes per transaction
+
+// Progress message posted to the notification window after each transaction.
+// wParam is the percentage completed, lParam the rows updated per second so
+// far.
+//
+#define WM_BULK_UPDATE_PROGRESS		(WM_APP + 0x34)
+
+////////////////////////////////////////////////////////////////////////////////
+// One change. rgpwszValues[i] is the new value of the i-th column given to
+// Open, as text; NULL sets the column to NULL.
+//
+typedef struct tagBULK_UPDATE_CHANGE
+{
+	DWORD		dwEmployeeID;
+	LPCWSTR		rgpwszValues[BULK_UPDATE_MAX_COLUMNS];
+} BULK_UPDATE_CHANGE;
+
+////////////////////////////////////////////////////////////////////////////////
+// Bulk update statistics, accumulated over the calls to Apply
+//
+typedef struct tagBULK_UPDATE_STATS
+{
+	DWORD		cChanges;
+	DWORD		cApplied;
+	DWORD		cMissing;								// Changes of employees that don't exist
+	DWORD		cTransactions;
+	DWORD		cSeeks;
+	DWORD		cRowsRead;								// Rows fetched by the forward reads
+	DWORD		dwElapsedMs;
+	DWORD		dwRowsPerSecond;
+} BULK_UPDATE_STATS;
+
+////////////////////////////////////////////////////////////////////////////////
+// Applies changes to a fixed set of Employees columns. Each call to Apply
+// sorts its changes by EmployeeID and walks PK_Employees in key order on one
+// updatable rowset, seeking over large gaps and reading forward over small
+// ones. A single accessor binds just the updated columns. The changes are
+// committed in transactions of cTxnRows changes, together with their change
+// log entries. Changes of the same employee are applied in the given order.
+//
+class EmployeeBulkUpdate
+{
+public:
+	EmployeeBulkUpdate();
+	~EmployeeBulkUpdate();
+
+	HRESULT Open(IOpenRowset *pISession, WCHAR **rgpwszColumns, DWORD cColumns);
+	void	Close();
+
+	HRESULT Apply(const BULK_UPDATE_CHANGE *rgChanges, DWORD cChanges, DWORD cTxnRows, HWND hWndProgress);
+
+	void	GetStats(BULK_UPDATE_STATS *pStats);
+
+private:
+	HRESULT ApplyTransaction(const BULK_UPDATE_CHANGE *rgChanges, const BATCH_LOOKUP_KEY *rgKeys, DWORD cKeys);
+	HRESULT Walk(IRowsetIndex	*pIRowsetIndex,
+				 IRowset		*pIRowset,
+				 IRowsetChange	*pIRowsetChange,
+				 HACCESSOR		hKeyAccessor,
+				 HACCESSOR		hUpdateAccessor,
+				 ChangeLogWriter *pChangeLog,
+				 const BULK_UPDATE_CHANGE *rgChanges,
+				 const BATCH_LOOKUP_KEY *rgKeys,
+				 DWORD			cKeys);
+
+	IOpenRowset			*m_pISession;
+	ITransactionLocal	*m_pITxnLocal;
+	DBCOLUMNINFO		*m_pDBColumnInfo;				// Indexed by ordinal, for the change log
+	WCHAR				*m_pStringsBuffer;
+	DBBINDING			m_rgBinding[BULK_UPDATE_MAX_COLUMNS + 1];	// EmployeeID, then the columns
+	DWORD				m_cBindings;
+	DWORD				m_cbRowSize;
+	BYTE				*m_pData;						// New row image
+	BYTE				*m_pOldData;					// Row image before the change
+	BULK_UPDATE_STATS	m_Stats;
+};
+
+#endif // !defined(AFX_BULKUPDATE_H__2C7A9F40_8B13_4D6E_A51F_C09E3B6D7148__INCLUDED_)
@@ -0,0 +1,1287 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: ChangeLog
+//
+// File: ChangeLog.cpp
+//
+// Comment: Append-only change log of the Employees table.
+//
+// Functions:
+//			1. Append column changes in the transaction of the mutation
+//			2. Read the changes that follow a sequence number
+//			3. Compact the log once consumers have caught up
+//
+// Notes:
+//			Compaction deletes the oldest entries and rewrites the newest
+//			discarded entry as a CHANGE_OP_COMPACTED marker. A cursor that
+//			starts before the marker lands on it first, which is how a
+//			consumer learns that it fell behind the retained range.
+//
+//			A writer inserts the first entry of a transaction, reads its
+//			ChangeSeq and adds itself to g_ChangeLogWriters under one lock.
+//			A reader reads MAX(ChangeSeq) before it takes GetStableSequence,
+//			so every writer still open below that maximum is in the list.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "ChangeLog.h"
+
+ChangeLogWriters	g_ChangeLogWriters;				// Writers with open transactions in this process
+
+// Columns written by ChangeLogWriter, in binding order
+//
+static WCHAR* g_rgpwszWriterColumns[] =	{
+											L"EmployeeID",
+											L"Operation",
+											L"ColumnName",
+											L"OldValue",
+											L"NewValue"
+										};
+
+// Columns read by ChangeLogCursor, in binding order. The key comes first
+// so that the accessor can be used to seek.
+//
+static WCHAR* g_rgpwszCursorColumns[] =	{
+											L"ChangeSeq",
+											L"EmployeeID",
+											L"Operation",
+											L"ColumnName",
+											L"OldValue",
+											L"NewValue",
+											L"ChangeTime"
+										};
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SetStringValue
+//
+// Description: Store a string, or NULL, in a bound WSTR column, truncating
+//				it to the column size.
+//
+////////////////////////////////////////////////////////////////////////////////
+static void SetStringValue(BYTE *pData, DBBINDING *pBinding, LPCWSTR pwszValue)
+{
+	DWORD	cchMax = pBinding->cbMaxLen/sizeof(WCHAR) - 1;
+	WCHAR	*pwszDst = (WCHAR*)(pData + pBinding->obValue);
+
+	if (NULL == pwszValue)
+	{
+		*(ULONG*)(pData + pBinding->obLength)		= 0;
+		*(DBSTATUS*)(pData + pBinding->obStatus)	= DBSTATUS_S_ISNULL;
+		return;
+	}
+
+	wcsncpy(pwszDst, pwszValue, cchMax);
+	pwszDst[cchMax] = WCHAR('\0');
+
+	*(ULONG*)(pData + pBinding->obLength)		= wcslen(pwszDst)*sizeof(WCHAR);
+	*(DBSTATUS*)(pData + pBinding->obStatus)	= DBSTATUS_S_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetStringValue
+//
+// Description: Copy a bound WSTR column into a caller buffer.
+//
+// Returns: TRUE if the column is NULL
+//
+////////////////////////////////////////////////////////////////////////////////
+static BOOL GetStringValue(BYTE *pData, DBBINDING *pBinding, WCHAR *pwszValue, DWORD cchValue)
+{
+	pwszValue[0] = WCHAR('\0');
+
+	if (DBSTATUS_S_OK != *(DBSTATUS*)(pData + pBinding->obStatus))
+	{
+		return TRUE;
+	}
+
+	wcsncpy(pwszValue, (WCHAR*)(pData + pBinding->obValue), cchValue - 1);
+	pwszValue[cchValue - 1] = WCHAR('\0');
+
+	return FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FormatColumnValue
+//
+// Description: Format a bound column value as text for the change log.
+//
+// Parameters
+//		pData		- row data buffer
+//		pBinding	- binding of the column
+//		pwszValue	- receives the text, CHANGELOG_MAX_VALUE + 1 characters
+//		pfNull		- receives TRUE if the value is NULL
+//
+// Returns: FALSE if the column type is not logged (BLOBs)
+//
+////////////////////////////////////////////////////////////////////////////////
+static BOOL FormatColumnValue(BYTE *pData, DBBINDING *pBinding, WCHAR *pwszValue, BOOL *pfNull)
+{
+	BYTE	*pValue = pData + pBinding->obValue;
+
+	pwszValue[0] = WCHAR('\0');
+	*pfNull		 = FALSE;
+
+	switch(pBinding->wType)
+	{
+	case DBTYPE_WSTR:
+	case DBTYPE_I4:
+	case DBTYPE_I2:
+	case DBTYPE_DBTIMESTAMP:
+		break;
+
+	default:
+		return FALSE;
+	}
+
+	if (DBSTATUS_S_ISNULL == *(DBSTATUS*)(pData + pBinding->obStatus))
+	{
+		*pfNull = TRUE;
+		return TRUE;
+	}
+
+	switch(pBinding->wType)
+	{
+	case DBTYPE_WSTR:
+		wcsncpy(pwszValue, (WCHAR*)pValue, CHANGELOG_MAX_VALUE);
+		pwszValue[CHANGELOG_MAX_VALUE] = WCHAR('\0');
+		break;
+
+	case DBTYPE_I4:
+		wsprintf(pwszValue, L"%d", *(int*)pValue);
+		break;
+
+	case DBTYPE_I2:
+		wsprintf(pwszValue, L"%d", (int)*(short*)pValue);
+		break;
+
+	case DBTYPE_DBTIMESTAMP:
+		{
+			DBTIMESTAMP *pts = (DBTIMESTAMP*)pValue;
+
+			wsprintf(pwszValue, L"%04d-%02d-%02d %02d:%02d:%02d",
+					 pts->year, pts->month, pts->day, pts->hour, pts->minute, pts->second);
+		}
+		break;
+	}
+
+	return TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogWriters::ChangeLogWriters()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+ChangeLogWriters::ChangeLogWriters() : m_pOpen(NULL)
+{
+	InitializeCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogWriters::~ChangeLogWriters()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+ChangeLogWriters::~ChangeLogWriters()
+{
+	DeleteCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogWriters::Lock()
+//
+// Description: Held by a writer from the insert of its first entry until it
+//				is added.
+//
+////////////////////////////////////////////////////////////////////////////////
+void ChangeLogWriters::Lock()
+{
+	EnterCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogWriters::Unlock()
+//
+// Description: Release the lock taken by Lock.
+//
+////////////////////////////////////////////////////////////////////////////////
+void ChangeLogWriters::Unlock()
+{
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogWriters::Add()
+//
+// Description: Add a writer whose transaction has entries from
+//				pWriter->ulFirstSequence on. Called with the lock held.
+//
+////////////////////////////////////////////////////////////////////////////////
+void ChangeLogWriters::Add(CHANGELOG_OPEN_WRITER *pWriter)
+{
+	pWriter->pNext	= m_pOpen;
+	m_pOpen			= pWriter;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogWriters::Remove()
+//
+// Description: Remove a writer once its transaction committed or aborted.
+//
+////////////////////////////////////////////////////////////////////////////////
+void ChangeLogWriters::Remove(CHANGELOG_OPEN_WRITER *pWriter)
+{
+	CHANGELOG_OPEN_WRITER	**ppLink;
+
+	EnterCriticalSection(&m_cs);
+
+	for (ppLink = &m_pOpen; *ppLink; ppLink = &(*ppLink)->pNext)
+	{
+		if (*ppLink == pWriter)
+		{
+			*ppLink = pWriter->pNext;
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&m_cs);
+
+	pWriter->pNext = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogWriters::GetStableSequence()
+//
+// Description: Returns the last sequence a reader can go up to: every
+//				entry up to it is committed or aborted.
+//
+// Parameters
+//		ulLastSequence	- MAX(ChangeSeq) the reader read just before
+//
+////////////////////////////////////////////////////////////////////////////////
+ULONG ChangeLogWriters::GetStableSequence(ULONG ulLastSequence)
+{
+	CHANGELOG_OPEN_WRITER	*pWriter;
+
+	EnterCriticalSection(&m_cs);
+
+	for (pWriter = m_pOpen; pWriter; pWriter = pWriter->pNext)
+	{
+		if (pWriter->ulFirstSequence <= ulLastSequence)
+		{
+			ulLastSequence = pWriter->ulFirstSequence - 1;
+		}
+	}
+
+	LeaveCriticalSection(&m_cs);
+
+	return ulLastSequence;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ReadLastSequence
+//
+// Description: Returns MAX(ChangeSeq), 0 if the log is empty.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT ReadLastSequence(IOpenRowset *pIOpenRowset, ULONG *pulSequence)
+{
+	HRESULT	hr;
+	LONG	lSequence	= 0;
+	BOOL	fNull		= TRUE;
+
+	*pulSequence = 0;
+
+	hr = ExecuteScalar(pIOpenRowset, L"SELECT MAX(ChangeSeq) FROM EmployeeChanges", &lSequence, &fNull);
+	if (SUCCEEDED(hr) && !fNull)
+	{
+		*pulSequence = lSequence;
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogWriter::ChangeLogWriter()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+ChangeLogWriter::ChangeLogWriter() : m_pIOpenRowset(NULL),
+									 m_pIRowset(NULL),
+									 m_pIRowsetChange(NULL),
+									 m_pIAccessor(NULL),
+									 m_hAccessor(DB_NULL_HACCESSOR),
+									 m_prgBinding(NULL),
+									 m_cBindings(0),
+									 m_cbRowSize(0),
+									 m_pData(NULL)
+{
+	m_Open.pNext			= NULL;
+	m_Open.ulFirstSequence	= 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogWriter::~ChangeLogWriter()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+ChangeLogWriter::~ChangeLogWriter()
+{
+	Close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogWriter::Open()
+//
+// Description: Open the change log table on the session of the mutation.
+//
+// Parameters
+//		pIOpenRowset	- session that holds the caller's transaction
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ChangeLogWriter::Open(IOpenRowset *pIOpenRowset)
+{
+	HRESULT	hr = NOERROR;
+
+	Close();
+
+	if (NULL == pIOpenRowset)
+	{
+		hr = E_POINTER;
+		goto Exit;
+	}
+
+	// The session reads back the sequence of the first entry of a transaction
+	//
+	m_pIOpenRowset = pIOpenRowset;
+	m_pIOpenRowset->AddRef();
+
+	hr = OpenTableRowset(pIOpenRowset, TABLE_EMPLOYEE_CHANGES, NULL, ROWSET_OPT_CHANGE, IID_IRowset, (IUnknown**)&m_pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = m_pIRowset->QueryInterface(IID_IRowsetChange, (void**)&m_pIRowsetChange);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// ChangeSeq and ChangeTime are filled in by the engine
+	//
+	hr = CreateColumnBindings(m_pIRowset,
+							  g_rgpwszWriterColumns,
+							  sizeof(g_rgpwszWriterColumns)/sizeof(g_rgpwszWriterColumns[0]),
+							  NULL,
+							  &m_prgBinding,
+							  &m_cBindings,
+							  &m_cbRowSize);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = m_pIRowset->QueryInterface(IID_IAccessor, (void**)&m_pIAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = m_pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, m_cBindings, m_prgBinding, 0, &m_hAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	m_pData = (BYTE*)CoTaskMemAlloc(m_cbRowSize);
+	if (NULL == m_pData)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+Exit:
+	if (FAILED(hr))
+	{
+		Close();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogWriter::Close()
+//
+// Description: Release the change log rowset. The transaction of the caller
+//				has to be over.
+//
+////////////////////////////////////////////////////////////////////////////////
+void ChangeLogWriter::Close()
+{
+	EndTransaction();
+
+	if (m_pData)
+	{
+		CoTaskMemFree(m_pData);
+		m_pData = NULL;
+	}
+
+	FreeColumnBindings(m_prgBinding);
+	m_prgBinding = NULL;
+	m_cBindings	 = 0;
+
+	if (m_pIAccessor)
+	{
+		m_pIAccessor->ReleaseAccessor(m_hAccessor, NULL);
+		m_pIAccessor->Release();
+		m_pIAccessor = NULL;
+	}
+
+	m_hAccessor = DB_NULL_HACCESSOR;
+
+	if (m_pIRowsetChange)
+	{
+		m_pIRowsetChange->Release();
+		m_pIRowsetChange = NULL;
+	}
+
+	if (m_pIRowset)
+	{
+		m_pIRowset->Release();
+		m_pIRowset = NULL;
+	}
+
+	if (m_pIOpenRowset)
+	{
+		m_pIOpenRowset->Release();
+		m_pIOpenRowset = NULL;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogWriter::EndTransaction()
+//
+// Description: Called once the transaction that holds the entries appended
+//				since the last call committed or aborted; readers can then
+//				go past them.
+//
+////////////////////////////////////////////////////////////////////////////////
+void ChangeLogWriter::EndTransaction()
+{
+	if (m_Open.ulFirstSequence)
+	{
+		g_ChangeLogWriters.Remove(&m_Open);
+		m_Open.ulFirstSequence = 0;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogWriter::Append()
+//
+// Description: Append one change entry.
+//
+// Parameters
+//		dwEmployeeID	- key of the changed row
+//		dwOperation		- CHANGE_OP_*
+//		pwszColumn		- changed column
+//		pwszOldValue	- value before the change, NULL for none
+//		pwszNewValue	- value after the change, NULL for none
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ChangeLogWriter::Append(DWORD dwEmployeeID, DWORD dwOperation, LPCWSTR pwszColumn, LPCWSTR pwszOldValue, LPCWSTR pwszNewValue)
+{
+	HRESULT	hr;
+	LONG	lSequence	= 0;
+	BOOL	fNull		= TRUE;
+
+	if (NULL == m_pIRowsetChange)
+	{
+		return E_UNEXPECTED;
+	}
+
+	memset(m_pData, 0, m_cbRowSize);
+
+	*(int*)(m_pData+m_prgBinding[0].obValue)		= dwEmployeeID;
+	*(ULONG*)(m_pData+m_prgBinding[0].obLength)		= 4;
+	*(DBSTATUS*)(m_pData+m_prgBinding[0].obStatus)	= DBSTATUS_S_OK;
+
+	*(int*)(m_pData+m_prgBinding[1].obValue)		= dwOperation;
+	*(ULONG*)(m_pData+m_prgBinding[1].obLength)		= 4;
+	*(DBSTATUS*)(m_pData+m_prgBinding[1].obStatus)	= DBSTATUS_S_OK;
+
+	SetStringValue(m_pData, &m_prgBinding[2], pwszColumn);
+	SetStringValue(m_pData, &m_prgBinding[3], pwszOldValue);
+	SetStringValue(m_pData, &m_prgBinding[4], pwszNewValue);
+
+	if (m_Open.ulFirstSequence)
+	{
+		return m_pIRowsetChange->InsertRow(DB_NULL_HCHAPTER, m_hAccessor, m_pData, NULL);
+	}
+
+	// The first entry of the transaction. No reader may go past its
+	// sequence until the transaction is over.
+	//
+	g_ChangeLogWriters.Lock();
+
+	hr = m_pIRowsetChange->InsertRow(DB_NULL_HCHAPTER, m_hAccessor, m_pData, NULL);
+	if (SUCCEEDED(hr))
+	{
+		hr = ExecuteScalar(m_pIOpenRowset, L"SELECT @@IDENTITY", &lSequence, &fNull);
+		if (SUCCEEDED(hr) && (fNull || lSequence <= 0))
+		{
+			hr = E_UNEXPECTED;
+		}
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		m_Open.ulFirstSequence = lSequence;
+		g_ChangeLogWriters.Add(&m_Open);
+	}
+
+	g_ChangeLogWriters.Unlock();
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogWriter::AppendRowChanges()
+//
+// Description: Compare the before and after images of an Employees row and
+//				append one entry per column that changed. BLOB columns are
+//				not logged.
+//
+// Parameters
+//		dwEmployeeID	- key of the changed row
+//		dwOperation		- CHANGE_OP_*
+//		prgBinding		- bindings of both row images
+//		cBindings		- number of bindings
+//		pDBColumnInfo	- column metadata, indexed by ordinal
+//		pOldData		- row before the change, NULL for an insert
+//		pNewData		- row after the change, NULL for a delete
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ChangeLogWriter::AppendRowChanges(DWORD			dwEmployeeID,
+										  DWORD			dwOperation,
+										  DBBINDING		*prgBinding,
+										  DWORD			cBindings,
+										  DBCOLUMNINFO	*pDBColumnInfo,
+										  BYTE			*pOldData,
+										  BYTE			*pNewData)
+{
+	return AppendColumnChanges(dwEmployeeID, dwOperation, prgBinding, cBindings, pDBColumnInfo, NULL, pOldData, pNewData);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogWriter::AppendRowChanges()
+//
+// Description: AppendRowChanges with the column names given by the
+//				caller, for bindings that were not made from the provider's
+//				column metadata.
+//
+// Parameters
+//		dwEmployeeID	- key of the changed row
+//		dwOperation		- CHANGE_OP_*
+//		prgBinding		- bindings of both row images
+//		cBindings		- number of bindings
+//		rgpwszColumns	- column name of each binding
+//		pOldData		- row before the change, NULL for an insert
+//		pNewData		- row after the change, NULL for a delete
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ChangeLogWriter::AppendRowChanges(DWORD			dwEmployeeID,
+										  DWORD			dwOperation,
+										  DBBINDING		*prgBinding,
+										  DWORD			cBindings,
+										  const LPCWSTR	*rgpwszColumns,
+										  BYTE			*pOldData,
+										  BYTE			*pNewData)
+{
+	return AppendColumnChanges(dwEmployeeID, dwOperation, prgBinding, cBindings, NULL, rgpwszColumns, pOldData, pNewData);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogWriter::AppendColumnChanges()
+//
+// Description: Append the entries of AppendRowChanges. A column is named
+//				by rgpwszColumns if given, else by pDBColumnInfo.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ChangeLogWriter::AppendColumnChanges(DWORD			dwEmployeeID,
+											 DWORD			dwOperation,
+											 DBBINDING		*prgBinding,
+											 DWORD			cBindings,
+											 DBCOLUMNINFO	*pDBColumnInfo,
+											 const LPCWSTR	*rgpwszColumns,
+											 BYTE			*pOldData,
+											 BYTE			*pNewData)
+{
+	HRESULT	hr = NOERROR;
+	WCHAR	wszOldValue[CHANGELOG_MAX_VALUE + 1];
+	WCHAR	wszNewValue[CHANGELOG_MAX_VALUE + 1];
+	BOOL	fOldNull;
+	BOOL	fNewNull;
+
+	for (DWORD dwCol = 0; dwCol < cBindings; ++dwCol)
+	{
+		fOldNull = TRUE;
+		fNewNull = TRUE;
+
+		if (pOldData && !FormatColumnValue(pOldData, &prgBinding[dwCol], wszOldValue, &fOldNull))
+		{
+			continue;
+		}
+
+		if (pNewData && !FormatColumnValue(pNewData, &prgBinding[dwCol], wszNewValue, &fNewNull))
+		{
+			continue;
+		}
+
+		// Skip unchanged columns
+		//
+		if (fOldNull == fNewNull && (fOldNull || 0 == wcscmp(wszOldValue, wszNewValue)))
+		{
+			continue;
+		}
+
+		hr = Append(dwEmployeeID,
+					dwOperation,
+					rgpwszColumns ? rgpwszColumns[dwCol] : pDBColumnInfo[prgBinding[dwCol].iOrdinal].pwszName,
+					fOldNull ? NULL : wszOldValue,
+					fNewNull ? NULL : wszNewValue);
+		if(FAILED(hr))
+		{
+			break;
+		}
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogCursor::ChangeLogCursor()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+ChangeLogCursor::ChangeLogCursor() : m_pIOpenRowset(NULL),
+									 m_pIRowset(NULL),
+									 m_pIRowsetIndex(NULL),
+									 m_pIAccessor(NULL),
+									 m_hAccessor(DB_NULL_HACCESSOR),
+									 m_prgBinding(NULL),
+									 m_cBindings(0),
+									 m_cbRowSize(0),
+									 m_pData(NULL),
+									 m_cRows(0),
+									 m_iRow(0),
+									 m_ulLastSequence(0),
+									 m_fEndOfRowset(FALSE)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogCursor::~ChangeLogCursor()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+ChangeLogCursor::~ChangeLogCursor()
+{
+	Close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogCursor::Open()
+//
+// Description: Position the cursor after a sequence number. The cursor
+//				ends at the last stable sequence.
+//
+// Parameters
+//		pIDBCreateSession	- data source
+//		ulSinceSequence		- last sequence the consumer has seen, 0 for all
+//		pfTruncated			- receives TRUE if entries after ulSinceSequence
+//							  were compacted away; the consumer must rescan
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ChangeLogCursor::Open(IDBCreateSession *pIDBCreateSession, ULONG ulSinceSequence, BOOL *pfTruncated)
+{
+	HRESULT	hr = NOERROR;
+
+	Close();
+
+	if (NULL == pIDBCreateSession || NULL == pfTruncated)
+	{
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+	*pfTruncated = FALSE;
+
+	hr = pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&m_pIOpenRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Entries past the oldest open transaction may be followed by entries
+	// below them that commit later
+	//
+	hr = ReadLastSequence(m_pIOpenRowset, &m_ulLastSequence);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	m_ulLastSequence = g_ChangeLogWriters.GetStableSequence(m_ulLastSequence);
+
+	hr = OpenTableRowset(m_pIOpenRowset, TABLE_EMPLOYEE_CHANGES, INDEX_EMPLOYEE_CHANGES, ROWSET_OPT_INDEX, IID_IRowsetIndex, (IUnknown**)&m_pIRowsetIndex);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = m_pIRowsetIndex->QueryInterface(IID_IRowset, (void**)&m_pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = CreateColumnBindings(m_pIRowset,
+							  g_rgpwszCursorColumns,
+							  sizeof(g_rgpwszCursorColumns)/sizeof(g_rgpwszCursorColumns[0]),
+							  NULL,
+							  &m_prgBinding,
+							  &m_cBindings,
+							  &m_cbRowSize);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = m_pIRowset->QueryInterface(IID_IAccessor, (void**)&m_pIAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = m_pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, m_cBindings, m_prgBinding, 0, &m_hAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	m_pData = (BYTE*)CoTaskMemAlloc(m_cbRowSize);
+	if (NULL == m_pData)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	// Position after the last sequence the consumer has seen
+	//
+	memset(m_pData, 0, m_cbRowSize);
+	*(ULONG*)(m_pData+m_prgBinding[0].obLength)		= 4;
+	*(DBSTATUS*)(m_pData+m_prgBinding[0].obStatus)	= DBSTATUS_S_OK;
+	*(int*)(m_pData+m_prgBinding[0].obValue)		= ulSinceSequence;
+
+	hr = m_pIRowsetIndex->Seek(m_hAccessor, 1, m_pData, DBSEEK_AFTER);
+	if (DB_E_NOTFOUND == hr)
+	{
+		// Nothing was logged after ulSinceSequence
+		//
+		m_fEndOfRowset = TRUE;
+		hr = NOERROR;
+		goto Exit;
+	}
+
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = FetchRows();
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// A compaction marker ahead of the consumer means entries it has not
+	// seen are gone
+	//
+	if (m_cRows)
+	{
+		CHANGE_RECORD	*pRecord = (CHANGE_RECORD*)CoTaskMemAlloc(sizeof(CHANGE_RECORD));
+
+		if (NULL == pRecord)
+		{
+			hr = E_OUTOFMEMORY;
+			goto Exit;
+		}
+
+		hr = ReadRow(m_rghRows[0], pRecord);
+		if (SUCCEEDED(hr) && CHANGE_OP_COMPACTED == pRecord->dwOperation)
+		{
+			*pfTruncated = TRUE;
+		}
+
+		CoTaskMemFree(pRecord);
+	}
+
+Exit:
+	if (FAILED(hr))
+	{
+		Close();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogCursor::Next()
+//
+// Description: Return the next change entry.
+//
+// Returns: NOERROR if a record was returned, S_FALSE at the end of the log
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ChangeLogCursor::Next(CHANGE_RECORD *pRecord)
+{
+	HRESULT	hr = NOERROR;
+
+	if (NULL == pRecord)
+	{
+		return E_INVALIDARG;
+	}
+
+	if (NULL == m_pIRowset)
+	{
+		return m_fEndOfRowset ? S_FALSE : E_UNEXPECTED;
+	}
+
+	for (;;)
+	{
+		if (m_iRow == m_cRows)
+		{
+			if (m_fEndOfRowset)
+			{
+				return S_FALSE;
+			}
+
+			hr = FetchRows();
+			if(FAILED(hr))
+			{
+				return hr;
+			}
+
+			if (0 == m_cRows)
+			{
+				return S_FALSE;
+			}
+		}
+
+		hr = ReadRow(m_rghRows[m_iRow++], pRecord);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+
+		if (pRecord->ulSequence > m_ulLastSequence)
+		{
+			m_iRow			= m_cRows;
+			m_fEndOfRowset	= TRUE;
+			return S_FALSE;
+		}
+
+		// Compaction markers carry no change
+		//
+		if (CHANGE_OP_COMPACTED != pRecord->dwOperation)
+		{
+			return NOERROR;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogCursor::FetchRows()
+//
+// Description: Release the current row handles and fetch the next batch.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ChangeLogCursor::FetchRows()
+{
+	HRESULT	hr;
+	HROW	*prghRows = m_rghRows;
+
+	ReleaseRows();
+
+	hr = m_pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, CHANGELOG_FETCH_ROWS, &m_cRows, &prghRows);
+	if(FAILED(hr))
+	{
+		m_cRows = 0;
+		return hr;
+	}
+
+	if (DB_S_ENDOFROWSET == hr || m_cRows < CHANGELOG_FETCH_ROWS)
+	{
+		m_fEndOfRowset = TRUE;
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogCursor::ReadRow()
+//
+// Description: Copy one change log row into a CHANGE_RECORD.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ChangeLogCursor::ReadRow(HROW hRow, CHANGE_RECORD *pRecord)
+{
+	HRESULT	hr;
+
+	memset(m_pData, 0, m_cbRowSize);
+
+	hr = m_pIRowset->GetData(hRow, m_hAccessor, m_pData);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	memset(pRecord, 0, sizeof(CHANGE_RECORD));
+
+	pRecord->ulSequence		= *(int*)(m_pData+m_prgBinding[0].obValue);
+	pRecord->dwEmployeeID	= *(int*)(m_pData+m_prgBinding[1].obValue);
+	pRecord->dwOperation	= *(int*)(m_pData+m_prgBinding[2].obValue);
+
+	GetStringValue(m_pData, &m_prgBinding[3], pRecord->wszColumn, CHANGELOG_MAX_COLUMN + 1);
+	pRecord->fOldValueNull = GetStringValue(m_pData, &m_prgBinding[4], pRecord->wszOldValue, CHANGELOG_MAX_VALUE + 1);
+	pRecord->fNewValueNull = GetStringValue(m_pData, &m_prgBinding[5], pRecord->wszNewValue, CHANGELOG_MAX_VALUE + 1);
+
+	if (DBSTATUS_S_OK == *(DBSTATUS*)(m_pData+m_prgBinding[6].obStatus))
+	{
+		memcpy(&pRecord->tsChanged, m_pData+m_prgBinding[6].obValue, sizeof(DBTIMESTAMP));
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogCursor::ReleaseRows()
+//
+// Description: Release the row handles held by the cursor.
+//
+////////////////////////////////////////////////////////////////////////////////
+void ChangeLogCursor::ReleaseRows()
+{
+	if (m_cRows && m_pIRowset)
+	{
+		m_pIRowset->ReleaseRows(m_cRows, m_rghRows, NULL, NULL, NULL);
+	}
+
+	m_cRows = 0;
+	m_iRow	= 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ChangeLogCursor::Close()
+//
+// Description: Release the rowset and the session of the cursor.
+//
+////////////////////////////////////////////////////////////////////////////////
+void ChangeLogCursor::Close()
+{
+	ReleaseRows();
+
+	if (m_pData)
+	{
+		CoTaskMemFree(m_pData);
+		m_pData = NULL;
+	}
+
+	FreeColumnBindings(m_prgBinding);
+	m_prgBinding = NULL;
+	m_cBindings	 = 0;
+
+	if (m_pIAccessor)
+	{
+		m_pIAccessor->ReleaseAccessor(m_hAccessor, NULL);
+		m_pIAccessor->Release();
+		m_pIAccessor = NULL;
+	}
+
+	m_hAccessor = DB_NULL_HACCESSOR;
+
+	if (m_pIRowset)
+	{
+		m_pIRowset->Release();
+		m_pIRowset = NULL;
+	}
+
+	if (m_pIRowsetIndex)
+	{
+		m_pIRowsetIndex->Release();
+		m_pIRowsetIndex = NULL;
+	}
+
+	if (m_pIOpenRowset)
+	{
+		m_pIOpenRowset->Release();
+		m_pIOpenRowset = NULL;
+	}
+
+	m_ulLastSequence	= 0;
+	m_fEndOfRowset		= FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EnsureChangeLogTable
+//
+// Description: Create the change log table and its index when a database
+//				created before the change log is opened.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EnsureChangeLogTable(IDBCreateSession *pIDBCreateSession)
+{
+	HRESULT		hr				= NOERROR;
+	IOpenRowset	*pIOpenRowset	= NULL;			// Provider Interface Pointer
+	IRowset		*pIRowset		= NULL;			// Provider Interface Pointer
+
+	if (NULL == pIDBCreateSession)
+	{
+		hr = E_POINTER;
+		goto Exit;
+	}
+
+	hr = pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pIOpenRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = OpenTableRowset(pIOpenRowset, TABLE_EMPLOYEE_CHANGES, NULL, 0, IID_IRowset, (IUnknown**)&pIRowset);
+	if (DB_E_NOTABLE != hr)
+	{
+		goto Exit;
+	}
+
+	hr = ExecuteCommand(pIOpenRowset, SQL_CREATE_EMPLOYEE_CHANGES_TABLE);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = ExecuteCommand(pIOpenRowset, SQL_CREATE_EMPLOYEE_CHANGES_INDEX);
+
+Exit:
+	if (pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	if (pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetLastChangeSequence
+//
+// Description: Returns the sequence number of the newest stable change. A
+//				consumer takes it before a full scan and reads changes after
+//				it.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT GetLastChangeSequence(IDBCreateSession *pIDBCreateSession, ULONG *pulSequence)
+{
+	HRESULT		hr				= NOERROR;
+	IOpenRowset	*pIOpenRowset	= NULL;			// Provider Interface Pointer
+
+	if (NULL == pIDBCreateSession || NULL == pulSequence)
+	{
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+	*pulSequence = 0;
+
+	hr = pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pIOpenRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = ReadLastSequence(pIOpenRowset, pulSequence);
+	if (SUCCEEDED(hr))
+	{
+		*pulSequence = g_ChangeLogWriters.GetStableSequence(*pulSequence);
+	}
+
+Exit:
+	if (pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactChangeLog
+//
+// Description: Discard old change entries.
+//
+// Parameters
+//		pIDBCreateSession	- data source
+//		ulAcknowledged		- lowest sequence read by every consumer
+//		cMaxEntries			- entries to keep regardless of consumers, 0 for
+//							  no limit
+//		pulCompactedTo		- receives the sequence of the compaction marker,
+//							  0 if nothing was discarded. May be NULL.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CompactChangeLog(IDBCreateSession	*pIDBCreateSession,
+						 ULONG				ulAcknowledged,
+						 ULONG				cMaxEntries,
+						 ULONG				*pulCompactedTo)
+{
+	HRESULT				hr				= NOERROR;
+	IOpenRowset			*pIOpenRowset	= NULL;			// Provider Interface Pointer
+	ITransactionLocal	*pITxnLocal		= NULL;			// Provider Interface Pointer
+	WCHAR				wszQuery[128];
+	LONG				lLast			= 0;
+	LONG				lMarker			= 0;
+	BOOL				fNull			= TRUE;
+	ULONG				ulCut;
+
+	if (pulCompactedTo)
+	{
+		*pulCompactedTo = 0;
+	}
+
+	if (NULL == pIDBCreateSession)
+	{
+		hr = E_POINTER;
+		goto Exit;
+	}
+
+	hr = pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pIOpenRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIOpenRowset->QueryInterface(IID_ITransactionLocal, (void**)&pITxnLocal);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pITxnLocal->StartTransaction(ISOLATIONLEVEL_READCOMMITTED | ISOLATIONLEVEL_CURSORSTABILITY, 0, NULL, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = ExecuteScalar(pIOpenRowset, L"SELECT MAX(ChangeSeq) FROM EmployeeChanges", &lLast, &fNull);
+	if(FAILED(hr) || fNull)
+	{
+		goto Abort;
+	}
+
+	// Everything acknowledged goes, and the size limit may push the cut
+	// further, past consumers that fell behind
+	//
+	ulCut = ulAcknowledged;
+	if (cMaxEntries && (ULONG)lLast > cMaxEntries && (ULONG)lLast - cMaxEntries > ulCut)
+	{
+		ulCut = (ULONG)lLast - cMaxEntries;
+	}
+
+	if (ulCut > (ULONG)lLast)
+	{
+		ulCut = (ULONG)lLast;
+	}
+
+	// The newest entry at or before the cut becomes the marker
+	//
+	wsprintf(wszQuery, L"SELECT MAX(ChangeSeq) FROM EmployeeChanges WHERE ChangeSeq <= %u", ulCut);
+	hr = ExecuteScalar(pIOpenRowset, wszQuery, &lMarker, &fNull);
+	if(FAILED(hr) || fNull)
+	{
+		goto Abort;
+	}
+
+	wsprintf(wszQuery, L"DELETE FROM EmployeeChanges WHERE ChangeSeq < %d", lMarker);
+	hr = ExecuteCommand(pIOpenRowset, wszQuery);
+	if(FAILED(hr))
+	{
+		goto Abort;
+	}
+
+	wsprintf(wszQuery, L"UPDATE EmployeeChanges SET Operation = %d, ColumnName = NULL, OldValue = NULL, NewValue = NULL WHERE ChangeSeq = %d", CHANGE_OP_COMPACTED, lMarker);
+	hr = ExecuteCommand(pIOpenRowset, wszQuery);
+	if(FAILED(hr))
+	{
+		goto Abort;
+	}
+
+	hr = pITxnLocal->Commit(FALSE, XACTTC_SYNC, 0);
+	if (SUCCEEDED(hr) && pulCompactedTo)
+	{
+		*pulCompactedTo = lMarker;
+	}
+
+	goto Exit;
+
+Abort:
+	pITxnLocal->Abort(NULL, FALSE, FALSE);
+
+Exit:
+	if (pITxnLocal)
+	{
+		pITxnLocal->Release();
+	}
+
+	if (pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	return hr;
+}
@@ -0,0 +1,220 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: ChangeLog
+//
+// File: ChangeLog.h
+//
+// Comment: Append-only change log of the Employees table.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_CHANGELOG_H__A2C95E17_3D48_4F0B_8C6A_E41B07D93F52__INCLUDED_)
+#define AFX_CHANGELOG_H__A2C95E17_3D48_4F0B_8C6A_E41B07D93F52__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+////////////////////////////////////////////////////////////////////////////////
+// Change log table
+//
+// Every mutation of an Employees row appends one row per changed column,
+// inside the transaction of the mutation. ChangeSeq is assigned by the
+// engine and only grows, so a consumer remembers the last sequence it has
+// seen and reads everything after it. The engine assigns it when the row
+// is inserted, not when it commits; readers stop short of the entries of
+// transactions still open, see ChangeLogWriters.
+//
+#define TABLE_EMPLOYEE_CHANGES			L"EmployeeChanges"
+#define INDEX_EMPLOYEE_CHANGES			L"PK_EmployeeChanges"
+
+#define SQL_CREATE_EMPLOYEE_CHANGES_TABLE	L"CREATE TABLE EmployeeChanges (ChangeSeq INT IDENTITY(1,1) NOT NULL, EmployeeID INT NOT NULL, Operation INT NOT NULL, ColumnName NVARCHAR(30), OldValue NVARCHAR(255), NewValue NVARCHAR(255), ChangeTime DATETIME DEFAULT GETDATE())"
+#define SQL_CREATE_EMPLOYEE_CHANGES_INDEX	L"CREATE UNIQUE INDEX PK_EmployeeChanges ON EmployeeChanges (ChangeSeq)"
+
+#define CHANGELOG_MAX_COLUMN			30
+#define CHANGELOG_MAX_VALUE				255
+#define CHANGELOG_FETCH_ROWS			16			// Row handles fetched per GetNextRows
+
+// Change operations
+//
+#define CHANGE_OP_COMPACTED				0			// Marker left behind by CompactChangeLog
+#define CHANGE_OP_INSERT				1
+#define CHANGE_OP_UPDATE				2
+#define CHANGE_OP_DELETE				3
+
+////////////////////////////////////////////////////////////////////////////////
+// One change log entry, as returned by ChangeLogCursor
+//
+typedef struct tagCHANGE_RECORD
+{
+	ULONG		ulSequence;
+	DWORD		dwEmployeeID;
+	DWORD		dwOperation;							// CHANGE_OP_*
+	DBTIMESTAMP	tsChanged;
+	BOOL		fOldValueNull;
+	BOOL		fNewValueNull;
+	WCHAR		wszColumn[CHANGELOG_MAX_COLUMN + 1];
+	WCHAR		wszOldValue[CHANGELOG_MAX_VALUE + 1];
+	WCHAR		wszNewValue[CHANGELOG_MAX_VALUE + 1];
+} CHANGE_RECORD;
+
+////////////////////////////////////////////////////////////////////////////////
+// A writer with uncommitted entries, linked in g_ChangeLogWriters
+//
+typedef struct tagCHANGELOG_OPEN_WRITER
+{
+	struct tagCHANGELOG_OPEN_WRITER	*pNext;
+	ULONG							ulFirstSequence;	// First entry of the open transaction
+} CHANGELOG_OPEN_WRITER;
+
+////////////////////////////////////////////////////////////////////////////////
+// The writers of this process that have entries in an open transaction.
+// A transaction can commit an entry below one that a later transaction
+// already committed; a reader that went past it would never see it. So
+// readers take GetStableSequence, which stays below the first entry of
+// the oldest open writer. Writers of other processes are not tracked.
+//
+class ChangeLogWriters
+{
+public:
+	ChangeLogWriters();
+	~ChangeLogWriters();
+
+	// A writer inserts its first entry and adds itself with the lock held
+	//
+	void	Lock();
+	void	Unlock();
+	void	Add(CHANGELOG_OPEN_WRITER *pWriter);
+
+	void	Remove(CHANGELOG_OPEN_WRITER *pWriter);
+
+	ULONG	GetStableSequence(ULONG ulLastSequence);
+
+private:
+	CRITICAL_SECTION		m_cs;
+	CHANGELOG_OPEN_WRITER	*m_pOpen;
+};
+
+extern ChangeLogWriters	g_ChangeLogWriters;
+
+////////////////////////////////////////////////////////////////////////////////
+// Appends change entries through the session of the caller, so that the
+// entries commit or abort together with the caller's transaction. The
+// caller calls EndTransaction, or Close, once that transaction committed
+// or aborted.
+//
+class ChangeLogWriter
+{
+public:
+	ChangeLogWriter();
+	~ChangeLogWriter();
+
+	HRESULT Open(IOpenRowset *pIOpenRowset);
+	void	Close();
+
+	void	EndTransaction();
+
+	HRESULT Append(DWORD dwEmployeeID, DWORD dwOperation, LPCWSTR pwszColumn, LPCWSTR pwszOldValue, LPCWSTR pwszNewValue);
+
+	HRESULT AppendRowChanges(DWORD			dwEmployeeID,
+							 DWORD			dwOperation,
+							 DBBINDING		*prgBinding,
+							 DWORD			cBindings,
+							 DBCOLUMNINFO	*pDBColumnInfo,
+							 BYTE			*pOldData,
+							 BYTE			*pNewData);
+
+	HRESULT AppendRowChanges(DWORD			dwEmployeeID,
+							 DWORD			dwOperation,
+							 DBBINDING		*prgBinding,
+							 DWORD			cBindings,
+							 const LPCWSTR	*rgpwszColumns,
+							 BYTE			*pOldData,
+							 BYTE			*pNewData);
+
+private:
+	HRESULT AppendColumnChanges(DWORD			dwEmployeeID,
+								DWORD			dwOperation,
+								DBBINDING		*prgBinding,
+								DWORD			cBindings,
+								DBCOLUMNINFO	*pDBColumnInfo,
+								const LPCWSTR	*rgpwszColumns,
+								BYTE			*pOldData,
+								BYTE			*pNewData);
+
+	IOpenRowset		*m_pIOpenRowset;
+	IRowset			*m_pIRowset;
+	IRowsetChange	*m_pIRowsetChange;
+	IAccessor		*m_pIAccessor;
+	HACCESSOR		m_hAccessor;
+	DBBINDING		*m_prgBinding;
+	DWORD			m_cBindings;
+	DWORD			m_cbRowSize;
+	BYTE			*m_pData;
+	CHANGELOG_OPEN_WRITER	m_Open;				// ulFirstSequence is 0 outside a transaction
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Reads the change entries that follow a given sequence number, in
+// sequence order, up to the last stable sequence when it was opened.
+//
+class ChangeLogCursor
+{
+public:
+	ChangeLogCursor();
+	~ChangeLogCursor();
+
+	HRESULT Open(IDBCreateSession *pIDBCreateSession, ULONG ulSinceSequence, BOOL *pfTruncated);
+	HRESULT Next(CHANGE_RECORD *pRecord);
+	void	Close();
+
+private:
+	HRESULT FetchRows();
+	HRESULT ReadRow(HROW hRow, CHANGE_RECORD *pRecord);
+	void	ReleaseRows();
+
+	IOpenRowset		*m_pIOpenRowset;
+	IRowset			*m_pIRowset;
+	IRowsetIndex	*m_pIRowsetIndex;
+	IAccessor		*m_pIAccessor;
+	HACCESSOR		m_hAccessor;
+	DBBINDING		*m_prgBinding;
+	DWORD			m_cBindings;
+	DWORD			m_cbRowSize;
+	BYTE			*m_pData;
+
+	HROW			m_rghRows[CHANGELOG_FETCH_ROWS];
+	ULONG			m_cRows;						// Row handles held
+	ULONG			m_iRow;							// Next row handle to read
+	ULONG			m_ulLastSequence;				// Stable sequence at Open
+	BOOL			m_fEndOfRowset;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Create the change log table if the database does not have it yet
+//
+HRESULT EnsureChangeLogTable(IDBCreateSession *pIDBCreateSession);
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns the sequence number of the newest stable change, 0 if the log is
+// empty
+//
+HRESULT GetLastChangeSequence(IDBCreateSession *pIDBCreateSession, ULONG *pulSequence);
+
+////////////////////////////////////////////////////////////////////////////////
+// Discard the entries every consumer has read (up to ulAcknowledged), and
+// all but the newest cMaxEntries entries (0 means no limit). Consumers behind
+// the discarded range are told by ChangeLogCursor::Open that they must
+// rescan the Employees table.
+//
+HRESULT CompactChangeLog(IDBCreateSession	*pIDBCreateSession,
+						 ULONG				ulAcknowledged,
+						 ULONG				cMaxEntries,
+						 ULONG				*pulCompactedTo);
+
+#endif // !defined(AFX_CHANGELOG_H__A2C95E17_3D48_4F0B_8C6A_E41B07D93F52__INCLUDED_)
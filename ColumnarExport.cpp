@@ -0,0 +1,1298 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: ColumnarExporter
+//
+// File: ColumnarExport.cpp
+//
+// Comment: Streaming export of the Employees table to a compressed,
+//			column oriented file.
+//
+// Functions:
+//			1. Scan Employees through PK_Employees in batches of row handles
+//			2. Stage each row group column by column
+//			3. Dictionary encode Country and City, plain encode the rest
+//			4. Stream photos into a separate BLOB section
+//			5. Compress the column chunks of a row group in parallel
+//
+// Notes:
+//			Memory use is bounded by the row group size: only the staged
+//			values of the current row group and one BLOB copy buffer are
+//			held in memory. Photos are copied straight into a temporary
+//			file and appended to the export once all row groups are
+//			written.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "Compress.h"
+#include "ColumnarExport.h"
+
+#define MAX_EXPORT_COLUMN_NAME	64
+
+////////////////////////////////////////////////////////////////////////////////
+// Staging state of one column for the current row group
+//
+struct tagEXPORT_COLUMN
+{
+	WCHAR		wszName[MAX_EXPORT_COLUMN_NAME];
+	DBTYPE		wType;					// Source column type
+	WORD		wEncoding;				// Preferred encoding
+	DWORD		cbWidth;				// Value width of fixed size columns
+
+	BYTE		*pbNulls;				// Presence bitmap, one bit per staged row
+	DWORD		cbNulls;
+
+	BYTE		*pbValues;				// Staged values, plain encoded
+	DWORD		cbValues;
+	DWORD		cbValuesMax;
+
+	BYTE		*pbDecoded;				// Bitmap followed by the encoded values
+	DWORD		cbDecoded;
+	DWORD		cbDecodedMax;
+
+	BYTE		*pbStored;				// Compressed chunk
+	DWORD		cbStored;
+	DWORD		cbStoredMax;
+
+	WORD		wChunkEncoding;			// Encoding chosen for the current chunk
+	WORD		wCompression;			// Compression chosen for the current chunk
+	HRESULT		hr;						// Result of the compression thread
+};
+
+// Columns that are dictionary encoded: few distinct values, many repeats
+//
+static WCHAR* s_rgpwszDictionaryColumns[] = {
+												L"Country",
+												L"City"
+											};
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GrowBuffer
+//
+// Description: Make sure a buffer can hold cbNeeded bytes.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT GrowBuffer(BYTE **ppb, DWORD *pcbMax, DWORD cbNeeded)
+{
+	BYTE	*pbNew;
+	DWORD	cbNew;
+
+	if (cbNeeded <= *pcbMax)
+	{
+		return NOERROR;
+	}
+
+	cbNew = *pcbMax ? *pcbMax : 4096;
+	while (cbNew < cbNeeded)
+	{
+		cbNew *= 2;
+	}
+
+	pbNew = (BYTE*)CoTaskMemRealloc(*ppb, cbNew);
+	if (NULL == pbNew)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	*ppb	= pbNew;
+	*pcbMax = cbNew;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: HashString
+//
+// Description: FNV-1a hash of a counted string.
+//
+////////////////////////////////////////////////////////////////////////////////
+static DWORD HashString(const BYTE *pbChars, DWORD cbChars)
+{
+	DWORD dwHash = 2166136261U;
+
+	for (DWORD dwByte = 0; dwByte < cbChars; ++dwByte)
+	{
+		dwHash ^= pbChars[dwByte];
+		dwHash *= 16777619U;
+	}
+
+	return dwHash;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ColumnarExporter::ColumnarExporter()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+ColumnarExporter::ColumnarExporter() :	m_cRowsPerGroup(COLUMNAR_DEFAULT_ROWS),
+										m_cWorkers(COLUMNAR_DEFAULT_WORKERS),
+										m_hFile(INVALID_HANDLE_VALUE),
+										m_hBlobFile(INVALID_HANDLE_VALUE),
+										m_ibFile(0),
+										m_cbBlobs(0),
+										m_pbCopy(NULL),
+										m_prgBinding(NULL),
+										m_cBindings(0),
+										m_rgColumns(NULL),
+										m_cRowsStaged(0),
+										m_lNextColumn(0),
+										m_rgibRowGroups(NULL),
+										m_cRowGroups(0),
+										m_cRowGroupsMax(0)
+{
+	m_wszBlobFile[0] = L'\0';
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ColumnarExporter::~ColumnarExporter()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+ColumnarExporter::~ColumnarExporter()
+{
+	FreeColumns();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SetRowsPerGroup
+//
+// Description: Set the number of rows staged before a row group is written.
+//				This bounds the memory used by the export.
+//
+////////////////////////////////////////////////////////////////////////////////
+void ColumnarExporter::SetRowsPerGroup(DWORD cRowsPerGroup)
+{
+	m_cRowsPerGroup = cRowsPerGroup ? cRowsPerGroup : COLUMNAR_DEFAULT_ROWS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SetWorkerCount
+//
+// Description: Set the number of threads compressing column chunks.
+//
+////////////////////////////////////////////////////////////////////////////////
+void ColumnarExporter::SetWorkerCount(DWORD cWorkers)
+{
+	if (0 == cWorkers)
+	{
+		cWorkers = 1;
+	}
+
+	m_cWorkers = (cWorkers > COLUMNAR_MAX_WORKERS) ? COLUMNAR_MAX_WORKERS : cWorkers;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Export
+//
+// Description: Export the Employees table, photos included, to a file.
+//
+// Parameters
+//		pIDBCreateSession	- connection to the Northwind database
+//		pwszFile			- output file, overwritten if it exists
+//		pStats				- optionally receives the export statistics
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ColumnarExporter::Export(IDBCreateSession *pIDBCreateSession, LPCWSTR pwszFile, EXPORT_STATS *pStats)
+{
+	HRESULT				hr					= NOERROR;			// Error code reporting
+	HRESULT				hrFetch				= NOERROR;			// Result of the last GetNextRows
+	HROW				rghRows[COLUMNAR_FETCH_ROWS];			// Array of row handles obtained from the rowset object
+	HROW				*prghRows			= rghRows;			// Row handle(s) pointer
+	ULONG				cRowsObtained		= 0;				// Number of rows obtained from the rowset object
+	DBOBJECT			dbObject;								// DBOBJECT data.
+	DBCOLUMNINFO		*pDBColumnInfo		= NULL;				// Record column metadata
+	WCHAR				*pStringsBuffer		= NULL;
+	BYTE				*pData				= NULL;				// Record data
+	DWORD				cbRow				= 0;
+	DWORD				dwStart				= GetTickCount();
+	ULONG				ulNumCols			= 0;
+	ULONG				ulRow;
+
+	IOpenRowset			*pIOpenRowset		= NULL;				// Provider Interface Pointer
+	IRowset				*pIRowset			= NULL;				// Provider Interface Pointer
+	IColumnsInfo		*pIColumnsInfo		= NULL;				// Provider Interface Pointer
+	IAccessor			*pIAccessor			= NULL;				// Provider Interface Pointer
+	HACCESSOR			hAccessor			= DB_NULL_HACCESSOR;// Accessor handle
+
+	if (NULL == pIDBCreateSession || NULL == pwszFile || wcslen(pwszFile) + 8 >= MAX_PATH)
+	{
+		return E_INVALIDARG;
+	}
+
+	FreeColumns();
+	memset(&m_Stats, 0, sizeof(m_Stats));
+
+	m_pbCopy = (BYTE*)CoTaskMemAlloc(BLOB_COPY_BUFFER_SIZE);
+	if (NULL == m_pbCopy)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+    // Create a session object and open the table in key order
+    //
+    hr = pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pIOpenRowset);
+    if(FAILED(hr))
+    {
+        goto Exit;
+    }
+
+	hr = OpenEmployeesRowset(pIOpenRowset, 0, IID_IRowset, (IUnknown**)&pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Photos are read sequentially and copied to the BLOB section
+	//
+	dbObject.dwFlags = STGM_READ;
+	dbObject.iid	 = IID_ISequentialStream;
+
+	hr = CreateColumnBindings(pIRowset, NULL, 0, &dbObject, &m_prgBinding, &m_cBindings, &cbRow);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Column names are needed for the file header
+	//
+    hr = pIRowset->QueryInterface(IID_IColumnsInfo, (void **)&pIColumnsInfo);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+    hr = pIColumnsInfo->GetColumnInfo(&ulNumCols, &pDBColumnInfo, &pStringsBuffer);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = PrepareColumns(pDBColumnInfo, ulNumCols);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+    hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA,
+									m_cBindings,
+									m_prgBinding,
+									0,
+									&hAccessor,
+									NULL);
+    if(FAILED(hr))
+    {
+        goto Exit;
+    }
+
+	pData = (BYTE*)CoTaskMemAlloc(cbRow);
+	if (NULL == pData)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	// Create the output file and the temporary BLOB section
+	//
+	m_hFile = CreateFile(pwszFile, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == m_hFile)
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto Exit;
+	}
+
+	wcscpy(m_wszBlobFile, pwszFile);
+	wcscat(m_wszBlobFile, L".blobs");
+
+	m_hBlobFile = CreateFile(m_wszBlobFile, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, NULL);
+	if (INVALID_HANDLE_VALUE == m_hBlobFile)
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto Exit;
+	}
+
+	hr = WriteHeader();
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Fetch rows in batches of handles, stage them and write out full row groups
+	//
+	do
+	{
+		hrFetch = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, COLUMNAR_FETCH_ROWS, &cRowsObtained, &prghRows);
+		if (FAILED(hrFetch))
+		{
+			hr = hrFetch;
+			goto Exit;
+		}
+
+		for (ulRow = 0; ulRow < cRowsObtained; ++ulRow)
+		{
+			memset(pData, 0, cbRow);
+
+			hr = pIRowset->GetData(rghRows[ulRow], hAccessor, pData);
+			if (SUCCEEDED(hr))
+			{
+				hr = StageRow(pData);
+			}
+
+			if (FAILED(hr))
+			{
+				pIRowset->ReleaseRows(cRowsObtained, rghRows, NULL, NULL, NULL);
+				goto Exit;
+			}
+
+			if (m_cRowsStaged == m_cRowsPerGroup)
+			{
+				hr = FlushRowGroup();
+				if (FAILED(hr))
+				{
+					pIRowset->ReleaseRows(cRowsObtained, rghRows, NULL, NULL, NULL);
+					goto Exit;
+				}
+			}
+		}
+
+		if (cRowsObtained)
+		{
+			pIRowset->ReleaseRows(cRowsObtained, rghRows, NULL, NULL, NULL);
+		}
+	}
+	while (DB_S_ENDOFROWSET != hrFetch && cRowsObtained);
+
+	if (m_cRowsStaged)
+	{
+		hr = FlushRowGroup();
+		if (FAILED(hr))
+		{
+			goto Exit;
+		}
+	}
+
+	hr = WriteFooter();
+	if (FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = NOERROR;
+
+	m_Stats.cbWritten	= m_ibFile;
+	m_Stats.dwElapsedMs = GetTickCount() - dwStart;
+	m_Stats.dwMBps100	= GetThroughputMBps100(m_Stats.cbSource, m_Stats.dwElapsedMs);
+
+	if (pStats)
+	{
+		*pStats = m_Stats;
+	}
+
+Exit:
+	if (INVALID_HANDLE_VALUE != m_hFile)
+	{
+		CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+
+		// Do not leave a partial export behind
+		//
+		if (FAILED(hr))
+		{
+			DeleteFile(pwszFile);
+		}
+	}
+
+	if (INVALID_HANDLE_VALUE != m_hBlobFile)
+	{
+		CloseHandle(m_hBlobFile);
+		m_hBlobFile = INVALID_HANDLE_VALUE;
+		DeleteFile(m_wszBlobFile);
+	}
+
+	if (pData)
+	{
+		CoTaskMemFree(pData);
+	}
+
+    if (pDBColumnInfo)
+    {
+        CoTaskMemFree(pDBColumnInfo);
+    }
+
+    if (pStringsBuffer)
+    {
+        CoTaskMemFree(pStringsBuffer);
+    }
+
+	if(pIAccessor)
+	{
+		pIAccessor->ReleaseAccessor(hAccessor, NULL);
+		pIAccessor->Release();
+	}
+
+	if (pIColumnsInfo)
+	{
+		pIColumnsInfo->Release();
+	}
+
+	if(pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	if(pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	FreeColumns();
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PrepareColumns
+//
+// Description: Allocate the staging state of each bound column and pick its
+//				encoding from the column type and name.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ColumnarExporter::PrepareColumns(DBCOLUMNINFO *pDBColumnInfo, ULONG ulNumCols)
+{
+	DWORD	cbNulls = (m_cRowsPerGroup + 7) / 8;
+
+	m_rgColumns = (EXPORT_COLUMN*)CoTaskMemAlloc(sizeof(EXPORT_COLUMN)*m_cBindings);
+	if (NULL == m_rgColumns)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	memset(m_rgColumns, 0, sizeof(EXPORT_COLUMN)*m_cBindings);
+
+	for (DWORD dwCol = 0; dwCol < m_cBindings; ++dwCol)
+	{
+		EXPORT_COLUMN	*pColumn = &m_rgColumns[dwCol];
+		DBCOLUMNINFO	*pInfo	 = NULL;
+
+		for (ULONG ulInfo = 0; ulInfo < ulNumCols; ++ulInfo)
+		{
+			if (pDBColumnInfo[ulInfo].iOrdinal == m_prgBinding[dwCol].iOrdinal)
+			{
+				pInfo = &pDBColumnInfo[ulInfo];
+				break;
+			}
+		}
+
+		if (NULL == pInfo)
+		{
+			return E_FAIL;
+		}
+
+		if (pInfo->pwszName)
+		{
+			wcsncpy(pColumn->wszName, pInfo->pwszName, MAX_EXPORT_COLUMN_NAME - 1);
+		}
+
+		pColumn->wType	   = pInfo->wType;
+		pColumn->wEncoding = COLUMNAR_ENC_PLAIN;
+
+		switch(pInfo->wType)
+		{
+		case DBTYPE_BYTES:
+			pColumn->wEncoding = COLUMNAR_ENC_BLOBREF;
+			break;
+
+		case DBTYPE_WSTR:
+			for (DWORD dwDict = 0; dwDict < sizeof(s_rgpwszDictionaryColumns)/sizeof(s_rgpwszDictionaryColumns[0]); ++dwDict)
+			{
+				if (0 == _wcsicmp(pColumn->wszName, s_rgpwszDictionaryColumns[dwDict]))
+				{
+					pColumn->wEncoding = COLUMNAR_ENC_DICT;
+				}
+			}
+			break;
+
+		default:
+			pColumn->cbWidth = m_prgBinding[dwCol].cbMaxLen;
+			break;
+		}
+
+		pColumn->cbNulls = cbNulls;
+		pColumn->pbNulls = (BYTE*)CoTaskMemAlloc(cbNulls);
+		if (NULL == pColumn->pbNulls)
+		{
+			return E_OUTOFMEMORY;
+		}
+
+		memset(pColumn->pbNulls, 0, cbNulls);
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StageRow
+//
+// Description: Append the values of one fetched row to the column buffers.
+//				Storage objects in the row are always released.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ColumnarExporter::StageRow(BYTE *pData)
+{
+	HRESULT		hr		= NOERROR;
+	DWORD		dwCol;
+
+	for (dwCol = 0; dwCol < m_cBindings; ++dwCol)
+	{
+		DBBINDING		*pBinding	= &m_prgBinding[dwCol];
+		EXPORT_COLUMN	*pColumn	= &m_rgColumns[dwCol];
+		DBSTATUS		dwStatus	= *(DBSTATUS*)(pData + pBinding->obStatus);
+		BYTE			*pbValue	= pData + pBinding->obValue;
+
+		if (DBSTATUS_S_ISNULL == dwStatus)
+		{
+			continue;
+		}
+
+		if (DBSTATUS_S_OK != dwStatus && DBSTATUS_S_TRUNCATED != dwStatus)
+		{
+			hr = E_FAIL;
+			break;
+		}
+
+		switch(pBinding->wType)
+		{
+		case DBTYPE_IUNKNOWN:
+			{
+				ISequentialStream *pISequentialStream = *(ISequentialStream**)pbValue;
+
+				hr = StageBlob(pISequentialStream, pColumn);
+				if (pISequentialStream)
+				{
+					pISequentialStream->Release();
+					*(ISequentialStream**)pbValue = NULL;
+				}
+			}
+			break;
+
+		case DBTYPE_WSTR:
+			{
+				DWORD	cbChars = *(ULONG*)(pData + pBinding->obLength);
+				WORD	cch;
+
+				// Truncated values only have the bound buffer available
+				//
+				if (cbChars > pBinding->cbMaxLen - sizeof(WCHAR))
+				{
+					cbChars = pBinding->cbMaxLen - sizeof(WCHAR);
+				}
+
+				cch		= (WORD)(cbChars / sizeof(WCHAR));
+				cbChars = cch * sizeof(WCHAR);
+
+				hr = GrowBuffer(&pColumn->pbValues, &pColumn->cbValuesMax, pColumn->cbValues + sizeof(WORD) + cbChars);
+				if (SUCCEEDED(hr))
+				{
+					memcpy(pColumn->pbValues + pColumn->cbValues, &cch, sizeof(WORD));
+					memcpy(pColumn->pbValues + pColumn->cbValues + sizeof(WORD), pbValue, cbChars);
+					pColumn->cbValues	+= sizeof(WORD) + cbChars;
+					m_Stats.cbSource	+= cbChars;
+				}
+			}
+			break;
+
+		default:
+			hr = GrowBuffer(&pColumn->pbValues, &pColumn->cbValuesMax, pColumn->cbValues + pColumn->cbWidth);
+			if (SUCCEEDED(hr))
+			{
+				memcpy(pColumn->pbValues + pColumn->cbValues, pbValue, pColumn->cbWidth);
+				pColumn->cbValues += pColumn->cbWidth;
+				m_Stats.cbSource  += pColumn->cbWidth;
+			}
+			break;
+		}
+
+		if (FAILED(hr))
+		{
+			break;
+		}
+
+		// Mark the row as present
+		//
+		pColumn->pbNulls[m_cRowsStaged / 8] |= (BYTE)(1 << (m_cRowsStaged % 8));
+	}
+
+	// Release storage objects left behind by a failure
+	//
+	for (; dwCol < m_cBindings; ++dwCol)
+	{
+		DBBINDING *pBinding = &m_prgBinding[dwCol];
+
+		if (DBTYPE_IUNKNOWN == pBinding->wType &&
+			DBSTATUS_S_OK == *(DBSTATUS*)(pData + pBinding->obStatus))
+		{
+			IUnknown *pIUnknown = *(IUnknown**)(pData + pBinding->obValue);
+			if (pIUnknown)
+			{
+				pIUnknown->Release();
+				*(IUnknown**)(pData + pBinding->obValue) = NULL;
+			}
+		}
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		++m_cRowsStaged;
+		++m_Stats.cRows;
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StageBlob
+//
+// Description: Copy a photo into the BLOB section and stage its reference.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ColumnarExporter::StageBlob(ISequentialStream *pISequentialStream, EXPORT_COLUMN *pColumn)
+{
+	HRESULT		hr			= NOERROR;
+	ULONGLONG	ibBlob		= m_cbBlobs;
+	DWORD		cbBlob		= 0;
+	ULONG		cbRead		= 0;
+	DWORD		cbWritten	= 0;
+
+	while (pISequentialStream)
+	{
+		hr = pISequentialStream->Read(m_pbCopy, BLOB_COPY_BUFFER_SIZE, &cbRead);
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+
+		if (0 == cbRead)
+		{
+			break;
+		}
+
+		if (!WriteFile(m_hBlobFile, m_pbCopy, cbRead, &cbWritten, NULL) || cbWritten != cbRead)
+		{
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+
+		cbBlob += cbRead;
+	}
+
+	m_cbBlobs			+= cbBlob;
+	m_Stats.cbBlobs		+= cbBlob;
+	m_Stats.cbSource	+= cbBlob;
+
+	hr = GrowBuffer(&pColumn->pbValues, &pColumn->cbValuesMax, pColumn->cbValues + sizeof(ULONGLONG) + sizeof(DWORD));
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	memcpy(pColumn->pbValues + pColumn->cbValues, &ibBlob, sizeof(ULONGLONG));
+	memcpy(pColumn->pbValues + pColumn->cbValues + sizeof(ULONGLONG), &cbBlob, sizeof(DWORD));
+	pColumn->cbValues += sizeof(ULONGLONG) + sizeof(DWORD);
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EncodeColumn
+//
+// Description: Encode and compress the staged values of one column.
+//				Runs on a compression thread; only touches its own column.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ColumnarExporter::EncodeColumn(EXPORT_COLUMN *pColumn, DWORD cRows)
+{
+	HRESULT		hr			= NOERROR;
+	DWORD		cbBitmap	= (cRows + 7) / 8;
+	DWORD		*rgdwHash	= NULL;				// Dictionary hash table, entry index + 1
+	DWORD		*rgdwEntry	= NULL;				// Offset of each entry in pbValues
+	WORD		*rgwIndex	= NULL;				// Entry index of each value
+	DWORD		cHash		= 16;
+	DWORD		cValues		= 0;
+	DWORD		cEntries	= 0;
+	DWORD		cbEntries	= 0;
+	DWORD		dwOffset;
+	DWORD		cbBound;
+
+	pColumn->wChunkEncoding = pColumn->wEncoding;
+
+	if (COLUMNAR_ENC_DICT == pColumn->wEncoding)
+	{
+		// Count the values to size the hash table
+		//
+		for (dwOffset = 0; dwOffset < pColumn->cbValues; ++cValues)
+		{
+			WORD cch;
+
+			memcpy(&cch, pColumn->pbValues + dwOffset, sizeof(WORD));
+			dwOffset += sizeof(WORD) + cch * sizeof(WCHAR);
+		}
+
+		while (cHash < cValues * 2)
+		{
+			cHash *= 2;
+		}
+
+		rgdwHash  = (DWORD*)CoTaskMemAlloc(sizeof(DWORD)*cHash);
+		rgdwEntry = (DWORD*)CoTaskMemAlloc(sizeof(DWORD)*(cValues + 1));
+		rgwIndex  = (WORD*)CoTaskMemAlloc(sizeof(WORD)*(cValues + 1));
+		if (NULL == rgdwHash || NULL == rgdwEntry || NULL == rgwIndex)
+		{
+			hr = E_OUTOFMEMORY;
+			goto Exit;
+		}
+
+		memset(rgdwHash, 0, sizeof(DWORD)*cHash);
+
+		// Assign an entry to each distinct value
+		//
+		cValues = 0;
+		for (dwOffset = 0; dwOffset < pColumn->cbValues; ++cValues)
+		{
+			WORD	cch;
+			BYTE	*pbChars;
+			DWORD	dwSlot;
+
+			memcpy(&cch, pColumn->pbValues + dwOffset, sizeof(WORD));
+			pbChars = pColumn->pbValues + dwOffset + sizeof(WORD);
+			dwSlot	= HashString(pbChars, cch * sizeof(WCHAR)) & (cHash - 1);
+
+			for (;;)
+			{
+				DWORD	dwEntry = rgdwHash[dwSlot];
+				WORD	cchEntry;
+
+				if (0 == dwEntry)
+				{
+					if (cEntries == COLUMNAR_MAX_DICT_ENTRIES)
+					{
+						break;
+					}
+
+					rgdwEntry[cEntries]	= dwOffset;
+					rgdwHash[dwSlot]	= ++cEntries;
+					rgwIndex[cValues]	= (WORD)(cEntries - 1);
+					cbEntries		   += sizeof(WORD) + cch * sizeof(WCHAR);
+					break;
+				}
+
+				memcpy(&cchEntry, pColumn->pbValues + rgdwEntry[dwEntry - 1], sizeof(WORD));
+				if (cchEntry == cch &&
+					0 == memcmp(pColumn->pbValues + rgdwEntry[dwEntry - 1] + sizeof(WORD), pbChars, cch * sizeof(WCHAR)))
+				{
+					rgwIndex[cValues] = (WORD)(dwEntry - 1);
+					break;
+				}
+
+				dwSlot = (dwSlot + 1) & (cHash - 1);
+			}
+
+			if (cEntries == COLUMNAR_MAX_DICT_ENTRIES && 0 == rgdwHash[dwSlot])
+			{
+				// Too many distinct values, this chunk stays plain
+				//
+				pColumn->wChunkEncoding = COLUMNAR_ENC_PLAIN;
+				break;
+			}
+
+			dwOffset += sizeof(WORD) + cch * sizeof(WCHAR);
+		}
+	}
+
+	if (COLUMNAR_ENC_DICT == pColumn->wChunkEncoding)
+	{
+		pColumn->cbDecoded = cbBitmap + sizeof(DWORD) + cbEntries + cValues * sizeof(WORD);
+	}
+	else
+	{
+		pColumn->cbDecoded = cbBitmap + pColumn->cbValues;
+	}
+
+	hr = GrowBuffer(&pColumn->pbDecoded, &pColumn->cbDecodedMax, pColumn->cbDecoded);
+	if (FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	memcpy(pColumn->pbDecoded, pColumn->pbNulls, cbBitmap);
+	dwOffset = cbBitmap;
+
+	if (COLUMNAR_ENC_DICT == pColumn->wChunkEncoding)
+	{
+		memcpy(pColumn->pbDecoded + dwOffset, &cEntries, sizeof(DWORD));
+		dwOffset += sizeof(DWORD);
+
+		for (DWORD dwEntry = 0; dwEntry < cEntries; ++dwEntry)
+		{
+			WORD cch;
+
+			memcpy(&cch, pColumn->pbValues + rgdwEntry[dwEntry], sizeof(WORD));
+			memcpy(pColumn->pbDecoded + dwOffset, pColumn->pbValues + rgdwEntry[dwEntry], sizeof(WORD) + cch * sizeof(WCHAR));
+			dwOffset += sizeof(WORD) + cch * sizeof(WCHAR);
+		}
+
+		memcpy(pColumn->pbDecoded + dwOffset, rgwIndex, cValues * sizeof(WORD));
+	}
+	else
+	{
+		memcpy(pColumn->pbDecoded + dwOffset, pColumn->pbValues, pColumn->cbValues);
+	}
+
+	// Compress the chunk, keep it uncompressed when that does not pay off
+	//
+	cbBound = LzCompressBound(pColumn->cbDecoded);
+	hr = GrowBuffer(&pColumn->pbStored, &pColumn->cbStoredMax, cbBound);
+	if (FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = LzCompress(pColumn->pbDecoded, pColumn->cbDecoded, pColumn->pbStored, cbBound, &pColumn->cbStored);
+	if (FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	if (pColumn->cbStored < pColumn->cbDecoded)
+	{
+		pColumn->wCompression = COMPRESSION_LZ;
+	}
+	else
+	{
+		pColumn->wCompression = COMPRESSION_NONE;
+		pColumn->cbStored	  = pColumn->cbDecoded;
+	}
+
+Exit:
+	if (rgdwHash)
+	{
+		CoTaskMemFree(rgdwHash);
+	}
+
+	if (rgdwEntry)
+	{
+		CoTaskMemFree(rgdwEntry);
+	}
+
+	if (rgwIndex)
+	{
+		CoTaskMemFree(rgwIndex);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompressThreadProc
+//
+// Description: Compression thread. Takes columns off the shared counter
+//				until every column of the row group has been encoded.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD WINAPI ColumnarExporter::CompressThreadProc(LPVOID lpParameter)
+{
+	ColumnarExporter	*pThis = (ColumnarExporter*)lpParameter;
+	LONG				lColumn;
+
+	while ((lColumn = InterlockedIncrement(&pThis->m_lNextColumn) - 1) < (LONG)pThis->m_cBindings)
+	{
+		EXPORT_COLUMN *pColumn = &pThis->m_rgColumns[lColumn];
+
+		pColumn->hr = EncodeColumn(pColumn, pThis->m_cRowsStaged);
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompressColumns
+//
+// Description: Encode and compress all columns of the staged row group,
+//				spreading the columns across the compression threads. The
+//				calling thread takes part in the work.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ColumnarExporter::CompressColumns()
+{
+	HANDLE	rghThreads[COLUMNAR_MAX_WORKERS];
+	DWORD	cThreads	= 0;
+	DWORD	cWorkers	= (m_cWorkers < m_cBindings) ? m_cWorkers : m_cBindings;
+	DWORD	dwStart		= GetTickCount();
+
+	m_lNextColumn = 0;
+
+	for (DWORD dwThread = 1; dwThread < cWorkers; ++dwThread)
+	{
+		HANDLE hThread = CreateThread(NULL, 0, CompressThreadProc, this, 0, NULL);
+
+		// Fewer threads only means less parallelism
+		//
+		if (NULL != hThread)
+		{
+			rghThreads[cThreads++] = hThread;
+		}
+	}
+
+	CompressThreadProc(this);
+
+	if (cThreads)
+	{
+		WaitForMultipleObjects(cThreads, rghThreads, TRUE, INFINITE);
+	}
+
+	for (DWORD dwThread = 0; dwThread < cThreads; ++dwThread)
+	{
+		CloseHandle(rghThreads[dwThread]);
+	}
+
+	m_Stats.dwCompressMs += GetTickCount() - dwStart;
+
+	for (DWORD dwCol = 0; dwCol < m_cBindings; ++dwCol)
+	{
+		if (FAILED(m_rgColumns[dwCol].hr))
+		{
+			return m_rgColumns[dwCol].hr;
+		}
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FlushRowGroup
+//
+// Description: Compress the staged row group and append it to the file.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ColumnarExporter::FlushRowGroup()
+{
+	HRESULT						hr = NOERROR;
+	COLUMNAR_ROWGROUP_HEADER	RowGroupHeader;
+
+	hr = CompressColumns();
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	// Remember where the row group starts for the footer
+	//
+	if (m_cRowGroups == m_cRowGroupsMax)
+	{
+		DWORD		cMax = m_cRowGroupsMax ? m_cRowGroupsMax * 2 : 16;
+		ULONGLONG	*rgibNew;
+
+		rgibNew = (ULONGLONG*)CoTaskMemRealloc(m_rgibRowGroups, sizeof(ULONGLONG)*cMax);
+		if (NULL == rgibNew)
+		{
+			return E_OUTOFMEMORY;
+		}
+
+		m_rgibRowGroups  = rgibNew;
+		m_cRowGroupsMax = cMax;
+	}
+
+	m_rgibRowGroups[m_cRowGroups++] = m_ibFile;
+
+	RowGroupHeader.dwMagic	= COLUMNAR_ROWGROUP_MAGIC;
+	RowGroupHeader.cRows	= m_cRowsStaged;
+
+	hr = WriteBytes(&RowGroupHeader, sizeof(RowGroupHeader));
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	for (DWORD dwCol = 0; dwCol < m_cBindings; ++dwCol)
+	{
+		EXPORT_COLUMN			*pColumn = &m_rgColumns[dwCol];
+		COLUMNAR_CHUNK_HEADER	ChunkHeader;
+
+		ChunkHeader.wEncoding	 = pColumn->wChunkEncoding;
+		ChunkHeader.wCompression = pColumn->wCompression;
+		ChunkHeader.cbDecoded	 = pColumn->cbDecoded;
+		ChunkHeader.cbStored	 = pColumn->cbStored;
+
+		hr = WriteBytes(&ChunkHeader, sizeof(ChunkHeader));
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+
+		hr = WriteBytes(COMPRESSION_LZ == pColumn->wCompression ? pColumn->pbStored : pColumn->pbDecoded,
+						pColumn->cbStored);
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+	}
+
+	++m_Stats.cRowGroups;
+
+	ResetColumns();
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: WriteHeader
+//
+// Description: Write the file header and the column descriptions.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ColumnarExporter::WriteHeader()
+{
+	HRESULT					hr = NOERROR;
+	COLUMNAR_FILE_HEADER	FileHeader;
+
+	FileHeader.dwMagic		 = COLUMNAR_FILE_MAGIC;
+	FileHeader.wVersion		 = COLUMNAR_FILE_VERSION;
+	FileHeader.cColumns		 = (WORD)m_cBindings;
+	FileHeader.cRowsPerGroup = m_cRowsPerGroup;
+
+	hr = WriteBytes(&FileHeader, sizeof(FileHeader));
+
+	for (DWORD dwCol = 0; SUCCEEDED(hr) && dwCol < m_cBindings; ++dwCol)
+	{
+		COLUMNAR_COLUMN_HEADER	ColumnHeader;
+		EXPORT_COLUMN			*pColumn = &m_rgColumns[dwCol];
+
+		ColumnHeader.wType	   = pColumn->wType;
+		ColumnHeader.wEncoding = pColumn->wEncoding;
+		ColumnHeader.cbWidth   = pColumn->cbWidth;
+		ColumnHeader.cchName   = (WORD)wcslen(pColumn->wszName);
+
+		hr = WriteBytes(&ColumnHeader, sizeof(ColumnHeader));
+		if (SUCCEEDED(hr))
+		{
+			hr = WriteBytes(pColumn->wszName, ColumnHeader.cchName * sizeof(WCHAR));
+		}
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: WriteFooter
+//
+// Description: Append the BLOB section, the row group offsets and the footer.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ColumnarExporter::WriteFooter()
+{
+	HRESULT					hr			= NOERROR;
+	COLUMNAR_BLOB_HEADER	BlobHeader;
+	COLUMNAR_FILE_FOOTER	Footer;
+	DWORD					cbRead		= 0;
+
+	Footer.ibBlobSection = m_ibFile;
+
+	BlobHeader.dwMagic = COLUMNAR_BLOB_MAGIC;
+	BlobHeader.cbBlobs = m_cbBlobs;
+
+	hr = WriteBytes(&BlobHeader, sizeof(BlobHeader));
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	// Copy the photos staged in the temporary file
+	//
+	if (0xFFFFFFFF == SetFilePointer(m_hBlobFile, 0, NULL, FILE_BEGIN))
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	for (;;)
+	{
+		if (!ReadFile(m_hBlobFile, m_pbCopy, BLOB_COPY_BUFFER_SIZE, &cbRead, NULL))
+		{
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+
+		if (0 == cbRead)
+		{
+			break;
+		}
+
+		hr = WriteBytes(m_pbCopy, cbRead);
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+	}
+
+	Footer.ibRowGroupOffsets = m_ibFile;
+	Footer.cRowGroups		 = m_cRowGroups;
+	Footer.cRows			 = m_Stats.cRows;
+	Footer.dwMagic			 = COLUMNAR_FOOTER_MAGIC;
+
+	if (m_cRowGroups)
+	{
+		hr = WriteBytes(m_rgibRowGroups, sizeof(ULONGLONG)*m_cRowGroups);
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+	}
+
+	return WriteBytes(&Footer, sizeof(Footer));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: WriteBytes
+//
+// Description: Write to the output file and track the file offset.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ColumnarExporter::WriteBytes(const void *pv, DWORD cb)
+{
+	DWORD cbWritten = 0;
+
+	if (0 == cb)
+	{
+		return NOERROR;
+	}
+
+	if (!WriteFile(m_hFile, pv, cb, &cbWritten, NULL) || cbWritten != cb)
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	m_ibFile += cb;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ResetColumns
+//
+// Description: Empty the column buffers for the next row group. The buffers
+//				themselves are kept and reused.
+//
+////////////////////////////////////////////////////////////////////////////////
+void ColumnarExporter::ResetColumns()
+{
+	for (DWORD dwCol = 0; dwCol < m_cBindings; ++dwCol)
+	{
+		EXPORT_COLUMN *pColumn = &m_rgColumns[dwCol];
+
+		memset(pColumn->pbNulls, 0, pColumn->cbNulls);
+		pColumn->cbValues	= 0;
+		pColumn->cbDecoded	= 0;
+		pColumn->cbStored	= 0;
+		pColumn->hr			= NOERROR;
+	}
+
+	m_cRowsStaged = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FreeColumns
+//
+// Description: Release all export state.
+//
+////////////////////////////////////////////////////////////////////////////////
+void ColumnarExporter::FreeColumns()
+{
+	if (m_rgColumns)
+	{
+		for (DWORD dwCol = 0; dwCol < m_cBindings; ++dwCol)
+		{
+			EXPORT_COLUMN *pColumn = &m_rgColumns[dwCol];
+
+			if (pColumn->pbNulls)
+			{
+				CoTaskMemFree(pColumn->pbNulls);
+			}
+
+			if (pColumn->pbValues)
+			{
+				CoTaskMemFree(pColumn->pbValues);
+			}
+
+			if (pColumn->pbDecoded)
+			{
+				CoTaskMemFree(pColumn->pbDecoded);
+			}
+
+			if (pColumn->pbStored)
+			{
+				CoTaskMemFree(pColumn->pbStored);
+			}
+		}
+
+		CoTaskMemFree(m_rgColumns);
+		m_rgColumns = NULL;
+	}
+
+	FreeColumnBindings(m_prgBinding);
+	m_prgBinding = NULL;
+	m_cBindings	 = 0;
+
+	if (m_rgibRowGroups)
+	{
+		CoTaskMemFree(m_rgibRowGroups);
+		m_rgibRowGroups = NULL;
+	}
+
+	m_cRowGroups	= 0;
+	m_cRowGroupsMax = 0;
+
+	if (m_pbCopy)
+	{
+		CoTaskMemFree(m_pbCopy);
+		m_pbCopy = NULL;
+	}
+
+	m_cRowsStaged	= 0;
+	m_ibFile		= 0;
+	m_cbBlobs		= 0;
+}
@@ -0,0 +1,181 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: ColumnarExporter
+//
+// File: ColumnarExport.h
+//
+// Comment: Streaming export of the Employees table to a compressed,
+//			column oriented file.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_COLUMNAREXPORT_H__3F7A1C52_8E0D_4B6A_A1F4_5D9C20E7B813__INCLUDED_)
+#define AFX_COLUMNAREXPORT_H__3F7A1C52_8E0D_4B6A_A1F4_5D9C20E7B813__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+////////////////////////////////////////////////////////////////////////////////
+// File layout
+//
+//		COLUMNAR_FILE_HEADER
+//		COLUMNAR_COLUMN_HEADER + column name, for each column
+//		row groups:
+//			COLUMNAR_ROWGROUP_HEADER
+//			COLUMNAR_CHUNK_HEADER + stored chunk, for each column
+//		COLUMNAR_BLOB_HEADER + photo bytes
+//		row group offsets (ULONGLONG each)
+//		COLUMNAR_FILE_FOOTER
+//
+// A decoded chunk starts with a null bitmap of (cRows + 7) / 8 bytes,
+// followed by the values of the non-null rows:
+//
+//		COLUMNAR_ENC_PLAIN		fixed width values, or WORD cch + WCHARs for strings
+//		COLUMNAR_ENC_DICT		DWORD entry count, entries as WORD cch + WCHARs,
+//								then one WORD entry index per value
+//		COLUMNAR_ENC_BLOBREF	ULONGLONG offset into the BLOB section + DWORD length
+//
+// All integers are little-endian.
+//
+#define COLUMNAR_FILE_MAGIC			0x5843574E		// 'NWCX'
+#define COLUMNAR_ROWGROUP_MAGIC		0x50524752		// 'RGRP'
+#define COLUMNAR_BLOB_MAGIC			0x424F4C42		// 'BLOB'
+#define COLUMNAR_FOOTER_MAGIC		0x4643574E		// 'NWCF'
+#define COLUMNAR_FILE_VERSION		1
+
+#define COLUMNAR_ENC_PLAIN			0
+#define COLUMNAR_ENC_DICT			1
+#define COLUMNAR_ENC_BLOBREF		2
+
+#define COLUMNAR_DEFAULT_ROWS		1024		// Rows per row group
+#define COLUMNAR_DEFAULT_WORKERS	4			// Compression threads
+#define COLUMNAR_MAX_WORKERS		16
+#define COLUMNAR_MAX_DICT_ENTRIES	0xFFFF		// Larger chunks fall back to plain
+#define COLUMNAR_FETCH_ROWS			64			// Row handles fetched per GetNextRows
+
+#include <pshpack1.h>
+
+typedef struct tagCOLUMNAR_FILE_HEADER
+{
+	DWORD		dwMagic;
+	WORD		wVersion;
+	WORD		cColumns;
+	DWORD		cRowsPerGroup;
+} COLUMNAR_FILE_HEADER;
+
+typedef struct tagCOLUMNAR_COLUMN_HEADER
+{
+	WORD		wType;				// Source DBTYPE
+	WORD		wEncoding;			// Preferred encoding
+	DWORD		cbWidth;			// Value width of fixed size columns
+	WORD		cchName;			// Followed by the column name
+} COLUMNAR_COLUMN_HEADER;
+
+typedef struct tagCOLUMNAR_ROWGROUP_HEADER
+{
+	DWORD		dwMagic;
+	DWORD		cRows;
+} COLUMNAR_ROWGROUP_HEADER;
+
+typedef struct tagCOLUMNAR_CHUNK_HEADER
+{
+	WORD		wEncoding;			// Encoding actually used for this chunk
+	WORD		wCompression;		// COMPRESSION_NONE or COMPRESSION_LZ
+	DWORD		cbDecoded;
+	DWORD		cbStored;
+} COLUMNAR_CHUNK_HEADER;
+
+typedef struct tagCOLUMNAR_BLOB_HEADER
+{
+	DWORD		dwMagic;
+	ULONGLONG	cbBlobs;
+} COLUMNAR_BLOB_HEADER;
+
+typedef struct tagCOLUMNAR_FILE_FOOTER
+{
+	ULONGLONG	ibBlobSection;
+	ULONGLONG	ibRowGroupOffsets;
+	DWORD		cRowGroups;
+	DWORD		cRows;
+	DWORD		dwMagic;
+} COLUMNAR_FILE_FOOTER;
+
+#include <poppack.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Export statistics
+//
+typedef struct tagEXPORT_STATS
+{
+	DWORD		cRows;				// Rows exported
+	DWORD		cRowGroups;			// Row groups written
+	ULONGLONG	cbSource;			// Bytes read from the provider, photos included
+	ULONGLONG	cbBlobs;			// Photo bytes
+	ULONGLONG	cbWritten;			// Size of the output file
+	DWORD		dwElapsedMs;		// Wall clock time of the export
+	DWORD		dwCompressMs;		// Time spent waiting for column compression
+	DWORD		dwMBps100;			// Source throughput in hundredths of MB/s
+} EXPORT_STATS;
+
+////////////////////////////////////////////////////////////////////////////////
+// Per column staging state, internal to the exporter
+//
+typedef struct tagEXPORT_COLUMN EXPORT_COLUMN;
+
+class ColumnarExporter
+{
+public:
+	ColumnarExporter();
+	~ColumnarExporter();
+
+	void	SetRowsPerGroup(DWORD cRowsPerGroup);
+	void	SetWorkerCount(DWORD cWorkers);
+
+	HRESULT Export(IDBCreateSession *pIDBCreateSession, LPCWSTR pwszFile, EXPORT_STATS *pStats);
+
+private:
+	HRESULT	PrepareColumns(DBCOLUMNINFO *pDBColumnInfo, ULONG ulNumCols);
+	HRESULT	StageRow(BYTE *pData);
+	HRESULT	StageBlob(ISequentialStream *pISequentialStream, EXPORT_COLUMN *pColumn);
+	HRESULT	FlushRowGroup();
+	HRESULT	CompressColumns();
+	HRESULT	WriteHeader();
+	HRESULT	WriteFooter();
+	HRESULT	WriteBytes(const void *pv, DWORD cb);
+	void	ResetColumns();
+	void	FreeColumns();
+
+	static HRESULT	EncodeColumn(EXPORT_COLUMN *pColumn, DWORD cRows);
+	static DWORD WINAPI CompressThreadProc(LPVOID lpParameter);
+
+	DWORD			m_cRowsPerGroup;
+	DWORD			m_cWorkers;
+
+	HANDLE			m_hFile;				// Output file
+	HANDLE			m_hBlobFile;			// Temporary BLOB section
+	WCHAR			m_wszBlobFile[MAX_PATH];
+	ULONGLONG		m_ibFile;				// Current output file offset
+	ULONGLONG		m_cbBlobs;				// Current BLOB section size
+	BYTE			*m_pbCopy;				// BLOB copy buffer
+
+	DBBINDING		*m_prgBinding;
+	DWORD			m_cBindings;
+	EXPORT_COLUMN	*m_rgColumns;
+
+	DWORD			m_cRowsStaged;			// Rows in the current row group
+	LONG			m_lNextColumn;			// Next column for the compression threads
+
+	ULONGLONG		*m_rgibRowGroups;		// Row group offsets for the footer
+	DWORD			m_cRowGroups;
+	DWORD			m_cRowGroupsMax;
+
+	EXPORT_STATS	m_Stats;
+};
+
+#endif // !defined(AFX_COLUMNAREXPORT_H__3F7A1C52_8E0D_4B6A_A1F4_5D9C20E7B813__INCLUDED_)
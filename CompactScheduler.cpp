@@ -0,0 +1,1028 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: CompactScheduler
+//
+// File: CompactScheduler.cpp
+//
+// Comment: Background compaction of the database file during idle periods.
+//
+// Functions:
+//			1. Estimate free space and growth of the database file
+//			2. Compact into a new file with ISSCEEngine::CompactDatabase
+//			3. Swap the compacted file in, and recover an interrupted swap
+//			4. Adapt the required quiet period to the foreground latency
+//			5. Keep the change log to its retention limit
+//
+// Notes:
+//			The swap renames the original to COMPACT_BACKUP_SUFFIX, renames
+//			the compacted copy into place and deletes the backup. If the
+//			device stops between the two renames, Start puts the original
+//			back.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "sqlce_sync.h"
+#include "DbHelpers.h"
+#include "ChangeLog.h"
+#include "CompactScheduler.h"
+
+#define COMPACT_BASELINE_SIGNATURE	0x424D4350		// "PCMB"
+
+// Contents of the baseline file
+//
+typedef struct tagCOMPACT_BASELINE
+{
+	DWORD		dwSignature;
+	DWORD		cRows;
+	ULONGLONG	cbFile;
+} COMPACT_BASELINE;
+
+CompactScheduler	g_CompactScheduler;			// Compaction of the application database
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::CompactScheduler()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+CompactScheduler::CompactScheduler() : m_hThread(NULL),
+									   m_hStop(NULL),
+									   m_cbBaseline(0),
+									   m_cBaselineRows(0),
+									   m_dwLastActivityMs(0),
+									   m_cLatencies(0),
+									   m_iLatency(0),
+									   m_cNewLatencies(0),
+									   m_dwIdleMs(0),
+									   m_fCompacting(FALSE)
+{
+	InitializeCriticalSection(&m_cs);
+
+	memset(&m_Settings, 0, sizeof(m_Settings));
+	memset(&m_Stats, 0, sizeof(m_Stats));
+	m_wszDatabase[0] = WCHAR('\0');
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::~CompactScheduler()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+CompactScheduler::~CompactScheduler()
+{
+	Stop();
+	DeleteCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::Start()
+//
+// Description: Recover an interrupted swap and start the scheduler thread.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CompactScheduler::Start(const COMPACT_SETTINGS *pSettings)
+{
+	HRESULT hr = NOERROR;
+
+	if (NULL == pSettings || NULL == pSettings->pwszDatabase || NULL == pSettings->pfnConnections ||
+		0 == pSettings->dwCheckIntervalMs || 0 == pSettings->dwIdleMs ||
+		wcslen(pSettings->pwszDatabase) + 16 >= MAX_PATH)
+	{
+		return E_INVALIDARG;
+	}
+
+	if (m_hThread)
+	{
+		return E_UNEXPECTED;
+	}
+
+	wcscpy(m_wszDatabase, pSettings->pwszDatabase);
+
+	m_Settings				= *pSettings;
+	m_Settings.pwszDatabase	= m_wszDatabase;
+
+	m_dwIdleMs			= pSettings->dwIdleMs;
+	m_dwLastActivityMs	= GetTickCount();
+	m_cLatencies		= 0;
+	m_iLatency			= 0;
+	m_cNewLatencies		= 0;
+
+	RecoverSwap();
+
+	// Without a baseline the first measurement becomes the baseline
+	//
+	if (FAILED(LoadBaseline()))
+	{
+		m_cbBaseline	= 0;
+		m_cBaselineRows	= 0;
+	}
+
+	m_hStop = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (NULL == m_hStop)
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto Exit;
+	}
+
+	m_hThread = CreateThread(NULL, 0, ThreadProc, this, 0, NULL);
+	if (NULL == m_hThread)
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto Exit;
+	}
+
+	// Measurement and compaction yield to the user interface
+	//
+	SetThreadPriority(m_hThread, THREAD_PRIORITY_BELOW_NORMAL);
+
+Exit:
+	if (FAILED(hr) && m_hStop)
+	{
+		CloseHandle(m_hStop);
+		m_hStop = NULL;
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::Stop()
+//
+// Description: Stop the scheduler thread. A compaction in progress
+//				completes first.
+//
+////////////////////////////////////////////////////////////////////////////////
+void CompactScheduler::Stop()
+{
+	if (m_hThread)
+	{
+		SetEvent(m_hStop);
+		WaitForSingleObject(m_hThread, INFINITE);
+
+		CloseHandle(m_hThread);
+		m_hThread = NULL;
+	}
+
+	if (m_hStop)
+	{
+		CloseHandle(m_hStop);
+		m_hStop = NULL;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::NoteForegroundActivity()
+//
+// Description: Report a foreground database operation and its latency.
+//				Called by the application after each operation.
+//
+////////////////////////////////////////////////////////////////////////////////
+void CompactScheduler::NoteForegroundActivity(DWORD dwLatencyMs)
+{
+	EnterCriticalSection(&m_cs);
+
+	m_dwLastActivityMs = GetTickCount();
+
+	m_rgdwLatencyMs[m_iLatency] = dwLatencyMs;
+	m_iLatency = (m_iLatency + 1) % COMPACT_LATENCY_SAMPLES;
+
+	if (m_cLatencies < COMPACT_LATENCY_SAMPLES)
+	{
+		m_cLatencies++;
+	}
+
+	m_cNewLatencies++;
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::CompactNow()
+//
+// Description: Compact immediately, whether due or not, on the calling
+//				thread.
+//
+// Returns: NOERROR if succesfull, S_FALSE if a compaction is in progress
+//			or the application refused to release its connections
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CompactScheduler::CompactNow()
+{
+	HRESULT	hr;
+	DWORD	cRows = 0;
+
+	if (NULL == m_Settings.pwszDatabase)
+	{
+		return E_UNEXPECTED;
+	}
+
+	hr = TrimChangeLog();
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	hr = CountRows(&cRows);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	return Compact(cRows);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::GetStats()
+//
+// Description: Copy the scheduler statistics.
+//
+////////////////////////////////////////////////////////////////////////////////
+void CompactScheduler::GetStats(COMPACT_STATS *pStats)
+{
+	EnterCriticalSection(&m_cs);
+
+	*pStats				= m_Stats;
+	pStats->dwIdleMs	= m_dwIdleMs;
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::ThreadProc()
+//
+// Description: Scheduler thread. Wakes up every check interval until Stop.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD WINAPI CompactScheduler::ThreadProc(LPVOID lpParameter)
+{
+	CompactScheduler	*pThis	= (CompactScheduler*)lpParameter;
+	BOOL				fCoInit	= SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+
+	while (WAIT_TIMEOUT == WaitForSingleObject(pThis->m_hStop, pThis->m_Settings.dwCheckIntervalMs))
+	{
+		pThis->Schedule();
+	}
+
+	if (fCoInit)
+	{
+		CoUninitialize();
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::Schedule()
+//
+// Description: Measure the file when the application is idle and compact it
+//				if it is due and the application is still idle.
+//
+////////////////////////////////////////////////////////////////////////////////
+void CompactScheduler::Schedule()
+{
+	COMPACT_MEASURE Measurement;
+
+	AdjustIdlePeriod();
+
+	if (!IsIdle())
+	{
+		return;
+	}
+
+	// A database without a change log is measured all the same
+	//
+	TrimChangeLog();
+
+	if (FAILED(Measure(&Measurement)))
+	{
+		return;
+	}
+
+	EnterCriticalSection(&m_cs);
+	m_Stats.LastMeasure = Measurement;
+	LeaveCriticalSection(&m_cs);
+
+	if (!IsDue(&Measurement))
+	{
+		return;
+	}
+
+	// The measurement took time; the user may be back
+	//
+	if (!IsIdle())
+	{
+		EnterCriticalSection(&m_cs);
+		m_Stats.cPostponed++;
+		LeaveCriticalSection(&m_cs);
+		return;
+	}
+
+	Compact(Measurement.cRows);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::IsIdle()
+//
+// Description: Returns TRUE if no foreground operation was reported during
+//				the current quiet period.
+//
+////////////////////////////////////////////////////////////////////////////////
+BOOL CompactScheduler::IsIdle()
+{
+	BOOL fIdle;
+
+	EnterCriticalSection(&m_cs);
+	fIdle = (GetTickCount() - m_dwLastActivityMs) >= m_dwIdleMs;
+	LeaveCriticalSection(&m_cs);
+
+	return fIdle;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::IsDue()
+//
+// Description: Returns TRUE if the measurement reaches a threshold. A zero
+//				threshold is not checked.
+//
+////////////////////////////////////////////////////////////////////////////////
+BOOL CompactScheduler::IsDue(const COMPACT_MEASURE *pMeasure)
+{
+	if (pMeasure->cbFile < m_Settings.cbMinFileSize)
+	{
+		return FALSE;
+	}
+
+	return (m_Settings.dwFreePercent   && pMeasure->dwFreePercent   >= m_Settings.dwFreePercent) ||
+		   (m_Settings.dwGrowthPercent && pMeasure->dwGrowthPercent >= m_Settings.dwGrowthPercent);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::AdjustIdlePeriod()
+//
+// Description: Double the quiet period while the 95th percentile of the
+//				foreground latency is over budget, halve it back while it is
+//				within. Only adjusts when new latencies were reported.
+//
+////////////////////////////////////////////////////////////////////////////////
+void CompactScheduler::AdjustIdlePeriod()
+{
+	DWORD dwP95;
+
+	EnterCriticalSection(&m_cs);
+
+	if (m_cNewLatencies)
+	{
+		m_cNewLatencies = 0;
+
+		dwP95 = GetLatencyPercentile(95);
+		m_Stats.dwLatencyP95Ms = dwP95;
+
+		if (m_Settings.dwLatencyBudgetMs && dwP95 > m_Settings.dwLatencyBudgetMs)
+		{
+			if (m_dwIdleMs < m_Settings.dwIdleMs * COMPACT_MAX_IDLE_BACKOFF)
+			{
+				m_dwIdleMs *= 2;
+			}
+		}
+		else if (m_dwIdleMs > m_Settings.dwIdleMs)
+		{
+			m_dwIdleMs /= 2;
+		}
+
+		if (m_dwIdleMs < m_Settings.dwIdleMs)
+		{
+			m_dwIdleMs = m_Settings.dwIdleMs;
+		}
+	}
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::GetLatencyPercentile()
+//
+// Description: Returns a percentile of the latencies kept. Called with the
+//				critical section held.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD CompactScheduler::GetLatencyPercentile(DWORD dwPercentile)
+{
+	DWORD	rgdwSorted[COMPACT_LATENCY_SAMPLES];
+	DWORD	dwIndex;
+	DWORD	dwValue;
+	DWORD	j;
+
+	if (0 == m_cLatencies)
+	{
+		return 0;
+	}
+
+	// Insertion sort, there are at most COMPACT_LATENCY_SAMPLES values
+	//
+	for (dwIndex = 0; dwIndex < m_cLatencies; ++dwIndex)
+	{
+		dwValue = m_rgdwLatencyMs[dwIndex];
+
+		for (j = dwIndex; j > 0 && rgdwSorted[j - 1] > dwValue; --j)
+		{
+			rgdwSorted[j] = rgdwSorted[j - 1];
+		}
+
+		rgdwSorted[j] = dwValue;
+	}
+
+	dwIndex = (m_cLatencies * dwPercentile) / 100;
+	if (dwIndex >= m_cLatencies)
+	{
+		dwIndex = m_cLatencies - 1;
+	}
+
+	return rgdwSorted[dwIndex];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::TrimChangeLog()
+//
+// Description: Drop the change log entries beyond the newest
+//				cChangeLogEntries. No consumer of the change log records
+//				what it has read, so the count is the whole policy; a
+//				consumer that falls further behind rescans the table.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CompactScheduler::TrimChangeLog()
+{
+	HRESULT				hr					= NOERROR;
+	IDBCreateSession	*pIDBCreateSession	= NULL;					// Data source
+	ULONG				ulCompactedTo		= 0;
+
+	if (0 == m_Settings.cChangeLogEntries)
+	{
+		return NOERROR;
+	}
+
+	hr = OpenDataSource(m_Settings.pwszDatabase, &pIDBCreateSession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = CompactChangeLog(pIDBCreateSession, 0, m_Settings.cChangeLogEntries, &ulCompactedTo);
+	if (SUCCEEDED(hr) && ulCompactedTo)
+	{
+		EnterCriticalSection(&m_cs);
+		m_Stats.ulChangeLogCompactedTo = ulCompactedTo;
+		LeaveCriticalSection(&m_cs);
+	}
+
+Exit:
+	if (pIDBCreateSession)
+	{
+		pIDBCreateSession->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::Measure()
+//
+// Description: Measure the file and estimate its free space against the
+//				baseline: the live data is assumed to scale with the row
+//				count.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CompactScheduler::Measure(COMPACT_MEASURE *pMeasure)
+{
+	HRESULT		hr;
+	ULONGLONG	cbLive;
+
+	memset(pMeasure, 0, sizeof(COMPACT_MEASURE));
+
+	hr = GetDatabaseFileSize(m_Settings.pwszDatabase, &pMeasure->cbFile);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	hr = CountRows(&pMeasure->cRows);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	if (0 == m_cbBaseline)
+	{
+		m_cbBaseline	= pMeasure->cbFile;
+		m_cBaselineRows	= pMeasure->cRows;
+		SaveBaseline();
+	}
+
+	cbLive = m_cbBaseline;
+	if (m_cBaselineRows)
+	{
+		cbLive = (m_cbBaseline * pMeasure->cRows) / m_cBaselineRows;
+	}
+
+	if (cbLive < pMeasure->cbFile)
+	{
+		pMeasure->dwFreePercent = (DWORD)(((pMeasure->cbFile - cbLive) * 100) / pMeasure->cbFile);
+	}
+
+	if (m_cbBaseline < pMeasure->cbFile)
+	{
+		pMeasure->dwGrowthPercent = (DWORD)(((pMeasure->cbFile - m_cbBaseline) * 100) / m_cbBaseline);
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::CountRows()
+//
+// Description: Count the rows of every user table, pausing dwThrottleMs
+//				between tables and giving up when foreground work resumes.
+//
+// Returns: NOERROR if succesfull, E_ABORT if interrupted
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CompactScheduler::CountRows(DWORD *pcRows)
+{
+	HRESULT				hr					= NOERROR;
+	IDBCreateSession	*pIDBCreateSession	= NULL;					// Data source
+	IOpenRowset			*pISession			= NULL;					// Provider Interface Pointer
+	IRowset				*pIRowset			= NULL;					// Provider Interface Pointer
+	IAccessor			*pIAccessor			= NULL;					// Provider Interface Pointer
+	HACCESSOR			hAccessor			= DB_NULL_HACCESSOR;	// Accessor handle
+	DBBINDING			*prgBinding			= NULL;
+	DWORD				cBindings			= 0;
+	DWORD				cbRowSize			= 0;
+	BYTE				*pData				= NULL;
+	WCHAR				*pwszTables			= NULL;					// Table names, MAX_PATH apart
+	DWORD				cTables				= 0;
+	HROW				rghRows[1]			= {DB_NULL_HROW};
+	HROW				*prghRows			= rghRows;
+	ULONG				cRowsObtained;
+	WCHAR				wszQuery[MAX_PATH + 32];
+	WCHAR				*rgpwszColumns[]	= {L"TABLE_NAME"};
+	LONG				lRows;
+	BOOL				fNull;
+	BOOL				fActive;
+	DWORD				dwActivityMs;
+
+	*pcRows = 0;
+
+	EnterCriticalSection(&m_cs);
+	dwActivityMs = m_dwLastActivityMs;
+	LeaveCriticalSection(&m_cs);
+
+	hr = OpenDataSource(m_Settings.pwszDatabase, &pIDBCreateSession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pISession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Collect the user table names first, one rowset at a time
+	//
+	hr = ExecuteQuery(pISession, L"SELECT TABLE_NAME FROM INFORMATION_SCHEMA.TABLES WHERE TABLE_TYPE = 'TABLE'", &pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = CreateColumnBindings(pIRowset, rgpwszColumns, 1, NULL, &prgBinding, &cBindings, &cbRowSize);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, cBindings, prgBinding, 0, &hAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	pData	   = (BYTE*)CoTaskMemAlloc(cbRowSize);
+	pwszTables = (WCHAR*)CoTaskMemAlloc(sizeof(WCHAR)*MAX_PATH*COMPACT_MAX_TABLES);
+	if (NULL == pData || NULL == pwszTables)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	while (cTables < COMPACT_MAX_TABLES)
+	{
+		hr = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, 1, &cRowsObtained, &prghRows);
+		if (FAILED(hr) || 0 == cRowsObtained)
+		{
+			hr = FAILED(hr) ? hr : NOERROR;
+			break;
+		}
+
+		memset(pData, 0, cbRowSize);
+
+		hr = pIRowset->GetData(rghRows[0], hAccessor, pData);
+
+		pIRowset->ReleaseRows(1, rghRows, NULL, NULL, NULL);
+		rghRows[0] = DB_NULL_HROW;
+
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		if (DBSTATUS_S_OK == *(DBSTATUS*)(pData + prgBinding[0].obStatus))
+		{
+			wcsncpy(pwszTables + cTables*MAX_PATH, (WCHAR*)(pData + prgBinding[0].obValue), MAX_PATH - 1);
+			pwszTables[cTables*MAX_PATH + MAX_PATH - 1] = WCHAR('\0');
+			cTables++;
+		}
+	}
+
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	pIAccessor->ReleaseAccessor(hAccessor, NULL);
+	hAccessor = DB_NULL_HACCESSOR;
+	pIAccessor->Release();
+	pIAccessor = NULL;
+	pIRowset->Release();
+	pIRowset = NULL;
+
+	for (DWORD dwTable = 0; dwTable < cTables; ++dwTable)
+	{
+		// Leave the disk to the foreground between tables
+		//
+		if (m_Settings.dwThrottleMs)
+		{
+			if (NULL == m_hStop)
+			{
+				Sleep(m_Settings.dwThrottleMs);
+			}
+			else if (WAIT_TIMEOUT != WaitForSingleObject(m_hStop, m_Settings.dwThrottleMs))
+			{
+				hr = E_ABORT;
+				goto Exit;
+			}
+		}
+
+		EnterCriticalSection(&m_cs);
+		fActive = (dwActivityMs != m_dwLastActivityMs);
+		LeaveCriticalSection(&m_cs);
+
+		if (fActive)
+		{
+			hr = E_ABORT;
+			goto Exit;
+		}
+
+		wsprintf(wszQuery, L"SELECT COUNT(*) FROM [%s]", pwszTables + dwTable*MAX_PATH);
+
+		hr = ExecuteScalar(pISession, wszQuery, &lRows, &fNull);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		if (!fNull)
+		{
+			*pcRows += (DWORD)lRows;
+		}
+	}
+
+Exit:
+	if (pIRowset && DB_NULL_HROW != rghRows[0])
+	{
+		pIRowset->ReleaseRows(1, rghRows, NULL, NULL, NULL);
+	}
+
+	if (pIAccessor)
+	{
+		pIAccessor->ReleaseAccessor(hAccessor, NULL);
+		pIAccessor->Release();
+	}
+
+	if (pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	FreeColumnBindings(prgBinding);
+
+	if (pData)
+	{
+		CoTaskMemFree(pData);
+	}
+
+	if (pwszTables)
+	{
+		CoTaskMemFree(pwszTables);
+	}
+
+	if (pISession)
+	{
+		pISession->Release();
+	}
+
+	if (pIDBCreateSession)
+	{
+		pIDBCreateSession->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::Compact()
+//
+// Description: Have the application release its connections, compact into
+//				a new file, swap it in and let the application reopen.
+//
+// Parameters
+//		cRows	- row count of the database, recorded in the new baseline
+//
+// Returns: NOERROR if succesfull, S_FALSE if postponed
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CompactScheduler::Compact(DWORD cRows)
+{
+	HRESULT			hr				= NOERROR;
+	HRESULT			hrReopen;
+	ISSCEEngine		*pISSCEEngine	= NULL;				// Engine object
+	BSTR			bstrSource		= NULL;
+	BSTR			bstrDestination	= NULL;
+	WCHAR			wszCompacted[MAX_PATH];
+	WCHAR			wszBackup[MAX_PATH];
+	WCHAR			wszConnect[MAX_PATH + 32];
+	ULONGLONG		cbBefore		= 0;
+	ULONGLONG		cbAfter			= 0;
+	DWORD			dwStartMs;
+	BOOL			fReleased		= FALSE;
+
+	if (InterlockedExchange(&m_fCompacting, TRUE))
+	{
+		return S_FALSE;
+	}
+
+	dwStartMs = GetTickCount();
+
+	wsprintf(wszCompacted, L"%s%s", m_Settings.pwszDatabase, COMPACT_TEMP_SUFFIX);
+	wsprintf(wszBackup,	   L"%s%s", m_Settings.pwszDatabase, COMPACT_BACKUP_SUFFIX);
+
+	// The engine refuses an existing destination
+	//
+	DeleteFile(wszCompacted);
+
+	hr = CoCreateInstance(CLSID_Engine, NULL, CLSCTX_INPROC_SERVER, IID_ISSCEEngine, (void**)&pISSCEEngine);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	wsprintf(wszConnect, L"Data Source=%s", m_Settings.pwszDatabase);
+	bstrSource = SysAllocString(wszConnect);
+
+	wsprintf(wszConnect, L"Data Source=%s", wszCompacted);
+	bstrDestination = SysAllocString(wszConnect);
+
+	if (NULL == bstrSource || NULL == bstrDestination)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	hr = m_Settings.pfnConnections(m_Settings.pvContext, COMPACT_RELEASE_CONNECTIONS);
+	if (FAILED(hr) || S_FALSE == hr)
+	{
+		EnterCriticalSection(&m_cs);
+		m_Stats.cPostponed++;
+		LeaveCriticalSection(&m_cs);
+		goto Exit;
+	}
+
+	fReleased = TRUE;
+
+	GetDatabaseFileSize(m_Settings.pwszDatabase, &cbBefore);
+
+	hr = pISSCEEngine->CompactDatabase(bstrSource, bstrDestination);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = SwapFiles(wszCompacted, wszBackup);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	GetDatabaseFileSize(m_Settings.pwszDatabase, &cbAfter);
+
+Exit:
+	if (FAILED(hr))
+	{
+		DeleteFile(wszCompacted);
+	}
+
+	if (fReleased)
+	{
+		hrReopen = m_Settings.pfnConnections(m_Settings.pvContext, COMPACT_REOPEN_CONNECTIONS);
+		if (SUCCEEDED(hr) && FAILED(hrReopen))
+		{
+			hr = hrReopen;
+		}
+	}
+
+	if (fReleased && SUCCEEDED(hr))
+	{
+		EnterCriticalSection(&m_cs);
+		m_Stats.cCompactions++;
+		m_Stats.dwLastCompactMs	= GetTickCount() - dwStartMs;
+		m_Stats.cbLastBefore	= cbBefore;
+		m_Stats.cbLastAfter		= cbAfter;
+		LeaveCriticalSection(&m_cs);
+
+		m_cbBaseline	= cbAfter;
+		m_cBaselineRows	= cRows;
+		SaveBaseline();
+	}
+
+	if (bstrSource)
+	{
+		SysFreeString(bstrSource);
+	}
+
+	if (bstrDestination)
+	{
+		SysFreeString(bstrDestination);
+	}
+
+	if (pISSCEEngine)
+	{
+		pISSCEEngine->Release();
+	}
+
+	InterlockedExchange(&m_fCompacting, FALSE);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::SwapFiles()
+//
+// Description: Put the compacted file in place of the database. On failure
+//				the original file is back in place.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CompactScheduler::SwapFiles(LPCWSTR pwszCompacted, LPCWSTR pwszBackup)
+{
+	HRESULT hr;
+
+	DeleteFile(pwszBackup);
+
+	if (!MoveFile(m_Settings.pwszDatabase, pwszBackup))
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	if (!MoveFile(pwszCompacted, m_Settings.pwszDatabase))
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		MoveFile(pwszBackup, m_Settings.pwszDatabase);
+		return hr;
+	}
+
+	DeleteFile(pwszBackup);
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::RecoverSwap()
+//
+// Description: Undo a swap interrupted between its two renames, and remove
+//				files left over by an interrupted compaction.
+//
+////////////////////////////////////////////////////////////////////////////////
+void CompactScheduler::RecoverSwap()
+{
+	WCHAR		wszCompacted[MAX_PATH];
+	WCHAR		wszBackup[MAX_PATH];
+	ULONGLONG	cbSize;
+
+	wsprintf(wszCompacted, L"%s%s", m_Settings.pwszDatabase, COMPACT_TEMP_SUFFIX);
+	wsprintf(wszBackup,	   L"%s%s", m_Settings.pwszDatabase, COMPACT_BACKUP_SUFFIX);
+
+	if (FAILED(GetDatabaseFileSize(m_Settings.pwszDatabase, &cbSize)) &&
+		SUCCEEDED(GetDatabaseFileSize(wszBackup, &cbSize)))
+	{
+		MoveFile(wszBackup, m_Settings.pwszDatabase);
+	}
+	else
+	{
+		DeleteFile(wszBackup);
+	}
+
+	DeleteFile(wszCompacted);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::LoadBaseline()
+//
+// Description: Read the size and row count recorded after the last
+//				compaction.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CompactScheduler::LoadBaseline()
+{
+	HRESULT				hr		= NOERROR;
+	HANDLE				hFile;
+	COMPACT_BASELINE	Baseline;
+	WCHAR				wszFile[MAX_PATH];
+	DWORD				cbRead	= 0;
+
+	wsprintf(wszFile, L"%s%s", m_Settings.pwszDatabase, COMPACT_BASELINE_SUFFIX);
+
+	hFile = CreateFile(wszFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == hFile)
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	if (!ReadFile(hFile, &Baseline, sizeof(Baseline), &cbRead, NULL) ||
+		sizeof(Baseline) != cbRead || COMPACT_BASELINE_SIGNATURE != Baseline.dwSignature)
+	{
+		hr = E_FAIL;
+	}
+	else
+	{
+		m_cbBaseline	= Baseline.cbFile;
+		m_cBaselineRows	= Baseline.cRows;
+	}
+
+	CloseHandle(hFile);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactScheduler::SaveBaseline()
+//
+// Description: Record the current baseline next to the database.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CompactScheduler::SaveBaseline()
+{
+	HRESULT				hr			= NOERROR;
+	HANDLE				hFile;
+	COMPACT_BASELINE	Baseline;
+	WCHAR				wszFile[MAX_PATH];
+	DWORD				cbWritten	= 0;
+
+	wsprintf(wszFile, L"%s%s", m_Settings.pwszDatabase, COMPACT_BASELINE_SUFFIX);
+
+	Baseline.dwSignature = COMPACT_BASELINE_SIGNATURE;
+	Baseline.cRows		 = m_cBaselineRows;
+	Baseline.cbFile		 = m_cbBaseline;
+
+	hFile = CreateFile(wszFile, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == hFile)
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	if (!WriteFile(hFile, &Baseline, sizeof(Baseline), &cbWritten, NULL) || sizeof(Baseline) != cbWritten)
+	{
+		hr = E_FAIL;
+	}
+
+	CloseHandle(hFile);
+
+	return hr;
+}
@@ -0,0 +1,181 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: CompactScheduler
+//
+// File: CompactScheduler.h
+//
+// Comment: Background compaction of the database file during idle periods.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_COMPACTSCHEDULER_H__8A3E5D70_16C9_4B2F_A4D8_93F0C7E21B6A__INCLUDED_)
+#define AFX_COMPACTSCHEDULER_H__8A3E5D70_16C9_4B2F_A4D8_93F0C7E21B6A__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define COMPACT_TEMP_SUFFIX			L".compact"		// Compacted copy before the swap
+#define COMPACT_BACKUP_SUFFIX		L".bak"			// Original file during the swap
+#define COMPACT_BASELINE_SUFFIX		L".cmpstat"		// Size and rows after the last compaction
+
+#define COMPACT_MAX_TABLES			64
+#define COMPACT_LATENCY_SAMPLES		64				// Foreground latencies kept for the percentile
+#define COMPACT_MAX_IDLE_BACKOFF	16				// Idle period grows up to this factor
+
+// Settings of the application scheduler
+//
+#define COMPACT_DEFAULT_FREE_PERCENT	30
+#define COMPACT_DEFAULT_GROWTH_PERCENT	100
+#define COMPACT_DEFAULT_MIN_FILE_SIZE	(256 * 1024)
+#define COMPACT_DEFAULT_CHECK_MS		(5 * 60 * 1000)
+#define COMPACT_DEFAULT_IDLE_MS			(30 * 1000)
+#define COMPACT_DEFAULT_LATENCY_MS		200
+#define COMPACT_DEFAULT_THROTTLE_MS		10
+#define COMPACT_DEFAULT_CHANGELOG_ENTRIES	4096
+
+// Requests passed to the connection callback
+//
+#define COMPACT_RELEASE_CONNECTIONS	1
+#define COMPACT_REOPEN_CONNECTIONS	2
+
+////////////////////////////////////////////////////////////////////////////////
+// Called on the scheduler thread around a compaction. The engine compacts
+// closed files only, so the application releases every connection to the
+// database on COMPACT_RELEASE_CONNECTIONS and opens them again on
+// COMPACT_REOPEN_CONNECTIONS. Returning S_FALSE to the release request
+// postpones the compaction.
+//
+typedef HRESULT (CALLBACK *PFN_COMPACT_CONNECTIONS)(LPVOID pvContext, DWORD dwRequest);
+
+////////////////////////////////////////////////////////////////////////////////
+// Scheduler settings
+//
+typedef struct tagCOMPACT_SETTINGS
+{
+	LPCWSTR						pwszDatabase;
+
+	// A compaction is due when either threshold is reached
+	//
+	DWORD						dwFreePercent;			// Estimated free space in the file
+	DWORD						dwGrowthPercent;		// Growth since the last compaction
+	ULONGLONG					cbMinFileSize;			// Smaller files are never compacted
+
+	DWORD						dwCheckIntervalMs;		// How often the file is measured
+	DWORD						dwIdleMs;				// Quiet period required to compact
+	DWORD						dwLatencyBudgetMs;		// 95th percentile allowed to foreground work
+	DWORD						dwThrottleMs;			// Pause between measurement queries
+
+	ULONG						cChangeLogEntries;		// Change log entries kept, 0 keeps them all
+
+	PFN_COMPACT_CONNECTIONS		pfnConnections;
+	LPVOID						pvContext;
+} COMPACT_SETTINGS;
+
+////////////////////////////////////////////////////////////////////////////////
+// Last measurement of the database file
+//
+typedef struct tagCOMPACT_MEASURE
+{
+	ULONGLONG	cbFile;
+	DWORD		cRows;					// Rows of all tables
+	DWORD		dwFreePercent;			// Estimated from the baseline
+	DWORD		dwGrowthPercent;
+} COMPACT_MEASURE;
+
+////////////////////////////////////////////////////////////////////////////////
+// Scheduler statistics
+//
+typedef struct tagCOMPACT_STATS
+{
+	DWORD			cCompactions;
+	DWORD			cPostponed;				// Due, but not idle or refused by the application
+	DWORD			dwLastCompactMs;		// Connections closed, compaction and swap
+	ULONGLONG		cbLastBefore;
+	ULONGLONG		cbLastAfter;
+	COMPACT_MEASURE	LastMeasure;
+	DWORD			dwLatencyP95Ms;
+	DWORD			dwIdleMs;				// Current quiet period, after backoff
+	ULONG			ulChangeLogCompactedTo;	// Marker of the last change log compaction, 0 if none
+} COMPACT_STATS;
+
+////////////////////////////////////////////////////////////////////////////////
+// Measures the database file on a low priority thread and compacts it into
+// a new file when it is due and the application is idle, then swaps the new
+// file in.
+//
+// The engine has no free page count, so free space is estimated against the
+// file size and row count recorded after the last compaction: a file that
+// grew while the row count did not is mostly free pages.
+//
+// CompactDatabase cannot be paced once started, so the foreground latency
+// budget is kept by choosing when to start: the application reports the
+// latency of its database operations, and when their 95th percentile goes
+// over the budget the required quiet period doubles, up to
+// COMPACT_MAX_IDLE_BACKOFF times the configured one. It halves again while
+// the percentile stays within the budget.
+//
+// Each idle pass, and CompactNow, first drop the change log entries beyond
+// the newest cChangeLogEntries, so that the compaction reclaims their
+// pages.
+//
+class CompactScheduler
+{
+public:
+	CompactScheduler();
+	~CompactScheduler();
+
+	HRESULT Start(const COMPACT_SETTINGS *pSettings);
+	void	Stop();
+
+	void	NoteForegroundActivity(DWORD dwLatencyMs);
+	HRESULT CompactNow();
+	void	GetStats(COMPACT_STATS *pStats);
+
+private:
+	static DWORD WINAPI ThreadProc(LPVOID lpParameter);
+
+	void	Schedule();
+	BOOL	IsIdle();
+	BOOL	IsDue(const COMPACT_MEASURE *pMeasure);
+	void	AdjustIdlePeriod();
+	DWORD	GetLatencyPercentile(DWORD dwPercentile);
+
+	HRESULT TrimChangeLog();
+	HRESULT Measure(COMPACT_MEASURE *pMeasure);
+	HRESULT CountRows(DWORD *pcRows);
+	HRESULT Compact(DWORD cRows);
+	HRESULT SwapFiles(LPCWSTR pwszCompacted, LPCWSTR pwszBackup);
+	void	RecoverSwap();
+
+	HRESULT LoadBaseline();
+	HRESULT SaveBaseline();
+
+	CRITICAL_SECTION	m_cs;					// Guards the statistics and latencies
+	COMPACT_SETTINGS	m_Settings;
+	WCHAR				m_wszDatabase[MAX_PATH];
+	HANDLE				m_hThread;
+	HANDLE				m_hStop;
+
+	ULONGLONG			m_cbBaseline;			// File size after the last compaction
+	DWORD				m_cBaselineRows;		// Rows after the last compaction
+
+	DWORD				m_dwLastActivityMs;
+	DWORD				m_rgdwLatencyMs[COMPACT_LATENCY_SAMPLES];
+	DWORD				m_cLatencies;
+	DWORD				m_iLatency;
+	DWORD				m_cNewLatencies;		// Reported since the last adjustment
+	DWORD				m_dwIdleMs;
+	LONG				m_fCompacting;
+
+	COMPACT_STATS		m_Stats;
+};
+
+extern CompactScheduler	g_CompactScheduler;
+
+#endif // !defined(AFX_COMPACTSCHEDULER_H__8A3E5D70_16C9_4B2F_A4D8_93F0C7E21B6A__INCLUDED_)
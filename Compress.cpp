@@ -0,0 +1,343 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: Compress
+//
+// File: Compress.cpp
+//
+// Comment: Small LZ77 block compressor used by the export file formats.
+//
+// Notes:
+//			A compressed block is a list of sequences. Each sequence starts
+//			with a token byte: the high nibble is the literal count and the
+//			low nibble is the match length minus LZ_MIN_MATCH. A nibble of 15
+//			is followed by extra length bytes (255 means "more follows").
+//			The literals come next, then a 2 byte little-endian match offset
+//			and the extra match length bytes. The last sequence carries
+//			literals only.
+//
+//			Devices may fault on unaligned access, so input words are
+//			always assembled byte by byte.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Compress.h"
+
+#define LZ_MIN_MATCH		4
+#define LZ_MAX_OFFSET		0xFFFF
+#define LZ_HASH_BITS		12
+#define LZ_HASH_SIZE		(1 << LZ_HASH_BITS)
+#define LZ_NO_POSITION		0xFFFFFFFF
+
+#define LZ_READ32(pb)		((DWORD)(pb)[0] | ((DWORD)(pb)[1] << 8) | ((DWORD)(pb)[2] << 16) | ((DWORD)(pb)[3] << 24))
+#define LZ_HASH(dw)			(((dw) * 2654435761U) >> (32 - LZ_HASH_BITS))
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: LzCompressBound
+//
+// Description: Returns the worst case size of a compressed block.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD LzCompressBound(DWORD cbSrc)
+{
+	return cbSrc + cbSrc/255 + 16;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: LzEmitLength
+//
+// Description: Write the extra length bytes for a nibble that overflowed.
+//
+// Returns: FALSE if the output buffer is too small
+//
+////////////////////////////////////////////////////////////////////////////////
+static BOOL LzEmitLength(DWORD dwLength, BYTE *pbDst, DWORD cbDstMax, DWORD *pdwOut)
+{
+	for (dwLength -= 15; ; dwLength -= 255)
+	{
+		if (*pdwOut >= cbDstMax)
+		{
+			return FALSE;
+		}
+
+		if (dwLength < 255)
+		{
+			pbDst[(*pdwOut)++] = (BYTE)dwLength;
+			return TRUE;
+		}
+
+		pbDst[(*pdwOut)++] = 255;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: LzEmitSequence
+//
+// Description: Write one sequence. A dwMatch of zero writes the last,
+//				literal-only sequence.
+//
+// Returns: FALSE if the output buffer is too small
+//
+////////////////////////////////////////////////////////////////////////////////
+static BOOL LzEmitSequence(const BYTE *pbLiterals, DWORD cLiterals, DWORD dwOffset, DWORD dwMatch,
+						   BYTE *pbDst, DWORD cbDstMax, DWORD *pdwOut)
+{
+	DWORD	dwMatchCode = dwMatch ? dwMatch - LZ_MIN_MATCH : 0;
+	BYTE	bToken;
+
+	if (*pdwOut >= cbDstMax)
+	{
+		return FALSE;
+	}
+
+	bToken  = (BYTE)((cLiterals >= 15 ? 15 : cLiterals) << 4);
+	bToken |= (BYTE)(dwMatchCode >= 15 ? 15 : dwMatchCode);
+	pbDst[(*pdwOut)++] = bToken;
+
+	if (cLiterals >= 15 && !LzEmitLength(cLiterals, pbDst, cbDstMax, pdwOut))
+	{
+		return FALSE;
+	}
+
+	if (*pdwOut + cLiterals > cbDstMax)
+	{
+		return FALSE;
+	}
+
+	memcpy(pbDst + *pdwOut, pbLiterals, cLiterals);
+	*pdwOut += cLiterals;
+
+	if (0 == dwMatch)
+	{
+		return TRUE;
+	}
+
+	if (*pdwOut + 2 > cbDstMax)
+	{
+		return FALSE;
+	}
+
+	pbDst[(*pdwOut)++] = (BYTE)(dwOffset & 0xFF);
+	pbDst[(*pdwOut)++] = (BYTE)(dwOffset >> 8);
+
+	if (dwMatchCode >= 15 && !LzEmitLength(dwMatchCode, pbDst, cbDstMax, pdwOut))
+	{
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: LzCompress
+//
+// Description: Compress a block with a single-probe hash table.
+//
+// Parameters
+//		pbSrc		- data to compress
+//		cbSrc		- size of the data
+//		pbDst		- output buffer
+//		cbDstMax	- size of the output buffer
+//		pcbDst		- receives the compressed size
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT LzCompress(const BYTE *pbSrc, DWORD cbSrc, BYTE *pbDst, DWORD cbDstMax, DWORD *pcbDst)
+{
+	HRESULT		hr			= NOERROR;
+	DWORD		*rgdwHash	= NULL;
+	DWORD		dwIn		= 0;
+	DWORD		dwAnchor	= 0;
+	DWORD		dwOut		= 0;
+	DWORD		dwIndex;
+
+	if ((NULL == pbSrc && cbSrc) || NULL == pbDst || NULL == pcbDst)
+	{
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+	// The hash table is allocated on the heap to keep worker stacks small
+	//
+	rgdwHash = (DWORD*)CoTaskMemAlloc(sizeof(DWORD)*LZ_HASH_SIZE);
+	if (NULL == rgdwHash)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	for (dwIndex = 0; dwIndex < LZ_HASH_SIZE; ++dwIndex)
+	{
+		rgdwHash[dwIndex] = LZ_NO_POSITION;
+	}
+
+	while (dwIn + LZ_MIN_MATCH <= cbSrc)
+	{
+		DWORD	dwSequence	= LZ_READ32(pbSrc + dwIn);
+		DWORD	dwHash		= LZ_HASH(dwSequence);
+		DWORD	dwCandidate = rgdwHash[dwHash];
+
+		rgdwHash[dwHash] = dwIn;
+
+		if (LZ_NO_POSITION != dwCandidate &&
+			dwIn - dwCandidate <= LZ_MAX_OFFSET &&
+			LZ_READ32(pbSrc + dwCandidate) == dwSequence)
+		{
+			DWORD dwMatch = LZ_MIN_MATCH;
+
+			// Extend the match as far as it goes
+			//
+			while (dwIn + dwMatch < cbSrc && pbSrc[dwCandidate + dwMatch] == pbSrc[dwIn + dwMatch])
+			{
+				++dwMatch;
+			}
+
+			if (!LzEmitSequence(pbSrc + dwAnchor, dwIn - dwAnchor, dwIn - dwCandidate, dwMatch, pbDst, cbDstMax, &dwOut))
+			{
+				hr = E_FAIL;
+				goto Exit;
+			}
+
+			dwIn	+= dwMatch;
+			dwAnchor = dwIn;
+		}
+		else
+		{
+			++dwIn;
+		}
+	}
+
+	// The remaining bytes go out as the last, literal-only sequence
+	//
+	if (!LzEmitSequence(pbSrc + dwAnchor, cbSrc - dwAnchor, 0, 0, pbDst, cbDstMax, &dwOut))
+	{
+		hr = E_FAIL;
+		goto Exit;
+	}
+
+	*pcbDst = dwOut;
+
+Exit:
+	if (rgdwHash)
+	{
+		CoTaskMemFree(rgdwHash);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: LzReadLength
+//
+// Description: Read the extra length bytes that follow an overflowed nibble.
+//
+// Returns: FALSE if the input is truncated
+//
+////////////////////////////////////////////////////////////////////////////////
+static BOOL LzReadLength(const BYTE *pbSrc, DWORD cbSrc, DWORD *pdwIn, DWORD *pdwLength)
+{
+	BYTE bExtra;
+
+	do
+	{
+		if (*pdwIn >= cbSrc)
+		{
+			return FALSE;
+		}
+
+		bExtra = pbSrc[(*pdwIn)++];
+		*pdwLength += bExtra;
+	}
+	while (255 == bExtra);
+
+	return TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: LzDecompress
+//
+// Description: Decompress a block produced by LzCompress.
+//
+// Parameters
+//		pbSrc		- compressed block
+//		cbSrc		- size of the compressed block
+//		pbDst		- output buffer
+//		cbDst		- expected size of the decompressed data
+//
+// Returns: NOERROR if succesfull, E_FAIL if the block is corrupt
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT LzDecompress(const BYTE *pbSrc, DWORD cbSrc, BYTE *pbDst, DWORD cbDst)
+{
+	DWORD	dwIn	= 0;
+	DWORD	dwOut	= 0;
+
+	if ((NULL == pbSrc && cbSrc) || (NULL == pbDst && cbDst))
+	{
+		return E_INVALIDARG;
+	}
+
+	while (dwIn < cbSrc)
+	{
+		BYTE	bToken		= pbSrc[dwIn++];
+		DWORD	cLiterals	= bToken >> 4;
+		DWORD	dwMatch		= bToken & 0x0F;
+		DWORD	dwOffset;
+
+		if (15 == cLiterals && !LzReadLength(pbSrc, cbSrc, &dwIn, &cLiterals))
+		{
+			return E_FAIL;
+		}
+
+		if (dwIn + cLiterals > cbSrc || dwOut + cLiterals > cbDst)
+		{
+			return E_FAIL;
+		}
+
+		memcpy(pbDst + dwOut, pbSrc + dwIn, cLiterals);
+		dwIn  += cLiterals;
+		dwOut += cLiterals;
+
+		// The last sequence has no match part
+		//
+		if (dwIn == cbSrc)
+		{
+			break;
+		}
+
+		if (dwIn + 2 > cbSrc)
+		{
+			return E_FAIL;
+		}
+
+		dwOffset = pbSrc[dwIn] | ((DWORD)pbSrc[dwIn + 1] << 8);
+		dwIn += 2;
+
+		if (15 == dwMatch && !LzReadLength(pbSrc, cbSrc, &dwIn, &dwMatch))
+		{
+			return E_FAIL;
+		}
+
+		dwMatch += LZ_MIN_MATCH;
+
+		if (0 == dwOffset || dwOffset > dwOut || dwOut + dwMatch > cbDst)
+		{
+			return E_FAIL;
+		}
+
+		// Byte by byte copy, matches may overlap their own output
+		//
+		for (DWORD dwByte = 0; dwByte < dwMatch; ++dwByte, ++dwOut)
+		{
+			pbDst[dwOut] = pbDst[dwOut - dwOffset];
+		}
+	}
+
+	return (dwOut == cbDst) ? NOERROR : E_FAIL;
+}
@@ -0,0 +1,43 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: Compress
+//
+// File: Compress.h
+//
+// Comment: Small LZ77 block compressor used by the export file formats.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_COMPRESS_H__0D4E2A7B_5C61_4F8A_9B3E_71C2D8E6A410__INCLUDED_)
+#define AFX_COMPRESS_H__0D4E2A7B_5C61_4F8A_9B3E_71C2D8E6A410__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+// Compression methods recorded with each stored block
+//
+#define COMPRESSION_NONE		0
+#define COMPRESSION_LZ			1
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns the worst case size of LzCompress output for cbSrc input bytes
+//
+DWORD LzCompressBound(DWORD cbSrc);
+
+////////////////////////////////////////////////////////////////////////////////
+// Compress a block. pbDst must hold at least LzCompressBound(cbSrc) bytes.
+//
+HRESULT LzCompress(const BYTE *pbSrc, DWORD cbSrc, BYTE *pbDst, DWORD cbDstMax, DWORD *pcbDst);
+
+////////////////////////////////////////////////////////////////////////////////
+// Decompress a block produced by LzCompress into exactly cbDst bytes
+//
+HRESULT LzDecompress(const BYTE *pbSrc, DWORD cbSrc, BYTE *pbDst, DWORD cbDst);
+
+#endif // !defined(AFX_COMPRESS_H__0D4E2A7B_5C61_4F8A_9B3E_71C2D8E6A410__INCLUDED_)
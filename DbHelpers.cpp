@@ -0,0 +1,1521 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: DbHelpers
+//
+// File: DbHelpers.cpp
+//
+// Comment: Shared OLE DB helpers used by the data-layer modules.
+//
+// Functions:
+//			1. Create, open and close a database file
+//			2. Open the Employees table through PK_Employees
+//			3. Build accessor bindings from column names
+//			4. Execute SQL statements and scalar queries on a session
+//			5. Copy the rows of a rowset into a table
+//			6. Create a table shaped like a rowset
+//			7. Measure the size of a database file
+//			8. Format employee names for display
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "SchemaCatalog.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: OpenDataSource
+//
+// Description:	Open a connection to a database file
+//
+// Parameters
+//		pwszDatabase		- path of the database file
+//		ppIDBCreateSession	- receives the IDBCreateSession interface
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT OpenDataSource(LPCWSTR pwszDatabase, IDBCreateSession **ppIDBCreateSession)
+{
+    HRESULT			   	hr				= NOERROR;	// Error code reporting
+	DBPROP				dbprop[1];					// property used in property set to initialize provider
+	DBPROP				sscedbprop[1];				// SQL Server Compact specific initialization property
+	DBPROPSET			dbpropset[2];				// Property Set used to initialize provider
+
+    IDBInitialize       *pIDBInitialize = NULL;		// Provider Interface Pointer
+	IDBProperties       *pIDBProperties	= NULL;		// Provider Interface Pointer
+
+	VariantInit(&dbprop[0].vValue);
+	VariantInit(&sscedbprop[0].vValue);
+
+	if (NULL == pwszDatabase || NULL == ppIDBCreateSession)
+	{
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+	*ppIDBCreateSession = NULL;
+
+    // Create an instance of the OLE DB Provider
+	//
+	hr = CoCreateInstance(	CLSID_SQLSERVERCE_3_5,
+							0,
+							CLSCTX_INPROC_SERVER,
+							IID_IDBInitialize,
+							(void**)&pIDBInitialize);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Initialize a property with name of database
+	//
+    dbprop[0].dwPropertyID	= DBPROP_INIT_DATASOURCE;
+	dbprop[0].dwOptions		= DBPROPOPTIONS_REQUIRED;
+    dbprop[0].vValue.vt		= VT_BSTR;
+    dbprop[0].vValue.bstrVal= SysAllocString(pwszDatabase);
+	if(NULL == dbprop[0].vValue.bstrVal)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	// Leave shrinking to the compaction scheduler
+	//
+	sscedbprop[0].dwPropertyID	= DBPROP_SSCE_AUTO_SHRINK_THRESHOLD;
+	sscedbprop[0].dwOptions		= DBPROPOPTIONS_REQUIRED;
+	sscedbprop[0].vValue.vt		= VT_I4;
+	sscedbprop[0].vValue.lVal	= DATABASE_AUTO_SHRINK_THRESHOLD;
+
+	// Initialize the property sets
+	//
+	dbpropset[0].guidPropertySet = DBPROPSET_DBINIT;
+	dbpropset[0].rgProperties	 = dbprop;
+	dbpropset[0].cProperties	 = sizeof(dbprop)/sizeof(dbprop[0]);
+
+	dbpropset[1].guidPropertySet = DBPROPSET_SSCE_DBINIT;
+	dbpropset[1].rgProperties	 = sscedbprop;
+	dbpropset[1].cProperties	 = sizeof(sscedbprop)/sizeof(sscedbprop[0]);
+
+	//Set initialization properties.
+	//
+	hr = pIDBInitialize->QueryInterface(IID_IDBProperties, (void **)&pIDBProperties);
+    if(FAILED(hr))
+    {
+		goto Exit;
+    }
+
+    hr = pIDBProperties->SetProperties(sizeof(dbpropset)/sizeof(dbpropset[0]), dbpropset);
+	if(FAILED(hr))
+    {
+		goto Exit;
+    }
+
+	// Initializes a data source object
+	//
+	hr = pIDBInitialize->Initialize();
+	if(FAILED(hr))
+    {
+		goto Exit;
+    }
+
+    // Get IDBCreateSession interface
+    //
+  	hr = pIDBInitialize->QueryInterface(IID_IDBCreateSession, (void**)ppIDBCreateSession);
+
+Exit:
+    // Clear Variant
+    //
+	VariantClear(&dbprop[0].vValue);
+	VariantClear(&sscedbprop[0].vValue);
+
+	// Release interfaces
+	//
+	if(pIDBProperties)
+	{
+		pIDBProperties->Release();
+	}
+
+    if (pIDBInitialize)
+    {
+        pIDBInitialize->Release();
+    }
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ReleaseDataSource
+//
+// Description:	Close a connection opened by OpenDataSource, so that the
+//				database file can be moved or deleted.
+//
+// Parameters
+//		ppIDBCreateSession	- the connection, set to NULL
+//
+////////////////////////////////////////////////////////////////////////////////
+void ReleaseDataSource(IDBCreateSession **ppIDBCreateSession)
+{
+	IDBInitialize *pIDBInitialize = NULL;		// Provider Interface Pointer
+
+	if (NULL == ppIDBCreateSession || NULL == *ppIDBCreateSession)
+	{
+		return;
+	}
+
+	if (SUCCEEDED((*ppIDBCreateSession)->QueryInterface(IID_IDBInitialize, (void**)&pIDBInitialize)))
+	{
+		pIDBInitialize->Uninitialize();
+		pIDBInitialize->Release();
+	}
+
+	(*ppIDBCreateSession)->Release();
+	*ppIDBCreateSession = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CreateDataSource
+//
+// Description:	Create a new, empty database file and open a connection to it
+//
+// Parameters
+//		pwszDatabase		- path of the database file, must not exist
+//		ppIDBCreateSession	- receives the IDBCreateSession interface
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CreateDataSource(LPCWSTR pwszDatabase, IDBCreateSession **ppIDBCreateSession)
+{
+	HRESULT				hr					 = NOERROR;	// Error code reporting
+	DBPROP				dbprop[1];						// property used in property set to initialize provider
+	DBPROP				sscedbprop[1];					// SQL Server Compact specific initialization property
+	DBPROPSET			dbpropset[2];					// Property Set used to initialize provider
+
+	IDBInitialize	    *pIDBInitialize      = NULL;    // Provider Interface Pointer
+	IDBDataSourceAdmin	*pIDBDataSourceAdmin = NULL;	// Provider Interface Pointer
+	IUnknown			*pIUnknownSession	 = NULL;	// Provider Interface Pointer
+
+	VariantInit(&dbprop[0].vValue);
+	VariantInit(&sscedbprop[0].vValue);
+
+	if (NULL == pwszDatabase || NULL == ppIDBCreateSession)
+	{
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+	*ppIDBCreateSession = NULL;
+
+   	// Create an instance of the OLE DB Provider
+	//
+	hr = CoCreateInstance(	CLSID_SQLSERVERCE_3_5,
+							0,
+							CLSCTX_INPROC_SERVER,
+							IID_IDBInitialize,
+							(void**)&pIDBInitialize);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	dbprop[0].dwPropertyID		= DBPROP_INIT_DATASOURCE;
+	dbprop[0].dwOptions			= DBPROPOPTIONS_REQUIRED;
+	dbprop[0].vValue.vt			= VT_BSTR;
+	dbprop[0].vValue.bstrVal	= SysAllocString(pwszDatabase);
+	if(NULL == dbprop[0].vValue.bstrVal)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	sscedbprop[0].dwPropertyID	= DBPROP_SSCE_AUTO_SHRINK_THRESHOLD;
+	sscedbprop[0].dwOptions		= DBPROPOPTIONS_REQUIRED;
+	sscedbprop[0].vValue.vt		= VT_I4;
+	sscedbprop[0].vValue.lVal	= DATABASE_AUTO_SHRINK_THRESHOLD;
+
+	dbpropset[0].guidPropertySet = DBPROPSET_DBINIT;
+	dbpropset[0].rgProperties	 = dbprop;
+	dbpropset[0].cProperties	 = sizeof(dbprop)/sizeof(dbprop[0]);
+
+	dbpropset[1].guidPropertySet = DBPROPSET_SSCE_DBINIT;
+	dbpropset[1].rgProperties	 = sscedbprop;
+	dbpropset[1].cProperties	 = sizeof(sscedbprop)/sizeof(sscedbprop[0]);
+
+	hr = pIDBInitialize->QueryInterface(IID_IDBDataSourceAdmin, (void **) &pIDBDataSourceAdmin);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Create and initialize data store
+	//
+	hr = pIDBDataSourceAdmin->CreateDataSource(sizeof(dbpropset)/sizeof(dbpropset[0]), dbpropset, NULL, IID_IUnknown, &pIUnknownSession);
+	if(FAILED(hr))
+    {
+		goto Exit;
+    }
+
+  	hr = pIDBInitialize->QueryInterface(IID_IDBCreateSession, (void**)ppIDBCreateSession);
+
+Exit:
+	VariantClear(&dbprop[0].vValue);
+	VariantClear(&sscedbprop[0].vValue);
+
+	if(pIUnknownSession)
+	{
+		pIUnknownSession->Release();
+	}
+
+	if(pIDBDataSourceAdmin)
+	{
+		pIDBDataSourceAdmin->Release();
+	}
+
+	if(pIDBInitialize)
+	{
+		pIDBInitialize->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: OpenTableRowset
+//
+// Description:	Open a table through one of its indexes
+//
+// Parameters
+//		pIOpenRowset	- session used to open the rowset
+//		pwszTable		- table name
+//		pwszIndex		- index name, or NULL to open the base table
+//		dwOptions		- ROWSET_OPT_* flags for the requested interfaces
+//		riid			- interface to return
+//		ppRowset		- receives the rowset
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT OpenTableRowset(IOpenRowset *pIOpenRowset, LPCWSTR pwszTable, LPCWSTR pwszIndex, DWORD dwOptions, REFIID riid, IUnknown **ppRowset)
+{
+	HRESULT				hr					= NOERROR;	// Error code reporting
+	DBID				TableID;						// Used to open table
+	DBID				IndexID;						// Used to open index
+	DBPROPSET			rowsetpropset[1];				// Used when opening integrated index
+	DBPROP				rowsetprop[2];					// Used when opening integrated index
+	ULONG				cProperties			= 0;
+
+	VariantInit(&rowsetprop[0].vValue);
+	VariantInit(&rowsetprop[1].vValue);
+
+	if (NULL == pIOpenRowset || NULL == pwszTable || NULL == ppRowset)
+	{
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+	// Set up information necessary to open a table
+	// using an index and have the ability to seek.
+	//
+	TableID.eKind			= DBKIND_NAME;
+	TableID.uName.pwszName	= (WCHAR*)pwszTable;
+
+	IndexID.eKind			= DBKIND_NAME;
+	IndexID.uName.pwszName	= (WCHAR*)pwszIndex;
+
+	if (dwOptions & ROWSET_OPT_CHANGE)
+	{
+		rowsetprop[cProperties].dwPropertyID	= DBPROP_IRowsetChange;
+		rowsetprop[cProperties].dwOptions		= DBPROPOPTIONS_REQUIRED;
+		rowsetprop[cProperties].colid			= DB_NULLID;
+		rowsetprop[cProperties].vValue.vt		= VT_BOOL;
+		rowsetprop[cProperties].vValue.boolVal	= VARIANT_TRUE;
+		++cProperties;
+	}
+
+	if (dwOptions & ROWSET_OPT_INDEX)
+	{
+		rowsetprop[cProperties].dwPropertyID	= DBPROP_IRowsetIndex;
+		rowsetprop[cProperties].dwOptions		= DBPROPOPTIONS_REQUIRED;
+		rowsetprop[cProperties].colid			= DB_NULLID;
+		rowsetprop[cProperties].vValue.vt		= VT_BOOL;
+		rowsetprop[cProperties].vValue.boolVal	= VARIANT_TRUE;
+		++cProperties;
+	}
+
+	rowsetpropset[0].cProperties	= cProperties;
+	rowsetpropset[0].guidPropertySet= DBPROPSET_ROWSET;
+	rowsetpropset[0].rgProperties	= rowsetprop;
+
+	// Open the table, using the index if one was given
+	//
+	hr = pIOpenRowset->OpenRowset(	NULL,
+									&TableID,
+									pwszIndex ? &IndexID : NULL,
+									riid,
+									cProperties ? 1 : 0,
+									cProperties ? rowsetpropset : NULL,
+									ppRowset);
+
+Exit:
+    // Clear Variants
+    //
+	VariantClear(&rowsetprop[0].vValue);
+	VariantClear(&rowsetprop[1].vValue);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: OpenEmployeesRowset
+//
+// Description:	Open the Employees table through the PK_Employees index
+//
+// Parameters
+//		pIOpenRowset	- session used to open the rowset
+//		dwOptions		- ROWSET_OPT_* flags for the requested interfaces
+//		riid			- interface to return
+//		ppRowset		- receives the rowset
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT OpenEmployeesRowset(IOpenRowset *pIOpenRowset, DWORD dwOptions, REFIID riid, IUnknown **ppRowset)
+{
+	return OpenTableRowset(pIOpenRowset, TABLE_EMPLOYEE, L"PK_Employees", dwOptions, riid, ppRowset);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ExecuteCommand
+//
+// Description:	Execute a non row returning SQL statement on a session
+//
+// Parameters
+//		pISession	- any interface on the session object
+//		pwszQuery	- the SQL statement to execute
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ExecuteCommand(IUnknown *pISession, LPCWSTR pwszQuery)
+{
+	HRESULT				hr			= NOERROR;		// Error code reporting
+	IDBCreateCommand	*pIDBCrtCmd	= NULL;			// Provider Interface Pointer
+	ICommandText		*pICmdText	= NULL;			// Provider Interface Pointer
+
+	if (NULL == pISession || NULL == pwszQuery)
+	{
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+	hr = pISession->QueryInterface(IID_IDBCreateCommand, (void**)&pIDBCrtCmd);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIDBCrtCmd->CreateCommand(NULL, IID_ICommandText, (IUnknown**)&pICmdText);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pICmdText->SetCommandText(DBGUID_SQL, pwszQuery);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pICmdText->Execute(NULL, IID_NULL, NULL, NULL, NULL);
+
+	// Cached column metadata is stale once the schema changed
+	//
+	if (SUCCEEDED(hr) && IsSchemaStatement(pwszQuery))
+	{
+		g_SchemaCatalog.Invalidate();
+	}
+
+Exit:
+	if (pICmdText)
+	{
+		pICmdText->Release();
+	}
+
+	if (pIDBCrtCmd)
+	{
+		pIDBCrtCmd->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ExecuteQuery
+//
+// Description:	Execute a row returning SQL statement on a session
+//
+// Parameters
+//		pISession	- any interface on the session object
+//		pwszQuery	- the SQL query to execute
+//		ppIRowset	- receives the forward-only rowset of the query
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ExecuteQuery(IUnknown *pISession, LPCWSTR pwszQuery, IRowset **ppIRowset)
+{
+	HRESULT				hr			= NOERROR;		// Error code reporting
+	IDBCreateCommand	*pIDBCrtCmd	= NULL;			// Provider Interface Pointer
+	ICommandText		*pICmdText	= NULL;			// Provider Interface Pointer
+
+	if (NULL == pISession || NULL == pwszQuery || NULL == ppIRowset)
+	{
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+	*ppIRowset = NULL;
+
+	hr = pISession->QueryInterface(IID_IDBCreateCommand, (void**)&pIDBCrtCmd);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIDBCrtCmd->CreateCommand(NULL, IID_ICommandText, (IUnknown**)&pICmdText);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pICmdText->SetCommandText(DBGUID_SQL, pwszQuery);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pICmdText->Execute(NULL, IID_IRowset, NULL, NULL, (IUnknown**)ppIRowset);
+
+Exit:
+	if (pICmdText)
+	{
+		pICmdText->Release();
+	}
+
+	if (pIDBCrtCmd)
+	{
+		pIDBCrtCmd->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ExecuteScalar
+//
+// Description:	Execute a query and return the first column of its first row
+//				as an integer, e.g. SELECT MAX(...) or SELECT COUNT(*).
+//
+// Parameters
+//		pISession	- any interface on the session object
+//		pwszQuery	- the SQL query to execute
+//		plValue		- receives the value
+//		pfNull		- receives TRUE if there was no row or the value is NULL
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ExecuteScalar(IUnknown *pISession, LPCWSTR pwszQuery, LONG *plValue, BOOL *pfNull)
+{
+	HRESULT				hr				= NOERROR;				// Error code reporting
+	DBBINDING			Binding;								// Binding of the first column
+	HROW				rghRows[1]		= {DB_NULL_HROW};		// Row handle
+	HROW				*prghRows		= rghRows;				// Row handle(s) pointer
+	ULONG				cRowsObtained	= 0;					// Number of rows obtained
+	BYTE				rgbData[sizeof(ULONG) + sizeof(DBSTATUS) + sizeof(LONG)];
+
+	IRowset				*pIRowset		= NULL;					// Provider Interface Pointer
+	IAccessor			*pIAccessor		= NULL;					// Provider Interface Pointer
+	HACCESSOR			hAccessor		= DB_NULL_HACCESSOR;	// Accessor handle
+
+	if (NULL == plValue || NULL == pfNull)
+	{
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+	*plValue = 0;
+	*pfNull	 = TRUE;
+
+	hr = ExecuteQuery(pISession, pwszQuery, &pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Bind the first column as a 4 byte integer, the provider converts it
+	//
+	memset(&Binding, 0, sizeof(Binding));
+	Binding.iOrdinal	= 1;
+	Binding.dwPart		= DBPART_VALUE | DBPART_STATUS | DBPART_LENGTH;
+	Binding.obLength	= 0;
+	Binding.obStatus	= sizeof(ULONG);
+	Binding.obValue		= sizeof(ULONG) + sizeof(DBSTATUS);
+	Binding.dwMemOwner	= DBMEMOWNER_CLIENTOWNED;
+	Binding.wType		= DBTYPE_I4;
+	Binding.cbMaxLen	= sizeof(LONG);
+
+	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, 1, &Binding, 0, &hAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, 1, &cRowsObtained, &prghRows);
+	if(FAILED(hr) || 0 == cRowsObtained)
+	{
+		hr = FAILED(hr) ? hr : NOERROR;
+		goto Exit;
+	}
+
+	memset(rgbData, 0, sizeof(rgbData));
+
+	hr = pIRowset->GetData(rghRows[0], hAccessor, rgbData);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	if (DBSTATUS_S_OK == *(DBSTATUS*)(rgbData + Binding.obStatus))
+	{
+		memcpy(plValue, rgbData + Binding.obValue, sizeof(LONG));
+		*pfNull = FALSE;
+	}
+
+Exit:
+	if (pIRowset && DB_NULL_HROW != rghRows[0])
+	{
+		pIRowset->ReleaseRows(1, rghRows, NULL, NULL, NULL);
+	}
+
+	if (pIAccessor)
+	{
+		pIAccessor->ReleaseAccessor(hAccessor, NULL);
+		pIAccessor->Release();
+	}
+
+	if (pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FindColumn
+//
+// Description: Returns the index into the column info array for a column name.
+//
+// Returns: TRUE if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static BOOL FindColumn(DBCOLUMNINFO* pDBColumnInfo, ULONG ulNumCols, WCHAR* pwszColName, ULONG* pulIndex)
+{
+	for(ULONG ulCol = 0; ulCol < ulNumCols; ++ulCol)
+	{
+		if(NULL != pDBColumnInfo[ulCol].pwszName)
+		{
+			if(0 == _wcsicmp(pDBColumnInfo[ulCol].pwszName, pwszColName))
+			{
+				*pulIndex = ulCol;
+				return TRUE;
+			}
+		}
+	}
+
+	return FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CreateColumnBindings
+//
+// Description: Build a DBBINDING array for the named columns of a rowset.
+//				The layout of the data buffer is the same one used by the
+//				Employees class: length, status and value for each column,
+//				aligned on COLUMN_ALIGNVAL.
+//
+// Parameters
+//		pIRowset		- rowset whose columns are bound
+//		rgpwszColumns	- column names, or NULL to bind all columns
+//		cColumns		- number of names in rgpwszColumns
+//		pBlobObject		- DBOBJECT used for BLOB columns, may be NULL
+//		pprgBinding		- receives the binding array
+//		pcBindings		- receives the number of bindings
+//		pcbRowSize		- receives the size of the data buffer
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CreateColumnBindings(IRowset		*pIRowset,
+							 WCHAR			**rgpwszColumns,
+							 DWORD			cColumns,
+							 DBOBJECT		*pBlobObject,
+							 DBBINDING		**pprgBinding,
+							 DWORD			*pcBindings,
+							 DWORD			*pcbRowSize)
+{
+	HRESULT				hr					= NOERROR;			// Error code reporting
+	DBBINDING			*prgBinding			= NULL;				// Binding used to create accessor
+	DBCOLUMNINFO		*pDBColumnInfo		= NULL;				// Record column metadata
+	WCHAR				*pStringsBuffer		= NULL;
+	DWORD				dwBindingSize		= 0;
+	DWORD				dwIndex				= 0;
+	DWORD				dwOffset			= 0;
+	ULONG				ulCol				= 0;
+	ULONG				ulNumCols			= 0;
+
+	IColumnsInfo		*pIColumnsInfo		= NULL;				// Provider Interface Pointer
+
+	if (NULL == pIRowset || NULL == pprgBinding || NULL == pcBindings || NULL == pcbRowSize)
+	{
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+	*pprgBinding = NULL;
+	*pcBindings  = 0;
+	*pcbRowSize  = 0;
+
+    // Get IColumnsInfo interface
+	//
+    hr = pIRowset->QueryInterface(IID_IColumnsInfo, (void **)&pIColumnsInfo);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Get the column metadata
+	//
+    hr = pIColumnsInfo->GetColumnInfo(&ulNumCols, &pDBColumnInfo, &pStringsBuffer);
+	if(FAILED(hr) || 0 == ulNumCols)
+	{
+		hr = FAILED(hr) ? hr : E_FAIL;
+		goto Exit;
+	}
+
+    // Create a DBBINDING array large enough for either request.
+	//
+	dwBindingSize = rgpwszColumns ? cColumns : ulNumCols;
+	prgBinding = (DBBINDING*)CoTaskMemAlloc(sizeof(DBBINDING)*dwBindingSize);
+	if (NULL == prgBinding)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	dwOffset = 0;
+	dwIndex  = 0;
+
+	for (DWORD dwCol = 0; dwCol < dwBindingSize; ++dwCol)
+	{
+		if (rgpwszColumns)
+		{
+			if (!FindColumn(pDBColumnInfo, ulNumCols, rgpwszColumns[dwCol], &ulCol))
+			{
+				hr = E_FAIL;
+				goto Exit;
+			}
+
+			if (DBTYPE_BYTES == pDBColumnInfo[ulCol].wType && NULL == pBlobObject)
+			{
+				hr = E_INVALIDARG;
+				goto Exit;
+			}
+		}
+		else
+		{
+			// The binding doesn't include the bookmark column.
+			//
+			ulCol = dwCol;
+			if (0 == pDBColumnInfo[ulCol].iOrdinal)
+			{
+				continue;
+			}
+
+			if (DBTYPE_BYTES == pDBColumnInfo[ulCol].wType && NULL == pBlobObject)
+			{
+				continue;
+			}
+		}
+
+		prgBinding[dwIndex].iOrdinal	= pDBColumnInfo[ulCol].iOrdinal;
+		prgBinding[dwIndex].pTypeInfo	= NULL;
+		prgBinding[dwIndex].pBindExt	= NULL;
+		prgBinding[dwIndex].dwMemOwner	= DBMEMOWNER_CLIENTOWNED;
+		prgBinding[dwIndex].dwFlags		= 0;
+		prgBinding[dwIndex].bPrecision	= pDBColumnInfo[ulCol].bPrecision;
+		prgBinding[dwIndex].bScale		= pDBColumnInfo[ulCol].bScale;
+		prgBinding[dwIndex].dwPart		= DBPART_VALUE | DBPART_STATUS | DBPART_LENGTH;
+		prgBinding[dwIndex].obLength	= dwOffset;
+		prgBinding[dwIndex].obStatus	= prgBinding[dwIndex].obLength + sizeof(ULONG);
+		prgBinding[dwIndex].obValue		= prgBinding[dwIndex].obStatus + sizeof(DBSTATUS);
+
+		switch(pDBColumnInfo[ulCol].wType)
+		{
+		case DBTYPE_BYTES:
+			prgBinding[dwIndex].pObject		= pBlobObject;
+			prgBinding[dwIndex].cbMaxLen	= sizeof(IUnknown*);
+			prgBinding[dwIndex].wType		= DBTYPE_IUNKNOWN;
+			break;
+
+		case DBTYPE_WSTR:
+			prgBinding[dwIndex].pObject		= NULL;
+			prgBinding[dwIndex].wType		= pDBColumnInfo[ulCol].wType;
+			prgBinding[dwIndex].cbMaxLen	= sizeof(WCHAR)*(pDBColumnInfo[ulCol].ulColumnSize + 1);	// Extra buffer for null terminator
+			break;
+
+		default:
+			prgBinding[dwIndex].pObject		= NULL;
+			prgBinding[dwIndex].wType		= pDBColumnInfo[ulCol].wType;
+			prgBinding[dwIndex].cbMaxLen	= pDBColumnInfo[ulCol].ulColumnSize;
+			break;
+		}
+
+		// Calculate the offset, and properly align it
+		//
+		dwOffset = prgBinding[dwIndex].obValue + prgBinding[dwIndex].cbMaxLen;
+		dwOffset = ROUND_UP(dwOffset, COLUMN_ALIGNVAL);
+
+		++dwIndex;
+	}
+
+	*pprgBinding = prgBinding;
+	*pcBindings  = dwIndex;
+	*pcbRowSize  = dwOffset;
+	prgBinding	 = NULL;
+
+Exit:
+    // Free allocated memory
+    //
+    if (prgBinding)
+    {
+        CoTaskMemFree(prgBinding);
+    }
+
+    if (pDBColumnInfo)
+    {
+        CoTaskMemFree(pDBColumnInfo);
+    }
+
+    if (pStringsBuffer)
+    {
+        CoTaskMemFree(pStringsBuffer);
+    }
+
+	if (pIColumnsInfo)
+	{
+		pIColumnsInfo->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FreeColumnBindings
+//
+// Description: Free the DBBINDING array returned by CreateColumnBindings
+//
+////////////////////////////////////////////////////////////////////////////////
+void FreeColumnBindings(DBBINDING *prgBinding)
+{
+	if (prgBinding)
+	{
+		CoTaskMemFree(prgBinding);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetThroughputMBps100
+//
+// Description: Returns the throughput in hundredths of MB/s, so that callers
+//				can print it without floating point support.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD GetThroughputMBps100(ULONGLONG cbBytes, DWORD dwElapsedMs)
+{
+	if (0 == dwElapsedMs)
+	{
+		dwElapsedMs = 1;
+	}
+
+	// bytes * 100 * 1000 / (ms * 1024 * 1024)
+	//
+	return (DWORD)((cbBytes * 100000) / ((ULONGLONG)dwElapsedMs * 1024 * 1024));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CopyBlob
+//
+// Description: Copy a BLOB between two storage objects.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT CopyBlob(ISequentialStream *pISrc, ISequentialStream *pIDst, BYTE *pbBuffer, ULONGLONG *pcbCopied)
+{
+	HRESULT	hr;
+	ULONG	cbRead;
+	ULONG	cbWritten;
+
+	for (;;)
+	{
+		hr = pISrc->Read(pbBuffer, BLOB_COPY_BUFFER_SIZE, &cbRead);
+		if (FAILED(hr) || 0 == cbRead)
+		{
+			break;
+		}
+
+		hr = pIDst->Write(pbBuffer, cbRead, &cbWritten);
+		if (FAILED(hr) || cbWritten != cbRead)
+		{
+			hr = FAILED(hr) ? hr : E_FAIL;
+			break;
+		}
+
+		*pcbCopied += cbRead;
+	}
+
+	return FAILED(hr) ? hr : NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CopyRowset
+//
+// Description: Insert every remaining row of a rowset into a table with the
+//				same column names, including one BLOB column. The caller
+//				owns the transaction on the destination session.
+//
+// Parameters
+//		pISrcRowset		- rows to copy, read from the current position
+//		pIDstSession	- session of the destination database
+//		pwszDstTable	- destination table
+//		pcRows			- receives the number of rows copied
+//		pcbBytes		- receives the number of data bytes copied
+//
+// Returns: NOERROR if succesfull
+//
+// Notes:
+//			Rows are copied one at a time because the provider allows one
+//			open storage object per rowset.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CopyRowset(IRowset		*pISrcRowset,
+				   IOpenRowset	*pIDstSession,
+				   LPCWSTR		pwszDstTable,
+				   DWORD		*pcRows,
+				   ULONGLONG	*pcbBytes)
+{
+	HRESULT				hr					= NOERROR;				// Error code reporting
+	DBCOLUMNINFO		*pDBColumnInfo		= NULL;					// Source column metadata
+	WCHAR				*pStringsBuffer		= NULL;
+	WCHAR				**rgpwszColumns		= NULL;					// Names of the copied columns
+	DBOBJECT			dbReadObject;								// Source BLOB storage
+	DBOBJECT			dbWriteObject;								// Destination BLOB storage
+	DBBINDING			*prgSrcBinding		= NULL;
+	DBBINDING			*prgDstBinding		= NULL;
+	DWORD				cSrcBindings		= 0;
+	DWORD				cDstBindings		= 0;
+	DWORD				cbSrcRow			= 0;
+	DWORD				cbDstRow			= 0;
+	DWORD				cColumns			= 0;
+	DWORD				cBlobs				= 0;
+	DWORD				dwCol;
+	ULONG				ulNumCols			= 0;
+	BYTE				*pSrcData			= NULL;
+	BYTE				*pDstData			= NULL;
+	BYTE				*pbCopy				= NULL;
+	HROW				rghSrcRows[1]		= {DB_NULL_HROW};
+	HROW				*prghSrcRows		= rghSrcRows;
+	HROW				rghDstRows[1]		= {DB_NULL_HROW};
+	ULONG				cRowsObtained		= 0;
+
+	IColumnsInfo		*pIColumnsInfo		= NULL;					// Provider Interface Pointer
+	IAccessor			*pISrcAccessor		= NULL;					// Provider Interface Pointer
+	IAccessor			*pIDstAccessor		= NULL;					// Provider Interface Pointer
+	IRowset				*pIDstRowset		= NULL;					// Provider Interface Pointer
+	IRowsetChange		*pIDstRowsetChange	= NULL;					// Provider Interface Pointer
+	ISequentialStream	*pISrcStream		= NULL;					// Provider Interface Pointer
+	ISequentialStream	*pIDstStream		= NULL;					// Provider Interface Pointer
+	HACCESSOR			hSrcAccessor		= DB_NULL_HACCESSOR;	// Accessor handle
+	HACCESSOR			hDstAccessor		= DB_NULL_HACCESSOR;	// Accessor handle
+
+	if (NULL == pISrcRowset || NULL == pIDstSession || NULL == pwszDstTable || NULL == pcRows || NULL == pcbBytes)
+	{
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+	*pcRows	  = 0;
+	*pcbBytes = 0;
+
+	// Collect the source column names, the bookmark excluded
+	//
+	hr = pISrcRowset->QueryInterface(IID_IColumnsInfo, (void**)&pIColumnsInfo);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIColumnsInfo->GetColumnInfo(&ulNumCols, &pDBColumnInfo, &pStringsBuffer);
+	if(FAILED(hr) || 0 == ulNumCols)
+	{
+		hr = FAILED(hr) ? hr : E_FAIL;
+		goto Exit;
+	}
+
+	rgpwszColumns = (WCHAR**)CoTaskMemAlloc(sizeof(WCHAR*)*ulNumCols);
+	if (NULL == rgpwszColumns)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	for (dwCol = 0; dwCol < ulNumCols; ++dwCol)
+	{
+		if (0 != pDBColumnInfo[dwCol].iOrdinal && NULL != pDBColumnInfo[dwCol].pwszName)
+		{
+			rgpwszColumns[cColumns++] = pDBColumnInfo[dwCol].pwszName;
+		}
+	}
+
+	// Bind both sides by name, so the column order may differ
+	//
+	dbReadObject.dwFlags	= STGM_READ;
+	dbReadObject.iid		= IID_ISequentialStream;
+	dbWriteObject.dwFlags	= STGM_WRITE;
+	dbWriteObject.iid		= IID_ISequentialStream;
+
+	hr = CreateColumnBindings(pISrcRowset, rgpwszColumns, cColumns, &dbReadObject, &prgSrcBinding, &cSrcBindings, &cbSrcRow);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = OpenTableRowset(pIDstSession, pwszDstTable, NULL, ROWSET_OPT_CHANGE, IID_IRowset, (IUnknown**)&pIDstRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIDstRowset->QueryInterface(IID_IRowsetChange, (void**)&pIDstRowsetChange);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = CreateColumnBindings(pIDstRowset, rgpwszColumns, cColumns, &dbWriteObject, &prgDstBinding, &cDstBindings, &cbDstRow);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// The types must match, and one BLOB column at most is supported
+	//
+	for (dwCol = 0; dwCol < cColumns; ++dwCol)
+	{
+		if (prgSrcBinding[dwCol].wType != prgDstBinding[dwCol].wType)
+		{
+			hr = E_FAIL;
+			goto Exit;
+		}
+
+		if (DBTYPE_IUNKNOWN == prgSrcBinding[dwCol].wType && ++cBlobs > 1)
+		{
+			hr = E_NOTIMPL;
+			goto Exit;
+		}
+	}
+
+	hr = pISrcRowset->QueryInterface(IID_IAccessor, (void**)&pISrcAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pISrcAccessor->CreateAccessor(DBACCESSOR_ROWDATA, cSrcBindings, prgSrcBinding, 0, &hSrcAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIDstRowset->QueryInterface(IID_IAccessor, (void**)&pIDstAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIDstAccessor->CreateAccessor(DBACCESSOR_ROWDATA, cDstBindings, prgDstBinding, 0, &hDstAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	pSrcData = (BYTE*)CoTaskMemAlloc(cbSrcRow);
+	pDstData = (BYTE*)CoTaskMemAlloc(cbDstRow);
+	pbCopy	 = (BYTE*)CoTaskMemAlloc(BLOB_COPY_BUFFER_SIZE);
+	if (NULL == pSrcData || NULL == pDstData || NULL == pbCopy)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	for (;;)
+	{
+		hr = pISrcRowset->GetNextRows(DB_NULL_HCHAPTER, 0, 1, &cRowsObtained, &prghSrcRows);
+		if (FAILED(hr) || 0 == cRowsObtained)
+		{
+			hr = FAILED(hr) ? hr : NOERROR;
+			break;
+		}
+
+		memset(pSrcData, 0, cbSrcRow);
+		memset(pDstData, 0, cbDstRow);
+
+		hr = pISrcRowset->GetData(rghSrcRows[0], hSrcAccessor, pSrcData);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		// Copy the scalar values, BLOBs are inserted empty and written below
+		//
+		for (dwCol = 0; dwCol < cColumns; ++dwCol)
+		{
+			DBBINDING	*pSrc	= &prgSrcBinding[dwCol];
+			DBBINDING	*pDst	= &prgDstBinding[dwCol];
+			DBSTATUS	dwStatus= *(DBSTATUS*)(pSrcData + pSrc->obStatus);
+			ULONG		cbValue	= *(ULONG*)(pSrcData + pSrc->obLength);
+
+			if (DBTYPE_IUNKNOWN == pSrc->wType)
+			{
+				if (DBSTATUS_S_OK == dwStatus)
+				{
+					pISrcStream = *(ISequentialStream**)(pSrcData + pSrc->obValue);
+				}
+				else
+				{
+					*(DBSTATUS*)(pDstData + pDst->obStatus) = DBSTATUS_S_ISNULL;
+				}
+				continue;
+			}
+
+			if (cbValue > pDst->cbMaxLen)
+			{
+				cbValue = pDst->cbMaxLen;
+			}
+
+			*(DBSTATUS*)(pDstData + pDst->obStatus) = dwStatus;
+			*(ULONG*)(pDstData + pDst->obLength)	= cbValue;
+
+			if (DBSTATUS_S_OK == dwStatus)
+			{
+				memcpy(pDstData + pDst->obValue, pSrcData + pSrc->obValue, (DBTYPE_WSTR == pSrc->wType) ? cbValue : pDst->cbMaxLen);
+				*pcbBytes += cbValue;
+			}
+		}
+
+		hr = pIDstRowsetChange->InsertRow(DB_NULL_HCHAPTER, hDstAccessor, pDstData, pISrcStream ? rghDstRows : NULL);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		// Write the BLOB through the stream of the inserted row
+		//
+		if (pISrcStream)
+		{
+			hr = pIDstRowset->GetData(rghDstRows[0], hDstAccessor, pDstData);
+			if(FAILED(hr))
+			{
+				goto Exit;
+			}
+
+			for (dwCol = 0; dwCol < cColumns; ++dwCol)
+			{
+				if (DBTYPE_IUNKNOWN == prgDstBinding[dwCol].wType &&
+					DBSTATUS_S_OK == *(DBSTATUS*)(pDstData + prgDstBinding[dwCol].obStatus))
+				{
+					pIDstStream = *(ISequentialStream**)(pDstData + prgDstBinding[dwCol].obValue);
+					break;
+				}
+			}
+
+			if (pIDstStream)
+			{
+				hr = CopyBlob(pISrcStream, pIDstStream, pbCopy, pcbBytes);
+				pIDstStream->Release();
+				pIDstStream = NULL;
+				if(FAILED(hr))
+				{
+					goto Exit;
+				}
+			}
+
+			pISrcStream->Release();
+			pISrcStream = NULL;
+
+			pIDstRowset->ReleaseRows(1, rghDstRows, NULL, NULL, NULL);
+			rghDstRows[0] = DB_NULL_HROW;
+		}
+
+		pISrcRowset->ReleaseRows(1, rghSrcRows, NULL, NULL, NULL);
+		rghSrcRows[0] = DB_NULL_HROW;
+
+		++(*pcRows);
+	}
+
+Exit:
+	if (pISrcStream)
+	{
+		pISrcStream->Release();
+	}
+
+	if (pIDstStream)
+	{
+		pIDstStream->Release();
+	}
+
+	if (DB_NULL_HROW != rghDstRows[0])
+	{
+		pIDstRowset->ReleaseRows(1, rghDstRows, NULL, NULL, NULL);
+	}
+
+	if (DB_NULL_HROW != rghSrcRows[0])
+	{
+		pISrcRowset->ReleaseRows(1, rghSrcRows, NULL, NULL, NULL);
+	}
+
+	if (pSrcData)
+	{
+		CoTaskMemFree(pSrcData);
+	}
+
+	if (pDstData)
+	{
+		CoTaskMemFree(pDstData);
+	}
+
+	if (pbCopy)
+	{
+		CoTaskMemFree(pbCopy);
+	}
+
+	FreeColumnBindings(prgSrcBinding);
+	FreeColumnBindings(prgDstBinding);
+
+	if (rgpwszColumns)
+	{
+		CoTaskMemFree(rgpwszColumns);
+	}
+
+	if (pDBColumnInfo)
+	{
+		CoTaskMemFree(pDBColumnInfo);
+	}
+
+	if (pStringsBuffer)
+	{
+		CoTaskMemFree(pStringsBuffer);
+	}
+
+	if (pISrcAccessor)
+	{
+		pISrcAccessor->ReleaseAccessor(hSrcAccessor, NULL);
+		pISrcAccessor->Release();
+	}
+
+	if (pIDstAccessor)
+	{
+		pIDstAccessor->ReleaseAccessor(hDstAccessor, NULL);
+		pIDstAccessor->Release();
+	}
+
+	if (pIDstRowsetChange)
+	{
+		pIDstRowsetChange->Release();
+	}
+
+	if (pIDstRowset)
+	{
+		pIDstRowset->Release();
+	}
+
+	if (pIColumnsInfo)
+	{
+		pIColumnsInfo->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetColumnTypeName
+//
+// Description: Write the SQL Server Compact type of a column into pwszType.
+//
+// Returns: FALSE if the type has no SQL equivalent
+//
+////////////////////////////////////////////////////////////////////////////////
+static BOOL GetColumnTypeName(DBCOLUMNINFO *pColumnInfo, WCHAR *pwszType)
+{
+	BOOL fLong = (pColumnInfo->dwFlags & DBCOLUMNFLAGS_ISLONG) ? TRUE : FALSE;
+
+	switch (pColumnInfo->wType)
+	{
+		case DBTYPE_UI1:		wcscpy(pwszType, L"TINYINT");			break;
+		case DBTYPE_I2:			wcscpy(pwszType, L"SMALLINT");			break;
+		case DBTYPE_I4:			wcscpy(pwszType, L"INT");				break;
+		case DBTYPE_I8:			wcscpy(pwszType, L"BIGINT");			break;
+		case DBTYPE_BOOL:		wcscpy(pwszType, L"BIT");				break;
+		case DBTYPE_R4:			wcscpy(pwszType, L"REAL");				break;
+		case DBTYPE_R8:			wcscpy(pwszType, L"FLOAT");				break;
+		case DBTYPE_CY:			wcscpy(pwszType, L"MONEY");				break;
+		case DBTYPE_GUID:		wcscpy(pwszType, L"UNIQUEIDENTIFIER");	break;
+		case DBTYPE_DBTIMESTAMP:	wcscpy(pwszType, L"DATETIME");			break;
+
+		case DBTYPE_NUMERIC:
+			wsprintf(pwszType, L"NUMERIC(%u,%u)", pColumnInfo->bPrecision, pColumnInfo->bScale);
+			break;
+
+		case DBTYPE_WSTR:
+			if (fLong)
+			{
+				wcscpy(pwszType, L"NTEXT");
+			}
+			else
+			{
+				wsprintf(pwszType, L"NVARCHAR(%u)", pColumnInfo->ulColumnSize);
+			}
+			break;
+
+		case DBTYPE_BYTES:
+			if (fLong)
+			{
+				wcscpy(pwszType, L"IMAGE");
+			}
+			else
+			{
+				wsprintf(pwszType, L"VARBINARY(%u)", pColumnInfo->ulColumnSize);
+			}
+			break;
+
+		default:
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CreateTableFromRowset
+//
+// Description: Create a table with the columns of a rowset, e.g. to receive
+//				the result of a query through CopyRowset.
+//
+// Parameters
+//		pIRowset	- rowset whose columns are reproduced
+//		pISession	- any interface on the session of the new table
+//		pwszTable	- name of the new table
+//
+// Returns: NOERROR if succesfull
+//
+// Notes:
+//			Only names, types and nullability are reproduced. Identity,
+//			defaults and indexes are left to the caller.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CreateTableFromRowset(IRowset *pIRowset, IUnknown *pISession, LPCWSTR pwszTable)
+{
+	HRESULT			hr				= NOERROR;		// Error code reporting
+	IColumnsInfo	*pIColumnsInfo	= NULL;			// Provider Interface Pointer
+	DBCOLUMNINFO	*pDBColumnInfo	= NULL;			// Column metadata
+	WCHAR			*pStringsBuffer	= NULL;
+	WCHAR			*pwszQuery		= NULL;			// CREATE TABLE statement
+	WCHAR			*pwszEnd;
+	WCHAR			wszType[32];
+	ULONG			ulNumCols		= 0;
+	DWORD			cchQuery;
+	BOOL			fFirst			= TRUE;
+
+	if (NULL == pIRowset || NULL == pISession || NULL == pwszTable)
+	{
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+	hr = pIRowset->QueryInterface(IID_IColumnsInfo, (void**)&pIColumnsInfo);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIColumnsInfo->GetColumnInfo(&ulNumCols, &pDBColumnInfo, &pStringsBuffer);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Room for the table name and, per column, its name, type and NOT NULL
+	//
+	cchQuery = (DWORD)wcslen(pwszTable) + 32;
+	for (ULONG ulCol = 0; ulCol < ulNumCols; ++ulCol)
+	{
+		if (pDBColumnInfo[ulCol].pwszName)
+		{
+			cchQuery += (DWORD)wcslen(pDBColumnInfo[ulCol].pwszName) + 48;
+		}
+	}
+
+	pwszQuery = (WCHAR*)CoTaskMemAlloc(sizeof(WCHAR)*cchQuery);
+	if (NULL == pwszQuery)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	pwszEnd = pwszQuery + wsprintf(pwszQuery, L"CREATE TABLE [%s] (", pwszTable);
+
+	for (ULONG ulCol = 0; ulCol < ulNumCols; ++ulCol)
+	{
+		if (0 == pDBColumnInfo[ulCol].iOrdinal || NULL == pDBColumnInfo[ulCol].pwszName)
+		{
+			continue;
+		}
+
+		if (!GetColumnTypeName(&pDBColumnInfo[ulCol], wszType))
+		{
+			hr = E_NOTIMPL;
+			goto Exit;
+		}
+
+		pwszEnd += wsprintf(pwszEnd,
+							L"%s[%s] %s%s",
+							fFirst ? L"" : L", ",
+							pDBColumnInfo[ulCol].pwszName,
+							wszType,
+							(pDBColumnInfo[ulCol].dwFlags & DBCOLUMNFLAGS_ISNULLABLE) ? L"" : L" NOT NULL");
+		fFirst = FALSE;
+	}
+
+	if (fFirst)
+	{
+		hr = E_FAIL;
+		goto Exit;
+	}
+
+	wcscpy(pwszEnd, L")");
+
+	hr = ExecuteCommand(pISession, pwszQuery);
+
+Exit:
+	if (pwszQuery)
+	{
+		CoTaskMemFree(pwszQuery);
+	}
+
+	if (pDBColumnInfo)
+	{
+		CoTaskMemFree(pDBColumnInfo);
+	}
+
+	if (pStringsBuffer)
+	{
+		CoTaskMemFree(pStringsBuffer);
+	}
+
+	if (pIColumnsInfo)
+	{
+		pIColumnsInfo->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetDatabaseFileSize
+//
+// Description: Returns the size of a database file.
+//
+// Parameters
+//		pwszDatabase	- path of the database file
+//		pcbSize			- receives the size in bytes
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT GetDatabaseFileSize(LPCWSTR pwszDatabase, ULONGLONG *pcbSize)
+{
+	WIN32_FIND_DATA		FindFileData;
+	HANDLE				hFind;
+
+	if (NULL == pwszDatabase || NULL == pcbSize)
+	{
+		return E_INVALIDARG;
+	}
+
+	*pcbSize = 0;
+
+	hFind = FindFirstFile(pwszDatabase, &FindFileData);
+	if (INVALID_HANDLE_VALUE == hFind)
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	FindClose(hFind);
+
+	*pcbSize = ((ULONGLONG)FindFileData.nFileSizeHigh << 32) | FindFileData.nFileSizeLow;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FormatEmployeeName
+//
+// Description:	Combine employee last name and first name as displayed in
+//				the name list, truncated to the buffer.
+//
+// Parameters
+//		pwszName		- receives LastName + ', ' + FirstName
+//		cchName			- size of pwszName in characters
+//
+////////////////////////////////////////////////////////////////////////////////
+void FormatEmployeeName(WCHAR *pwszName, DWORD cchName, LPCWSTR pwszLastName, LPCWSTR pwszFirstName)
+{
+	DWORD cch;
+
+	if (NULL == pwszName || 0 == cchName)
+	{
+		return;
+	}
+
+	wcsncpy(pwszName, pwszLastName, cchName - 1);
+	pwszName[cchName - 1] = 0;
+
+	cch = wcslen(pwszName);
+	wcsncat(pwszName, L", ", cchName - 1 - cch);
+
+	cch = wcslen(pwszName);
+	wcsncat(pwszName, pwszFirstName, cchName - 1 - cch);
+}
@@ -0,0 +1,136 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: DbHelpers
+//
+// File: DbHelpers.h
+//
+// Comment: Shared OLE DB helpers used by the data-layer modules that work
+//			on the Employees table outside of the Employees dialog.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_DBHELPERS_H__6B0F3C1A_94C2_4E0B_8E3D_2F1B7A5C9D21__INCLUDED_)
+#define AFX_DBHELPERS_H__6B0F3C1A_94C2_4E0B_8E3D_2F1B7A5C9D21__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+// Rowset capabilities requested by OpenEmployeesRowset
+//
+#define ROWSET_OPT_INDEX		0x00000001		// DBPROP_IRowsetIndex
+#define ROWSET_OPT_CHANGE		0x00000002		// DBPROP_IRowsetChange
+
+// DBPROP_SSCE_AUTO_SHRINK_THRESHOLD of the connections opened by the
+// application. 100 turns automatic shrinking off: CompactScheduler compacts
+// the database when the device is idle instead.
+//
+#define DATABASE_AUTO_SHRINK_THRESHOLD	100
+
+// Size of the buffer used to copy BLOB data between streams and files
+//
+#define BLOB_COPY_BUFFER_SIZE	(16 * 1024)
+
+////////////////////////////////////////////////////////////////////////////////
+// Open a connection to a database file and return its IDBCreateSession
+//
+HRESULT OpenDataSource(LPCWSTR pwszDatabase, IDBCreateSession **ppIDBCreateSession);
+
+////////////////////////////////////////////////////////////////////////////////
+// Uninitialize and release a connection opened by OpenDataSource
+//
+void ReleaseDataSource(IDBCreateSession **ppIDBCreateSession);
+
+////////////////////////////////////////////////////////////////////////////////
+// Create a new, empty database file and return its IDBCreateSession
+//
+HRESULT CreateDataSource(LPCWSTR pwszDatabase, IDBCreateSession **ppIDBCreateSession);
+
+////////////////////////////////////////////////////////////////////////////////
+// Open a table through an index, or the base table if pwszIndex is NULL
+//
+HRESULT OpenTableRowset(IOpenRowset	*pIOpenRowset,
+						LPCWSTR		pwszTable,
+						LPCWSTR		pwszIndex,
+						DWORD		dwOptions,
+						REFIID		riid,
+						IUnknown	**ppRowset);
+
+////////////////////////////////////////////////////////////////////////////////
+// Open the Employees table through the PK_Employees index
+//
+HRESULT OpenEmployeesRowset(IOpenRowset *pIOpenRowset,
+							DWORD		dwOptions,
+							REFIID		riid,
+							IUnknown	**ppRowset);
+
+////////////////////////////////////////////////////////////////////////////////
+// Execute a non row returning SQL statement on a session
+//
+HRESULT ExecuteCommand(IUnknown *pISession, LPCWSTR pwszQuery);
+
+////////////////////////////////////////////////////////////////////////////////
+// Execute a row returning SQL statement on a session
+//
+HRESULT ExecuteQuery(IUnknown *pISession, LPCWSTR pwszQuery, IRowset **ppIRowset);
+
+////////////////////////////////////////////////////////////////////////////////
+// Execute a query and return the first column of its first row as an integer
+//
+HRESULT ExecuteScalar(IUnknown *pISession, LPCWSTR pwszQuery, LONG *plValue, BOOL *pfNull);
+
+////////////////////////////////////////////////////////////////////////////////
+// Build a DBBINDING array for the named columns of a rowset.
+// If rgpwszColumns is NULL, every column except the bookmark is bound.
+// BLOB columns are bound as storage objects described by pBlobObject; when
+// pBlobObject is NULL they are left out of an all-columns binding.
+//
+HRESULT CreateColumnBindings(IRowset		*pIRowset,
+							 WCHAR			**rgpwszColumns,
+							 DWORD			cColumns,
+							 DBOBJECT		*pBlobObject,
+							 DBBINDING		**pprgBinding,
+							 DWORD			*pcBindings,
+							 DWORD			*pcbRowSize);
+
+////////////////////////////////////////////////////////////////////////////////
+// Free the DBBINDING array returned by CreateColumnBindings
+//
+void FreeColumnBindings(DBBINDING *prgBinding);
+
+////////////////////////////////////////////////////////////////////////////////
+// Insert the remaining rows of a rowset into a table with the same column
+// names. The caller owns the transaction on the destination session.
+//
+HRESULT CopyRowset(IRowset		*pISrcRowset,
+				   IOpenRowset	*pIDstSession,
+				   LPCWSTR		pwszDstTable,
+				   DWORD		*pcRows,
+				   ULONGLONG	*pcbBytes);
+
+////////////////////////////////////////////////////////////////////////////////
+// Create a table with the column names, types and nullability of a rowset
+//
+HRESULT CreateTableFromRowset(IRowset *pIRowset, IUnknown *pISession, LPCWSTR pwszTable);
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns the size of a database file
+//
+HRESULT GetDatabaseFileSize(LPCWSTR pwszDatabase, ULONGLONG *pcbSize);
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns the throughput in hundredths of MB/s for a byte count and duration
+//
+DWORD GetThroughputMBps100(ULONGLONG cbBytes, DWORD dwElapsedMs);
+
+////////////////////////////////////////////////////////////////////////////////
+// Format LastName + ', ' + FirstName into a buffer of cchName characters
+//
+void FormatEmployeeName(WCHAR *pwszName, DWORD cchName, LPCWSTR pwszLastName, LPCWSTR pwszFirstName);
+
+#endif // !defined(AFX_DBHELPERS_H__6B0F3C1A_94C2_4E0B_8E3D_2F1B7A5C9D21__INCLUDED_)
@@ -0,0 +1,161 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: EmployeeBinder
+//
+// File: EmployeeBinder.cpp
+//
+// Comment: Binds employee records to the controls of the employees dialog.
+//
+// Functions:
+//			1. Display an EmployeeRecord in the dialog
+//			2. Build an EmployeeRecord from the dialog
+//			3. Fill the employee name list
+//
+// Notes:
+//			This file only moves values between the controls and the
+//			records; EmployeeStore reads and writes them.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "EmployeeSchema.h"
+#include "SessionPool.h"
+#include "EmployeeStore.h"
+#include "EmployeeBinder.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Dialog control of a text field of an EmployeeRecord
+//
+#define EMPLOYEE_INFO_CONTROL(iField)	(g_rgEmployeeSchema[EMPLOYEE_INFO_COLUMN(iField)].nControlID)
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ShowEmployeeRecord()
+//
+// Description: Display the EmployeeID and the text fields of a record. A
+//				NULL field leaves its control as it is.
+//
+// Parameters:
+//			hWndDlg		- Employees dialog
+//			pRecord		- Employee to display
+//
+////////////////////////////////////////////////////////////////////////////////
+void ShowEmployeeRecord(HWND hWndDlg, const EmployeeRecord *pRecord)
+{
+	DWORD	dwIndex;
+
+	SetDlgItemInt(hWndDlg, g_rgEmployeeSchema[EMPLOYEE_COL_EMPLOYEE_ID].nControlID, pRecord->GetEmployeeID(), 0);
+
+	for (dwIndex = 0; dwIndex < EMPLOYEE_INFO_FIELDS; ++dwIndex)
+	{
+		if (pRecord->GetField(dwIndex))
+		{
+			SetDlgItemText(hWndDlg, EMPLOYEE_INFO_CONTROL(dwIndex), pRecord->GetField(dwIndex));
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ReadEmployeeRecord()
+//
+// Description: Build a record of the text fields as edited in the dialog.
+//				The record has no photo and no row version.
+//
+// Parameters:
+//			hWndDlg			- Employees dialog
+//			dwEmployeeID	- Employee edited
+//			pRecord			- Receives the record
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ReadEmployeeRecord(HWND hWndDlg, DWORD dwEmployeeID, EmployeeRecord *pRecord)
+{
+	WCHAR	rgwszFields[EMPLOYEE_INFO_FIELDS][EMPLOYEE_MAX_FIELD + 1];
+	LPCWSTR	rgpwszFields[EMPLOYEE_INFO_FIELDS];
+	DWORD	dwIndex;
+
+	for (dwIndex = 0; dwIndex < EMPLOYEE_INFO_FIELDS; ++dwIndex)
+	{
+		GetDlgItemText(hWndDlg, EMPLOYEE_INFO_CONTROL(dwIndex), rgwszFields[dwIndex], EMPLOYEE_MAX_FIELD + 1);
+		rgpwszFields[dwIndex] = rgwszFields[dwIndex];
+	}
+
+	return pRecord->Create(dwEmployeeID, rgpwszFields, NULL, NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CreateEmployeePhoto()
+//
+// Description: Create the bitmap of the photo of a record.
+//
+// Returns: The DIB section, NULL if the record has no photo
+//
+////////////////////////////////////////////////////////////////////////////////
+HBITMAP CreateEmployeePhoto(HWND hWndDlg, const EmployeeRecord *pRecord)
+{
+	HBITMAP					hBitmap		= NULL;
+	BITMAPINFO				bmpInfo;
+	const BITMAPINFOHEADER	*pbmiPhoto;
+	const BYTE				*pRecordBits;
+	BYTE					*pPhotoBits	= NULL;
+	HDC						hDC;
+
+	pbmiPhoto = pRecord->GetPhoto(&pRecordBits);
+	if (NULL == pbmiPhoto)
+	{
+		return NULL;
+	}
+
+	memset(&bmpInfo, 0, sizeof(bmpInfo));
+	bmpInfo.bmiHeader = *pbmiPhoto;
+
+	hDC = GetDC(hWndDlg);
+
+	hBitmap = CreateDIBSection(hDC, &bmpInfo, DIB_RGB_COLORS, (void **)&pPhotoBits, NULL, 0);
+	if (hBitmap)
+	{
+		memcpy(pPhotoBits, pRecordBits, pbmiPhoto->biSizeImage);
+	}
+
+	ReleaseDC(hWndDlg, hDC);
+
+	return hBitmap;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddEmployeeName()
+//
+// Description: Add an employee name to the employee name combobox, with the
+//				EmployeeID as its item data.
+//
+// Parameters:
+//			pvContext		- Employees dialog
+//			dwEmployeeID	- Employee
+//			pwszName		- "LastName, FirstName"
+//
+// Returns: NOERROR, an item that can't be added is left out
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CALLBACK AddEmployeeName(LPVOID pvContext, DWORD dwEmployeeID, LPCWSTR pwszName)
+{
+	DWORD	dwIndex;
+
+	// Add new item into combobox
+	//
+	dwIndex = SendDlgItemMessage((HWND)pvContext, IDC_COMBO_NAME, CB_ADDSTRING, 0, (LPARAM)pwszName);
+	if (CB_ERR != dwIndex)
+	{
+		// Set item assocaited data to employee id.
+		SendDlgItemMessage((HWND)pvContext, IDC_COMBO_NAME, CB_SETITEMDATA, dwIndex, dwEmployeeID);
+	}
+
+	return NOERROR;
+}
@@ -0,0 +1,44 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: EmployeeBinder
+//
+// File: EmployeeBinder.h
+//
+// Comment: Binds employee records to the controls of the employees dialog.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_EMPLOYEEBINDER_H__C2B84E61_0D3F_4A9E_B715_6E29F08D3A4C__INCLUDED_)
+#define AFX_EMPLOYEEBINDER_H__C2B84E61_0D3F_4A9E_B715_6E29F08D3A4C__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+////////////////////////////////////////////////////////////////////////////////
+// Display the EmployeeID and the text fields of a record
+//
+void ShowEmployeeRecord(HWND hWndDlg, const EmployeeRecord *pRecord);
+
+////////////////////////////////////////////////////////////////////////////////
+// Build a record of the text fields as edited in the dialog
+//
+HRESULT ReadEmployeeRecord(HWND hWndDlg, DWORD dwEmployeeID, EmployeeRecord *pRecord);
+
+////////////////////////////////////////////////////////////////////////////////
+// Create the bitmap of the photo of a record, NULL if it has none
+//
+HBITMAP CreateEmployeePhoto(HWND hWndDlg, const EmployeeRecord *pRecord);
+
+////////////////////////////////////////////////////////////////////////////////
+// PFN_EMPLOYEE_NAME adding the names to IDC_COMBO_NAME, pvContext is the
+// dialog window
+//
+HRESULT CALLBACK AddEmployeeName(LPVOID pvContext, DWORD dwEmployeeID, LPCWSTR pwszName);
+
+#endif // !defined(AFX_EMPLOYEEBINDER_H__C2B84E61_0D3F_4A9E_B715_6E29F08D3A4C__INCLUDED_)
@@ -0,0 +1,191 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: EmployeeSchema
+//
+// File: EmployeeSchema.cpp
+//
+// Comment: The columns of Employees, described once.
+//
+// Functions:
+//			1. The column table generated from EMPLOYEE_SCHEMA
+//			2. Bind columns of EMPLOYEE_ROW without reading the metadata
+//			3. Check the schema against the database
+//
+// Notes:
+//			The ordinals, types and offsets are known when the code is
+//			compiled, so a binding is a copy of the table below. The
+//			database is checked against it once per schema version of
+//			g_SchemaCatalog, instead of looking the columns up by name
+//			each time a rowset is bound.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "SchemaCatalog.h"
+#include "EmployeeSchema.h"
+
+#define EMPLOYEE_SCHEMA_ENTRY_(Id, Name, Type, Kind, cch, Control)						\
+	{																					\
+		EMPLOYEE_WIDEN(#Name),															\
+		EMPLOYEE_ORDINAL(EMPLOYEE_COL_##Id),											\
+		EMPLOYEE_DBTYPE_##Kind,															\
+		EMPLOYEE_SIZE_##Kind(cch),														\
+		EMPLOYEE_BINDTYPE_##Kind,														\
+		offsetof(EMPLOYEE_ROW, Name),													\
+		offsetof(EMPLOYEE_ROW, cb##Name),												\
+		offsetof(EMPLOYEE_ROW, dw##Name##Status),										\
+		sizeof(((EMPLOYEE_ROW*)0)->Name),												\
+		Control																			\
+	},
+
+const EMPLOYEE_SCHEMA_COLUMN g_rgEmployeeSchema[EMPLOYEE_SCHEMA_SIZE] =	{
+																			EMPLOYEE_SCHEMA(EMPLOYEE_SCHEMA_ENTRY_)
+																		};
+
+// Column names, resolved by CheckEmployeeSchema
+//
+#define EMPLOYEE_SCHEMA_NAME_ENTRY_(Id, Name, Type, Kind, cch, Control)	EMPLOYEE_WIDEN(#Name),
+
+static WCHAR* s_rgpwszSchemaNames[EMPLOYEE_SCHEMA_SIZE] =	{
+																EMPLOYEE_SCHEMA(EMPLOYEE_SCHEMA_NAME_ENTRY_)
+															};
+
+static SCHEMA_COLUMN	s_rgSchemaColumns[EMPLOYEE_SCHEMA_SIZE];
+static DWORD			s_dwCheckedVersion	= 0;		// Catalog version checked, 0 if none
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: BindEmployeeColumns()
+//
+// Description: Fill the bindings of columns of EMPLOYEE_ROW.
+//
+// Parameters:
+//			rgiColumn		- Column indexes, EMPLOYEE_COL_*
+//			cColumns		- Number of columns
+//			pBlobObject		- Storage object of the BLOB columns
+//			rgBinding		- Receives cColumns bindings
+//
+////////////////////////////////////////////////////////////////////////////////
+void BindEmployeeColumns(const DWORD	*rgiColumn,
+						 DWORD			cColumns,
+						 DBOBJECT		*pBlobObject,
+						 DBBINDING		*rgBinding)
+{
+	const EMPLOYEE_SCHEMA_COLUMN	*pColumn;
+	DWORD							dwIndex;
+
+	for (dwIndex = 0; dwIndex < cColumns; ++dwIndex)
+	{
+		pColumn = &g_rgEmployeeSchema[rgiColumn[dwIndex]];
+
+		rgBinding[dwIndex].iOrdinal		= pColumn->iOrdinal;
+		rgBinding[dwIndex].obValue		= pColumn->obValue;
+		rgBinding[dwIndex].obLength		= pColumn->obLength;
+		rgBinding[dwIndex].obStatus		= pColumn->obStatus;
+		rgBinding[dwIndex].pTypeInfo	= NULL;
+		rgBinding[dwIndex].pObject		= (DBTYPE_IUNKNOWN == pColumn->wBindType) ? pBlobObject : NULL;
+		rgBinding[dwIndex].pBindExt		= NULL;
+		rgBinding[dwIndex].dwPart		= DBPART_VALUE | DBPART_STATUS | DBPART_LENGTH;
+		rgBinding[dwIndex].dwMemOwner	= DBMEMOWNER_CLIENTOWNED;
+		rgBinding[dwIndex].cbMaxLen		= pColumn->cbMaxLen;
+		rgBinding[dwIndex].dwFlags		= 0;
+		rgBinding[dwIndex].wType		= pColumn->wBindType;
+		rgBinding[dwIndex].bPrecision	= 0;
+		rgBinding[dwIndex].bScale		= 0;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CheckEmployeeSchema()
+//
+// Description: Check that Employees has the columns of the schema, at the
+//				ordinals, of the types and of the sizes the bindings assume.
+//
+// Parameters:
+//			pISession	- Session of the database
+//
+// Returns: NOERROR if succesfull, DB_E_BADCOLUMNID if a column is missing or
+//			differs
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CheckEmployeeSchema(IUnknown *pISession)
+{
+	HRESULT hr;
+	DWORD	dwIndex;
+
+	// Cheap once resolved, the catalog compares versions only
+	//
+	hr = g_SchemaCatalog.Resolve(pISession,
+								 TABLE_EMPLOYEE,
+								 s_rgpwszSchemaNames,
+								 EMPLOYEE_SCHEMA_SIZE,
+								 s_rgSchemaColumns);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	if (s_rgSchemaColumns[0].dwVersion == s_dwCheckedVersion)
+	{
+		return NOERROR;
+	}
+
+	for (dwIndex = 0; dwIndex < EMPLOYEE_SCHEMA_SIZE; ++dwIndex)
+	{
+		if (s_rgSchemaColumns[dwIndex].iOrdinal != g_rgEmployeeSchema[dwIndex].iOrdinal ||
+			s_rgSchemaColumns[dwIndex].wType != g_rgEmployeeSchema[dwIndex].wType ||
+			(g_rgEmployeeSchema[dwIndex].ulColumnSize &&
+			 s_rgSchemaColumns[dwIndex].ulColumnSize != g_rgEmployeeSchema[dwIndex].ulColumnSize))
+		{
+			return DB_E_BADCOLUMNID;
+		}
+	}
+
+	s_dwCheckedVersion = s_rgSchemaColumns[0].dwVersion;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SetEmployeeText()
+//
+// Description: Set a WSTR column of an EMPLOYEE_ROW, cut to the column size.
+//
+// Parameters:
+//			pRow		- Row
+//			iColumn		- Column index, EMPLOYEE_COL_*
+//			pwszValue	- Text, NULL for NULL
+//
+////////////////////////////////////////////////////////////////////////////////
+void SetEmployeeText(EMPLOYEE_ROW *pRow, DWORD iColumn, LPCWSTR pwszValue)
+{
+	WCHAR	*pwszColumn = (WCHAR*)EMPLOYEE_ROW_VALUE(pRow, iColumn);
+	DWORD	cch;
+
+	if (NULL == pwszValue)
+	{
+		pwszColumn[0]						= WCHAR('\0');
+		EMPLOYEE_ROW_LENGTH(pRow, iColumn)	= 0;
+		EMPLOYEE_ROW_STATUS(pRow, iColumn)	= DBSTATUS_S_ISNULL;
+		return;
+	}
+
+	cch = wcslen(pwszValue);
+	if (cch > g_rgEmployeeSchema[iColumn].ulColumnSize)
+	{
+		cch = g_rgEmployeeSchema[iColumn].ulColumnSize;
+	}
+
+	memcpy(pwszColumn, pwszValue, cch*sizeof(WCHAR));
+	pwszColumn[cch] = WCHAR('\0');
+
+	EMPLOYEE_ROW_LENGTH(pRow, iColumn)	= cch*sizeof(WCHAR);
+	EMPLOYEE_ROW_STATUS(pRow, iColumn)	= DBSTATUS_S_OK;
+}
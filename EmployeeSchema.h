@@ -0,0 +1,178 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: EmployeeSchema
+//
+// File: EmployeeSchema.h
+//
+// Comment: The columns of Employees, described once.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_EMPLOYEESCHEMA_H__2B8E6F04_C9D1_4A37_9E52_D06A3F1C8B7E__INCLUDED_)
+#define AFX_EMPLOYEESCHEMA_H__2B8E6F04_C9D1_4A37_9E52_D06A3F1C8B7E__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+////////////////////////////////////////////////////////////////////////////////
+// The columns of Employees in table order, one X(...) per column:
+//
+//	X(Id, Name, SQL type, Kind, Characters, Dialog control)
+//
+// Kind is I4, WSTR, BLOB or VERSION. Characters is the size of a WSTR
+// column. The dialog control is the edit control showing the column, 0 if
+// none. The key column is the key of PK_Employees. The VERSION column is
+// set by the engine on every insert and update and is never written.
+//
+// Everything below is generated from these lists: the DDL, the column
+// indexes and ordinals, the EMPLOYEE_ROW record and its bindings. A column
+// is added or changed here and nowhere else. The sample rows of
+// g_SampleEmployeeData have one value per written column, in this order.
+//
+#define EMPLOYEE_SCHEMA_KEY(X)																\
+	X(EMPLOYEE_ID,	EmployeeID,	L"INT NOT NULL",	I4,		0,	IDC_EDIT_EMPLOYEE_ID)
+
+#define EMPLOYEE_SCHEMA_COLUMNS(X)															\
+	X(LAST_NAME,	LastName,	L"NVARCHAR(20)",	WSTR,	20,	0)						\
+	X(FIRST_NAME,	FirstName,	L"NVARCHAR(10)",	WSTR,	10,	0)						\
+	X(ADDRESS,		Address,	L"NVARCHAR(60)",	WSTR,	60,	IDC_EDIT_ADDRESS)		\
+	X(CITY,			City,		L"NVARCHAR(15)",	WSTR,	15,	IDC_EDIT_CITY)			\
+	X(REGION,		Region,		L"NVARCHAR(15)",	WSTR,	15,	IDC_EDIT_REGION)		\
+	X(POSTAL_CODE,	PostalCode,	L"NVARCHAR(10)",	WSTR,	10,	IDC_EDIT_POSTAL_CODE)	\
+	X(COUNTRY,		Country,	L"NVARCHAR(15)",	WSTR,	15,	IDC_EDIT_COUNTRY)		\
+	X(HOME_PHONE,	HomePhone,	L"NVARCHAR(24)",	WSTR,	24,	IDC_EDIT_HOME_PHONE)	\
+	X(PHOTO,		Photo,		L"IMAGE",			BLOB,	0,	0)						\
+	X(ROW_VERSION,	RowVersion,	L"ROWVERSION",		VERSION,	0,	0)
+
+#define EMPLOYEE_SCHEMA(X)		EMPLOYEE_SCHEMA_KEY(X) EMPLOYEE_SCHEMA_COLUMNS(X)
+
+// Column names as wide string literals
+//
+#define EMPLOYEE_WIDEN_(x)		L ## x
+#define EMPLOYEE_WIDEN(x)		EMPLOYEE_WIDEN_(x)
+
+#define EMPLOYEE_SCHEMA_NAME_(Id, Name, Type, Kind, cch, Control)			EMPLOYEE_WIDEN(#Name)
+#define EMPLOYEE_SCHEMA_DDL_FIRST_(Id, Name, Type, Kind, cch, Control)		EMPLOYEE_WIDEN(#Name) L" " Type
+#define EMPLOYEE_SCHEMA_DDL_NEXT_(Id, Name, Type, Kind, cch, Control)		L", " EMPLOYEE_WIDEN(#Name) L" " Type
+
+// Employees and its key index
+//
+#define EMPLOYEE_SCHEMA_TABLE_DDL	L"CREATE TABLE Employees ("									\
+									EMPLOYEE_SCHEMA_KEY(EMPLOYEE_SCHEMA_DDL_FIRST_)				\
+									EMPLOYEE_SCHEMA_COLUMNS(EMPLOYEE_SCHEMA_DDL_NEXT_)			\
+									L")"
+
+#define EMPLOYEE_SCHEMA_INDEX_DDL	L"CREATE UNIQUE INDEX PK_Employees ON Employees ("			\
+									EMPLOYEE_SCHEMA_KEY(EMPLOYEE_SCHEMA_NAME_)					\
+									L")"
+
+// Column indexes, EMPLOYEE_COL_EMPLOYEE_ID, EMPLOYEE_COL_LAST_NAME, ...
+//
+#define EMPLOYEE_SCHEMA_INDEX_(Id, Name, Type, Kind, cch, Control)			EMPLOYEE_COL_##Id,
+
+enum
+{
+	EMPLOYEE_SCHEMA(EMPLOYEE_SCHEMA_INDEX_)
+	EMPLOYEE_SCHEMA_SIZE
+};
+
+// Columns an insert writes, every column before RowVersion
+//
+#define EMPLOYEE_SCHEMA_WRITTEN		EMPLOYEE_COL_ROW_VERSION
+
+typedef char EMPLOYEE_ROW_VERSION_LAST[(EMPLOYEE_COL_ROW_VERSION + 1 == EMPLOYEE_SCHEMA_SIZE) ? 1 : -1];
+
+// Ordinal of a column, 0 is the bookmark
+//
+#define EMPLOYEE_ORDINAL(iColumn)	((DBORDINAL)(iColumn) + 1)
+
+// Column and bound types of each kind
+//
+#define EMPLOYEE_DBTYPE_I4			DBTYPE_I4
+#define EMPLOYEE_DBTYPE_WSTR		DBTYPE_WSTR
+#define EMPLOYEE_DBTYPE_BLOB		DBTYPE_BYTES
+#define EMPLOYEE_DBTYPE_VERSION		DBTYPE_BYTES
+
+#define EMPLOYEE_BINDTYPE_I4		DBTYPE_I4
+#define EMPLOYEE_BINDTYPE_WSTR		DBTYPE_WSTR
+#define EMPLOYEE_BINDTYPE_BLOB		DBTYPE_IUNKNOWN
+#define EMPLOYEE_BINDTYPE_VERSION	DBTYPE_BYTES
+
+#define EMPLOYEE_SIZE_I4(cch)		sizeof(LONG)
+#define EMPLOYEE_SIZE_WSTR(cch)		(cch)
+#define EMPLOYEE_SIZE_BLOB(cch)		0				// Not checked, the provider reports its limit
+#define EMPLOYEE_SIZE_VERSION(cch)	8				// Bytes of a ROWVERSION
+
+#define EMPLOYEE_VALUE_I4(Name, cch)	LONG		Name
+#define EMPLOYEE_VALUE_WSTR(Name, cch)	WCHAR		Name[(cch) + 1]		// Extra buffer for null terminator
+#define EMPLOYEE_VALUE_BLOB(Name, cch)	IUnknown	*Name				// Storage object of DBOBJECT::iid
+#define EMPLOYEE_VALUE_VERSION(Name, cch)	BYTE	Name[8]
+
+////////////////////////////////////////////////////////////////////////////////
+// A row of Employees as bound by BindEmployeeColumns: the length, status
+// and value of each column, cbEmployeeID, dwEmployeeIDStatus, EmployeeID,
+// cbLastName, ... Only the columns of the bindings are read or written.
+//
+#define EMPLOYEE_SCHEMA_FIELD_(Id, Name, Type, Kind, cch, Control)	\
+	ULONG		cb##Name;											\
+	DBSTATUS	dw##Name##Status;									\
+	EMPLOYEE_VALUE_##Kind(Name, cch);
+
+typedef struct tagEMPLOYEE_ROW
+{
+	EMPLOYEE_SCHEMA(EMPLOYEE_SCHEMA_FIELD_)
+} EMPLOYEE_ROW;
+
+////////////////////////////////////////////////////////////////////////////////
+// A column of Employees with its binding in EMPLOYEE_ROW
+//
+typedef struct tagEMPLOYEE_SCHEMA_COLUMN
+{
+	LPCWSTR			pwszName;
+	DBORDINAL		iOrdinal;
+	DBTYPE			wType;						// Type of the column
+	DBLENGTH		ulColumnSize;				// Characters of a WSTR column, else bytes
+	DBTYPE			wBindType;					// Type of the value in EMPLOYEE_ROW
+	DBBYTEOFFSET	obValue;
+	DBBYTEOFFSET	obLength;
+	DBBYTEOFFSET	obStatus;
+	DBLENGTH		cbMaxLen;
+	int				nControlID;					// Edit control of the dialog, 0 if none
+} EMPLOYEE_SCHEMA_COLUMN;
+
+// Parts of a column of an EMPLOYEE_ROW, by column index
+//
+#define EMPLOYEE_ROW_VALUE(pRow, iColumn)	((BYTE*)(pRow) + g_rgEmployeeSchema[iColumn].obValue)
+#define EMPLOYEE_ROW_LENGTH(pRow, iColumn)	(*(ULONG*)((BYTE*)(pRow) + g_rgEmployeeSchema[iColumn].obLength))
+#define EMPLOYEE_ROW_STATUS(pRow, iColumn)	(*(DBSTATUS*)((BYTE*)(pRow) + g_rgEmployeeSchema[iColumn].obStatus))
+
+////////////////////////////////////////////////////////////////////////////////
+// Fill the bindings of columns of EMPLOYEE_ROW. BLOB columns are bound as
+// the storage object described by pBlobObject.
+//
+void BindEmployeeColumns(const DWORD	*rgiColumn,
+						 DWORD			cColumns,
+						 DBOBJECT		*pBlobObject,
+						 DBBINDING		*rgBinding);
+
+////////////////////////////////////////////////////////////////////////////////
+// Check that Employees has the columns of the schema at their ordinals.
+// The check runs again only after g_SchemaCatalog sees a schema change.
+//
+HRESULT CheckEmployeeSchema(IUnknown *pISession);
+
+////////////////////////////////////////////////////////////////////////////////
+// Set a WSTR column of an EMPLOYEE_ROW, cut to the column size. NULL sets
+// the column to NULL.
+//
+void SetEmployeeText(EMPLOYEE_ROW *pRow, DWORD iColumn, LPCWSTR pwszValue);
+
+extern const EMPLOYEE_SCHEMA_COLUMN	g_rgEmployeeSchema[EMPLOYEE_SCHEMA_SIZE];
+
+#endif // !defined(AFX_EMPLOYEESCHEMA_H__2B8E6F04_C9D1_4A37_9E52_D06A3F1C8B7E__INCLUDED_)
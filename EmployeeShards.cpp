@@ -0,0 +1,811 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: EmployeeShards
+//
+// File: EmployeeShards.cpp
+//
+// Comment: Employees split by EmployeeID range across several database files.
+//
+// Functions:
+//			1. Open or create the database file of each range
+//			2. Route single employee requests to the shard of their range
+//			3. Scan all shards in parallel and merge by EmployeeID
+//
+// Notes:
+//			Each shard has its own connection, so the size limit of a
+//			database file applies to a range rather than to the whole table,
+//			and writers of different ranges do not serialize on one file.
+//			The scan threads check their sessions out of a pool per shard,
+//			so repeated scans don't open a session per shard each time.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "EmployeeSchema.h"
+#include "SessionPool.h"
+#include "EmployeeShards.h"
+
+// State of the scan of one shard
+//
+typedef struct tagSHARD_SCAN
+{
+	POOLED_SESSION		*pSession;
+	EMPLOYEE_NAME		*rgNames;
+	DWORD				cNames;
+	HRESULT				hr;
+} SHARD_SCAN;
+
+// Columns read for a name
+//
+static WCHAR* s_rgpwszNameColumns[] =	{
+											L"EmployeeID",
+											L"LastName",
+											L"FirstName"
+										};
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeShards::EmployeeShards()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeeShards::EmployeeShards() : m_cShards(0)
+{
+	for (DWORD iShard = 0; iShard < SHARD_MAX_SHARDS; ++iShard)
+	{
+		m_rgpIDBCreateSession[iShard] = NULL;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeShards::~EmployeeShards()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeeShards::~EmployeeShards()
+{
+	Close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeShards::Open()
+//
+// Description: Open a connection to each shard, creating the database
+//				files that do not exist.
+//
+// Parameters
+//		rgShards	- the shards, in any order. Ranges must not overlap.
+//		cShards		- number of shards
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeShards::Open(const EMPLOYEE_SHARD *rgShards, DWORD cShards)
+{
+	HRESULT			hr		= NOERROR;
+	EMPLOYEE_SHARD	Shard;
+	SESSION_POOL_SETTINGS	Settings;
+	DWORD			iShard;
+	DWORD			iSorted;
+
+	if (NULL == rgShards || 0 == cShards || cShards > SHARD_MAX_SHARDS)
+	{
+		return E_INVALIDARG;
+	}
+
+	if (m_cShards)
+	{
+		return E_UNEXPECTED;
+	}
+
+	// Keep the shards sorted by range
+	//
+	for (iShard = 0; iShard < cShards; ++iShard)
+	{
+		Shard = rgShards[iShard];
+
+		if (NULL == Shard.pwszDatabase || Shard.dwFirstID > Shard.dwLastID ||
+			wcslen(Shard.pwszDatabase) >= MAX_PATH)
+		{
+			return E_INVALIDARG;
+		}
+
+		for (iSorted = iShard; iSorted > 0 && m_rgShard[iSorted - 1].dwFirstID > Shard.dwFirstID; --iSorted)
+		{
+			m_rgShard[iSorted] = m_rgShard[iSorted - 1];
+		}
+
+		m_rgShard[iSorted] = Shard;
+	}
+
+	for (iShard = 0; iShard < cShards; ++iShard)
+	{
+		if (iShard > 0 && m_rgShard[iShard].dwFirstID <= m_rgShard[iShard - 1].dwLastID)
+		{
+			return E_INVALIDARG;
+		}
+
+		wcscpy(m_rgwszDatabase[iShard], m_rgShard[iShard].pwszDatabase);
+		m_rgShard[iShard].pwszDatabase = m_rgwszDatabase[iShard];
+	}
+
+	m_cShards = cShards;
+
+	for (iShard = 0; iShard < m_cShards; ++iShard)
+	{
+		hr = OpenShard(iShard);
+		if(FAILED(hr))
+		{
+			Close();
+			break;
+		}
+
+		Settings.pIDBCreateSession	= m_rgpIDBCreateSession[iShard];
+		Settings.cMinSessions		= 1;
+		Settings.cMaxSessions		= SHARD_POOL_MAX_SESSIONS;
+		Settings.dwIdleTimeoutMs	= SHARD_POOL_IDLE_TIMEOUT;
+
+		hr = m_rgSessionPool[iShard].Start(&Settings);
+		if(FAILED(hr))
+		{
+			Close();
+			break;
+		}
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeShards::Close()
+//
+// Description: Close the connections to the shards.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeeShards::Close()
+{
+	for (DWORD iShard = 0; iShard < m_cShards; ++iShard)
+	{
+		m_rgSessionPool[iShard].Stop();
+		ReleaseDataSource(&m_rgpIDBCreateSession[iShard]);
+	}
+
+	m_cShards = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeShards::OpenShard()
+//
+// Description: Open a shard, or create it with an empty Employees table.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeShards::OpenShard(DWORD iShard)
+{
+	HRESULT			hr			= NOERROR;
+	IOpenRowset		*pISession	= NULL;			// Provider Interface Pointer
+	ULONGLONG		cbSize;
+
+	if (SUCCEEDED(GetDatabaseFileSize(m_rgShard[iShard].pwszDatabase, &cbSize)))
+	{
+		return OpenDataSource(m_rgShard[iShard].pwszDatabase, &m_rgpIDBCreateSession[iShard]);
+	}
+
+	hr = CreateDataSource(m_rgShard[iShard].pwszDatabase, &m_rgpIDBCreateSession[iShard]);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = m_rgpIDBCreateSession[iShard]->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pISession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = ExecuteCommand(pISession, EMPLOYEE_SCHEMA_TABLE_DDL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = ExecuteCommand(pISession, EMPLOYEE_SCHEMA_INDEX_DDL);
+
+Exit:
+	if (pISession)
+	{
+		pISession->Release();
+	}
+
+	// Don't leave a shard without its table behind
+	//
+	if (FAILED(hr) && m_rgpIDBCreateSession[iShard])
+	{
+		ReleaseDataSource(&m_rgpIDBCreateSession[iShard]);
+		DeleteFile(m_rgShard[iShard].pwszDatabase);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeShards::GetShardCount()
+//
+// Description: Returns the number of open shards.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD EmployeeShards::GetShardCount()
+{
+	return m_cShards;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeShards::GetShard()
+//
+// Description: Find the shard of an employee.
+//
+// Returns: NOERROR if succesfull, E_INVALIDARG if no shard holds the id
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeShards::GetShard(DWORD dwEmployeeID, DWORD *piShard)
+{
+	DWORD iLow	= 0;
+	DWORD iHigh	= m_cShards;
+	DWORD iMid;
+
+	if (NULL == piShard)
+	{
+		return E_INVALIDARG;
+	}
+
+	// Binary search of the sorted ranges
+	//
+	while (iLow < iHigh)
+	{
+		iMid = (iLow + iHigh) / 2;
+
+		if (dwEmployeeID < m_rgShard[iMid].dwFirstID)
+		{
+			iHigh = iMid;
+		}
+		else if (dwEmployeeID > m_rgShard[iMid].dwLastID)
+		{
+			iLow = iMid + 1;
+		}
+		else
+		{
+			*piShard = iMid;
+			return NOERROR;
+		}
+	}
+
+	return E_INVALIDARG;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeShards::CreateSession()
+//
+// Description: Create a session on the shard of an employee. Inserts and
+//				updates of the employee go through this session.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeShards::CreateSession(DWORD dwEmployeeID, REFIID riid, IUnknown **ppSession)
+{
+	HRESULT hr;
+	DWORD	iShard;
+
+	if (NULL == ppSession)
+	{
+		return E_INVALIDARG;
+	}
+
+	*ppSession = NULL;
+
+	hr = GetShard(dwEmployeeID, &iShard);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	return m_rgpIDBCreateSession[iShard]->CreateSession(NULL, riid, ppSession);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeShards::LookupName()
+//
+// Description: Seek one employee on the shard of its range.
+//
+// Returns: NOERROR if found, S_FALSE if the employee does not exist
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeShards::LookupName(DWORD dwEmployeeID, EMPLOYEE_NAME *pName)
+{
+	HRESULT			hr					= NOERROR;
+	IOpenRowset		*pISession			= NULL;				// Provider Interface Pointer
+	IRowsetIndex	*pIRowsetIndex		= NULL;				// Provider Interface Pointer
+	IRowset			*pIRowset			= NULL;				// Provider Interface Pointer
+	IAccessor		*pIAccessor			= NULL;				// Provider Interface Pointer
+	HACCESSOR		hAccessor			= DB_NULL_HACCESSOR;// Accessor handle
+	DBBINDING		*prgBinding			= NULL;				// Binding used to create accessor
+	DWORD			cBindings			= 0;
+	DWORD			cbRowSize			= 0;
+	BYTE			*pData				= NULL;				// Record data
+	HROW			rghRows[1];								// Row handle obtained from the seek
+	HROW			*prghRows			= rghRows;
+	ULONG			cRowsObtained		= 0;
+
+	if (NULL == pName)
+	{
+		return E_INVALIDARG;
+	}
+
+	hr = CreateSession(dwEmployeeID, IID_IOpenRowset, (IUnknown**)&pISession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = OpenEmployeesRowset(pISession, ROWSET_OPT_INDEX, IID_IRowsetIndex, (IUnknown**)&pIRowsetIndex);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowsetIndex->QueryInterface(IID_IRowset, (void**)&pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = CreateColumnBindings(pIRowset,
+							  s_rgpwszNameColumns,
+							  sizeof(s_rgpwszNameColumns)/sizeof(s_rgpwszNameColumns[0]),
+							  NULL,
+							  &prgBinding,
+							  &cBindings,
+							  &cbRowSize);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, cBindings, prgBinding, cbRowSize, &hAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	pData = (BYTE*)CoTaskMemAlloc(cbRowSize);
+	if (NULL == pData)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+    // Set data buffer for seek operation
+    //
+	memset(pData, 0, cbRowSize);
+	*(ULONG*)(pData+prgBinding[0].obLength)		= 4;
+	*(DBSTATUS*)(pData+prgBinding[0].obStatus)	= DBSTATUS_S_OK;
+	*(int*)(pData+prgBinding[0].obValue)		= dwEmployeeID;
+
+	hr = pIRowsetIndex->Seek(hAccessor, 1, pData, DBSEEK_FIRSTEQ);
+	if (DB_E_NOTFOUND == hr)
+	{
+		hr = S_FALSE;
+		goto Exit;
+	}
+
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, 1, &cRowsObtained, &prghRows);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	if (0 == cRowsObtained)
+	{
+		hr = S_FALSE;
+		goto Exit;
+	}
+
+	memset(pData, 0, cbRowSize);
+
+	hr = pIRowset->GetData(rghRows[0], hAccessor, pData);
+
+	pIRowset->ReleaseRows(1, rghRows, NULL, NULL, NULL);
+
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	pName->dwEmployeeID = dwEmployeeID;
+	FormatEmployeeName(pName->wszName,
+					   SHARD_MAX_NAME,
+					   DBSTATUS_S_ISNULL == *(DBSTATUS *)(pData+prgBinding[1].obStatus) ? L"" : (WCHAR*)(pData+prgBinding[1].obValue),
+					   DBSTATUS_S_ISNULL == *(DBSTATUS *)(pData+prgBinding[2].obStatus) ? L"" : (WCHAR*)(pData+prgBinding[2].obValue));
+
+	hr = NOERROR;
+
+Exit:
+	if (pData)
+	{
+		CoTaskMemFree(pData);
+	}
+
+	if (DB_NULL_HACCESSOR != hAccessor)
+	{
+		pIAccessor->ReleaseAccessor(hAccessor, NULL);
+	}
+
+	if (pIAccessor)
+	{
+		pIAccessor->Release();
+	}
+
+	FreeColumnBindings(prgBinding);
+
+	if (pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	if (pIRowsetIndex)
+	{
+		pIRowsetIndex->Release();
+	}
+
+	if (pISession)
+	{
+		pISession->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeShards::ScanNames()
+//
+// Description: Read the names of every shard, one thread per shard, and
+//				pass them to pfnName in EmployeeID order.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeShards::ScanNames(PFN_SHARD_NAME pfnName, LPVOID pvContext)
+{
+	HRESULT			hr			= NOERROR;
+	SHARD_SCAN		rgScan[SHARD_MAX_SHARDS];
+	HANDLE			rghThread[SHARD_MAX_SHARDS];
+	DWORD			rgiNext[SHARD_MAX_SHARDS];			// Next name of each shard
+	DWORD			cThreads	= 0;
+	DWORD			iShard;
+	DWORD			iMin;
+
+	if (NULL == pfnName)
+	{
+		return E_INVALIDARG;
+	}
+
+	if (0 == m_cShards)
+	{
+		return E_UNEXPECTED;
+	}
+
+	for (iShard = 0; iShard < m_cShards; ++iShard)
+	{
+		rgScan[iShard].pSession	= NULL;
+		rgScan[iShard].rgNames	= NULL;
+		rgScan[iShard].cNames	= 0;
+		rgScan[iShard].hr		= NOERROR;
+		rgiNext[iShard]			= 0;
+	}
+
+	// Take a session of each shard before starting any thread
+	//
+	for (iShard = 0; iShard < m_cShards; ++iShard)
+	{
+		hr = m_rgSessionPool[iShard].CheckOut(INFINITE, &rgScan[iShard].pSession);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+	}
+
+	// Fan out
+	//
+	for (iShard = 0; iShard < m_cShards; ++iShard)
+	{
+		rghThread[cThreads] = CreateThread(NULL, 0, ScanProc, &rgScan[iShard], 0, NULL);
+		if (NULL == rghThread[cThreads])
+		{
+			hr = HRESULT_FROM_WIN32(GetLastError());
+			break;
+		}
+
+		++cThreads;
+	}
+
+	if (cThreads)
+	{
+		WaitForMultipleObjects(cThreads, rghThread, TRUE, INFINITE);
+	}
+
+	for (iShard = 0; iShard < cThreads; ++iShard)
+	{
+		CloseHandle(rghThread[iShard]);
+
+		if (SUCCEEDED(hr) && FAILED(rgScan[iShard].hr))
+		{
+			hr = rgScan[iShard].hr;
+		}
+	}
+
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Merge. The ranges don't overlap, so this takes the shards in turn,
+	// but comparing the keys keeps the order whatever the shards hold.
+	//
+	while (TRUE)
+	{
+		iMin = m_cShards;
+
+		for (iShard = 0; iShard < m_cShards; ++iShard)
+		{
+			if (rgiNext[iShard] < rgScan[iShard].cNames &&
+				(iMin == m_cShards ||
+				 rgScan[iShard].rgNames[rgiNext[iShard]].dwEmployeeID < rgScan[iMin].rgNames[rgiNext[iMin]].dwEmployeeID))
+			{
+				iMin = iShard;
+			}
+		}
+
+		if (iMin == m_cShards)
+		{
+			break;
+		}
+
+		hr = pfnName(pvContext, &rgScan[iMin].rgNames[rgiNext[iMin]++]);
+		if (FAILED(hr) || S_FALSE == hr)
+		{
+			break;
+		}
+	}
+
+	if (S_FALSE == hr)
+	{
+		hr = NOERROR;
+	}
+
+Exit:
+	for (iShard = 0; iShard < m_cShards; ++iShard)
+	{
+		if (rgScan[iShard].pSession)
+		{
+			m_rgSessionPool[iShard].CheckIn(rgScan[iShard].pSession, FAILED(rgScan[iShard].hr));
+		}
+
+		if (rgScan[iShard].rgNames)
+		{
+			CoTaskMemFree(rgScan[iShard].rgNames);
+		}
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeShards::ScanProc()
+//
+// Description: Scan one shard.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD WINAPI EmployeeShards::ScanProc(LPVOID lpParameter)
+{
+	SHARD_SCAN	*pScan	= (SHARD_SCAN*)lpParameter;
+	BOOL		fCoInit	= SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+
+	pScan->hr = ReadNames(pScan->pSession->pISession, &pScan->rgNames, &pScan->cNames);
+
+	if (fCoInit)
+	{
+		CoUninitialize();
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeShards::ReadNames()
+//
+// Description: Read the names of one shard in PK_Employees order.
+//
+// Parameters
+//		pISession	- session of the shard
+//		prgNames	- receives the names, freed with CoTaskMemFree
+//		pcNames		- receives the number of names
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeShards::ReadNames(IOpenRowset *pISession, EMPLOYEE_NAME **prgNames, DWORD *pcNames)
+{
+	HRESULT			hr					= NOERROR;
+	HRESULT			hrFetch				= NOERROR;
+	IRowset			*pIRowset			= NULL;				// Provider Interface Pointer
+	IAccessor		*pIAccessor			= NULL;				// Provider Interface Pointer
+	HACCESSOR		hAccessor			= DB_NULL_HACCESSOR;// Accessor handle
+	DBBINDING		*prgBinding			= NULL;				// Binding used to create accessor
+	DWORD			cBindings			= 0;
+	DWORD			cbRowSize			= 0;
+	BYTE			*pData				= NULL;				// Record data
+	HROW			rghRows[SHARD_SCAN_GROW_ROWS];
+	HROW			*prghRows			= rghRows;
+	ULONG			cRowsObtained		= 0;
+	EMPLOYEE_NAME	*rgNames			= NULL;
+	EMPLOYEE_NAME	*rgGrown;
+	DWORD			cNames				= 0;
+	DWORD			cMaxNames			= 0;
+
+	*prgNames	= NULL;
+	*pcNames	= 0;
+
+	hr = OpenEmployeesRowset(pISession, 0, IID_IRowset, (IUnknown**)&pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = CreateColumnBindings(pIRowset,
+							  s_rgpwszNameColumns,
+							  sizeof(s_rgpwszNameColumns)/sizeof(s_rgpwszNameColumns[0]),
+							  NULL,
+							  &prgBinding,
+							  &cBindings,
+							  &cbRowSize);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, cBindings, prgBinding, cbRowSize, &hAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	pData = (BYTE*)CoTaskMemAlloc(cbRowSize);
+	if (NULL == pData)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	while (DB_S_ENDOFROWSET != hrFetch)
+	{
+		hrFetch = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, SHARD_SCAN_GROW_ROWS, &cRowsObtained, &prghRows);
+		if (FAILED(hrFetch))
+		{
+			hr = hrFetch;
+			goto Exit;
+		}
+
+		if (0 == cRowsObtained)
+		{
+			break;
+		}
+
+		if (cNames + cRowsObtained > cMaxNames)
+		{
+			rgGrown = (EMPLOYEE_NAME*)CoTaskMemRealloc(rgNames, sizeof(EMPLOYEE_NAME)*(cMaxNames + SHARD_SCAN_GROW_ROWS));
+			if (NULL == rgGrown)
+			{
+				pIRowset->ReleaseRows(cRowsObtained, rghRows, NULL, NULL, NULL);
+				hr = E_OUTOFMEMORY;
+				goto Exit;
+			}
+
+			rgNames		= rgGrown;
+			cMaxNames  += SHARD_SCAN_GROW_ROWS;
+		}
+
+		for (ULONG iRow = 0; iRow < cRowsObtained; ++iRow)
+		{
+			memset(pData, 0, cbRowSize);
+
+			hr = pIRowset->GetData(rghRows[iRow], hAccessor, pData);
+			if (FAILED(hr))
+			{
+				break;
+			}
+
+			// Employees without an id or a complete name are not listed
+			//
+			if (DBSTATUS_S_ISNULL == *(DBSTATUS *)(pData+prgBinding[0].obStatus) ||
+				DBSTATUS_S_ISNULL == *(DBSTATUS *)(pData+prgBinding[1].obStatus) ||
+				DBSTATUS_S_ISNULL == *(DBSTATUS *)(pData+prgBinding[2].obStatus))
+			{
+				continue;
+			}
+
+			rgNames[cNames].dwEmployeeID = *(LONG*)(pData+prgBinding[0].obValue);
+			FormatEmployeeName(rgNames[cNames].wszName,
+							   SHARD_MAX_NAME,
+							   (WCHAR*)(pData+prgBinding[1].obValue),
+							   (WCHAR*)(pData+prgBinding[2].obValue));
+			++cNames;
+		}
+
+		pIRowset->ReleaseRows(cRowsObtained, rghRows, NULL, NULL, NULL);
+
+		if (FAILED(hr))
+		{
+			goto Exit;
+		}
+	}
+
+	*prgNames	= rgNames;
+	*pcNames	= cNames;
+	rgNames		= NULL;
+	hr			= NOERROR;
+
+Exit:
+	if (rgNames)
+	{
+		CoTaskMemFree(rgNames);
+	}
+
+	if (pData)
+	{
+		CoTaskMemFree(pData);
+	}
+
+	if (DB_NULL_HACCESSOR != hAccessor)
+	{
+		pIAccessor->ReleaseAccessor(hAccessor, NULL);
+	}
+
+	if (pIAccessor)
+	{
+		pIAccessor->Release();
+	}
+
+	FreeColumnBindings(prgBinding);
+
+	if (pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	return hr;
+}
@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: EmployeeShards
+//
+// File: EmployeeShards.h
+//
+// Comment: Employees split by EmployeeID range across several database files.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_EMPLOYEESHARDS_H__9D4E2B17_C6A3_4F58_8B01_E7A35D92C4F6__INCLUDED_)
+#define AFX_EMPLOYEESHARDS_H__9D4E2B17_C6A3_4F58_8B01_E7A35D92C4F6__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define SHARD_MAX_SHARDS			16
+#define SHARD_MAX_NAME				64				// LastName + ', ' + FirstName
+#define SHARD_SCAN_GROW_ROWS		64				// Name buffer growth of a shard scan
+#define SHARD_POOL_MAX_SESSIONS		2				// Sessions pooled per shard
+#define SHARD_POOL_IDLE_TIMEOUT		60000			// Milliseconds an extra session stays open
+
+////////////////////////////////////////////////////////////////////////////////
+// One database file and the EmployeeID range it stores
+//
+typedef struct tagEMPLOYEE_SHARD
+{
+	DWORD	dwFirstID;						// Lowest EmployeeID of the range
+	DWORD	dwLastID;						// Highest EmployeeID of the range, inclusive
+	LPCWSTR	pwszDatabase;					// Created with the Employees table if missing
+} EMPLOYEE_SHARD;
+
+////////////////////////////////////////////////////////////////////////////////
+// An employee name
+//
+typedef struct tagEMPLOYEE_NAME
+{
+	DWORD	dwEmployeeID;
+	WCHAR	wszName[SHARD_MAX_NAME];
+} EMPLOYEE_NAME;
+
+////////////////////////////////////////////////////////////////////////////////
+// Receives the names of a scan in EmployeeID order, on the thread that called
+// ScanNames. Returning S_FALSE ends the scan.
+//
+typedef HRESULT (CALLBACK *PFN_SHARD_NAME)(LPVOID pvContext, const EMPLOYEE_NAME *pName);
+
+////////////////////////////////////////////////////////////////////////////////
+// Keeps a connection to each shard. Requests for one employee are routed to
+// the shard of its range. Scans read every shard on its own thread, through
+// a session of the pool of the shard, and merge the results by EmployeeID.
+//
+// Writers of different shards use different files and do not wait for each
+// other.
+//
+class EmployeeShards
+{
+public:
+	EmployeeShards();
+	~EmployeeShards();
+
+	HRESULT Open(const EMPLOYEE_SHARD *rgShards, DWORD cShards);
+	void	Close();
+
+	DWORD	GetShardCount();
+	HRESULT GetShard(DWORD dwEmployeeID, DWORD *piShard);
+	HRESULT CreateSession(DWORD dwEmployeeID, REFIID riid, IUnknown **ppSession);
+
+	HRESULT LookupName(DWORD dwEmployeeID, EMPLOYEE_NAME *pName);
+	HRESULT ScanNames(PFN_SHARD_NAME pfnName, LPVOID pvContext);
+
+private:
+	static DWORD WINAPI ScanProc(LPVOID lpParameter);
+	static HRESULT ReadNames(IOpenRowset *pISession, EMPLOYEE_NAME **prgNames, DWORD *pcNames);
+
+	HRESULT OpenShard(DWORD iShard);
+
+	DWORD				m_cShards;
+	EMPLOYEE_SHARD		m_rgShard[SHARD_MAX_SHARDS];			// Sorted by dwFirstID
+	WCHAR				m_rgwszDatabase[SHARD_MAX_SHARDS][MAX_PATH];
+	IDBCreateSession	*m_rgpIDBCreateSession[SHARD_MAX_SHARDS];
+	SessionPool			m_rgSessionPool[SHARD_MAX_SHARDS];		// Sessions of the scan threads
+};
+
+#endif // !defined(AFX_EMPLOYEESHARDS_H__9D4E2B17_C6A3_4F58_8B01_E7A35D92C4F6__INCLUDED_)
@@ -0,0 +1,1373 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: EmployeeStore
+//
+// File: EmployeeStore.cpp
+//
+// Comment: Employee data access without any window.
+//
+// Functions:
+//			1. Load an employee and decode its photo into an EmployeeRecord
+//			2. Save an EmployeeRecord, conditional on its row version
+//			3. Scan the employee names
+//
+// Notes:
+//			The employees dialog binds these records to its controls through
+//			EmployeeBinder; nothing in this file needs a window, a device
+//			context or a message loop.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "ChangeLog.h"
+#include "RowVersion.h"
+#include "EmployeeSchema.h"
+#include "ResultCache.h"
+#include "AddressIndex.h"
+#include "PhotoStore.h"
+#include "SessionPool.h"
+#include "EmployeeStore.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Columns bound by the store, bound from EmployeeSchema.h once the table is
+// checked against it
+//
+static const DWORD s_rgiNameListColumns[] =	{
+												EMPLOYEE_COL_EMPLOYEE_ID,
+												EMPLOYEE_COL_LAST_NAME,
+												EMPLOYEE_COL_FIRST_NAME
+											};
+
+static const DWORD s_rgiEmployeeInfoColumns[] =	{
+													EMPLOYEE_COL_EMPLOYEE_ID,
+													EMPLOYEE_COL_ADDRESS,
+													EMPLOYEE_COL_CITY,
+													EMPLOYEE_COL_REGION,
+													EMPLOYEE_COL_POSTAL_CODE,
+													EMPLOYEE_COL_COUNTRY,
+													EMPLOYEE_COL_HOME_PHONE,
+													EMPLOYEE_COL_PHOTO,
+													EMPLOYEE_COL_ROW_VERSION
+												};
+
+#define EMPLOYEE_NAME_COLUMNS	(sizeof(s_rgiNameListColumns)/sizeof(s_rgiNameListColumns[0]))
+#define EMPLOYEE_INFO_COLUMNS	(sizeof(s_rgiEmployeeInfoColumns)/sizeof(s_rgiEmployeeInfoColumns[0]))
+#define EMPLOYEE_SAVE_COLUMNS	(EMPLOYEE_INFO_FIELDS + 1)		// The info columns but the photo and the version
+
+// LastName + ', ' + FirstName
+//
+#define EMPLOYEE_NAME_LENGTH	(sizeof(((EMPLOYEE_ROW*)0)->LastName)/sizeof(WCHAR) + sizeof(((EMPLOYEE_ROW*)0)->FirstName)/sizeof(WCHAR) + 2)
+
+// The text fields of a record are the Address to HomePhone columns, in order
+//
+typedef char EMPLOYEE_INFO_FIELDS_MATCH[(EMPLOYEE_COL_HOME_PHONE - EMPLOYEE_COL_ADDRESS + 1 == EMPLOYEE_INFO_FIELDS) ? 1 : -1];
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ReadEmployeePhoto
+//
+// Description: Read the bitmap of an employee photo BLOB.
+//
+// Parameters:
+//			pILockBytes	- Photo BLOB
+//			pbmiPhoto	- Receives the bitmap info header
+//			ppPhotoBits	- Receives the bits, freed with CoTaskMemFree
+//
+// Returns: NOERROR if succesfull, S_FALSE if not a 24 bit bitmap
+//
+// Notes: This sample only display 24 bit bitmap
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT ReadEmployeePhoto(ILockBytes *pILockBytes, BITMAPINFOHEADER *pbmiPhoto, BYTE **ppPhotoBits)
+{
+	HRESULT				hr			= NOERROR;
+	ULONG				ulRead;
+	ULARGE_INTEGER		ulStart;
+	BITMAPFILEHEADER	bmpFileHeader;
+	BYTE				*pPhotoBits	= NULL;
+
+	*ppPhotoBits = NULL;
+
+	// Read Bitmap file header
+	//
+	ulRead = 0;
+	ulStart.QuadPart = 0;
+	hr = pILockBytes->ReadAt(ulStart, &bmpFileHeader, sizeof(BITMAPFILEHEADER), &ulRead);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	if (sizeof(BITMAPFILEHEADER) != ulRead)
+	{
+		return S_FALSE;
+	}
+
+	// Read Bitmap info header
+	//
+	ulStart.QuadPart += ulRead;
+	ulRead = 0;
+	hr = pILockBytes->ReadAt(ulStart, pbmiPhoto, sizeof(BITMAPINFOHEADER), &ulRead);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	// THIS SAMPLE ONLY SUPPORT 24 BIT BITMAP
+	//
+	if (sizeof(BITMAPINFOHEADER) != ulRead || 24 != pbmiPhoto->biBitCount)
+	{
+		return S_FALSE;
+	}
+
+	// An uncompressed bitmap may leave its size to the reader
+	//
+	if (0 == pbmiPhoto->biSizeImage)
+	{
+		pbmiPhoto->biSizeImage = ROUND_UP(pbmiPhoto->biWidth * 3, sizeof(DWORD)) *
+								 (pbmiPhoto->biHeight < 0 ? -pbmiPhoto->biHeight : pbmiPhoto->biHeight);
+	}
+
+	pPhotoBits = (BYTE*)CoTaskMemAlloc(pbmiPhoto->biSizeImage);
+	if (NULL == pPhotoBits)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	// Read bitmap bits
+	//
+	ulStart.QuadPart += ulRead;
+	ulRead = 0;
+	hr = pILockBytes->ReadAt(ulStart, pPhotoBits, pbmiPhoto->biSizeImage, &ulRead);
+	if(FAILED(hr) || pbmiPhoto->biSizeImage != ulRead)
+	{
+		CoTaskMemFree(pPhotoBits);
+		return FAILED(hr) ? hr : S_FALSE;
+	}
+
+	*ppPhotoBits = pPhotoBits;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ParseEmployeePhoto
+//
+// Description: Find the bitmap of an employee photo held in memory.
+//
+// Parameters:
+//			pbPhoto		- Bitmap file of the photo
+//			cbPhoto		- Bytes of the bitmap file
+//			pbmiPhoto	- Receives the bitmap info header
+//			ppPhotoBits	- Receives the bits, in pbPhoto
+//
+// Returns: NOERROR if succesfull, S_FALSE if not a 24 bit bitmap
+//
+// Notes: The layout is the one ReadEmployeePhoto reads
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT ParseEmployeePhoto(const BYTE *pbPhoto, DWORD cbPhoto, BITMAPINFOHEADER *pbmiPhoto, const BYTE **ppPhotoBits)
+{
+	DWORD obBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
+
+	*ppPhotoBits = NULL;
+
+	if (cbPhoto < obBits)
+	{
+		return S_FALSE;
+	}
+
+	memcpy(pbmiPhoto, pbPhoto + sizeof(BITMAPFILEHEADER), sizeof(BITMAPINFOHEADER));
+
+	// THIS SAMPLE ONLY SUPPORT 24 BIT BITMAP
+	//
+	if (24 != pbmiPhoto->biBitCount)
+	{
+		return S_FALSE;
+	}
+
+	if (0 == pbmiPhoto->biSizeImage)
+	{
+		pbmiPhoto->biSizeImage = ROUND_UP(pbmiPhoto->biWidth * 3, sizeof(DWORD)) *
+								 (pbmiPhoto->biHeight < 0 ? -pbmiPhoto->biHeight : pbmiPhoto->biHeight);
+	}
+
+	if (pbmiPhoto->biSizeImage > cbPhoto - obBits)
+	{
+		return S_FALSE;
+	}
+
+	*ppPhotoBits = pbPhoto + obBits;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeRecord::EmployeeRecord()
+//
+// Description: Constructor, the record is empty
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeeRecord::EmployeeRecord() : m_pRecord(NULL)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeRecord::~EmployeeRecord()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeeRecord::~EmployeeRecord()
+{
+	Clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeRecord::Create()
+//
+// Description: Build the record of an employee. The record has no row
+//				version until SetVersion is called.
+//
+// Parameters:
+//			dwEmployeeID	- Employee
+//			rgpwszFields	- EMPLOYEE_INFO_FIELDS texts, NULL for a NULL column
+//			pbmiPhoto		- Header of the 24 bit photo, NULL if none
+//			pPhotoBits		- pbmiPhoto->biSizeImage bytes of bits
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeRecord::Create(DWORD					dwEmployeeID,
+							   LPCWSTR					*rgpwszFields,
+							   const BITMAPINFOHEADER	*pbmiPhoto,
+							   const BYTE				*pPhotoBits)
+{
+	EMPLOYEE_INFO_RECORD	*pRecord	= NULL;
+	DWORD					cbBits		= 0;
+	DWORD					cbRecord	= sizeof(EMPLOYEE_INFO_RECORD);
+	DWORD					cbField;
+	DWORD					dwIndex;
+
+	if (NULL == rgpwszFields || (pbmiPhoto && NULL == pPhotoBits))
+	{
+		return E_INVALIDARG;
+	}
+
+	for (dwIndex = 0; dwIndex < EMPLOYEE_INFO_FIELDS; ++dwIndex)
+	{
+		if (rgpwszFields[dwIndex])
+		{
+			cbRecord += sizeof(WCHAR) * (wcslen(rgpwszFields[dwIndex]) + 1);
+		}
+	}
+
+	if (pbmiPhoto)
+	{
+		cbBits		= pbmiPhoto->biSizeImage;
+		cbRecord	= ROUND_UP(cbRecord, sizeof(DWORD)) + cbBits;
+	}
+
+	pRecord = (EMPLOYEE_INFO_RECORD*)CoTaskMemAlloc(cbRecord);
+	if (NULL == pRecord)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	memset(pRecord, 0, sizeof(EMPLOYEE_INFO_RECORD));
+
+	pRecord->cbRecord		= cbRecord;
+	pRecord->dwEmployeeID	= dwEmployeeID;
+
+	cbRecord = sizeof(EMPLOYEE_INFO_RECORD);
+
+	for (dwIndex = 0; dwIndex < EMPLOYEE_INFO_FIELDS; ++dwIndex)
+	{
+		if (rgpwszFields[dwIndex])
+		{
+			cbField = sizeof(WCHAR) * (wcslen(rgpwszFields[dwIndex]) + 1);
+
+			pRecord->rgobField[dwIndex] = cbRecord;
+			memcpy((BYTE*)pRecord + cbRecord, rgpwszFields[dwIndex], cbField);
+
+			cbRecord += cbField;
+		}
+	}
+
+	if (pbmiPhoto)
+	{
+		pRecord->obPhotoBits	= ROUND_UP(cbRecord, sizeof(DWORD));
+		pRecord->bmiPhoto		= *pbmiPhoto;
+
+		memcpy((BYTE*)pRecord + pRecord->obPhotoBits, pPhotoBits, cbBits);
+	}
+
+	Attach(pRecord);
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeRecord::Clear()
+//
+// Description: Free the record.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeeRecord::Clear()
+{
+	if (m_pRecord)
+	{
+		CoTaskMemFree(m_pRecord);
+		m_pRecord = NULL;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeRecord::Swap()
+//
+// Description: Exchange two records without copying them.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeeRecord::Swap(EmployeeRecord *pOther)
+{
+	EMPLOYEE_INFO_RECORD *pRecord = m_pRecord;
+
+	m_pRecord			= pOther->m_pRecord;
+	pOther->m_pRecord	= pRecord;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeRecord::Attach()
+//
+// Description: Take over a block allocated with CoTaskMemAlloc.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeeRecord::Attach(EMPLOYEE_INFO_RECORD *pRecord)
+{
+	Clear();
+
+	m_pRecord = pRecord;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeRecord::Detach()
+//
+// Description: Hand the block over to the caller, which frees it with
+//				CoTaskMemFree. The record is empty afterwards.
+//
+////////////////////////////////////////////////////////////////////////////////
+EMPLOYEE_INFO_RECORD* EmployeeRecord::Detach()
+{
+	EMPLOYEE_INFO_RECORD *pRecord = m_pRecord;
+
+	m_pRecord = NULL;
+
+	return pRecord;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeRecord::IsEmpty()
+//
+// Description: Returns TRUE if the record holds no employee.
+//
+////////////////////////////////////////////////////////////////////////////////
+BOOL EmployeeRecord::IsEmpty() const
+{
+	return NULL == m_pRecord;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeRecord::GetEmployeeID()
+//
+// Description: Returns the EmployeeID, 0 if the record is empty.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD EmployeeRecord::GetEmployeeID() const
+{
+	return m_pRecord ? m_pRecord->dwEmployeeID : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeRecord::GetField()
+//
+// Description: Returns a text field, EMPLOYEE_INFO_*.
+//
+// Returns: NULL if the column is NULL
+//
+////////////////////////////////////////////////////////////////////////////////
+LPCWSTR EmployeeRecord::GetField(DWORD iField) const
+{
+	if (NULL == m_pRecord || iField >= EMPLOYEE_INFO_FIELDS || 0 == m_pRecord->rgobField[iField])
+	{
+		return NULL;
+	}
+
+	return (LPCWSTR)((const BYTE*)m_pRecord + m_pRecord->rgobField[iField]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeRecord::GetVersion()
+//
+// Description: Returns the row version the record was read at.
+//
+// Returns: FALSE if the record has no row version
+//
+////////////////////////////////////////////////////////////////////////////////
+BOOL EmployeeRecord::GetVersion(ULONGLONG *pullVersion) const
+{
+	if (NULL == m_pRecord || !m_pRecord->fVersion)
+	{
+		return FALSE;
+	}
+
+	*pullVersion = m_pRecord->ullVersion;
+
+	return TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeRecord::SetVersion()
+//
+// Description: Set the row version a save of the record is checked against.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeeRecord::SetVersion(BOOL fVersion, ULONGLONG ullVersion)
+{
+	if (m_pRecord)
+	{
+		m_pRecord->fVersion		= fVersion;
+		m_pRecord->ullVersion	= fVersion ? ullVersion : 0;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeRecord::GetPhoto()
+//
+// Description: Returns the header and the bits of the photo.
+//
+// Returns: NULL if the employee has no photo
+//
+////////////////////////////////////////////////////////////////////////////////
+const BITMAPINFOHEADER* EmployeeRecord::GetPhoto(const BYTE **ppPhotoBits) const
+{
+	if (NULL == m_pRecord || 0 == m_pRecord->obPhotoBits)
+	{
+		return NULL;
+	}
+
+	*ppPhotoBits = (const BYTE*)m_pRecord + m_pRecord->obPhotoBits;
+
+	return &m_pRecord->bmiPhoto;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeRecord::GetData()
+//
+// Description: Returns the block of the record, NULL if empty.
+//
+////////////////////////////////////////////////////////////////////////////////
+const EMPLOYEE_INFO_RECORD* EmployeeRecord::GetData() const
+{
+	return m_pRecord;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeStore::EmployeeStore()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeeStore::EmployeeStore() : m_pIDBCreateSession(NULL),
+								 m_pISession(NULL),
+								 m_pPooledSession(NULL)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeStore::~EmployeeStore()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeeStore::~EmployeeStore()
+{
+	Close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeStore::Open()
+//
+// Description: Use an open data source. Each call opens its own session.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeStore::Open(IDBCreateSession *pIDBCreateSession)
+{
+	if (NULL == pIDBCreateSession)
+	{
+		return E_POINTER;
+	}
+
+	Close();
+
+	m_pIDBCreateSession = pIDBCreateSession;
+	m_pIDBCreateSession->AddRef();
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeStore::Open()
+//
+// Description: Use an open session, such as one checked out of a
+//				SessionPool. Every call runs on it, so the store is used by
+//				one thread at a time.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeStore::Open(IOpenRowset *pISession)
+{
+	if (NULL == pISession)
+	{
+		return E_POINTER;
+	}
+
+	Close();
+
+	m_pISession = pISession;
+	m_pISession->AddRef();
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeStore::Open()
+//
+// Description: Use a session checked out of a SessionPool. Every call runs
+//				on it, through the rowsets and accessors the session caches.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeStore::Open(POOLED_SESSION *pSession)
+{
+	HRESULT hr;
+
+	if (NULL == pSession)
+	{
+		return E_POINTER;
+	}
+
+	hr = Open(pSession->pISession);
+	if (SUCCEEDED(hr))
+	{
+		m_pPooledSession = pSession;
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeStore::Close()
+//
+// Description: Release the data source or the session.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeeStore::Close()
+{
+	if (m_pIDBCreateSession)
+	{
+		m_pIDBCreateSession->Release();
+		m_pIDBCreateSession = NULL;
+	}
+
+	if (m_pISession)
+	{
+		m_pISession->Release();
+		m_pISession = NULL;
+	}
+
+	m_pPooledSession = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeStore::OpenSession()
+//
+// Description: Returns the session a call runs on: the session given to
+//				Open, or a new session of the data source.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeStore::OpenSession(IOpenRowset **ppIOpenRowset)
+{
+	if (m_pISession)
+	{
+		m_pISession->AddRef();
+		*ppIOpenRowset = m_pISession;
+		return NOERROR;
+	}
+
+	if (NULL == m_pIDBCreateSession)
+	{
+		return E_POINTER;
+	}
+
+	return m_pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**) ppIOpenRowset);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeStore::OpenEmployees()
+//
+// Description: Open the Employees table through PK_Employees, and an
+//				accessor on it. On a pooled session both are those the
+//				session caches: *ppIAccessor is then NULL, the accessor is
+//				not the caller's to release.
+//
+// Parameters:
+//			pIOpenRowset	- Session of the call
+//			dwOptions		- ROWSET_OPT_* flags
+//			cBindings		- Number of bindings
+//			rgBinding		- Bindings of the accessor
+//			ppIRowset		- Receives the rowset
+//			ppIAccessor		- Receives the accessor interface to release
+//			phAccessor		- Receives the accessor
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeStore::OpenEmployees(IOpenRowset		*pIOpenRowset,
+									 DWORD				dwOptions,
+									 DWORD				cBindings,
+									 const DBBINDING	*rgBinding,
+									 IRowset			**ppIRowset,
+									 IAccessor			**ppIAccessor,
+									 HACCESSOR			*phAccessor)
+{
+	HRESULT			hr;
+	POOLED_ROWSET	*pRowset;
+
+	*ppIRowset		= NULL;
+	*ppIAccessor	= NULL;
+	*phAccessor		= DB_NULL_HACCESSOR;
+
+	if (m_pPooledSession)
+	{
+		hr = g_SessionPool.GetRowset(m_pPooledSession, TABLE_EMPLOYEE, L"PK_Employees", dwOptions, &pRowset);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+
+		hr = g_SessionPool.GetAccessor(pRowset, cBindings, rgBinding, phAccessor);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+
+		*ppIRowset = pRowset->pIRowset;
+		(*ppIRowset)->AddRef();
+
+		return NOERROR;
+	}
+
+	hr = OpenEmployeesRowset(pIOpenRowset, dwOptions, IID_IRowset, (IUnknown**)ppIRowset);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	hr = (*ppIRowset)->QueryInterface(IID_IAccessor, (void**)ppIAccessor);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	return (*ppIAccessor)->CreateAccessor(DBACCESSOR_ROWDATA, cBindings, rgBinding, 0, phAccessor, NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeStore::Load()
+//
+// Description: Read an employee, from the result cache if no write touched
+//				it since it was last read.
+//
+// Parameters:
+//			dwEmployeeID	- Employee
+//			pRecord			- Receives the employee and the row version read
+//
+// Returns: NOERROR if succesfull, S_FALSE if the employee does not exist
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeStore::Load(DWORD dwEmployeeID, EmployeeRecord *pRecord)
+{
+	HRESULT				hr					= NOERROR;			// Error code reporting
+	DBBINDING			rgBinding[EMPLOYEE_INFO_COLUMNS];		// Binding used to create accessor
+	HROW				rghRows[1];								// Array of row handles obtained from the rowset object
+	HROW				*prghRows			= rghRows;			// Row handle(s) pointer
+   	ULONG				cRowsObtained		= 0;				// Number of rows obtained from the rowset object
+    DBOBJECT			dbObject;								// DBOBJECT data.
+	EMPLOYEE_ROW		Row;									// record data
+	DWORD				dwIndex				= 0;
+	ULONGLONG			ullVersion			= 0;				// Row version read
+	BOOL				fVersion			= FALSE;			// ullVersion was read
+	EMPLOYEE_INFO_RECORD *pCached			= NULL;				// Copy of the cached employee
+	DWORD				dwCacheGeneration;						// Cache generation before the read
+	LPCWSTR				rgpwszFields[EMPLOYEE_INFO_FIELDS];		// Texts read, NULL if NULL
+	BITMAPINFOHEADER	bmiPhoto;								// Photo decoded
+	BYTE				*pPhotoBits			= NULL;				// Bits read from the row
+	const BYTE			*pbPhotoBits		= NULL;				// Bits of the record, read or mapped
+	PHOTO_STORE_REF		PhotoRef;								// Photo kept in g_PhotoStore
+	PHOTO_STORE_VIEW	*pPhotoView			= NULL;
+	const BYTE			*pbPhotoFile;
+	EmployeeRecord		Record;
+
+	IOpenRowset			*pIOpenRowset		= NULL;				// Provider Interface Pointer
+	IRowset				*pIRowset			= NULL;				// Provider Interface Pointer
+	IRowsetIndex		*pIRowsetIndex		= NULL;				// Provider Interface Pointer
+	IAccessor			*pIAccessor			= NULL;				// Provider Interface Pointer
+	ILockBytes			*pILockBytes		= NULL;				// Provider Interface Pointer
+	HACCESSOR			hAccessor			= DB_NULL_HACCESSOR;// Accessor handle
+
+	if (NULL == pRecord)
+	{
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+
+	// Serve a recent read of this employee, if no write touched it since
+	//
+	if (NOERROR == g_ResultCache.Lookup(RESULT_SHAPE_EMPLOYEE_INFO, dwEmployeeID, dwEmployeeID, (void**)&pCached, NULL))
+	{
+		pRecord->Attach(pCached);
+		goto Exit;
+	}
+
+	// Taken before the row is read, see ResultCache::Store
+	//
+	dwCacheGeneration = g_ResultCache.GetGeneration();
+
+    // Create a session object, or take the one given to Open
+    //
+    hr = OpenSession(&pIOpenRowset);
+    if(FAILED(hr))
+    {
+        goto Exit;
+    }
+
+	// The bindings are those of the schema, if the table still matches it
+	//
+	hr = CheckEmployeeSchema(pIOpenRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Set up the DBOBJECT structure of the photo (BLOB)
+	//
+	dbObject.dwFlags = STGM_READ;
+	dbObject.iid	 = IID_ILockBytes;
+
+	BindEmployeeColumns(s_rgiEmployeeInfoColumns, EMPLOYEE_INFO_COLUMNS, &dbObject, rgBinding);
+
+	// Open the table using the index, and the accessor
+	//
+	hr = OpenEmployees(pIOpenRowset, ROWSET_OPT_INDEX, EMPLOYEE_INFO_COLUMNS, rgBinding, &pIRowset, &pIAccessor, &hAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->QueryInterface(IID_IRowsetIndex, (void**) &pIRowsetIndex);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+    // Set data buffer to zero
+    //
+    memset(&Row, 0, sizeof(Row));
+
+    // Set data buffer for seek operation
+    //
+	Row.cbEmployeeID		= sizeof(LONG);
+	Row.dwEmployeeIDStatus	= DBSTATUS_S_OK;
+	Row.EmployeeID			= dwEmployeeID;
+
+ 	// Position at a key value within the current range
+	//
+	hr = pIRowsetIndex->Seek(hAccessor, 1, &Row, DBSEEK_FIRSTEQ);
+	if (DB_E_NOTFOUND == hr)
+	{
+		hr = S_FALSE;
+		goto Exit;
+	}
+
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+    // Retrieve a row handle for the row resulting from the seek
+    //
+    hr = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, 1, &cRowsObtained, &prghRows);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	if (DB_S_ENDOFROWSET == hr || 0 == cRowsObtained)
+	{
+		hr = S_FALSE;
+		goto Exit;
+	}
+
+	// Fetch actual data
+	//
+	hr = pIRowset->GetData(prghRows[0], hAccessor, &Row);
+	if (SUCCEEDED(hr))
+	{
+		// Keep the version read, a save of the record applies only to it
+		//
+		fVersion = (DBSTATUS_S_OK == Row.dwRowVersionStatus);
+		if (fVersion)
+		{
+			memcpy(&ullVersion, Row.RowVersion, sizeof(ullVersion));
+		}
+
+		// If return a null value or status is not OK, ignore the contents of the value and length parts of the buffer.
+		//
+		for (dwIndex = 0; dwIndex < EMPLOYEE_INFO_FIELDS; ++dwIndex)
+		{
+			rgpwszFields[dwIndex] = NULL;
+			if (DBSTATUS_S_OK == EMPLOYEE_ROW_STATUS(&Row, EMPLOYEE_INFO_COLUMN(dwIndex)))
+			{
+				rgpwszFields[dwIndex] = (WCHAR*)EMPLOYEE_ROW_VALUE(&Row, EMPLOYEE_INFO_COLUMN(dwIndex));
+			}
+		}
+
+		// Decode the employee photo. A photo in the store is decoded in
+		// its mapping, without reading it into a buffer first.
+		//
+		if (DBSTATUS_S_OK == Row.dwPhotoStatus)
+		{
+			pILockBytes = (ILockBytes*)Row.Photo;
+
+			if (g_PhotoStore.IsOpen() && NOERROR == (hr = PhotoStore::ReadRef(pILockBytes, &PhotoRef)))
+			{
+				hr = g_PhotoStore.Read(&PhotoRef, &pPhotoView, &pbPhotoFile);
+				if (SUCCEEDED(hr))
+				{
+					hr = ParseEmployeePhoto(pbPhotoFile, PhotoRef.cbData, &bmiPhoto, &pbPhotoBits);
+				}
+			}
+			else if (SUCCEEDED(hr))
+			{
+				hr = ReadEmployeePhoto(pILockBytes, &bmiPhoto, &pPhotoBits);
+				pbPhotoBits = pPhotoBits;
+			}
+		}
+	}
+
+	// Release the rowset.
+	//
+	pIRowset->ReleaseRows(1, prghRows, NULL, NULL, NULL);
+
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = Record.Create(dwEmployeeID, rgpwszFields, pbPhotoBits ? &bmiPhoto : NULL, pbPhotoBits);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	Record.SetVersion(fVersion, ullVersion);
+
+	// Keep the decoded employee for the next time it is read
+	//
+	g_ResultCache.Store(RESULT_SHAPE_EMPLOYEE_INFO, dwEmployeeID, dwEmployeeID, Record.GetData(), Record.GetData()->cbRecord, dwCacheGeneration);
+
+	pRecord->Swap(&Record);
+
+Exit:
+	if (pPhotoBits)
+	{
+		CoTaskMemFree(pPhotoBits);
+	}
+
+	g_PhotoStore.ReleaseView(pPhotoView);
+
+	// Release interfaces
+	//
+	if(pILockBytes)
+	{
+		pILockBytes->Release();
+	}
+
+	if(pIAccessor)
+	{
+		pIAccessor->ReleaseAccessor(hAccessor, NULL);
+		pIAccessor->Release();
+	}
+
+	if(pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	if (pIRowsetIndex)
+	{
+		pIRowsetIndex->Release();
+	}
+
+	if(pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeStore::Save()
+//
+// Description: Write the text fields of an employee. If the record has a
+//				row version, the row is only written if it still has that
+//				version; the record gets the version written.
+//
+// Parameters:
+//			pRecord		- Employee to write
+//
+// Returns: NOERROR if succesfull, S_FALSE if the employee does not exist,
+//			DB_E_CONCURRENCYVIOLATION if the row changed since it was read
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeStore::Save(EmployeeRecord *pRecord)
+{
+	HRESULT				hr					= NOERROR;			// Error code reporting
+	DBBINDING			rgBinding[EMPLOYEE_SAVE_COLUMNS];		// Binding used to create accessor
+	LPCWSTR				rgpwszColumns[EMPLOYEE_SAVE_COLUMNS];	// Column names of the change log
+	HROW				rghRows[1];								// Array of row handles obtained from the rowset object
+	HROW				*prghRows			= rghRows;			// Row handle(s) pointer
+   	ULONG				cRowsObtained		= 0;				// Number of rows obtained from the rowset object
+	EMPLOYEE_ROW		Row;									// record data
+	DWORD				dwIndex				= 0;
+	EMPLOYEE_ROW		OldRow;									// record data before the change
+	ChangeLogWriter		ChangeLog;								// Change log of the update
+	DWORD				dwEmployeeID;
+	ULONGLONG			ullReadVersion;							// Row version the record was read at
+	ULONGLONG			ullVersion			= 0;				// Row version in the database
+
+	IOpenRowset			*pIOpenRowset		= NULL;				// Provider Interface Pointer
+	IRowset				*pIRowset			= NULL;				// Provider Interface Pointer
+	ITransactionLocal	*pITxnLocal			= NULL;				// Provider Interface Pointer
+    IRowsetChange		*pIRowsetChange		= NULL;
+	IRowsetIndex		*pIRowsetIndex		= NULL;				// Provider Interface Pointer
+	IAccessor			*pIAccessor			= NULL;				// Provider Interface Pointer
+	HACCESSOR			hAccessor			= DB_NULL_HACCESSOR;// Accessor handle
+
+	if (NULL == pRecord || pRecord->IsEmpty())
+	{
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+	dwEmployeeID = pRecord->GetEmployeeID();
+
+    // Create a session object, or take the one given to Open
+    //
+    hr = OpenSession(&pIOpenRowset);
+    if(FAILED(hr))
+    {
+        goto Exit;
+    }
+
+	hr = pIOpenRowset->QueryInterface(IID_ITransactionLocal, (void**)&pITxnLocal);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// The bindings are those of the schema, if the table still matches it
+	//
+	hr = CheckEmployeeSchema(pIOpenRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	BindEmployeeColumns(s_rgiEmployeeInfoColumns, EMPLOYEE_SAVE_COLUMNS, NULL, rgBinding);
+
+	// The change log names the columns as the schema does
+	//
+	for (dwIndex = 0; dwIndex < EMPLOYEE_SAVE_COLUMNS; ++dwIndex)
+	{
+		rgpwszColumns[dwIndex] = g_rgEmployeeSchema[s_rgiEmployeeInfoColumns[dwIndex]].pwszName;
+	}
+
+	// Open the table using the index, and the accessor
+	//
+	hr = OpenEmployees(pIOpenRowset,
+					   ROWSET_OPT_INDEX | ROWSET_OPT_CHANGE,
+					   EMPLOYEE_SAVE_COLUMNS,
+					   rgBinding,
+					   &pIRowset,
+					   &pIAccessor,
+					   &hAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->QueryInterface(IID_IRowsetIndex, (void**) &pIRowsetIndex);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->QueryInterface(IID_IRowsetChange, (void**)&pIRowsetChange);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Open the change log on this session, so that its entries are part
+	// of the transaction
+	//
+	hr = ChangeLog.Open(pIOpenRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+    // Set data buffer to zero
+    //
+    memset(&Row, 0, sizeof(Row));
+    memset(&OldRow, 0, sizeof(OldRow));
+
+	// Begins a new local transaction, the update and its change log
+	// entries commit together. The row read stays locked until the
+	// commit, so that its version can't change between the check and
+	// the update.
+	//
+	hr = pITxnLocal->StartTransaction(ISOLATIONLEVEL_REPEATABLEREAD, 0, NULL, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+    // Set data buffer for seek operation
+    //
+	Row.cbEmployeeID		= sizeof(LONG);
+	Row.dwEmployeeIDStatus	= DBSTATUS_S_OK;
+	Row.EmployeeID			= dwEmployeeID;
+
+	// Position at a key value within the current range
+	//
+	hr = pIRowsetIndex->Seek(hAccessor, 1, &Row, DBSEEK_FIRSTEQ);
+	if (DB_E_NOTFOUND == hr)
+	{
+		hr = S_FALSE;
+		goto Abort;
+	}
+
+	if(FAILED(hr))
+	{
+		goto Abort;
+	}
+
+    // Retrieve a row handle for the row resulting from the seek
+    //
+    hr = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, 1, &cRowsObtained, &prghRows);
+	if(FAILED(hr))
+	{
+		goto Abort;
+	}
+
+	if (DB_S_ENDOFROWSET == hr || 0 == cRowsObtained)
+	{
+		hr = S_FALSE;
+		goto Abort;
+	}
+
+	// Keep the row as it was for the change log
+	//
+	hr = pIRowset->GetData(prghRows[0], hAccessor, &OldRow);
+	if(FAILED(hr))
+	{
+		pIRowset->ReleaseRows(1, prghRows, NULL, NULL, NULL);
+		goto Abort;
+	}
+
+	// Apply the edit only to the version of the row that was read
+	//
+	hr = GetRowVersion(pIRowset, prghRows[0], &ullVersion);
+	if(FAILED(hr))
+	{
+		pIRowset->ReleaseRows(1, prghRows, NULL, NULL, NULL);
+		goto Abort;
+	}
+
+	if (NOERROR == hr && pRecord->GetVersion(&ullReadVersion) && ullVersion != ullReadVersion)
+	{
+		hr = DB_E_CONCURRENCYVIOLATION;
+		pIRowset->ReleaseRows(1, prghRows, NULL, NULL, NULL);
+		goto Abort;
+	}
+
+	// Copy the fields, cut to the column size
+	//
+	for (dwIndex = 0; dwIndex < EMPLOYEE_INFO_FIELDS; ++dwIndex)
+	{
+		SetEmployeeText(&Row, EMPLOYEE_INFO_COLUMN(dwIndex), pRecord->GetField(dwIndex));
+	}
+
+	// Set data to database
+	//
+	hr = pIRowsetChange->SetData(prghRows[0], hAccessor, &Row);
+	if(SUCCEEDED(hr))
+	{
+		// Log the columns that changed
+		//
+		hr = ChangeLog.AppendRowChanges(dwEmployeeID,
+										CHANGE_OP_UPDATE,
+										rgBinding,
+										EMPLOYEE_SAVE_COLUMNS,
+										rgpwszColumns,
+										(BYTE*)&OldRow,
+										(BYTE*)&Row);
+	}
+
+	// The next save applies to the version written here
+	//
+	if (SUCCEEDED(hr) && NOERROR != GetRowVersion(pIRowset, prghRows[0], &ullVersion))
+	{
+		ullVersion = 0;
+	}
+
+	// Release the rowset.
+	//
+	pIRowset->ReleaseRows(1, prghRows, NULL, NULL, NULL);
+
+	if(FAILED(hr))
+	{
+		goto Abort;
+	}
+
+	// Commit the transaction
+	//
+	hr = pITxnLocal->Commit(FALSE, XACTTC_SYNC, 0);
+
+	// Committed or refused as a conflict, the next load reads the row again
+	//
+	g_ResultCache.InvalidateEmployee(dwEmployeeID);
+	g_AddressIndex.MarkChanged(dwEmployeeID);
+
+	if (SUCCEEDED(hr))
+	{
+		pRecord->SetVersion(0 != ullVersion, ullVersion);
+	}
+
+	goto Exit;
+
+Abort:
+	// Abort the transaction
+	//
+	pITxnLocal->Abort(NULL, FALSE, FALSE);
+
+	if (DB_E_CONCURRENCYVIOLATION == hr)
+	{
+		g_ResultCache.InvalidateEmployee(dwEmployeeID);
+	}
+
+Exit:
+	// Release interfaces
+	//
+	ChangeLog.Close();
+
+	if(pIAccessor)
+	{
+		pIAccessor->ReleaseAccessor(hAccessor, NULL);
+		pIAccessor->Release();
+	}
+
+	if (pIRowsetChange)
+	{
+		pIRowsetChange->Release();
+	}
+
+	if (pITxnLocal)
+	{
+		pITxnLocal->Release();
+	}
+
+	if(pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	if (pIRowsetIndex)
+	{
+		pIRowsetIndex->Release();
+	}
+
+	if(pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeStore::ScanNames()
+//
+// Description: Read the names of the employees in EmployeeID order. An
+//				employee without a complete name is left out.
+//
+// Parameters:
+//			pfnName		- Receives each name
+//			pvContext	- Passed to pfnName
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeStore::ScanNames(PFN_EMPLOYEE_NAME pfnName, LPVOID pvContext)
+{
+	HRESULT					hr					= NOERROR;			// Error code reporting
+	DBBINDING				rgBinding[EMPLOYEE_NAME_COLUMNS];		// Binding used to create accessor
+	HROW				    rghRows[1];								// Array of row handles obtained from the rowset object
+	HROW*				    prghRows			= rghRows;			// Row handle(s) pointer
+   	ULONG				    cRowsObtained;							// Number of rows obtained from the rowset object
+	EMPLOYEE_ROW			Row;									// Record data
+	WCHAR					wszName[EMPLOYEE_NAME_LENGTH];			// Record employee name
+
+	IOpenRowset				*pIOpenRowset		= NULL;				// Provider Interface Pointer
+	IRowset					*pIRowset			= NULL;				// Provider Interface Pointer
+	IAccessor*			    pIAccessor			= NULL;				// Provider Interface Pointer
+	HACCESSOR			    hAccessor			= DB_NULL_HACCESSOR;// Accessor handle
+
+	if (NULL == pfnName)
+	{
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+    // Create a session object, or take the one given to Open
+    //
+    hr = OpenSession(&pIOpenRowset);
+    if(FAILED(hr))
+    {
+        goto Exit;
+    }
+
+	// The bindings are those of the schema, if the table still matches it
+	//
+	hr = CheckEmployeeSchema(pIOpenRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	BindEmployeeColumns(s_rgiNameListColumns, EMPLOYEE_NAME_COLUMNS, NULL, rgBinding);
+
+	// Open the table using the index, and the accessor
+	//
+	hr = OpenEmployees(pIOpenRowset, ROWSET_OPT_INDEX, EMPLOYEE_NAME_COLUMNS, rgBinding, &pIRowset, &pIAccessor, &hAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Retrive a row
+	//
+	hr = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, 1, &cRowsObtained, &prghRows);
+	while (SUCCEEDED(hr) && DB_S_ENDOFROWSET != hr)
+	{
+		// Set data buffer to zero
+		//
+		memset(&Row, 0, sizeof(Row));
+
+		// Fetch actual data
+		hr = pIRowset->GetData(prghRows[0], hAccessor, &Row);
+		if (FAILED(hr))
+		{
+			// Release the rowset.
+			//
+			pIRowset->ReleaseRows(1, prghRows, NULL, NULL, NULL);
+			goto Exit;
+		}
+
+		// If return a null value, ignore the contents of the value and length parts of the buffer.
+		//
+		if (DBSTATUS_S_ISNULL != Row.dwEmployeeIDStatus &&
+			DBSTATUS_S_ISNULL != Row.dwLastNameStatus &&
+			DBSTATUS_S_ISNULL != Row.dwFirstNameStatus)
+		{
+			// Combine employee last name and first name
+			//
+			wcscpy(wszName, Row.LastName);
+			wcscat(wszName, L", ");
+			wcscat(wszName, Row.FirstName);
+
+			hr = pfnName(pvContext, Row.EmployeeID, wszName);
+		}
+
+		// Release the rowset.
+		//
+		pIRowset->ReleaseRows(1, prghRows, NULL, NULL, NULL);
+
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		if (S_FALSE == hr)
+		{
+			hr = NOERROR;
+			goto Exit;
+		}
+
+		// Fetches next row.
+		hr = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, 1, &cRowsObtained, &prghRows);
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		hr = NOERROR;
+	}
+
+Exit:
+	// Release interfaces
+	//
+	if(pIAccessor)
+	{
+		pIAccessor->ReleaseAccessor(hAccessor, NULL);
+		pIAccessor->Release();
+	}
+
+	if(pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	if(pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	return hr;
+}
@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: EmployeeStore
+//
+// File: EmployeeStore.h
+//
+// Comment: Employee data access without any window.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_EMPLOYEESTORE_H__9F6A2D13_47E8_4B05_8C3E_1A7D5B92E064__INCLUDED_)
+#define AFX_EMPLOYEESTORE_H__9F6A2D13_47E8_4B05_8C3E_1A7D5B92E064__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define EMPLOYEE_MAX_FIELD				255				// Characters of a text field
+
+// Text fields of an employee record, in dialog order
+//
+#define EMPLOYEE_INFO_ADDRESS			0
+#define EMPLOYEE_INFO_CITY				1
+#define EMPLOYEE_INFO_REGION			2
+#define EMPLOYEE_INFO_POSTAL_CODE		3
+#define EMPLOYEE_INFO_COUNTRY			4
+#define EMPLOYEE_INFO_HOME_PHONE		5
+#define EMPLOYEE_INFO_FIELDS			6
+
+// Column of a text field, the Address to HomePhone columns of EmployeeSchema.h
+//
+#define EMPLOYEE_INFO_COLUMN(iField)	(EMPLOYEE_COL_ADDRESS + (iField))
+
+////////////////////////////////////////////////////////////////////////////////
+// An employee with its photo decoded to 24 bit bitmap bits. The texts and
+// the bits follow the structure in the same allocation, so a record is
+// copied, cached and handed over as one block.
+//
+typedef struct tagEMPLOYEE_INFO_RECORD
+{
+	DWORD				cbRecord;
+	DWORD				dwEmployeeID;
+	BOOL				fVersion;							// The row has a row version
+	ULONGLONG			ullVersion;
+	DWORD				rgobField[EMPLOYEE_INFO_FIELDS];	// Offset of a text, 0 if NULL
+	DWORD				obPhotoBits;						// Offset of the bits, 0 if no photo
+	BITMAPINFOHEADER	bmiPhoto;
+} EMPLOYEE_INFO_RECORD;
+
+////////////////////////////////////////////////////////////////////////////////
+// Owns one EMPLOYEE_INFO_RECORD. A record is not copied: it is handed over
+// with Swap, Attach and Detach, which move the block without copying it.
+//
+class EmployeeRecord
+{
+public:
+	EmployeeRecord();
+	~EmployeeRecord();
+
+	HRESULT Create(DWORD					dwEmployeeID,
+				   LPCWSTR					*rgpwszFields,
+				   const BITMAPINFOHEADER	*pbmiPhoto,
+				   const BYTE				*pPhotoBits);
+	void	Clear();
+
+	void	Swap(EmployeeRecord *pOther);
+	void	Attach(EMPLOYEE_INFO_RECORD *pRecord);
+	EMPLOYEE_INFO_RECORD* Detach();
+
+	BOOL	IsEmpty() const;
+	DWORD	GetEmployeeID() const;
+	LPCWSTR GetField(DWORD iField) const;
+	BOOL	GetVersion(ULONGLONG *pullVersion) const;
+	void	SetVersion(BOOL fVersion, ULONGLONG ullVersion);
+	const BITMAPINFOHEADER* GetPhoto(const BYTE **ppPhotoBits) const;
+	const EMPLOYEE_INFO_RECORD* GetData() const;
+
+private:
+	EmployeeRecord(const EmployeeRecord &);				// Not implemented, use Swap
+	EmployeeRecord& operator=(const EmployeeRecord &);	// Not implemented, use Swap
+
+	EMPLOYEE_INFO_RECORD	*m_pRecord;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Receives the employee names of a scan in EmployeeID order. Returning
+// S_FALSE ends the scan.
+//
+typedef HRESULT (CALLBACK *PFN_EMPLOYEE_NAME)(LPVOID pvContext, DWORD dwEmployeeID, LPCWSTR pwszName);
+
+////////////////////////////////////////////////////////////////////////////////
+// Reads and writes employees of the application database as EmployeeRecord
+// values. Nothing here touches a window, so the same code runs behind the
+// dialog, in a batch job or in a benchmark. Loads are served through
+// g_ResultCache; saves are conditional on the row version of the record
+// and keep the change log, the result cache and the address index current.
+//
+class EmployeeStore
+{
+public:
+	EmployeeStore();
+	~EmployeeStore();
+
+	HRESULT Open(IDBCreateSession *pIDBCreateSession);
+	HRESULT Open(IOpenRowset *pISession);
+	HRESULT Open(POOLED_SESSION *pSession);
+	void	Close();
+
+	HRESULT Load(DWORD dwEmployeeID, EmployeeRecord *pRecord);
+	HRESULT Save(EmployeeRecord *pRecord);
+	HRESULT ScanNames(PFN_EMPLOYEE_NAME pfnName, LPVOID pvContext);
+
+private:
+	HRESULT OpenSession(IOpenRowset **ppIOpenRowset);
+	HRESULT OpenEmployees(IOpenRowset		*pIOpenRowset,
+						  DWORD				dwOptions,
+						  DWORD				cBindings,
+						  const DBBINDING	*rgBinding,
+						  IRowset			**ppIRowset,
+						  IAccessor			**ppIAccessor,
+						  HACCESSOR			*phAccessor);
+
+	IDBCreateSession	*m_pIDBCreateSession;
+	IOpenRowset			*m_pISession;			// Session every call runs on, if given
+	POOLED_SESSION		*m_pPooledSession;		// Pool session of m_pISession, if given
+};
+
+#endif // !defined(AFX_EMPLOYEESTORE_H__9F6A2D13_47E8_4B05_8C3E_1A7D5B92E064__INCLUDED_)
@@ -22,18 +22,166 @@
 //			8. Insert BLOB to database using ISequentialStream 
 //			9. Load BLOB from database using ILockBytes
 //			10. Wrap employee data insertions in a transaction
+//			11. Record every mutation in the EmployeeChanges log
+//			12. Bind the dialog to the records of EmployeeStore
+//			13. Compact the database while the dialog is idle
 //
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "stdafx.h"
 #include "Employees.h"
 #include "dbcommon.h"
+#include "DbHelpers.h"
+#include "ChangeLog.h"
+#include "TemplateDatabase.h"
+#include "StartupLoader.h"
+#include "RowVersion.h"
+#include "SchemaCatalog.h"
+#include "ResultCache.h"
+#include "AddressIndex.h"
+#include "EmployeeSchema.h"
+#include "SessionPool.h"
+#include "EmployeeStore.h"
+#include "EmployeeBinder.h"
+#include "PhotoStore.h"
+#include "CompactScheduler.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // Declaration of function to handle messages for the employees dialog box
 //
 LRESULT CALLBACK EmployeesDlgProc(HWND, UINT, WPARAM, LPARAM);
 
+////////////////////////////////////////////////////////////////////////////////
+// The data source of the dialog, given up while g_CompactScheduler compacts
+// the database. Loads and saves hold the lock while they run; the scheduler
+// thread holds it only to release the connections and to put them back.
+// g_StartupLoader stores the data source it opens under it.
+//
+// A load or save that finds the connections released does not wait for the
+// compaction. It is left undone and the dialog command is posted again once
+// the connections are back.
+//
+typedef struct tagEMPLOYEES_CONNECTION
+{
+	CRITICAL_SECTION	cs;
+	IDBCreateSession	**ppIDBCreateSession;
+	BOOL				fReleased;				// Closed for a compaction
+	HWND				hWndDialog;				// Receives the deferred commands
+	BOOL				fLoadDeferred;			// IDC_COMBO_NAME LBN_SELCHANGE
+	BOOL				fSaveDeferred;			// IDC_BUTTON_SAVE BN_CLICKED
+} EMPLOYEES_CONNECTION;
+
+static EMPLOYEES_CONNECTION	g_Connection;		// Connection of the dialog
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EnterConnection
+//
+// Description: Take the connection of the dialog for a load or save, unless
+//				a compaction has it. Then the command is deferred instead.
+//
+// Parameters:
+//			pfDeferred	- Set if the connection is released
+//
+// Returns: TRUE if taken, LeaveCriticalSection gives it back
+//
+////////////////////////////////////////////////////////////////////////////////
+static BOOL EnterConnection(BOOL *pfDeferred)
+{
+	EnterCriticalSection(&g_Connection.cs);
+
+	if (!g_Connection.fReleased)
+	{
+		return TRUE;
+	}
+
+	*pfDeferred = TRUE;
+
+	LeaveCriticalSection(&g_Connection.cs);
+
+	return FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CompactConnections
+//
+// Description: PFN_COMPACT_CONNECTIONS of the dialog. Closes the data source
+//				and the photo store for the compaction and opens them again,
+//				then posts the commands deferred meanwhile. The compaction is
+//				postponed until the name list is loaded, the loader holds its
+//				own reference until then.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT CALLBACK CompactConnections(LPVOID pvContext, DWORD dwRequest)
+{
+	EMPLOYEES_CONNECTION	*pConnection		= (EMPLOYEES_CONNECTION*)pvContext;
+	IDBCreateSession		*pIDBCreateSession	= NULL;
+	STARTUP_TIMES			Times;
+	BOOL					fLoadDeferred;
+	BOOL					fSaveDeferred;
+	HRESULT					hr;
+
+	if (COMPACT_RELEASE_CONNECTIONS == dwRequest)
+	{
+		g_StartupLoader.GetTimes(&Times);
+		if (STARTUP_STAGE_PENDING == Times.rgdwStageMs[STARTUP_STAGE_ALL_NAMES])
+		{
+			return S_FALSE;
+		}
+
+		// Waits for a load or save in progress
+		//
+		EnterCriticalSection(&pConnection->cs);
+
+		g_PhotoStore.Close();
+		ReleaseDataSource(pConnection->ppIDBCreateSession);
+
+		pConnection->fReleased = TRUE;
+
+		LeaveCriticalSection(&pConnection->cs);
+
+		return NOERROR;
+	}
+
+	// Opened outside the lock, the dialog only waits for the swap
+	//
+	hr = OpenDataSource(DATABASE_NORTHWIND, &pIDBCreateSession);
+
+	EnterCriticalSection(&pConnection->cs);
+
+	*pConnection->ppIDBCreateSession = pIDBCreateSession;
+
+	g_PhotoStore.Open(DATABASE_NORTHWIND, FALSE);
+
+	fLoadDeferred = pConnection->fLoadDeferred;
+	fSaveDeferred = pConnection->fSaveDeferred;
+
+	pConnection->fReleased		= FALSE;
+	pConnection->fLoadDeferred	= FALSE;
+	pConnection->fSaveDeferred	= FALSE;
+
+	LeaveCriticalSection(&pConnection->cs);
+
+	// The edits are saved before the selection is displayed again
+	//
+	if (fSaveDeferred)
+	{
+		PostMessage(pConnection->hWndDialog,
+					WM_COMMAND,
+					MAKEWPARAM(IDC_BUTTON_SAVE, BN_CLICKED),
+					(LPARAM)GetDlgItem(pConnection->hWndDialog, IDC_BUTTON_SAVE));
+	}
+
+	if (fLoadDeferred)
+	{
+		PostMessage(pConnection->hWndDialog,
+					WM_COMMAND,
+					MAKEWPARAM(IDC_COMBO_NAME, LBN_SELCHANGE),
+					(LPARAM)GetDlgItem(pConnection->hWndDialog, IDC_COMBO_NAME));
+	}
+
+	return hr;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Function: Employees::Employees()
 //
@@ -51,6 +199,13 @@ Employees::Employees(BOOL *pSuccess) : m_hWndEmployees(NULL),
 {
 	HRESULT hr = NOERROR;
 
+	InitializeCriticalSection(&g_Connection.cs);
+	g_Connection.ppIDBCreateSession	= &m_pIDBCreateSession;
+	g_Connection.fReleased			= FALSE;
+	g_Connection.hWndDialog			= NULL;
+	g_Connection.fLoadDeferred		= FALSE;
+	g_Connection.fSaveDeferred		= FALSE;
+
 	// Initialize environment
 	//
 	hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
@@ -83,6 +238,11 @@ Employees::Employees(BOOL *pSuccess) : m_hWndEmployees(NULL),
 ////////////////////////////////////////////////////////////////////////////////
 Employees::~Employees()
 {
+	// The scheduler and the loader may still be using the data source
+	//
+	g_CompactScheduler.Stop();
+	g_StartupLoader.Stop();
+
 	// Release interfaces
 	//
 	if(m_pIDBCreateSession)
@@ -105,6 +265,8 @@ Employees::~Employees()
        DestroyWindow(m_hWndEmployees);
   	}
 
+	DeleteCriticalSection(&g_Connection.cs);
+
 	// Uninitialize the environment
 	CoUninitialize();
 }
@@ -117,17 +279,23 @@ Employees::~Employees()
 // Returns: The handle to the window
 //
 // Notes:
+//		The dialog is shown before the database is opened. The database is
+//		opened and the employee names loaded by g_StartupLoader, and the
+//		dialog displays the first employee when the first names arrive.
 //
 ////////////////////////////////////////////////////////////////////////////////
 HWND Employees::Create(HWND hWndParent, HINSTANCE hInstance)
 {
-	HRESULT hr = NOERROR;
-	RECT	rect;
-	DWORD	dwCurSel;
-	DWORD	dwEmployeeID;
+	HRESULT				hr = NOERROR;
+	RECT				rect;
+	HANDLE				hFind;							// File handle
+	WIN32_FIND_DATA		FindFileData;					// The file structure description  
+	COMPACT_SETTINGS	CompactSettings;				// Background compaction
 
 	m_hInstance = hInstance;
 
+	g_StartupLoader.Begin();
+
 	// Create the dialog window
 	//
 	GetClientRect(hWndParent, &rect);
@@ -142,50 +310,67 @@ HWND Employees::Create(HWND hWndParent, HINSTANCE hInstance)
 		return NULL;
     }
 
-	// Open a connection to database and create a session object.
+	// Display the dialog window and center it under the commandbar
 	//
-	hr = InitDatabase();
-	if (FAILED(hr))
+	MoveWindow(m_hWndEmployees, rect.left, rect.top, rect.right-rect.left,rect.bottom-rect.top, TRUE);
+	ShowWindow(m_hWndEmployees, SW_SHOW);
+	UpdateWindow(m_hWndEmployees);
+
+	g_StartupLoader.MarkStage(STARTUP_STAGE_WINDOW);
+
+	// On first run the database is cloned or created here,
+	// otherwise the loader opens it.
+	//
+	hFind = FindFirstFile(DATABASE_NORTHWIND, &FindFileData);
+	if (INVALID_HANDLE_VALUE != hFind)
 	{
-		MessageBox(NULL, L"Error - Initialize database", L"Northwind Oledb sample", MB_OK);
-		return NULL;
+		FindClose(hFind);
+	}
+	else
+	{
+		hr = InitDatabase();
+		if (FAILED(hr))
+		{
+			MessageBox(NULL, L"Error - Initialize database", L"Northwind Oledb sample", MB_OK);
+			return NULL;
+		}
 	}
 
-	// Populate combobox with employee name list.
+	// Photos are kept beside the database once a store was created for
+	// it. Without one they stay in the Photo column.
+	//
+	g_PhotoStore.Open(DATABASE_NORTHWIND, FALSE);
+
+	// Populate combobox with employee name list in the background.
 	//
-	hr = PopulateEmployeeNameList();
+	hr = g_StartupLoader.Start(m_hWndEmployees, DATABASE_NORTHWIND, &m_pIDBCreateSession, &g_Connection.cs);
 	if (FAILED(hr))
 	{	
 		MessageBox(NULL, L"Error - Retrive employee name list", L"Northwind Oledb sample", MB_OK);
 		return NULL;
 	}
 
-	// Display the dialog window and center it under the commandbar
+	// Automatic shrinking is off (DATABASE_AUTO_SHRINK_THRESHOLD), the file
+	// is compacted while the dialog is idle instead. The dialog works
+	// without it.
 	//
-	if (m_hWndEmployees)
-	{
-		MoveWindow(m_hWndEmployees, rect.left, rect.top, rect.right-rect.left,rect.bottom-rect.top, TRUE);
-		ShowWindow(m_hWndEmployees, SW_SHOW);
-		UpdateWindow(m_hWndEmployees);
-	}
+	memset(&CompactSettings, 0, sizeof(CompactSettings));
 
-	// Set current selection of employee name combobox to index 0,
-	//
-	dwCurSel = SendDlgItemMessage(m_hWndEmployees, IDC_COMBO_NAME, CB_SETCURSEL, 0, 0);
-	if (CB_ERR != dwCurSel)
-	{
-		// Retrieve current selected employee id from employee name combobox,
-		// and load other employee info.
-		//
-		dwEmployeeID = SendDlgItemMessage(m_hWndEmployees, IDC_COMBO_NAME, CB_GETITEMDATA, dwCurSel, 0);
-		hr = LoadEmployeeInfo(dwEmployeeID);
-		if (FAILED(hr))
-		{
-			MessageBox(NULL, L"Error - Update employee info", L"Northwind Oledb sample", MB_OK);
-			return NULL;
-		}
-		ShowEmployeePhoto();
-	}
+	CompactSettings.pwszDatabase		= DATABASE_NORTHWIND;
+	CompactSettings.dwFreePercent		= COMPACT_DEFAULT_FREE_PERCENT;
+	CompactSettings.dwGrowthPercent		= COMPACT_DEFAULT_GROWTH_PERCENT;
+	CompactSettings.cbMinFileSize		= COMPACT_DEFAULT_MIN_FILE_SIZE;
+	CompactSettings.dwCheckIntervalMs	= COMPACT_DEFAULT_CHECK_MS;
+	CompactSettings.dwIdleMs			= COMPACT_DEFAULT_IDLE_MS;
+	CompactSettings.dwLatencyBudgetMs	= COMPACT_DEFAULT_LATENCY_MS;
+	CompactSettings.dwThrottleMs		= COMPACT_DEFAULT_THROTTLE_MS;
+	CompactSettings.cChangeLogEntries	= COMPACT_DEFAULT_CHANGELOG_ENTRIES;
+	CompactSettings.pfnConnections		= CompactConnections;
+	CompactSettings.pvContext			= &g_Connection;
+
+	g_Connection.hWndDialog = m_hWndEmployees;
+
+	g_CompactScheduler.Start(&CompactSettings);
 
 	return m_hWndEmployees;
 }
@@ -208,13 +393,24 @@ HRESULT Employees::InitDatabase()
 	WIN32_FIND_DATA		FindFileData;					// The file structure description  
 
 	// If database exists, open it,
-	// Otherwise, create a new database, insert sample data.
+	// Otherwise, clone the template database if one was installed, or
+	// create a new database and insert sample data, the default.
 	//
 	hFind = FindFirstFile(DATABASE_NORTHWIND, &FindFileData);
 	if (INVALID_HANDLE_VALUE != hFind)
 	{
 		FindClose(hFind);
 		hr = OpenDatabase();
+		if(SUCCEEDED(hr))
+		{
+			// Databases created by earlier versions need the newer tables
+			//
+			hr = UpgradeSchema(m_pIDBCreateSession);
+		}
+	}
+	else if (NOERROR == CloneTemplateDatabase(DATABASE_NORTHWIND))
+	{
+		hr = OpenDatabase();
 	}
 	else
 	{
@@ -227,6 +423,11 @@ HRESULT Employees::InitDatabase()
 			//
 			hr = InsertEmployeeInfo();
 		}
+
+		if(SUCCEEDED(hr))
+		{
+			hr = SetSchemaVersion(m_pIDBCreateSession, DATABASE_SCHEMA_VERSION);
+		}
 	}
 
 	return hr;
@@ -336,7 +537,7 @@ HRESULT Employees::CreateDatabase()
 
 	// Create Employees table
 	//
-	hr = ExecuteSQL(pICmdText, (LPWSTR)SQL_CREATE_EMPLOYEES_TABLE);
+	hr = ExecuteSQL(pICmdText, (LPWSTR)EMPLOYEE_SCHEMA_TABLE_DDL);
 	if(FAILED(hr))
 	{
 		goto Exit;
@@ -347,12 +548,25 @@ HRESULT Employees::CreateDatabase()
 	// In your application, to improve performance, index shoule be created after 
 	// inserting initial data. 
 	//
-	hr = ExecuteSQL(pICmdText, (LPWSTR)SQL_CREATE_EMPLOYEES_INDEX);
+	hr = ExecuteSQL(pICmdText, (LPWSTR)EMPLOYEE_SCHEMA_INDEX_DDL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Create the change log table and its index
+	//
+	hr = ExecuteSQL(pICmdText, (LPWSTR)SQL_CREATE_EMPLOYEE_CHANGES_TABLE);
 	if(FAILED(hr))
 	{
 		goto Exit;
 	}
 
+	hr = ExecuteSQL(pICmdText, (LPWSTR)SQL_CREATE_EMPLOYEE_CHANGES_INDEX);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
 
 Exit:
     // Clear Variant
@@ -401,12 +615,14 @@ HRESULT Employees::OpenDatabase()
 {
     HRESULT			   	hr				= NOERROR;	// Error code reporting
 	DBPROP				dbprop[1];					// property used in property set to initialize provider
-	DBPROPSET			dbpropset[1];				// Property Set used to initialize provider
+	DBPROP				sscedbprop[1];				// SQL Server Compact specific initialization property
+	DBPROPSET			dbpropset[2];				// Property Set used to initialize provider
 
     IDBInitialize       *pIDBInitialize = NULL;		// Provider Interface Pointer
 	IDBProperties       *pIDBProperties	= NULL;		// Provider Interface Pointer
 
 	VariantInit(&dbprop[0].vValue);		
+	VariantInit(&sscedbprop[0].vValue);
 
     // Create an instance of the OLE DB Provider
 	//
@@ -432,12 +648,23 @@ HRESULT Employees::OpenDatabase()
 		goto Exit;
 	}
 
-	// Initialize the property set
+	// Leave shrinking to the compaction scheduler
+	//
+	sscedbprop[0].dwPropertyID	= DBPROP_SSCE_AUTO_SHRINK_THRESHOLD;
+	sscedbprop[0].dwOptions		= DBPROPOPTIONS_REQUIRED;
+	sscedbprop[0].vValue.vt		= VT_I4;
+	sscedbprop[0].vValue.lVal	= DATABASE_AUTO_SHRINK_THRESHOLD;
+
+	// Initialize the property sets
 	//
 	dbpropset[0].guidPropertySet = DBPROPSET_DBINIT;
 	dbpropset[0].rgProperties	 = dbprop;
 	dbpropset[0].cProperties	 = sizeof(dbprop)/sizeof(dbprop[0]);
 
+	dbpropset[1].guidPropertySet = DBPROPSET_SSCE_DBINIT;
+	dbpropset[1].rgProperties	 = sscedbprop;
+	dbpropset[1].cProperties	 = sizeof(sscedbprop)/sizeof(sscedbprop[0]);
+
 	//Set initialization properties.
 	//
 	hr = pIDBInitialize->QueryInterface(IID_IDBProperties, (void **)&pIDBProperties);
@@ -448,7 +675,7 @@ HRESULT Employees::OpenDatabase()
 
 	// Sets properties in the Data Source and initialization property groups
 	//
-    hr = pIDBProperties->SetProperties(1, dbpropset); 
+    hr = pIDBProperties->SetProperties(sizeof(dbpropset)/sizeof(dbpropset[0]), dbpropset); 
 	if(FAILED(hr))
     {
 		goto Exit;
@@ -470,6 +697,7 @@ Exit:
     // Clear Variant
     //
 	VariantClear(&dbprop[0].vValue);
+	VariantClear(&sscedbprop[0].vValue);
 
 	// Release interfaces
 	//
@@ -511,6 +739,13 @@ HRESULT Employees::ExecuteSQL(ICommandText *pICmdText, WCHAR * pwszQuery)
 
 	hr = pICmdText->Execute(NULL, IID_NULL, NULL, NULL, NULL);
 
+	// Cached column metadata is stale once the schema changed
+	//
+	if (SUCCEEDED(hr) && IsSchemaStatement(pwszQuery))
+	{
+		g_SchemaCatalog.Invalidate();
+	}
+
 Exit:
 
 	return hr;
@@ -528,7 +763,9 @@ Exit:
 HRESULT Employees::InsertEmployeeInfo()
 {
 	HRESULT				hr					= NOERROR;			// Error code reporting
-	DBBINDING			*prgBinding			= NULL;				// Binding used to create accessor
+	DBBINDING			rgBinding[EMPLOYEE_SCHEMA_WRITTEN];		// Binding used to create accessor
+	DWORD				rgiColumns[EMPLOYEE_SCHEMA_WRITTEN];
+	LPCWSTR				rgpwszColumns[EMPLOYEE_SCHEMA_WRITTEN];	// Column names of the change log
     HROW				rghRows[1]          = {DB_NULL_HROW};   // Array of row handles obtained from the rowset object
 	HROW				*prghRows			= rghRows;			// Row handle(s) pointer
 	DBID				TableID;								// Used to open/create table
@@ -537,15 +774,10 @@ HRESULT Employees::InsertEmployeeInfo()
 	DBPROP				rowsetprop[1];							// Used when opening integrated index
    	ULONG				cRowsObtained		= 0;				// Number of rows obtained from the rowset object
     DBOBJECT			dbObject;								// DBOBJECT data.
-	DBCOLUMNINFO		*pDBColumnInfo		= NULL;				// Record column metadata
-	BYTE				*pData				= NULL;				// record data
-	WCHAR				*pStringsBuffer		= NULL;
-	DWORD				dwBindingSize		= 0;
-	DWORD				dwIndex				= 0;
+	EMPLOYEE_ROW		Row;									// record data
 	DWORD				dwRow				= 0;
 	DWORD				dwCol				= 0;
-	DWORD				dwOffset			= 0;
-	ULONG				ulNumCols;
+	ChangeLogWriter		ChangeLog;								// Change log of the inserted rows
 
 	IOpenRowset			*pIOpenRowset		= NULL;				// Provider Interface Pointer
 	IRowset				*pIRowset			= NULL;				// Provider Interface Pointer
@@ -553,7 +785,6 @@ HRESULT Employees::InsertEmployeeInfo()
 	IRowsetChange		*pIRowsetChange		= NULL;				// Provider Interface Pointer
 	IAccessor			*pIAccessor			= NULL;				// Provider Interface Pointer
 	ISequentialStream	*pISequentialStream = NULL;				// Provider Interface Pointer
-	IColumnsInfo		*pIColumnsInfo		= NULL;				// Provider Interface Pointer
 	HACCESSOR			hAccessor			= DB_NULL_HACCESSOR;// Accessor handle
 
 	VariantInit(&rowsetprop[0].vValue);
@@ -623,87 +854,27 @@ HRESULT Employees::InsertEmployeeInfo()
 		goto Exit;
 	}
 
-    // Get IColumnsInfo interface
+	// The bindings are those of the schema, if the table matches it
 	//
-    hr = pIRowset->QueryInterface(IID_IColumnsInfo, (void **)&pIColumnsInfo);
+	hr = CheckEmployeeSchema(pIOpenRowset);
 	if(FAILED(hr))
 	{
 		goto Exit;
 	}
 
-	// Get the column metadata 
+	// Bind every column of the schema but the row version, the photo is
+	// written through ISequentialStream
 	//
-    hr = pIColumnsInfo->GetColumnInfo(&ulNumCols, &pDBColumnInfo, &pStringsBuffer);
-	if(FAILED(hr) || 0 == ulNumCols)
-	{
-		goto Exit;
-	}
+	dbObject.dwFlags = STGM_WRITE;
+	dbObject.iid = IID_ISequentialStream;
 
-    // Create a DBBINDING array.
-    // The binding doesn't include the bookmark column (first column).
-	//
-	dwBindingSize = ulNumCols - 1;
-	prgBinding = (DBBINDING*)CoTaskMemAlloc(sizeof(DBBINDING)*dwBindingSize);
-	if (NULL == prgBinding)
+	for (dwCol = 0; dwCol < EMPLOYEE_SCHEMA_WRITTEN; ++dwCol)
 	{
-		hr = E_OUTOFMEMORY;
-		goto Exit;
+		rgiColumns[dwCol]		= dwCol;
+		rgpwszColumns[dwCol]	= g_rgEmployeeSchema[dwCol].pwszName;
 	}
 
-	// Set initial offset for binding position
-	//
-	dwOffset = 0;
-
-	// Prepare structures to create the accessor
-	//
-    for (dwIndex = 0; dwIndex < dwBindingSize; ++dwIndex)
-    {
-		prgBinding[dwIndex].iOrdinal	= pDBColumnInfo[dwIndex + 1].iOrdinal;
-		prgBinding[dwIndex].pTypeInfo	= NULL;
-		prgBinding[dwIndex].pBindExt	= NULL;
-		prgBinding[dwIndex].dwMemOwner	= DBMEMOWNER_CLIENTOWNED;
-		prgBinding[dwIndex].dwFlags		= 0;
-		prgBinding[dwIndex].bPrecision	= pDBColumnInfo[dwIndex + 1].bPrecision;
-		prgBinding[dwIndex].bScale		= pDBColumnInfo[dwIndex + 1].bScale;
-		prgBinding[dwIndex].dwPart		= DBPART_VALUE | DBPART_STATUS | DBPART_LENGTH;
-		prgBinding[dwIndex].obLength	= dwOffset;                                     
-		prgBinding[dwIndex].obStatus	= prgBinding[dwIndex].obLength + sizeof(ULONG);  
-		prgBinding[dwIndex].obValue		= prgBinding[dwIndex].obStatus + sizeof(DBSTATUS);
-
-		switch(pDBColumnInfo[dwIndex + 1].wType)
-		{
-		case DBTYPE_BYTES:
-			// Set up the DBOBJECT structure.
-			//
-			dbObject.dwFlags = STGM_WRITE;
-			dbObject.iid = IID_ISequentialStream;
-
-			prgBinding[dwIndex].pObject		= &dbObject;
-			prgBinding[dwIndex].cbMaxLen	= sizeof(IUnknown*);
-			prgBinding[dwIndex].wType		= DBTYPE_IUNKNOWN;
-			break;
-
-		case DBTYPE_WSTR:
-			prgBinding[dwIndex].pObject		= NULL;
-			prgBinding[dwIndex].wType		= pDBColumnInfo[dwIndex + 1].wType;
-			prgBinding[dwIndex].cbMaxLen	= sizeof(WCHAR)*(pDBColumnInfo[dwIndex + 1].ulColumnSize + 1);	// Extra buffer for null terminator 
-			break;
-
-		default:
-			prgBinding[dwIndex].pObject		= NULL;
-			prgBinding[dwIndex].wType		= pDBColumnInfo[dwIndex + 1].wType;
-			prgBinding[dwIndex].cbMaxLen	= pDBColumnInfo[dwIndex + 1].ulColumnSize; 
-			break;
-		}
-
-		// Calculate new offset
-		// 
-		dwOffset = prgBinding[dwIndex].obValue + prgBinding[dwIndex].cbMaxLen;
-
-		// Properly align the offset
-		//
-		dwOffset = ROUND_UP(dwOffset, COLUMN_ALIGNVAL);
-	}
+	BindEmployeeColumns(rgiColumns, EMPLOYEE_SCHEMA_WRITTEN, &dbObject, rgBinding);
 
 	// Get IAccessor interface
 	//
@@ -716,8 +887,8 @@ HRESULT Employees::InsertEmployeeInfo()
     // Create accessor.
 	//
     hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, 
-									dwBindingSize, 
-									prgBinding,
+									EMPLOYEE_SCHEMA_WRITTEN,
+									rgBinding,
 									0,
 									&hAccessor,
 									NULL);
@@ -726,12 +897,12 @@ HRESULT Employees::InsertEmployeeInfo()
         goto Exit;
     }
 
-	// Allocate data buffer for seek and retrieve operation.
+	// Open the change log on this session, so that its entries are part
+	// of the transaction
 	//
-	pData = (BYTE*)CoTaskMemAlloc(dwOffset);
-	if (NULL == pData)
+	hr = ChangeLog.Open(pIOpenRowset);
+	if(FAILED(hr))
 	{
-		hr = E_OUTOFMEMORY;
 		goto Exit;
 	}
 
@@ -747,48 +918,32 @@ HRESULT Employees::InsertEmployeeInfo()
 	//
 	for (dwRow = 0; dwRow < sizeof(g_SampleEmployeeData)/sizeof(g_SampleEmployeeData[0]); ++dwRow)
 	{
-		DWORD	dwPhotoCol;
-		DWORD   dwInfoSize;
 		LPWSTR	lpwszInfo;
 
 		// Set data buffer to zero
 		//
-		memset(pData, 0, dwOffset);
+		memset(&Row, 0, sizeof(Row));
 
-		for (dwCol = 0; dwCol < dwBindingSize; ++dwCol)
+		// The sample values are in schema column order
+		//
+		for (dwCol = 0; dwCol < EMPLOYEE_SCHEMA_WRITTEN; ++dwCol)
 		{
 			// Get column value in string
 			//
 			lpwszInfo = g_SampleEmployeeData[dwRow].wszEmployeeInfo[dwCol];
 
-			switch(prgBinding[dwCol].wType)
+			switch(g_rgEmployeeSchema[dwCol].wBindType)
 			{
 				case DBTYPE_WSTR:
 					// Copy value to binding buffer, truncate the string if it is too long
 					//
-					dwInfoSize = prgBinding[dwCol].cbMaxLen/sizeof(WCHAR) - 1;
-					if (wcslen(lpwszInfo) >= dwInfoSize)
-					{
-						wcsncpy((WCHAR*)(pData+prgBinding[dwCol].obValue), lpwszInfo, dwInfoSize);
-						*(WCHAR*)(pData+prgBinding[dwCol].obValue+dwInfoSize*sizeof(WCHAR)) = WCHAR('\0');
-					}
-					else
-					{
-						wcscpy((WCHAR*)(pData+prgBinding[dwCol].obValue), lpwszInfo);
-					}
-
-					*(ULONG*)(pData+prgBinding[dwCol].obLength)		= wcslen((WCHAR*)(pData+prgBinding[dwCol].obValue))*sizeof(WCHAR);
-					*(DBSTATUS*)(pData+prgBinding[dwCol].obStatus)	= DBSTATUS_S_OK;
-					break;
-
-				case DBTYPE_IUNKNOWN:
-					dwPhotoCol = dwCol;
+					SetEmployeeText(&Row, dwCol, lpwszInfo);
 					break;
 
 				case DBTYPE_I4:
-					*(int*)(pData+prgBinding[dwCol].obValue)		= _wtoi(g_SampleEmployeeData[dwRow].wszEmployeeInfo[dwCol]);
-					*(ULONG*)(pData+prgBinding[dwCol].obLength)		= 4;
-					*(DBSTATUS*)(pData+prgBinding[dwCol].obStatus)	= DBSTATUS_S_OK;
+					*(LONG*)EMPLOYEE_ROW_VALUE(&Row, dwCol)	= _wtoi(lpwszInfo);
+					EMPLOYEE_ROW_LENGTH(&Row, dwCol)		= sizeof(LONG);
+					EMPLOYEE_ROW_STATUS(&Row, dwCol)		= DBSTATUS_S_OK;
 					break;
 
 				default:
@@ -798,7 +953,21 @@ HRESULT Employees::InsertEmployeeInfo()
 
 		// Insert data to database
 		//
-		hr = pIRowsetChange->InsertRow(DB_NULL_HCHAPTER, hAccessor, pData, prghRows);
+		hr = pIRowsetChange->InsertRow(DB_NULL_HCHAPTER, hAccessor, &Row, prghRows);
+		if (FAILED(hr))
+		{
+			goto Abort;
+		}
+
+		// Log the inserted values
+		//
+		hr = ChangeLog.AppendRowChanges(Row.EmployeeID,
+										CHANGE_OP_INSERT,
+										rgBinding,
+										EMPLOYEE_SCHEMA_WRITTEN,
+										rgpwszColumns,
+										NULL,
+										(BYTE*)&Row);
 		if (FAILED(hr))
 		{
 			goto Abort;
@@ -806,7 +975,7 @@ HRESULT Employees::InsertEmployeeInfo()
 
 		// Get the row data
 		//
-		hr = pIRowset->GetData(rghRows[0], hAccessor, pData);
+		hr = pIRowset->GetData(rghRows[0], hAccessor, &Row);
         if(FAILED(hr))
         {
 			goto Abort;
@@ -814,7 +983,7 @@ HRESULT Employees::InsertEmployeeInfo()
 
         // Check the status
         //
-        if (DBSTATUS_S_OK != *(DBSTATUS*)(pData+prgBinding[dwPhotoCol].obStatus))
+        if (DBSTATUS_S_OK != Row.dwPhotoStatus)
         {
             hr = E_FAIL;
 			goto Abort;
@@ -822,7 +991,7 @@ HRESULT Employees::InsertEmployeeInfo()
 
 		// Insert photo into database through ISequentialStream
 		//
-		pISequentialStream = (*(ISequentialStream**) (pData + prgBinding[dwPhotoCol].obValue));
+		pISequentialStream = (ISequentialStream*)Row.Photo;
 		if (pISequentialStream)
 		{
 			// Insert photo
@@ -863,6 +1032,11 @@ HRESULT Employees::InsertEmployeeInfo()
 		pITxnLocal->Commit(FALSE, XACTTC_SYNC, 0);
 	}
 
+	// Results read before the sample rows were loaded are stale
+	//
+	g_ResultCache.InvalidateAll();
+	g_AddressIndex.MarkAllChanged();
+
 	goto Exit;
 
 Abort:
@@ -883,38 +1057,6 @@ Exit:
     //
 	VariantClear(&rowsetprop[0].vValue);
 
-    // Free allocated DBBinding memory
-    //
-    if (prgBinding)
-    {
-        CoTaskMemFree(prgBinding);
-        prgBinding = NULL;
-    }
-
-    // Free allocated column info memory
-    //
-    if (pDBColumnInfo)
-    {
-        CoTaskMemFree(pDBColumnInfo);
-        pDBColumnInfo = NULL;
-    }
-	
-	// Free allocated column string values buffer
-    //
-    if (pStringsBuffer)
-    {
-        CoTaskMemFree(pStringsBuffer);
-        pStringsBuffer = NULL;
-    }
-
-    // Free data record buffer
-    //
-	if (pData)
-	{
-        CoTaskMemFree(pData);
-		pData = NULL;
-	}
-
 	// Release interfaces
 	//
     if(pISequentialStream)
@@ -922,17 +1064,14 @@ Exit:
 		pISequentialStream->Release();
     }
 
+	ChangeLog.Close();
+
 	if(pIAccessor)
 	{
 		pIAccessor->ReleaseAccessor(hAccessor, NULL); 
 		pIAccessor->Release();
 	}
 
-	if (pIColumnsInfo)
-	{
-		pIColumnsInfo->Release();
-	}
-
 	if (pIRowsetChange)
 	{
 		pIRowsetChange->Release();
@@ -963,7 +1102,8 @@ Exit:
 //
 // Returns: NOERROR if succesfull
 //
-// Notes:
+// Notes: With g_PhotoStore open the photo is appended to the store and
+//		  the stream gets its reference.
 //
 ////////////////////////////////////////////////////////////////////////////////
 HRESULT Employees::SaveEmployeePhoto(ISequentialStream* pISequentialStream, DWORD dwPhotoID)
@@ -974,6 +1114,7 @@ HRESULT Employees::SaveEmployeePhoto(ISequentialStream* pISequentialStream, DWOR
 	BYTE	*pPhotoData = NULL;
 	DWORD	dwSize;
 	DWORD	dwWritten;
+	PHOTO_STORE_REF	PhotoRef;
 
 	// Determine the location of the employee photo resource 
 	//
@@ -1008,6 +1149,20 @@ HRESULT Employees::SaveEmployeePhoto(ISequentialStream* pISequentialStream, DWOR
 		goto Exit;
 	}
 
+	// Keep the photo in the store, the row refers to it
+	//
+	if (g_PhotoStore.IsOpen())
+	{
+		hr = g_PhotoStore.Append(pPhotoData, dwSize, &PhotoRef);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		pPhotoData	= (BYTE*)&PhotoRef;
+		dwSize		= sizeof(PhotoRef);
+	}
+
 	// Write the photo data into the stream object 
 	//
 	hr = pISequentialStream->Write(pPhotoData, dwSize, &dwWritten);
@@ -1040,734 +1195,80 @@ Exit:
 ////////////////////////////////////////////////////////////////////////////////
 HRESULT Employees::PopulateEmployeeNameList()
 {
-	HRESULT					hr					= NOERROR;			// Error code reporting
-	DBID				    TableID;								// Used to open/create table
-	DBID				    IndexID;								// Used to open/create index
-	DBPROPSET			    rowsetpropset[1];						// Used when opening integrated index
-	DBPROP				    rowsetprop[1];							// Used when opening integrated index
-	DBBINDING				*prgBinding			= NULL;				// Binding used to create accessor
-	HROW				    rghRows[1];								// Array of row handles obtained from the rowset object
-	HROW*				    prghRows			= rghRows;			// Row handle(s) pointer
-   	ULONG				    cRowsObtained;							// Number of rows obtained from the rowset object
-	BYTE					*pData				= NULL;				// Record data
-	DBCOLUMNINFO			*pDBColumnInfo		= NULL;				// Record column metadata
-	WCHAR					*pwszName			= NULL;				// Record employee name
-	DWORD					dwIndex				= 0;
-	DWORD					dwOffset			= 0;
-	DWORD					dwBindingSize		= 0;
-	DWORD					dwOrdinal			= 0;
-	ULONG					ulNumCols			= 0;
-	WCHAR					*pStringsBuffer		= NULL;
-
-	IOpenRowset				*pIOpenRowset		= NULL;				// Provider Interface Pointer
-	IRowset					*pIRowset			= NULL;				// Provider Interface Pointer
-	IColumnsInfo			*pIColumnsInfo		= NULL;				// Provider Interface Pointer
-	IAccessor*			    pIAccessor			= NULL;				// Provider Interface Pointer
-	HACCESSOR			    hAccessor			= DB_NULL_HACCESSOR;// Accessor handle
-
-	WCHAR*					pwszEmployees[]		=	{				// Info to retrieve employee names
-														L"EmployeeID",
-														L"LastName", 
-														L"FirstName"
-													 };
-
-    VariantInit(&rowsetprop[0].vValue);
+	HRESULT			hr		= NOERROR;			// Error code reporting
+	EmployeeStore	Store;						// Employee data access
 
-	// Validate IDBCreateSession interface
-	//
-	if (NULL == m_pIDBCreateSession)
+	hr = Store.Open(m_pIDBCreateSession);
+	if(FAILED(hr))
 	{
-		hr = E_POINTER;
-		goto Exit;
+		return hr;
 	}
 
-    // Create a session object 
-    //
-    hr = m_pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**) &pIOpenRowset);
-    if(FAILED(hr))
-    {
-        goto Exit;
-    }
-
-	// Set up information necessary to open a table 
-	// using an index and have the ability to seek.
-	//
-	TableID.eKind			= DBKIND_NAME;
-	TableID.uName.pwszName	= (WCHAR*)TABLE_EMPLOYEE;
-
-	IndexID.eKind			= DBKIND_NAME;
-	IndexID.uName.pwszName	= L"PK_Employees";
-
-	// Request ability to use IRowsetIndex interface
-	rowsetpropset[0].cProperties	= 1;
-	rowsetpropset[0].guidPropertySet= DBPROPSET_ROWSET;
-	rowsetpropset[0].rgProperties	= rowsetprop;
+	return Store.ScanNames(AddEmployeeName, m_hWndEmployees);
+}
 
-	rowsetprop[0].dwPropertyID		= DBPROP_IRowsetIndex;
-	rowsetprop[0].dwOptions			= DBPROPOPTIONS_REQUIRED;
-	rowsetprop[0].colid				= DB_NULLID;
-	rowsetprop[0].vValue.vt			= VT_BOOL;
-	rowsetprop[0].vValue.boolVal	= VARIANT_TRUE;
+////////////////////////////////////////////////////////////////////////////////
+// Function: LoadEmployeeInfo()
+//
+// Description: Update employee info based on employee id.
+//
+// Returns: NOERROR if succesfull
+//
+// Notes:
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT Employees::LoadEmployeeInfo(DWORD dwEmployeeID)
+{
+	HRESULT			hr		= NOERROR;			// Error code reporting
+	EmployeeStore	Store;						// Employee data access
+	EmployeeRecord	Record;						// Employee read
+	ULONGLONG		ullVersion;					// Row version read
+	DWORD			dwStartMs;					// Start of the database work
 
-	// Open the table using the index
+	// Loaded again once a compaction in progress is over
 	//
-	hr = pIOpenRowset->OpenRowset(NULL, 
-								  &TableID, 
-								  &IndexID, 
-								  IID_IRowset, 
-								  sizeof(rowsetpropset)/sizeof(rowsetpropset[0]),
-								  rowsetpropset, 
-								  (IUnknown**)&pIRowset);
-	if(FAILED(hr))
+	if (!EnterConnection(&g_Connection.fLoadDeferred))
 	{
-		goto Exit;
+		return S_FALSE;
 	}
 
-    // Get IColumnsInfo interface
-	//
-    hr = pIRowset->QueryInterface(IID_IColumnsInfo, (void **)&pIColumnsInfo);
-	if(FAILED(hr))
+	dwStartMs = GetTickCount();
+
+	hr = Store.Open(m_pIDBCreateSession);
+	if(SUCCEEDED(hr))
 	{
-		goto Exit;
+		hr = Store.Load(dwEmployeeID, &Record);
 	}
 
-	// Get the column metadata 
-	//
-    hr = pIColumnsInfo->GetColumnInfo(&ulNumCols, &pDBColumnInfo, &pStringsBuffer);
-	if(FAILED(hr) || 0 == ulNumCols)
+	Store.Close();
+
+	LeaveCriticalSection(&g_Connection.cs);
+
+	g_CompactScheduler.NoteForegroundActivity(GetTickCount() - dwStartMs);
+
+	if (NOERROR != hr)
 	{
-		goto Exit;
+		return hr;
 	}
 
-    // Create a DBBINDING array.
+	// A save applies only to the version displayed
 	//
-	dwBindingSize = sizeof(pwszEmployees)/sizeof(pwszEmployees[0]);
-	prgBinding = (DBBINDING*)CoTaskMemAlloc(sizeof(DBBINDING)*dwBindingSize);
-	if (NULL == prgBinding)
+	if (Record.GetVersion(&ullVersion))
 	{
-		hr = E_OUTOFMEMORY;
-		goto Exit;
+		g_RowVersions.Remember(dwEmployeeID, ullVersion);
+	}
+	else
+	{
+		g_RowVersions.Forget(dwEmployeeID);
 	}
 
-	// Set initial offset for binding position
-	//
-	dwOffset = 0;
+	ClearEmployeeInfo();
 
-	// Prepare structures to create the accessor
-	//
-    for (dwIndex = 0; dwIndex < dwBindingSize; ++dwIndex)
-    {
-		if (!GetColumnOrdinal(pDBColumnInfo, ulNumCols, pwszEmployees[dwIndex], &dwOrdinal))
-		{
-			hr = E_FAIL;
-			goto Exit;
-		}
+	ShowEmployeeRecord(m_hWndEmployees, &Record);
 
-		prgBinding[dwIndex].iOrdinal	= dwOrdinal;
-		prgBinding[dwIndex].dwPart		= DBPART_VALUE | DBPART_STATUS | DBPART_LENGTH;
-		prgBinding[dwIndex].obLength	= dwOffset;                                     
-		prgBinding[dwIndex].obStatus	= prgBinding[dwIndex].obLength + sizeof(ULONG);  
-		prgBinding[dwIndex].obValue		= prgBinding[dwIndex].obStatus + sizeof(DBSTATUS);
-		prgBinding[dwIndex].wType		= pDBColumnInfo[dwOrdinal].wType;
-		prgBinding[dwIndex].pTypeInfo	= NULL;
-		prgBinding[dwIndex].pObject		= NULL;
-		prgBinding[dwIndex].pBindExt	= NULL;
-		prgBinding[dwIndex].dwMemOwner	= DBMEMOWNER_CLIENTOWNED;
-		prgBinding[dwIndex].dwFlags		= 0;
-		prgBinding[dwIndex].bPrecision	= pDBColumnInfo[dwOrdinal].bPrecision;
-		prgBinding[dwIndex].bScale		= pDBColumnInfo[dwOrdinal].bScale;
-
-		switch(prgBinding[dwIndex].wType)
-		{
-		case DBTYPE_WSTR:		
-			prgBinding[dwIndex].cbMaxLen = sizeof(WCHAR)*(pDBColumnInfo[dwOrdinal].ulColumnSize + 1);	// Extra buffer for null terminator 
-			break;
-		default:
-			prgBinding[dwIndex].cbMaxLen = pDBColumnInfo[dwOrdinal].ulColumnSize; 
-			break;
-		}
+	m_hBitmap = CreateEmployeePhoto(m_hWndEmployees, &Record);
 
-		// Calculate the offset, and properly align it
-		// 
-		dwOffset = prgBinding[dwIndex].obValue + prgBinding[dwIndex].cbMaxLen;
-		dwOffset = ROUND_UP(dwOffset, COLUMN_ALIGNVAL);
-	}
-
-	// Get IAccessor 
-	//
-	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
-	if(FAILED(hr))
-	{
-		goto Exit;
-	}
-
-	// Create the accessor
-	//
-	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, 
-									dwBindingSize, 
-									prgBinding, 
-									0, 
-									&hAccessor, 
-									NULL);
-	if(FAILED(hr))
-	{
-		goto Exit;
-	}
-
-	// Allocate data buffer.
-	//
-	pData = (BYTE*)CoTaskMemAlloc(dwOffset);
-	if (NULL == pData)
-	{
-		hr = E_OUTOFMEMORY;
-		goto Exit;
-	}
-
-	// Allocate a memory big enough to held employee name
-	// LastName + ', ' + FirstName
-	//
-	pwszName = (WCHAR*)CoTaskMemAlloc(prgBinding[1].cbMaxLen + prgBinding[2].cbMaxLen + 2);
-	if (NULL == pwszName)
-	{
-		hr = E_OUTOFMEMORY;
-		goto Exit;
-	}
-
-	// Retrive a row
-	//
-	hr = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, 1, &cRowsObtained, &prghRows);
-	while (SUCCEEDED(hr) && DB_S_ENDOFROWSET != hr)
-	{
-		// Set data buffer to zero
-		//
-		memset(pData, 0, dwOffset);
-
-		// Fetch actual data
-		hr = pIRowset->GetData(prghRows[0], hAccessor, pData);
-		if (FAILED(hr))
-		{
-			// Release the rowset.
-			//
-			pIRowset->ReleaseRows(1, prghRows, NULL, NULL, NULL);
-			goto Exit;
-		}
-
-		// If return a null value, ignore the contents of the value and length parts of the buffer.
-		//
-		if (DBSTATUS_S_ISNULL != *(DBSTATUS *)(pData+prgBinding[0].obStatus))
-		{
-			// If return a null value, ignore the contents of the value and length parts of the buffer.
-			//
-			if (DBSTATUS_S_ISNULL != *(DBSTATUS *)(pData+prgBinding[1].obStatus) && 
-				DBSTATUS_S_ISNULL != *(DBSTATUS *)(pData+prgBinding[2].obStatus))
-			{
-				// Combine employee last name and first name
-				//
-				wcscpy(pwszName, (WCHAR*)(pData+prgBinding[1].obValue));
-				wcscat(pwszName, L", ");
-				wcscat(pwszName, (WCHAR*)(pData+prgBinding[2].obValue));
-
-				// Add new item into combobox
-				//
-				dwIndex = SendDlgItemMessage(m_hWndEmployees, IDC_COMBO_NAME, CB_ADDSTRING, 0, (LPARAM)pwszName);
-				if (CB_ERR != dwIndex)
-				{
-					// Set item assocaited data to employee id.
-					SendDlgItemMessage(	m_hWndEmployees, 
-										IDC_COMBO_NAME, 
-										CB_SETITEMDATA, 
-										dwIndex, 
-										*(LONG*)(pData+prgBinding[0].obValue));
-				}
-			}
-		}
-
-		// Release the rowset.
-		//
-		hr = pIRowset->ReleaseRows(1, prghRows, NULL, NULL, NULL);
-		if(FAILED(hr))
-		{
-			goto Exit;
-		}
-
-
-		// Fetches next row.
-		hr = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, 1, &cRowsObtained, &prghRows);
-	}
-
-Exit:
-    // Clear Variants
-    //
-	VariantClear(&rowsetprop[0].vValue);
-
-  
-
-    // Free allocated DBBinding memory
-    //
-    if (prgBinding)
-    {
-        CoTaskMemFree(prgBinding);
-        prgBinding = NULL;
-    }
-
-    // Free allocated column info memory
-    //
-    if (pDBColumnInfo)
-    {
-        CoTaskMemFree(pDBColumnInfo);
-        pDBColumnInfo = NULL;
-    }
-	
-	// Free allocated column string values buffer
-    //
-    if (pStringsBuffer)
-    {
-        CoTaskMemFree(pStringsBuffer);
-        pStringsBuffer = NULL;
-    }
-
-    // Free data record buffer
-    //
-	if (pData)
-	{
-        CoTaskMemFree(pData);
-		pData = NULL;
-	}
-
-    // Free employee name buffer
-    //
-	if (pwszName)
-	{
-		CoTaskMemFree(pwszName);
-		pwszName = NULL;
-	}
-
-	// Release interfaces
-	//
-	if(pIAccessor)
-	{
-		pIAccessor->ReleaseAccessor(hAccessor, NULL); 
-		pIAccessor->Release();
-	}
-
-	if (pIColumnsInfo)
-	{
-		pIColumnsInfo->Release();
-	}
-
-	if(pIRowset)
-	{
-		pIRowset->Release();
-	}
-
-	if(pIOpenRowset)
-	{
-		pIOpenRowset->Release();
-	}
-
-	return hr;
-}
-
-////////////////////////////////////////////////////////////////////////////////
-// Function: LoadEmployeeInfo()
-//
-// Description: Update employee info based on employee id.
-//
-// Returns: NOERROR if succesfull
-//
-// Notes:
-//
-////////////////////////////////////////////////////////////////////////////////
-HRESULT Employees::LoadEmployeeInfo(DWORD dwEmployeeID)
-{
-	HRESULT				hr					= NOERROR;			// Error code reporting
-	DBBINDING			*prgBinding			= NULL;				// Binding used to create accessor
-	HROW				rghRows[1];								// Array of row handles obtained from the rowset object
-	HROW				*prghRows			= rghRows;			// Row handle(s) pointer
-	DBID				TableID;								// Used to open/create table
-	DBID				IndexID;								// Used to create index
-	DBPROPSET			rowsetpropset[1];						// Used when opening integrated index
-	DBPROP				rowsetprop[1];							// Used when opening integrated index
-   	ULONG				cRowsObtained		= 0;				// Number of rows obtained from the rowset object
-    DBOBJECT			dbObject;								// DBOBJECT data.
-	DBCOLUMNINFO		*pDBColumnInfo		= NULL;				// Record column metadata
-	BYTE				*pData				= NULL;				// record data
-	WCHAR				*pStringsBuffer		= NULL;
-	DWORD				dwBindingSize		= 0;
-	DWORD				dwIndex				= 0;
-	DWORD				dwOffset			= 0;
-	DWORD				dwOrdinal			= 0;
-	ULONG				ulNumCols;
-
-	IOpenRowset			*pIOpenRowset		= NULL;				// Provider Interface Pointer
-	IRowset				*pIRowset			= NULL;				// Provider Interface Pointer
-	IRowsetIndex		*pIRowsetIndex		= NULL;				// Provider Interface Pointer
-	IAccessor			*pIAccessor			= NULL;				// Provider Interface Pointer
-	ILockBytes			*pILockBytes		= NULL;				// Provider Interface Pointer
-	IColumnsInfo		*pIColumnsInfo		= NULL;				// Provider Interface Pointer
-	HACCESSOR			hAccessor			= DB_NULL_HACCESSOR;// Accessor handle
-
-	WCHAR*				pwszEmployees[]		=	{						// Employee info Column names
-													L"EmployeeID",
-													L"Address",
-													L"City",   
-													L"Region", 
-													L"PostalCode",
-													L"Country", 
-													L"HomePhone",
-													L"Photo"	
-												};
-	
-	VariantInit(&rowsetprop[0].vValue);
-
-	// Validate IDBCreateSession interface
-	//
-	if (NULL == m_pIDBCreateSession)
-	{
-		hr = E_POINTER;
-		goto Exit;
-	}
-
-    // Create a session object 
-    //
-    hr = m_pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**) &pIOpenRowset);
-    if(FAILED(hr))
-    {
-        goto Exit;
-    }
-
-	// Set up information necessary to open a table 
-	// using an index and have the ability to seek.
-	//
-	TableID.eKind			= DBKIND_NAME;
-	TableID.uName.pwszName	= (WCHAR*)TABLE_EMPLOYEE;
-
-	IndexID.eKind			= DBKIND_NAME;
-	IndexID.uName.pwszName	= L"PK_Employees";
-
-	// Request ability to use IRowsetChange interface
-	// 
-	rowsetpropset[0].cProperties	= 1;
-	rowsetpropset[0].guidPropertySet= DBPROPSET_ROWSET;
-	rowsetpropset[0].rgProperties	= rowsetprop;
-
-	rowsetprop[0].dwPropertyID		= DBPROP_IRowsetIndex;
-	rowsetprop[0].dwOptions			= DBPROPOPTIONS_REQUIRED;
-	rowsetprop[0].colid				= DB_NULLID;
-	rowsetprop[0].vValue.vt			= VT_BOOL;
-	rowsetprop[0].vValue.boolVal	= VARIANT_TRUE;
-
-	// Open the table using the index
-	//
-	hr = pIOpenRowset->OpenRowset(	NULL,
-									&TableID,
-									&IndexID,
-									IID_IRowsetIndex,
-									sizeof(rowsetpropset)/sizeof(rowsetpropset[0]),
-									rowsetpropset,
-									(IUnknown**) &pIRowsetIndex);
-	if(FAILED(hr))
-	{
-		goto Exit;
-	}
-
-    // Get IRowset interface
-	//
-	hr = pIRowsetIndex->QueryInterface(IID_IRowset, (void**) &pIRowset);
-	if(FAILED(hr))
-	{
-		goto Exit;
-	}
-
-    // Get IColumnsInfo interface
-	//
-    hr = pIRowset->QueryInterface(IID_IColumnsInfo, (void **)&pIColumnsInfo);
-	if(FAILED(hr))
-	{
-		goto Exit;
-	}
-
-	// Get the column metadata 
-	//
-    hr = pIColumnsInfo->GetColumnInfo(&ulNumCols, &pDBColumnInfo, &pStringsBuffer);
-	if(FAILED(hr) || 0 == ulNumCols)
-	{
-		goto Exit;
-	}
-
-    // Create a DBBINDING array.
-	//
-	dwBindingSize = sizeof(pwszEmployees)/sizeof(pwszEmployees[0]);
-	prgBinding = (DBBINDING*)CoTaskMemAlloc(sizeof(DBBINDING)*dwBindingSize);
-	if (NULL == prgBinding)
-	{
-		hr = E_OUTOFMEMORY;
-		goto Exit;
-	}
-
-	// Set initial offset for binding position
-	//
-	dwOffset = 0;
-
-	// Prepare structures to create the accessor
-	//
-    for (dwIndex = 0; dwIndex < dwBindingSize; ++dwIndex)
-    {
-		if (!GetColumnOrdinal(pDBColumnInfo, ulNumCols, pwszEmployees[dwIndex], &dwOrdinal))
-		{
-			hr = E_FAIL;
-			goto Exit;
-		}
-
-		// Prepare structures to create the accessor
-		//
-		prgBinding[dwIndex].iOrdinal	= dwOrdinal;
-		prgBinding[dwIndex].dwPart		= DBPART_VALUE | DBPART_STATUS | DBPART_LENGTH;
-		prgBinding[dwIndex].obLength	= dwOffset;                                     
-		prgBinding[dwIndex].obStatus	= prgBinding[dwIndex].obLength + sizeof(ULONG);  
-		prgBinding[dwIndex].obValue		= prgBinding[dwIndex].obStatus + sizeof(DBSTATUS);
-		prgBinding[dwIndex].pTypeInfo	= NULL;
-		prgBinding[dwIndex].pBindExt	= NULL;
-		prgBinding[dwIndex].dwMemOwner	= DBMEMOWNER_CLIENTOWNED;
-		prgBinding[dwIndex].dwFlags		= 0;
-		prgBinding[dwIndex].bPrecision	= pDBColumnInfo[dwOrdinal].bPrecision;
-		prgBinding[dwIndex].bScale		= pDBColumnInfo[dwOrdinal].bScale;
-
-		switch(pDBColumnInfo[dwOrdinal].wType)
-		{
-		case DBTYPE_BYTES:		// Column "Photo" binding (BLOB) 
-			// Set up the DBOBJECT structure.
-			//
-			dbObject.dwFlags = STGM_READ;
-			dbObject.iid	 = IID_ILockBytes;
-
-			prgBinding[dwIndex].pObject		= &dbObject;
-			prgBinding[dwIndex].cbMaxLen	= sizeof(IUnknown*);
-			prgBinding[dwIndex].wType		= DBTYPE_IUNKNOWN;
-			break;
-
-		case DBTYPE_WSTR:
-			prgBinding[dwIndex].pObject		= NULL;
-			prgBinding[dwIndex].wType		= pDBColumnInfo[dwOrdinal].wType;
-			prgBinding[dwIndex].cbMaxLen	= sizeof(WCHAR)*(pDBColumnInfo[dwOrdinal].ulColumnSize + 1);	// Extra buffer for null terminator 
-			break;
-
-		default:
-			prgBinding[dwIndex].pObject		= NULL;
-			prgBinding[dwIndex].wType		= pDBColumnInfo[dwOrdinal].wType;
-			prgBinding[dwIndex].cbMaxLen	= pDBColumnInfo[dwOrdinal].ulColumnSize; 
-			break;
-		}
-
-		// Calculate new offset
-		// 
-		dwOffset = prgBinding[dwIndex].obValue + prgBinding[dwIndex].cbMaxLen;
-
-		// Properly align the offset
-		//
-		dwOffset = ROUND_UP(dwOffset, COLUMN_ALIGNVAL);
-	}
-
-	// Get IAccessor interface
-	//
-	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
-	if(FAILED(hr))
-	{
-		goto Exit;
-	}
-
-    // Create accessor.
-	//
-    hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, 
-									dwBindingSize, 
-									prgBinding,
-									0,
-									&hAccessor,
-									NULL);
-    if(FAILED(hr))
-    {
-        goto Exit;
-    }
-
-	// Allocate data buffer for seek and retrieve operation.
-	//
-	pData = (BYTE*)CoTaskMemAlloc(dwOffset);
-	if (NULL == pData)
-	{
-		hr = E_OUTOFMEMORY;
-		goto Exit;
-	}
-
-    // Set data buffer to zero
-    //
-    memset(pData, 0, dwOffset);
-
-    // Set data buffer for seek operation
-    //
-	*(ULONG*)(pData+prgBinding[0].obLength)		= 4;
-	*(DBSTATUS*)(pData+prgBinding[0].obStatus)	= DBSTATUS_S_OK;
-	*(int*)(pData+prgBinding[0].obValue)		= dwEmployeeID;
-
- 	// Position at a key value within the current range 
-	//
-	hr = pIRowsetIndex->Seek(hAccessor, 1, pData, DBSEEK_FIRSTEQ);
-	if(FAILED(hr))
-	{
-		goto Exit;	
-	}
-
-    // Retrieve a row handle for the row resulting from the seek
-    //
-    hr = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, 1, &cRowsObtained, &prghRows);
-	if(FAILED(hr))
-	{
-		goto Exit;	
-	}
-
-	if (DB_S_ENDOFROWSET != hr)
-	{
-		// Fetch actual data
-		//
-		hr = pIRowset->GetData(prghRows[0], hAccessor, pData);
-		if (FAILED(hr))
-		{
-			goto Exit;
-		}
-
-		// Clear employee info on the dialog
-		//
-		ClearEmployeeInfo();
-
-		// Update dialog
-		// If return a null value or status is not OK, ignore the contents of the value and length parts of the buffer.
-		//
-    	if (DBSTATUS_S_ISNULL != *(DBSTATUS *)(pData+prgBinding[0].obStatus) && 
-            DBSTATUS_S_OK == *(DBSTATUS *)(pData+prgBinding[0].obStatus))
-	    {
-		    SetDlgItemInt(m_hWndEmployees,  IDC_EDIT_EMPLOYEE_ID, *(LONG*)(pData+prgBinding[0].obValue), 0);
-        }
-
-		if (DBSTATUS_S_ISNULL != *(DBSTATUS *)(pData+prgBinding[1].obStatus) &&
-            DBSTATUS_S_OK == *(DBSTATUS *)(pData+prgBinding[1].obStatus))
-		{
-			SetDlgItemText(m_hWndEmployees, IDC_EDIT_ADDRESS, (WCHAR*)(pData+prgBinding[1].obValue));
-		}
-
-		if (DBSTATUS_S_ISNULL != *(DBSTATUS *)(pData+prgBinding[2].obStatus) &&
-            DBSTATUS_S_OK == *(DBSTATUS *)(pData+prgBinding[2].obStatus))
-		{
-			SetDlgItemText(m_hWndEmployees, IDC_EDIT_CITY, (WCHAR*)(pData+prgBinding[2].obValue));
-		}
-
-		if (DBSTATUS_S_ISNULL != *(DBSTATUS *)(pData+prgBinding[3].obStatus) &&
-            DBSTATUS_S_OK == *(DBSTATUS *)(pData+prgBinding[3].obStatus))
-		{
-			SetDlgItemText(m_hWndEmployees, IDC_EDIT_REGION, (WCHAR*)(pData+prgBinding[3].obValue));
-		}
-
-		if (DBSTATUS_S_ISNULL != *(DBSTATUS *)(pData+prgBinding[4].obStatus) &&
-            DBSTATUS_S_OK == *(DBSTATUS *)(pData+prgBinding[4].obStatus))
-		{
-			SetDlgItemText(m_hWndEmployees, IDC_EDIT_POSTAL_CODE, (WCHAR*)(pData+prgBinding[4].obValue));
-		}
-
-		if (DBSTATUS_S_ISNULL != *(DBSTATUS *)(pData+prgBinding[5].obStatus) &&
-            DBSTATUS_S_OK == *(DBSTATUS *)(pData+prgBinding[5].obStatus))
-		{
-			SetDlgItemText(m_hWndEmployees, IDC_EDIT_COUNTRY, (WCHAR*)(pData+prgBinding[5].obValue));
-		}
-
-		if (DBSTATUS_S_ISNULL != *(DBSTATUS *)(pData+prgBinding[6].obStatus) &&
-            DBSTATUS_S_OK == *(DBSTATUS *)(pData+prgBinding[6].obStatus))
-		{
-			SetDlgItemText(m_hWndEmployees, IDC_EDIT_HOME_PHONE, (WCHAR*)(pData+prgBinding[6].obValue));
-		}
-
-		// Update employee photo
-		// 
-		if (DBSTATUS_S_ISNULL != *(DBSTATUS *)(pData+prgBinding[7].obStatus) &&
-            DBSTATUS_S_OK == *(DBSTATUS *)(pData+prgBinding[7].obStatus))
-        {
-    		pILockBytes = (*(ILockBytes**) (pData + prgBinding[7].obValue));
-	    	LoadEmployeePhoto(pILockBytes);
-        }
-	}
-
-	// Release the rowset.
-	//
-	pIRowset->ReleaseRows(1, prghRows, NULL, NULL, NULL);
-
-Exit:
-    // Clear Variants
-    //
-	VariantClear(&rowsetprop[0].vValue);
-
-    // Free allocated DBBinding memory
-    //
-    if (prgBinding)
-    {
-        CoTaskMemFree(prgBinding);
-        prgBinding = NULL;
-    }
-
-    // Free allocated column info memory
-    //
-    if (pDBColumnInfo)
-    {
-        CoTaskMemFree(pDBColumnInfo);
-        pDBColumnInfo = NULL;
-    }
-	
-	// Free allocated column string values buffer
-    //
-    if (pStringsBuffer)
-    {
-        CoTaskMemFree(pStringsBuffer);
-        pStringsBuffer = NULL;
-    }
-
-    // Free data record buffer
-    //
-	if (pData)
-	{
-        CoTaskMemFree(pData);
-		pData = NULL;
-	}
-
-	// Release interfaces
-	//
-	if(pILockBytes)
-	{
-		pILockBytes->Release();
-	}
-
-	if(pIAccessor)
-	{
-		pIAccessor->ReleaseAccessor(hAccessor, NULL); 
-		pIAccessor->Release();
-	}
-
-	if (pIColumnsInfo)
-	{
-		pIColumnsInfo->Release();
-	}
-
-	if(pIRowset)
-	{
-		pIRowset->Release();
-	}
-
-	if (pIRowsetIndex)
-	{
-		pIRowsetIndex->Release();
-	}
-
-	if(pIOpenRowset)
-	{
-		pIOpenRowset->Release();
-	}
-
-	return hr;
+	return NOERROR;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1936,13 +1437,17 @@ void Employees::ShowEmployeePhoto()
 ////////////////////////////////////////////////////////////////////////////////
 void Employees::ClearEmployeeInfo()
 {
-	SetDlgItemText(m_hWndEmployees, IDC_EDIT_EMPLOYEE_ID, L"");
-	SetDlgItemText(m_hWndEmployees, IDC_EDIT_ADDRESS,     L"");
-	SetDlgItemText(m_hWndEmployees, IDC_EDIT_CITY,        L"");
-	SetDlgItemText(m_hWndEmployees, IDC_EDIT_REGION,      L"");
-	SetDlgItemText(m_hWndEmployees, IDC_EDIT_POSTAL_CODE, L"");
-	SetDlgItemText(m_hWndEmployees, IDC_EDIT_COUNTRY,     L"");
-	SetDlgItemText(m_hWndEmployees, IDC_EDIT_HOME_PHONE,  L"");
+	DWORD dwCol;
+
+	// Every column shown on the dialog
+	//
+	for (dwCol = 0; dwCol < EMPLOYEE_SCHEMA_SIZE; ++dwCol)
+	{
+		if (g_rgEmployeeSchema[dwCol].nControlID)
+		{
+			SetDlgItemText(m_hWndEmployees, g_rgEmployeeSchema[dwCol].nControlID, L"");
+		}
+	}
 
 	LoadEmployeePhoto(NULL);
 }
@@ -1959,343 +1464,64 @@ void Employees::ClearEmployeeInfo()
 ////////////////////////////////////////////////////////////////////////////////
 HRESULT Employees::SaveEmployeeInfo(DWORD dwEmployeeID)
 {
-	HRESULT				hr					= NOERROR;			// Error code reporting
-	DBBINDING			*prgBinding			= NULL;				// Binding used to create accessor
-	HROW				rghRows[1];								// Array of row handles obtained from the rowset object
-	HROW				*prghRows			= rghRows;			// Row handle(s) pointer
-	DBID				TableID;								// Used to open/create table
-	DBID				IndexID;								// Used to create index
-	DBPROPSET			rowsetpropset[1];						// Used when opening integrated index
-	DBPROP				rowsetprop[2];							// Used when opening integrated index
-   	ULONG				cRowsObtained		= 0;				// Number of rows obtained from the rowset object
-	DBCOLUMNINFO		*pDBColumnInfo		= NULL;				// Record column metadata
-	BYTE				*pData				= NULL;				// record data
-	WCHAR				*pStringsBuffer		= NULL;
-	DWORD				dwBindingSize		= 0;
-	DWORD				dwIndex				= 0;
-	DWORD				dwOffset			= 0;
-	DWORD				dwOrdinal			= 0;
-    ULONG				ulNumCols;
-
-	IOpenRowset			*pIOpenRowset		= NULL;				// Provider Interface Pointer
-	IRowset				*pIRowset			= NULL;				// Provider Interface Pointer
-    IRowsetChange		*pIRowsetChange		= NULL;
-	IRowsetIndex		*pIRowsetIndex		= NULL;				// Provider Interface Pointer
-	IAccessor			*pIAccessor			= NULL;				// Provider Interface Pointer
-	IColumnsInfo		*pIColumnsInfo		= NULL;				// Provider Interface Pointer
-	HACCESSOR			hAccessor			= DB_NULL_HACCESSOR;// Accessor handle
-
-	WCHAR*				pwszEmployees[]		=	{				// Employee info column names
-													L"EmployeeID",
-													L"Address",
-													L"City",
-													L"Region",
-													L"PostalCode",
-													L"Country",
-													L"HomePhone"
-												};
-	
-	VariantInit(&rowsetprop[0].vValue);
-	VariantInit(&rowsetprop[1].vValue);
-
-	// Validate IDBCreateSession interface
-	//
-	if (NULL == m_pIDBCreateSession)
-	{
-		hr = E_POINTER;
-		goto Exit;
-	}
-
-    // Create a session object 
-    //
-    hr = m_pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**) &pIOpenRowset);
-    if(FAILED(hr))
-    {
-        goto Exit;
-    }
-
-	// Set up information necessary to open a table 
-	// using an index and have the ability to seek.
-	//
-	TableID.eKind			= DBKIND_NAME;
-	TableID.uName.pwszName	= (WCHAR*)TABLE_EMPLOYEE;
-
-	IndexID.eKind			= DBKIND_NAME;
-	IndexID.uName.pwszName	= L"PK_Employees";
-
-	// Request ability to use IRowsetChange interface
-	// 
-	rowsetpropset[0].cProperties	= 2;
-	rowsetpropset[0].guidPropertySet= DBPROPSET_ROWSET;
-	rowsetpropset[0].rgProperties	= rowsetprop;
-
-	rowsetprop[0].dwPropertyID		= DBPROP_IRowsetChange;
-	rowsetprop[0].dwOptions			= DBPROPOPTIONS_REQUIRED;
-	rowsetprop[0].colid				= DB_NULLID;
-	rowsetprop[0].vValue.vt			= VT_BOOL;
-	rowsetprop[0].vValue.boolVal	= VARIANT_TRUE;
-
-	rowsetprop[1].dwPropertyID		= DBPROP_IRowsetIndex;
-	rowsetprop[1].dwOptions			= DBPROPOPTIONS_REQUIRED;
-	rowsetprop[1].colid				= DB_NULLID;
-	rowsetprop[1].vValue.vt			= VT_BOOL;
-	rowsetprop[1].vValue.boolVal	= VARIANT_TRUE;
-
-	// Open the table using the index
-	//
-	hr = pIOpenRowset->OpenRowset(	NULL,
-									&TableID,
-									&IndexID,
-									IID_IRowsetIndex,
-									sizeof(rowsetpropset)/sizeof(rowsetpropset[0]),
-									rowsetpropset,
-									(IUnknown**) &pIRowsetIndex);
-	if(FAILED(hr))
-	{
-		goto Exit;
-	}
-
-    // Get IRowset interface
-	//
-	hr = pIRowsetIndex->QueryInterface(IID_IRowset, (void**) &pIRowset);
-	if(FAILED(hr))
-	{
-		goto Exit;
-	}
-
-	hr = pIRowset->QueryInterface(IID_IRowsetChange, (void**)&pIRowsetChange);
-	if(FAILED(hr))
-	{
-		goto Exit;
-	}
-
-    // Get IColumnsInfo interface
-	//
-    hr = pIRowset->QueryInterface(IID_IColumnsInfo, (void **)&pIColumnsInfo);
-	if(FAILED(hr))
-	{
-		goto Exit;
-	}
-
-	// Get the column metadata 
-	//
-    hr = pIColumnsInfo->GetColumnInfo(&ulNumCols, &pDBColumnInfo, &pStringsBuffer);
-	if(FAILED(hr) || 0 == ulNumCols)
-	{
-		goto Exit;
-	}
-
-    // Create a DBBINDING array.
-	//
-	dwBindingSize = sizeof(pwszEmployees)/sizeof(pwszEmployees[0]);
-	prgBinding = (DBBINDING*)CoTaskMemAlloc(sizeof(DBBINDING)*dwBindingSize);
-	if (NULL == prgBinding)
-	{
-		hr = E_OUTOFMEMORY;
-		goto Exit;
-	}
-
-	// Set initial offset for binding position
-	//
-	dwOffset = 0;
-
-	// Prepare structures to create the accessor
-	//
-    for (dwIndex = 0; dwIndex < dwBindingSize; ++dwIndex)
-    {
-		if (!GetColumnOrdinal(pDBColumnInfo, ulNumCols, pwszEmployees[dwIndex], &dwOrdinal))
-		{
-			hr = E_FAIL;
-			goto Exit;
-		}
-
-		prgBinding[dwIndex].iOrdinal	= dwOrdinal;
-		prgBinding[dwIndex].dwPart		= DBPART_VALUE | DBPART_STATUS | DBPART_LENGTH;
-		prgBinding[dwIndex].obLength	= dwOffset;                                     
-		prgBinding[dwIndex].obStatus	= prgBinding[dwIndex].obLength + sizeof(ULONG);  
-		prgBinding[dwIndex].obValue		= prgBinding[dwIndex].obStatus + sizeof(DBSTATUS);
-		prgBinding[dwIndex].pTypeInfo	= NULL;
-		prgBinding[dwIndex].pObject		= NULL;
-		prgBinding[dwIndex].pBindExt	= NULL;
-		prgBinding[dwIndex].dwMemOwner	= DBMEMOWNER_CLIENTOWNED;
-		prgBinding[dwIndex].dwFlags		= 0;
-		prgBinding[dwIndex].wType		= pDBColumnInfo[dwOrdinal].wType;
-		prgBinding[dwIndex].bPrecision	= pDBColumnInfo[dwOrdinal].bPrecision;
-		prgBinding[dwIndex].bScale		= pDBColumnInfo[dwOrdinal].bScale;
-
-		switch(prgBinding[dwIndex].wType)
-		{
-		case DBTYPE_WSTR:		
-			prgBinding[dwIndex].cbMaxLen = sizeof(WCHAR)*(pDBColumnInfo[dwOrdinal].ulColumnSize + 1);	// Extra buffer for null terminator 
-			break;
-		default:
-			prgBinding[dwIndex].cbMaxLen = pDBColumnInfo[dwOrdinal].ulColumnSize; 
-			break;
-		}
-		
-		// Calculate new offset
-		// 
-		dwOffset = prgBinding[dwIndex].obValue + prgBinding[dwIndex].cbMaxLen;
-
-		// Properly align the offset
-		//
-		dwOffset = ROUND_UP(dwOffset, COLUMN_ALIGNVAL);
-	}
+	HRESULT			hr		= NOERROR;			// Error code reporting
+	EmployeeStore	Store;						// Employee data access
+	EmployeeRecord	Record;						// Employee as edited
+	ULONGLONG		ullVersion;					// Row version LoadEmployeeInfo read
+	DWORD			dwStartMs;					// Start of the database work
 
-	// Get IAccessor interface
-	//
-	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
+	hr = ReadEmployeeRecord(m_hWndEmployees, dwEmployeeID, &Record);
 	if(FAILED(hr))
 	{
-		goto Exit;
+		return hr;
 	}
 
-    // Create accessor.
-	//
-    hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, 
-									dwBindingSize, 
-									prgBinding,
-									0,
-									&hAccessor,
-									NULL);
-    if(FAILED(hr))
-    {
-        goto Exit;
-    }
-
-	// Allocate data buffer for seek and retrieve operation.
+	// Apply the edit only to the version of the row that was displayed
 	//
-	pData = (BYTE*)CoTaskMemAlloc(dwOffset);
-	if (NULL == pData)
+	if (NOERROR == g_RowVersions.Lookup(dwEmployeeID, &ullVersion))
 	{
-		hr = E_OUTOFMEMORY;
-		goto Exit;
+		Record.SetVersion(TRUE, ullVersion);
 	}
 
-    // Set data buffer to zero
-    //
-    memset(pData, 0, dwOffset);
-
-    // Set data buffer for seek operation
-    //
-	*(ULONG*)(pData+prgBinding[0].obLength)		= 4;
-	*(DBSTATUS*)(pData+prgBinding[0].obStatus)	= DBSTATUS_S_OK;
-	*(int*)(pData+prgBinding[0].obValue)		= dwEmployeeID;
-
-	// Position at a key value within the current range 
+	// Saved once a compaction in progress is over, the edits stay on
+	// the dialog until then
 	//
-	hr = pIRowsetIndex->Seek(hAccessor, 1, pData, DBSEEK_FIRSTEQ);
-	if(FAILED(hr))
+	if (!EnterConnection(&g_Connection.fSaveDeferred))
 	{
-		goto Exit;	
+		return S_FALSE;
 	}
 
-    // Retrieve a row handle for the row resulting from the seek
-    //
-    hr = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, 1, &cRowsObtained, &prghRows);
-	if(FAILED(hr))
-	{
-		goto Exit;	
-	}
+	dwStartMs = GetTickCount();
 
-	if (DB_S_ENDOFROWSET != hr)
+	hr = Store.Open(m_pIDBCreateSession);
+	if(SUCCEEDED(hr))
 	{
-		GetDlgItemText(m_hWndEmployees, IDC_EDIT_ADDRESS,	  (WCHAR*)(pData+prgBinding[1].obValue), prgBinding[1].cbMaxLen);
-		GetDlgItemText(m_hWndEmployees, IDC_EDIT_CITY,		  (WCHAR*)(pData+prgBinding[2].obValue), prgBinding[2].cbMaxLen);
-		GetDlgItemText(m_hWndEmployees, IDC_EDIT_REGION,	  (WCHAR*)(pData+prgBinding[3].obValue), prgBinding[3].cbMaxLen);
-		GetDlgItemText(m_hWndEmployees, IDC_EDIT_POSTAL_CODE, (WCHAR*)(pData+prgBinding[4].obValue), prgBinding[4].cbMaxLen);
-		GetDlgItemText(m_hWndEmployees, IDC_EDIT_COUNTRY,	  (WCHAR*)(pData+prgBinding[5].obValue), prgBinding[5].cbMaxLen);
-		GetDlgItemText(m_hWndEmployees, IDC_EDIT_HOME_PHONE,  (WCHAR*)(pData+prgBinding[6].obValue), prgBinding[6].cbMaxLen);
-
-		for (dwIndex = 1; dwIndex <= 6; ++dwIndex)
-		{
-			*(ULONG*)(pData+prgBinding[dwIndex].obLength)	 = wcslen((WCHAR*)(pData+prgBinding[dwIndex].obValue))*sizeof(WCHAR);
-			*(DBSTATUS*)(pData+prgBinding[dwIndex].obStatus) = DBSTATUS_S_OK;
-		}
-
-		// Set data to database
-		//
-		hr = pIRowsetChange->SetData(prghRows[0], hAccessor, pData);
+		hr = Store.Save(&Record);
 	}
 
-	// Release the rowset.
-	//
-	pIRowset->ReleaseRows(1, prghRows, NULL, NULL, NULL);
-
-Exit:
-    // Clear Variants
-    //
-	VariantClear(&rowsetprop[0].vValue);
-	VariantClear(&rowsetprop[1].vValue);
-
-   
+	Store.Close();
 
-    // Free allocated DBBinding memory
-    //
-    if (prgBinding)
-    {
-        CoTaskMemFree(prgBinding);
-        prgBinding = NULL;
-    }
+	LeaveCriticalSection(&g_Connection.cs);
 
-    // Free allocated column info memory
-    //
-    if (pDBColumnInfo)
-    {
-        CoTaskMemFree(pDBColumnInfo);
-        pDBColumnInfo = NULL;
-    }
-	
-	// Free allocated column string values buffer
-    //
-    if (pStringsBuffer)
-    {
-        CoTaskMemFree(pStringsBuffer);
-        pStringsBuffer = NULL;
-    }
+	g_CompactScheduler.NoteForegroundActivity(GetTickCount() - dwStartMs);
 
-    // Free data record buffer
-    //
-	if (pData)
+	if (NOERROR != hr)
 	{
-        CoTaskMemFree(pData);
-		pData = NULL;
+		return hr;
 	}
 
-	// Release interfaces
+	// The next save applies to the version written here
 	//
-	if(pIAccessor)
-	{
-		pIAccessor->ReleaseAccessor(hAccessor, NULL); 
-		pIAccessor->Release();
-	}
-
-	if (pIColumnsInfo)
-	{
-		pIColumnsInfo->Release();
-	}
-
-	if (pIRowsetChange)
-	{
-		pIRowsetChange->Release();
-	}
-
-	if(pIRowset)
-	{
-		pIRowset->Release();
-	}
-
-	if (pIRowsetIndex)
+	if (Record.GetVersion(&ullVersion))
 	{
-		pIRowsetIndex->Release();
+		g_RowVersions.Remember(dwEmployeeID, ullVersion);
 	}
-
-	if(pIOpenRowset)
+	else
 	{
-		pIOpenRowset->Release();
+		g_RowVersions.Forget(dwEmployeeID);
 	}
 
-	return hr;
+	return NOERROR;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,1423 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: HashJoin
+//
+// File: HashJoin.cpp
+//
+// Comment: Equi-join of two tables of the database on the client.
+//
+// Functions:
+//			1. Read the build input into an arena of records and hash it
+//			2. Fetch the probe input in batches, hash and look up each batch
+//			3. Partition both inputs to temporary files when the build
+//			   input doesn't fit the memory budget
+//			4. Join the spilled partitions one pair at a time
+//
+// Notes:
+//			Every column is bound as text and keys are compared as text, so
+//			an INT key joins an INT key but not an NVARCHAR one holding the
+//			same digits. The hash table holds offsets into the arena next to
+//			the hash, so a lookup touches a record only when the hashes are
+//			equal. Spill files go to DBPROP_SSCE_TEMPFILE_DIRECTORY of the
+//			data source, or to the temporary path when none is set, and are
+//			deleted when the join ends. A partition is joined in memory
+//			even when it alone is over the budget; HASH_JOIN_PARTITIONS
+//			times the budget fits without that.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "SchemaCatalog.h"
+#include "HashJoin.h"
+
+#define HASH_JOIN_SIDE_BUILD	0
+#define HASH_JOIN_SIDE_PROBE	1
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GrowBuffer
+//
+// Description: Make sure a buffer can hold cbNeeded bytes.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT GrowBuffer(BYTE **ppb, DWORD *pcbMax, DWORD cbNeeded)
+{
+	BYTE	*pbNew;
+	DWORD	cbNew;
+
+	if (cbNeeded <= *pcbMax)
+	{
+		return NOERROR;
+	}
+
+	cbNew = *pcbMax ? *pcbMax : 4096;
+	while (cbNew < cbNeeded)
+	{
+		cbNew *= 2;
+	}
+
+	pbNew = (BYTE*)CoTaskMemRealloc(*ppb, cbNew);
+	if (NULL == pbNew)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	*ppb	= pbNew;
+	*pcbMax = cbNew;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: HashKey
+//
+// Description: FNV-1a hash of the characters of a key.
+//
+////////////////////////////////////////////////////////////////////////////////
+static DWORD HashKey(LPCWSTR pwszKey)
+{
+	const BYTE	*pbChars	= (const BYTE*)pwszKey;
+	DWORD		cbChars		= sizeof(WCHAR) * wcslen(pwszKey);
+	DWORD		dwHash		= 2166136261U;
+
+	for (DWORD dwByte = 0; dwByte < cbChars; ++dwByte)
+	{
+		dwHash ^= pbChars[dwByte];
+		dwHash *= 16777619U;
+	}
+
+	return dwHash;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetBucketCount
+//
+// Description: Returns the number of slots of a hash table of cRecords, at
+//				most half full.
+//
+////////////////////////////////////////////////////////////////////////////////
+static DWORD GetBucketCount(DWORD cRecords)
+{
+	DWORD cBuckets = HASH_JOIN_MIN_BUCKETS;
+
+	while (cBuckets < 2 * cRecords)
+	{
+		cBuckets *= 2;
+	}
+
+	return cBuckets;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FormatRecord
+//
+// Description: Format the values of a row as a record.
+//
+// Parameters:
+//			rgpwszValues	- Values, NULL for NULL
+//			cColumns		- Number of values
+//			dwHash			- Hash of the key, the first value
+//			pbRecord		- Receives the record, large enough for the
+//							  largest record of the input
+//
+// Returns: The record
+//
+////////////////////////////////////////////////////////////////////////////////
+static HASH_JOIN_RECORD* FormatRecord(LPCWSTR *rgpwszValues, DWORD cColumns, DWORD dwHash, BYTE *pbRecord)
+{
+	HASH_JOIN_RECORD	*pRecord	= (HASH_JOIN_RECORD*)pbRecord;
+	WORD				*pcch		= (WORD*)(pRecord + 1);
+	WCHAR				*pwszValue;
+	DWORD				cbRecord;
+	DWORD				cch;
+
+	pRecord->dwHash		= dwHash;
+	pRecord->dwNulls	= 0;
+
+	for (DWORD dwCol = 0; dwCol < cColumns; ++dwCol)
+	{
+		pwszValue = (WCHAR*)(pcch + 1);
+
+		if (NULL == rgpwszValues[dwCol])
+		{
+			pRecord->dwNulls |= 1 << dwCol;
+			cch = 0;
+		}
+		else
+		{
+			cch = wcslen(rgpwszValues[dwCol]);
+			if (cch > HASH_JOIN_MAX_STRING)
+			{
+				cch = HASH_JOIN_MAX_STRING;
+			}
+
+			memcpy(pwszValue, rgpwszValues[dwCol], cch*sizeof(WCHAR));
+		}
+
+		pwszValue[cch]	= WCHAR('\0');
+		*pcch			= (WORD)cch;
+		pcch			= (WORD*)(pwszValue + cch + 1);
+	}
+
+	// Records are kept DWORD aligned, in the arena and in the spill files
+	//
+	cbRecord = (DWORD)((BYTE*)pcch - pbRecord);
+	pRecord->cbRecord = ROUND_UP(cbRecord, sizeof(DWORD));
+	memset(pcch, 0, pRecord->cbRecord - cbRecord);
+
+	return pRecord;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: DecodeRecord
+//
+// Description: Point at the values of a record, NULL for NULL.
+//
+////////////////////////////////////////////////////////////////////////////////
+static void DecodeRecord(const HASH_JOIN_RECORD *pRecord, DWORD cColumns, LPCWSTR *rgpwszValues)
+{
+	const WORD *pcch = (const WORD*)(pRecord + 1);
+
+	for (DWORD dwCol = 0; dwCol < cColumns; ++dwCol)
+	{
+		rgpwszValues[dwCol] = (pRecord->dwNulls & (1 << dwCol)) ? NULL : (LPCWSTR)(pcch + 1);
+		pcch = (const WORD*)((const WCHAR*)(pcch + 1) + *pcch + 1);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetSpillDirectory
+//
+// Description: Get the temporary file directory of a data source, the
+//				temporary path if none was set.
+//
+// Parameters:
+//			pIDBCreateSession	- Data source
+//			pwszDirectory		- Receives the directory, MAX_PATH characters
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT GetSpillDirectory(IDBCreateSession *pIDBCreateSession, WCHAR *pwszDirectory)
+{
+	HRESULT				hr					= NOERROR;
+	DBPROPID			rgPropertyIDs[1];
+	DBPROPIDSET			PropertyIDSet;
+	DBPROPSET			*rgPropertySets		= NULL;
+	ULONG				cPropertySets		= 0;
+	DBPROP				*pProperty;
+	DWORD				cch;
+
+	IDBProperties		*pIDBProperties		= NULL;		// Provider Interface Pointer
+
+	pwszDirectory[0] = WCHAR('\0');
+
+	hr = pIDBCreateSession->QueryInterface(IID_IDBProperties, (void **)&pIDBProperties);
+	if(SUCCEEDED(hr))
+	{
+		rgPropertyIDs[0]				= DBPROP_SSCE_TEMPFILE_DIRECTORY;
+		PropertyIDSet.rgPropertyIDs		= rgPropertyIDs;
+		PropertyIDSet.cPropertyIDs		= 1;
+		PropertyIDSet.guidPropertySet	= DBPROPSET_SSCE_DBINIT;
+
+		hr = pIDBProperties->GetProperties(1, &PropertyIDSet, &cPropertySets, &rgPropertySets);
+		if (SUCCEEDED(hr) && cPropertySets && rgPropertySets[0].cProperties)
+		{
+			pProperty = &rgPropertySets[0].rgProperties[0];
+
+			if (DBPROPSTATUS_OK == pProperty->dwStatus &&
+				VT_BSTR == pProperty->vValue.vt &&
+				pProperty->vValue.bstrVal &&
+				wcslen(pProperty->vValue.bstrVal) + 32 < MAX_PATH)
+			{
+				wcscpy(pwszDirectory, pProperty->vValue.bstrVal);
+			}
+		}
+
+		if (rgPropertySets)
+		{
+			for (ULONG ulProp = 0; ulProp < rgPropertySets[0].cProperties; ++ulProp)
+			{
+				VariantClear(&rgPropertySets[0].rgProperties[ulProp].vValue);
+			}
+
+			CoTaskMemFree(rgPropertySets[0].rgProperties);
+			CoTaskMemFree(rgPropertySets);
+		}
+
+		pIDBProperties->Release();
+	}
+
+	// The provider itself falls back to the temporary path
+	//
+	if (WCHAR('\0') == pwszDirectory[0])
+	{
+		cch = GetTempPath(MAX_PATH, pwszDirectory);
+		if (0 == cch)
+		{
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+
+		if (cch + 32 >= MAX_PATH)
+		{
+			return E_FAIL;
+		}
+	}
+
+	cch = wcslen(pwszDirectory);
+	if (L'\\' != pwszDirectory[cch - 1])
+	{
+		wcscat(pwszDirectory, L"\\");
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: InitSide
+//
+// Description: Reset the state of an input.
+//
+////////////////////////////////////////////////////////////////////////////////
+static void InitSide(HASH_JOIN_SIDE *pSide)
+{
+	memset(pSide, 0, sizeof(HASH_JOIN_SIDE));
+
+	pSide->hAccessor = DB_NULL_HACCESSOR;
+
+	for (DWORD dwPartition = 0; dwPartition < HASH_JOIN_PARTITIONS; ++dwPartition)
+	{
+		pSide->rghPartition[dwPartition] = INVALID_HANDLE_VALUE;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: HashJoin::HashJoin()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+HashJoin::HashJoin() :	m_pIDBCreateSession(NULL),
+						m_pfnRow(NULL),
+						m_pvContext(NULL),
+						m_cbBudget(HASH_JOIN_DEFAULT_BUDGET),
+						m_fStopped(FALSE),
+						m_pbRecord(NULL),
+						m_pbArena(NULL),
+						m_cbArena(0),
+						m_cbArenaMax(0),
+						m_cRecords(0),
+						m_rgBucket(NULL),
+						m_cBuckets(0),
+						m_fSpilled(FALSE),
+						m_pbRead(NULL),
+						m_cbRead(0)
+{
+	InitSide(&m_Build);
+	InitSide(&m_Probe);
+
+	m_wszSpillPrefix[0] = WCHAR('\0');
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: HashJoin::~HashJoin()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+HashJoin::~HashJoin()
+{
+	CloseSpill();
+	CloseSide(&m_Build);
+	CloseSide(&m_Probe);
+	ResetTable();
+
+	if (m_pbArena)
+	{
+		CoTaskMemFree(m_pbArena);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SetMemoryBudget
+//
+// Description: Set the bytes of the build input held in memory, the hash
+//				table included. A larger build input is spilled.
+//
+////////////////////////////////////////////////////////////////////////////////
+void HashJoin::SetMemoryBudget(DWORD cbBudget)
+{
+	m_cbBudget = cbBudget ? cbBudget : HASH_JOIN_DEFAULT_BUDGET;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Execute
+//
+// Description: Join two tables and pass each pair of rows with equal keys
+//				to a callback. The pairs come in no particular order.
+//
+// Parameters
+//		pIDBCreateSession	- connection to the database
+//		pBuild				- input held in the hash table, the smaller one
+//		pProbe				- input looked up in the hash table
+//		pfnRow				- receives the joined rows
+//		pvContext			- passed to pfnRow
+//		pStats				- optionally receives the join statistics
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT HashJoin::Execute(IDBCreateSession			*pIDBCreateSession,
+						  const HASH_JOIN_INPUT		*pBuild,
+						  const HASH_JOIN_INPUT		*pProbe,
+						  PFN_HASH_JOIN_ROW			pfnRow,
+						  LPVOID					pvContext,
+						  HASH_JOIN_STATS			*pStats)
+{
+	HRESULT				hr					= NOERROR;			// Error code reporting
+	DWORD				dwStart;
+	DWORD				cbRecordMax;
+
+	IOpenRowset			*pIOpenRowset		= NULL;				// Provider Interface Pointer
+
+	if (NULL == pIDBCreateSession || NULL == pBuild || NULL == pProbe || NULL == pfnRow)
+	{
+		return E_INVALIDARG;
+	}
+
+	memset(&m_Stats, 0, sizeof(m_Stats));
+
+	m_pIDBCreateSession = pIDBCreateSession;
+	m_pfnRow			= pfnRow;
+	m_pvContext			= pvContext;
+	m_fStopped			= FALSE;
+
+    // Create a session object and open both inputs
+    //
+    hr = pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pIOpenRowset);
+    if(FAILED(hr))
+    {
+        goto Exit;
+    }
+
+	hr = OpenSide(pIOpenRowset, pBuild, &m_Build);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = OpenSide(pIOpenRowset, pProbe, &m_Probe);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// One buffer formats the records of either input
+	//
+	cbRecordMax = (m_Build.cbRecordMax > m_Probe.cbRecordMax) ? m_Build.cbRecordMax : m_Probe.cbRecordMax;
+
+	m_pbRecord = (BYTE*)CoTaskMemAlloc(cbRecordMax);
+	if (NULL == m_pbRecord)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	dwStart = GetTickCount();
+
+	hr = BuildPhase();
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	m_Stats.dwBuildMs	= GetTickCount() - dwStart;
+	dwStart				= GetTickCount();
+
+	hr = ProbePhase();
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	m_Stats.dwProbeMs = GetTickCount() - dwStart;
+
+	hr = NOERROR;
+
+	if (pStats)
+	{
+		*pStats = m_Stats;
+	}
+
+Exit:
+	CloseSpill();
+	CloseSide(&m_Build);
+	CloseSide(&m_Probe);
+	ResetTable();
+
+	if (m_pbArena)
+	{
+		CoTaskMemFree(m_pbArena);
+		m_pbArena		= NULL;
+		m_cbArenaMax	= 0;
+	}
+
+	if (m_pbRecord)
+	{
+		CoTaskMemFree(m_pbRecord);
+		m_pbRecord = NULL;
+	}
+
+	if(pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	m_pIDBCreateSession = NULL;
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: OpenSide
+//
+// Description: Open the rowset of an input and bind its columns as text.
+//
+// Parameters
+//		pIOpenRowset	- session of the join
+//		pInput			- table, index and columns of the input
+//		pSide			- receives the state of the input
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT HashJoin::OpenSide(IOpenRowset *pIOpenRowset, const HASH_JOIN_INPUT *pInput, HASH_JOIN_SIDE *pSide)
+{
+	HRESULT				hr					= NOERROR;			// Error code reporting
+	SCHEMA_COLUMN		rgColumns[HASH_JOIN_MAX_COLUMNS];
+	DBBINDING			*pBinding;
+	DWORD				dwOffset			= 0;
+	DWORD				cchMax;
+
+	if (NULL == pInput->pwszTable ||
+		NULL == pInput->rgpwszColumns ||
+		0 == pInput->cColumns ||
+		pInput->cColumns > HASH_JOIN_MAX_COLUMNS)
+	{
+		return E_INVALIDARG;
+	}
+
+	hr = g_SchemaCatalog.Resolve(pIOpenRowset, pInput->pwszTable, pInput->rgpwszColumns, pInput->cColumns, rgColumns);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	hr = OpenTableRowset(pIOpenRowset, pInput->pwszTable, pInput->pwszIndex, 0, IID_IRowset, (IUnknown**)&pSide->pIRowset);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	pSide->cColumns		= pInput->cColumns;
+	pSide->cbRecordMax	= sizeof(HASH_JOIN_RECORD);
+
+	// Every column is converted to text by the provider
+	//
+	for (DWORD dwCol = 0; dwCol < pInput->cColumns; ++dwCol)
+	{
+		if (DBTYPE_BYTES == rgColumns[dwCol].wType)
+		{
+			return E_INVALIDARG;
+		}
+
+		if (DBTYPE_WSTR == rgColumns[dwCol].wType)
+		{
+			cchMax = (rgColumns[dwCol].ulColumnSize > HASH_JOIN_MAX_STRING) ? HASH_JOIN_MAX_STRING : rgColumns[dwCol].ulColumnSize;
+		}
+		else
+		{
+			cchMax = HASH_JOIN_MAX_TEXT;
+		}
+
+		pBinding = &pSide->rgBinding[dwCol];
+
+		pBinding->iOrdinal		= rgColumns[dwCol].iOrdinal;
+		pBinding->obLength		= dwOffset;
+		pBinding->obStatus		= pBinding->obLength + sizeof(ULONG);
+		pBinding->obValue		= pBinding->obStatus + sizeof(DBSTATUS);
+		pBinding->pTypeInfo		= NULL;
+		pBinding->pObject		= NULL;
+		pBinding->pBindExt		= NULL;
+		pBinding->dwPart		= DBPART_VALUE | DBPART_STATUS | DBPART_LENGTH;
+		pBinding->dwMemOwner	= DBMEMOWNER_CLIENTOWNED;
+		pBinding->cbMaxLen		= sizeof(WCHAR)*(cchMax + 1);	// Extra buffer for null terminator
+		pBinding->dwFlags		= 0;
+		pBinding->wType			= DBTYPE_WSTR;
+		pBinding->bPrecision	= 0;
+		pBinding->bScale		= 0;
+
+		dwOffset = ROUND_UP(pBinding->obValue + pBinding->cbMaxLen, COLUMN_ALIGNVAL);
+
+		pSide->cbRecordMax += sizeof(WORD) + pBinding->cbMaxLen;
+	}
+
+	pSide->cbRow		= dwOffset;
+	pSide->cbRecordMax	= ROUND_UP(pSide->cbRecordMax, sizeof(DWORD));
+
+	pSide->pbBlock = (BYTE*)CoTaskMemAlloc(pSide->cbRow * HASH_JOIN_FETCH_ROWS);
+	if (NULL == pSide->pbBlock)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	hr = pSide->pIRowset->QueryInterface(IID_IAccessor, (void**)&pSide->pIAccessor);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	return pSide->pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA,
+											 pSide->cColumns,
+											 pSide->rgBinding,
+											 0,
+											 &pSide->hAccessor,
+											 NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FetchBlock
+//
+// Description: Fetch the next batch of rows of an input, point at their
+//				values and hash their keys. Rows with a NULL key get a hash
+//				of 0 and are skipped by the callers.
+//
+// Parameters
+//		pSide		- input
+//		pcRows		- receives the number of rows fetched
+//		pfEnd		- receives TRUE once the rowset is read
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT HashJoin::FetchBlock(HASH_JOIN_SIDE *pSide, ULONG *pcRows, BOOL *pfEnd)
+{
+	HRESULT				hr					= NOERROR;			// Error code reporting
+	HRESULT				hrFetch;								// Result of GetNextRows
+	HROW				rghRows[HASH_JOIN_FETCH_ROWS];			// Array of row handles obtained from the rowset object
+	HROW				*prghRows			= rghRows;			// Row handle(s) pointer
+	ULONG				cRowsObtained		= 0;				// Number of rows obtained from the rowset object
+	ULONG				ulRow;
+	BYTE				*pbRow;
+	DBSTATUS			dwStatus;
+
+	*pcRows = 0;
+	*pfEnd	= TRUE;
+
+	hrFetch = pSide->pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, HASH_JOIN_FETCH_ROWS, &cRowsObtained, &prghRows);
+	if (FAILED(hrFetch))
+	{
+		return hrFetch;
+	}
+
+	for (ulRow = 0; ulRow < cRowsObtained; ++ulRow)
+	{
+		hr = pSide->pIRowset->GetData(rghRows[ulRow], pSide->hAccessor, pSide->pbBlock + ulRow*pSide->cbRow);
+		if(FAILED(hr))
+		{
+			break;
+		}
+	}
+
+	if (cRowsObtained)
+	{
+		pSide->pIRowset->ReleaseRows(cRowsObtained, rghRows, NULL, NULL, NULL);
+	}
+
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	// Decode and hash the whole batch before any of it is looked up
+	//
+	for (ulRow = 0; ulRow < cRowsObtained; ++ulRow)
+	{
+		pbRow = pSide->pbBlock + ulRow*pSide->cbRow;
+
+		for (DWORD dwCol = 0; dwCol < pSide->cColumns; ++dwCol)
+		{
+			dwStatus = *(DBSTATUS*)(pbRow + pSide->rgBinding[dwCol].obStatus);
+
+			if (DBSTATUS_S_ISNULL == dwStatus)
+			{
+				pSide->rgpwszValues[ulRow][dwCol] = NULL;
+			}
+			else if (DBSTATUS_S_OK == dwStatus || DBSTATUS_S_TRUNCATED == dwStatus)
+			{
+				pSide->rgpwszValues[ulRow][dwCol] = (LPCWSTR)(pbRow + pSide->rgBinding[dwCol].obValue);
+			}
+			else
+			{
+				return DB_E_ERRORSOCCURRED;
+			}
+		}
+
+		pSide->rgdwHash[ulRow] = pSide->rgpwszValues[ulRow][0] ? HashKey(pSide->rgpwszValues[ulRow][0]) : 0;
+	}
+
+	*pcRows = cRowsObtained;
+	*pfEnd	= (DB_S_ENDOFROWSET == hrFetch || 0 == cRowsObtained);
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CloseSide
+//
+// Description: Release the rowset and buffers of an input.
+//
+////////////////////////////////////////////////////////////////////////////////
+void HashJoin::CloseSide(HASH_JOIN_SIDE *pSide)
+{
+	if (pSide->pIAccessor)
+	{
+		pSide->pIAccessor->ReleaseAccessor(pSide->hAccessor, NULL);
+		pSide->pIAccessor->Release();
+	}
+
+	if (pSide->pIRowset)
+	{
+		pSide->pIRowset->Release();
+	}
+
+	if (pSide->pbBlock)
+	{
+		CoTaskMemFree(pSide->pbBlock);
+	}
+
+	if (pSide->pbSpill)
+	{
+		CoTaskMemFree(pSide->pbSpill);
+	}
+
+	InitSide(pSide);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: BuildPhase
+//
+// Description: Read the build input into the hash table, or into the build
+//				partitions once it is over the memory budget.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT HashJoin::BuildPhase()
+{
+	HRESULT				hr					= NOERROR;
+	HASH_JOIN_RECORD	*pRecord;
+	ULONG				cRows;
+	ULONG				ulRow;
+	BOOL				fEnd;
+
+	do
+	{
+		hr = FetchBlock(&m_Build, &cRows, &fEnd);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+
+		m_Stats.cBuildRows += cRows;
+
+		for (ulRow = 0; ulRow < cRows; ++ulRow)
+		{
+			// NULL keys never match
+			//
+			if (NULL == m_Build.rgpwszValues[ulRow][0])
+			{
+				continue;
+			}
+
+			pRecord = FormatRecord(m_Build.rgpwszValues[ulRow], m_Build.cColumns, m_Build.rgdwHash[ulRow], m_pbRecord);
+
+			if (!m_fSpilled && GetMemoryUse(m_cbArena + pRecord->cbRecord, m_cRecords + 1) > m_cbBudget)
+			{
+				hr = StartSpill();
+				if(FAILED(hr))
+				{
+					return hr;
+				}
+			}
+
+			hr = m_fSpilled ? SpillRecord(&m_Build, pRecord) : AddRecord(pRecord);
+			if(FAILED(hr))
+			{
+				return hr;
+			}
+		}
+	}
+	while (!fEnd);
+
+	if (m_fSpilled)
+	{
+		return NOERROR;
+	}
+
+	return BuildTable();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ProbePhase
+//
+// Description: Read the probe input and look up each batch of rows in the
+//				hash table. Once spilled, the probe input is partitioned
+//				instead and the partitions are joined afterwards.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT HashJoin::ProbePhase()
+{
+	HRESULT				hr					= NOERROR;
+	HASH_JOIN_RECORD	*pRecord;
+	ULONG				cRows;
+	ULONG				ulRow;
+	DWORD				dwPartition;
+	BOOL				fEnd;
+
+	// Nothing can match an empty build input
+	//
+	if (!m_fSpilled && 0 == m_cRecords)
+	{
+		return NOERROR;
+	}
+
+	do
+	{
+		hr = FetchBlock(&m_Probe, &cRows, &fEnd);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+
+		m_Stats.cProbeRows += cRows;
+
+		for (ulRow = 0; ulRow < cRows; ++ulRow)
+		{
+			if (NULL == m_Probe.rgpwszValues[ulRow][0])
+			{
+				continue;
+			}
+
+			if (m_fSpilled)
+			{
+				pRecord = FormatRecord(m_Probe.rgpwszValues[ulRow], m_Probe.cColumns, m_Probe.rgdwHash[ulRow], m_pbRecord);
+				hr		= SpillRecord(&m_Probe, pRecord);
+			}
+			else
+			{
+				hr = ProbeRow(m_Probe.rgpwszValues[ulRow], m_Probe.rgdwHash[ulRow]);
+			}
+
+			if(FAILED(hr) || m_fStopped)
+			{
+				return hr;
+			}
+		}
+	}
+	while (!fEnd);
+
+	if (!m_fSpilled)
+	{
+		return NOERROR;
+	}
+
+	// Join the partitions, a pair at a time
+	//
+	for (dwPartition = 0; dwPartition < HASH_JOIN_PARTITIONS; ++dwPartition)
+	{
+		hr = FlushPartition(&m_Build, dwPartition);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+
+		hr = FlushPartition(&m_Probe, dwPartition);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+
+		if (m_Build.rgcbPartition[dwPartition] || m_Probe.rgcbPartition[dwPartition])
+		{
+			++m_Stats.cPartitionsSpilled;
+		}
+	}
+
+	m_cbRead = (m_Probe.cbRecordMax > HASH_JOIN_READ_BUFFER) ? m_Probe.cbRecordMax : HASH_JOIN_READ_BUFFER;
+
+	m_pbRead = (BYTE*)CoTaskMemAlloc(m_cbRead);
+	if (NULL == m_pbRead)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	for (dwPartition = 0; dwPartition < HASH_JOIN_PARTITIONS && !m_fStopped; ++dwPartition)
+	{
+		hr = JoinPartition(dwPartition);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddRecord
+//
+// Description: Append a record of the build input to the arena.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT HashJoin::AddRecord(const HASH_JOIN_RECORD *pRecord)
+{
+	HRESULT hr;
+
+	hr = GrowBuffer(&m_pbArena, &m_cbArenaMax, m_cbArena + pRecord->cbRecord);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	memcpy(m_pbArena + m_cbArena, pRecord, pRecord->cbRecord);
+
+	m_cbArena += pRecord->cbRecord;
+	++m_cRecords;
+
+	UpdatePeakMemory();
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: BuildTable
+//
+// Description: Build the hash table over the records of the arena. Equal
+//				keys take consecutive slots, linear probing finds them all.
+//
+// Returns: NOERROR if succesfull, E_FAIL if the arena is corrupt
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT HashJoin::BuildTable()
+{
+	HASH_JOIN_RECORD	*pRecord;
+	DWORD				obRecord;
+	DWORD				dwMask;
+	DWORD				dwBucket;
+
+	// Count the records, the arena of a partition comes from a file
+	//
+	m_cRecords = 0;
+
+	for (obRecord = 0; obRecord < m_cbArena; obRecord += pRecord->cbRecord)
+	{
+		pRecord = (HASH_JOIN_RECORD*)(m_pbArena + obRecord);
+
+		if (m_cbArena - obRecord < sizeof(HASH_JOIN_RECORD) ||
+			pRecord->cbRecord < sizeof(HASH_JOIN_RECORD) ||
+			pRecord->cbRecord > m_cbArena - obRecord)
+		{
+			return E_FAIL;
+		}
+
+		++m_cRecords;
+	}
+
+	m_cBuckets	= GetBucketCount(m_cRecords);
+	m_rgBucket	= (HASH_JOIN_BUCKET*)CoTaskMemAlloc(m_cBuckets * sizeof(HASH_JOIN_BUCKET));
+	if (NULL == m_rgBucket)
+	{
+		m_cBuckets = 0;
+		return E_OUTOFMEMORY;
+	}
+
+	memset(m_rgBucket, 0, m_cBuckets * sizeof(HASH_JOIN_BUCKET));
+
+	dwMask = m_cBuckets - 1;
+
+	for (obRecord = 0; obRecord < m_cbArena; obRecord += pRecord->cbRecord)
+	{
+		pRecord	 = (HASH_JOIN_RECORD*)(m_pbArena + obRecord);
+		dwBucket = pRecord->dwHash & dwMask;
+
+		while (m_rgBucket[dwBucket].obRecord)
+		{
+			dwBucket = (dwBucket + 1) & dwMask;
+		}
+
+		m_rgBucket[dwBucket].dwHash		= pRecord->dwHash;
+		m_rgBucket[dwBucket].obRecord	= obRecord + 1;
+	}
+
+	UpdatePeakMemory();
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ProbeRow
+//
+// Description: Look up a row of the probe input and pass each match to the
+//				callback.
+//
+// Parameters
+//		rgpwszProbe	- values of the row, the key first and not NULL
+//		dwHash		- hash of the key
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT HashJoin::ProbeRow(LPCWSTR *rgpwszProbe, DWORD dwHash)
+{
+	HRESULT					hr			= NOERROR;
+	const HASH_JOIN_RECORD	*pRecord;
+	const WORD				*pcch;
+	DWORD					cchKey;
+	DWORD					dwMask;
+	DWORD					dwBucket;
+
+	if (0 == m_cBuckets)
+	{
+		return NOERROR;
+	}
+
+	cchKey	= wcslen(rgpwszProbe[0]);
+	dwMask	= m_cBuckets - 1;
+
+	for (dwBucket = dwHash & dwMask; m_rgBucket[dwBucket].obRecord; dwBucket = (dwBucket + 1) & dwMask)
+	{
+		// The record is only read when the hashes are equal
+		//
+		if (m_rgBucket[dwBucket].dwHash != dwHash)
+		{
+			continue;
+		}
+
+		pRecord = (const HASH_JOIN_RECORD*)(m_pbArena + m_rgBucket[dwBucket].obRecord - 1);
+		pcch	= (const WORD*)(pRecord + 1);
+
+		if (*pcch != cchKey || memcmp(pcch + 1, rgpwszProbe[0], cchKey*sizeof(WCHAR)))
+		{
+			continue;
+		}
+
+		DecodeRecord(pRecord, m_Build.cColumns, m_rgpwszBuild);
+
+		++m_Stats.cMatches;
+
+		hr = m_pfnRow(m_pvContext, m_rgpwszBuild, rgpwszProbe);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+
+		if (S_FALSE == hr)
+		{
+			m_fStopped = TRUE;
+			return NOERROR;
+		}
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ResetTable
+//
+// Description: Empty the hash table. The arena is kept for the next
+//				partition.
+//
+////////////////////////////////////////////////////////////////////////////////
+void HashJoin::ResetTable()
+{
+	if (m_rgBucket)
+	{
+		CoTaskMemFree(m_rgBucket);
+		m_rgBucket = NULL;
+	}
+
+	m_cBuckets	= 0;
+	m_cbArena	= 0;
+	m_cRecords	= 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StartSpill
+//
+// Description: Create the partition files of both inputs and move the build
+//				records read so far into them.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT HashJoin::StartSpill()
+{
+	HRESULT				hr					= NOERROR;
+	HASH_JOIN_SIDE		*rgpSide[2]			= { &m_Build, &m_Probe };
+	HASH_JOIN_RECORD	*pRecord;
+	WCHAR				wszDirectory[MAX_PATH];
+	WCHAR				wszFile[MAX_PATH];
+	DWORD				obRecord;
+
+	hr = GetSpillDirectory(m_pIDBCreateSession, wszDirectory);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	wsprintf(m_wszSpillPrefix, L"%sNWJ%04X%04X", wszDirectory, GetCurrentThreadId() & 0xFFFF, GetTickCount() & 0xFFFF);
+
+	m_fSpilled = TRUE;
+
+	for (DWORD iSide = HASH_JOIN_SIDE_BUILD; iSide <= HASH_JOIN_SIDE_PROBE; ++iSide)
+	{
+		rgpSide[iSide]->pbSpill = (BYTE*)CoTaskMemAlloc(HASH_JOIN_PARTITIONS * HASH_JOIN_SPILL_BUFFER);
+		if (NULL == rgpSide[iSide]->pbSpill)
+		{
+			return E_OUTOFMEMORY;
+		}
+
+		for (DWORD dwPartition = 0; dwPartition < HASH_JOIN_PARTITIONS; ++dwPartition)
+		{
+			GetPartitionFile(iSide, dwPartition, wszFile);
+
+			rgpSide[iSide]->rghPartition[dwPartition] = CreateFile(wszFile,
+																   GENERIC_READ | GENERIC_WRITE,
+																   0,
+																   NULL,
+																   CREATE_ALWAYS,
+																   FILE_ATTRIBUTE_TEMPORARY,
+																   NULL);
+			if (INVALID_HANDLE_VALUE == rgpSide[iSide]->rghPartition[dwPartition])
+			{
+				return HRESULT_FROM_WIN32(GetLastError());
+			}
+		}
+	}
+
+	// The records in memory go to their partitions like the rest
+	//
+	for (obRecord = 0; obRecord < m_cbArena; obRecord += pRecord->cbRecord)
+	{
+		pRecord = (HASH_JOIN_RECORD*)(m_pbArena + obRecord);
+
+		hr = SpillRecord(&m_Build, pRecord);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+	}
+
+	ResetTable();
+	UpdatePeakMemory();
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SpillRecord
+//
+// Description: Append a record to its partition of an input. The partition
+//				is chosen by the high bits of the hash, the hash table of a
+//				partition uses the low bits.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT HashJoin::SpillRecord(HASH_JOIN_SIDE *pSide, const HASH_JOIN_RECORD *pRecord)
+{
+	HRESULT	hr			= NOERROR;
+	DWORD	dwPartition	= pRecord->dwHash >> (32 - HASH_JOIN_PARTITION_BITS);
+	DWORD	cbWritten	= 0;
+
+	if (pSide->rgcbSpill[dwPartition] + pRecord->cbRecord > HASH_JOIN_SPILL_BUFFER)
+	{
+		hr = FlushPartition(pSide, dwPartition);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+	}
+
+	if (pRecord->cbRecord > HASH_JOIN_SPILL_BUFFER)
+	{
+		if (!WriteFile(pSide->rghPartition[dwPartition], pRecord, pRecord->cbRecord, &cbWritten, NULL) ||
+			cbWritten != pRecord->cbRecord)
+		{
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+	}
+	else
+	{
+		memcpy(pSide->pbSpill + dwPartition*HASH_JOIN_SPILL_BUFFER + pSide->rgcbSpill[dwPartition],
+			   pRecord,
+			   pRecord->cbRecord);
+
+		pSide->rgcbSpill[dwPartition] += pRecord->cbRecord;
+	}
+
+	pSide->rgcbPartition[dwPartition]	+= pRecord->cbRecord;
+	m_Stats.cbSpilled					+= pRecord->cbRecord;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FlushPartition
+//
+// Description: Write the buffered records of a partition to its file.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT HashJoin::FlushPartition(HASH_JOIN_SIDE *pSide, DWORD iPartition)
+{
+	DWORD cbWritten = 0;
+
+	if (0 == pSide->rgcbSpill[iPartition])
+	{
+		return NOERROR;
+	}
+
+	if (!WriteFile(pSide->rghPartition[iPartition],
+				   pSide->pbSpill + iPartition*HASH_JOIN_SPILL_BUFFER,
+				   pSide->rgcbSpill[iPartition],
+				   &cbWritten,
+				   NULL) ||
+		cbWritten != pSide->rgcbSpill[iPartition])
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	pSide->rgcbSpill[iPartition] = 0;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: JoinPartition
+//
+// Description: Read a build partition into the hash table and stream the
+//				probe partition of the same hash bits through it.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT HashJoin::JoinPartition(DWORD iPartition)
+{
+	HRESULT				hr					= NOERROR;
+	HANDLE				hBuild				= m_Build.rghPartition[iPartition];
+	HANDLE				hProbe				= m_Probe.rghPartition[iPartition];
+	DWORD				cbBuild				= m_Build.rgcbPartition[iPartition];
+	DWORD				cbLeft				= m_Probe.rgcbPartition[iPartition];
+	LPCWSTR				rgpwszProbe[HASH_JOIN_MAX_COLUMNS];
+	HASH_JOIN_RECORD	*pRecord;
+	DWORD				ibNext				= 0;
+	DWORD				cbValid				= 0;
+	DWORD				cbChunk;
+	DWORD				cbRead				= 0;
+
+	if (0 == cbBuild || 0 == cbLeft)
+	{
+		return NOERROR;
+	}
+
+	ResetTable();
+
+	hr = GrowBuffer(&m_pbArena, &m_cbArenaMax, cbBuild);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	if (0xFFFFFFFF == SetFilePointer(hBuild, 0, NULL, FILE_BEGIN) ||
+		!ReadFile(hBuild, m_pbArena, cbBuild, &cbRead, NULL) ||
+		cbRead != cbBuild)
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	m_cbArena = cbBuild;
+
+	hr = BuildTable();
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	if (0xFFFFFFFF == SetFilePointer(hProbe, 0, NULL, FILE_BEGIN))
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	// Records are read a buffer at a time; a record cut at the end of the
+	// buffer is moved to its start before the next read
+	//
+	for (;;)
+	{
+		pRecord = (HASH_JOIN_RECORD*)(m_pbRead + ibNext);
+
+		if (cbValid - ibNext >= sizeof(HASH_JOIN_RECORD))
+		{
+			if (pRecord->cbRecord < sizeof(HASH_JOIN_RECORD) || pRecord->cbRecord > m_cbRead)
+			{
+				return E_FAIL;
+			}
+
+			if (cbValid - ibNext >= pRecord->cbRecord)
+			{
+				DecodeRecord(pRecord, m_Probe.cColumns, rgpwszProbe);
+				ibNext += pRecord->cbRecord;
+
+				hr = ProbeRow(rgpwszProbe, pRecord->dwHash);
+				if(FAILED(hr) || m_fStopped)
+				{
+					return hr;
+				}
+
+				continue;
+			}
+		}
+
+		if (0 == cbLeft)
+		{
+			break;
+		}
+
+		memmove(m_pbRead, m_pbRead + ibNext, cbValid - ibNext);
+		cbValid -= ibNext;
+		ibNext	 = 0;
+
+		cbChunk = (m_cbRead - cbValid < cbLeft) ? m_cbRead - cbValid : cbLeft;
+
+		if (!ReadFile(hProbe, m_pbRead + cbValid, cbChunk, &cbRead, NULL) || cbRead != cbChunk)
+		{
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+
+		cbValid += cbChunk;
+		cbLeft	-= cbChunk;
+	}
+
+	return (ibNext == cbValid) ? NOERROR : E_FAIL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetPartitionFile
+//
+// Description: Get the name of the file of a partition of an input.
+//
+////////////////////////////////////////////////////////////////////////////////
+void HashJoin::GetPartitionFile(DWORD iSide, DWORD iPartition, WCHAR *pwszFile)
+{
+	wsprintf(pwszFile,
+			 L"%s%c%02u.tmp",
+			 m_wszSpillPrefix,
+			 (HASH_JOIN_SIDE_BUILD == iSide) ? L'B' : L'P',
+			 iPartition);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CloseSpill
+//
+// Description: Close and delete the partition files.
+//
+////////////////////////////////////////////////////////////////////////////////
+void HashJoin::CloseSpill()
+{
+	HASH_JOIN_SIDE	*rgpSide[2]	= { &m_Build, &m_Probe };
+	WCHAR			wszFile[MAX_PATH];
+
+	if (!m_fSpilled)
+	{
+		return;
+	}
+
+	for (DWORD iSide = HASH_JOIN_SIDE_BUILD; iSide <= HASH_JOIN_SIDE_PROBE; ++iSide)
+	{
+		for (DWORD dwPartition = 0; dwPartition < HASH_JOIN_PARTITIONS; ++dwPartition)
+		{
+			if (INVALID_HANDLE_VALUE != rgpSide[iSide]->rghPartition[dwPartition])
+			{
+				CloseHandle(rgpSide[iSide]->rghPartition[dwPartition]);
+				rgpSide[iSide]->rghPartition[dwPartition] = INVALID_HANDLE_VALUE;
+
+				GetPartitionFile(iSide, dwPartition, wszFile);
+				DeleteFile(wszFile);
+			}
+
+			rgpSide[iSide]->rgcbSpill[dwPartition]		= 0;
+			rgpSide[iSide]->rgcbPartition[dwPartition]	= 0;
+		}
+	}
+
+	if (m_pbRead)
+	{
+		CoTaskMemFree(m_pbRead);
+		m_pbRead = NULL;
+	}
+
+	m_cbRead	= 0;
+	m_fSpilled	= FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetMemoryUse
+//
+// Description: Returns the bytes of a hash table of cRecords records in an
+//				arena of cbArena bytes.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD HashJoin::GetMemoryUse(DWORD cbArena, DWORD cRecords)
+{
+	return cbArena + GetBucketCount(cRecords) * sizeof(HASH_JOIN_BUCKET);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: UpdatePeakMemory
+//
+// Description: Record the memory held by the arena, the hash table and the
+//				fetch and spill buffers, if it is the largest so far.
+//
+////////////////////////////////////////////////////////////////////////////////
+void HashJoin::UpdatePeakMemory()
+{
+	DWORD cbMemory = m_cbArenaMax + m_cBuckets * sizeof(HASH_JOIN_BUCKET) + m_cbRead;
+
+	cbMemory += (m_Build.cbRow + m_Probe.cbRow) * HASH_JOIN_FETCH_ROWS;
+
+	if (m_fSpilled)
+	{
+		cbMemory += 2 * HASH_JOIN_PARTITIONS * HASH_JOIN_SPILL_BUFFER;
+	}
+
+	if (cbMemory > m_Stats.cbPeakMemory)
+	{
+		m_Stats.cbPeakMemory = cbMemory;
+	}
+}
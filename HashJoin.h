@@ -0,0 +1,183 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: HashJoin
+//
+// File: HashJoin.h
+//
+// Comment: Equi-join of two tables of the database on the client.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_HASHJOIN_H__8D2C4E71_B5A3_4F09_9C6E_3A71F0D5B248__INCLUDED_)
+#define AFX_HASHJOIN_H__8D2C4E71_B5A3_4F09_9C6E_3A71F0D5B248__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define HASH_JOIN_MAX_COLUMNS		16				// Columns of each input, the key included
+#define HASH_JOIN_MAX_TEXT			64				// Characters of a value that isn't a string column
+#define HASH_JOIN_MAX_STRING		4000			// Longer strings, ntext, are cut
+#define HASH_JOIN_FETCH_ROWS		64				// Row handles fetched and hashed per batch
+#define HASH_JOIN_PARTITION_BITS	4
+#define HASH_JOIN_PARTITIONS		(1 << HASH_JOIN_PARTITION_BITS)
+#define HASH_JOIN_SPILL_BUFFER		(4 * 1024)		// Write buffer of each spill partition
+#define HASH_JOIN_READ_BUFFER		(16 * 1024)		// Read buffer of a probe partition
+#define HASH_JOIN_DEFAULT_BUDGET	(256 * 1024)	// Bytes of the build side held in memory
+#define HASH_JOIN_MIN_BUCKETS		16
+
+////////////////////////////////////////////////////////////////////////////////
+// One input of the join. The first column is the join key. Rows with a NULL
+// key never match.
+//
+typedef struct tagHASH_JOIN_INPUT
+{
+	LPCWSTR		pwszTable;
+	LPCWSTR		pwszIndex;						// Index to scan, NULL for the base table
+	WCHAR		**rgpwszColumns;				// Column names, the join key first
+	DWORD		cColumns;
+} HASH_JOIN_INPUT;
+
+////////////////////////////////////////////////////////////////////////////////
+// Receives the joined rows, the values of the build and the probe input as
+// text, NULL for NULL. Returning S_FALSE ends the join.
+//
+typedef HRESULT (CALLBACK *PFN_HASH_JOIN_ROW)(LPVOID pvContext, LPCWSTR *rgpwszBuild, LPCWSTR *rgpwszProbe);
+
+////////////////////////////////////////////////////////////////////////////////
+// Join statistics
+//
+typedef struct tagHASH_JOIN_STATS
+{
+	DWORD		cBuildRows;						// Rows read from the build input
+	DWORD		cProbeRows;						// Rows read from the probe input
+	DWORD		cMatches;						// Joined rows passed to the callback
+	DWORD		cPartitionsSpilled;				// Partitions written to the spill directory, 0 if none
+	DWORD		cbPeakMemory;					// Largest memory use of the hash table and buffers
+	ULONGLONG	cbSpilled;						// Bytes written to the spill files
+	DWORD		dwBuildMs;						// Time spent reading and partitioning the build input
+	DWORD		dwProbeMs;						// Time spent reading the probe input and joining
+} HASH_JOIN_STATS;
+
+////////////////////////////////////////////////////////////////////////////////
+// A row in the hash table or in a spill file. The values follow as WORD
+// character count and null terminated characters, in column order, padded
+// to a DWORD boundary.
+//
+typedef struct tagHASH_JOIN_RECORD
+{
+	DWORD		dwHash;							// Hash of the key
+	DWORD		cbRecord;						// Bytes of the record, the header included
+	DWORD		dwNulls;						// One bit per NULL column
+} HASH_JOIN_RECORD;
+
+////////////////////////////////////////////////////////////////////////////////
+// A slot of the hash table
+//
+typedef struct tagHASH_JOIN_BUCKET
+{
+	DWORD		dwHash;
+	DWORD		obRecord;						// Offset of the record in the arena + 1, 0 if empty
+} HASH_JOIN_BUCKET;
+
+////////////////////////////////////////////////////////////////////////////////
+// State of one input, internal to the join
+//
+typedef struct tagHASH_JOIN_SIDE
+{
+	IRowset		*pIRowset;
+	IAccessor	*pIAccessor;
+	HACCESSOR	hAccessor;
+	DBBINDING	rgBinding[HASH_JOIN_MAX_COLUMNS];
+	DWORD		cColumns;
+	DWORD		cbRow;							// Bytes of a fetched row
+	DWORD		cbRecordMax;					// Bytes of the largest record
+	BYTE		*pbBlock;						// HASH_JOIN_FETCH_ROWS fetched rows
+	LPCWSTR		rgpwszValues[HASH_JOIN_FETCH_ROWS][HASH_JOIN_MAX_COLUMNS];
+	DWORD		rgdwHash[HASH_JOIN_FETCH_ROWS];
+
+	HANDLE		rghPartition[HASH_JOIN_PARTITIONS];
+	BYTE		*pbSpill;						// HASH_JOIN_SPILL_BUFFER per partition
+	DWORD		rgcbSpill[HASH_JOIN_PARTITIONS];		// Bytes waiting in the write buffer
+	DWORD		rgcbPartition[HASH_JOIN_PARTITIONS];	// Bytes of the partition, buffered included
+} HASH_JOIN_SIDE;
+
+////////////////////////////////////////////////////////////////////////////////
+// Joins two tables on equal key values. The build input is read into a
+// hash table of bucket slots over a contiguous arena of records; the probe
+// input is fetched in batches of row handles, its keys hashed a batch at a
+// time and looked up. When the build input doesn't fit the memory budget,
+// both inputs are partitioned by hash into files of the temporary file
+// directory of the database, and the partitions are joined one pair at a
+// time.
+//
+class HashJoin
+{
+public:
+	HashJoin();
+	~HashJoin();
+
+	void	SetMemoryBudget(DWORD cbBudget);
+
+	HRESULT Execute(IDBCreateSession		*pIDBCreateSession,
+					const HASH_JOIN_INPUT	*pBuild,
+					const HASH_JOIN_INPUT	*pProbe,
+					PFN_HASH_JOIN_ROW		pfnRow,
+					LPVOID					pvContext,
+					HASH_JOIN_STATS			*pStats);
+
+private:
+	HRESULT OpenSide(IOpenRowset *pIOpenRowset, const HASH_JOIN_INPUT *pInput, HASH_JOIN_SIDE *pSide);
+	HRESULT FetchBlock(HASH_JOIN_SIDE *pSide, ULONG *pcRows, BOOL *pfEnd);
+	void	CloseSide(HASH_JOIN_SIDE *pSide);
+
+	HRESULT BuildPhase();
+	HRESULT ProbePhase();
+	HRESULT AddRecord(const HASH_JOIN_RECORD *pRecord);
+	HRESULT BuildTable();
+	HRESULT ProbeRow(LPCWSTR *rgpwszProbe, DWORD dwHash);
+	void	ResetTable();
+
+	HRESULT StartSpill();
+	HRESULT SpillRecord(HASH_JOIN_SIDE *pSide, const HASH_JOIN_RECORD *pRecord);
+	HRESULT FlushPartition(HASH_JOIN_SIDE *pSide, DWORD iPartition);
+	HRESULT JoinPartition(DWORD iPartition);
+	void	GetPartitionFile(DWORD iSide, DWORD iPartition, WCHAR *pwszFile);
+	void	CloseSpill();
+
+	DWORD	GetMemoryUse(DWORD cbArena, DWORD cRecords);
+	void	UpdatePeakMemory();
+
+	IDBCreateSession	*m_pIDBCreateSession;
+	PFN_HASH_JOIN_ROW	m_pfnRow;
+	LPVOID				m_pvContext;
+	DWORD				m_cbBudget;
+	BOOL				m_fStopped;					// The callback returned S_FALSE
+
+	HASH_JOIN_SIDE		m_Build;
+	HASH_JOIN_SIDE		m_Probe;
+
+	BYTE				*m_pbRecord;				// Record being formatted
+	LPCWSTR				m_rgpwszBuild[HASH_JOIN_MAX_COLUMNS];
+
+	BYTE				*m_pbArena;					// Build records
+	DWORD				m_cbArena;
+	DWORD				m_cbArenaMax;
+	DWORD				m_cRecords;
+	HASH_JOIN_BUCKET	*m_rgBucket;
+	DWORD				m_cBuckets;					// Power of 2
+
+	BOOL				m_fSpilled;
+	WCHAR				m_wszSpillPrefix[MAX_PATH];	// Spill directory and file name prefix
+	BYTE				*m_pbRead;					// Read buffer of a probe partition
+	DWORD				m_cbRead;
+
+	HASH_JOIN_STATS		m_Stats;
+};
+
+#endif // !defined(AFX_HASHJOIN_H__8D2C4E71_B5A3_4F09_9C6E_3A71F0D5B248__INCLUDED_)
@@ -0,0 +1,979 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: MergeSync
+//
+// File: MergeSync.cpp
+//
+// Comment: Merge replication of the Northwind database, with per-table
+//			throughput reporting.
+//
+// Functions:
+//			1. Drive ISSCEMerge (AddSubscription, Initialize, Run, Terminate)
+//			2. Record per-table time, rows and bytes through
+//			   ISSCEStatusReporting
+//			3. Stand in for the publisher with a local .sdf file
+//
+// Notes:
+//			The agent reports table boundaries and overall progress only.
+//			Elapsed time per table comes from the boundaries, downloaded
+//			bytes from the growth of the subscriber file, and rows from
+//			counting the published tables before and after the run. The
+//			local stand-in publisher reports exact rows and bytes.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "ResultCache.h"
+#include "AddressIndex.h"
+#include "MergeSync.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeStatusReporter::MergeStatusReporter()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+MergeStatusReporter::MergeStatusReporter() : m_cRef(1),
+											 m_hWndNotify(NULL)
+{
+	InitializeCriticalSection(&m_cs);
+
+	m_wszSubscriber[0] = WCHAR('\0');
+	Reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeStatusReporter::~MergeStatusReporter()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+MergeStatusReporter::~MergeStatusReporter()
+{
+	DeleteCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// IUnknown
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT STDMETHODCALLTYPE MergeStatusReporter::QueryInterface(REFIID riid, void **ppvObject)
+{
+	if (NULL == ppvObject)
+	{
+		return E_POINTER;
+	}
+
+	if (IID_IUnknown == riid || IID_ISSCEStatusReporting == riid)
+	{
+		*ppvObject = (ISSCEStatusReporting*)this;
+		AddRef();
+		return NOERROR;
+	}
+
+	*ppvObject = NULL;
+	return E_NOINTERFACE;
+}
+
+ULONG STDMETHODCALLTYPE MergeStatusReporter::AddRef()
+{
+	return InterlockedIncrement(&m_cRef);
+}
+
+ULONG STDMETHODCALLTYPE MergeStatusReporter::Release()
+{
+	LONG cRef = InterlockedDecrement(&m_cRef);
+
+	if (0 == cRef)
+	{
+		delete this;
+	}
+
+	return cRef;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ISSCEStatusReporting
+//
+// The agent calls these from its own thread.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT STDMETHODCALLTYPE MergeStatusReporter::OnStartTableUpload(const WCHAR *wszTableName)
+{
+	BeginTable(wszTableName, MERGE_UPLOAD);
+	return NOERROR;
+}
+
+HRESULT STDMETHODCALLTYPE MergeStatusReporter::OnStartTableDownload(const WCHAR *wszTableName)
+{
+	BeginTable(wszTableName, MERGE_DOWNLOAD);
+	return NOERROR;
+}
+
+HRESULT STDMETHODCALLTYPE MergeStatusReporter::OnSynchronization(DWORD dwPrecentCompleted)
+{
+	DWORD		cRows;
+	ULONGLONG	cbBytes;
+	HWND		hWndNotify;
+
+	EnterCriticalSection(&m_cs);
+	m_dwPercent = dwPrecentCompleted;
+	hWndNotify	= m_hWndNotify;
+	LeaveCriticalSection(&m_cs);
+
+	if (hWndNotify)
+	{
+		GetTotals(&cRows, &cbBytes);
+		PostMessage(hWndNotify,
+					WM_MERGE_PROGRESS,
+					(WPARAM)dwPrecentCompleted,
+					(LPARAM)GetThroughputMBps100(cbBytes, GetTickCount() - m_dwStartMs));
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeStatusReporter::SetNotifyWindow()
+//
+// Description: Window that receives WM_MERGE_PROGRESS, NULL for none.
+//
+////////////////////////////////////////////////////////////////////////////////
+void MergeStatusReporter::SetNotifyWindow(HWND hWndNotify)
+{
+	EnterCriticalSection(&m_cs);
+	m_hWndNotify = hWndNotify;
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeStatusReporter::SetSubscriberDatabase()
+//
+// Description: Subscriber file whose growth measures downloaded bytes.
+//
+////////////////////////////////////////////////////////////////////////////////
+void MergeStatusReporter::SetSubscriberDatabase(LPCWSTR pwszDatabase)
+{
+	EnterCriticalSection(&m_cs);
+	wcsncpy(m_wszSubscriber, pwszDatabase ? pwszDatabase : L"", MAX_PATH - 1);
+	m_wszSubscriber[MAX_PATH - 1] = WCHAR('\0');
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeStatusReporter::Reset()
+//
+// Description: Discard the statistics of the previous run.
+//
+////////////////////////////////////////////////////////////////////////////////
+void MergeStatusReporter::Reset()
+{
+	EnterCriticalSection(&m_cs);
+	memset(m_rgTables, 0, sizeof(m_rgTables));
+	m_cTables		= 0;
+	m_fInTable		= FALSE;
+	m_cbTableStart	= 0;
+	m_dwPercent		= 0;
+	m_dwStartMs		= GetTickCount();
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeStatusReporter::Finish()
+//
+// Description: Close the statistics of the last table.
+//
+////////////////////////////////////////////////////////////////////////////////
+void MergeStatusReporter::Finish()
+{
+	EnterCriticalSection(&m_cs);
+	EndTable();
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeStatusReporter::BeginTable()
+//
+// Description: Close the current table and start a new entry.
+//
+////////////////////////////////////////////////////////////////////////////////
+void MergeStatusReporter::BeginTable(const WCHAR *wszTableName, DWORD dwDirection)
+{
+	MERGE_TABLE_STATS *pTable;
+
+	EnterCriticalSection(&m_cs);
+
+	EndTable();
+
+	if (m_cTables < MERGE_MAX_TABLES)
+	{
+		pTable = &m_rgTables[m_cTables++];
+
+		memset(pTable, 0, sizeof(MERGE_TABLE_STATS));
+		wcsncpy(pTable->wszTable, wszTableName ? wszTableName : L"", MERGE_MAX_TABLE_NAME);
+		pTable->dwDirection		= dwDirection;
+		pTable->dwStartMs		= GetTickCount();
+		pTable->dwPercentStart	= m_dwPercent;
+
+		m_cbTableStart	= GetSubscriberSize();
+		m_fInTable		= TRUE;
+	}
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeStatusReporter::EndTable()
+//
+// Description: Close the statistics of the current table. Called with the
+//				critical section held.
+//
+////////////////////////////////////////////////////////////////////////////////
+void MergeStatusReporter::EndTable()
+{
+	MERGE_TABLE_STATS	*pTable;
+	ULONGLONG			cbSize;
+
+	if (!m_fInTable)
+	{
+		return;
+	}
+
+	pTable = &m_rgTables[m_cTables - 1];
+	pTable->dwElapsedMs	 = GetTickCount() - pTable->dwStartMs;
+	pTable->dwPercentEnd = m_dwPercent;
+
+	// Without an exact byte count, use the growth of the subscriber file
+	//
+	if (MERGE_DOWNLOAD == pTable->dwDirection && 0 == pTable->cbBytes)
+	{
+		cbSize = GetSubscriberSize();
+		if (cbSize > m_cbTableStart)
+		{
+			pTable->cbBytes = cbSize - m_cbTableStart;
+		}
+	}
+
+	m_fInTable = FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeStatusReporter::GetSubscriberSize()
+//
+// Description: Returns the size of the subscriber file, 0 if unknown.
+//
+////////////////////////////////////////////////////////////////////////////////
+ULONGLONG MergeStatusReporter::GetSubscriberSize()
+{
+	ULONGLONG cbSize = 0;
+
+	if (WCHAR('\0') != m_wszSubscriber[0])
+	{
+		GetDatabaseFileSize(m_wszSubscriber, &cbSize);
+	}
+
+	return cbSize;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeStatusReporter::AddTableTransfer()
+//
+// Description: Add exact row and byte counts to the current table.
+//
+////////////////////////////////////////////////////////////////////////////////
+void MergeStatusReporter::AddTableTransfer(DWORD cRows, ULONGLONG cbBytes)
+{
+	EnterCriticalSection(&m_cs);
+
+	if (m_fInTable)
+	{
+		m_rgTables[m_cTables - 1].cRows	  += cRows;
+		m_rgTables[m_cTables - 1].cbBytes += cbBytes;
+	}
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeStatusReporter::AddTableRows()
+//
+// Description: Add a row count to the entry of a table, once the run is
+//				over. The entry is created if the agent did not report the
+//				table.
+//
+////////////////////////////////////////////////////////////////////////////////
+void MergeStatusReporter::AddTableRows(LPCWSTR pwszTable, DWORD dwDirection, DWORD cRows)
+{
+	DWORD dwIndex;
+
+	EnterCriticalSection(&m_cs);
+
+	for (dwIndex = 0; dwIndex < m_cTables; ++dwIndex)
+	{
+		if (dwDirection == m_rgTables[dwIndex].dwDirection &&
+			0 == _wcsicmp(m_rgTables[dwIndex].wszTable, pwszTable))
+		{
+			break;
+		}
+	}
+
+	if (dwIndex == m_cTables && m_cTables < MERGE_MAX_TABLES)
+	{
+		memset(&m_rgTables[dwIndex], 0, sizeof(MERGE_TABLE_STATS));
+		wcsncpy(m_rgTables[dwIndex].wszTable, pwszTable, MERGE_MAX_TABLE_NAME);
+		m_rgTables[dwIndex].dwDirection = dwDirection;
+		++m_cTables;
+	}
+
+	if (dwIndex < m_cTables)
+	{
+		m_rgTables[dwIndex].cRows += cRows;
+	}
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeStatusReporter::GetTableCount()
+//
+// Description: Returns the number of table entries.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD MergeStatusReporter::GetTableCount()
+{
+	DWORD cTables;
+
+	EnterCriticalSection(&m_cs);
+	cTables = m_cTables;
+	LeaveCriticalSection(&m_cs);
+
+	return cTables;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeStatusReporter::GetTableStats()
+//
+// Description: Copy the statistics of one table entry.
+//
+// Returns: FALSE if dwIndex is out of range
+//
+////////////////////////////////////////////////////////////////////////////////
+BOOL MergeStatusReporter::GetTableStats(DWORD dwIndex, MERGE_TABLE_STATS *pStats)
+{
+	BOOL fFound = FALSE;
+
+	EnterCriticalSection(&m_cs);
+
+	if (dwIndex < m_cTables && pStats)
+	{
+		*pStats = m_rgTables[dwIndex];
+		fFound	= TRUE;
+	}
+
+	LeaveCriticalSection(&m_cs);
+
+	return fFound;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeStatusReporter::GetTotals()
+//
+// Description: Sum rows and bytes over all table entries.
+//
+////////////////////////////////////////////////////////////////////////////////
+void MergeStatusReporter::GetTotals(DWORD *pcRows, ULONGLONG *pcbBytes)
+{
+	*pcRows	  = 0;
+	*pcbBytes = 0;
+
+	EnterCriticalSection(&m_cs);
+
+	for (DWORD dwIndex = 0; dwIndex < m_cTables; ++dwIndex)
+	{
+		*pcRows	  += m_rgTables[dwIndex].cRows;
+		*pcbBytes += m_rgTables[dwIndex].cbBytes;
+	}
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PutString
+//
+// Description: Set a string property of the merge agent. NULL strings are
+//				left at the agent default.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT PutString(ISSCEMerge *pISSCEMerge, HRESULT (STDMETHODCALLTYPE ISSCEMerge::*pfnPut)(BSTR), LPCWSTR pwszValue)
+{
+	HRESULT	hr;
+	BSTR	bstrValue;
+
+	if (NULL == pwszValue)
+	{
+		return NOERROR;
+	}
+
+	bstrValue = SysAllocString(pwszValue);
+	if (NULL == bstrValue)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	hr = (pISSCEMerge->*pfnPut)(bstrValue);
+
+	SysFreeString(bstrValue);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeSync::MergeSync()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+MergeSync::MergeSync() : m_pISSCEMerge(NULL),
+						 m_fCancel(FALSE)
+{
+	InitializeCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeSync::~MergeSync()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+MergeSync::~MergeSync()
+{
+	DeleteCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeSync::Run()
+//
+// Description: Synchronize the subscriber database.
+//
+// Parameters
+//		pSettings	- agent settings, or the local stand-in publisher
+//		pReporter	- receives the per-table statistics
+//		pResult		- receives the change counts and throughput
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT MergeSync::Run(const MERGE_SYNC_SETTINGS *pSettings, MergeStatusReporter *pReporter, MERGE_SYNC_RESULT *pResult)
+{
+	HRESULT	hr;
+	DWORD	dwStartMs;
+
+	if (NULL == pSettings || NULL == pSettings->pwszSubscriberDatabase || NULL == pReporter || NULL == pResult)
+	{
+		return E_INVALIDARG;
+	}
+
+	memset(pResult, 0, sizeof(MERGE_SYNC_RESULT));
+	InterlockedExchange(&m_fCancel, FALSE);
+
+	pReporter->Reset();
+	pReporter->SetSubscriberDatabase(pSettings->pwszSubscriberDatabase);
+
+	dwStartMs = GetTickCount();
+
+	if (pSettings->pwszLocalPublisher)
+	{
+		hr = RunLocalPublisher(pSettings, pReporter, pResult);
+	}
+	else
+	{
+		hr = RunAgent(pSettings, pReporter, pResult);
+	}
+
+	// The download may have changed any row
+	//
+	g_ResultCache.InvalidateAll();
+	g_AddressIndex.MarkAllChanged();
+
+	pReporter->Finish();
+	pReporter->GetTotals(&pResult->cRows, &pResult->cbBytes);
+
+	pResult->dwElapsedMs = GetTickCount() - dwStartMs;
+	pResult->dwMBps100	 = GetThroughputMBps100(pResult->cbBytes, pResult->dwElapsedMs);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeSync::Cancel()
+//
+// Description: Cancel the run in progress, from another thread.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT MergeSync::Cancel()
+{
+	HRESULT hr = S_FALSE;
+
+	InterlockedExchange(&m_fCancel, TRUE);
+
+	EnterCriticalSection(&m_cs);
+	if (m_pISSCEMerge)
+	{
+		hr = m_pISSCEMerge->Cancel();
+	}
+	LeaveCriticalSection(&m_cs);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeSync::RunAgent()
+//
+// Description: Synchronize through the SQL Server Compact replication agent.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT MergeSync::RunAgent(const MERGE_SYNC_SETTINGS *pSettings, MergeStatusReporter *pReporter, MERGE_SYNC_RESULT *pResult)
+{
+	HRESULT				hr					= NOERROR;
+	ISSCEMerge			*pISSCEMerge		= NULL;		// Replication agent
+	WCHAR				wszConnect[MAX_PATH + 32];		// Subscriber connection string
+	LONG				*rglRowsBefore		= NULL;		// Row counts before the run
+	LONG				*rglRowsAfter		= NULL;		// Row counts after the run
+	BOOL				fCounted			= FALSE;
+	BOOL				fInitialized		= FALSE;
+	WIN32_FIND_DATA		FindFileData;
+	HANDLE				hFind;
+	long				lValue;
+
+	if (pSettings->cTables)
+	{
+		rglRowsBefore = (LONG*)CoTaskMemAlloc(sizeof(LONG)*pSettings->cTables);
+		rglRowsAfter  = (LONG*)CoTaskMemAlloc(sizeof(LONG)*pSettings->cTables);
+		if (NULL == rglRowsBefore || NULL == rglRowsAfter)
+		{
+			hr = E_OUTOFMEMORY;
+			goto Exit;
+		}
+
+		// A first synchronization creates the database, there is nothing
+		// to count yet
+		//
+		fCounted = SUCCEEDED(CountRows(pSettings, rglRowsBefore));
+	}
+
+	hr = CoCreateInstance(CLSID_Replication, NULL, CLSCTX_INPROC_SERVER, IID_ISSCEMerge, (void**)&pISSCEMerge);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	wsprintf(wszConnect, L"Data Source=%s", pSettings->pwszSubscriberDatabase);
+
+	if (FAILED(hr = PutString(pISSCEMerge, &ISSCEMerge::put_SubscriberConnectionString, wszConnect)) ||
+		FAILED(hr = PutString(pISSCEMerge, &ISSCEMerge::put_Subscriber,		pSettings->pwszSubscriber)) ||
+		FAILED(hr = PutString(pISSCEMerge, &ISSCEMerge::put_InternetURL,		pSettings->pwszInternetURL)) ||
+		FAILED(hr = PutString(pISSCEMerge, &ISSCEMerge::put_InternetLogin,	pSettings->pwszInternetLogin)) ||
+		FAILED(hr = PutString(pISSCEMerge, &ISSCEMerge::put_InternetPassword, pSettings->pwszInternetPassword)) ||
+		FAILED(hr = PutString(pISSCEMerge, &ISSCEMerge::put_Publisher,		pSettings->pwszPublisher)) ||
+		FAILED(hr = PutString(pISSCEMerge, &ISSCEMerge::put_PublisherDatabase, pSettings->pwszPublisherDatabase)) ||
+		FAILED(hr = PutString(pISSCEMerge, &ISSCEMerge::put_Publication,		pSettings->pwszPublication)) ||
+		FAILED(hr = PutString(pISSCEMerge, &ISSCEMerge::put_PublisherLogin,	pSettings->pwszPublisherLogin)) ||
+		FAILED(hr = PutString(pISSCEMerge, &ISSCEMerge::put_PublisherPassword, pSettings->pwszPublisherPassword)))
+	{
+		goto Exit;
+	}
+
+	hr = pISSCEMerge->put_PublisherSecurityMode(pSettings->ePublisherSecurityMode);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pISSCEMerge->put_ExchangeType(pSettings->eExchangeType);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pISSCEMerge->put_CompressionLevel(pSettings->nCompressionLevel);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	if ((pSettings->lConnectTimeout && FAILED(hr = pISSCEMerge->put_ConnectTimeout(pSettings->lConnectTimeout))) ||
+		(pSettings->lSendTimeout	&& FAILED(hr = pISSCEMerge->put_SendTimeout(pSettings->lSendTimeout))) ||
+		(pSettings->lReceiveTimeout && FAILED(hr = pISSCEMerge->put_ReceiveTimeout(pSettings->lReceiveTimeout))))
+	{
+		goto Exit;
+	}
+
+	hr = pISSCEMerge->put_StatusReportingHandler(pReporter);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Create the subscription on the first synchronization
+	//
+	hFind = FindFirstFile(pSettings->pwszSubscriberDatabase, &FindFileData);
+	if (INVALID_HANDLE_VALUE != hFind)
+	{
+		FindClose(hFind);
+	}
+	else
+	{
+		hr = pISSCEMerge->AddSubscription(CREATE_DATABASE);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+	}
+
+	hr = pISSCEMerge->Initialize();
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	fInitialized = TRUE;
+
+	// Publish the agent so that Cancel can reach it
+	//
+	EnterCriticalSection(&m_cs);
+	m_pISSCEMerge = pISSCEMerge;
+	LeaveCriticalSection(&m_cs);
+
+	hr = m_fCancel ? E_ABORT : pISSCEMerge->Run();
+
+	EnterCriticalSection(&m_cs);
+	m_pISSCEMerge = NULL;
+	LeaveCriticalSection(&m_cs);
+
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	if (SUCCEEDED(pISSCEMerge->get_PublisherChanges(&lValue)))
+	{
+		pResult->cPublisherChanges = lValue;
+	}
+
+	if (SUCCEEDED(pISSCEMerge->get_PublisherConflicts(&lValue)))
+	{
+		pResult->cPublisherConflicts = lValue;
+	}
+
+	if (SUCCEEDED(pISSCEMerge->get_SubscriberChanges(&lValue)))
+	{
+		pResult->cSubscriberChanges = lValue;
+	}
+
+	if (SUCCEEDED(pISSCEMerge->get_SubscriberConflicts(&lValue)))
+	{
+		pResult->cSubscriberConflicts = lValue;
+	}
+
+Exit:
+	if (fInitialized)
+	{
+		pISSCEMerge->Terminate();
+	}
+
+	if (pISSCEMerge)
+	{
+		pISSCEMerge->put_StatusReportingHandler(NULL);
+		pISSCEMerge->Release();
+	}
+
+	// The net row count change of each table is what the run downloaded
+	//
+	if (SUCCEEDED(hr) && pSettings->cTables && SUCCEEDED(CountRows(pSettings, rglRowsAfter)))
+	{
+		for (DWORD dwTable = 0; dwTable < pSettings->cTables; ++dwTable)
+		{
+			LONG lDelta = rglRowsAfter[dwTable] - (fCounted ? rglRowsBefore[dwTable] : 0);
+
+			pReporter->AddTableRows(pSettings->rgpwszTables[dwTable], MERGE_DOWNLOAD, (DWORD)(lDelta < 0 ? -lDelta : lDelta));
+		}
+	}
+
+	if (rglRowsBefore)
+	{
+		CoTaskMemFree(rglRowsBefore);
+	}
+
+	if (rglRowsAfter)
+	{
+		CoTaskMemFree(rglRowsAfter);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeSync::RunLocalPublisher()
+//
+// Description: Synchronize against a local .sdf file standing in for the
+//				publisher. Uploads copy the published tables from the
+//				subscriber to the stand-in, downloads copy them back. The
+//				status reporter receives the same calls the agent makes.
+//
+// Notes:
+//			A missing stand-in is seeded with a copy of the subscriber.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT MergeSync::RunLocalPublisher(const MERGE_SYNC_SETTINGS *pSettings, MergeStatusReporter *pReporter, MERGE_SYNC_RESULT *pResult)
+{
+	HRESULT				hr					= NOERROR;
+	IDBCreateSession	*pISubscriber		= NULL;		// Subscriber data source
+	IDBCreateSession	*pIPublisher		= NULL;		// Stand-in publisher data source
+	WIN32_FIND_DATA		FindFileData;
+	HANDLE				hFind;
+	DWORD				cSteps;
+	DWORD				dwStep				= 0;
+	DWORD				dwTable;
+	DWORD				cRows;
+	ULONGLONG			cbBytes;
+
+	hFind = FindFirstFile(pSettings->pwszLocalPublisher, &FindFileData);
+	if (INVALID_HANDLE_VALUE != hFind)
+	{
+		FindClose(hFind);
+	}
+	else if (!CopyFile(pSettings->pwszSubscriberDatabase, pSettings->pwszLocalPublisher, TRUE))
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto Exit;
+	}
+
+	hr = OpenDataSource(pSettings->pwszSubscriberDatabase, &pISubscriber);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = OpenDataSource(pSettings->pwszLocalPublisher, &pIPublisher);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	cSteps = pSettings->cTables * ((BIDIRECTIONAL == pSettings->eExchangeType) ? 2 : 1);
+
+	// Upload
+	//
+	for (dwTable = 0; dwTable < pSettings->cTables; ++dwTable)
+	{
+		if (m_fCancel)
+		{
+			hr = E_ABORT;
+			goto Exit;
+		}
+
+		pReporter->OnStartTableUpload(pSettings->rgpwszTables[dwTable]);
+
+		hr = CopyTable(pISubscriber, pIPublisher, pSettings->rgpwszTables[dwTable], &cRows, &cbBytes);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		pReporter->AddTableTransfer(cRows, cbBytes);
+		pResult->cSubscriberChanges += cRows;
+
+		pReporter->OnSynchronization((++dwStep * 100) / cSteps);
+	}
+
+	// Download
+	//
+	if (BIDIRECTIONAL == pSettings->eExchangeType)
+	{
+		for (dwTable = 0; dwTable < pSettings->cTables; ++dwTable)
+		{
+			if (m_fCancel)
+			{
+				hr = E_ABORT;
+				goto Exit;
+			}
+
+			pReporter->OnStartTableDownload(pSettings->rgpwszTables[dwTable]);
+
+			hr = CopyTable(pIPublisher, pISubscriber, pSettings->rgpwszTables[dwTable], &cRows, &cbBytes);
+			if(FAILED(hr))
+			{
+				goto Exit;
+			}
+
+			pReporter->AddTableTransfer(cRows, cbBytes);
+			pResult->cPublisherChanges += cRows;
+
+			pReporter->OnSynchronization((++dwStep * 100) / cSteps);
+		}
+	}
+
+Exit:
+	if (pIPublisher)
+	{
+		pIPublisher->Release();
+	}
+
+	if (pISubscriber)
+	{
+		pISubscriber->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeSync::CopyTable()
+//
+// Description: Replace the rows of a table with the rows of the same table
+//				in another database, in one transaction.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT MergeSync::CopyTable(IDBCreateSession *pISrc, IDBCreateSession *pIDst, LPCWSTR pwszTable, DWORD *pcRows, ULONGLONG *pcbBytes)
+{
+	HRESULT				hr				= NOERROR;
+	IOpenRowset			*pISrcSession	= NULL;			// Provider Interface Pointer
+	IOpenRowset			*pIDstSession	= NULL;			// Provider Interface Pointer
+	IRowset				*pISrcRowset	= NULL;			// Provider Interface Pointer
+	ITransactionLocal	*pITxnLocal		= NULL;			// Provider Interface Pointer
+	WCHAR				wszQuery[MERGE_MAX_TABLE_NAME + 32];
+
+	*pcRows	  = 0;
+	*pcbBytes = 0;
+
+	hr = pISrc->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pISrcSession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = OpenTableRowset(pISrcSession, pwszTable, NULL, 0, IID_IRowset, (IUnknown**)&pISrcRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIDst->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pIDstSession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIDstSession->QueryInterface(IID_ITransactionLocal, (void**)&pITxnLocal);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pITxnLocal->StartTransaction(ISOLATIONLEVEL_READCOMMITTED | ISOLATIONLEVEL_CURSORSTABILITY, 0, NULL, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	wsprintf(wszQuery, L"DELETE FROM [%s]", pwszTable);
+	hr = ExecuteCommand(pIDstSession, wszQuery);
+	if(FAILED(hr))
+	{
+		goto Abort;
+	}
+
+	hr = CopyRowset(pISrcRowset, pIDstSession, pwszTable, pcRows, pcbBytes);
+	if(FAILED(hr))
+	{
+		goto Abort;
+	}
+
+	hr = pITxnLocal->Commit(FALSE, XACTTC_SYNC, 0);
+	goto Exit;
+
+Abort:
+	pITxnLocal->Abort(NULL, FALSE, FALSE);
+
+Exit:
+	if (pITxnLocal)
+	{
+		pITxnLocal->Release();
+	}
+
+	if (pISrcRowset)
+	{
+		pISrcRowset->Release();
+	}
+
+	if (pISrcSession)
+	{
+		pISrcSession->Release();
+	}
+
+	if (pIDstSession)
+	{
+		pIDstSession->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergeSync::CountRows()
+//
+// Description: Count the rows of each published table of the subscriber.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT MergeSync::CountRows(const MERGE_SYNC_SETTINGS *pSettings, LONG *rglRows)
+{
+	HRESULT				hr				= NOERROR;
+	IDBCreateSession	*pISubscriber	= NULL;			// Subscriber data source
+	IOpenRowset			*pISession		= NULL;			// Provider Interface Pointer
+	WCHAR				wszQuery[MERGE_MAX_TABLE_NAME + 32];
+	BOOL				fNull;
+
+	hr = OpenDataSource(pSettings->pwszSubscriberDatabase, &pISubscriber);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pISubscriber->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pISession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	for (DWORD dwTable = 0; dwTable < pSettings->cTables; ++dwTable)
+	{
+		wsprintf(wszQuery, L"SELECT COUNT(*) FROM [%s]", pSettings->rgpwszTables[dwTable]);
+
+		hr = ExecuteScalar(pISession, wszQuery, &rglRows[dwTable], &fNull);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+	}
+
+Exit:
+	if (pISession)
+	{
+		pISession->Release();
+	}
+
+	if (pISubscriber)
+	{
+		pISubscriber->Release();
+	}
+
+	return hr;
+}
@@ -0,0 +1,184 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: MergeSync
+//
+// File: MergeSync.h
+//
+// Comment: Merge replication of the Northwind database, with per-table
+//			throughput reporting.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_MERGESYNC_H__5E8D1B04_72A3_4C96_B1E7_0F3A64C28D95__INCLUDED_)
+#define AFX_MERGESYNC_H__5E8D1B04_72A3_4C96_B1E7_0F3A64C28D95__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include "sqlce_sync.h"
+
+#define MERGE_MAX_TABLES			64
+#define MERGE_MAX_TABLE_NAME		128
+
+// Direction of a table transfer
+//
+#define MERGE_UPLOAD				1
+#define MERGE_DOWNLOAD				2
+
+// Progress message posted to the notification window.
+// wParam is the percentage completed, lParam the throughput in hundredths
+// of MB/s so far.
+//
+#define WM_MERGE_PROGRESS			(WM_APP + 0x28)
+
+////////////////////////////////////////////////////////////////////////////////
+// Statistics of one table transfer
+//
+typedef struct tagMERGE_TABLE_STATS
+{
+	WCHAR		wszTable[MERGE_MAX_TABLE_NAME + 1];
+	DWORD		dwDirection;			// MERGE_UPLOAD or MERGE_DOWNLOAD
+	DWORD		dwStartMs;				// GetTickCount() when the table started
+	DWORD		dwElapsedMs;
+	DWORD		dwPercentStart;			// Overall progress when the table started
+	DWORD		dwPercentEnd;
+	DWORD		cRows;
+	ULONGLONG	cbBytes;
+} MERGE_TABLE_STATS;
+
+////////////////////////////////////////////////////////////////////////////////
+// Synchronization settings. Strings that are NULL are not set on the agent.
+//
+typedef struct tagMERGE_SYNC_SETTINGS
+{
+	LPCWSTR				pwszSubscriberDatabase;		// Local .sdf file
+	LPCWSTR				pwszSubscriber;
+
+	LPCWSTR				pwszInternetURL;			// sqlcesa35.dll URL
+	LPCWSTR				pwszInternetLogin;
+	LPCWSTR				pwszInternetPassword;
+
+	LPCWSTR				pwszPublisher;
+	LPCWSTR				pwszPublisherDatabase;
+	LPCWSTR				pwszPublication;
+	LPCWSTR				pwszPublisherLogin;
+	LPCWSTR				pwszPublisherPassword;
+	REPL_SECURITY_TYPE	ePublisherSecurityMode;
+
+	REPL_EXCHANGE_TYPE	eExchangeType;
+	short				nCompressionLevel;			// 0 - 6, 1 is the agent default
+	LONG				lConnectTimeout;			// Milliseconds, 0 keeps the default
+	LONG				lSendTimeout;
+	LONG				lReceiveTimeout;
+
+	// Published tables. The agent does not report row counts per table, so
+	// the driver counts the rows of these tables before and after the run.
+	// The local stand-in publisher copies exactly these tables.
+	//
+	LPCWSTR				*rgpwszTables;
+	DWORD				cTables;
+
+	// When set, the named .sdf file stands in for the publisher and no
+	// network or server is involved. Used to benchmark offline.
+	//
+	LPCWSTR				pwszLocalPublisher;
+} MERGE_SYNC_SETTINGS;
+
+////////////////////////////////////////////////////////////////////////////////
+// Result of a synchronization
+//
+typedef struct tagMERGE_SYNC_RESULT
+{
+	DWORD		dwElapsedMs;
+	LONG		cPublisherChanges;
+	LONG		cPublisherConflicts;
+	LONG		cSubscriberChanges;
+	LONG		cSubscriberConflicts;
+	DWORD		cRows;					// Sum over the table statistics
+	ULONGLONG	cbBytes;
+	DWORD		dwMBps100;				// Throughput in hundredths of MB/s
+} MERGE_SYNC_RESULT;
+
+////////////////////////////////////////////////////////////////////////////////
+// ISSCEStatusReporting sink. Each OnStartTable* call closes the statistics
+// of the previous table and opens a new entry.
+//
+class MergeStatusReporter : public ISSCEStatusReporting
+{
+public:
+	MergeStatusReporter();
+	virtual ~MergeStatusReporter();
+
+	// IUnknown
+	//
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject);
+	ULONG	STDMETHODCALLTYPE AddRef();
+	ULONG	STDMETHODCALLTYPE Release();
+
+	// ISSCEStatusReporting
+	//
+	HRESULT STDMETHODCALLTYPE OnStartTableUpload(const WCHAR *wszTableName);
+	HRESULT STDMETHODCALLTYPE OnStartTableDownload(const WCHAR *wszTableName);
+	HRESULT STDMETHODCALLTYPE OnSynchronization(DWORD dwPrecentCompleted);
+
+	void	SetNotifyWindow(HWND hWndNotify);
+	void	SetSubscriberDatabase(LPCWSTR pwszDatabase);
+	void	Reset();
+	void	Finish();
+
+	void	AddTableTransfer(DWORD cRows, ULONGLONG cbBytes);
+	void	AddTableRows(LPCWSTR pwszTable, DWORD dwDirection, DWORD cRows);
+
+	DWORD	GetTableCount();
+	BOOL	GetTableStats(DWORD dwIndex, MERGE_TABLE_STATS *pStats);
+	void	GetTotals(DWORD *pcRows, ULONGLONG *pcbBytes);
+
+private:
+	void		BeginTable(const WCHAR *wszTableName, DWORD dwDirection);
+	void		EndTable();
+	ULONGLONG	GetSubscriberSize();
+
+	LONG				m_cRef;
+	CRITICAL_SECTION	m_cs;
+	HWND				m_hWndNotify;
+	WCHAR				m_wszSubscriber[MAX_PATH];
+
+	MERGE_TABLE_STATS	m_rgTables[MERGE_MAX_TABLES];
+	DWORD				m_cTables;
+	BOOL				m_fInTable;
+	ULONGLONG			m_cbTableStart;			// Subscriber size when the table started
+	DWORD				m_dwStartMs;			// GetTickCount() when the run started
+	DWORD				m_dwPercent;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Runs one merge synchronization, through the replication agent or the
+// local stand-in publisher.
+//
+class MergeSync
+{
+public:
+	MergeSync();
+	~MergeSync();
+
+	HRESULT Run(const MERGE_SYNC_SETTINGS *pSettings, MergeStatusReporter *pReporter, MERGE_SYNC_RESULT *pResult);
+	HRESULT Cancel();
+
+private:
+	HRESULT RunAgent(const MERGE_SYNC_SETTINGS *pSettings, MergeStatusReporter *pReporter, MERGE_SYNC_RESULT *pResult);
+	HRESULT RunLocalPublisher(const MERGE_SYNC_SETTINGS *pSettings, MergeStatusReporter *pReporter, MERGE_SYNC_RESULT *pResult);
+	HRESULT CopyTable(IDBCreateSession *pISrc, IDBCreateSession *pIDst, LPCWSTR pwszTable, DWORD *pcRows, ULONGLONG *pcbBytes);
+	HRESULT CountRows(const MERGE_SYNC_SETTINGS *pSettings, LONG *rglRows);
+
+	CRITICAL_SECTION	m_cs;					// Guards m_pISSCEMerge
+	ISSCEMerge			*m_pISSCEMerge;			// Agent of the run in progress
+	LONG				m_fCancel;
+};
+
+#endif // !defined(AFX_MERGESYNC_H__5E8D1B04_72A3_4C96_B1E7_0F3A64C28D95__INCLUDED_)
@@ -0,0 +1,717 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: EmployeeParallelScan
+//
+// File: ParallelScan.cpp
+//
+// Comment: Scan of Employees split into key ranges read in parallel.
+//
+// Functions:
+//			1. Split the EmployeeID key space into ranges of similar size
+//			2. Read each range on its own session and thread through
+//			   SetRange on PK_Employees
+//			3. Pass the rows on as they are read, or merge the ranges in
+//			   key order
+//
+// Notes:
+//			The ranges are planned from the row counts of
+//			PARALLEL_SCAN_SLICES evenly spaced key ranges per partition,
+//			which the provider answers from the index. The counts are
+//			taken only when there is more than one partition. Ranges
+//			follow each other in key order, so the ordered merge reads
+//			the partitions one after the other while the later ones read
+//			ahead into their queues. The sessions of the partitions are
+//			checked out before any thread starts, so the merge never waits
+//			for a partition that waits for a session.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "EmployeeSchema.h"
+#include "SessionPool.h"
+#include "ParallelScan.h"
+
+static const DWORD s_rgiKeyColumn[] = { EMPLOYEE_COL_EMPLOYEE_ID };
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeParallelScan::EmployeeParallelScan()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeeParallelScan::EmployeeParallelScan() :	m_cColumns(0),
+												m_dwFlags(0),
+												m_pfnRow(NULL),
+												m_pvContext(NULL),
+												m_fCancel(FALSE),
+												m_cPartitions(0)
+{
+	memset(m_rgiColumn, 0, sizeof(m_rgiColumn));
+	memset(m_rgPartition, 0, sizeof(m_rgPartition));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeeParallelScan::~EmployeeParallelScan()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeeParallelScan::~EmployeeParallelScan()
+{
+	FreePartitions();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Scan
+//
+// Description: Scan Employees on several threads.
+//
+// Parameters
+//		pSessionPool	- sessions of the partitions, at least one
+//		rgiColumn		- columns bound for the callback, EMPLOYEE_COL_*
+//		cColumns		- number of columns
+//		cPartitions		- key ranges and threads, 0 for one per processor,
+//						  fewer if the pool has fewer sessions to give
+//		dwFlags			- PARALLEL_SCAN_* options
+//		pfnRow			- receives the rows
+//		pvContext		- passed to pfnRow
+//		pStats			- optionally receives the scan statistics
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeParallelScan::Scan(SessionPool				*pSessionPool,
+								   const DWORD				*rgiColumn,
+								   DWORD					cColumns,
+								   DWORD					cPartitions,
+								   DWORD					dwFlags,
+								   PFN_PARALLEL_SCAN_ROW	pfnRow,
+								   LPVOID					pvContext,
+								   PARALLEL_SCAN_STATS		*pStats)
+{
+	HRESULT					hr					= NOERROR;			// Error code reporting
+	HANDLE					rghThreads[PARALLEL_SCAN_MAX_PARTITIONS];
+	DWORD					cThreads			= 0;
+	PARALLEL_SCAN_STATS		Stats;
+	SYSTEM_INFO				SystemInfo;
+	DWORD					dwStart				= GetTickCount();
+	DWORD					iPartition;
+	DWORD					dwIndex;
+	POOLED_SESSION			*rgpSession[PARALLEL_SCAN_MAX_PARTITIONS];
+	DWORD					cSessions			= 0;
+
+	if (NULL == pSessionPool || NULL == rgiColumn || NULL == pfnRow || 0 == cColumns || cColumns > EMPLOYEE_SCHEMA_SIZE)
+	{
+		return E_INVALIDARG;
+	}
+
+	for (dwIndex = 0; dwIndex < cColumns; ++dwIndex)
+	{
+		if (rgiColumn[dwIndex] >= EMPLOYEE_SCHEMA_SIZE || DBTYPE_IUNKNOWN == g_rgEmployeeSchema[rgiColumn[dwIndex]].wBindType)
+		{
+			return E_INVALIDARG;
+		}
+
+		m_rgiColumn[dwIndex] = rgiColumn[dwIndex];
+	}
+
+	if (0 == cPartitions)
+	{
+		GetSystemInfo(&SystemInfo);
+		cPartitions = SystemInfo.dwNumberOfProcessors ? SystemInfo.dwNumberOfProcessors : 1;
+	}
+
+	if (cPartitions > PARALLEL_SCAN_MAX_PARTITIONS)
+	{
+		cPartitions = PARALLEL_SCAN_MAX_PARTITIONS;
+	}
+
+	FreePartitions();
+	memset(&Stats, 0, sizeof(Stats));
+
+	m_cColumns			= cColumns;
+	m_dwFlags			= dwFlags;
+	m_pfnRow			= pfnRow;
+	m_pvContext			= pvContext;
+	m_fCancel			= FALSE;
+
+	// A session per partition, all checked out before the threads start.
+	// Waits for the first one only, and scans on as many as the pool gives.
+	//
+	hr = pSessionPool->CheckOut(INFINITE, &rgpSession[0]);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	for (cSessions = 1; cSessions < cPartitions; ++cSessions)
+	{
+		if (FAILED(pSessionPool->CheckOut(0, &rgpSession[cSessions])))
+		{
+			break;
+		}
+	}
+
+	// Plan the ranges on the session of the first partition
+	//
+	hr = CheckEmployeeSchema(rgpSession[0]->pISession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = PlanPartitions(rgpSession[0]->pISession, cSessions);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	for (iPartition = 0; iPartition < m_cPartitions; ++iPartition)
+	{
+		m_rgPartition[iPartition].pSession = rgpSession[iPartition];
+	}
+
+	Stats.dwPlanMs = GetTickCount() - dwStart;
+
+	if (m_dwFlags & PARALLEL_SCAN_ORDERED)
+	{
+		for (iPartition = 0; iPartition < m_cPartitions; ++iPartition)
+		{
+			PARALLEL_SCAN_PARTITION *pPartition = &m_rgPartition[iPartition];
+
+			pPartition->rgRows	= (EMPLOYEE_ROW*)CoTaskMemAlloc(PARALLEL_SCAN_QUEUE_ROWS * sizeof(EMPLOYEE_ROW));
+			pPartition->hFree	= CreateSemaphore(NULL, PARALLEL_SCAN_QUEUE_ROWS, PARALLEL_SCAN_QUEUE_ROWS + 1, NULL);
+			pPartition->hFilled	= CreateSemaphore(NULL, 0, PARALLEL_SCAN_QUEUE_ROWS + 1, NULL);
+
+			if (NULL == pPartition->rgRows || NULL == pPartition->hFree || NULL == pPartition->hFilled)
+			{
+				hr = E_OUTOFMEMORY;
+				goto Exit;
+			}
+		}
+	}
+
+	// Fan out, a thread per range
+	//
+	for (iPartition = 0; iPartition < m_cPartitions; ++iPartition)
+	{
+		rghThreads[cThreads] = CreateThread(NULL, 0, ScanThreadProc, &m_rgPartition[iPartition], 0, NULL);
+		if (NULL == rghThreads[cThreads])
+		{
+			hr = HRESULT_FROM_WIN32(GetLastError());
+			Cancel();
+			break;
+		}
+
+		++cThreads;
+	}
+
+	if (SUCCEEDED(hr) && (m_dwFlags & PARALLEL_SCAN_ORDERED))
+	{
+		hr = MergePartitions();
+	}
+
+	if (cThreads)
+	{
+		WaitForMultipleObjects(cThreads, rghThreads, TRUE, INFINITE);
+	}
+
+	for (iPartition = 0; iPartition < cThreads; ++iPartition)
+	{
+		CloseHandle(rghThreads[iPartition]);
+	}
+
+	for (iPartition = 0; iPartition < m_cPartitions; ++iPartition)
+	{
+		if (SUCCEEDED(hr) && FAILED(m_rgPartition[iPartition].hr))
+		{
+			hr = m_rgPartition[iPartition].hr;
+		}
+
+		Stats.rgcRows[iPartition]	= m_rgPartition[iPartition].cRows;
+		Stats.cRows					+= m_rgPartition[iPartition].cRows;
+	}
+
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = NOERROR;
+
+	Stats.cPartitions	= m_cPartitions;
+	Stats.dwElapsedMs	= GetTickCount() - dwStart;
+
+	if (pStats)
+	{
+		*pStats = Stats;
+	}
+
+Exit:
+	FreePartitions();
+
+	for (iPartition = 0; iPartition < cSessions; ++iPartition)
+	{
+		pSessionPool->CheckIn(rgpSession[iPartition], FALSE);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PlanPartitions
+//
+// Description: Split the EmployeeID key space into ranges of about the same
+//				number of rows. Evenly spaced key ranges are counted and
+//				handed out in order until each partition has its share.
+//
+// Parameters
+//		pISession	- session of the calling thread
+//		cPartitions	- partitions wanted, fewer are planned for small tables
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeParallelScan::PlanPartitions(IUnknown *pISession, DWORD cPartitions)
+{
+	HRESULT		hr							= NOERROR;
+	WCHAR		wszQuery[256];
+	LPCWSTR		pwszKey						= g_rgEmployeeSchema[EMPLOYEE_COL_EMPLOYEE_ID].pwszName;
+	LONG		rglSliceFirst[PARALLEL_SCAN_MAX_PARTITIONS * PARALLEL_SCAN_SLICES + 1];
+	LONG		rgcSliceRows[PARALLEL_SCAN_MAX_PARTITIONS * PARALLEL_SCAN_SLICES];
+	ULONGLONG	cTotalRows					= 0;
+	ULONGLONG	cRows						= 0;
+	LONGLONG	llSpan;
+	LONG		lMin;
+	LONG		lMax;
+	BOOL		fNull;
+	DWORD		cSlices;
+	DWORD		iSlice;
+
+	m_cPartitions = 0;
+
+	wsprintf(wszQuery, L"SELECT MIN(%s) FROM %s", pwszKey, TABLE_EMPLOYEE);
+
+	hr = ExecuteScalar(pISession, wszQuery, &lMin, &fNull);
+	if(FAILED(hr) || fNull)
+	{
+		// Nothing to scan
+		//
+		return hr;
+	}
+
+	wsprintf(wszQuery, L"SELECT MAX(%s) FROM %s", pwszKey, TABLE_EMPLOYEE);
+
+	hr = ExecuteScalar(pISession, wszQuery, &lMax, &fNull);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	llSpan	= (LONGLONG)lMax - lMin + 1;
+	cSlices	= cPartitions * PARALLEL_SCAN_SLICES;
+	if ((LONGLONG)cSlices > llSpan)
+	{
+		cSlices = (DWORD)llSpan;
+	}
+
+	if (1 == cPartitions || 1 == cSlices)
+	{
+		m_rgPartition[0].lFirst	= lMin;
+		m_rgPartition[0].lLast	= lMax;
+		m_cPartitions			= 1;
+
+		goto Exit;
+	}
+
+	for (iSlice = 0; iSlice <= cSlices; ++iSlice)
+	{
+		rglSliceFirst[iSlice] = (LONG)(lMin + llSpan * iSlice / cSlices);
+	}
+
+	for (iSlice = 0; iSlice < cSlices; ++iSlice)
+	{
+		wsprintf(wszQuery,
+				 L"SELECT COUNT(*) FROM %s WHERE %s >= %d AND %s <= %d",
+				 TABLE_EMPLOYEE,
+				 pwszKey,
+				 rglSliceFirst[iSlice],
+				 pwszKey,
+				 rglSliceFirst[iSlice + 1] - 1);
+
+		hr = ExecuteScalar(pISession, wszQuery, &rgcSliceRows[iSlice], &fNull);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+
+		cTotalRows += rgcSliceRows[iSlice];
+	}
+
+	// Close a partition once the rows so far reach its share of the total
+	//
+	m_rgPartition[0].lFirst = lMin;
+
+	for (iSlice = 0; iSlice < cSlices; ++iSlice)
+	{
+		cRows += rgcSliceRows[iSlice];
+
+		if (iSlice + 1 < cSlices &&
+			m_cPartitions + 1 < cPartitions &&
+			cRows * cPartitions >= cTotalRows * (m_cPartitions + 1))
+		{
+			m_rgPartition[m_cPartitions].lLast		= rglSliceFirst[iSlice + 1] - 1;
+			m_rgPartition[m_cPartitions + 1].lFirst	= rglSliceFirst[iSlice + 1];
+			++m_cPartitions;
+		}
+	}
+
+	m_rgPartition[m_cPartitions].lLast = lMax;
+	++m_cPartitions;
+
+Exit:
+	for (DWORD iPartition = 0; iPartition < m_cPartitions; ++iPartition)
+	{
+		m_rgPartition[iPartition].pThis			= this;
+		m_rgPartition[iPartition].iPartition	= iPartition;
+		m_rgPartition[iPartition].hr			= NOERROR;
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ScanThreadProc
+//
+// Description: Thread of a partition.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD WINAPI EmployeeParallelScan::ScanThreadProc(LPVOID lpParameter)
+{
+	PARALLEL_SCAN_PARTITION	*pPartition = (PARALLEL_SCAN_PARTITION*)lpParameter;
+	BOOL					fCoInit		= SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+
+	pPartition->hr = pPartition->pThis->ScanPartition(pPartition);
+
+	// The merge sees the end of the partition after its result
+	//
+	if (pPartition->hFilled)
+	{
+		InterlockedExchange(&pPartition->fDone, TRUE);
+		ReleaseSemaphore(pPartition->hFilled, 1, NULL);
+	}
+
+	if (fCoInit)
+	{
+		CoUninitialize();
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ScanPartition
+//
+// Description: Read the rows of a key range on the session checked out
+//				for it, and pass them to the callback or to the queue of
+//				the merge.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeParallelScan::ScanPartition(PARALLEL_SCAN_PARTITION *pPartition)
+{
+	HRESULT				hr					= NOERROR;			// Error code reporting
+	HRESULT				hrFetch				= NOERROR;			// Result of the last GetNextRows
+	HROW				rghRows[PARALLEL_SCAN_FETCH_ROWS];		// Array of row handles obtained from the rowset object
+	HROW				*prghRows			= rghRows;			// Row handle(s) pointer
+	ULONG				cRowsObtained		= 0;				// Number of rows obtained from the rowset object
+	DBBINDING			KeyBinding;
+	DBBINDING			rgBinding[EMPLOYEE_SCHEMA_SIZE];
+	EMPLOYEE_ROW		StartKey;
+	EMPLOYEE_ROW		EndKey;
+	EMPLOYEE_ROW		Row;
+	EMPLOYEE_ROW		*pRow;
+	BOOL				fOrdered			= (m_dwFlags & PARALLEL_SCAN_ORDERED) ? TRUE : FALSE;
+	ULONG				ulRow;
+
+	IOpenRowset			*pIOpenRowset		= NULL;				// Provider Interface Pointer
+	IRowsetIndex		*pIRowsetIndex		= NULL;				// Provider Interface Pointer
+	IRowset				*pIRowset			= NULL;				// Provider Interface Pointer
+	IAccessor			*pIAccessor			= NULL;				// Provider Interface Pointer
+	HACCESSOR			hKeyAccessor		= DB_NULL_HACCESSOR;// EmployeeID only
+	HACCESSOR			hRowAccessor		= DB_NULL_HACCESSOR;// Columns of the callback
+
+	pIOpenRowset = pPartition->pSession->pISession;
+	pIOpenRowset->AddRef();
+
+	hr = OpenEmployeesRowset(pIOpenRowset, ROWSET_OPT_INDEX, IID_IRowsetIndex, (IUnknown**)&pIRowsetIndex);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowsetIndex->QueryInterface(IID_IRowset, (void**)&pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	BindEmployeeColumns(s_rgiKeyColumn, 1, NULL, &KeyBinding);
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, 1, &KeyBinding, 0, &hKeyAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	BindEmployeeColumns(m_rgiColumn, m_cColumns, NULL, rgBinding);
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, m_cColumns, rgBinding, 0, &hRowAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Limit the rowset to the key range of the partition
+	//
+	StartKey.cbEmployeeID		= sizeof(LONG);
+	StartKey.dwEmployeeIDStatus	= DBSTATUS_S_OK;
+	StartKey.EmployeeID			= pPartition->lFirst;
+
+	EndKey.cbEmployeeID			= sizeof(LONG);
+	EndKey.dwEmployeeIDStatus	= DBSTATUS_S_OK;
+	EndKey.EmployeeID			= pPartition->lLast;
+
+	hr = pIRowsetIndex->SetRange(hKeyAccessor, 1, &StartKey, 1, &EndKey, DBRANGE_INCLUSIVESTART | DBRANGE_INCLUSIVEEND);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	do
+	{
+		hrFetch = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, PARALLEL_SCAN_FETCH_ROWS, &cRowsObtained, &prghRows);
+		if (FAILED(hrFetch))
+		{
+			hr = hrFetch;
+			goto Exit;
+		}
+
+		for (ulRow = 0; ulRow < cRowsObtained && !m_fCancel; ++ulRow)
+		{
+			// An ordered row waits for a free slot of the queue
+			//
+			if (fOrdered)
+			{
+				WaitForSingleObject(pPartition->hFree, INFINITE);
+				if (m_fCancel)
+				{
+					break;
+				}
+
+				pRow = &pPartition->rgRows[pPartition->cRows % PARALLEL_SCAN_QUEUE_ROWS];
+			}
+			else
+			{
+				pRow = &Row;
+			}
+
+			hr = pIRowset->GetData(rghRows[ulRow], hRowAccessor, pRow);
+			if(FAILED(hr))
+			{
+				break;
+			}
+
+			++pPartition->cRows;
+
+			if (fOrdered)
+			{
+				InterlockedIncrement(&pPartition->cProduced);
+				ReleaseSemaphore(pPartition->hFilled, 1, NULL);
+				continue;
+			}
+
+			hr = m_pfnRow(m_pvContext, pPartition->iPartition, pRow);
+			if(FAILED(hr))
+			{
+				break;
+			}
+
+			if (S_FALSE == hr)
+			{
+				hr = NOERROR;
+				Cancel();
+			}
+		}
+
+		if (cRowsObtained)
+		{
+			pIRowset->ReleaseRows(cRowsObtained, rghRows, NULL, NULL, NULL);
+		}
+
+		if(FAILED(hr))
+		{
+			Cancel();
+			goto Exit;
+		}
+	}
+	while (DB_S_ENDOFROWSET != hrFetch && cRowsObtained && !m_fCancel);
+
+	hr = NOERROR;
+
+Exit:
+	if(pIAccessor)
+	{
+		if (DB_NULL_HACCESSOR != hKeyAccessor)
+		{
+			pIAccessor->ReleaseAccessor(hKeyAccessor, NULL);
+		}
+
+		if (DB_NULL_HACCESSOR != hRowAccessor)
+		{
+			pIAccessor->ReleaseAccessor(hRowAccessor, NULL);
+		}
+
+		pIAccessor->Release();
+	}
+
+	if(pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	if(pIRowsetIndex)
+	{
+		pIRowsetIndex->Release();
+	}
+
+	if(pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: MergePartitions
+//
+// Description: Pass the queued rows of the partitions to the callback in
+//				key order: all of the first partition, then all of the
+//				next. Runs on the calling thread.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeeParallelScan::MergePartitions()
+{
+	HRESULT					hr			= NOERROR;
+	PARALLEL_SCAN_PARTITION	*pPartition;
+	const EMPLOYEE_ROW		*pRow;
+
+	for (DWORD iPartition = 0; iPartition < m_cPartitions; ++iPartition)
+	{
+		pPartition = &m_rgPartition[iPartition];
+
+		for (;;)
+		{
+			WaitForSingleObject(pPartition->hFilled, INFINITE);
+
+			// Woken by the end of the partition rather than by a row
+			//
+			if ((LONG)pPartition->cConsumed == pPartition->cProduced)
+			{
+				if (FAILED(pPartition->hr))
+				{
+					Cancel();
+					return pPartition->hr;
+				}
+
+				break;
+			}
+
+			pRow = &pPartition->rgRows[pPartition->cConsumed % PARALLEL_SCAN_QUEUE_ROWS];
+
+			hr = m_pfnRow(m_pvContext, iPartition, pRow);
+
+			++pPartition->cConsumed;
+			ReleaseSemaphore(pPartition->hFree, 1, NULL);
+
+			if(FAILED(hr) || S_FALSE == hr)
+			{
+				Cancel();
+				return FAILED(hr) ? hr : NOERROR;
+			}
+		}
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: Cancel
+//
+// Description: Stop the partitions. A partition waiting for a free slot of
+//				its queue is woken to see it.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeeParallelScan::Cancel()
+{
+	InterlockedExchange(&m_fCancel, TRUE);
+
+	for (DWORD iPartition = 0; iPartition < m_cPartitions; ++iPartition)
+	{
+		if (m_rgPartition[iPartition].hFree)
+		{
+			ReleaseSemaphore(m_rgPartition[iPartition].hFree, 1, NULL);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FreePartitions
+//
+// Description: Release the queues of the partitions.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeeParallelScan::FreePartitions()
+{
+	for (DWORD iPartition = 0; iPartition < PARALLEL_SCAN_MAX_PARTITIONS; ++iPartition)
+	{
+		PARALLEL_SCAN_PARTITION *pPartition = &m_rgPartition[iPartition];
+
+		if (pPartition->rgRows)
+		{
+			CoTaskMemFree(pPartition->rgRows);
+		}
+
+		if (pPartition->hFree)
+		{
+			CloseHandle(pPartition->hFree);
+		}
+
+		if (pPartition->hFilled)
+		{
+			CloseHandle(pPartition->hFilled);
+		}
+	}
+
+	memset(m_rgPartition, 0, sizeof(m_rgPartition));
+
+	m_cPartitions = 0;
+}
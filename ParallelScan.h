@@ -0,0 +1,119 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: EmployeeParallelScan
+//
+// File: ParallelScan.h
+//
+// Comment: Scan of Employees split into key ranges read in parallel.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_PARALLELSCAN_H__A73E1F96_2C58_4D0B_B814_6F9D3E02C7A5__INCLUDED_)
+#define AFX_PARALLELSCAN_H__A73E1F96_2C58_4D0B_B814_6F9D3E02C7A5__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define PARALLEL_SCAN_MAX_PARTITIONS	16
+#define PARALLEL_SCAN_SLICES			4				// Key ranges counted per partition when planning
+#define PARALLEL_SCAN_FETCH_ROWS		64				// Row handles fetched per GetNextRows
+#define PARALLEL_SCAN_QUEUE_ROWS		256				// Rows a partition reads ahead of an ordered merge
+
+// Scan options
+//
+#define PARALLEL_SCAN_ORDERED			0x00000001		// Rows reach the callback in EmployeeID order,
+														// on the calling thread
+
+////////////////////////////////////////////////////////////////////////////////
+// Receives the rows of a scan, with the columns asked for bound. Without
+// PARALLEL_SCAN_ORDERED it is called on the thread of each partition, for
+// several partitions at once. Returning S_FALSE ends the scan.
+//
+typedef HRESULT (CALLBACK *PFN_PARALLEL_SCAN_ROW)(LPVOID pvContext, DWORD iPartition, const EMPLOYEE_ROW *pRow);
+
+////////////////////////////////////////////////////////////////////////////////
+// Scan statistics
+//
+typedef struct tagPARALLEL_SCAN_STATS
+{
+	DWORD		cPartitions;								// Partitions scanned, 0 if the table is empty
+	DWORD		cRows;										// Rows passed to the callback
+	DWORD		rgcRows[PARALLEL_SCAN_MAX_PARTITIONS];		// Of each partition
+	DWORD		dwPlanMs;									// Time spent splitting the key space
+	DWORD		dwElapsedMs;								// Wall clock time, planning included
+} PARALLEL_SCAN_STATS;
+
+////////////////////////////////////////////////////////////////////////////////
+// A key range and the thread reading it, internal to the scan
+//
+typedef struct tagPARALLEL_SCAN_PARTITION
+{
+	class EmployeeParallelScan	*pThis;
+	DWORD						iPartition;
+	POOLED_SESSION				*pSession;					// Checked out by Scan for the thread
+	LONG						lFirst;						// EmployeeID range, both ends included
+	LONG						lLast;
+	HRESULT						hr;
+	DWORD						cRows;
+
+	// Rows read ahead of an ordered merge, one writer and one reader
+	//
+	EMPLOYEE_ROW				*rgRows;					// PARALLEL_SCAN_QUEUE_ROWS
+	HANDLE						hFree;						// Counts the free slots
+	HANDLE						hFilled;					// Counts the filled slots, and the end
+	volatile LONG				cProduced;
+	DWORD						cConsumed;
+	volatile LONG				fDone;
+} PARALLEL_SCAN_PARTITION;
+
+////////////////////////////////////////////////////////////////////////////////
+// Scans Employees through PK_Employees on several threads. The key space
+// is split into ranges of about the same row count, from row counts of
+// evenly spaced key ranges. Each range is read on its own thread and on a
+// session of a SessionPool, limited with IRowsetIndex::SetRange. The rows
+// go to the callback as each partition reads them, or through a merge that
+// keeps key order. The scan has no more partitions than the pool has
+// sessions to give.
+//
+class EmployeeParallelScan
+{
+public:
+	EmployeeParallelScan();
+	~EmployeeParallelScan();
+
+	HRESULT Scan(SessionPool				*pSessionPool,
+				 const DWORD				*rgiColumn,
+				 DWORD						cColumns,
+				 DWORD						cPartitions,
+				 DWORD						dwFlags,
+				 PFN_PARALLEL_SCAN_ROW		pfnRow,
+				 LPVOID						pvContext,
+				 PARALLEL_SCAN_STATS		*pStats);
+
+private:
+	HRESULT PlanPartitions(IUnknown *pISession, DWORD cPartitions);
+	HRESULT ScanPartition(PARALLEL_SCAN_PARTITION *pPartition);
+	HRESULT MergePartitions();
+	void	Cancel();
+	void	FreePartitions();
+
+	static DWORD WINAPI ScanThreadProc(LPVOID lpParameter);
+
+	DWORD					m_rgiColumn[EMPLOYEE_SCHEMA_SIZE];
+	DWORD					m_cColumns;
+	DWORD					m_dwFlags;
+	PFN_PARALLEL_SCAN_ROW	m_pfnRow;
+	LPVOID					m_pvContext;
+	volatile LONG			m_fCancel;
+
+	PARALLEL_SCAN_PARTITION	m_rgPartition[PARALLEL_SCAN_MAX_PARTITIONS];
+	DWORD					m_cPartitions;
+};
+
+#endif // !defined(AFX_PARALLELSCAN_H__A73E1F96_2C58_4D0B_B814_6F9D3E02C7A5__INCLUDED_)
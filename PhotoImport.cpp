@@ -0,0 +1,1156 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: EmployeePhotoImport
+//
+// File: PhotoImport.cpp
+//
+// Comment: Employee photos imported from a directory of bitmap files.
+//
+// Functions:
+//			1. Read the bitmap files of a directory ahead of the writer
+//			2. Check the bitmaps and make their thumbnails as scheduled tasks
+//			3. Match the files to the employees by last name or EmployeeID
+//			4. Write the photos to the rows on one thread, in batches
+//
+// Notes:
+//			Two semaphores bound the pipeline. m_hSlots counts the photos
+//			that may still be read before the writer catches up, so no
+//			more than PHOTO_IMPORT_QUEUE_DEPTH files are in memory and the
+//			queue of decoded photos can't overflow. m_hQueued counts the
+//			decoded photos; it is released once more when the last file is
+//			read, so that the writer sees the end even if every photo was
+//			already written.
+//
+//			A photo is written the way InsertEmployeeInfo writes one: the
+//			Photo column is bound as an ISequentialStream and the bitmap
+//			file, or its g_PhotoStore reference, is written to it.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "EmployeeSchema.h"
+#include "ResultCache.h"
+#include "SessionPool.h"
+#include "EmployeeStore.h"
+#include "TaskScheduler.h"
+#include "PhotoStore.h"
+#include "PhotoImport.h"
+
+#define PHOTO_IMPORT_INITIAL_NAMES	64				// Names allocated first, doubled when full
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeePhotoImport::EmployeePhotoImport()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeePhotoImport::EmployeePhotoImport() :	m_pIDBCreateSession(NULL),
+												m_cTxnRows(0),
+												m_pfnThumbnail(NULL),
+												m_pvContext(NULL),
+												m_rgName(NULL),
+												m_cNames(0),
+												m_cMaxNames(0),
+												m_hSlots(NULL),
+												m_hQueued(NULL),
+												m_iQueueHead(0),
+												m_cQueued(0),
+												m_cRead(0),
+												m_cHandled(0),
+												m_fReadDone(FALSE),
+												m_fCancel(FALSE),
+												m_hrWrite(NOERROR)
+{
+	InitializeCriticalSection(&m_cs);
+
+	memset(m_rgpQueue, 0, sizeof(m_rgpQueue));
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeePhotoImport::~EmployeePhotoImport()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+EmployeePhotoImport::~EmployeePhotoImport()
+{
+	DeleteCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeePhotoImport::Import()
+//
+// Description: Set the photos of the employees from the bitmap files of a
+//				directory.
+//
+// Parameters:
+//			pIDBCreateSession	- Database of the employees
+//			pwszDirectory		- Directory of the *.bmp files
+//			cTxnRows			- Rows written per transaction
+//			pfnThumbnail		- Optional, receives the thumbnails
+//			pvContext			- Passed to pfnThumbnail
+//			pStats				- Optional, receives the statistics
+//
+// Returns: NOERROR if succesfull
+//
+// Notes:	g_TaskScheduler is started for the import if it isn't running.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeePhotoImport::Import(IDBCreateSession		*pIDBCreateSession,
+									LPCWSTR					pwszDirectory,
+									DWORD					cTxnRows,
+									PFN_PHOTO_THUMBNAIL		pfnThumbnail,
+									LPVOID					pvContext,
+									PHOTO_IMPORT_STATS		*pStats)
+{
+	HRESULT		hr				= NOERROR;
+	HRESULT		hrRead;
+	DWORD		dwStartMs		= GetTickCount();
+	BOOL		fScheduler		= FALSE;				// Started here
+	HANDLE		hWriter			= NULL;
+	DWORD		dwThreadId;
+
+	if (NULL == pIDBCreateSession || NULL == pwszDirectory || 0 == cTxnRows)
+	{
+		return E_INVALIDARG;
+	}
+
+	m_pIDBCreateSession	= pIDBCreateSession;
+	m_cTxnRows			= cTxnRows;
+	m_pfnThumbnail		= pfnThumbnail;
+	m_pvContext			= pvContext;
+	m_iQueueHead		= 0;
+	m_cQueued			= 0;
+	m_cRead				= 0;
+	m_cHandled			= 0;
+	m_fReadDone			= FALSE;
+	m_fCancel			= FALSE;
+	m_hrWrite			= NOERROR;
+
+	memset(&m_Stats, 0, sizeof(m_Stats));
+
+	// The files are matched against the names as they are now
+	//
+	hr = LoadNames();
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	m_hSlots	= CreateSemaphore(NULL, PHOTO_IMPORT_QUEUE_DEPTH, PHOTO_IMPORT_QUEUE_DEPTH, NULL);
+	m_hQueued	= CreateSemaphore(NULL, 0, PHOTO_IMPORT_QUEUE_DEPTH + 1, NULL);
+	if (NULL == m_hSlots || NULL == m_hQueued)
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto Exit;
+	}
+
+	if (0 == g_TaskScheduler.GetWorkerCount())
+	{
+		// The decode tasks don't use the database
+		//
+		hr = g_TaskScheduler.Start(NULL, 0);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		fScheduler = TRUE;
+	}
+
+	hWriter = CreateThread(NULL, 0, WriterThreadProc, this, 0, &dwThreadId);
+	if (NULL == hWriter)
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto Exit;
+	}
+
+	// Read on this thread while the files read before are decoded and
+	// written
+	//
+	hrRead = ReadFiles(pwszDirectory);
+
+	WaitForSingleObject(hWriter, INFINITE);
+	CloseHandle(hWriter);
+
+	hr = FAILED(hrRead) ? hrRead : m_hrWrite;
+
+Exit:
+	if (fScheduler)
+	{
+		g_TaskScheduler.Stop();
+	}
+
+	if (m_hSlots)
+	{
+		CloseHandle(m_hSlots);
+		m_hSlots = NULL;
+	}
+
+	if (m_hQueued)
+	{
+		CloseHandle(m_hQueued);
+		m_hQueued = NULL;
+	}
+
+	if (m_rgName)
+	{
+		CoTaskMemFree(m_rgName);
+		m_rgName	= NULL;
+		m_cNames	= 0;
+		m_cMaxNames	= 0;
+	}
+
+	m_Stats.dwElapsedMs = GetTickCount() - dwStartMs;
+
+	if (pStats)
+	{
+		*pStats = m_Stats;
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeePhotoImport::AddName()
+//
+// Description: PFN_EMPLOYEE_NAME of LoadNames, keeping the last name.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CALLBACK EmployeePhotoImport::AddName(LPVOID pvContext, DWORD dwEmployeeID, LPCWSTR pwszName)
+{
+	EmployeePhotoImport	*pThis	= (EmployeePhotoImport*)pvContext;
+	PHOTO_IMPORT_NAME	*rgGrown;
+	PHOTO_IMPORT_NAME	*pName;
+	DWORD				cchName;
+	DWORD				cMaxNames;
+
+	if (pThis->m_cNames == pThis->m_cMaxNames)
+	{
+		cMaxNames = pThis->m_cMaxNames ? 2 * pThis->m_cMaxNames : PHOTO_IMPORT_INITIAL_NAMES;
+
+		rgGrown = (PHOTO_IMPORT_NAME*)CoTaskMemRealloc(pThis->m_rgName, cMaxNames * sizeof(PHOTO_IMPORT_NAME));
+		if (NULL == rgGrown)
+		{
+			return E_OUTOFMEMORY;
+		}
+
+		pThis->m_rgName		= rgGrown;
+		pThis->m_cMaxNames	= cMaxNames;
+	}
+
+	pName = &pThis->m_rgName[pThis->m_cNames++];
+
+	// The name is "LastName, FirstName"
+	//
+	for (cchName = 0;
+		 pwszName[cchName] && L',' != pwszName[cchName] && cchName + 1 < sizeof(pName->wszLastName)/sizeof(WCHAR);
+		 ++cchName)
+	{
+		pName->wszLastName[cchName] = pwszName[cchName];
+	}
+
+	pName->wszLastName[cchName]	= L'\0';
+	pName->dwEmployeeID			= dwEmployeeID;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeePhotoImport::DecodeTask()
+//
+// Description: PFN_SCHEDULER_TASK decoding a photo and queuing it for the
+//				writer.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CALLBACK EmployeePhotoImport::DecodeTask(LPVOID pvContext, const SCHEDULER_TASK_CONTEXT *pTaskContext)
+{
+	PHOTO_IMPORT_ITEM *pItem = (PHOTO_IMPORT_ITEM*)pvContext;
+
+	// A cancelled photo is still queued, the writer counts every photo
+	//
+	if (*pTaskContext->pfCancel || pItem->pThis->m_fCancel)
+	{
+		pItem->hr = E_ABORT;
+	}
+	else
+	{
+		pItem->pThis->DecodeItem(pItem);
+	}
+
+	pItem->pThis->QueueItem(pItem);
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeePhotoImport::WriterThreadProc()
+//
+// Description: Thread writing the decoded photos.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD WINAPI EmployeePhotoImport::WriterThreadProc(LPVOID lpParameter)
+{
+	EmployeePhotoImport	*pThis	= (EmployeePhotoImport*)lpParameter;
+	BOOL				fCoInit	= SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+
+	pThis->m_hrWrite = pThis->WriteItems();
+
+	if (fCoInit)
+	{
+		CoUninitialize();
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeePhotoImport::LoadNames()
+//
+// Description: Read the last names of the employees.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeePhotoImport::LoadNames()
+{
+	HRESULT			hr;
+	EmployeeStore	Store;
+
+	hr = Store.Open(m_pIDBCreateSession);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	return Store.ScanNames(AddName, this);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeePhotoImport::ReadFiles()
+//
+// Description: Read the bitmap files of a directory and hand them to the
+//				decode tasks, waiting whenever PHOTO_IMPORT_QUEUE_DEPTH
+//				photos are in flight.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeePhotoImport::ReadFiles(LPCWSTR pwszDirectory)
+{
+	HRESULT				hr			= NOERROR;
+	HANDLE				hFind;
+	WIN32_FIND_DATA		FindFileData;
+	WCHAR				wszPattern[MAX_PATH];
+	PHOTO_IMPORT_ITEM	*pItem;
+	DWORD				dwStartMs;
+
+	if (wcslen(pwszDirectory) + 7 > MAX_PATH)
+	{
+		hr = E_INVALIDARG;
+		goto Exit;
+	}
+
+	wcscpy(wszPattern, pwszDirectory);
+	wcscat(wszPattern, L"\\*.bmp");
+
+	hFind = FindFirstFile(wszPattern, &FindFileData);
+	if (INVALID_HANDLE_VALUE == hFind)
+	{
+		if (ERROR_FILE_NOT_FOUND != GetLastError() && ERROR_NO_MORE_FILES != GetLastError())
+		{
+			hr = HRESULT_FROM_WIN32(GetLastError());
+		}
+
+		goto Exit;
+	}
+
+	do
+	{
+		if (FindFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			continue;
+		}
+
+		// Wait for the writer to fall less than a queue behind
+		//
+		WaitForSingleObject(m_hSlots, INFINITE);
+		if (m_fCancel)
+		{
+			break;
+		}
+
+		dwStartMs = GetTickCount();
+
+		hr = ReadItem(pwszDirectory, FindFileData.cFileName, &pItem);
+		if(FAILED(hr))
+		{
+			InterlockedExchange(&m_fCancel, TRUE);
+			break;
+		}
+
+		EnterCriticalSection(&m_cs);
+		++m_cRead;
+		++m_Stats.cFiles;
+		m_Stats.cbRead		+= pItem->cbFile;
+		m_Stats.dwReadMs	+= GetTickCount() - dwStartMs;
+		LeaveCriticalSection(&m_cs);
+
+		// A file that could not be read goes straight to the writer,
+		// which counts it
+		//
+		if (NOERROR != pItem->hr)
+		{
+			QueueItem(pItem);
+		}
+		else if (FAILED(g_TaskScheduler.Submit(DecodeTask, pItem, SCHEDULER_PRIORITY_BACKGROUND, SCHEDULER_NO_AFFINITY, NULL)))
+		{
+			DecodeItem(pItem);
+			QueueItem(pItem);
+		}
+	}
+	while (FindNextFile(hFind, &FindFileData));
+
+	FindClose(hFind);
+
+Exit:
+	// Wake the writer to see the end
+	//
+	EnterCriticalSection(&m_cs);
+	m_fReadDone = TRUE;
+	LeaveCriticalSection(&m_cs);
+
+	ReleaseSemaphore(m_hQueued, 1, NULL);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeePhotoImport::ReadItem()
+//
+// Description: Read a bitmap file into a new photo. A file that is too
+//				large or can't be read gives a photo rejected with S_FALSE.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeePhotoImport::ReadItem(LPCWSTR pwszDirectory, LPCWSTR pwszFile, PHOTO_IMPORT_ITEM **ppItem)
+{
+	PHOTO_IMPORT_ITEM	*pItem;
+	WCHAR				wszPath[MAX_PATH];
+	HANDLE				hFile;
+	DWORD				dwSizeHigh	= 0;
+	DWORD				cbFile;
+	DWORD				cbRead;
+
+	*ppItem = NULL;
+
+	pItem = (PHOTO_IMPORT_ITEM*)CoTaskMemAlloc(sizeof(PHOTO_IMPORT_ITEM));
+	if (NULL == pItem)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	memset(pItem, 0, sizeof(PHOTO_IMPORT_ITEM));
+
+	pItem->pThis	= this;
+	pItem->hr		= S_FALSE;
+
+	wcsncpy(pItem->wszFile, pwszFile, MAX_PATH - 1);
+
+	if (wcslen(pwszDirectory) + 1 + wcslen(pwszFile) >= MAX_PATH)
+	{
+		*ppItem = pItem;
+		return NOERROR;
+	}
+
+	wcscpy(wszPath, pwszDirectory);
+	wcscat(wszPath, L"\\");
+	wcscat(wszPath, pwszFile);
+
+	hFile = CreateFile(wszPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == hFile)
+	{
+		*ppItem = pItem;
+		return NOERROR;
+	}
+
+	cbFile = GetFileSize(hFile, &dwSizeHigh);
+
+	if (0xFFFFFFFF != cbFile && 0 == dwSizeHigh && cbFile && cbFile <= PHOTO_IMPORT_MAX_FILE)
+	{
+		pItem->pbFile = (BYTE*)CoTaskMemAlloc(cbFile);
+		if (NULL == pItem->pbFile)
+		{
+			CloseHandle(hFile);
+			CoTaskMemFree(pItem);
+			return E_OUTOFMEMORY;
+		}
+
+		if (ReadFile(hFile, pItem->pbFile, cbFile, &cbRead, NULL) && cbFile == cbRead)
+		{
+			pItem->cbFile	= cbFile;
+			pItem->hr		= NOERROR;
+		}
+		else
+		{
+			CoTaskMemFree(pItem->pbFile);
+			pItem->pbFile = NULL;
+		}
+	}
+
+	CloseHandle(hFile);
+
+	*ppItem = pItem;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeePhotoImport::DecodeItem()
+//
+// Description: Check that a photo is a 24 bit bitmap the application can
+//				show, find its employee and make its thumbnail. Sets
+//				pItem->hr to S_FALSE if the photo is rejected.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeePhotoImport::DecodeItem(PHOTO_IMPORT_ITEM *pItem)
+{
+	DWORD				dwStartMs	= GetTickCount();
+	BITMAPFILEHEADER	bmpFileHeader;
+	BITMAPINFOHEADER	bmiPhoto;
+	DWORD				obBits		= sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
+	DWORD				cbBits;
+
+	pItem->hr = S_FALSE;
+
+	if (pItem->cbFile < obBits)
+	{
+		goto Exit;
+	}
+
+	memcpy(&bmpFileHeader, pItem->pbFile, sizeof(BITMAPFILEHEADER));
+	memcpy(&bmiPhoto, pItem->pbFile + sizeof(BITMAPFILEHEADER), sizeof(BITMAPINFOHEADER));
+
+	// "BM", and the bits right after the info header, where
+	// EmployeeStore reads them
+	//
+	if (0x4D42 != bmpFileHeader.bfType || obBits != bmpFileHeader.bfOffBits)
+	{
+		goto Exit;
+	}
+
+	// THIS SAMPLE ONLY SUPPORT 24 BIT BITMAP
+	//
+	if (sizeof(BITMAPINFOHEADER) != bmiPhoto.biSize || 24 != bmiPhoto.biBitCount ||
+		BI_RGB != bmiPhoto.biCompression || bmiPhoto.biWidth <= 0 || 0 == bmiPhoto.biHeight ||
+		bmiPhoto.biWidth > 0x7FFF || bmiPhoto.biHeight > 0x7FFF || bmiPhoto.biHeight < -0x7FFF)
+	{
+		goto Exit;
+	}
+
+	cbBits = ROUND_UP(bmiPhoto.biWidth * 3, sizeof(DWORD)) *
+			 (bmiPhoto.biHeight < 0 ? -bmiPhoto.biHeight : bmiPhoto.biHeight);
+	if (cbBits > pItem->cbFile - obBits)
+	{
+		goto Exit;
+	}
+
+	bmiPhoto.biSizeImage = cbBits;
+
+	pItem->dwEmployeeID = FindEmployee(pItem->wszFile);
+	if (0 == pItem->dwEmployeeID)
+	{
+		pItem->hr = NOERROR;
+		goto Exit;
+	}
+
+	pItem->hr = MakeThumbnail(&bmiPhoto, pItem->pbFile + obBits, &pItem->bmiThumbnail, &pItem->pThumbnailBits);
+
+Exit:
+	EnterCriticalSection(&m_cs);
+	m_Stats.dwDecodeMs += GetTickCount() - dwStartMs;
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeePhotoImport::FindEmployee()
+//
+// Description: Returns the EmployeeID of the employee of a file name, 0 if
+//				no employee matches.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD EmployeePhotoImport::FindEmployee(LPCWSTR pwszFile)
+{
+	WCHAR	wszBase[MAX_PATH];
+	WCHAR	*pwszDot;
+	WCHAR	*pwszEnd;
+	DWORD	dwEmployeeID;
+	DWORD	iName;
+
+	wcscpy(wszBase, pwszFile);
+
+	pwszDot = wcsrchr(wszBase, L'.');
+	if (pwszDot)
+	{
+		*pwszDot = L'\0';
+	}
+
+	// 5.bmp is the photo of EmployeeID 5
+	//
+	dwEmployeeID = wcstoul(wszBase, &pwszEnd, 10);
+	if (L'\0' != wszBase[0] && L'\0' == *pwszEnd)
+	{
+		for (iName = 0; iName < m_cNames; ++iName)
+		{
+			if (dwEmployeeID == m_rgName[iName].dwEmployeeID)
+			{
+				return dwEmployeeID;
+			}
+		}
+
+		return 0;
+	}
+
+	for (iName = 0; iName < m_cNames; ++iName)
+	{
+		if (0 == _wcsicmp(wszBase, m_rgName[iName].wszLastName))
+		{
+			return m_rgName[iName].dwEmployeeID;
+		}
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeePhotoImport::QueueItem()
+//
+// Description: Hand a photo to the writer.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeePhotoImport::QueueItem(PHOTO_IMPORT_ITEM *pItem)
+{
+	EnterCriticalSection(&m_cs);
+
+	m_rgpQueue[(m_iQueueHead + m_cQueued) % PHOTO_IMPORT_QUEUE_DEPTH] = pItem;
+	++m_cQueued;
+
+	LeaveCriticalSection(&m_cs);
+
+	ReleaseSemaphore(m_hQueued, 1, NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeePhotoImport::WriteItems()
+//
+// Description: Write the queued photos to their rows until every photo
+//				read is handled. After a failure the photos are still taken
+//				off the queue, so that the reader isn't left waiting.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeePhotoImport::WriteItems()
+{
+	HRESULT				hr					= NOERROR;			// Error code reporting
+	static const DWORD	rgiKeyColumns[]		= { EMPLOYEE_COL_EMPLOYEE_ID };
+	static const DWORD	rgiPhotoColumns[]	= { EMPLOYEE_COL_PHOTO };
+	DBBINDING			rgKeyBinding[1];
+	DBBINDING			rgPhotoBinding[1];
+	DBOBJECT			dbObject;
+	HROW				rghRows[1];								// Array of row handles obtained from the rowset object
+	HROW				*prghRows			= rghRows;			// Row handle(s) pointer
+	ULONG				cRowsObtained		= 0;				// Number of rows obtained from the rowset object
+	EMPLOYEE_ROW		Row;									// record data
+	PHOTO_IMPORT_ITEM	*pItem;
+	PHOTO_STORE_REF		PhotoRef;
+	const BYTE			*pbPhoto;
+	DWORD				cbPhoto;
+	ULONG				cbWritten;
+	DWORD				*rgdwBatch			= NULL;				// Employees of the open transaction
+	DWORD				cBatch				= 0;
+	BOOL				fTxn				= FALSE;
+	BOOL				fEnd;
+	DWORD				dwStartMs;
+	DWORD				iBatch;
+
+	IOpenRowset			*pIOpenRowset		= NULL;				// Provider Interface Pointer
+	IRowset				*pIRowset			= NULL;				// Provider Interface Pointer
+	IRowsetIndex		*pIRowsetIndex		= NULL;				// Provider Interface Pointer
+	IAccessor			*pIAccessor			= NULL;				// Provider Interface Pointer
+	ITransactionLocal	*pITxnLocal			= NULL;				// Provider Interface Pointer
+	ISequentialStream	*pISequentialStream	= NULL;				// Provider Interface Pointer
+	HACCESSOR			hKeyAccessor		= DB_NULL_HACCESSOR;// Accessor handle
+	HACCESSOR			hPhotoAccessor		= DB_NULL_HACCESSOR;// Accessor handle
+
+	rgdwBatch = (DWORD*)CoTaskMemAlloc(m_cTxnRows * sizeof(DWORD));
+	if (NULL == rgdwBatch)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Drain;
+	}
+
+    // Create a session object
+    //
+    hr = m_pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**) &pIOpenRowset);
+    if(FAILED(hr))
+    {
+        goto Drain;
+    }
+
+	hr = pIOpenRowset->QueryInterface(IID_ITransactionLocal, (void**)&pITxnLocal);
+	if(FAILED(hr))
+	{
+		goto Drain;
+	}
+
+	hr = OpenEmployeesRowset(pIOpenRowset, ROWSET_OPT_INDEX | ROWSET_OPT_CHANGE, IID_IRowsetIndex, (IUnknown**)&pIRowsetIndex);
+	if(FAILED(hr))
+	{
+		goto Drain;
+	}
+
+	hr = pIRowsetIndex->QueryInterface(IID_IRowset, (void**)&pIRowset);
+	if(FAILED(hr))
+	{
+		goto Drain;
+	}
+
+	// The bindings are those of the schema, if the table still matches it
+	//
+	hr = CheckEmployeeSchema(pIOpenRowset);
+	if(FAILED(hr))
+	{
+		goto Drain;
+	}
+
+	// The photo is written through ISequentialStream
+	//
+	dbObject.dwFlags	= STGM_WRITE;
+	dbObject.iid		= IID_ISequentialStream;
+
+	BindEmployeeColumns(rgiKeyColumns, 1, NULL, rgKeyBinding);
+	BindEmployeeColumns(rgiPhotoColumns, 1, &dbObject, rgPhotoBinding);
+
+	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
+	if(FAILED(hr))
+	{
+		goto Drain;
+	}
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, 1, rgKeyBinding, 0, &hKeyAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Drain;
+	}
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, 1, rgPhotoBinding, 0, &hPhotoAccessor, NULL);
+
+Drain:
+	if(FAILED(hr))
+	{
+		InterlockedExchange(&m_fCancel, TRUE);
+	}
+
+	for (;;)
+	{
+		WaitForSingleObject(m_hQueued, INFINITE);
+
+		// Woken by the end of the files rather than by a photo
+		//
+		EnterCriticalSection(&m_cs);
+
+		pItem = NULL;
+		if (m_cQueued)
+		{
+			pItem			= m_rgpQueue[m_iQueueHead];
+			m_iQueueHead	= (m_iQueueHead + 1) % PHOTO_IMPORT_QUEUE_DEPTH;
+			--m_cQueued;
+		}
+
+		LeaveCriticalSection(&m_cs);
+
+		if (pItem)
+		{
+			dwStartMs = GetTickCount();
+
+			if (NOERROR != pItem->hr)
+			{
+				EnterCriticalSection(&m_cs);
+				++m_Stats.cRejected;
+				LeaveCriticalSection(&m_cs);
+			}
+			else if (0 == pItem->dwEmployeeID)
+			{
+				EnterCriticalSection(&m_cs);
+				++m_Stats.cUnmatched;
+				LeaveCriticalSection(&m_cs);
+			}
+			else if (SUCCEEDED(hr))
+			{
+				// Begins a new local transaction for the next cTxnRows photos
+				//
+				if (!fTxn)
+				{
+					hr = pITxnLocal->StartTransaction(ISOLATIONLEVEL_READCOMMITTED | ISOLATIONLEVEL_CURSORSTABILITY, 0, NULL, NULL);
+					fTxn = SUCCEEDED(hr);
+				}
+
+				if (SUCCEEDED(hr))
+				{
+					memset(&Row, 0, sizeof(Row));
+
+					Row.cbEmployeeID		= sizeof(LONG);
+					Row.dwEmployeeIDStatus	= DBSTATUS_S_OK;
+					Row.EmployeeID			= pItem->dwEmployeeID;
+
+					hr = pIRowsetIndex->Seek(hKeyAccessor, 1, &Row, DBSEEK_FIRSTEQ);
+					if (SUCCEEDED(hr))
+					{
+						hr = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, 1, &cRowsObtained, &prghRows);
+						if (SUCCEEDED(hr) && (DB_S_ENDOFROWSET == hr || 0 == cRowsObtained))
+						{
+							hr = DB_E_NOTFOUND;
+						}
+					}
+
+					// The employee was deleted since the names were read
+					//
+					if (DB_E_NOTFOUND == hr)
+					{
+						hr = NOERROR;
+
+						EnterCriticalSection(&m_cs);
+						++m_Stats.cUnmatched;
+						LeaveCriticalSection(&m_cs);
+					}
+					else if (SUCCEEDED(hr))
+					{
+						pbPhoto	= pItem->pbFile;
+						cbPhoto	= pItem->cbFile;
+
+						// Keep the photo in the store, the row refers to it
+						//
+						if (g_PhotoStore.IsOpen())
+						{
+							hr = g_PhotoStore.Append(pbPhoto, cbPhoto, &PhotoRef);
+
+							pbPhoto	= (const BYTE*)&PhotoRef;
+							cbPhoto	= sizeof(PhotoRef);
+						}
+
+						if (SUCCEEDED(hr))
+						{
+							memset(&Row, 0, sizeof(Row));
+
+							hr = pIRowset->GetData(prghRows[0], hPhotoAccessor, &Row);
+							if (SUCCEEDED(hr) && (DBSTATUS_S_OK != Row.dwPhotoStatus || NULL == Row.Photo))
+							{
+								hr = E_FAIL;
+							}
+						}
+
+						if (SUCCEEDED(hr))
+						{
+							pISequentialStream = (ISequentialStream*)Row.Photo;
+
+							hr = pISequentialStream->Write(pbPhoto, cbPhoto, &cbWritten);
+							if (SUCCEEDED(hr) && cbPhoto != cbWritten)
+							{
+								hr = STG_E_WRITEFAULT;
+							}
+
+							pISequentialStream->Release();
+							pISequentialStream = NULL;
+						}
+
+						pIRowset->ReleaseRows(1, prghRows, NULL, NULL, NULL);
+
+						if (SUCCEEDED(hr))
+						{
+							rgdwBatch[cBatch++] = pItem->dwEmployeeID;
+
+							if (m_pfnThumbnail && pItem->pThumbnailBits)
+							{
+								m_pfnThumbnail(m_pvContext,
+											   pItem->dwEmployeeID,
+											   pItem->wszFile,
+											   &pItem->bmiThumbnail,
+											   pItem->pThumbnailBits);
+							}
+						}
+					}
+				}
+
+				// Commit a full batch
+				//
+				if (SUCCEEDED(hr) && cBatch == m_cTxnRows)
+				{
+					hr = pITxnLocal->Commit(FALSE, XACTTC_SYNC, 0);
+					fTxn = FALSE;
+
+					for (iBatch = 0; iBatch < cBatch; ++iBatch)
+					{
+						g_ResultCache.InvalidateEmployee(rgdwBatch[iBatch]);
+					}
+
+					if (SUCCEEDED(hr))
+					{
+						EnterCriticalSection(&m_cs);
+						m_Stats.cWritten += cBatch;
+						++m_Stats.cTransactions;
+						LeaveCriticalSection(&m_cs);
+					}
+
+					cBatch = 0;
+				}
+
+				if(FAILED(hr))
+				{
+					InterlockedExchange(&m_fCancel, TRUE);
+				}
+			}
+
+			FreeItem(pItem);
+
+			ReleaseSemaphore(m_hSlots, 1, NULL);
+
+			EnterCriticalSection(&m_cs);
+			++m_cHandled;
+			m_Stats.dwWriteMs += GetTickCount() - dwStartMs;
+			LeaveCriticalSection(&m_cs);
+		}
+
+		EnterCriticalSection(&m_cs);
+		fEnd = m_fReadDone && m_cHandled == m_cRead;
+		LeaveCriticalSection(&m_cs);
+
+		if (fEnd)
+		{
+			break;
+		}
+	}
+
+	// Commit the last batch, or drop the one that failed
+	//
+	if (fTxn)
+	{
+		if (SUCCEEDED(hr))
+		{
+			hr = pITxnLocal->Commit(FALSE, XACTTC_SYNC, 0);
+
+			if (SUCCEEDED(hr) && cBatch)
+			{
+				EnterCriticalSection(&m_cs);
+				m_Stats.cWritten += cBatch;
+				++m_Stats.cTransactions;
+				LeaveCriticalSection(&m_cs);
+			}
+		}
+		else
+		{
+			pITxnLocal->Abort(NULL, FALSE, FALSE);
+		}
+
+		for (iBatch = 0; iBatch < cBatch; ++iBatch)
+		{
+			g_ResultCache.InvalidateEmployee(rgdwBatch[iBatch]);
+		}
+	}
+
+	// Release interfaces
+	//
+	if(pIAccessor)
+	{
+		pIAccessor->ReleaseAccessor(hKeyAccessor, NULL);
+		pIAccessor->ReleaseAccessor(hPhotoAccessor, NULL);
+		pIAccessor->Release();
+	}
+
+	if(pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	if(pIRowsetIndex)
+	{
+		pIRowsetIndex->Release();
+	}
+
+	if(pITxnLocal)
+	{
+		pITxnLocal->Release();
+	}
+
+	if(pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	if (rgdwBatch)
+	{
+		CoTaskMemFree(rgdwBatch);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeePhotoImport::FreeItem()
+//
+// Description: Free a photo.
+//
+////////////////////////////////////////////////////////////////////////////////
+void EmployeePhotoImport::FreeItem(PHOTO_IMPORT_ITEM *pItem)
+{
+	if (pItem->pbFile)
+	{
+		CoTaskMemFree(pItem->pbFile);
+	}
+
+	if (pItem->pThumbnailBits)
+	{
+		CoTaskMemFree(pItem->pThumbnailBits);
+	}
+
+	CoTaskMemFree(pItem);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EmployeePhotoImport::MakeThumbnail()
+//
+// Description: Shrink a 24 bit bitmap so that its longer side is at most
+//				PHOTO_IMPORT_THUMBNAIL_SIZE pixels, each pixel the average
+//				of the pixels it covers.
+//
+// Parameters:
+//			pbmiPhoto		- Header of the photo, biSizeImage set
+//			pPhotoBits		- Bits of the photo
+//			pbmiThumbnail	- Receives the header of the thumbnail
+//			ppThumbnailBits	- Receives its bits, freed with CoTaskMemFree
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EmployeePhotoImport::MakeThumbnail(const BITMAPINFOHEADER	*pbmiPhoto,
+										   const BYTE				*pPhotoBits,
+										   BITMAPINFOHEADER			*pbmiThumbnail,
+										   BYTE						**ppThumbnailBits)
+{
+	LONG		cxPhoto			= pbmiPhoto->biWidth;
+	LONG		cyPhoto			= pbmiPhoto->biHeight < 0 ? -pbmiPhoto->biHeight : pbmiPhoto->biHeight;
+	DWORD		cbPhotoRow		= ROUND_UP(cxPhoto * 3, sizeof(DWORD));
+	LONG		cxThumbnail		= cxPhoto;
+	LONG		cyThumbnail		= cyPhoto;
+	DWORD		cbThumbnailRow;
+	BYTE		*pThumbnailBits;
+	BYTE		*pbOut;
+	const BYTE	*pbIn;
+	LONG		x, y, xIn, yIn;
+	LONG		xFirst, xLast, yFirst, yLast;
+	DWORD		rgdwSum[3];
+	DWORD		cPixels;
+
+	*ppThumbnailBits = NULL;
+
+	// Keep the aspect ratio
+	//
+	if (cxPhoto >= cyPhoto && cxPhoto > PHOTO_IMPORT_THUMBNAIL_SIZE)
+	{
+		cxThumbnail	= PHOTO_IMPORT_THUMBNAIL_SIZE;
+		cyThumbnail	= cyPhoto * PHOTO_IMPORT_THUMBNAIL_SIZE / cxPhoto;
+	}
+	else if (cyPhoto > cxPhoto && cyPhoto > PHOTO_IMPORT_THUMBNAIL_SIZE)
+	{
+		cyThumbnail	= PHOTO_IMPORT_THUMBNAIL_SIZE;
+		cxThumbnail	= cxPhoto * PHOTO_IMPORT_THUMBNAIL_SIZE / cyPhoto;
+	}
+
+	if (0 == cxThumbnail)
+	{
+		cxThumbnail = 1;
+	}
+
+	if (0 == cyThumbnail)
+	{
+		cyThumbnail = 1;
+	}
+
+	cbThumbnailRow = ROUND_UP(cxThumbnail * 3, sizeof(DWORD));
+
+	pThumbnailBits = (BYTE*)CoTaskMemAlloc(cbThumbnailRow * cyThumbnail);
+	if (NULL == pThumbnailBits)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	memset(pThumbnailBits, 0, cbThumbnailRow * cyThumbnail);
+
+	// Rows stay in the order of the photo, bottom up or top down
+	//
+	for (y = 0; y < cyThumbnail; ++y)
+	{
+		yFirst	= y * cyPhoto / cyThumbnail;
+		yLast	= (y + 1) * cyPhoto / cyThumbnail;
+		if (yLast == yFirst)
+		{
+			++yLast;
+		}
+
+		pbOut = pThumbnailBits + y * cbThumbnailRow;
+
+		for (x = 0; x < cxThumbnail; ++x)
+		{
+			xFirst	= x * cxPhoto / cxThumbnail;
+			xLast	= (x + 1) * cxPhoto / cxThumbnail;
+			if (xLast == xFirst)
+			{
+				++xLast;
+			}
+
+			rgdwSum[0] = rgdwSum[1] = rgdwSum[2] = 0;
+
+			for (yIn = yFirst; yIn < yLast; ++yIn)
+			{
+				pbIn = pPhotoBits + yIn * cbPhotoRow + xFirst * 3;
+
+				for (xIn = xFirst; xIn < xLast; ++xIn, pbIn += 3)
+				{
+					rgdwSum[0] += pbIn[0];
+					rgdwSum[1] += pbIn[1];
+					rgdwSum[2] += pbIn[2];
+				}
+			}
+
+			cPixels = (yLast - yFirst) * (xLast - xFirst);
+
+			*pbOut++ = (BYTE)(rgdwSum[0] / cPixels);
+			*pbOut++ = (BYTE)(rgdwSum[1] / cPixels);
+			*pbOut++ = (BYTE)(rgdwSum[2] / cPixels);
+		}
+	}
+
+	memset(pbmiThumbnail, 0, sizeof(BITMAPINFOHEADER));
+
+	pbmiThumbnail->biSize			= sizeof(BITMAPINFOHEADER);
+	pbmiThumbnail->biWidth			= cxThumbnail;
+	pbmiThumbnail->biHeight			= pbmiPhoto->biHeight < 0 ? -cyThumbnail : cyThumbnail;
+	pbmiThumbnail->biPlanes			= 1;
+	pbmiThumbnail->biBitCount		= 24;
+	pbmiThumbnail->biCompression	= BI_RGB;
+	pbmiThumbnail->biSizeImage		= cbThumbnailRow * cyThumbnail;
+
+	*ppThumbnailBits = pThumbnailBits;
+
+	return NOERROR;
+}
@@ -0,0 +1,154 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: EmployeePhotoImport
+//
+// File: PhotoImport.h
+//
+// Comment: Employee photos imported from a directory of bitmap files.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_PHOTOIMPORT_H__E1A64C39_7B52_4F0D_A8C3_2D95F6B07E14__INCLUDED_)
+#define AFX_PHOTOIMPORT_H__E1A64C39_7B52_4F0D_A8C3_2D95F6B07E14__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define PHOTO_IMPORT_QUEUE_DEPTH		8				// Photos read ahead of the writer
+#define PHOTO_IMPORT_MAX_FILE			(1024 * 1024)	// Bytes of the largest photo file
+#define PHOTO_IMPORT_THUMBNAIL_SIZE		48				// Pixels of the longer side of a thumbnail
+
+////////////////////////////////////////////////////////////////////////////////
+// Receives the thumbnail of each photo written, on the writer thread, one
+// call at a time. The bits are a 24 bit DIB valid during the call.
+//
+typedef HRESULT (CALLBACK *PFN_PHOTO_THUMBNAIL)(LPVOID					pvContext,
+												DWORD					dwEmployeeID,
+												LPCWSTR					pwszFile,
+												const BITMAPINFOHEADER	*pbmiThumbnail,
+												const BYTE				*pThumbnailBits);
+
+////////////////////////////////////////////////////////////////////////////////
+// Import statistics. The busy times of the stages add up to more than the
+// elapsed time when they overlap.
+//
+typedef struct tagPHOTO_IMPORT_STATS
+{
+	DWORD		cFiles;							// Bitmap files found
+	ULONGLONG	cbRead;
+	DWORD		cRejected;						// Not a 24 bit bitmap, too large, or unreadable
+	DWORD		cUnmatched;						// No employee of that name or EmployeeID
+	DWORD		cWritten;						// Rows given their photo
+	DWORD		cTransactions;
+	DWORD		dwReadMs;						// Busy time of the reader
+	DWORD		dwDecodeMs;						// Busy time of the decode tasks, summed
+	DWORD		dwWriteMs;						// Busy time of the writer
+	DWORD		dwElapsedMs;
+} PHOTO_IMPORT_STATS;
+
+////////////////////////////////////////////////////////////////////////////////
+// A photo on its way from its file to its row
+//
+typedef struct tagPHOTO_IMPORT_ITEM
+{
+	class EmployeePhotoImport	*pThis;
+	WCHAR						wszFile[MAX_PATH];		// File name, without the directory
+	BYTE						*pbFile;				// The whole bitmap file
+	DWORD						cbFile;
+	HRESULT						hr;						// S_FALSE if rejected
+	DWORD						dwEmployeeID;			// 0 if no employee matches
+	BITMAPINFOHEADER			bmiThumbnail;
+	BYTE						*pThumbnailBits;
+} PHOTO_IMPORT_ITEM;
+
+////////////////////////////////////////////////////////////////////////////////
+// An employee name the files are matched against
+//
+typedef struct tagPHOTO_IMPORT_NAME
+{
+	DWORD		dwEmployeeID;
+	WCHAR		wszLastName[sizeof(((EMPLOYEE_ROW*)0)->LastName)/sizeof(WCHAR)];
+} PHOTO_IMPORT_NAME;
+
+////////////////////////////////////////////////////////////////////////////////
+// Sets the photos of employees from the bitmap files of a directory. A
+// file is the photo of the employee of its name, either the last name
+// (davolio.bmp) or the EmployeeID (5.bmp).
+//
+// The import is a pipeline of three stages that run at once:
+//
+//	- The calling thread reads the files, at most PHOTO_IMPORT_QUEUE_DEPTH
+//	  ahead of the writer.
+//	- Background tasks of g_TaskScheduler check each bitmap, find its
+//	  employee and make its thumbnail, several at a time.
+//	- A single writer thread writes the photos to the rows as they are
+//	  decoded, cTxnRows rows per transaction, through g_PhotoStore when it
+//	  is open.
+//
+// The photos are written in the order they are decoded, not the order of
+// the files. A failed write stops the import; rows of the transaction that
+// failed keep their old photos.
+//
+class EmployeePhotoImport
+{
+public:
+	EmployeePhotoImport();
+	~EmployeePhotoImport();
+
+	HRESULT Import(IDBCreateSession		*pIDBCreateSession,
+				   LPCWSTR				pwszDirectory,
+				   DWORD				cTxnRows,
+				   PFN_PHOTO_THUMBNAIL	pfnThumbnail,
+				   LPVOID				pvContext,
+				   PHOTO_IMPORT_STATS	*pStats);
+
+private:
+	static HRESULT CALLBACK AddName(LPVOID pvContext, DWORD dwEmployeeID, LPCWSTR pwszName);
+	static HRESULT CALLBACK DecodeTask(LPVOID pvContext, const SCHEDULER_TASK_CONTEXT *pTaskContext);
+	static DWORD WINAPI WriterThreadProc(LPVOID lpParameter);
+
+	HRESULT LoadNames();
+	HRESULT ReadFiles(LPCWSTR pwszDirectory);
+	HRESULT ReadItem(LPCWSTR pwszDirectory, LPCWSTR pwszFile, PHOTO_IMPORT_ITEM **ppItem);
+	void	DecodeItem(PHOTO_IMPORT_ITEM *pItem);
+	DWORD	FindEmployee(LPCWSTR pwszFile);
+	void	QueueItem(PHOTO_IMPORT_ITEM *pItem);
+	HRESULT WriteItems();
+	void	FreeItem(PHOTO_IMPORT_ITEM *pItem);
+
+	static HRESULT MakeThumbnail(const BITMAPINFOHEADER *pbmiPhoto,
+								 const BYTE				*pPhotoBits,
+								 BITMAPINFOHEADER		*pbmiThumbnail,
+								 BYTE					**ppThumbnailBits);
+
+	CRITICAL_SECTION	m_cs;					// Guards the queue, the counts and the statistics
+	IDBCreateSession	*m_pIDBCreateSession;
+	DWORD				m_cTxnRows;
+	PFN_PHOTO_THUMBNAIL	m_pfnThumbnail;
+	LPVOID				m_pvContext;
+
+	PHOTO_IMPORT_NAME	*m_rgName;
+	DWORD				m_cNames;
+	DWORD				m_cMaxNames;
+
+	HANDLE				m_hSlots;				// Counts the photos that may still be read ahead
+	HANDLE				m_hQueued;				// Counts the decoded photos, and the end of the files
+	PHOTO_IMPORT_ITEM	*m_rgpQueue[PHOTO_IMPORT_QUEUE_DEPTH];
+	DWORD				m_iQueueHead;
+	DWORD				m_cQueued;
+	DWORD				m_cRead;				// Photos read
+	DWORD				m_cHandled;				// Photos the writer is done with
+	BOOL				m_fReadDone;
+	volatile LONG		m_fCancel;
+	HRESULT				m_hrWrite;
+
+	PHOTO_IMPORT_STATS	m_Stats;
+};
+
+#endif // !defined(AFX_PHOTOIMPORT_H__E1A64C39_7B52_4F0D_A8C3_2D95F6B07E14__INCLUDED_)
@@ -0,0 +1,1170 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: PhotoStore
+//
+// File: PhotoStore.cpp
+//
+// Comment: Employee photos kept in memory mapped files beside the database.
+//
+// Functions:
+//			1. Append photos to the newest store file
+//			2. Read photos in place through a mapping of the file
+//			3. Check the checksum of every photo read
+//			4. Copy the live photos to a new file and delete the old ones
+//			5. Move photos kept in the database to the store
+//
+// Notes:
+//			An extent is written and flushed before the row refers to it,
+//			and the files are only appended to, so a row never refers to
+//			bytes that may still change. A write cut short leaves a tail
+//			no row refers to; the next extent is written after it.
+//
+//			Windows CE maps only files opened with CreateFileForMapping,
+//			which is why the store files are opened with it.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "EmployeeSchema.h"
+#include "PhotoStore.h"
+
+PhotoStore	g_PhotoStore;							// Photos of the employees database
+
+// CRC-32 (IEEE 802.3) of each value of a nibble, the table is looked up
+// twice per byte
+//
+static const DWORD s_rgdwCrcNibble[16] =	{
+												0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+												0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+												0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+												0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+											};
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::PhotoStore()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+PhotoStore::PhotoStore() :	m_cFiles(0)
+{
+	InitializeCriticalSection(&m_cs);
+
+	memset(m_wszBase, 0, sizeof(m_wszBase));
+	memset(m_rgFile, 0, sizeof(m_rgFile));
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::~PhotoStore()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+PhotoStore::~PhotoStore()
+{
+	Close();
+
+	DeleteCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::Open()
+//
+// Description: Open the store files of a database, <database>.photo.1,
+//				<database>.photo.2 and so on.
+//
+// Parameters:
+//			pwszDatabase	- Database file
+//			fCreate			- Create the first file if the database has none
+//
+// Returns: NOERROR if succesfull, S_FALSE if the database has no store
+//			and fCreate is FALSE
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT PhotoStore::Open(LPCWSTR pwszDatabase, BOOL fCreate)
+{
+	HRESULT			hr				= NOERROR;
+	HANDLE			hFind;
+	WIN32_FIND_DATA	FindFileData;
+	WCHAR			wszPattern[MAX_PATH];
+	DWORD			rgdwGeneration[PHOTO_STORE_MAX_FILES];
+	DWORD			cGenerations	= 0;
+	DWORD			dwGeneration;
+	WCHAR			*pwszEnd;
+	WCHAR			*pwszDot;
+	DWORD			iGeneration;
+	DWORD			iMove;
+
+	// Room for the suffix, the dot and the generation
+	//
+	if (NULL == pwszDatabase || wcslen(pwszDatabase) + wcslen(PHOTO_STORE_SUFFIX) + 12 > MAX_PATH)
+	{
+		return E_INVALIDARG;
+	}
+
+	Close();
+
+	EnterCriticalSection(&m_cs);
+
+	wcscpy(m_wszBase, pwszDatabase);
+	wcscat(m_wszBase, PHOTO_STORE_SUFFIX);
+
+	// Find the generations, in order
+	//
+	wcscpy(wszPattern, m_wszBase);
+	wcscat(wszPattern, L".*");
+
+	hFind = FindFirstFile(wszPattern, &FindFileData);
+	if (INVALID_HANDLE_VALUE != hFind)
+	{
+		do
+		{
+			pwszDot = wcsrchr(FindFileData.cFileName, L'.');
+			if (NULL == pwszDot || L'\0' == pwszDot[1])
+			{
+				continue;
+			}
+
+			dwGeneration = wcstoul(pwszDot + 1, &pwszEnd, 10);
+			if (L'\0' != *pwszEnd || 0 == dwGeneration)
+			{
+				continue;
+			}
+
+			if (PHOTO_STORE_MAX_FILES == cGenerations)
+			{
+				hr = HRESULT_FROM_WIN32(ERROR_TOO_MANY_OPEN_FILES);
+				break;
+			}
+
+			for (iGeneration = 0; iGeneration < cGenerations && rgdwGeneration[iGeneration] < dwGeneration; ++iGeneration)
+			{
+			}
+
+			for (iMove = cGenerations; iMove > iGeneration; --iMove)
+			{
+				rgdwGeneration[iMove] = rgdwGeneration[iMove - 1];
+			}
+
+			rgdwGeneration[iGeneration] = dwGeneration;
+			++cGenerations;
+		}
+		while (FindNextFile(hFind, &FindFileData));
+
+		FindClose(hFind);
+	}
+
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	if (0 == cGenerations)
+	{
+		if (!fCreate)
+		{
+			hr = S_FALSE;
+			goto Exit;
+		}
+
+		hr = OpenFile(1, TRUE);
+		goto Exit;
+	}
+
+	for (iGeneration = 0; iGeneration < cGenerations; ++iGeneration)
+	{
+		hr = OpenFile(rgdwGeneration[iGeneration], FALSE);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+	}
+
+Exit:
+	LeaveCriticalSection(&m_cs);
+
+	if (NOERROR != hr)
+	{
+		Close();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::Close()
+//
+// Description: Close the store files. Views still held stay valid until
+//				they are released.
+//
+////////////////////////////////////////////////////////////////////////////////
+void PhotoStore::Close()
+{
+	EnterCriticalSection(&m_cs);
+
+	while (m_cFiles)
+	{
+		CloseFile(&m_rgFile[m_cFiles - 1], FALSE);
+	}
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::IsOpen()
+//
+// Description: Returns TRUE if photos are written to the store.
+//
+////////////////////////////////////////////////////////////////////////////////
+BOOL PhotoStore::IsOpen()
+{
+	BOOL fOpen;
+
+	EnterCriticalSection(&m_cs);
+	fOpen = (0 != m_cFiles);
+	LeaveCriticalSection(&m_cs);
+
+	return fOpen;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::Append()
+//
+// Description: Append a photo to the newest store file and flush it.
+//
+// Parameters:
+//			pbData	- Bitmap file of the photo
+//			cbData	- Bytes of the bitmap file
+//			pRef	- Receives what the Photo column of the row is set to
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT PhotoStore::Append(const BYTE *pbData, DWORD cbData, PHOTO_STORE_REF *pRef)
+{
+	HRESULT				hr			= NOERROR;
+	PHOTO_STORE_FILE	*pFile;
+	PHOTO_STORE_EXTENT	Extent;
+	BYTE				rgbPad[PHOTO_STORE_ALIGN];
+	DWORD				cbPad;
+	DWORD				cbWritten;
+	LONG				lHigh;
+
+	if (NULL == pbData || 0 == cbData || NULL == pRef)
+	{
+		return E_INVALIDARG;
+	}
+
+	// The checksum is taken before the lock
+	//
+	Extent.dwSignature	= PHOTO_STORE_EXTENT_SIGNATURE;
+	Extent.cbData		= cbData;
+	Extent.dwChecksum	= Checksum(pbData, cbData);
+	Extent.dwReserved	= 0;
+
+	cbPad = ROUND_UP(cbData, PHOTO_STORE_ALIGN) - cbData;
+	memset(rgbPad, 0, sizeof(rgbPad));
+
+	EnterCriticalSection(&m_cs);
+
+	if (0 == m_cFiles)
+	{
+		hr = E_UNEXPECTED;
+		goto Exit;
+	}
+
+	pFile = &m_rgFile[m_cFiles - 1];
+
+	lHigh = (LONG)(pFile->cbEnd >> 32);
+	if (0xFFFFFFFF == SetFilePointer(pFile->hFile, (LONG)(DWORD)pFile->cbEnd, &lHigh, FILE_BEGIN) &&
+		NO_ERROR != GetLastError())
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto Exit;
+	}
+
+	if (!WriteFile(pFile->hFile, &Extent, sizeof(Extent), &cbWritten, NULL) || sizeof(Extent) != cbWritten ||
+		!WriteFile(pFile->hFile, pbData, cbData, &cbWritten, NULL) || cbData != cbWritten ||
+		(cbPad && (!WriteFile(pFile->hFile, rgbPad, cbPad, &cbWritten, NULL) || cbPad != cbWritten)) ||
+		!FlushFileBuffers(pFile->hFile))
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		if (SUCCEEDED(hr))
+		{
+			hr = STG_E_WRITEFAULT;
+		}
+
+		goto Exit;
+	}
+
+	pRef->dwSignature	= PHOTO_STORE_REF_SIGNATURE;
+	pRef->dwGeneration	= pFile->dwGeneration;
+	pRef->obData		= pFile->cbEnd + sizeof(Extent);
+	pRef->cbData		= cbData;
+	pRef->dwChecksum	= Extent.dwChecksum;
+
+	pFile->cbEnd += sizeof(Extent) + cbData + cbPad;
+
+	++m_Stats.cAppends;
+	m_Stats.cbAppended += cbData;
+
+Exit:
+	LeaveCriticalSection(&m_cs);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::Read()
+//
+// Description: Return the bytes of a photo in the mapping of its file.
+//
+// Parameters:
+//			pRef	- Photo column of the row
+//			ppView	- Receives the view holding the bytes, released with
+//					  ReleaseView
+//			ppbData	- Receives the pRef->cbData bytes of the photo
+//
+// Returns: NOERROR if succesfull, HRESULT_FROM_WIN32(ERROR_CRC) if the
+//			bytes don't match their checksum
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT PhotoStore::Read(const PHOTO_STORE_REF *pRef, PHOTO_STORE_VIEW **ppView, const BYTE **ppbData)
+{
+	HRESULT					hr			= NOERROR;
+	PHOTO_STORE_FILE		*pFile;
+	PHOTO_STORE_VIEW		*pView		= NULL;
+	const PHOTO_STORE_EXTENT *pExtent;
+	const BYTE				*pbData;
+	ULONGLONG				cbNeeded;
+
+	*ppView		= NULL;
+	*ppbData	= NULL;
+
+	if (PHOTO_STORE_REF_SIGNATURE != pRef->dwSignature ||
+		pRef->obData < sizeof(PHOTO_STORE_FILE_HEADER) + sizeof(PHOTO_STORE_EXTENT))
+	{
+		return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+	}
+
+	cbNeeded = pRef->obData + pRef->cbData;
+
+	EnterCriticalSection(&m_cs);
+
+	pFile = FindFile(pRef->dwGeneration);
+	if (NULL == pFile)
+	{
+		hr = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+		goto Exit;
+	}
+
+	if (cbNeeded > pFile->cbEnd)
+	{
+		hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+		goto Exit;
+	}
+
+	// Map the file again once it outgrew its view
+	//
+	if (NULL == pFile->pView || cbNeeded > pFile->pView->cbMapped)
+	{
+		hr = MapFile(pFile, cbNeeded);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+	}
+
+	pView = pFile->pView;
+	++pView->cRefs;
+
+	++m_Stats.cReads;
+	m_Stats.cbRead += pRef->cbData;
+
+Exit:
+	LeaveCriticalSection(&m_cs);
+
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	// The bytes are checked without the lock, the view can't go away
+	//
+	pExtent	= (const PHOTO_STORE_EXTENT*)(pView->pbBase + (DWORD)pRef->obData - sizeof(PHOTO_STORE_EXTENT));
+	pbData	= pView->pbBase + (DWORD)pRef->obData;
+
+	if (PHOTO_STORE_EXTENT_SIGNATURE != pExtent->dwSignature ||
+		pRef->cbData != pExtent->cbData ||
+		pRef->dwChecksum != pExtent->dwChecksum ||
+		pRef->dwChecksum != Checksum(pbData, pRef->cbData))
+	{
+		EnterCriticalSection(&m_cs);
+		++m_Stats.cChecksumErrors;
+		LeaveCriticalSection(&m_cs);
+
+		ReleaseView(pView);
+		return HRESULT_FROM_WIN32(ERROR_CRC);
+	}
+
+	*ppView		= pView;
+	*ppbData	= pbData;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::ReleaseView()
+//
+// Description: Release a view returned by Read.
+//
+////////////////////////////////////////////////////////////////////////////////
+void PhotoStore::ReleaseView(PHOTO_STORE_VIEW *pView)
+{
+	if (NULL == pView)
+	{
+		return;
+	}
+
+	EnterCriticalSection(&m_cs);
+	ReleaseViewLocked(pView);
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::Collect()
+//
+// Description: Copy the photos the rows refer to into a new store file,
+//				point the rows at the copies and delete the older files.
+//
+// Parameters:
+//			pIDBCreateSession	- Database of the rows
+//			fMigrate			- Also move the photos kept in the rows
+//
+// Returns: NOERROR if succesfull
+//
+// Notes:	Photos appended to an older file while the rows are walked
+//			are not seen, so photos are not written during a collection,
+//			as the database is not during a compaction. A file that can't
+//			be deleted yet, being mapped, is deleted by the next
+//			collection.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT PhotoStore::Collect(IDBCreateSession *pIDBCreateSession, BOOL fMigrate)
+{
+	HRESULT		hr					= NOERROR;
+	DWORD		dwStartMs			= GetTickCount();
+	DWORD		dwGeneration;
+	ULONGLONG	cbOld				= 0;
+	ULONGLONG	cbNew;
+
+	if (NULL == pIDBCreateSession)
+	{
+		return E_POINTER;
+	}
+
+	// Appends go to the new file from here on
+	//
+	EnterCriticalSection(&m_cs);
+
+	if (0 == m_cFiles)
+	{
+		hr = E_UNEXPECTED;
+	}
+	else if (PHOTO_STORE_MAX_FILES == m_cFiles)
+	{
+		hr = HRESULT_FROM_WIN32(ERROR_TOO_MANY_OPEN_FILES);
+	}
+	else
+	{
+		dwGeneration = m_rgFile[m_cFiles - 1].dwGeneration + 1;
+		hr = OpenFile(dwGeneration, TRUE);
+	}
+
+	m_Stats.cMoved		= 0;
+	m_Stats.cMigrated	= 0;
+
+	LeaveCriticalSection(&m_cs);
+
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	// Until the rows commit, they refer to the old files
+	//
+	hr = MoveRows(pIDBCreateSession, dwGeneration, fMigrate);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	EnterCriticalSection(&m_cs);
+
+	while (m_cFiles > 1)
+	{
+		cbOld += m_rgFile[0].cbEnd;
+		CloseFile(&m_rgFile[0], TRUE);
+	}
+
+	cbNew = m_rgFile[0].cbEnd - sizeof(PHOTO_STORE_FILE_HEADER);
+
+	++m_Stats.cCollections;
+	m_Stats.cbReclaimed		= cbOld > cbNew ? cbOld - cbNew : 0;
+	m_Stats.dwLastCollectMs	= GetTickCount() - dwStartMs;
+
+	LeaveCriticalSection(&m_cs);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::GetStats()
+//
+// Description: Return the store statistics.
+//
+////////////////////////////////////////////////////////////////////////////////
+void PhotoStore::GetStats(PHOTO_STORE_STATS *pStats)
+{
+	DWORD iFile;
+
+	EnterCriticalSection(&m_cs);
+
+	*pStats = m_Stats;
+
+	pStats->cFiles	= m_cFiles;
+	pStats->cbFiles	= 0;
+
+	for (iFile = 0; iFile < m_cFiles; ++iFile)
+	{
+		pStats->cbFiles += m_rgFile[iFile].cbEnd;
+	}
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::ReadRef()
+//
+// Description: Read the store reference held by a Photo BLOB.
+//
+// Parameters:
+//			pILockBytes	- Photo BLOB
+//			pRef		- Receives the reference
+//
+// Returns: NOERROR if succesfull, S_FALSE if the BLOB holds the bitmap
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT PhotoStore::ReadRef(ILockBytes *pILockBytes, PHOTO_STORE_REF *pRef)
+{
+	HRESULT			hr;
+	ULONG			ulRead	= 0;
+	ULARGE_INTEGER	ulStart;
+
+	ulStart.QuadPart = 0;
+	hr = pILockBytes->ReadAt(ulStart, pRef, sizeof(PHOTO_STORE_REF), &ulRead);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	if (sizeof(PHOTO_STORE_REF) != ulRead || PHOTO_STORE_REF_SIGNATURE != pRef->dwSignature)
+	{
+		return S_FALSE;
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::OpenFile()
+//
+// Description: Open or create a store file and add it after the files
+//				open. Called with m_cs held.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT PhotoStore::OpenFile(DWORD dwGeneration, BOOL fCreate)
+{
+	HRESULT					hr			= NOERROR;
+	WCHAR					wszFile[MAX_PATH];
+	HANDLE					hFile;
+	PHOTO_STORE_FILE_HEADER	Header;
+	DWORD					cbDone;
+	DWORD					dwSizeLow;
+	DWORD					dwSizeHigh	= 0;
+	ULONGLONG				cbEnd;
+
+	GetFileName(dwGeneration, wszFile);
+
+	hFile = CreateFileForMapping(wszFile,
+								 GENERIC_READ | GENERIC_WRITE,
+								 FILE_SHARE_READ,
+								 NULL,
+								 fCreate ? CREATE_NEW : OPEN_EXISTING,
+								 FILE_ATTRIBUTE_NORMAL,
+								 NULL);
+	if (INVALID_HANDLE_VALUE == hFile)
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	if (fCreate)
+	{
+		memset(&Header, 0, sizeof(Header));
+
+		Header.dwSignature	= PHOTO_STORE_FILE_SIGNATURE;
+		Header.dwGeneration	= dwGeneration;
+
+		if (!WriteFile(hFile, &Header, sizeof(Header), &cbDone, NULL) || sizeof(Header) != cbDone ||
+			!FlushFileBuffers(hFile))
+		{
+			hr = HRESULT_FROM_WIN32(GetLastError());
+			CloseHandle(hFile);
+			DeleteFile(wszFile);
+			return FAILED(hr) ? hr : STG_E_WRITEFAULT;
+		}
+
+		cbEnd = sizeof(Header);
+	}
+	else
+	{
+		if (!ReadFile(hFile, &Header, sizeof(Header), &cbDone, NULL) || sizeof(Header) != cbDone ||
+			PHOTO_STORE_FILE_SIGNATURE != Header.dwSignature || dwGeneration != Header.dwGeneration)
+		{
+			CloseHandle(hFile);
+			return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+		}
+
+		dwSizeLow = GetFileSize(hFile, &dwSizeHigh);
+		if (0xFFFFFFFF == dwSizeLow && NO_ERROR != GetLastError())
+		{
+			hr = HRESULT_FROM_WIN32(GetLastError());
+			CloseHandle(hFile);
+			return hr;
+		}
+
+		// A cut short tail is left where it is
+		//
+		cbEnd = ((ULONGLONG)dwSizeHigh << 32) | dwSizeLow;
+		cbEnd = (cbEnd + PHOTO_STORE_ALIGN - 1) & ~(ULONGLONG)(PHOTO_STORE_ALIGN - 1);
+	}
+
+	m_rgFile[m_cFiles].dwGeneration	= dwGeneration;
+	m_rgFile[m_cFiles].hFile		= hFile;
+	m_rgFile[m_cFiles].cbEnd		= cbEnd;
+	m_rgFile[m_cFiles].pView		= NULL;
+	++m_cFiles;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::CloseFile()
+//
+// Description: Close a store file, and delete it if asked, and remove it
+//				from the files open. Called with m_cs held.
+//
+////////////////////////////////////////////////////////////////////////////////
+void PhotoStore::CloseFile(PHOTO_STORE_FILE *pFile, BOOL fDelete)
+{
+	WCHAR	wszFile[MAX_PATH];
+	DWORD	iFile	= (DWORD)(pFile - m_rgFile);
+
+	if (pFile->pView)
+	{
+		ReleaseViewLocked(pFile->pView);
+	}
+
+	CloseHandle(pFile->hFile);
+
+	if (fDelete)
+	{
+		GetFileName(pFile->dwGeneration, wszFile);
+		DeleteFile(wszFile);
+	}
+
+	for (; iFile + 1 < m_cFiles; ++iFile)
+	{
+		m_rgFile[iFile] = m_rgFile[iFile + 1];
+	}
+
+	--m_cFiles;
+	memset(&m_rgFile[m_cFiles], 0, sizeof(PHOTO_STORE_FILE));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::FindFile()
+//
+// Description: Returns the open file of a generation, NULL if there is
+//				none. Called with m_cs held.
+//
+////////////////////////////////////////////////////////////////////////////////
+PHOTO_STORE_FILE* PhotoStore::FindFile(DWORD dwGeneration)
+{
+	DWORD iFile;
+
+	for (iFile = 0; iFile < m_cFiles; ++iFile)
+	{
+		if (dwGeneration == m_rgFile[iFile].dwGeneration)
+		{
+			return &m_rgFile[iFile];
+		}
+	}
+
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::MapFile()
+//
+// Description: Replace the view of a file with one of the whole file.
+//				The old view is freed when its readers release it. Called
+//				with m_cs held.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT PhotoStore::MapFile(PHOTO_STORE_FILE *pFile, ULONGLONG cbNeeded)
+{
+	PHOTO_STORE_VIEW	*pView;
+	DWORD				dwSizeLow;
+	DWORD				dwSizeHigh	= 0;
+	ULONGLONG			cbFile;
+	HRESULT				hr;
+
+	dwSizeLow = GetFileSize(pFile->hFile, &dwSizeHigh);
+	if (0xFFFFFFFF == dwSizeLow && NO_ERROR != GetLastError())
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	cbFile = ((ULONGLONG)dwSizeHigh << 32) | dwSizeLow;
+	if (cbFile < cbNeeded)
+	{
+		return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+	}
+
+	pView = (PHOTO_STORE_VIEW*)CoTaskMemAlloc(sizeof(PHOTO_STORE_VIEW));
+	if (NULL == pView)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	pView->hMapping = CreateFileMapping(pFile->hFile, NULL, PAGE_READONLY, dwSizeHigh, dwSizeLow, NULL);
+	if (NULL == pView->hMapping)
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		CoTaskMemFree(pView);
+		return hr;
+	}
+
+	pView->pbBase = (const BYTE*)MapViewOfFile(pView->hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (NULL == pView->pbBase)
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		CloseHandle(pView->hMapping);
+		CoTaskMemFree(pView);
+		return hr;
+	}
+
+	pView->cbMapped	= cbFile;
+	pView->cRefs	= 1;
+
+	if (pFile->pView)
+	{
+		ReleaseViewLocked(pFile->pView);
+		++m_Stats.cRemaps;
+	}
+
+	pFile->pView = pView;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::GetFileName()
+//
+// Description: Build the name of the store file of a generation.
+//
+////////////////////////////////////////////////////////////////////////////////
+void PhotoStore::GetFileName(DWORD dwGeneration, WCHAR *pwszFile)
+{
+	wsprintf(pwszFile, L"%s.%u", m_wszBase, dwGeneration);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::ReleaseViewLocked()
+//
+// Description: Release a view and free it with its last reference. Called
+//				with m_cs held.
+//
+////////////////////////////////////////////////////////////////////////////////
+void PhotoStore::ReleaseViewLocked(PHOTO_STORE_VIEW *pView)
+{
+	if (--pView->cRefs)
+	{
+		return;
+	}
+
+	UnmapViewOfFile(pView->pbBase);
+	CloseHandle(pView->hMapping);
+	CoTaskMemFree(pView);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::MoveRows()
+//
+// Description: Copy the photos of the employees kept in older files, and
+//				those kept in the rows if fMigrate, to the file of a
+//				generation and write their new references, in one
+//				transaction.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT PhotoStore::MoveRows(IDBCreateSession *pIDBCreateSession, DWORD dwGeneration, BOOL fMigrate)
+{
+	HRESULT				hr					= NOERROR;			// Error code reporting
+	static const DWORD	rgiReadColumns[]	= { EMPLOYEE_COL_EMPLOYEE_ID, EMPLOYEE_COL_PHOTO };
+	static const DWORD	rgiWriteColumns[]	= { EMPLOYEE_COL_PHOTO };
+	DBBINDING			rgReadBinding[2];						// Key and photo, read as ILockBytes
+	DBBINDING			rgWriteBinding[1];						// Photo, written as ISequentialStream
+	DBOBJECT			dbReadObject;
+	DBOBJECT			dbWriteObject;
+	HROW				rghRows[1];								// Array of row handles obtained from the rowset object
+	HROW				*prghRows			= rghRows;			// Row handle(s) pointer
+	ULONG				cRowsObtained		= 0;				// Number of rows obtained from the rowset object
+	EMPLOYEE_ROW		Row;									// record data
+	PHOTO_STORE_REF		Ref;									// Reference read
+	PHOTO_STORE_REF		NewRef;									// Reference of the copy
+	PHOTO_STORE_VIEW	*pView				= NULL;
+	const BYTE			*pbPhoto;
+	BYTE				*pbInline			= NULL;				// Photo kept in the row
+	DWORD				cbInline;
+	BOOL				fMove;
+	BOOL				fMigrated;
+	ULONG				cbWritten;
+	DWORD				cMoved				= 0;
+	DWORD				cMigrated			= 0;
+
+	IOpenRowset			*pIOpenRowset		= NULL;				// Provider Interface Pointer
+	IRowset				*pIRowset			= NULL;				// Provider Interface Pointer
+	IAccessor			*pIAccessor			= NULL;				// Provider Interface Pointer
+	ITransactionLocal	*pITxnLocal			= NULL;				// Provider Interface Pointer
+	ILockBytes			*pILockBytes		= NULL;				// Provider Interface Pointer
+	ISequentialStream	*pISequentialStream	= NULL;				// Provider Interface Pointer
+	HACCESSOR			hReadAccessor		= DB_NULL_HACCESSOR;// Accessor handle
+	HACCESSOR			hWriteAccessor		= DB_NULL_HACCESSOR;// Accessor handle
+
+	// Create a session object
+	//
+	hr = pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**) &pIOpenRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIOpenRowset->QueryInterface(IID_ITransactionLocal, (void**)&pITxnLocal);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = OpenEmployeesRowset(pIOpenRowset, ROWSET_OPT_CHANGE, IID_IRowset, (IUnknown**)&pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// The bindings are those of the schema, if the table still matches it
+	//
+	hr = CheckEmployeeSchema(pIOpenRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	dbReadObject.dwFlags	= STGM_READ;
+	dbReadObject.iid		= IID_ILockBytes;
+	dbWriteObject.dwFlags	= STGM_WRITE;
+	dbWriteObject.iid		= IID_ISequentialStream;
+
+	BindEmployeeColumns(rgiReadColumns, 2, &dbReadObject, rgReadBinding);
+	BindEmployeeColumns(rgiWriteColumns, 1, &dbWriteObject, rgWriteBinding);
+
+	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, 2, rgReadBinding, 0, &hReadAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, 1, rgWriteBinding, 0, &hWriteAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// Begins a new local transaction, the rows refer to the new file
+	// together
+	//
+	hr = pITxnLocal->StartTransaction(ISOLATIONLEVEL_READCOMMITTED | ISOLATIONLEVEL_CURSORSTABILITY, 0, NULL, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	for (;;)
+	{
+		hr = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, 1, &cRowsObtained, &prghRows);
+		if(FAILED(hr))
+		{
+			goto Abort;
+		}
+
+		if (DB_S_ENDOFROWSET == hr || 0 == cRowsObtained)
+		{
+			break;
+		}
+
+		fMove		= FALSE;
+		fMigrated	= FALSE;
+
+		memset(&Row, 0, sizeof(Row));
+
+		hr = pIRowset->GetData(prghRows[0], hReadAccessor, &Row);
+		if (SUCCEEDED(hr) && DBSTATUS_S_OK == Row.dwPhotoStatus && Row.Photo)
+		{
+			pILockBytes = (ILockBytes*)Row.Photo;
+
+			hr = ReadRef(pILockBytes, &Ref);
+			if (NOERROR == hr && dwGeneration != Ref.dwGeneration)
+			{
+				// Copy a photo of an older file
+				//
+				hr = Read(&Ref, &pView, &pbPhoto);
+				if (SUCCEEDED(hr))
+				{
+					hr = Append(pbPhoto, Ref.cbData, &NewRef);
+					ReleaseView(pView);
+					pView = NULL;
+				}
+
+				fMove = SUCCEEDED(hr);
+			}
+			else if (S_FALSE == hr && fMigrate)
+			{
+				// Move a photo kept in the row
+				//
+				hr = ReadInlinePhoto(pILockBytes, &pbInline, &cbInline);
+				if (SUCCEEDED(hr) && cbInline)
+				{
+					hr = Append(pbInline, cbInline, &NewRef);
+					fMigrated = fMove = SUCCEEDED(hr);
+				}
+
+				if (pbInline)
+				{
+					CoTaskMemFree(pbInline);
+					pbInline = NULL;
+				}
+			}
+
+			// The photo is read before it is written
+			//
+			pILockBytes->Release();
+			pILockBytes = NULL;
+		}
+
+		if (SUCCEEDED(hr) && fMove)
+		{
+			memset(&Row, 0, sizeof(Row));
+
+			hr = pIRowset->GetData(prghRows[0], hWriteAccessor, &Row);
+			if (SUCCEEDED(hr) && (DBSTATUS_S_OK != Row.dwPhotoStatus || NULL == Row.Photo))
+			{
+				hr = E_FAIL;
+			}
+
+			if (SUCCEEDED(hr))
+			{
+				pISequentialStream = (ISequentialStream*)Row.Photo;
+
+				hr = pISequentialStream->Write(&NewRef, sizeof(NewRef), &cbWritten);
+				if (SUCCEEDED(hr) && sizeof(NewRef) != cbWritten)
+				{
+					hr = STG_E_WRITEFAULT;
+				}
+
+				pISequentialStream->Release();
+				pISequentialStream = NULL;
+			}
+
+			if (SUCCEEDED(hr))
+			{
+				++cMoved;
+				cMigrated += fMigrated;
+			}
+		}
+
+		// Release the rowset.
+		//
+		pIRowset->ReleaseRows(1, prghRows, NULL, NULL, NULL);
+
+		if(FAILED(hr))
+		{
+			goto Abort;
+		}
+	}
+
+	// Commit the transaction
+	//
+	hr = pITxnLocal->Commit(FALSE, XACTTC_SYNC, 0);
+	if(FAILED(hr))
+	{
+		goto Abort;
+	}
+
+	EnterCriticalSection(&m_cs);
+	m_Stats.cMoved		= cMoved;
+	m_Stats.cMigrated	= cMigrated;
+	LeaveCriticalSection(&m_cs);
+
+	goto Exit;
+
+Abort:
+	// Abort the transaction
+	//
+	pITxnLocal->Abort(NULL, FALSE, FALSE);
+
+Exit:
+	// Release interfaces
+	//
+	if(pIAccessor)
+	{
+		pIAccessor->ReleaseAccessor(hReadAccessor, NULL);
+		pIAccessor->ReleaseAccessor(hWriteAccessor, NULL);
+		pIAccessor->Release();
+	}
+
+	if(pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	if(pITxnLocal)
+	{
+		pITxnLocal->Release();
+	}
+
+	if(pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::ReadInlinePhoto()
+//
+// Description: Read the whole bitmap file kept in a Photo BLOB.
+//
+// Parameters:
+//			pILockBytes	- Photo BLOB
+//			ppbData		- Receives the bytes, freed with CoTaskMemFree
+//			pcbData		- Receives the number of bytes, 0 if none
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT PhotoStore::ReadInlinePhoto(ILockBytes *pILockBytes, BYTE **ppbData, DWORD *pcbData)
+{
+	HRESULT			hr			= NOERROR;
+	BYTE			*pbData		= NULL;
+	BYTE			*pbGrown;
+	DWORD			cbData		= 0;
+	DWORD			cbAlloc		= 0;
+	ULONG			ulRead;
+	ULARGE_INTEGER	ulStart;
+
+	*ppbData = NULL;
+	*pcbData = 0;
+
+	for (;;)
+	{
+		if (cbAlloc - cbData < BLOB_COPY_BUFFER_SIZE)
+		{
+			pbGrown = (BYTE*)CoTaskMemRealloc(pbData, cbAlloc + BLOB_COPY_BUFFER_SIZE);
+			if (NULL == pbGrown)
+			{
+				hr = E_OUTOFMEMORY;
+				goto Exit;
+			}
+
+			pbData	= pbGrown;
+			cbAlloc	+= BLOB_COPY_BUFFER_SIZE;
+		}
+
+		ulRead = 0;
+		ulStart.QuadPart = cbData;
+		hr = pILockBytes->ReadAt(ulStart, pbData + cbData, BLOB_COPY_BUFFER_SIZE, &ulRead);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		cbData += ulRead;
+
+		if (ulRead < BLOB_COPY_BUFFER_SIZE)
+		{
+			break;
+		}
+	}
+
+	hr = NOERROR;
+
+	*ppbData = pbData;
+	*pcbData = cbData;
+	pbData = NULL;
+
+Exit:
+	if (pbData)
+	{
+		CoTaskMemFree(pbData);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PhotoStore::Checksum()
+//
+// Description: Returns the CRC-32 of bytes.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD PhotoStore::Checksum(const BYTE *pbData, DWORD cbData)
+{
+	DWORD dwCrc = 0xFFFFFFFF;
+
+	while (cbData--)
+	{
+		dwCrc ^= *pbData++;
+		dwCrc = (dwCrc >> 4) ^ s_rgdwCrcNibble[dwCrc & 0x0F];
+		dwCrc = (dwCrc >> 4) ^ s_rgdwCrcNibble[dwCrc & 0x0F];
+	}
+
+	return ~dwCrc;
+}
@@ -0,0 +1,168 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: PhotoStore
+//
+// File: PhotoStore.h
+//
+// Comment: Employee photos kept in memory mapped files beside the database.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_PHOTOSTORE_H__6D2F81C4_B0E7_4A93_9C5D_E13A47F806B2__INCLUDED_)
+#define AFX_PHOTOSTORE_H__6D2F81C4_B0E7_4A93_9C5D_E13A47F806B2__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define PHOTO_STORE_SUFFIX				L".photo"		// <database>.photo.<generation>
+#define PHOTO_STORE_MAX_FILES			4				// Generations open at once
+#define PHOTO_STORE_ALIGN				8				// Extents start on this boundary
+
+#define PHOTO_STORE_FILE_SIGNATURE		0x544F4850		// "PHOT"
+#define PHOTO_STORE_EXTENT_SIGNATURE	0x54584550		// "PEXT"
+#define PHOTO_STORE_REF_SIGNATURE		0x46455250		// "PREF", never the "BM" of a bitmap
+
+////////////////////////////////////////////////////////////////////////////////
+// What the Photo column holds for a photo kept in the store, in place of
+// the bitmap file
+//
+typedef struct tagPHOTO_STORE_REF
+{
+	DWORD		dwSignature;					// PHOTO_STORE_REF_SIGNATURE
+	DWORD		dwGeneration;					// File of the photo
+	ULONGLONG	obData;							// Offset of the bytes in the file
+	DWORD		cbData;
+	DWORD		dwChecksum;						// CRC-32 of the bytes
+} PHOTO_STORE_REF;
+
+////////////////////////////////////////////////////////////////////////////////
+// Start of a store file, followed by the extents
+//
+typedef struct tagPHOTO_STORE_FILE_HEADER
+{
+	DWORD		dwSignature;					// PHOTO_STORE_FILE_SIGNATURE
+	DWORD		dwGeneration;
+	DWORD		rgdwReserved[2];
+} PHOTO_STORE_FILE_HEADER;
+
+////////////////////////////////////////////////////////////////////////////////
+// Start of an extent, followed by its bytes and padding
+//
+typedef struct tagPHOTO_STORE_EXTENT
+{
+	DWORD		dwSignature;					// PHOTO_STORE_EXTENT_SIGNATURE
+	DWORD		cbData;
+	DWORD		dwChecksum;
+	DWORD		dwReserved;
+} PHOTO_STORE_EXTENT;
+
+////////////////////////////////////////////////////////////////////////////////
+// A read only view of a whole store file. Views are replaced when the file
+// outgrows them and freed when their last reader releases them.
+//
+typedef struct tagPHOTO_STORE_VIEW
+{
+	HANDLE		hMapping;
+	const BYTE	*pbBase;
+	ULONGLONG	cbMapped;
+	LONG		cRefs;							// Readers, and the file while current
+} PHOTO_STORE_VIEW;
+
+////////////////////////////////////////////////////////////////////////////////
+// A generation of the store
+//
+typedef struct tagPHOTO_STORE_FILE
+{
+	DWORD				dwGeneration;
+	HANDLE				hFile;
+	ULONGLONG			cbEnd;					// Where the next extent goes
+	PHOTO_STORE_VIEW	*pView;
+} PHOTO_STORE_FILE;
+
+////////////////////////////////////////////////////////////////////////////////
+// Store statistics
+//
+typedef struct tagPHOTO_STORE_STATS
+{
+	DWORD		cFiles;
+	ULONGLONG	cbFiles;
+	DWORD		cAppends;
+	ULONGLONG	cbAppended;
+	DWORD		cReads;
+	ULONGLONG	cbRead;
+	DWORD		cRemaps;						// Views replaced as the files grew
+	DWORD		cChecksumErrors;
+	DWORD		cCollections;
+	DWORD		cMoved;							// Photos copied by the last collection
+	DWORD		cMigrated;						// Inline photos moved to the store by it
+	ULONGLONG	cbReclaimed;					// Bytes of files it deleted, less the copies
+	DWORD		dwLastCollectMs;
+} PHOTO_STORE_STATS;
+
+////////////////////////////////////////////////////////////////////////////////
+// Keeps photo bytes in append only files beside the database, so that
+// photo writes don't grow the database file and photo reads don't go
+// through the provider buffer pool. The Photo column of a row holds a
+// PHOTO_STORE_REF instead of the bitmap file; rows written while the store
+// is closed keep the bitmap inline and both kinds are read.
+//
+// Reads return a pointer into a read only mapping of the file, valid until
+// the view is released; the bytes are not copied. The checksum of every
+// read is checked.
+//
+// Replaced photos leave dead extents behind. Collect copies the photos the
+// rows still refer to into a new generation file, points the rows at the
+// copies in one transaction, then deletes the older files. Until the
+// commit the rows refer to the old files, which are kept, so a failed
+// collection loses nothing.
+//
+class PhotoStore
+{
+public:
+	PhotoStore();
+	~PhotoStore();
+
+	HRESULT Open(LPCWSTR pwszDatabase, BOOL fCreate);
+	void	Close();
+	BOOL	IsOpen();
+
+	HRESULT Append(const BYTE *pbData, DWORD cbData, PHOTO_STORE_REF *pRef);
+	HRESULT Read(const PHOTO_STORE_REF *pRef, PHOTO_STORE_VIEW **ppView, const BYTE **ppbData);
+	void	ReleaseView(PHOTO_STORE_VIEW *pView);
+
+	HRESULT Collect(IDBCreateSession *pIDBCreateSession, BOOL fMigrate);
+
+	void	GetStats(PHOTO_STORE_STATS *pStats);
+
+	static HRESULT ReadRef(ILockBytes *pILockBytes, PHOTO_STORE_REF *pRef);
+
+private:
+	HRESULT OpenFile(DWORD dwGeneration, BOOL fCreate);
+	void	CloseFile(PHOTO_STORE_FILE *pFile, BOOL fDelete);
+	PHOTO_STORE_FILE* FindFile(DWORD dwGeneration);
+	HRESULT MapFile(PHOTO_STORE_FILE *pFile, ULONGLONG cbNeeded);
+	void	GetFileName(DWORD dwGeneration, WCHAR *pwszFile);
+
+	void	ReleaseViewLocked(PHOTO_STORE_VIEW *pView);
+
+	HRESULT MoveRows(IDBCreateSession *pIDBCreateSession, DWORD dwGeneration, BOOL fMigrate);
+
+	static HRESULT ReadInlinePhoto(ILockBytes *pILockBytes, BYTE **ppbData, DWORD *pcbData);
+	static DWORD Checksum(const BYTE *pbData, DWORD cbData);
+
+	CRITICAL_SECTION	m_cs;					// Guards the files, the views and the statistics
+	WCHAR				m_wszBase[MAX_PATH];	// Database name and PHOTO_STORE_SUFFIX
+	PHOTO_STORE_FILE	m_rgFile[PHOTO_STORE_MAX_FILES];	// Oldest first, appends go to the last
+	DWORD				m_cFiles;
+	PHOTO_STORE_STATS	m_Stats;
+};
+
+extern PhotoStore	g_PhotoStore;
+
+#endif // !defined(AFX_PHOTOSTORE_H__6D2F81C4_B0E7_4A93_9C5D_E13A47F806B2__INCLUDED_)
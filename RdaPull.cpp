@@ -0,0 +1,897 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: RdaPull
+//
+// File: RdaPull.cpp
+//
+// Comment: Concurrent, pipelined Remote Data Access refresh of several
+//			tables.
+//
+// Functions:
+//			1. Pull independent tables concurrently, each worker with its
+//			   own ISSCERDA agent and session
+//			2. Build the indexes of pulled tables while other tables are
+//			   still downloading
+//			3. Cap the pulls in flight by count and by estimated size
+//			4. Stand in for the server with a local .sdf file
+//
+// Notes:
+//			ISSCERDA::Pull blocks until the table is downloaded and applied,
+//			so concurrency comes from running one agent per worker thread.
+//			The first failure stops new pulls; pulls in flight complete.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "ResultCache.h"
+#include "AddressIndex.h"
+#include "RdaPull.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: PutString
+//
+// Description: Set a string property of the RDA agent. NULL strings are left
+//				at the agent default.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT PutString(ISSCERDA *pISSCERDA, HRESULT (STDMETHODCALLTYPE ISSCERDA::*pfnPut)(BSTR), LPCWSTR pwszValue)
+{
+	HRESULT	hr;
+	BSTR	bstrValue;
+
+	if (NULL == pwszValue)
+	{
+		return NOERROR;
+	}
+
+	bstrValue = SysAllocString(pwszValue);
+	if (NULL == bstrValue)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	hr = (pISSCERDA->*pfnPut)(bstrValue);
+
+	SysFreeString(bstrValue);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: DropTable
+//
+// Description: Drop a local table if it exists. A pull needs the table to
+//				be absent.
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT DropTable(IOpenRowset *pISession, LPCWSTR pwszTable)
+{
+	HRESULT	hr;
+	IRowset	*pIRowset = NULL;
+	WCHAR	wszQuery[RDA_MAX_TABLE_NAME + 16];
+
+	hr = OpenTableRowset(pISession, pwszTable, NULL, 0, IID_IRowset, (IUnknown**)&pIRowset);
+	if (DB_E_NOTABLE == hr)
+	{
+		return NOERROR;
+	}
+
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	pIRowset->Release();
+
+	wsprintf(wszQuery, L"DROP TABLE [%s]", pwszTable);
+
+	return ExecuteCommand(pISession, wszQuery);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RdaPullCoordinator::RdaPullCoordinator()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+RdaPullCoordinator::RdaPullCoordinator() : m_hPullChanged(NULL),
+										   m_hIndexChanged(NULL),
+										   m_pSettings(NULL),
+										   m_rgStats(NULL),
+										   m_fCancel(FALSE)
+{
+	InitializeCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RdaPullCoordinator::~RdaPullCoordinator()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+RdaPullCoordinator::~RdaPullCoordinator()
+{
+	DeleteCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RdaPullCoordinator::Run()
+//
+// Description: Refresh the tables of pSettings and wait for the refresh to
+//				complete.
+//
+// Parameters
+//		pSettings		- agent settings and tables, or the stand-in server
+//		rgStats			- receives the statistics of each table, one entry
+//						  per table of pSettings
+//		pdwElapsedMs	- receives the duration of the whole refresh
+//
+// Returns: NOERROR if succesfull, E_ABORT if cancelled, otherwise the first
+//			failure (the failed table has RDA_TABLE_FAILED)
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT RdaPullCoordinator::Run(const RDA_PULL_SETTINGS *pSettings, RDA_TABLE_STATS *rgStats, DWORD *pdwElapsedMs)
+{
+	HRESULT	hr					= NOERROR;
+	HANDLE	rghThreads[RDA_MAX_WORKERS + 1];
+	DWORD	cThreads			= 0;
+	DWORD	cWorkers;
+	DWORD	dwTable;
+
+	if (NULL == pSettings || NULL == pSettings->pwszLocalDatabase || NULL == pSettings->rgTables ||
+		0 == pSettings->cTables || pSettings->cTables > RDA_MAX_TABLES || NULL == rgStats || NULL == pdwElapsedMs)
+	{
+		return E_INVALIDARG;
+	}
+
+	for (dwTable = 0; dwTable < pSettings->cTables; ++dwTable)
+	{
+		const RDA_PULL_TABLE *pTable = &pSettings->rgTables[dwTable];
+
+		if (NULL == pTable->pwszLocalTable || NULL == pTable->pwszSelect ||
+			wcslen(pTable->pwszLocalTable) > RDA_MAX_TABLE_NAME)
+		{
+			return E_INVALIDARG;
+		}
+
+		// A table cannot wait for itself or for a table that is not refreshed
+		//
+		if ((pTable->ullDependsOn & ((ULONGLONG)1 << dwTable)) ||
+			(pSettings->cTables < RDA_MAX_TABLES && (pTable->ullDependsOn >> pSettings->cTables)))
+		{
+			return E_INVALIDARG;
+		}
+	}
+
+	cWorkers = pSettings->cMaxConcurrent;
+	if (cWorkers < 1)
+	{
+		cWorkers = 1;
+	}
+
+	if (cWorkers > RDA_MAX_WORKERS)
+	{
+		cWorkers = RDA_MAX_WORKERS;
+	}
+
+	if (cWorkers > pSettings->cTables)
+	{
+		cWorkers = pSettings->cTables;
+	}
+
+	memset(rgStats, 0, sizeof(RDA_TABLE_STATS)*pSettings->cTables);
+
+	m_pSettings		= pSettings;
+	m_rgStats		= rgStats;
+	m_cInFlight		= 0;
+	m_cbInFlight	= 0;
+	m_cPullsLeft	= pSettings->cTables;
+	m_ullPulled		= 0;
+	m_iIndexHead	= 0;
+	m_cIndexQueue	= 0;
+	m_hrResult		= NOERROR;
+	m_dwStartMs		= GetTickCount();
+	InterlockedExchange(&m_fCancel, FALSE);
+
+	// Manual reset: every waiter re-examines the state when it changes.
+	// The pull workers and the index thread wait for different conditions,
+	// so each has its own event and never resets the other's.
+	//
+	m_hPullChanged	= CreateEvent(NULL, TRUE, FALSE, NULL);
+	m_hIndexChanged	= CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (NULL == m_hPullChanged || NULL == m_hIndexChanged)
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto Exit;
+	}
+
+	rghThreads[cThreads] = CreateThread(NULL, 0, IndexThreadProc, this, 0, NULL);
+	if (NULL == rghThreads[cThreads])
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto Exit;
+	}
+
+	++cThreads;
+
+	for (DWORD dwWorker = 0; dwWorker < cWorkers; ++dwWorker)
+	{
+		rghThreads[cThreads] = CreateThread(NULL, 0, PullThreadProc, this, 0, NULL);
+
+		// Fewer workers only means less concurrency
+		//
+		if (NULL != rghThreads[cThreads])
+		{
+			++cThreads;
+		}
+	}
+
+	if (1 == cThreads)
+	{
+		Fail(E_OUTOFMEMORY);
+	}
+
+	WaitForMultipleObjects(cThreads, rghThreads, TRUE, INFINITE);
+
+	hr = m_fCancel ? E_ABORT : m_hrResult;
+
+	// The pulled tables replaced their rows, even when a later table failed
+	//
+	g_ResultCache.InvalidateAll();
+	g_AddressIndex.MarkAllChanged();
+
+Exit:
+	for (DWORD dwThread = 0; dwThread < cThreads; ++dwThread)
+	{
+		CloseHandle(rghThreads[dwThread]);
+	}
+
+	if (m_hPullChanged)
+	{
+		CloseHandle(m_hPullChanged);
+		m_hPullChanged = NULL;
+	}
+
+	if (m_hIndexChanged)
+	{
+		CloseHandle(m_hIndexChanged);
+		m_hIndexChanged = NULL;
+	}
+
+	*pdwElapsedMs = GetTickCount() - m_dwStartMs;
+
+	m_pSettings = NULL;
+	m_rgStats	= NULL;
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RdaPullCoordinator::Cancel()
+//
+// Description: Stop starting pulls and index builds, from another thread.
+//				Pulls in flight complete.
+//
+////////////////////////////////////////////////////////////////////////////////
+void RdaPullCoordinator::Cancel()
+{
+	EnterCriticalSection(&m_cs);
+
+	InterlockedExchange(&m_fCancel, TRUE);
+
+	if (m_hPullChanged)
+	{
+		SetEvent(m_hPullChanged);
+		SetEvent(m_hIndexChanged);
+	}
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Thread procedures
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD WINAPI RdaPullCoordinator::PullThreadProc(LPVOID lpParameter)
+{
+	return (DWORD)((RdaPullCoordinator*)lpParameter)->PullWorker();
+}
+
+DWORD WINAPI RdaPullCoordinator::IndexThreadProc(LPVOID lpParameter)
+{
+	return (DWORD)((RdaPullCoordinator*)lpParameter)->IndexWorker();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RdaPullCoordinator::PullWorker()
+//
+// Description: Pull tables until none is left. The worker has its own agent
+//				(or stand-in connection) and its own local session.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT RdaPullCoordinator::PullWorker()
+{
+	HRESULT				hr				= NOERROR;
+	IDBCreateSession	*pILocal		= NULL;		// Local data source
+	IDBCreateSession	*pIEndpoint		= NULL;		// Stand-in server data source
+	IOpenRowset			*pISession		= NULL;		// Local session
+	ISSCERDA			*pISSCERDA		= NULL;		// RDA agent
+	BOOL				fCoInit;
+	DWORD				dwTable;
+
+	fCoInit = SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+
+	hr = OpenDataSource(m_pSettings->pwszLocalDatabase, &pILocal);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pILocal->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pISession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	if (m_pSettings->pwszLocalEndpoint)
+	{
+		hr = OpenDataSource(m_pSettings->pwszLocalEndpoint, &pIEndpoint);
+	}
+	else
+	{
+		hr = CreateAgent(&pISSCERDA);
+	}
+
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	while (NextPull(&dwTable))
+	{
+		const RDA_PULL_TABLE *pTable = &m_pSettings->rgTables[dwTable];
+
+		hr = DropTable(pISession, pTable->pwszLocalTable);
+		if (SUCCEEDED(hr))
+		{
+			if (pIEndpoint)
+			{
+				hr = PullFromEndpoint(pIEndpoint, pISession, pTable, &m_rgStats[dwTable]);
+			}
+			else
+			{
+				hr = PullFromAgent(pISSCERDA, pTable);
+			}
+		}
+
+		EndPull(dwTable, hr);
+	}
+
+Exit:
+	if(FAILED(hr))
+	{
+		Fail(hr);
+	}
+
+	if (pISSCERDA)
+	{
+		pISSCERDA->Release();
+	}
+
+	if (pISession)
+	{
+		pISession->Release();
+	}
+
+	if (pIEndpoint)
+	{
+		pIEndpoint->Release();
+	}
+
+	if (pILocal)
+	{
+		pILocal->Release();
+	}
+
+	if (fCoInit)
+	{
+		CoUninitialize();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RdaPullCoordinator::IndexWorker()
+//
+// Description: Build the indexes of each pulled table, in pull order. Row
+//				counts of tables pulled by the agent are taken here too.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT RdaPullCoordinator::IndexWorker()
+{
+	HRESULT				hr				= NOERROR;
+	IDBCreateSession	*pILocal		= NULL;		// Local data source
+	IOpenRowset			*pISession		= NULL;		// Local session
+	WCHAR				wszQuery[RDA_MAX_TABLE_NAME + 32];
+	BOOL				fCoInit;
+	BOOL				fNull;
+	LONG				lRows;
+	DWORD				dwTable;
+
+	fCoInit = SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+
+	hr = OpenDataSource(m_pSettings->pwszLocalDatabase, &pILocal);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pILocal->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pISession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	while (NextIndex(&dwTable))
+	{
+		const RDA_PULL_TABLE *pTable = &m_pSettings->rgTables[dwTable];
+
+		hr = NOERROR;
+
+		if (NULL == m_pSettings->pwszLocalEndpoint)
+		{
+			wsprintf(wszQuery, L"SELECT COUNT(*) FROM [%s]", pTable->pwszLocalTable);
+
+			hr = ExecuteScalar(pISession, wszQuery, &lRows, &fNull);
+			if (SUCCEEDED(hr) && !fNull)
+			{
+				m_rgStats[dwTable].cRows = (DWORD)lRows;
+			}
+		}
+
+		for (DWORD dwIndex = 0; SUCCEEDED(hr) && dwIndex < pTable->cIndexes; ++dwIndex)
+		{
+			hr = ExecuteCommand(pISession, pTable->rgpwszIndexes[dwIndex]);
+		}
+
+		EndIndex(dwTable, hr);
+	}
+
+	hr = NOERROR;
+
+Exit:
+	if(FAILED(hr))
+	{
+		Fail(hr);
+	}
+
+	if (pISession)
+	{
+		pISession->Release();
+	}
+
+	if (pILocal)
+	{
+		pILocal->Release();
+	}
+
+	if (fCoInit)
+	{
+		CoUninitialize();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RdaPullCoordinator::NextPull()
+//
+// Description: Wait for a table that can be pulled: pending, with the tables
+//				it depends on pulled, and within the memory budget. A table
+//				always fits when nothing else is in flight.
+//
+// Returns: FALSE when the worker should stop
+//
+////////////////////////////////////////////////////////////////////////////////
+BOOL RdaPullCoordinator::NextPull(DWORD *pdwTable)
+{
+	const RDA_PULL_TABLE	*pTable;
+	BOOL					fPending;
+	DWORD					dwTable;
+
+	EnterCriticalSection(&m_cs);
+
+	for (;;)
+	{
+		if (m_fCancel || FAILED(m_hrResult))
+		{
+			break;
+		}
+
+		fPending = FALSE;
+
+		for (dwTable = 0; dwTable < m_pSettings->cTables; ++dwTable)
+		{
+			if (RDA_TABLE_PENDING != m_rgStats[dwTable].dwState)
+			{
+				continue;
+			}
+
+			fPending = TRUE;
+			pTable	 = &m_pSettings->rgTables[dwTable];
+
+			if (pTable->ullDependsOn & ~m_ullPulled)
+			{
+				continue;
+			}
+
+			if (m_pSettings->cbMemoryBudget && m_cInFlight &&
+				m_cbInFlight + pTable->cbEstimate > m_pSettings->cbMemoryBudget)
+			{
+				continue;
+			}
+
+			m_rgStats[dwTable].dwState	  = RDA_TABLE_PULLING;
+			m_rgStats[dwTable].dwQueuedMs = GetTickCount() - m_dwStartMs;
+			m_cInFlight++;
+			m_cbInFlight += pTable->cbEstimate;
+
+			LeaveCriticalSection(&m_cs);
+
+			*pdwTable = dwTable;
+			return TRUE;
+		}
+
+		if (!fPending)
+		{
+			break;
+		}
+
+		// Nothing in flight can satisfy the dependencies that are left
+		//
+		if (0 == m_cInFlight)
+		{
+			m_hrResult = E_INVALIDARG;
+			SetEvent(m_hPullChanged);
+			SetEvent(m_hIndexChanged);
+			break;
+		}
+
+		ResetEvent(m_hPullChanged);
+		LeaveCriticalSection(&m_cs);
+
+		WaitForSingleObject(m_hPullChanged, INFINITE);
+
+		EnterCriticalSection(&m_cs);
+	}
+
+	LeaveCriticalSection(&m_cs);
+
+	return FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RdaPullCoordinator::NextIndex()
+//
+// Description: Wait for a pulled table to index.
+//
+// Returns: FALSE when every table is pulled and indexed, or on failure
+//
+////////////////////////////////////////////////////////////////////////////////
+BOOL RdaPullCoordinator::NextIndex(DWORD *pdwTable)
+{
+	DWORD	dwNow;
+
+	EnterCriticalSection(&m_cs);
+
+	for (;;)
+	{
+		if (m_fCancel || FAILED(m_hrResult))
+		{
+			break;
+		}
+
+		if (m_cIndexQueue)
+		{
+			*pdwTable = m_rgdwIndexQueue[m_iIndexHead];
+			m_iIndexHead = (m_iIndexHead + 1) % RDA_MAX_TABLES;
+			m_cIndexQueue--;
+
+			dwNow = GetTickCount();
+			m_rgStats[*pdwTable].dwState		= RDA_TABLE_INDEXING;
+			m_rgStats[*pdwTable].dwIndexWaitMs	= dwNow - m_rgdwPulledMs[*pdwTable];
+			m_rgdwPulledMs[*pdwTable]			= dwNow;
+
+			LeaveCriticalSection(&m_cs);
+			return TRUE;
+		}
+
+		if (0 == m_cPullsLeft)
+		{
+			break;
+		}
+
+		ResetEvent(m_hIndexChanged);
+		LeaveCriticalSection(&m_cs);
+
+		WaitForSingleObject(m_hIndexChanged, INFINITE);
+
+		EnterCriticalSection(&m_cs);
+	}
+
+	LeaveCriticalSection(&m_cs);
+
+	return FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RdaPullCoordinator::EndPull()
+//
+// Description: Record the end of a pull and hand the table to the index
+//				thread.
+//
+////////////////////////////////////////////////////////////////////////////////
+void RdaPullCoordinator::EndPull(DWORD dwTable, HRESULT hr)
+{
+	RDA_TABLE_STATS	*pStats = &m_rgStats[dwTable];
+	DWORD			dwNow	= GetTickCount();
+
+	EnterCriticalSection(&m_cs);
+
+	m_cInFlight--;
+	m_cbInFlight -= m_pSettings->rgTables[dwTable].cbEstimate;
+	m_cPullsLeft--;
+
+	pStats->dwPullMs = dwNow - m_dwStartMs - pStats->dwQueuedMs;
+	pStats->hr		 = hr;
+
+	if (FAILED(hr))
+	{
+		pStats->dwState	  = RDA_TABLE_FAILED;
+		pStats->dwTotalMs = dwNow - m_dwStartMs;
+
+		if (SUCCEEDED(m_hrResult))
+		{
+			m_hrResult = hr;
+		}
+	}
+	else
+	{
+		pStats->dwState = RDA_TABLE_PULLED;
+		m_ullPulled |= (ULONGLONG)1 << dwTable;
+		m_rgdwPulledMs[dwTable] = dwNow;
+
+		m_rgdwIndexQueue[(m_iIndexHead + m_cIndexQueue) % RDA_MAX_TABLES] = dwTable;
+		m_cIndexQueue++;
+	}
+
+	SetEvent(m_hPullChanged);
+	SetEvent(m_hIndexChanged);
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RdaPullCoordinator::EndIndex()
+//
+// Description: Record the end of the index build; the table is ready.
+//
+////////////////////////////////////////////////////////////////////////////////
+void RdaPullCoordinator::EndIndex(DWORD dwTable, HRESULT hr)
+{
+	RDA_TABLE_STATS	*pStats = &m_rgStats[dwTable];
+	DWORD			dwNow	= GetTickCount();
+
+	EnterCriticalSection(&m_cs);
+
+	pStats->dwIndexMs = dwNow - m_rgdwPulledMs[dwTable];
+	pStats->dwTotalMs = dwNow - m_dwStartMs;
+	pStats->dwState	  = FAILED(hr) ? RDA_TABLE_FAILED : RDA_TABLE_DONE;
+	pStats->hr		  = hr;
+
+	if (FAILED(hr) && SUCCEEDED(m_hrResult))
+	{
+		m_hrResult = hr;
+		SetEvent(m_hPullChanged);
+	}
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RdaPullCoordinator::Fail()
+//
+// Description: Record a failure that is not tied to a table and stop the
+//				refresh.
+//
+////////////////////////////////////////////////////////////////////////////////
+void RdaPullCoordinator::Fail(HRESULT hr)
+{
+	EnterCriticalSection(&m_cs);
+
+	if (SUCCEEDED(m_hrResult))
+	{
+		m_hrResult = hr;
+	}
+
+	SetEvent(m_hPullChanged);
+	SetEvent(m_hIndexChanged);
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RdaPullCoordinator::CreateAgent()
+//
+// Description: Create an RDA agent connected to the local database.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT RdaPullCoordinator::CreateAgent(ISSCERDA **ppISSCERDA)
+{
+	HRESULT		hr			= NOERROR;
+	ISSCERDA	*pISSCERDA	= NULL;
+	WCHAR		wszConnect[MAX_PATH + 32];
+
+	*ppISSCERDA = NULL;
+
+	hr = CoCreateInstance(CLSID_RemoteDataAccess, NULL, CLSCTX_INPROC_SERVER, IID_ISSCERDA, (void**)&pISSCERDA);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	wsprintf(wszConnect, L"Data Source=%s", m_pSettings->pwszLocalDatabase);
+
+	if (FAILED(hr = PutString(pISSCERDA, &ISSCERDA::put_LocalConnectionString, wszConnect)) ||
+		FAILED(hr = PutString(pISSCERDA, &ISSCERDA::put_InternetURL,			m_pSettings->pwszInternetURL)) ||
+		FAILED(hr = PutString(pISSCERDA, &ISSCERDA::put_InternetLogin,		m_pSettings->pwszInternetLogin)) ||
+		FAILED(hr = PutString(pISSCERDA, &ISSCERDA::put_InternetPassword,		m_pSettings->pwszInternetPassword)))
+	{
+		goto Exit;
+	}
+
+	hr = pISSCERDA->put_CompressionLevel(m_pSettings->nCompressionLevel);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	if ((m_pSettings->lConnectTimeout && FAILED(hr = pISSCERDA->put_ConnectTimeout(m_pSettings->lConnectTimeout))) ||
+		(m_pSettings->lSendTimeout	  && FAILED(hr = pISSCERDA->put_SendTimeout(m_pSettings->lSendTimeout))) ||
+		(m_pSettings->lReceiveTimeout && FAILED(hr = pISSCERDA->put_ReceiveTimeout(m_pSettings->lReceiveTimeout))))
+	{
+		goto Exit;
+	}
+
+	*ppISSCERDA = pISSCERDA;
+	pISSCERDA	= NULL;
+
+Exit:
+	if (pISSCERDA)
+	{
+		pISSCERDA->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RdaPullCoordinator::PullFromAgent()
+//
+// Description: Pull one table through the RDA agent.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT RdaPullCoordinator::PullFromAgent(ISSCERDA *pISSCERDA, const RDA_PULL_TABLE *pTable)
+{
+	HRESULT	hr				= NOERROR;
+	BSTR	bstrTable		= SysAllocString(pTable->pwszLocalTable);
+	BSTR	bstrSelect		= SysAllocString(pTable->pwszSelect);
+	BSTR	bstrConnect		= SysAllocString(m_pSettings->pwszRemoteConnect ? m_pSettings->pwszRemoteConnect : L"");
+	BSTR	bstrErrorTable	= SysAllocString(pTable->pwszErrorTable ? pTable->pwszErrorTable : L"");
+
+	if (NULL == bstrTable || NULL == bstrSelect || NULL == bstrConnect || NULL == bstrErrorTable)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	hr = pISSCERDA->Pull(bstrTable, bstrSelect, bstrConnect, pTable->eTrackOption, bstrErrorTable);
+
+Exit:
+	SysFreeString(bstrTable);
+	SysFreeString(bstrSelect);
+	SysFreeString(bstrConnect);
+	SysFreeString(bstrErrorTable);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RdaPullCoordinator::PullFromEndpoint()
+//
+// Description: Pull one table from the stand-in server: run the query on
+//				it, then create the local table and copy the rows in one
+//				local transaction, as the agent applies a pull.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT RdaPullCoordinator::PullFromEndpoint(IDBCreateSession	*pIEndpoint,
+											 IOpenRowset		*pISession,
+											 const RDA_PULL_TABLE *pTable,
+											 RDA_TABLE_STATS	*pStats)
+{
+	HRESULT				hr					= NOERROR;
+	IOpenRowset			*pIEndpointSession	= NULL;		// Provider Interface Pointer
+	IRowset				*pIRowset			= NULL;		// Provider Interface Pointer
+	ITransactionLocal	*pITxnLocal			= NULL;		// Provider Interface Pointer
+
+	hr = pIEndpoint->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pIEndpointSession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = ExecuteQuery(pIEndpointSession, pTable->pwszSelect, &pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pISession->QueryInterface(IID_ITransactionLocal, (void**)&pITxnLocal);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pITxnLocal->StartTransaction(ISOLATIONLEVEL_READCOMMITTED | ISOLATIONLEVEL_CURSORSTABILITY, 0, NULL, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = CreateTableFromRowset(pIRowset, pISession, pTable->pwszLocalTable);
+	if(FAILED(hr))
+	{
+		goto Abort;
+	}
+
+	// Only this worker writes the statistics of the table while it pulls
+	//
+	hr = CopyRowset(pIRowset, pISession, pTable->pwszLocalTable, &pStats->cRows, &pStats->cbBytes);
+	if(FAILED(hr))
+	{
+		goto Abort;
+	}
+
+	hr = pITxnLocal->Commit(FALSE, XACTTC_SYNC, 0);
+	goto Exit;
+
+Abort:
+	pITxnLocal->Abort(NULL, FALSE, FALSE);
+
+Exit:
+	if (pITxnLocal)
+	{
+		pITxnLocal->Release();
+	}
+
+	if (pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	if (pIEndpointSession)
+	{
+		pIEndpointSession->Release();
+	}
+
+	return hr;
+}
@@ -0,0 +1,155 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: RdaPull
+//
+// File: RdaPull.h
+//
+// Comment: Concurrent, pipelined Remote Data Access refresh of several
+//			tables.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_RDAPULL_H__C41F6A92_0B7D_4E25_9A83_6D2E15B0F7C4__INCLUDED_)
+#define AFX_RDAPULL_H__C41F6A92_0B7D_4E25_9A83_6D2E15B0F7C4__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include "sqlce_sync.h"
+
+#define RDA_MAX_TABLES				64				// Dependencies are a 64 bit mask
+#define RDA_MAX_WORKERS				8
+#define RDA_MAX_TABLE_NAME			128
+
+// Table states
+//
+#define RDA_TABLE_PENDING			0
+#define RDA_TABLE_PULLING			1
+#define RDA_TABLE_PULLED			2				// Waiting for its indexes
+#define RDA_TABLE_INDEXING			3
+#define RDA_TABLE_DONE				4
+#define RDA_TABLE_FAILED			5
+
+////////////////////////////////////////////////////////////////////////////////
+// One table to refresh. The local table is dropped and pulled again.
+//
+typedef struct tagRDA_PULL_TABLE
+{
+	LPCWSTR			pwszLocalTable;
+	LPCWSTR			pwszSelect;				// Query run on the server
+	RDA_TRACKOPTION	eTrackOption;			// TRACKINGOFF or TRACKINGON
+	LPCWSTR			pwszErrorTable;			// NULL for none
+
+	// Index statements run once the rows are local. The pull itself never
+	// brings indexes, so the next pull overlaps with this index build.
+	//
+	LPCWSTR			*rgpwszIndexes;
+	DWORD			cIndexes;
+
+	ULONGLONG		ullDependsOn;			// Bit n set: table n is pulled first
+	DWORD			cbEstimate;				// Expected download size
+} RDA_PULL_TABLE;
+
+////////////////////////////////////////////////////////////////////////////////
+// Refresh settings. Strings that are NULL are not set on the agent.
+//
+typedef struct tagRDA_PULL_SETTINGS
+{
+	LPCWSTR					pwszLocalDatabase;		// Local .sdf file
+	LPCWSTR					pwszInternetURL;		// sqlcesa35.dll URL
+	LPCWSTR					pwszInternetLogin;
+	LPCWSTR					pwszInternetPassword;
+	LPCWSTR					pwszRemoteConnect;		// OLE DB connection string of the server
+	short					nCompressionLevel;		// 0 - 6, 1 is the agent default
+	LONG					lConnectTimeout;		// Milliseconds, 0 keeps the default
+	LONG					lSendTimeout;
+	LONG					lReceiveTimeout;
+
+	DWORD					cMaxConcurrent;			// Pulls in flight, 1 - RDA_MAX_WORKERS
+	DWORD					cbMemoryBudget;			// Sum of cbEstimate in flight, 0 for no limit
+
+	const RDA_PULL_TABLE	*rgTables;
+	DWORD					cTables;
+
+	// When set, the named .sdf file stands in for the server: each query
+	// runs against it and the rows are copied into the local database. Used
+	// to test and benchmark without a server.
+	//
+	LPCWSTR					pwszLocalEndpoint;
+} RDA_PULL_SETTINGS;
+
+////////////////////////////////////////////////////////////////////////////////
+// Refresh statistics of one table. Times are in milliseconds.
+//
+typedef struct tagRDA_TABLE_STATS
+{
+	DWORD		dwState;				// RDA_TABLE_*
+	HRESULT		hr;
+	DWORD		dwQueuedMs;				// Refresh start to pull start
+	DWORD		dwPullMs;
+	DWORD		dwIndexWaitMs;			// Pull end to index start
+	DWORD		dwIndexMs;
+	DWORD		dwTotalMs;				// Refresh start to table ready
+	DWORD		cRows;
+	ULONGLONG	cbBytes;				// Known with the stand-in server only
+} RDA_TABLE_STATS;
+
+////////////////////////////////////////////////////////////////////////////////
+// Pulls independent tables concurrently, each worker with its own agent and
+// session, while a separate thread builds the indexes of the tables already
+// pulled.
+//
+class RdaPullCoordinator
+{
+public:
+	RdaPullCoordinator();
+	~RdaPullCoordinator();
+
+	HRESULT Run(const RDA_PULL_SETTINGS *pSettings, RDA_TABLE_STATS *rgStats, DWORD *pdwElapsedMs);
+	void	Cancel();
+
+private:
+	static DWORD WINAPI PullThreadProc(LPVOID lpParameter);
+	static DWORD WINAPI IndexThreadProc(LPVOID lpParameter);
+
+	HRESULT PullWorker();
+	HRESULT IndexWorker();
+	BOOL	NextPull(DWORD *pdwTable);
+	BOOL	NextIndex(DWORD *pdwTable);
+	void	EndPull(DWORD dwTable, HRESULT hr);
+	void	EndIndex(DWORD dwTable, HRESULT hr);
+	void	Fail(HRESULT hr);
+
+	HRESULT CreateAgent(ISSCERDA **ppISSCERDA);
+	HRESULT PullFromAgent(ISSCERDA *pISSCERDA, const RDA_PULL_TABLE *pTable);
+	HRESULT PullFromEndpoint(IDBCreateSession *pIEndpoint, IOpenRowset *pISession, const RDA_PULL_TABLE *pTable, RDA_TABLE_STATS *pStats);
+
+	CRITICAL_SECTION		m_cs;					// Guards everything below
+	HANDLE					m_hPullChanged;			// Set when a pull may start
+	HANDLE					m_hIndexChanged;		// Set when a table may be indexed
+
+	const RDA_PULL_SETTINGS	*m_pSettings;
+	RDA_TABLE_STATS			*m_rgStats;
+	DWORD					m_dwStartMs;
+	DWORD					m_rgdwPulledMs[RDA_MAX_TABLES];
+
+	DWORD					m_cInFlight;
+	DWORD					m_cbInFlight;
+	DWORD					m_cPullsLeft;			// Tables not pulled or failed yet
+	ULONGLONG				m_ullPulled;
+
+	DWORD					m_rgdwIndexQueue[RDA_MAX_TABLES];
+	DWORD					m_iIndexHead;
+	DWORD					m_cIndexQueue;
+
+	HRESULT					m_hrResult;				// First failure
+	LONG					m_fCancel;
+};
+
+#endif // !defined(AFX_RDAPULL_H__C41F6A92_0B7D_4E25_9A83_6D2E15B0F7C4__INCLUDED_)
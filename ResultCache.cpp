@@ -0,0 +1,462 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: ResultCache
+//
+// File: ResultCache.cpp
+//
+// Comment: Read-through cache of decoded query results.
+//
+// Functions:
+//			1. Keep decoded results keyed by query shape and EmployeeID range
+//			2. Drop the results a write touches
+//			3. Stay within a memory budget, least recently used first
+//
+// Notes:
+//			Values older than the TTL are never served. The TTL bounds how
+//			long a change made outside this process, by a merge or an RDA
+//			pull for instance, can go unseen when its caller doesn't
+//			invalidate the cache itself.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "ResultCache.h"
+
+ResultCache	g_ResultCache;							// Results read from the application database
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: HashKey
+//
+// Description: Returns the bucket of a key.
+//
+////////////////////////////////////////////////////////////////////////////////
+static DWORD HashKey(DWORD dwShape, DWORD dwFirstID, DWORD dwLastID)
+{
+	DWORD dwHash = dwShape;
+
+	dwHash = dwHash * 31 + dwFirstID;
+	dwHash = dwHash * 31 + dwLastID;
+
+	return dwHash % RESULT_CACHE_BUCKETS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ResultCache::ResultCache()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+ResultCache::ResultCache() : m_cbBudget(RESULT_CACHE_DEFAULT_BUDGET),
+							 m_dwTtlMs(RESULT_CACHE_DEFAULT_TTL),
+							 m_pNewest(NULL),
+							 m_pOldest(NULL),
+							 m_dwGeneration(0)
+{
+	InitializeCriticalSection(&m_cs);
+	memset(m_rgpBucket, 0, sizeof(m_rgpBucket));
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ResultCache::~ResultCache()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+ResultCache::~ResultCache()
+{
+	while (m_pOldest)
+	{
+		RemoveEntry(m_pOldest);
+	}
+
+	DeleteCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ResultCache::Configure()
+//
+// Description: Set the memory budget and the TTL of the values.
+//
+// Parameters:
+//			cbBudget	- Bytes of values held at most, 0 disables the cache
+//			dwTtlMs		- Milliseconds a value is served after it was stored
+//
+////////////////////////////////////////////////////////////////////////////////
+void ResultCache::Configure(DWORD cbBudget, DWORD dwTtlMs)
+{
+	EnterCriticalSection(&m_cs);
+
+	m_cbBudget	= cbBudget;
+	m_dwTtlMs	= dwTtlMs;
+
+	Trim(0);
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ResultCache::Lookup()
+//
+// Description: Copy the value of a result read within the TTL.
+//
+// Parameters:
+//			dwShape		- Query shape, RESULT_SHAPE_*
+//			dwFirstID	- First EmployeeID of the query
+//			dwLastID	- Last EmployeeID of the query
+//			ppvValue	- Copy of the value, freed with CoTaskMemFree
+//			pcbValue	- Size of the value, may be NULL
+//
+// Returns: NOERROR if found, S_FALSE if the result isn't cached
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ResultCache::Lookup(DWORD dwShape, DWORD dwFirstID, DWORD dwLastID, void **ppvValue, DWORD *pcbValue)
+{
+	HRESULT				hr			= NOERROR;
+	RESULT_CACHE_ENTRY	*pEntry		= NULL;
+	void				*pvValue	= NULL;
+
+	if (NULL == ppvValue)
+	{
+		return E_INVALIDARG;
+	}
+
+	*ppvValue = NULL;
+
+	EnterCriticalSection(&m_cs);
+
+	++m_Stats.cLookups;
+
+	pEntry = FindEntry(dwShape, dwFirstID, dwLastID);
+	if (NULL == pEntry)
+	{
+		hr = S_FALSE;
+		goto Exit;
+	}
+
+	if (GetTickCount() - pEntry->dwStoredMs >= m_dwTtlMs)
+	{
+		++m_Stats.cExpired;
+		RemoveEntry(pEntry);
+
+		hr = S_FALSE;
+		goto Exit;
+	}
+
+	pvValue = CoTaskMemAlloc(pEntry->cbValue);
+	if (NULL == pvValue)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	memcpy(pvValue, pEntry->rgbValue, pEntry->cbValue);
+
+	// Make it the most recently used
+	//
+	if (pEntry != m_pNewest)
+	{
+		pEntry->pNewer->pOlder = pEntry->pOlder;
+		if (pEntry->pOlder)
+		{
+			pEntry->pOlder->pNewer = pEntry->pNewer;
+		}
+		else
+		{
+			m_pOldest = pEntry->pNewer;
+		}
+
+		pEntry->pOlder		= m_pNewest;
+		pEntry->pNewer		= NULL;
+		m_pNewest->pNewer	= pEntry;
+		m_pNewest			= pEntry;
+	}
+
+	++m_Stats.cHits;
+
+	*ppvValue = pvValue;
+	if (pcbValue)
+	{
+		*pcbValue = pEntry->cbValue;
+	}
+
+Exit:
+	LeaveCriticalSection(&m_cs);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ResultCache::Store()
+//
+// Description: Copy the value of a result just read, replacing the value
+//				cached for the same key.
+//
+// Parameters:
+//			dwShape		- Query shape, RESULT_SHAPE_*
+//			dwFirstID	- First EmployeeID of the query
+//			dwLastID	- Last EmployeeID of the query
+//			pvValue		- Decoded result
+//			cbValue		- Size of the value
+//			dwGeneration	- GetGeneration taken before the result was read
+//
+// Returns: NOERROR if stored, S_FALSE if the value doesn't fit the budget
+//			or a write invalidated the cache since dwGeneration
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT ResultCache::Store(DWORD dwShape, DWORD dwFirstID, DWORD dwLastID, const void *pvValue, DWORD cbValue, DWORD dwGeneration)
+{
+	RESULT_CACHE_ENTRY	*pEntry		= NULL;
+	RESULT_CACHE_ENTRY	*pOld		= NULL;
+	DWORD				iBucket;
+
+	if (NULL == pvValue || dwFirstID > dwLastID)
+	{
+		return E_INVALIDARG;
+	}
+
+	if (cbValue > m_cbBudget)
+	{
+		return S_FALSE;
+	}
+
+	pEntry = (RESULT_CACHE_ENTRY*)CoTaskMemAlloc(sizeof(RESULT_CACHE_ENTRY) + cbValue);
+	if (NULL == pEntry)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	pEntry->dwShape		= dwShape;
+	pEntry->dwFirstID	= dwFirstID;
+	pEntry->dwLastID	= dwLastID;
+	pEntry->dwStoredMs	= GetTickCount();
+	pEntry->cbValue		= cbValue;
+	memcpy(pEntry->rgbValue, pvValue, cbValue);
+
+	EnterCriticalSection(&m_cs);
+
+	// The rows may have been written after they were read; the value
+	// would then be served until its TTL runs out
+	//
+	if (dwGeneration != m_dwGeneration)
+	{
+		++m_Stats.cStaleStores;
+		LeaveCriticalSection(&m_cs);
+
+		CoTaskMemFree(pEntry);
+		return S_FALSE;
+	}
+
+	pOld = FindEntry(dwShape, dwFirstID, dwLastID);
+	if (pOld)
+	{
+		RemoveEntry(pOld);
+	}
+
+	Trim(cbValue);
+
+	iBucket = HashKey(dwShape, dwFirstID, dwLastID);
+
+	pEntry->pNextInBucket	= m_rgpBucket[iBucket];
+	m_rgpBucket[iBucket]	= pEntry;
+
+	pEntry->pNewer			= NULL;
+	pEntry->pOlder			= m_pNewest;
+	if (m_pNewest)
+	{
+		m_pNewest->pNewer	= pEntry;
+	}
+	else
+	{
+		m_pOldest			= pEntry;
+	}
+	m_pNewest				= pEntry;
+
+	m_Stats.cbUsed += cbValue;
+	++m_Stats.cEntries;
+	++m_Stats.cStores;
+
+	LeaveCriticalSection(&m_cs);
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ResultCache::InvalidateEmployee()
+//
+// Description: Drop the results read from a range that holds an employee.
+//				Called by the paths that write the row of the employee,
+//				after the write is committed.
+//
+////////////////////////////////////////////////////////////////////////////////
+void ResultCache::InvalidateEmployee(DWORD dwEmployeeID)
+{
+	RESULT_CACHE_ENTRY	*pEntry;
+	RESULT_CACHE_ENTRY	*pNewer;
+
+	EnterCriticalSection(&m_cs);
+
+	++m_dwGeneration;
+
+	for (pEntry = m_pOldest; pEntry; pEntry = pNewer)
+	{
+		pNewer = pEntry->pNewer;
+
+		if (pEntry->dwFirstID <= dwEmployeeID && dwEmployeeID <= pEntry->dwLastID)
+		{
+			++m_Stats.cInvalidations;
+			RemoveEntry(pEntry);
+		}
+	}
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ResultCache::InvalidateAll()
+//
+// Description: Drop every result, after a write that doesn't tell which
+//				rows it changed.
+//
+////////////////////////////////////////////////////////////////////////////////
+void ResultCache::InvalidateAll()
+{
+	EnterCriticalSection(&m_cs);
+
+	++m_dwGeneration;
+
+	while (m_pOldest)
+	{
+		++m_Stats.cInvalidations;
+		RemoveEntry(m_pOldest);
+	}
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ResultCache::GetGeneration()
+//
+// Description: Returns the invalidation generation, taken by a reader
+//				before it reads the rows it passes to Store.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD ResultCache::GetGeneration()
+{
+	DWORD dwGeneration;
+
+	EnterCriticalSection(&m_cs);
+	dwGeneration = m_dwGeneration;
+	LeaveCriticalSection(&m_cs);
+
+	return dwGeneration;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ResultCache::GetStats()
+//
+// Description: Returns the cache statistics.
+//
+////////////////////////////////////////////////////////////////////////////////
+void ResultCache::GetStats(RESULT_CACHE_STATS *pStats)
+{
+	if (NULL == pStats)
+	{
+		return;
+	}
+
+	EnterCriticalSection(&m_cs);
+
+	*pStats = m_Stats;
+	pStats->dwHitRate = m_Stats.cLookups ? (DWORD)((ULONGLONG)m_Stats.cHits * 100 / m_Stats.cLookups) : 0;
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ResultCache::FindEntry()
+//
+// Description: Returns the entry of a key, NULL if none.
+//				Called with the critical section held.
+//
+////////////////////////////////////////////////////////////////////////////////
+RESULT_CACHE_ENTRY* ResultCache::FindEntry(DWORD dwShape, DWORD dwFirstID, DWORD dwLastID)
+{
+	RESULT_CACHE_ENTRY	*pEntry;
+
+	for (pEntry = m_rgpBucket[HashKey(dwShape, dwFirstID, dwLastID)]; pEntry; pEntry = pEntry->pNextInBucket)
+	{
+		if (pEntry->dwShape == dwShape && pEntry->dwFirstID == dwFirstID && pEntry->dwLastID == dwLastID)
+		{
+			return pEntry;
+		}
+	}
+
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ResultCache::RemoveEntry()
+//
+// Description: Unlink and free an entry.
+//				Called with the critical section held.
+//
+////////////////////////////////////////////////////////////////////////////////
+void ResultCache::RemoveEntry(RESULT_CACHE_ENTRY *pEntry)
+{
+	RESULT_CACHE_ENTRY	**ppLink;
+
+	ppLink = &m_rgpBucket[HashKey(pEntry->dwShape, pEntry->dwFirstID, pEntry->dwLastID)];
+	while (*ppLink != pEntry)
+	{
+		ppLink = &(*ppLink)->pNextInBucket;
+	}
+	*ppLink = pEntry->pNextInBucket;
+
+	if (pEntry->pNewer)
+	{
+		pEntry->pNewer->pOlder = pEntry->pOlder;
+	}
+	else
+	{
+		m_pNewest = pEntry->pOlder;
+	}
+
+	if (pEntry->pOlder)
+	{
+		pEntry->pOlder->pNewer = pEntry->pNewer;
+	}
+	else
+	{
+		m_pOldest = pEntry->pNewer;
+	}
+
+	m_Stats.cbUsed -= pEntry->cbValue;
+	--m_Stats.cEntries;
+
+	CoTaskMemFree(pEntry);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: ResultCache::Trim()
+//
+// Description: Drop the least recently used values until cbFree more bytes
+//				fit the budget. Called with the critical section held.
+//
+////////////////////////////////////////////////////////////////////////////////
+void ResultCache::Trim(DWORD cbFree)
+{
+	while (m_pOldest && m_Stats.cbUsed + cbFree > m_cbBudget)
+	{
+		++m_Stats.cEvictions;
+		RemoveEntry(m_pOldest);
+	}
+}
@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: ResultCache
+//
+// File: ResultCache.h
+//
+// Comment: Read-through cache of decoded query results.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_RESULTCACHE_H__E7B3052C_91D4_4A68_BF20_6C8D1A4E93F5__INCLUDED_)
+#define AFX_RESULTCACHE_H__E7B3052C_91D4_4A68_BF20_6C8D1A4E93F5__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define RESULT_CACHE_BUCKETS			64
+#define RESULT_CACHE_DEFAULT_BUDGET		(512 * 1024)	// Bytes of cached values
+#define RESULT_CACHE_DEFAULT_TTL		30000			// Milliseconds a value is served
+
+// Query shapes. A result is keyed by its shape and the EmployeeID range it
+// was read from; a point lookup has dwFirstID == dwLastID.
+//
+#define RESULT_SHAPE_EMPLOYEE_INFO		1				// EMPLOYEE_INFO_RECORD, see EmployeeStore.h
+
+////////////////////////////////////////////////////////////////////////////////
+// A cached value. Entries are chained in their hash bucket and in the
+// recently used list.
+//
+typedef struct tagRESULT_CACHE_ENTRY
+{
+	struct tagRESULT_CACHE_ENTRY	*pNextInBucket;
+	struct tagRESULT_CACHE_ENTRY	*pNewer;
+	struct tagRESULT_CACHE_ENTRY	*pOlder;
+	DWORD							dwShape;
+	DWORD							dwFirstID;
+	DWORD							dwLastID;
+	DWORD							dwStoredMs;
+	DWORD							cbValue;
+	BYTE							rgbValue[1];
+} RESULT_CACHE_ENTRY;
+
+////////////////////////////////////////////////////////////////////////////////
+// Cache statistics
+//
+typedef struct tagRESULT_CACHE_STATS
+{
+	DWORD		cLookups;
+	DWORD		cHits;
+	DWORD		cExpired;								// Lookups that found a value past its TTL
+	DWORD		cStores;
+	DWORD		cEvictions;								// Values dropped to stay in the budget
+	DWORD		cInvalidations;							// Values dropped by writes
+	DWORD		cStaleStores;							// Values not stored, read before a write
+	DWORD		cEntries;
+	DWORD		cbUsed;
+	DWORD		dwHitRate;								// Percent of the lookups
+} RESULT_CACHE_STATS;
+
+////////////////////////////////////////////////////////////////////////////////
+// Holds recently read results so that reading them again within the TTL
+// doesn't reach the provider. Every path that writes Employees rows calls
+// InvalidateEmployee for the rows it wrote, or InvalidateAll when it can't
+// tell which rows changed. Values are copied in and out, so an entry can be
+// dropped while a caller uses its copy.
+//
+// A reader takes GetGeneration before it reads the rows and passes it to
+// Store. Every invalidation moves the generation on, so a value read
+// before a write committed is not stored after the write invalidated it.
+//
+class ResultCache
+{
+public:
+	ResultCache();
+	~ResultCache();
+
+	void	Configure(DWORD cbBudget, DWORD dwTtlMs);
+
+	HRESULT Lookup(DWORD dwShape, DWORD dwFirstID, DWORD dwLastID, void **ppvValue, DWORD *pcbValue);
+	HRESULT Store(DWORD dwShape, DWORD dwFirstID, DWORD dwLastID, const void *pvValue, DWORD cbValue, DWORD dwGeneration);
+	DWORD	GetGeneration();
+
+	void	InvalidateEmployee(DWORD dwEmployeeID);
+	void	InvalidateAll();
+
+	void	GetStats(RESULT_CACHE_STATS *pStats);
+
+private:
+	RESULT_CACHE_ENTRY* FindEntry(DWORD dwShape, DWORD dwFirstID, DWORD dwLastID);
+	void	RemoveEntry(RESULT_CACHE_ENTRY *pEntry);
+	void	Trim(DWORD cbFree);
+
+	CRITICAL_SECTION	m_cs;
+	DWORD				m_cbBudget;
+	DWORD				m_dwTtlMs;
+	RESULT_CACHE_ENTRY	*m_rgpBucket[RESULT_CACHE_BUCKETS];
+	RESULT_CACHE_ENTRY	*m_pNewest;
+	RESULT_CACHE_ENTRY	*m_pOldest;
+	DWORD				m_dwGeneration;			// Moved on by every invalidation
+	RESULT_CACHE_STATS	m_Stats;
+};
+
+extern ResultCache	g_ResultCache;
+
+#endif // !defined(AFX_RESULTCACHE_H__E7B3052C_91D4_4A68_BF20_6C8D1A4E93F5__INCLUDED_)
@@ -0,0 +1,370 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: RowVersion
+//
+// File: RowVersion.cpp
+//
+// Comment: Row versions of the Employees table for optimistic concurrency.
+//
+// Functions:
+//			1. Add the row version column to existing databases
+//			2. Read the row version of a row
+//			3. Remember the versions read by the application
+//
+// Notes:
+//			LoadEmployeeInfo remembers the version of the row it displays,
+//			and SaveEmployeeInfo applies an edit only if the row still has
+//			that version. No lock is held while the user edits.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "RowVersion.h"
+
+RowVersionCache		g_RowVersions;				// Versions read by the employees dialog
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RowVersionCache::RowVersionCache()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+RowVersionCache::RowVersionCache() : m_cVersions(0),
+									 m_iNext(0)
+{
+	InitializeCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RowVersionCache::~RowVersionCache()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+RowVersionCache::~RowVersionCache()
+{
+	DeleteCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RowVersionCache::Remember()
+//
+// Description: Record the version of a row read or written.
+//
+////////////////////////////////////////////////////////////////////////////////
+void RowVersionCache::Remember(DWORD dwEmployeeID, ULONGLONG ullVersion)
+{
+	DWORD iVersion;
+
+	EnterCriticalSection(&m_cs);
+
+	for (iVersion = 0; iVersion < m_cVersions; ++iVersion)
+	{
+		if (dwEmployeeID == m_rgdwEmployeeID[iVersion])
+		{
+			break;
+		}
+	}
+
+	if (iVersion == m_cVersions)
+	{
+		if (m_cVersions < ROW_VERSION_CACHE_SIZE)
+		{
+			++m_cVersions;
+		}
+		else
+		{
+			iVersion = m_iNext;
+			m_iNext	 = (m_iNext + 1) % ROW_VERSION_CACHE_SIZE;
+		}
+	}
+
+	m_rgdwEmployeeID[iVersion]	= dwEmployeeID;
+	m_rgullVersion[iVersion]	= ullVersion;
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RowVersionCache::Lookup()
+//
+// Description: Returns the version remembered for a row.
+//
+// Returns: NOERROR if found, S_FALSE if no version is remembered
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT RowVersionCache::Lookup(DWORD dwEmployeeID, ULONGLONG *pullVersion)
+{
+	HRESULT hr = S_FALSE;
+
+	if (NULL == pullVersion)
+	{
+		return E_INVALIDARG;
+	}
+
+	EnterCriticalSection(&m_cs);
+
+	for (DWORD iVersion = 0; iVersion < m_cVersions; ++iVersion)
+	{
+		if (dwEmployeeID == m_rgdwEmployeeID[iVersion])
+		{
+			*pullVersion = m_rgullVersion[iVersion];
+			hr = NOERROR;
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&m_cs);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: RowVersionCache::Forget()
+//
+// Description: Drop the version remembered for a row.
+//
+////////////////////////////////////////////////////////////////////////////////
+void RowVersionCache::Forget(DWORD dwEmployeeID)
+{
+	EnterCriticalSection(&m_cs);
+
+	for (DWORD iVersion = 0; iVersion < m_cVersions; ++iVersion)
+	{
+		if (dwEmployeeID == m_rgdwEmployeeID[iVersion])
+		{
+			// Keep the array dense, the replacement order doesn't matter
+			//
+			--m_cVersions;
+			m_rgdwEmployeeID[iVersion]	= m_rgdwEmployeeID[m_cVersions];
+			m_rgullVersion[iVersion]	= m_rgullVersion[m_cVersions];
+
+			if (m_iNext >= m_cVersions)
+			{
+				m_iNext = 0;
+			}
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FindRowVersionColumn
+//
+// Description: Find the row version column of a rowset.
+//
+// Returns: NOERROR if found, S_FALSE if the rowset has none
+//
+////////////////////////////////////////////////////////////////////////////////
+static HRESULT FindRowVersionColumn(IRowset *pIRowset, DBORDINAL *piOrdinal)
+{
+	HRESULT			hr				= NOERROR;
+	IColumnsInfo	*pIColumnsInfo	= NULL;			// Provider Interface Pointer
+	DBCOLUMNINFO	*pDBColumnInfo	= NULL;			// Record column metadata
+	WCHAR			*pStringsBuffer	= NULL;
+	ULONG			ulNumCols		= 0;
+
+    hr = pIRowset->QueryInterface(IID_IColumnsInfo, (void **)&pIColumnsInfo);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+    hr = pIColumnsInfo->GetColumnInfo(&ulNumCols, &pDBColumnInfo, &pStringsBuffer);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = S_FALSE;
+
+	for (ULONG ulCol = 0; ulCol < ulNumCols; ++ulCol)
+	{
+		if (pDBColumnInfo[ulCol].pwszName && 0 == _wcsicmp(pDBColumnInfo[ulCol].pwszName, COLUMN_ROW_VERSION))
+		{
+			*piOrdinal	= pDBColumnInfo[ulCol].iOrdinal;
+			hr			= NOERROR;
+			break;
+		}
+	}
+
+Exit:
+	if (pDBColumnInfo)
+	{
+		CoTaskMemFree(pDBColumnInfo);
+	}
+
+	if (pStringsBuffer)
+	{
+		CoTaskMemFree(pStringsBuffer);
+	}
+
+	if (pIColumnsInfo)
+	{
+		pIColumnsInfo->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: EnsureRowVersionColumn
+//
+// Description: Add the row version column when a database created before
+//				row versions is opened.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT EnsureRowVersionColumn(IDBCreateSession *pIDBCreateSession)
+{
+	HRESULT		hr				= NOERROR;
+	IOpenRowset	*pIOpenRowset	= NULL;			// Provider Interface Pointer
+	IRowset		*pIRowset		= NULL;			// Provider Interface Pointer
+	DBORDINAL	iOrdinal;
+
+	if (NULL == pIDBCreateSession)
+	{
+		hr = E_POINTER;
+		goto Exit;
+	}
+
+	hr = pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pIOpenRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = OpenTableRowset(pIOpenRowset, TABLE_EMPLOYEE, NULL, 0, IID_IRowset, (IUnknown**)&pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = FindRowVersionColumn(pIRowset, &iOrdinal);
+
+	// The table can't be altered while the rowset is open
+	//
+	pIRowset->Release();
+	pIRowset = NULL;
+
+	if (S_FALSE == hr)
+	{
+		hr = ExecuteCommand(pIOpenRowset, SQL_ADD_EMPLOYEES_ROW_VERSION);
+	}
+
+Exit:
+	if (pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	if (pIOpenRowset)
+	{
+		pIOpenRowset->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetRowVersion
+//
+// Description: Read the row version of a row fetched from an Employees
+//				rowset, through an accessor of its own so that the caller's
+//				bindings are unchanged.
+//
+// Parameters
+//		pIRowset	- rowset of the row
+//		hRow		- the row
+//		pullVersion	- receives the version
+//
+// Returns: NOERROR if succesfull, S_FALSE if the table has no row version
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT GetRowVersion(IRowset *pIRowset, HROW hRow, ULONGLONG *pullVersion)
+{
+	HRESULT		hr			= NOERROR;
+	IAccessor	*pIAccessor	= NULL;					// Provider Interface Pointer
+	HACCESSOR	hAccessor	= DB_NULL_HACCESSOR;	// Accessor handle
+	DBBINDING	Binding;
+	DBORDINAL	iOrdinal;
+	BYTE		rgbData[sizeof(ULONG) + sizeof(DBSTATUS) + ROW_VERSION_SIZE + sizeof(ULONGLONG)];
+
+	if (NULL == pIRowset || NULL == pullVersion)
+	{
+		return E_INVALIDARG;
+	}
+
+	*pullVersion = 0;
+
+	hr = FindRowVersionColumn(pIRowset, &iOrdinal);
+	if (NOERROR != hr)
+	{
+		return hr;
+	}
+
+	memset(&Binding, 0, sizeof(Binding));
+
+	Binding.iOrdinal	= iOrdinal;
+	Binding.dwPart		= DBPART_VALUE | DBPART_STATUS | DBPART_LENGTH;
+	Binding.obLength	= 0;
+	Binding.obStatus	= Binding.obLength + sizeof(ULONG);
+	Binding.obValue		= ROUND_UP(Binding.obStatus + sizeof(DBSTATUS), COLUMN_ALIGNVAL);
+	Binding.dwMemOwner	= DBMEMOWNER_CLIENTOWNED;
+	Binding.wType		= DBTYPE_BYTES;
+	Binding.cbMaxLen	= ROW_VERSION_SIZE;
+
+	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, 1, &Binding, 0, &hAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	memset(rgbData, 0, sizeof(rgbData));
+
+	hr = pIRowset->GetData(hRow, hAccessor, rgbData);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	if (DBSTATUS_S_OK != *(DBSTATUS *)(rgbData+Binding.obStatus))
+	{
+		hr = E_FAIL;
+		goto Exit;
+	}
+
+	// Only compared for equality, the byte order doesn't matter
+	//
+	memcpy(pullVersion, rgbData+Binding.obValue, ROW_VERSION_SIZE);
+
+Exit:
+	if (DB_NULL_HACCESSOR != hAccessor)
+	{
+		pIAccessor->ReleaseAccessor(hAccessor, NULL);
+	}
+
+	if (pIAccessor)
+	{
+		pIAccessor->Release();
+	}
+
+	return hr;
+}
@@ -0,0 +1,71 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: RowVersion
+//
+// File: RowVersion.h
+//
+// Comment: Row versions of the Employees table for optimistic concurrency.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_ROWVERSION_H__F3A1D8C2_5E6B_4A07_9C14_2B8E70D5A96C__INCLUDED_)
+#define AFX_ROWVERSION_H__F3A1D8C2_5E6B_4A07_9C14_2B8E70D5A96C__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+////////////////////////////////////////////////////////////////////////////////
+// Row version column
+//
+// The engine gives a rowversion column a new, database-wide increasing value
+// on every insert and update of the row. New tables get it from
+// EmployeeSchema.h; SQL_ADD_EMPLOYEES_ROW_VERSION upgrades older databases.
+//
+#define COLUMN_ROW_VERSION				L"RowVersion"
+#define SQL_ADD_EMPLOYEES_ROW_VERSION	L"ALTER TABLE Employees ADD RowVersion ROWVERSION"
+
+#define ROW_VERSION_SIZE				8
+#define ROW_VERSION_CACHE_SIZE			32			// Versions remembered by RowVersionCache
+
+////////////////////////////////////////////////////////////////////////////////
+// Versions read by the application, so that a save can be made conditional
+// on the row not having changed since it was read. The oldest version is
+// forgotten when the cache is full; a save of a forgotten row is not checked.
+//
+class RowVersionCache
+{
+public:
+	RowVersionCache();
+	~RowVersionCache();
+
+	void	Remember(DWORD dwEmployeeID, ULONGLONG ullVersion);
+	HRESULT Lookup(DWORD dwEmployeeID, ULONGLONG *pullVersion);
+	void	Forget(DWORD dwEmployeeID);
+
+private:
+	CRITICAL_SECTION	m_cs;
+	DWORD				m_rgdwEmployeeID[ROW_VERSION_CACHE_SIZE];
+	ULONGLONG			m_rgullVersion[ROW_VERSION_CACHE_SIZE];
+	DWORD				m_cVersions;
+	DWORD				m_iNext;					// Replaced when the cache is full
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Add the row version column to an Employees table that has none
+//
+HRESULT EnsureRowVersionColumn(IDBCreateSession *pIDBCreateSession);
+
+////////////////////////////////////////////////////////////////////////////////
+// Read the row version of a fetched row
+//
+HRESULT GetRowVersion(IRowset *pIRowset, HROW hRow, ULONGLONG *pullVersion);
+
+extern RowVersionCache	g_RowVersions;
+
+#endif // !defined(AFX_ROWVERSION_H__F3A1D8C2_5E6B_4A07_9C14_2B8E70D5A96C__INCLUDED_)
@@ -0,0 +1,667 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: SchemaCatalog
+//
+// File: SchemaCatalog.cpp
+//
+// Comment: Process-wide cache of the column metadata of the database.
+//
+// Functions:
+//			1. Read the columns of a table from the COLUMNS schema rowset
+//			2. Look up columns through a hash of their case folded names
+//			3. Drop the cached metadata when the schema changes
+//
+// Notes:
+//			The columns of a table don't change between two DDL statements,
+//			so a caller resolves its column names to SCHEMA_COLUMN handles
+//			once and binds from them, instead of fetching IColumnsInfo and
+//			searching it by name on every call.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "SchemaCatalog.h"
+
+SchemaCatalog	g_SchemaCatalog;					// Column metadata of the application database
+
+// Columns read from the COLUMNS schema rowset
+//
+static WCHAR* s_rgpwszSchemaColumns[] =	{
+											L"COLUMN_NAME",
+											L"ORDINAL_POSITION",
+											L"DATA_TYPE",
+											L"CHARACTER_MAXIMUM_LENGTH",
+											L"NUMERIC_PRECISION",
+											L"NUMERIC_SCALE",
+											L"IS_NULLABLE"
+										};
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: FoldName
+//
+// Description: Copy a name in lower case and hash it (FNV-1a).
+//
+// Returns: FALSE if the name is longer than SCHEMA_MAX_NAME
+//
+////////////////////////////////////////////////////////////////////////////////
+static BOOL FoldName(LPCWSTR pwszName, WCHAR *pwszFolded, DWORD *pdwHash)
+{
+	DWORD dwHash = 2166136261;
+	DWORD cch;
+
+	for (cch = 0; pwszName[cch]; ++cch)
+	{
+		if (cch == SCHEMA_MAX_NAME)
+		{
+			return FALSE;
+		}
+
+		pwszFolded[cch] = towlower(pwszName[cch]);
+
+		dwHash ^= pwszFolded[cch];
+		dwHash *= 16777619;
+	}
+
+	pwszFolded[cch] = WCHAR('\0');
+	*pdwHash		= dwHash;
+
+	return TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetFixedTypeSize
+//
+// Description: Returns the size of a fixed length type, 0 if not fixed.
+//
+////////////////////////////////////////////////////////////////////////////////
+static DBLENGTH GetFixedTypeSize(DBTYPE wType)
+{
+	switch(wType)
+	{
+	case DBTYPE_I1:
+	case DBTYPE_UI1:
+		return 1;
+
+	case DBTYPE_I2:
+	case DBTYPE_UI2:
+	case DBTYPE_BOOL:
+		return 2;
+
+	case DBTYPE_I4:
+	case DBTYPE_UI4:
+	case DBTYPE_R4:
+		return 4;
+
+	case DBTYPE_I8:
+	case DBTYPE_UI8:
+	case DBTYPE_R8:
+	case DBTYPE_CY:
+		return 8;
+
+	case DBTYPE_GUID:
+		return sizeof(GUID);
+
+	case DBTYPE_DBTIMESTAMP:
+		return sizeof(DBTIMESTAMP);
+
+	case DBTYPE_NUMERIC:
+		return sizeof(DB_NUMERIC);
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetIntegerValue
+//
+// Description: Returns an integer column of a schema rowset, 0 if NULL.
+//
+////////////////////////////////////////////////////////////////////////////////
+static DWORD GetIntegerValue(BYTE *pData, DBBINDING *pBinding)
+{
+	BYTE *pValue = pData + pBinding->obValue;
+
+	if (DBSTATUS_S_OK != *(DBSTATUS*)(pData + pBinding->obStatus))
+	{
+		return 0;
+	}
+
+	switch(pBinding->wType)
+	{
+	case DBTYPE_I2:
+	case DBTYPE_UI2:
+		return *(USHORT*)pValue;
+
+	case DBTYPE_I4:
+	case DBTYPE_UI4:
+		return *(ULONG*)pValue;
+
+	case DBTYPE_I8:
+	case DBTYPE_UI8:
+		return (DWORD)*(ULONGLONG*)pValue;
+
+	case DBTYPE_BOOL:
+		return VARIANT_FALSE != *(VARIANT_BOOL*)pValue;
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: IsSchemaStatement
+//
+// Description: Returns TRUE if a SQL statement is a CREATE, ALTER or DROP.
+//
+////////////////////////////////////////////////////////////////////////////////
+BOOL IsSchemaStatement(LPCWSTR pwszQuery)
+{
+	if (NULL == pwszQuery)
+	{
+		return FALSE;
+	}
+
+	while (iswspace(*pwszQuery))
+	{
+		++pwszQuery;
+	}
+
+	return 0 == _wcsnicmp(pwszQuery, L"CREATE", 6) ||
+		   0 == _wcsnicmp(pwszQuery, L"ALTER", 5) ||
+		   0 == _wcsnicmp(pwszQuery, L"DROP", 4);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SchemaCatalog::SchemaCatalog()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+SchemaCatalog::SchemaCatalog() : m_dwVersion(1),
+								 m_cTables(0),
+								 m_cEntries(0)
+{
+	InitializeCriticalSection(&m_cs);
+	memset(m_rgwBucket, 0, sizeof(m_rgwBucket));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SchemaCatalog::~SchemaCatalog()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+SchemaCatalog::~SchemaCatalog()
+{
+	DeleteCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SchemaCatalog::Invalidate()
+//
+// Description: Drop the cached tables after a change of the schema.
+//				Handles resolved before are resolved again on their next use.
+//
+////////////////////////////////////////////////////////////////////////////////
+void SchemaCatalog::Invalidate()
+{
+	EnterCriticalSection(&m_cs);
+
+	// Version 0 marks a handle that was never resolved
+	//
+	if (0 == ++m_dwVersion)
+	{
+		m_dwVersion = 1;
+	}
+
+	m_cTables	= 0;
+	m_cEntries	= 0;
+	memset(m_rgwBucket, 0, sizeof(m_rgwBucket));
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SchemaCatalog::GetVersion()
+//
+// Description: Returns the version of the catalog.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD SchemaCatalog::GetVersion()
+{
+	DWORD dwVersion;
+
+	EnterCriticalSection(&m_cs);
+	dwVersion = m_dwVersion;
+	LeaveCriticalSection(&m_cs);
+
+	return dwVersion;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SchemaCatalog::Resolve()
+//
+// Description: Resolve column names to handles. Handles that are current
+//				are left as they are, so calling Resolve before every use
+//				costs a version check once the columns are resolved.
+//
+// Parameters
+//		pISession		- any interface on a session, used if the table
+//						  isn't cached yet
+//		pwszTable		- table of the columns
+//		rgpwszColumns	- column names
+//		cColumns		- number of columns
+//		rgColumns		- the handles, set to 0 before the first call
+//
+// Returns: NOERROR if succesfull, DB_E_NOTABLE if the table doesn't exist,
+//			DB_E_BADCOLUMNID if a column doesn't exist
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT SchemaCatalog::Resolve(IUnknown		*pISession,
+							   LPCWSTR			pwszTable,
+							   WCHAR			**rgpwszColumns,
+							   DWORD			cColumns,
+							   SCHEMA_COLUMN	*rgColumns)
+{
+	HRESULT hr		= NOERROR;
+	DWORD	iTable;
+	DWORD	iCol;
+
+	if (NULL == pwszTable || NULL == rgpwszColumns || NULL == rgColumns)
+	{
+		return E_INVALIDARG;
+	}
+
+	EnterCriticalSection(&m_cs);
+
+	for (iCol = 0; iCol < cColumns; ++iCol)
+	{
+		if (rgColumns[iCol].dwVersion != m_dwVersion)
+		{
+			break;
+		}
+	}
+
+	if (iCol == cColumns)
+	{
+		goto Exit;
+	}
+
+	hr = FindTable(pISession, pwszTable, &iTable);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	for (iCol = 0; iCol < cColumns; ++iCol)
+	{
+		if (NULL == rgpwszColumns[iCol] || !FindColumn(iTable, rgpwszColumns[iCol], &rgColumns[iCol]))
+		{
+			hr = DB_E_BADCOLUMNID;
+			goto Exit;
+		}
+	}
+
+Exit:
+	LeaveCriticalSection(&m_cs);
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SchemaCatalog::GetColumn()
+//
+// Description: Resolve one column.
+//
+// Returns: NOERROR if succesfull, DB_E_BADCOLUMNID if the column doesn't exist
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT SchemaCatalog::GetColumn(IUnknown *pISession, LPCWSTR pwszTable, LPCWSTR pwszColumn, SCHEMA_COLUMN *pColumn)
+{
+	if (NULL == pColumn)
+	{
+		return E_INVALIDARG;
+	}
+
+	pColumn->dwVersion = 0;
+
+	return Resolve(pISession, pwszTable, (WCHAR**)&pwszColumn, 1, pColumn);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SchemaCatalog::FindTable()
+//
+// Description: Find a cached table, loading it if needed.
+//				Called with the lock held.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT SchemaCatalog::FindTable(IUnknown *pISession, LPCWSTR pwszTable, DWORD *piTable)
+{
+	WCHAR	wszFolded[SCHEMA_MAX_NAME + 1];
+	DWORD	dwHash;
+
+	if (!FoldName(pwszTable, wszFolded, &dwHash))
+	{
+		return DB_E_NOTABLE;
+	}
+
+	for (DWORD iTable = 0; iTable < m_cTables; ++iTable)
+	{
+		if (0 == wcscmp(m_rgwszTable[iTable], wszFolded))
+		{
+			*piTable = iTable;
+			return NOERROR;
+		}
+	}
+
+	if (NULL == pISession)
+	{
+		return E_POINTER;
+	}
+
+	return LoadTable(pISession, pwszTable, piTable);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SchemaCatalog::FindColumn()
+//
+// Description: Look up a column of a cached table in the hash.
+//				Called with the lock held.
+//
+////////////////////////////////////////////////////////////////////////////////
+BOOL SchemaCatalog::FindColumn(DWORD iTable, LPCWSTR pwszColumn, SCHEMA_COLUMN *pColumn)
+{
+	WCHAR					wszFolded[SCHEMA_MAX_NAME + 1];
+	DWORD					dwHash;
+	DWORD					iBucket;
+	SCHEMA_CATALOG_ENTRY	*pEntry;
+
+	if (!FoldName(pwszColumn, wszFolded, &dwHash))
+	{
+		return FALSE;
+	}
+
+	dwHash ^= iTable * 2654435761;
+
+	// Linear probing up to the first empty bucket
+	//
+	for (iBucket = dwHash & (SCHEMA_CATALOG_HASH_SIZE - 1); m_rgwBucket[iBucket]; iBucket = (iBucket + 1) & (SCHEMA_CATALOG_HASH_SIZE - 1))
+	{
+		pEntry = &m_rgEntry[m_rgwBucket[iBucket] - 1];
+
+		if (pEntry->dwHash == dwHash && pEntry->iTable == iTable && 0 == wcscmp(pEntry->wszColumn, wszFolded))
+		{
+			*pColumn = pEntry->Column;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SchemaCatalog::AddColumn()
+//
+// Description: Add a column of a table being loaded to the hash.
+//				Called with the lock held.
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT SchemaCatalog::AddColumn(DWORD iTable, LPCWSTR pwszColumn, const SCHEMA_COLUMN *pColumn)
+{
+	SCHEMA_CATALOG_ENTRY	*pEntry;
+	DWORD					iBucket;
+
+	if (m_cEntries == SCHEMA_CATALOG_MAX_COLUMNS)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	pEntry = &m_rgEntry[m_cEntries];
+
+	if (!FoldName(pwszColumn, pEntry->wszColumn, &pEntry->dwHash))
+	{
+		return E_INVALIDARG;
+	}
+
+	pEntry->dwHash	^= iTable * 2654435761;
+	pEntry->iTable	 = iTable;
+	pEntry->Column	 = *pColumn;
+
+	// The table is never more than half full, so there is always an
+	// empty bucket
+	//
+	for (iBucket = pEntry->dwHash & (SCHEMA_CATALOG_HASH_SIZE - 1); m_rgwBucket[iBucket]; iBucket = (iBucket + 1) & (SCHEMA_CATALOG_HASH_SIZE - 1))
+	{
+	}
+
+	m_rgwBucket[iBucket] = (WORD)(++m_cEntries);
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SchemaCatalog::LoadTable()
+//
+// Description: Read the columns of a table from the COLUMNS schema rowset.
+//				Called with the lock held.
+//
+// Returns: NOERROR if succesfull, DB_E_NOTABLE if the table doesn't exist
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT SchemaCatalog::LoadTable(IUnknown *pISession, LPCWSTR pwszTable, DWORD *piTable)
+{
+	HRESULT			hr				= NOERROR;
+	IDBSchemaRowset	*pIDBSchema		= NULL;					// Provider Interface Pointer
+	IRowset			*pIRowset		= NULL;					// Provider Interface Pointer
+	IAccessor		*pIAccessor		= NULL;					// Provider Interface Pointer
+	HACCESSOR		hAccessor		= DB_NULL_HACCESSOR;	// Accessor handle
+	DBBINDING		*prgBinding		= NULL;					// Binding used to create accessor
+	DWORD			cBindings		= 0;
+	DWORD			cbRowSize		= 0;
+	BYTE			*pData			= NULL;					// Schema row data
+	HROW			rghRows[1];								// Row handle
+	HROW			*prghRows		= rghRows;
+	ULONG			cRowsObtained	= 0;
+	VARIANT			rgRestrictions[CRESTRICTIONS_DBSCHEMA_COLUMNS];
+	SCHEMA_COLUMN	Column;
+	DWORD			iTable			= m_cTables;
+	DWORD			cFirstEntry		= m_cEntries;
+	DWORD			dwHash;
+
+	for (DWORD iRestriction = 0; iRestriction < CRESTRICTIONS_DBSCHEMA_COLUMNS; ++iRestriction)
+	{
+		VariantInit(&rgRestrictions[iRestriction]);
+	}
+
+	if (m_cTables == SCHEMA_CATALOG_MAX_TABLES)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	if (!FoldName(pwszTable, m_rgwszTable[iTable], &dwHash))
+	{
+		hr = DB_E_NOTABLE;
+		goto Exit;
+	}
+
+	// Restrict the schema rowset to the table: TABLE_CATALOG, TABLE_SCHEMA,
+	// TABLE_NAME, COLUMN_NAME
+	//
+	rgRestrictions[2].vt		= VT_BSTR;
+	rgRestrictions[2].bstrVal	= SysAllocString(pwszTable);
+	if (NULL == rgRestrictions[2].bstrVal)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	hr = pISession->QueryInterface(IID_IDBSchemaRowset, (void**)&pIDBSchema);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIDBSchema->GetRowset(NULL,
+							   DBSCHEMA_COLUMNS,
+							   CRESTRICTIONS_DBSCHEMA_COLUMNS,
+							   rgRestrictions,
+							   IID_IRowset,
+							   0,
+							   NULL,
+							   (IUnknown**)&pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = CreateColumnBindings(pIRowset,
+							  s_rgpwszSchemaColumns,
+							  sizeof(s_rgpwszSchemaColumns)/sizeof(s_rgpwszSchemaColumns[0]),
+							  NULL,
+							  &prgBinding,
+							  &cBindings,
+							  &cbRowSize);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIRowset->QueryInterface(IID_IAccessor, (void**)&pIAccessor);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA, cBindings, prgBinding, cbRowSize, &hAccessor, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	pData = (BYTE*)CoTaskMemAlloc(cbRowSize);
+	if (NULL == pData)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	while (TRUE)
+	{
+		hr = pIRowset->GetNextRows(DB_NULL_HCHAPTER, 0, 1, &cRowsObtained, &prghRows);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		if (0 == cRowsObtained)
+		{
+			break;
+		}
+
+		memset(pData, 0, cbRowSize);
+
+		hr = pIRowset->GetData(rghRows[0], hAccessor, pData);
+
+		pIRowset->ReleaseRows(1, rghRows, NULL, NULL, NULL);
+
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		if (DBSTATUS_S_OK != *(DBSTATUS*)(pData + prgBinding[0].obStatus))
+		{
+			continue;
+		}
+
+		Column.dwVersion	= m_dwVersion;
+		Column.iOrdinal		= GetIntegerValue(pData, &prgBinding[1]);
+		Column.wType		= (DBTYPE)GetIntegerValue(pData, &prgBinding[2]);
+		Column.ulColumnSize	= GetFixedTypeSize(Column.wType);
+		Column.bPrecision	= (BYTE)GetIntegerValue(pData, &prgBinding[4]);
+		Column.bScale		= (BYTE)GetIntegerValue(pData, &prgBinding[5]);
+		Column.fNullable	= (BOOL)GetIntegerValue(pData, &prgBinding[6]);
+
+		// Strings and binaries have the size they are declared with
+		//
+		if (0 == Column.ulColumnSize)
+		{
+			Column.ulColumnSize = GetIntegerValue(pData, &prgBinding[3]);
+		}
+
+		hr = AddColumn(iTable, (WCHAR*)(pData + prgBinding[0].obValue), &Column);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+	}
+
+	// The COLUMNS rowset is empty for a table that doesn't exist
+	//
+	if (m_cEntries == cFirstEntry)
+	{
+		hr = DB_E_NOTABLE;
+		goto Exit;
+	}
+
+	++m_cTables;
+	*piTable = iTable;
+	hr		 = NOERROR;
+
+Exit:
+	// Take back the columns of a table that failed to load. They were
+	// added last, so no other entry was placed after them in a probe
+	// sequence.
+	//
+	if (FAILED(hr))
+	{
+		for (DWORD iBucket = 0; iBucket < SCHEMA_CATALOG_HASH_SIZE; ++iBucket)
+		{
+			if (m_rgwBucket[iBucket] > cFirstEntry)
+			{
+				m_rgwBucket[iBucket] = 0;
+			}
+		}
+
+		m_cEntries = cFirstEntry;
+	}
+
+	if (pData)
+	{
+		CoTaskMemFree(pData);
+	}
+
+	if (DB_NULL_HACCESSOR != hAccessor)
+	{
+		pIAccessor->ReleaseAccessor(hAccessor, NULL);
+	}
+
+	if (pIAccessor)
+	{
+		pIAccessor->Release();
+	}
+
+	FreeColumnBindings(prgBinding);
+
+	if (pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	if (pIDBSchema)
+	{
+		pIDBSchema->Release();
+	}
+
+	VariantClear(&rgRestrictions[2]);
+
+	return hr;
+}
@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: SchemaCatalog
+//
+// File: SchemaCatalog.h
+//
+// Comment: Process-wide cache of the column metadata of the database.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_SCHEMACATALOG_H__C41F7A26_0E95_4B3D_86A2_5D9B1E0F37C8__INCLUDED_)
+#define AFX_SCHEMACATALOG_H__C41F7A26_0E95_4B3D_86A2_5D9B1E0F37C8__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define SCHEMA_MAX_NAME					128
+#define SCHEMA_CATALOG_MAX_TABLES		16
+#define SCHEMA_CATALOG_MAX_COLUMNS		256
+#define SCHEMA_CATALOG_HASH_SIZE		512			// Power of 2, twice the columns at least
+
+////////////////////////////////////////////////////////////////////////////////
+// A column resolved by name. The fields have the meaning of the DBCOLUMNINFO
+// fields of the same name. The handle stays valid until the catalog version
+// changes.
+//
+typedef struct tagSCHEMA_COLUMN
+{
+	DWORD		dwVersion;						// Catalog version it was resolved in, 0 if never
+	DBORDINAL	iOrdinal;
+	DBTYPE		wType;
+	DBLENGTH	ulColumnSize;					// Characters for strings, bytes otherwise
+	BYTE		bPrecision;
+	BYTE		bScale;
+	BOOL		fNullable;
+} SCHEMA_COLUMN;
+
+////////////////////////////////////////////////////////////////////////////////
+// A column of a cached table
+//
+typedef struct tagSCHEMA_CATALOG_ENTRY
+{
+	DWORD			iTable;
+	DWORD			dwHash;
+	WCHAR			wszColumn[SCHEMA_MAX_NAME + 1];		// Case folded
+	SCHEMA_COLUMN	Column;
+} SCHEMA_CATALOG_ENTRY;
+
+////////////////////////////////////////////////////////////////////////////////
+// Column metadata of the tables of the database, read once per table
+// through IDBSchemaRowset and looked up through a hash of the case folded
+// names. Any DDL statement changes the version of the catalog: the cached
+// tables are dropped, and column handles resolved before are resolved
+// again on their next use.
+//
+class SchemaCatalog
+{
+public:
+	SchemaCatalog();
+	~SchemaCatalog();
+
+	HRESULT Resolve(IUnknown		*pISession,
+					LPCWSTR			pwszTable,
+					WCHAR			**rgpwszColumns,
+					DWORD			cColumns,
+					SCHEMA_COLUMN	*rgColumns);
+	HRESULT GetColumn(IUnknown *pISession, LPCWSTR pwszTable, LPCWSTR pwszColumn, SCHEMA_COLUMN *pColumn);
+
+	void	Invalidate();
+	DWORD	GetVersion();
+
+private:
+	HRESULT LoadTable(IUnknown *pISession, LPCWSTR pwszTable, DWORD *piTable);
+	HRESULT FindTable(IUnknown *pISession, LPCWSTR pwszTable, DWORD *piTable);
+	BOOL	FindColumn(DWORD iTable, LPCWSTR pwszColumn, SCHEMA_COLUMN *pColumn);
+	HRESULT AddColumn(DWORD iTable, LPCWSTR pwszColumn, const SCHEMA_COLUMN *pColumn);
+
+	CRITICAL_SECTION		m_cs;
+	DWORD					m_dwVersion;
+	WCHAR					m_rgwszTable[SCHEMA_CATALOG_MAX_TABLES][SCHEMA_MAX_NAME + 1];	// Case folded
+	DWORD					m_cTables;
+	SCHEMA_CATALOG_ENTRY	m_rgEntry[SCHEMA_CATALOG_MAX_COLUMNS];
+	DWORD					m_cEntries;
+	WORD					m_rgwBucket[SCHEMA_CATALOG_HASH_SIZE];	// Entry index + 1, 0 if empty
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns TRUE if a SQL statement changes the schema
+//
+BOOL IsSchemaStatement(LPCWSTR pwszQuery);
+
+extern SchemaCatalog	g_SchemaCatalog;
+
+#endif // !defined(AFX_SCHEMACATALOG_H__C41F7A26_0E95_4B3D_86A2_5D9B1E0F37C8__INCLUDED_)
@@ -0,0 +1,807 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: SessionPool
+//
+// File: SessionPool.cpp
+//
+// Comment: Bounded pool of open sessions shared by worker threads.
+//
+// Functions:
+//			1. Check sessions out and in, waiting when the pool is exhausted
+//			2. Grow the pool on demand and close sessions that stay idle
+//			3. Cache rowsets and accessors with each session
+//			4. Report wait times, utilization and statements per session
+//
+// Notes:
+//			A checkout takes the idle session used last, so that its cached
+//			rowsets are warm and the sessions used least are the ones that
+//			reach the idle timeout and are closed.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "SessionPool.h"
+
+SessionPool	g_SessionPool;							// Sessions of the worker threads on the application database
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SessionPool::SessionPool()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+SessionPool::SessionPool() : m_hAvailable(NULL),
+							 m_fStarted(FALSE),
+							 m_dwStartMs(0),
+							 m_dwLastChangeMs(0),
+							 m_ullInUseMs(0)
+{
+	InitializeCriticalSection(&m_cs);
+
+	memset(&m_Settings, 0, sizeof(m_Settings));
+	memset(m_rgSession, 0, sizeof(m_rgSession));
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SessionPool::~SessionPool()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+SessionPool::~SessionPool()
+{
+	Stop();
+
+	if (m_hAvailable)
+	{
+		CloseHandle(m_hAvailable);
+	}
+
+	DeleteCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SessionPool::Start()
+//
+// Description: Open the minimum number of sessions.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT SessionPool::Start(const SESSION_POOL_SETTINGS *pSettings)
+{
+	HRESULT hr = NOERROR;
+
+	if (NULL == pSettings || NULL == pSettings->pIDBCreateSession ||
+		0 == pSettings->cMaxSessions || pSettings->cMaxSessions > SESSION_POOL_MAX_SESSIONS ||
+		pSettings->cMinSessions > pSettings->cMaxSessions)
+	{
+		return E_INVALIDARG;
+	}
+
+	if (m_fStarted)
+	{
+		return E_UNEXPECTED;
+	}
+
+	if (NULL == m_hAvailable)
+	{
+		m_hAvailable = CreateEvent(NULL, TRUE, FALSE, NULL);
+		if (NULL == m_hAvailable)
+		{
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+	}
+
+	m_Settings = *pSettings;
+	m_Settings.pIDBCreateSession->AddRef();
+
+	memset(m_rgSession, 0, sizeof(m_rgSession));
+	memset(&m_Stats, 0, sizeof(m_Stats));
+
+	m_dwStartMs			= GetTickCount();
+	m_dwLastChangeMs	= m_dwStartMs;
+	m_ullInUseMs		= 0;
+	m_fStarted			= TRUE;
+
+	for (DWORD iSession = 0; iSession < m_Settings.cMinSessions; ++iSession)
+	{
+		hr = OpenSession(&m_rgSession[iSession]);
+		if(FAILED(hr))
+		{
+			Stop();
+			break;
+		}
+
+		m_rgSession[iSession].dwLastUsedMs = m_dwStartMs;
+
+		++m_Stats.cSessions;
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SessionPool::Stop()
+//
+// Description: Close the idle sessions and fail waiting checkouts.
+//				Sessions still checked out are closed when checked in.
+//
+////////////////////////////////////////////////////////////////////////////////
+void SessionPool::Stop()
+{
+	EnterCriticalSection(&m_cs);
+
+	if (m_fStarted)
+	{
+		m_fStarted = FALSE;
+
+		for (DWORD iSession = 0; iSession < SESSION_POOL_MAX_SESSIONS; ++iSession)
+		{
+			if (m_rgSession[iSession].pISession && !m_rgSession[iSession].fInUse)
+			{
+				CloseSession(&m_rgSession[iSession]);
+			}
+		}
+
+		m_Settings.pIDBCreateSession->Release();
+		m_Settings.pIDBCreateSession = NULL;
+
+		SetEvent(m_hAvailable);
+	}
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SessionPool::CheckOut()
+//
+// Description: Take a session from the pool, opening one if none is idle
+//				and the pool is below its maximum.
+//
+// Parameters
+//		dwTimeoutMs	- longest wait for a session, or INFINITE
+//		ppSession	- receives the session
+//
+// Returns: NOERROR if succesfull, HRESULT_FROM_WIN32(ERROR_TIMEOUT) if no
+//			session was returned in time
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT SessionPool::CheckOut(DWORD dwTimeoutMs, POOLED_SESSION **ppSession)
+{
+	HRESULT			hr			= NOERROR;
+	POOLED_SESSION	*pSession	= NULL;
+	DWORD			dwStartMs	= GetTickCount();
+	DWORD			dwWaitMs	= 0;
+	BOOL			fWaited		= FALSE;
+	BOOL			fOpen		= FALSE;
+	DWORD			iSession;
+
+	if (NULL == ppSession)
+	{
+		return E_INVALIDARG;
+	}
+
+	*ppSession = NULL;
+
+	EnterCriticalSection(&m_cs);
+
+	while (TRUE)
+	{
+		if (!m_fStarted)
+		{
+			hr = E_UNEXPECTED;
+			break;
+		}
+
+		TrimIdleSessions();
+
+		// The idle session used last
+		//
+		for (iSession = 0; iSession < SESSION_POOL_MAX_SESSIONS; ++iSession)
+		{
+			if (m_rgSession[iSession].pISession && !m_rgSession[iSession].fInUse &&
+				(NULL == pSession || m_rgSession[iSession].dwLastUsedMs - pSession->dwLastUsedMs < 0x80000000))
+			{
+				pSession = &m_rgSession[iSession];
+			}
+		}
+
+		// Grow: reserve a free slot and open the session outside the lock
+		//
+		if (NULL == pSession && m_Stats.cSessions < m_Settings.cMaxSessions)
+		{
+			for (iSession = 0; iSession < SESSION_POOL_MAX_SESSIONS; ++iSession)
+			{
+				if (NULL == m_rgSession[iSession].pISession && !m_rgSession[iSession].fInUse)
+				{
+					pSession = &m_rgSession[iSession];
+					fOpen	 = TRUE;
+
+					++m_Stats.cSessions;
+					break;
+				}
+			}
+		}
+
+		if (pSession)
+		{
+			NoteInUseChange();
+
+			pSession->fInUse = TRUE;
+
+			if (++m_Stats.cInUse > m_Stats.cPeakInUse)
+			{
+				m_Stats.cPeakInUse = m_Stats.cInUse;
+			}
+
+			++m_Stats.cCheckouts;
+			break;
+		}
+
+		// Exhausted, wait for a check in
+		//
+		if (!fWaited)
+		{
+			++m_Stats.cWaits;
+			fWaited = TRUE;
+		}
+
+		dwWaitMs = GetTickCount() - dwStartMs;
+		if (INFINITE != dwTimeoutMs && dwWaitMs >= dwTimeoutMs)
+		{
+			++m_Stats.cTimeouts;
+			hr = HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+			break;
+		}
+
+		ResetEvent(m_hAvailable);
+
+		LeaveCriticalSection(&m_cs);
+		WaitForSingleObject(m_hAvailable, INFINITE == dwTimeoutMs ? INFINITE : dwTimeoutMs - dwWaitMs);
+		EnterCriticalSection(&m_cs);
+	}
+
+	if (fWaited)
+	{
+		dwWaitMs = GetTickCount() - dwStartMs;
+
+		m_Stats.dwTotalWaitMs += dwWaitMs;
+		if (dwWaitMs > m_Stats.dwMaxWaitMs)
+		{
+			m_Stats.dwMaxWaitMs = dwWaitMs;
+		}
+	}
+
+	LeaveCriticalSection(&m_cs);
+
+	if (fOpen)
+	{
+		hr = OpenSession(pSession);
+
+		EnterCriticalSection(&m_cs);
+
+		if(FAILED(hr))
+		{
+			NoteInUseChange();
+
+			pSession->fInUse = FALSE;
+			--m_Stats.cInUse;
+			--m_Stats.cSessions;
+
+			SetEvent(m_hAvailable);
+		}
+		else
+		{
+			++m_Stats.cOpened;
+		}
+
+		LeaveCriticalSection(&m_cs);
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		*ppSession = pSession;
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SessionPool::CheckIn()
+//
+// Description: Return a session to the pool.
+//
+// Parameters
+//		pSession	- session returned by CheckOut
+//		fDiscard	- close the session rather than keep it, after an error
+//					  that may have left it unusable
+//
+////////////////////////////////////////////////////////////////////////////////
+void SessionPool::CheckIn(POOLED_SESSION *pSession, BOOL fDiscard)
+{
+	if (NULL == pSession || pSession < m_rgSession || pSession >= m_rgSession + SESSION_POOL_MAX_SESSIONS)
+	{
+		return;
+	}
+
+	EnterCriticalSection(&m_cs);
+
+	NoteInUseChange();
+
+	pSession->fInUse		= FALSE;
+	pSession->dwLastUsedMs	= GetTickCount();
+	--m_Stats.cInUse;
+
+	if (fDiscard || !m_fStarted)
+	{
+		CloseSession(pSession);
+	}
+
+	if (m_fStarted)
+	{
+		TrimIdleSessions();
+	}
+
+	SetEvent(m_hAvailable);
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SessionPool::GetRowset()
+//
+// Description: Returns a rowset of the session, opening it on first use.
+//				A cached rowset is positioned before its first row.
+//
+// Parameters
+//		pwszTable	- table to open
+//		pwszIndex	- index to open it through, NULL for the base table
+//		dwOptions	- ROWSET_OPT_ flags
+//		ppRowset	- receives the rowset, owned by the session
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT SessionPool::GetRowset(POOLED_SESSION	*pSession,
+							   LPCWSTR			pwszTable,
+							   LPCWSTR			pwszIndex,
+							   DWORD			dwOptions,
+							   POOLED_ROWSET	**ppRowset)
+{
+	HRESULT			hr		= NOERROR;
+	POOLED_ROWSET	*pRowset;
+	DWORD			iRowset;
+
+	if (NULL == pSession || NULL == pSession->pISession || NULL == pwszTable || NULL == ppRowset ||
+		wcslen(pwszTable) >= SESSION_POOL_MAX_NAME ||
+		(pwszIndex && wcslen(pwszIndex) >= SESSION_POOL_MAX_NAME))
+	{
+		return E_INVALIDARG;
+	}
+
+	*ppRowset = NULL;
+
+	if (NULL == pwszIndex)
+	{
+		pwszIndex = L"";
+	}
+
+	for (iRowset = 0; iRowset < pSession->cRowsets; ++iRowset)
+	{
+		pRowset = &pSession->rgRowset[iRowset];
+
+		if (dwOptions == pRowset->dwOptions &&
+			0 == wcscmp(pwszTable, pRowset->wszTable) &&
+			0 == wcscmp(pwszIndex, pRowset->wszIndex))
+		{
+			hr = pRowset->pIRowset->RestartPosition(DB_NULL_HCHAPTER);
+			if (SUCCEEDED(hr))
+			{
+				*ppRowset = pRowset;
+				hr = NOERROR;
+			}
+
+			return hr;
+		}
+	}
+
+	// Replace the oldest rowset when the cache is full
+	//
+	if (pSession->cRowsets < SESSION_POOL_MAX_ROWSETS)
+	{
+		pRowset = &pSession->rgRowset[pSession->cRowsets++];
+	}
+	else
+	{
+		pRowset = &pSession->rgRowset[pSession->iNextRowset];
+		pSession->iNextRowset = (pSession->iNextRowset + 1) % SESSION_POOL_MAX_ROWSETS;
+
+		CloseRowset(pRowset);
+	}
+
+	wcscpy(pRowset->wszTable, pwszTable);
+	wcscpy(pRowset->wszIndex, pwszIndex);
+	pRowset->dwOptions = dwOptions;
+
+	++pSession->cStatements;
+
+	hr = OpenTableRowset(pSession->pISession,
+						 pwszTable,
+						 *pwszIndex ? pwszIndex : NULL,
+						 dwOptions,
+						 IID_IRowset,
+						 (IUnknown**)&pRowset->pIRowset);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pRowset->pIRowset->QueryInterface(IID_IAccessor, (void**)&pRowset->pIAccessor);
+
+Exit:
+	if(FAILED(hr))
+	{
+		// Drop the slot; a failed rowset is never cached
+		//
+		CloseRowset(pRowset);
+
+		*pRowset = pSession->rgRowset[--pSession->cRowsets];
+		memset(&pSession->rgRowset[pSession->cRowsets], 0, sizeof(POOLED_ROWSET));
+
+		if (pSession->iNextRowset >= pSession->cRowsets)
+		{
+			pSession->iNextRowset = 0;
+		}
+	}
+	else
+	{
+		*ppRowset = pRowset;
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SameBindings
+//
+// Description: Compare the bindings of a cached accessor with those
+//				asked for. Objects compare by their flags and interface.
+//
+////////////////////////////////////////////////////////////////////////////////
+static BOOL SameBindings(const DBBINDING *rgCached, const DBBINDING *rgBinding, DWORD cBindings)
+{
+	for (DWORD iBinding = 0; iBinding < cBindings; ++iBinding)
+	{
+		const DBBINDING *pCached	= &rgCached[iBinding];
+		const DBBINDING *pBinding	= &rgBinding[iBinding];
+
+		if (pCached->iOrdinal	!= pBinding->iOrdinal	||
+			pCached->obValue	!= pBinding->obValue	||
+			pCached->obLength	!= pBinding->obLength	||
+			pCached->obStatus	!= pBinding->obStatus	||
+			pCached->cbMaxLen	!= pBinding->cbMaxLen	||
+			pCached->dwPart		!= pBinding->dwPart		||
+			pCached->dwMemOwner	!= pBinding->dwMemOwner	||
+			pCached->eParamIO	!= pBinding->eParamIO	||
+			pCached->dwFlags	!= pBinding->dwFlags	||
+			pCached->wType		!= pBinding->wType		||
+			pCached->bPrecision	!= pBinding->bPrecision	||
+			pCached->bScale		!= pBinding->bScale)
+		{
+			return FALSE;
+		}
+
+		if ((NULL == pCached->pObject) != (NULL == pBinding->pObject))
+		{
+			return FALSE;
+		}
+
+		if (pCached->pObject &&
+			(pCached->pObject->dwFlags != pBinding->pObject->dwFlags ||
+			 !IsEqualIID(pCached->pObject->iid, pBinding->pObject->iid)))
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SessionPool::GetAccessor()
+//
+// Description: Returns an accessor of a rowset from GetRowset, creating it
+//				on first use. The accessor is owned by the rowset and stays
+//				valid until the session is checked in or the rowset asks
+//				for more accessors than it caches.
+//
+// Parameters
+//		pRowset		- rowset returned by GetRowset
+//		cBindings	- number of bindings
+//		rgBinding	- bindings of the accessor
+//		phAccessor	- receives the accessor
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT SessionPool::GetAccessor(POOLED_ROWSET		*pRowset,
+								 DWORD				cBindings,
+								 const DBBINDING	*rgBinding,
+								 HACCESSOR			*phAccessor)
+{
+	HRESULT			hr			= NOERROR;
+	POOLED_ACCESSOR	*pAccessor;
+	DBOBJECT		*rgObject;
+	DWORD			iAccessor;
+	DWORD			iBinding;
+
+	if (NULL == pRowset || NULL == pRowset->pIAccessor || 0 == cBindings || NULL == rgBinding || NULL == phAccessor)
+	{
+		return E_INVALIDARG;
+	}
+
+	*phAccessor = DB_NULL_HACCESSOR;
+
+	for (iAccessor = 0; iAccessor < pRowset->cAccessors; ++iAccessor)
+	{
+		pAccessor = &pRowset->rgAccessor[iAccessor];
+
+		if (cBindings == pAccessor->cBindings && SameBindings(pAccessor->prgBinding, rgBinding, cBindings))
+		{
+			*phAccessor = pAccessor->hAccessor;
+			return NOERROR;
+		}
+	}
+
+	// Replace the oldest accessor when the cache is full
+	//
+	if (pRowset->cAccessors < SESSION_POOL_MAX_ACCESSORS)
+	{
+		pAccessor = &pRowset->rgAccessor[pRowset->cAccessors];
+	}
+	else
+	{
+		pAccessor = &pRowset->rgAccessor[pRowset->iNextAccessor];
+		pRowset->iNextAccessor = (pRowset->iNextAccessor + 1) % SESSION_POOL_MAX_ACCESSORS;
+
+		pRowset->pIAccessor->ReleaseAccessor(pAccessor->hAccessor, NULL);
+		CoTaskMemFree(pAccessor->prgBinding);
+		memset(pAccessor, 0, sizeof(POOLED_ACCESSOR));
+
+		--pRowset->cAccessors;
+	}
+
+	// Keep a copy of the bindings to compare the next callers with
+	//
+	pAccessor->prgBinding = (DBBINDING*)CoTaskMemAlloc(cBindings * (sizeof(DBBINDING) + sizeof(DBOBJECT)));
+	if (NULL == pAccessor->prgBinding)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	rgObject = (DBOBJECT*)(pAccessor->prgBinding + cBindings);
+
+	memcpy(pAccessor->prgBinding, rgBinding, cBindings * sizeof(DBBINDING));
+
+	for (iBinding = 0; iBinding < cBindings; ++iBinding)
+	{
+		if (rgBinding[iBinding].pObject)
+		{
+			rgObject[iBinding] = *rgBinding[iBinding].pObject;
+			pAccessor->prgBinding[iBinding].pObject = &rgObject[iBinding];
+		}
+	}
+
+	hr = pRowset->pIAccessor->CreateAccessor(DBACCESSOR_ROWDATA,
+											 cBindings,
+											 rgBinding,
+											 0,
+											 &pAccessor->hAccessor,
+											 NULL);
+
+Exit:
+	if(FAILED(hr))
+	{
+		// Drop the slot; a failed accessor is never cached
+		//
+		CoTaskMemFree(pAccessor->prgBinding);
+
+		*pAccessor = pRowset->rgAccessor[pRowset->cAccessors];
+		memset(&pRowset->rgAccessor[pRowset->cAccessors], 0, sizeof(POOLED_ACCESSOR));
+
+		if (pRowset->iNextAccessor >= pRowset->cAccessors)
+		{
+			pRowset->iNextAccessor = 0;
+		}
+	}
+	else
+	{
+		pAccessor->cBindings = cBindings;
+		++pRowset->cAccessors;
+
+		*phAccessor = pAccessor->hAccessor;
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SessionPool::GetStats()
+//
+// Description: Returns the pool statistics.
+//
+////////////////////////////////////////////////////////////////////////////////
+void SessionPool::GetStats(SESSION_POOL_STATS *pStats)
+{
+	DWORD dwElapsedMs;
+
+	if (NULL == pStats)
+	{
+		return;
+	}
+
+	EnterCriticalSection(&m_cs);
+
+	NoteInUseChange();
+
+	*pStats = m_Stats;
+
+	dwElapsedMs = m_dwLastChangeMs - m_dwStartMs;
+	if (dwElapsedMs && m_Settings.cMaxSessions)
+	{
+		pStats->dwUtilization = (DWORD)(m_ullInUseMs * 100 / ((ULONGLONG)dwElapsedMs * m_Settings.cMaxSessions));
+	}
+
+	for (DWORD iSession = 0; iSession < SESSION_POOL_MAX_SESSIONS; ++iSession)
+	{
+		pStats->rgcStatements[iSession] = m_rgSession[iSession].cStatements;
+	}
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SessionPool::OpenSession()
+//
+// Description: Create the session of a slot. Called without the lock, a
+//				growing CheckOut can race with Stop.
+//
+// Returns: NOERROR if succesfull, E_UNEXPECTED if the pool was stopped
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT SessionPool::OpenSession(POOLED_SESSION *pSession)
+{
+	HRESULT				hr;
+	IDBCreateSession	*pIDBCreateSession;
+
+	pSession->cRowsets		= 0;
+	pSession->iNextRowset	= 0;
+	pSession->cStatements	= 0;
+
+	// Stop releases the data source under the lock
+	//
+	EnterCriticalSection(&m_cs);
+
+	pIDBCreateSession = m_Settings.pIDBCreateSession;
+	if (pIDBCreateSession)
+	{
+		pIDBCreateSession->AddRef();
+	}
+
+	LeaveCriticalSection(&m_cs);
+
+	if (NULL == pIDBCreateSession)
+	{
+		return E_UNEXPECTED;
+	}
+
+	hr = pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pSession->pISession);
+
+	pIDBCreateSession->Release();
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SessionPool::CloseSession()
+//
+// Description: Close the session of a slot and its cached rowsets.
+//				Called with the lock held.
+//
+////////////////////////////////////////////////////////////////////////////////
+void SessionPool::CloseSession(POOLED_SESSION *pSession)
+{
+	for (DWORD iRowset = 0; iRowset < pSession->cRowsets; ++iRowset)
+	{
+		CloseRowset(&pSession->rgRowset[iRowset]);
+	}
+
+	if (pSession->pISession)
+	{
+		pSession->pISession->Release();
+
+		--m_Stats.cSessions;
+		++m_Stats.cClosed;
+	}
+
+	memset(pSession, 0, sizeof(POOLED_SESSION));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SessionPool::CloseRowset()
+//
+// Description: Release a cached rowset and its accessors.
+//
+////////////////////////////////////////////////////////////////////////////////
+void SessionPool::CloseRowset(POOLED_ROWSET *pRowset)
+{
+	for (DWORD iAccessor = 0; iAccessor < pRowset->cAccessors; ++iAccessor)
+	{
+		pRowset->pIAccessor->ReleaseAccessor(pRowset->rgAccessor[iAccessor].hAccessor, NULL);
+		CoTaskMemFree(pRowset->rgAccessor[iAccessor].prgBinding);
+	}
+
+	if (pRowset->pIAccessor)
+	{
+		pRowset->pIAccessor->Release();
+	}
+
+	if (pRowset->pIRowset)
+	{
+		pRowset->pIRowset->Release();
+	}
+
+	memset(pRowset, 0, sizeof(POOLED_ROWSET));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SessionPool::TrimIdleSessions()
+//
+// Description: Shrink: close sessions idle for longer than the timeout,
+//				keeping the minimum. Called with the lock held.
+//
+////////////////////////////////////////////////////////////////////////////////
+void SessionPool::TrimIdleSessions()
+{
+	DWORD dwNowMs = GetTickCount();
+
+	for (DWORD iSession = 0; iSession < SESSION_POOL_MAX_SESSIONS; ++iSession)
+	{
+		if (m_Stats.cSessions <= m_Settings.cMinSessions)
+		{
+			break;
+		}
+
+		if (m_rgSession[iSession].pISession && !m_rgSession[iSession].fInUse &&
+			dwNowMs - m_rgSession[iSession].dwLastUsedMs >= m_Settings.dwIdleTimeoutMs)
+		{
+			CloseSession(&m_rgSession[iSession]);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SessionPool::NoteInUseChange()
+//
+// Description: Add the sessions in use since the last change to the
+//				utilization. Called with the lock held, before cInUse changes.
+//
+////////////////////////////////////////////////////////////////////////////////
+void SessionPool::NoteInUseChange()
+{
+	DWORD dwNowMs = GetTickCount();
+
+	m_ullInUseMs	   += (ULONGLONG)m_Stats.cInUse * (dwNowMs - m_dwLastChangeMs);
+	m_dwLastChangeMs	= dwNowMs;
+}
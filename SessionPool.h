@@ -0,0 +1,153 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: SessionPool
+//
+// File: SessionPool.h
+//
+// Comment: Bounded pool of open sessions shared by worker threads.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_SESSIONPOOL_H__51C8E0A4_2D7F_4B96_A3E5_0F6B9C17D82E__INCLUDED_)
+#define AFX_SESSIONPOOL_H__51C8E0A4_2D7F_4B96_A3E5_0F6B9C17D82E__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define SESSION_POOL_MAX_SESSIONS	16
+#define SESSION_POOL_MAX_ROWSETS	4				// Rowsets cached by a session
+#define SESSION_POOL_MAX_NAME		64				// Table and index names of a cached rowset
+#define SESSION_POOL_MAX_ACCESSORS	4				// Accessors cached by a rowset
+
+////////////////////////////////////////////////////////////////////////////////
+// Pool settings
+//
+// Sessions are opened when a checkout finds none idle, up to cMaxSessions.
+// Idle sessions above cMinSessions are closed after dwIdleTimeoutMs.
+//
+typedef struct tagSESSION_POOL_SETTINGS
+{
+	IDBCreateSession	*pIDBCreateSession;
+	DWORD				cMinSessions;			// Opened by Start and always kept
+	DWORD				cMaxSessions;			// At most SESSION_POOL_MAX_SESSIONS
+	DWORD				dwIdleTimeoutMs;
+} SESSION_POOL_SETTINGS;
+
+////////////////////////////////////////////////////////////////////////////////
+// An accessor cached by a rowset, with a copy of the bindings it was
+// created from
+//
+typedef struct tagPOOLED_ACCESSOR
+{
+	HACCESSOR	hAccessor;
+	DBBINDING	*prgBinding;						// Followed by the DBOBJECT of each binding
+	DWORD		cBindings;
+} POOLED_ACCESSOR;
+
+////////////////////////////////////////////////////////////////////////////////
+// A rowset cached by a pooled session, with the accessors created on it
+//
+typedef struct tagPOOLED_ROWSET
+{
+	WCHAR			wszTable[SESSION_POOL_MAX_NAME];
+	WCHAR			wszIndex[SESSION_POOL_MAX_NAME];	// Empty for the base table
+	DWORD			dwOptions;							// ROWSET_OPT_ flags
+	IRowset			*pIRowset;
+	IAccessor		*pIAccessor;
+	POOLED_ACCESSOR	rgAccessor[SESSION_POOL_MAX_ACCESSORS];
+	DWORD			cAccessors;
+	DWORD			iNextAccessor;						// Replaced when the cache is full
+} POOLED_ROWSET;
+
+////////////////////////////////////////////////////////////////////////////////
+// A pooled session. Owned by one thread between CheckOut and CheckIn.
+//
+typedef struct tagPOOLED_SESSION
+{
+	IOpenRowset		*pISession;
+	POOLED_ROWSET	rgRowset[SESSION_POOL_MAX_ROWSETS];
+	DWORD			cRowsets;
+	DWORD			iNextRowset;					// Replaced when the cache is full
+	DWORD			cStatements;					// Statements and rowsets opened
+	DWORD			dwLastUsedMs;
+	BOOL			fInUse;
+} POOLED_SESSION;
+
+////////////////////////////////////////////////////////////////////////////////
+// Pool statistics
+//
+typedef struct tagSESSION_POOL_STATS
+{
+	DWORD		cSessions;
+	DWORD		cInUse;
+	DWORD		cPeakInUse;
+	DWORD		cCheckouts;
+	DWORD		cWaits;								// Checkouts that found the pool exhausted
+	DWORD		cTimeouts;
+	DWORD		dwTotalWaitMs;
+	DWORD		dwMaxWaitMs;
+	DWORD		cOpened;							// Sessions opened to grow the pool
+	DWORD		cClosed;							// Idle or discarded sessions closed
+	DWORD		dwUtilization;						// Percent of cMaxSessions in use, over time
+	DWORD		rgcStatements[SESSION_POOL_MAX_SESSIONS];
+} SESSION_POOL_STATS;
+
+////////////////////////////////////////////////////////////////////////////////
+// Hands out open sessions to worker threads. A thread checks a session out,
+// runs its statements through it and checks it in again. Rowsets opened
+// through GetRowset, and accessors created through GetAccessor, stay open
+// for the next user of the session. Stop is called once the worker threads
+// are done.
+//
+class SessionPool
+{
+public:
+	SessionPool();
+	~SessionPool();
+
+	HRESULT Start(const SESSION_POOL_SETTINGS *pSettings);
+	void	Stop();
+
+	HRESULT CheckOut(DWORD dwTimeoutMs, POOLED_SESSION **ppSession);
+	void	CheckIn(POOLED_SESSION *pSession, BOOL fDiscard);
+
+	HRESULT GetRowset(POOLED_SESSION	*pSession,
+					  LPCWSTR			pwszTable,
+					  LPCWSTR			pwszIndex,
+					  DWORD				dwOptions,
+					  POOLED_ROWSET		**ppRowset);
+	HRESULT GetAccessor(POOLED_ROWSET	*pRowset,
+						DWORD			cBindings,
+						const DBBINDING	*rgBinding,
+						HACCESSOR		*phAccessor);
+
+	void	GetStats(SESSION_POOL_STATS *pStats);
+
+private:
+	HRESULT OpenSession(POOLED_SESSION *pSession);
+	void	CloseSession(POOLED_SESSION *pSession);
+	void	CloseRowset(POOLED_ROWSET *pRowset);
+	void	TrimIdleSessions();
+	void	NoteInUseChange();
+
+	CRITICAL_SECTION		m_cs;					// Guards the slots and the statistics
+	SESSION_POOL_SETTINGS	m_Settings;
+	POOLED_SESSION			m_rgSession[SESSION_POOL_MAX_SESSIONS];
+	HANDLE					m_hAvailable;			// Set when a session is checked in or closed
+	BOOL					m_fStarted;
+
+	DWORD					m_dwStartMs;
+	DWORD					m_dwLastChangeMs;
+	ULONGLONG				m_ullInUseMs;			// Sessions in use, integrated over time
+	SESSION_POOL_STATS		m_Stats;
+};
+
+extern SessionPool	g_SessionPool;
+
+#endif // !defined(AFX_SESSIONPOOL_H__51C8E0A4_2D7F_4B96_A3E5_0F6B9C17D82E__INCLUDED_)
@@ -0,0 +1,556 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: StartupLoader
+//
+// File: StartupLoader.cpp
+//
+// Comment: Staged startup. The database is opened and the employee names
+//			loaded on a background thread while the window is shown.
+//
+// Functions:
+//			1. Open the database on a background thread
+//			2. Stream the employee names to the dialog in pages
+//			3. Time each startup stage
+//
+// Notes:
+//			Time to first paint no longer includes opening the database,
+//			reading every employee name and decoding a photo. The dialog
+//			selects the first employee when the first page of names
+//			arrives, and the remaining pages are appended as they are read.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "TemplateDatabase.h"
+#include "EmployeeSchema.h"
+#include "SessionPool.h"
+#include "EmployeeStore.h"
+#include "StartupLoader.h"
+
+StartupLoader	g_StartupLoader;				// Startup of the employees dialog
+
+////////////////////////////////////////////////////////////////////////////////
+// Page being filled by a scan of the names
+//
+typedef struct tagSTARTUP_NAME_SCAN
+{
+	StartupLoader		*pLoader;
+	STARTUP_NAME_PAGE	*pPage;
+	DWORD				cPageNames;				// Names that fill pPage
+	HRESULT				hr;						// Reason the scan was ended
+} STARTUP_NAME_SCAN;
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StartupLoader::StartupLoader()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+StartupLoader::StartupLoader() : m_hWndNotify(NULL),
+								 m_ppIDBCreateSession(NULL),
+								 m_pcsDataSource(NULL),
+								 m_hThread(NULL),
+								 m_hStop(NULL),
+								 m_dwStartMs(0)
+{
+	InitializeCriticalSection(&m_cs);
+
+	m_wszDatabase[0] = 0;
+	Begin();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StartupLoader::~StartupLoader()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+StartupLoader::~StartupLoader()
+{
+	Stop();
+	DeleteCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StartupLoader::Begin()
+//
+// Description: Start timing the startup stages.
+//
+////////////////////////////////////////////////////////////////////////////////
+void StartupLoader::Begin()
+{
+	EnterCriticalSection(&m_cs);
+
+	m_dwStartMs = GetTickCount();
+
+	for (DWORD dwStage = 0; dwStage < STARTUP_STAGE_COUNT; ++dwStage)
+	{
+		m_Times.rgdwStageMs[dwStage] = STARTUP_STAGE_PENDING;
+	}
+
+	m_Times.cNames	= 0;
+	m_Times.hr		= NOERROR;
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StartupLoader::Start()
+//
+// Description: Start loading the employee names on a background thread.
+//
+// Parameters
+//		hWndNotify			- dialog that receives WM_STARTUP_NAMES and WM_STARTUP_DONE
+//		pwszDatabase		- the database
+//		ppIDBCreateSession	- the owner's data source. If it is NULL the
+//							  database is opened by the loader and returned here.
+//		pcsDataSource		- held by the owner while it reads *ppIDBCreateSession
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT StartupLoader::Start(HWND				hWndNotify,
+							 LPCWSTR			pwszDatabase,
+							 IDBCreateSession	**ppIDBCreateSession,
+							 CRITICAL_SECTION	*pcsDataSource)
+{
+	HRESULT hr = NOERROR;
+
+	if (NULL == hWndNotify || NULL == pwszDatabase || NULL == ppIDBCreateSession ||
+		NULL == pcsDataSource || wcslen(pwszDatabase) >= MAX_PATH)
+	{
+		return E_INVALIDARG;
+	}
+
+	if (m_hThread)
+	{
+		return E_UNEXPECTED;
+	}
+
+	wcscpy(m_wszDatabase, pwszDatabase);
+
+	m_hWndNotify			= hWndNotify;
+	m_ppIDBCreateSession	= ppIDBCreateSession;
+	m_pcsDataSource			= pcsDataSource;
+
+	m_hStop = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (NULL == m_hStop)
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto Exit;
+	}
+
+	m_hThread = CreateThread(NULL, 0, ThreadProc, this, 0, NULL);
+	if (NULL == m_hThread)
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto Exit;
+	}
+
+Exit:
+	if (FAILED(hr) && m_hStop)
+	{
+		CloseHandle(m_hStop);
+		m_hStop = NULL;
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StartupLoader::Stop()
+//
+// Description: Stop loading and wait for the thread. Called by the thread
+//				of the dialog, before the owner releases its data source and
+//				destroys the dialog. The pages still queued for the dialog
+//				are freed.
+//
+////////////////////////////////////////////////////////////////////////////////
+void StartupLoader::Stop()
+{
+	MSG	msg;
+
+	if (m_hThread)
+	{
+		SetEvent(m_hStop);
+		WaitForSingleObject(m_hThread, INFINITE);
+
+		CloseHandle(m_hThread);
+		m_hThread = NULL;
+
+		while (PeekMessage(&msg, m_hWndNotify, WM_STARTUP_NAMES, WM_STARTUP_NAMES, PM_REMOVE))
+		{
+			CoTaskMemFree((STARTUP_NAME_PAGE*)msg.lParam);
+		}
+	}
+
+	if (m_hStop)
+	{
+		CloseHandle(m_hStop);
+		m_hStop = NULL;
+	}
+
+	m_hWndNotify			= NULL;
+	m_ppIDBCreateSession	= NULL;
+	m_pcsDataSource			= NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StartupLoader::MarkStage()
+//
+// Description: Record the time a stage is reached. Only the first time
+//				is kept.
+//
+////////////////////////////////////////////////////////////////////////////////
+void StartupLoader::MarkStage(DWORD dwStage)
+{
+	if (dwStage >= STARTUP_STAGE_COUNT)
+	{
+		return;
+	}
+
+	EnterCriticalSection(&m_cs);
+
+	if (STARTUP_STAGE_PENDING == m_Times.rgdwStageMs[dwStage])
+	{
+		m_Times.rgdwStageMs[dwStage] = GetTickCount() - m_dwStartMs;
+	}
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StartupLoader::GetTimes()
+//
+// Description: Returns the startup timings.
+//
+////////////////////////////////////////////////////////////////////////////////
+void StartupLoader::GetTimes(STARTUP_TIMES *pTimes)
+{
+	if (pTimes)
+	{
+		EnterCriticalSection(&m_cs);
+		*pTimes = m_Times;
+		LeaveCriticalSection(&m_cs);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StartupLoader::ReportTimes()
+//
+// Description: Write the startup timings to the debugger output.
+//				Stages not reached are reported as -1.
+//
+////////////////////////////////////////////////////////////////////////////////
+void StartupLoader::ReportTimes()
+{
+	STARTUP_TIMES	Times;
+	WCHAR			wszReport[192];
+
+	GetTimes(&Times);
+
+	wsprintf(wszReport,
+			 L"Startup: window %d ms, open %d ms, first page %d ms, first employee %d ms, all names %d ms, %d names, hr 0x%08X\r\n",
+			 Times.rgdwStageMs[STARTUP_STAGE_WINDOW],
+			 Times.rgdwStageMs[STARTUP_STAGE_OPEN],
+			 Times.rgdwStageMs[STARTUP_STAGE_FIRST_PAGE],
+			 Times.rgdwStageMs[STARTUP_STAGE_FIRST_EMPLOYEE],
+			 Times.rgdwStageMs[STARTUP_STAGE_ALL_NAMES],
+			 Times.cNames,
+			 Times.hr);
+
+	OutputDebugString(wszReport);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StartupLoader::ThreadProc()
+//
+// Description: Open the database, then read the names.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD WINAPI StartupLoader::ThreadProc(LPVOID lpParameter)
+{
+	StartupLoader		*pThis				= (StartupLoader*)lpParameter;
+	IDBCreateSession	*pIDBCreateSession	= NULL;
+	BOOL				fCoInit				= SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+	HRESULT				hr;
+
+	hr = pThis->Open(&pIDBCreateSession);
+	if (SUCCEEDED(hr))
+	{
+		pThis->MarkStage(STARTUP_STAGE_OPEN);
+
+		hr = pThis->LoadNames(pIDBCreateSession);
+		pIDBCreateSession->Release();
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		pThis->MarkStage(STARTUP_STAGE_ALL_NAMES);
+	}
+
+	EnterCriticalSection(&pThis->m_cs);
+	pThis->m_Times.hr = hr;
+	LeaveCriticalSection(&pThis->m_cs);
+
+	if (WAIT_TIMEOUT == WaitForSingleObject(pThis->m_hStop, 0))
+	{
+		PostMessage(pThis->m_hWndNotify, WM_STARTUP_DONE, (WPARAM)hr, 0);
+	}
+
+	if (fCoInit)
+	{
+		CoUninitialize();
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StartupLoader::Open()
+//
+// Description: Open the database and bring it to the current schema
+//				version, unless the owner already has it open.
+//
+// Parameters
+//		ppIDBCreateSession	- receives a reference to the data source
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT StartupLoader::Open(IDBCreateSession **ppIDBCreateSession)
+{
+	HRESULT				hr					= NOERROR;
+	IDBCreateSession	*pIDBCreateSession;
+
+	EnterCriticalSection(m_pcsDataSource);
+	pIDBCreateSession = *m_ppIDBCreateSession;
+	LeaveCriticalSection(m_pcsDataSource);
+
+	if (NULL == pIDBCreateSession)
+	{
+		hr = OpenDataSource(m_wszDatabase, &pIDBCreateSession);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+
+		// Databases created by earlier versions need the newer tables
+		//
+		hr = UpgradeSchema(pIDBCreateSession);
+		if(FAILED(hr))
+		{
+			ReleaseDataSource(&pIDBCreateSession);
+			return hr;
+		}
+
+		// Hand the data source to the owner
+		//
+		EnterCriticalSection(m_pcsDataSource);
+		*m_ppIDBCreateSession = pIDBCreateSession;
+		LeaveCriticalSection(m_pcsDataSource);
+	}
+
+	pIDBCreateSession->AddRef();
+	*ppIDBCreateSession = pIDBCreateSession;
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StartupLoader::LoadNames()
+//
+// Description: Read the employee names through EmployeeStore::ScanNames
+//				and post them to the dialog, a small page first.
+//
+// Returns: NOERROR if succesfull, E_ABORT if stopped
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT StartupLoader::LoadNames(IDBCreateSession *pIDBCreateSession)
+{
+	HRESULT				hr					= NOERROR;
+	EmployeeStore		Store;
+	STARTUP_NAME_SCAN	Scan;
+
+	Scan.pLoader	= this;
+	Scan.pPage		= NULL;
+	Scan.cPageNames	= STARTUP_FIRST_PAGE_SIZE;
+	Scan.hr			= NOERROR;
+
+	hr = Store.Open(pIDBCreateSession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = Store.ScanNames(AddName, &Scan);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = Scan.hr;
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	// The last page is not full
+	//
+	if (Scan.pPage)
+	{
+		hr = PostPage(&Scan.pPage);
+		if(FAILED(hr))
+		{
+			goto Exit;
+		}
+
+		if (STARTUP_FIRST_PAGE_SIZE == Scan.cPageNames)
+		{
+			MarkStage(STARTUP_STAGE_FIRST_PAGE);
+		}
+	}
+
+Exit:
+	// A page the dialog did not take
+	//
+	if (Scan.pPage)
+	{
+		CoTaskMemFree(Scan.pPage);
+	}
+
+	Store.Close();
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StartupLoader::AddName()
+//
+// Description: PFN_EMPLOYEE_NAME adding a name to the page being filled,
+//				and posting the page to the dialog once it is full.
+//
+// Returns: NOERROR to go on, S_FALSE if stopped or the page was not posted
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CALLBACK StartupLoader::AddName(LPVOID pvContext, DWORD dwEmployeeID, LPCWSTR pwszName)
+{
+	STARTUP_NAME_SCAN	*pScan	= (STARTUP_NAME_SCAN*)pvContext;
+	StartupLoader		*pThis	= pScan->pLoader;
+	STARTUP_NAME		*pName;
+
+	if (NULL == pScan->pPage)
+	{
+		if (WAIT_OBJECT_0 == WaitForSingleObject(pThis->m_hStop, 0))
+		{
+			pScan->hr = E_ABORT;
+			return S_FALSE;
+		}
+
+		pScan->pPage = (STARTUP_NAME_PAGE*)CoTaskMemAlloc(sizeof(STARTUP_NAME_PAGE));
+		if (NULL == pScan->pPage)
+		{
+			pScan->hr = E_OUTOFMEMORY;
+			return S_FALSE;
+		}
+
+		pScan->pPage->fFirst = (STARTUP_FIRST_PAGE_SIZE == pScan->cPageNames);
+		pScan->pPage->cNames = 0;
+	}
+
+	pName = &pScan->pPage->rgName[pScan->pPage->cNames++];
+	pName->dwEmployeeID = dwEmployeeID;
+
+	wcsncpy(pName->wszName, pwszName, STARTUP_MAX_NAME - 1);
+	pName->wszName[STARTUP_MAX_NAME - 1] = 0;
+
+	if (pScan->pPage->cNames < pScan->cPageNames)
+	{
+		return NOERROR;
+	}
+
+	// Left to LoadNames to free if it was not posted
+	//
+	pScan->hr = pThis->PostPage(&pScan->pPage);
+	if (FAILED(pScan->hr))
+	{
+		return S_FALSE;
+	}
+
+	if (STARTUP_FIRST_PAGE_SIZE == pScan->cPageNames)
+	{
+		pThis->MarkStage(STARTUP_STAGE_FIRST_PAGE);
+		pScan->cPageNames = STARTUP_PAGE_SIZE;
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: StartupLoader::PostPage()
+//
+// Description: Post a page of names to the dialog, which takes ownership.
+//				If the post fails the page is left to the caller to free.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT StartupLoader::PostPage(STARTUP_NAME_PAGE **ppPage)
+{
+	DWORD cNames = (*ppPage)->cNames;
+
+	if (!PostMessage(m_hWndNotify, WM_STARTUP_NAMES, 0, (LPARAM)*ppPage))
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	*ppPage = NULL;
+
+	EnterCriticalSection(&m_cs);
+	m_Times.cNames += cNames;
+	LeaveCriticalSection(&m_cs);
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: AddStartupNames
+//
+// Description: Add a page of names to the employee name combobox, with the
+//				employee id as item data, and free the page.
+//
+// Returns: The number of names added
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD AddStartupNames(HWND hWndDlg, STARTUP_NAME_PAGE *pPage)
+{
+	DWORD	cAdded	= 0;
+	DWORD	dwIndex;
+
+	if (NULL == pPage)
+	{
+		return 0;
+	}
+
+	for (DWORD dwName = 0; dwName < pPage->cNames; ++dwName)
+	{
+		dwIndex = SendDlgItemMessage(hWndDlg, IDC_COMBO_NAME, CB_ADDSTRING, 0, (LPARAM)pPage->rgName[dwName].wszName);
+		if (CB_ERR != dwIndex)
+		{
+			SendDlgItemMessage(hWndDlg, IDC_COMBO_NAME, CB_SETITEMDATA, dwIndex, pPage->rgName[dwName].dwEmployeeID);
+			++cAdded;
+		}
+	}
+
+	CoTaskMemFree(pPage);
+
+	return cAdded;
+}
@@ -0,0 +1,134 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: StartupLoader
+//
+// File: StartupLoader.h
+//
+// Comment: Staged startup. The database is opened and the employee names
+//			loaded on a background thread while the window is shown.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_STARTUPLOADER_H__3C9A61E2_7B45_4F0D_9E2A_C84B16D0F357__INCLUDED_)
+#define AFX_STARTUPLOADER_H__3C9A61E2_7B45_4F0D_9E2A_C84B16D0F357__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define STARTUP_FIRST_PAGE_SIZE		8				// Names in the first page, enough to fill the drop down
+#define STARTUP_PAGE_SIZE			64				// Names in the following pages
+#define STARTUP_MAX_NAME			64				// LastName + ', ' + FirstName
+
+////////////////////////////////////////////////////////////////////////////////
+// Posted to the dialog with a page of employee names in lParam. The dialog
+// owns the page and frees it with CoTaskMemFree.
+//
+#define WM_STARTUP_NAMES			(WM_APP + 0x32)
+
+////////////////////////////////////////////////////////////////////////////////
+// Posted to the dialog when the name list is complete, or loading failed.
+// wParam is the HRESULT.
+//
+#define WM_STARTUP_DONE				(WM_APP + 0x33)
+
+////////////////////////////////////////////////////////////////////////////////
+// Startup stages, timed from StartupLoader::Begin
+//
+#define STARTUP_STAGE_WINDOW			0			// Dialog shown
+#define STARTUP_STAGE_OPEN				1			// Database open
+#define STARTUP_STAGE_FIRST_PAGE		2			// First page of names posted
+#define STARTUP_STAGE_FIRST_EMPLOYEE	3			// First employee displayed
+#define STARTUP_STAGE_ALL_NAMES			4			// Name list complete
+#define STARTUP_STAGE_COUNT				5
+
+#define STARTUP_STAGE_PENDING			0xFFFFFFFF	// Stage not reached
+
+////////////////////////////////////////////////////////////////////////////////
+// A page of employee names
+//
+typedef struct tagSTARTUP_NAME
+{
+	DWORD	dwEmployeeID;
+	WCHAR	wszName[STARTUP_MAX_NAME];
+} STARTUP_NAME;
+
+typedef struct tagSTARTUP_NAME_PAGE
+{
+	BOOL			fFirst;							// First page of the list
+	DWORD			cNames;
+	STARTUP_NAME	rgName[STARTUP_PAGE_SIZE];
+} STARTUP_NAME_PAGE;
+
+////////////////////////////////////////////////////////////////////////////////
+// Startup timings
+//
+typedef struct tagSTARTUP_TIMES
+{
+	DWORD	rgdwStageMs[STARTUP_STAGE_COUNT];		// Since Begin, or STARTUP_STAGE_PENDING
+	DWORD	cNames;
+	HRESULT	hr;
+} STARTUP_TIMES;
+
+////////////////////////////////////////////////////////////////////////////////
+// Opens the database and streams the employee names to the dialog in pages.
+// The first page is small so the dialog can select and display the first
+// employee as soon as possible.
+//
+// The data source is returned through the pointer given to Start, under the
+// critical section given with it, before the first message is posted. The
+// owner reads the pointer under the same critical section.
+//
+// Pages the dialog has not received when Stop is called are freed there.
+//
+class StartupLoader
+{
+public:
+	StartupLoader();
+	~StartupLoader();
+
+	void	Begin();
+	HRESULT Start(HWND				hWndNotify,
+				  LPCWSTR			pwszDatabase,
+				  IDBCreateSession	**ppIDBCreateSession,
+				  CRITICAL_SECTION	*pcsDataSource);
+	void	Stop();
+
+	void	MarkStage(DWORD dwStage);
+	void	GetTimes(STARTUP_TIMES *pTimes);
+	void	ReportTimes();
+
+private:
+	static DWORD WINAPI ThreadProc(LPVOID lpParameter);
+	static HRESULT CALLBACK AddName(LPVOID pvContext, DWORD dwEmployeeID, LPCWSTR pwszName);
+
+	HRESULT Open(IDBCreateSession **ppIDBCreateSession);
+	HRESULT LoadNames(IDBCreateSession *pIDBCreateSession);
+	HRESULT PostPage(STARTUP_NAME_PAGE **ppPage);
+
+	CRITICAL_SECTION	m_cs;					// Guards the timings
+	HWND				m_hWndNotify;
+	WCHAR				m_wszDatabase[MAX_PATH];
+	IDBCreateSession	**m_ppIDBCreateSession;
+	CRITICAL_SECTION	*m_pcsDataSource;		// Guards *m_ppIDBCreateSession
+	HANDLE				m_hThread;
+	HANDLE				m_hStop;
+
+	DWORD				m_dwStartMs;
+	STARTUP_TIMES		m_Times;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Add a page of names to the employee name combobox and free it.
+// Returns the number of names added.
+//
+DWORD AddStartupNames(HWND hWndDlg, STARTUP_NAME_PAGE *pPage);
+
+extern StartupLoader	g_StartupLoader;
+
+#endif // !defined(AFX_STARTUPLOADER_H__3C9A61E2_7B45_4F0D_9E2A_C84B16D0F357__INCLUDED_)
@@ -0,0 +1,874 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: TaskScheduler
+//
+// File: TaskScheduler.cpp
+//
+// Comment: Work-stealing pool of threads running database tasks.
+//
+// Functions:
+//			1. Queue tasks per worker and priority
+//			2. Steal the oldest task of another worker when idle
+//			3. Cancel, wait for and release tasks
+//			4. Check a session out of the pool for the tasks of a worker
+//			5. Report queue depths, steals and waits
+//
+// Notes:
+//			A semaphore counts the queued tasks, so a worker it wakes
+//			always finds a task in some queue. Cancelled tasks stay queued
+//			and are completed with E_ABORT by the worker that takes them,
+//			which keeps the count right. Stop wakes every worker once more
+//			to find the queues empty.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "DbHelpers.h"
+#include "SessionPool.h"
+#include "TaskScheduler.h"
+
+TaskScheduler	g_TaskScheduler;						// Data layer tasks of the application
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::TaskScheduler()
+//
+// Description: Constructor
+//
+////////////////////////////////////////////////////////////////////////////////
+TaskScheduler::TaskScheduler() :	m_pSessionPool(NULL),
+									m_cWorkers(0),
+									m_hWork(NULL),
+									m_hIdle(NULL),
+									m_cPending(0),
+									m_iNextWorker(0),
+									m_fStop(FALSE)
+{
+	InitializeCriticalSection(&m_cs);
+
+	memset(m_rgWorker, 0, sizeof(m_rgWorker));
+
+	for (DWORD iWorker = 0; iWorker < SCHEDULER_MAX_WORKERS; ++iWorker)
+	{
+		InitializeCriticalSection(&m_rgWorker[iWorker].cs);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::~TaskScheduler()
+//
+// Description: Destructor
+//
+////////////////////////////////////////////////////////////////////////////////
+TaskScheduler::~TaskScheduler()
+{
+	Stop();
+
+	for (DWORD iWorker = 0; iWorker < SCHEDULER_MAX_WORKERS; ++iWorker)
+	{
+		DeleteCriticalSection(&m_rgWorker[iWorker].cs);
+	}
+
+	DeleteCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::Start()
+//
+// Description: Start the worker threads.
+//
+// Parameters
+//		pSessionPool	- pool the sessions of the workers are checked out of,
+//						  NULL if the tasks don't use the database
+//		cWorkers		- worker threads, 0 for one per processor
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT TaskScheduler::Start(SessionPool *pSessionPool, DWORD cWorkers)
+{
+	HRESULT		hr			= NOERROR;
+	SYSTEM_INFO	SystemInfo;
+	DWORD		iWorker;
+
+	if (m_cWorkers)
+	{
+		return E_UNEXPECTED;
+	}
+
+	if (0 == cWorkers)
+	{
+		GetSystemInfo(&SystemInfo);
+		cWorkers = SystemInfo.dwNumberOfProcessors ? SystemInfo.dwNumberOfProcessors : 1;
+	}
+
+	if (cWorkers > SCHEDULER_MAX_WORKERS)
+	{
+		cWorkers = SCHEDULER_MAX_WORKERS;
+	}
+
+	m_hWork = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+	m_hIdle = CreateEvent(NULL, TRUE, TRUE, NULL);
+	if (NULL == m_hWork || NULL == m_hIdle)
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto Exit;
+	}
+
+	m_pSessionPool	= pSessionPool;
+	m_cPending		= 0;
+	m_iNextWorker	= 0;
+	m_fStop			= FALSE;
+
+	for (iWorker = 0; iWorker < cWorkers; ++iWorker)
+	{
+		SCHEDULER_WORKER *pWorker = &m_rgWorker[iWorker];
+
+		pWorker->pThis		= this;
+		pWorker->iWorker	= iWorker;
+		pWorker->hThread	= CreateThread(NULL, 0, WorkerThreadProc, pWorker, 0, &pWorker->dwThreadId);
+		if (NULL == pWorker->hThread)
+		{
+			hr = HRESULT_FROM_WIN32(GetLastError());
+			break;
+		}
+
+		++m_cWorkers;
+	}
+
+Exit:
+	if(FAILED(hr))
+	{
+		Stop();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::Stop()
+//
+// Description: Cancel the queued tasks, wait for the running ones and
+//				stop the worker threads.
+//
+////////////////////////////////////////////////////////////////////////////////
+void TaskScheduler::Stop()
+{
+	DWORD	iWorker;
+	DWORD	dwPriority;
+	DWORD	iTask;
+
+	for (iWorker = 0; iWorker < m_cWorkers; ++iWorker)
+	{
+		SCHEDULER_WORKER *pWorker = &m_rgWorker[iWorker];
+
+		EnterCriticalSection(&pWorker->cs);
+
+		for (dwPriority = 0; dwPriority < SCHEDULER_PRIORITIES; ++dwPriority)
+		{
+			SCHEDULER_DEQUE *pDeque = &pWorker->rgDeque[dwPriority];
+
+			for (iTask = 0; iTask < pDeque->cTasks; ++iTask)
+			{
+				InterlockedExchange(&pDeque->rgpTask[(pDeque->iOldest + iTask) % pDeque->cSlots]->fCancel, TRUE);
+			}
+		}
+
+		LeaveCriticalSection(&pWorker->cs);
+	}
+
+	InterlockedExchange(&m_fStop, TRUE);
+
+	if (m_cWorkers)
+	{
+		ReleaseSemaphore(m_hWork, m_cWorkers, NULL);
+	}
+
+	for (iWorker = 0; iWorker < m_cWorkers; ++iWorker)
+	{
+		WaitForSingleObject(m_rgWorker[iWorker].hThread, INFINITE);
+	}
+
+	for (iWorker = 0; iWorker < SCHEDULER_MAX_WORKERS; ++iWorker)
+	{
+		SCHEDULER_WORKER *pWorker = &m_rgWorker[iWorker];
+
+		if (pWorker->hThread)
+		{
+			CloseHandle(pWorker->hThread);
+		}
+
+		for (dwPriority = 0; dwPriority < SCHEDULER_PRIORITIES; ++dwPriority)
+		{
+			if (pWorker->rgDeque[dwPriority].rgpTask)
+			{
+				CoTaskMemFree(pWorker->rgDeque[dwPriority].rgpTask);
+			}
+		}
+
+		// Keep the critical section, clear the rest
+		//
+		memset(&pWorker->rgDeque, 0, sizeof(pWorker->rgDeque));
+		memset(&pWorker->Stats, 0, (BYTE*)(pWorker + 1) - (BYTE*)&pWorker->Stats);
+
+		pWorker->hThread	= NULL;
+		pWorker->dwThreadId	= 0;
+		pWorker->pSession	= NULL;
+	}
+
+	if (m_hWork)
+	{
+		CloseHandle(m_hWork);
+		m_hWork = NULL;
+	}
+
+	if (m_hIdle)
+	{
+		CloseHandle(m_hIdle);
+		m_hIdle = NULL;
+	}
+
+	m_pSessionPool	= NULL;
+	m_cWorkers		= 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::Submit()
+//
+// Description: Queue a task.
+//
+// Parameters
+//		pfnTask		- the task
+//		pvContext	- passed to pfnTask
+//		dwPriority	- SCHEDULER_PRIORITY_*
+//		iAffinity	- worker to queue the task to, SCHEDULER_NO_AFFINITY for any
+//		ppTask		- optionally receives the task, to wait for and release
+//					  with CloseTask
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT TaskScheduler::Submit(PFN_SCHEDULER_TASK	pfnTask,
+							  LPVOID				pvContext,
+							  DWORD					dwPriority,
+							  DWORD					iAffinity,
+							  SCHEDULER_TASK		**ppTask)
+{
+	HRESULT				hr			= NOERROR;
+	SCHEDULER_TASK		*pTask		= NULL;
+	SCHEDULER_WORKER	*pWorker;
+	DWORD				iWorker;
+
+	if (ppTask)
+	{
+		*ppTask = NULL;
+	}
+
+	if (NULL == pfnTask || dwPriority >= SCHEDULER_PRIORITIES)
+	{
+		return E_INVALIDARG;
+	}
+
+	if (0 == m_cWorkers || m_fStop)
+	{
+		return E_UNEXPECTED;
+	}
+
+	pTask = (SCHEDULER_TASK*)CoTaskMemAlloc(sizeof(SCHEDULER_TASK));
+	if (NULL == pTask)
+	{
+		return E_OUTOFMEMORY;
+	}
+
+	memset(pTask, 0, sizeof(SCHEDULER_TASK));
+
+	pTask->pfnTask		= pfnTask;
+	pTask->pvContext	= pvContext;
+	pTask->dwPriority	= dwPriority;
+	pTask->iAffinity	= iAffinity < m_cWorkers ? iAffinity : SCHEDULER_NO_AFFINITY;
+	pTask->dwQueuedMs	= GetTickCount();
+	pTask->cRefs		= ppTask ? 2 : 1;
+	pTask->hr			= E_PENDING;
+
+	if (ppTask)
+	{
+		pTask->hDone = CreateEvent(NULL, TRUE, FALSE, NULL);
+		if (NULL == pTask->hDone)
+		{
+			hr = HRESULT_FROM_WIN32(GetLastError());
+			goto Exit;
+		}
+	}
+
+	// The worker asked for, the worker submitting, or the next in turn
+	//
+	iWorker = pTask->iAffinity;
+	if (SCHEDULER_NO_AFFINITY == iWorker)
+	{
+		iWorker = GetCurrentWorker();
+	}
+
+	if (SCHEDULER_NO_AFFINITY == iWorker)
+	{
+		iWorker = (DWORD)InterlockedIncrement(&m_iNextWorker) % m_cWorkers;
+	}
+
+	EnterCriticalSection(&m_cs);
+
+	if (0 == m_cPending++)
+	{
+		ResetEvent(m_hIdle);
+	}
+
+	LeaveCriticalSection(&m_cs);
+
+	pWorker = &m_rgWorker[iWorker];
+
+	EnterCriticalSection(&pWorker->cs);
+
+	hr = PushTask(&pWorker->rgDeque[dwPriority], pTask);
+	if (SUCCEEDED(hr))
+	{
+		++pWorker->rgcSubmitted[dwPriority];
+
+		if (++pWorker->Stats.cQueued > pWorker->Stats.cPeakQueued)
+		{
+			pWorker->Stats.cPeakQueued = pWorker->Stats.cQueued;
+		}
+	}
+
+	LeaveCriticalSection(&pWorker->cs);
+
+	if(FAILED(hr))
+	{
+		EnterCriticalSection(&m_cs);
+
+		if (0 == --m_cPending)
+		{
+			SetEvent(m_hIdle);
+		}
+
+		LeaveCriticalSection(&m_cs);
+
+		goto Exit;
+	}
+
+	ReleaseSemaphore(m_hWork, 1, NULL);
+
+	if (ppTask)
+	{
+		*ppTask = pTask;
+	}
+
+	pTask = NULL;
+
+Exit:
+	if (pTask)
+	{
+		if (pTask->hDone)
+		{
+			CloseHandle(pTask->hDone);
+		}
+
+		CoTaskMemFree(pTask);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::Cancel()
+//
+// Description: Cancel a task. A queued task completes with E_ABORT without
+//				running; a running task sees the flag if it checks it.
+//
+////////////////////////////////////////////////////////////////////////////////
+void TaskScheduler::Cancel(SCHEDULER_TASK *pTask)
+{
+	if (pTask)
+	{
+		InterlockedExchange(&pTask->fCancel, TRUE);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::Wait()
+//
+// Description: Wait for a task to complete.
+//
+// Parameters
+//		pTask		- task returned by Submit
+//		dwTimeoutMs	- longest wait, INFINITE for none
+//
+// Returns: the result of the task, E_ABORT if it was cancelled before it
+//			ran, HRESULT_FROM_WIN32(ERROR_TIMEOUT) if it did not complete
+//			in time
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT TaskScheduler::Wait(SCHEDULER_TASK *pTask, DWORD dwTimeoutMs)
+{
+	if (NULL == pTask || NULL == pTask->hDone)
+	{
+		return E_INVALIDARG;
+	}
+
+	if (WAIT_OBJECT_0 != WaitForSingleObject(pTask->hDone, dwTimeoutMs))
+	{
+		return HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+	}
+
+	return pTask->hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::CloseTask()
+//
+// Description: Release a task returned by Submit. A task still queued or
+//				running completes as usual.
+//
+////////////////////////////////////////////////////////////////////////////////
+void TaskScheduler::CloseTask(SCHEDULER_TASK *pTask)
+{
+	if (pTask)
+	{
+		ReleaseTask(pTask);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::WaitIdle()
+//
+// Description: Wait until no task is queued or running.
+//
+// Returns: NOERROR if succesfull, HRESULT_FROM_WIN32(ERROR_TIMEOUT) if
+//			tasks remain
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT TaskScheduler::WaitIdle(DWORD dwTimeoutMs)
+{
+	if (NULL == m_hIdle)
+	{
+		return NOERROR;
+	}
+
+	if (WAIT_OBJECT_0 != WaitForSingleObject(m_hIdle, dwTimeoutMs))
+	{
+		return HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+	}
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::GetWorkerCount()
+//
+// Description: Number of worker threads, the range of affinity hints.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD TaskScheduler::GetWorkerCount()
+{
+	return m_cWorkers;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::GetStats()
+//
+// Description: Add up the counters of the workers.
+//
+////////////////////////////////////////////////////////////////////////////////
+void TaskScheduler::GetStats(SCHEDULER_STATS *pStats)
+{
+	ULONGLONG	rgullWaitMs[SCHEDULER_PRIORITIES];
+	DWORD		rgcStarted[SCHEDULER_PRIORITIES];
+	DWORD		dwPriority;
+
+	memset(pStats, 0, sizeof(SCHEDULER_STATS));
+	memset(rgullWaitMs, 0, sizeof(rgullWaitMs));
+	memset(rgcStarted, 0, sizeof(rgcStarted));
+
+	pStats->cWorkers = m_cWorkers;
+
+	for (DWORD iWorker = 0; iWorker < m_cWorkers; ++iWorker)
+	{
+		SCHEDULER_WORKER *pWorker = &m_rgWorker[iWorker];
+
+		EnterCriticalSection(&pWorker->cs);
+
+		pStats->rgWorker[iWorker]	= pWorker->Stats;
+		pStats->cCompleted			+= pWorker->cCompleted;
+		pStats->cFailed				+= pWorker->cFailed;
+		pStats->cCancelled			+= pWorker->cCancelled;
+		pStats->cSteals				+= pWorker->Stats.cStolen;
+		pStats->cAffinityHits		+= pWorker->cAffinityHits;
+		pStats->cAffinityMisses		+= pWorker->cAffinityMisses;
+
+		for (dwPriority = 0; dwPriority < SCHEDULER_PRIORITIES; ++dwPriority)
+		{
+			pStats->rgcSubmitted[dwPriority]	+= pWorker->rgcSubmitted[dwPriority];
+			rgcStarted[dwPriority]				+= pWorker->rgcStarted[dwPriority];
+			rgullWaitMs[dwPriority]				+= pWorker->rgullWaitMs[dwPriority];
+
+			if (pWorker->rgdwMaxWaitMs[dwPriority] > pStats->rgdwMaxWaitMs[dwPriority])
+			{
+				pStats->rgdwMaxWaitMs[dwPriority] = pWorker->rgdwMaxWaitMs[dwPriority];
+			}
+		}
+
+		LeaveCriticalSection(&pWorker->cs);
+	}
+
+	for (dwPriority = 0; dwPriority < SCHEDULER_PRIORITIES; ++dwPriority)
+	{
+		if (rgcStarted[dwPriority])
+		{
+			pStats->rgdwAvgWaitMs[dwPriority] = (DWORD)(rgullWaitMs[dwPriority] / rgcStarted[dwPriority]);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::WorkerThreadProc()
+//
+// Description: Worker thread. Runs a task each time the semaphore counts
+//				one, until Stop finds the queues empty. Checks its session
+//				in whenever it has to wait for a task.
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD WINAPI TaskScheduler::WorkerThreadProc(LPVOID lpParameter)
+{
+	SCHEDULER_WORKER	*pWorker	= (SCHEDULER_WORKER*)lpParameter;
+	TaskScheduler		*pThis		= pWorker->pThis;
+	BOOL				fCoInit		= SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+	SCHEDULER_TASK		*pTask;
+
+	for (;;)
+	{
+		if (WAIT_TIMEOUT == WaitForSingleObject(pThis->m_hWork, 0))
+		{
+			if (pWorker->pSession)
+			{
+				pThis->m_pSessionPool->CheckIn(pWorker->pSession, FALSE);
+				pWorker->pSession = NULL;
+			}
+
+			WaitForSingleObject(pThis->m_hWork, INFINITE);
+		}
+
+		pTask = pThis->TakeTask(pWorker);
+		if (NULL == pTask)
+		{
+			if (pThis->m_fStop)
+			{
+				break;
+			}
+
+			continue;
+		}
+
+		pThis->RunTask(pWorker, pTask);
+	}
+
+	if (pWorker->pSession)
+	{
+		pThis->m_pSessionPool->CheckIn(pWorker->pSession, FALSE);
+		pWorker->pSession = NULL;
+	}
+
+	if (fCoInit)
+	{
+		CoUninitialize();
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::TakeTask()
+//
+// Description: Take the next task for a worker: at each priority in turn,
+//				its own newest task, else the oldest task of the next worker
+//				that has one.
+//
+// Returns: the task, NULL if every queue is empty
+//
+////////////////////////////////////////////////////////////////////////////////
+SCHEDULER_TASK* TaskScheduler::TakeTask(SCHEDULER_WORKER *pWorker)
+{
+	SCHEDULER_TASK		*pTask	= NULL;
+	SCHEDULER_WORKER	*pVictim;
+	DWORD				dwPriority;
+	DWORD				iNext;
+
+	for (dwPriority = 0; dwPriority < SCHEDULER_PRIORITIES; ++dwPriority)
+	{
+		EnterCriticalSection(&pWorker->cs);
+
+		pTask = PopNewest(&pWorker->rgDeque[dwPriority]);
+		if (pTask)
+		{
+			--pWorker->Stats.cQueued;
+		}
+
+		LeaveCriticalSection(&pWorker->cs);
+
+		if (pTask)
+		{
+			return pTask;
+		}
+
+		for (iNext = 1; iNext < m_cWorkers; ++iNext)
+		{
+			pVictim = &m_rgWorker[(pWorker->iWorker + iNext) % m_cWorkers];
+
+			EnterCriticalSection(&pVictim->cs);
+
+			pTask = PopOldest(&pVictim->rgDeque[dwPriority]);
+			if (pTask)
+			{
+				--pVictim->Stats.cQueued;
+			}
+
+			LeaveCriticalSection(&pVictim->cs);
+
+			if (pTask)
+			{
+				EnterCriticalSection(&pWorker->cs);
+				++pWorker->Stats.cStolen;
+				LeaveCriticalSection(&pWorker->cs);
+
+				return pTask;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::RunTask()
+//
+// Description: Run a task on the session of the worker, or complete it
+//				with E_ABORT if it was cancelled while queued.
+//
+////////////////////////////////////////////////////////////////////////////////
+void TaskScheduler::RunTask(SCHEDULER_WORKER *pWorker, SCHEDULER_TASK *pTask)
+{
+	HRESULT					hr			= NOERROR;
+	SCHEDULER_TASK_CONTEXT	TaskContext;
+	DWORD					dwWaitMs	= GetTickCount() - pTask->dwQueuedMs;
+	BOOL					fRun		= !pTask->fCancel;
+
+	if (fRun)
+	{
+		if (m_pSessionPool && NULL == pWorker->pSession)
+		{
+			hr = m_pSessionPool->CheckOut(INFINITE, &pWorker->pSession);
+		}
+
+		if (SUCCEEDED(hr))
+		{
+			TaskContext.iWorker		= pWorker->iWorker;
+			TaskContext.pSession	= pWorker->pSession;
+			TaskContext.pISession	= pWorker->pSession ? pWorker->pSession->pISession : NULL;
+			TaskContext.pfCancel	= &pTask->fCancel;
+
+			hr = pTask->pfnTask(pTask->pvContext, &TaskContext);
+		}
+	}
+	else
+	{
+		hr = E_ABORT;
+	}
+
+	EnterCriticalSection(&pWorker->cs);
+
+	if (fRun)
+	{
+		++pWorker->Stats.cExecuted;
+		++pWorker->cCompleted;
+		++pWorker->rgcStarted[pTask->dwPriority];
+
+		pWorker->rgullWaitMs[pTask->dwPriority] += dwWaitMs;
+
+		if (dwWaitMs > pWorker->rgdwMaxWaitMs[pTask->dwPriority])
+		{
+			pWorker->rgdwMaxWaitMs[pTask->dwPriority] = dwWaitMs;
+		}
+
+		if(FAILED(hr))
+		{
+			++pWorker->cFailed;
+		}
+
+		if (SCHEDULER_NO_AFFINITY != pTask->iAffinity)
+		{
+			if (pTask->iAffinity == pWorker->iWorker)
+			{
+				++pWorker->cAffinityHits;
+			}
+			else
+			{
+				++pWorker->cAffinityMisses;
+			}
+		}
+	}
+	else
+	{
+		++pWorker->cCancelled;
+	}
+
+	LeaveCriticalSection(&pWorker->cs);
+
+	pTask->hr = hr;
+
+	if (pTask->hDone)
+	{
+		SetEvent(pTask->hDone);
+	}
+
+	ReleaseTask(pTask);
+
+	EnterCriticalSection(&m_cs);
+
+	if (0 == --m_cPending)
+	{
+		SetEvent(m_hIdle);
+	}
+
+	LeaveCriticalSection(&m_cs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::ReleaseTask()
+//
+// Description: Drop a reference to a task, freeing it with the last one.
+//
+////////////////////////////////////////////////////////////////////////////////
+void TaskScheduler::ReleaseTask(SCHEDULER_TASK *pTask)
+{
+	if (0 == InterlockedDecrement(&pTask->cRefs))
+	{
+		if (pTask->hDone)
+		{
+			CloseHandle(pTask->hDone);
+		}
+
+		CoTaskMemFree(pTask);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::GetCurrentWorker()
+//
+// Description: Worker of the calling thread.
+//
+// Returns: the index of the worker, SCHEDULER_NO_AFFINITY if the caller is
+//			not a worker
+//
+////////////////////////////////////////////////////////////////////////////////
+DWORD TaskScheduler::GetCurrentWorker()
+{
+	DWORD dwThreadId = GetCurrentThreadId();
+
+	for (DWORD iWorker = 0; iWorker < m_cWorkers; ++iWorker)
+	{
+		if (m_rgWorker[iWorker].dwThreadId == dwThreadId)
+		{
+			return iWorker;
+		}
+	}
+
+	return SCHEDULER_NO_AFFINITY;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::PushTask()
+//
+// Description: Add a task at the new end of a queue, doubling the slots
+//				when it is full.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT TaskScheduler::PushTask(SCHEDULER_DEQUE *pDeque, SCHEDULER_TASK *pTask)
+{
+	SCHEDULER_TASK	**rgpTask;
+	DWORD			cSlots;
+
+	if (pDeque->cTasks == pDeque->cSlots)
+	{
+		cSlots	= pDeque->cSlots ? pDeque->cSlots * 2 : SCHEDULER_INITIAL_DEPTH;
+		rgpTask	= (SCHEDULER_TASK**)CoTaskMemAlloc(cSlots * sizeof(SCHEDULER_TASK*));
+		if (NULL == rgpTask)
+		{
+			return E_OUTOFMEMORY;
+		}
+
+		// Unwrap the ring, oldest first
+		//
+		for (DWORD iTask = 0; iTask < pDeque->cTasks; ++iTask)
+		{
+			rgpTask[iTask] = pDeque->rgpTask[(pDeque->iOldest + iTask) % pDeque->cSlots];
+		}
+
+		if (pDeque->rgpTask)
+		{
+			CoTaskMemFree(pDeque->rgpTask);
+		}
+
+		pDeque->rgpTask	= rgpTask;
+		pDeque->cSlots	= cSlots;
+		pDeque->iOldest	= 0;
+	}
+
+	pDeque->rgpTask[(pDeque->iOldest + pDeque->cTasks) % pDeque->cSlots] = pTask;
+	++pDeque->cTasks;
+
+	return NOERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::PopNewest()
+//
+// Description: Take the task queued last, for the owner of the queue.
+//
+////////////////////////////////////////////////////////////////////////////////
+SCHEDULER_TASK* TaskScheduler::PopNewest(SCHEDULER_DEQUE *pDeque)
+{
+	if (0 == pDeque->cTasks)
+	{
+		return NULL;
+	}
+
+	--pDeque->cTasks;
+
+	return pDeque->rgpTask[(pDeque->iOldest + pDeque->cTasks) % pDeque->cSlots];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: TaskScheduler::PopOldest()
+//
+// Description: Take the task queued first, for a thief.
+//
+////////////////////////////////////////////////////////////////////////////////
+SCHEDULER_TASK* TaskScheduler::PopOldest(SCHEDULER_DEQUE *pDeque)
+{
+	SCHEDULER_TASK *pTask;
+
+	if (0 == pDeque->cTasks)
+	{
+		return NULL;
+	}
+
+	pTask			= pDeque->rgpTask[pDeque->iOldest];
+	pDeque->iOldest	= (pDeque->iOldest + 1) % pDeque->cSlots;
+	--pDeque->cTasks;
+
+	return pTask;
+}
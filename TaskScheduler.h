@@ -0,0 +1,197 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: TaskScheduler
+//
+// File: TaskScheduler.h
+//
+// Comment: Work-stealing pool of threads running database tasks.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_TASKSCHEDULER_H__0B7D4E62_93A1_4F58_BC26_E85A1D3F7C09__INCLUDED_)
+#define AFX_TASKSCHEDULER_H__0B7D4E62_93A1_4F58_BC26_E85A1D3F7C09__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#define SCHEDULER_MAX_WORKERS		16
+#define SCHEDULER_INITIAL_DEPTH		32				// Slots of a queue, doubled when full
+#define SCHEDULER_NO_AFFINITY		0xFFFFFFFF
+
+// Task priorities, a worker takes the first it finds in this order
+//
+#define SCHEDULER_PRIORITY_INTERACTIVE	0			// Lookups a user is waiting for
+#define SCHEDULER_PRIORITY_BACKGROUND	1			// Prefetch, decode, compaction, sync
+#define SCHEDULER_PRIORITIES			2
+
+////////////////////////////////////////////////////////////////////////////////
+// What a task is given when it runs
+//
+typedef struct tagSCHEDULER_TASK_CONTEXT
+{
+	DWORD			iWorker;					// Worker running the task
+	POOLED_SESSION	*pSession;					// Session of the worker, NULL without a pool
+	IOpenRowset		*pISession;					// pSession->pISession
+	volatile LONG	*pfCancel;					// Set when the task is cancelled
+} SCHEDULER_TASK_CONTEXT;
+
+////////////////////////////////////////////////////////////////////////////////
+// Runs a task on a worker thread. A long task checks *pfCancel now and
+// then and returns E_ABORT when it is set. The session is checked out to
+// the worker and is not released or checked in by the task.
+//
+typedef HRESULT (CALLBACK *PFN_SCHEDULER_TASK)(LPVOID pvContext, const SCHEDULER_TASK_CONTEXT *pTaskContext);
+
+////////////////////////////////////////////////////////////////////////////////
+// A submitted task. Held by the scheduler until it completes and by the
+// caller until CloseTask.
+//
+typedef struct tagSCHEDULER_TASK
+{
+	PFN_SCHEDULER_TASK	pfnTask;
+	LPVOID				pvContext;
+	DWORD				dwPriority;
+	DWORD				iAffinity;				// Worker asked for, SCHEDULER_NO_AFFINITY for any
+	DWORD				dwQueuedMs;
+	volatile LONG		fCancel;
+	volatile LONG		cRefs;
+	HRESULT				hr;						// E_PENDING until the task completes
+	HANDLE				hDone;					// Set when the task completes, NULL if not waited on
+} SCHEDULER_TASK;
+
+////////////////////////////////////////////////////////////////////////////////
+// Tasks waiting for a worker at one priority. The owner takes the newest
+// task, thieves take the oldest.
+//
+typedef struct tagSCHEDULER_DEQUE
+{
+	SCHEDULER_TASK		**rgpTask;
+	DWORD				cSlots;
+	DWORD				iOldest;
+	DWORD				cTasks;
+} SCHEDULER_DEQUE;
+
+////////////////////////////////////////////////////////////////////////////////
+// Statistics of a worker
+//
+typedef struct tagSCHEDULER_WORKER_STATS
+{
+	DWORD		cExecuted;						// Tasks run, cancelled ones excluded
+	DWORD		cStolen;						// Taken from the queues of other workers
+	DWORD		cQueued;						// Waiting in the queues of the worker now
+	DWORD		cPeakQueued;
+} SCHEDULER_WORKER_STATS;
+
+////////////////////////////////////////////////////////////////////////////////
+// Scheduler statistics
+//
+typedef struct tagSCHEDULER_STATS
+{
+	DWORD					cWorkers;
+	DWORD					rgcSubmitted[SCHEDULER_PRIORITIES];
+	DWORD					cCompleted;				// Ran, successfully or not
+	DWORD					cFailed;
+	DWORD					cCancelled;				// Cancelled before they ran
+	DWORD					cSteals;
+	DWORD					cAffinityHits;			// Ran on the worker asked for
+	DWORD					cAffinityMisses;		// Stolen from the worker asked for
+	DWORD					rgdwAvgWaitMs[SCHEDULER_PRIORITIES];	// From submission to start
+	DWORD					rgdwMaxWaitMs[SCHEDULER_PRIORITIES];
+	SCHEDULER_WORKER_STATS	rgWorker[SCHEDULER_MAX_WORKERS];
+} SCHEDULER_STATS;
+
+////////////////////////////////////////////////////////////////////////////////
+// A worker thread with its queues and its session
+//
+typedef struct tagSCHEDULER_WORKER
+{
+	class TaskScheduler		*pThis;
+	DWORD					iWorker;
+	HANDLE					hThread;
+	DWORD					dwThreadId;
+	CRITICAL_SECTION		cs;						// Guards the queues and the counters
+	SCHEDULER_DEQUE			rgDeque[SCHEDULER_PRIORITIES];
+	POOLED_SESSION			*pSession;				// Checked out while the worker has tasks
+
+	SCHEDULER_WORKER_STATS	Stats;
+	DWORD					rgcSubmitted[SCHEDULER_PRIORITIES];
+	DWORD					cCompleted;
+	DWORD					cFailed;
+	DWORD					cCancelled;
+	DWORD					cAffinityHits;
+	DWORD					cAffinityMisses;
+	DWORD					rgcStarted[SCHEDULER_PRIORITIES];
+	ULONGLONG				rgullWaitMs[SCHEDULER_PRIORITIES];
+	DWORD					rgdwMaxWaitMs[SCHEDULER_PRIORITIES];
+} SCHEDULER_WORKER;
+
+////////////////////////////////////////////////////////////////////////////////
+// Runs data layer tasks on a fixed set of worker threads, one per
+// processor by default. Each worker has a queue per priority. A task goes
+// to the worker of its affinity hint, to the queue of the submitting
+// worker when submitted from a task, or to the workers in turn. An idle
+// worker takes its own newest task and otherwise steals the oldest task of
+// another worker; interactive tasks are taken before background tasks
+// everywhere. A running task is not interrupted, so long background tasks
+// are split or check for cancellation.
+//
+// A worker checks a session out of the pool given to Start when it takes
+// a task and keeps it for the tasks that follow, which is what the affinity
+// hint is for: related tasks sent to one worker find its session and the
+// rowsets behind it warm. The session goes back to the pool when the
+// worker runs out of tasks.
+//
+class TaskScheduler
+{
+public:
+	TaskScheduler();
+	~TaskScheduler();
+
+	HRESULT Start(SessionPool *pSessionPool, DWORD cWorkers);
+	void	Stop();
+
+	HRESULT Submit(PFN_SCHEDULER_TASK	pfnTask,
+				   LPVOID				pvContext,
+				   DWORD				dwPriority,
+				   DWORD				iAffinity,
+				   SCHEDULER_TASK		**ppTask);
+	void	Cancel(SCHEDULER_TASK *pTask);
+	HRESULT Wait(SCHEDULER_TASK *pTask, DWORD dwTimeoutMs);
+	void	CloseTask(SCHEDULER_TASK *pTask);
+	HRESULT WaitIdle(DWORD dwTimeoutMs);
+
+	DWORD	GetWorkerCount();
+	void	GetStats(SCHEDULER_STATS *pStats);
+
+private:
+	static DWORD WINAPI WorkerThreadProc(LPVOID lpParameter);
+
+	SCHEDULER_TASK* TakeTask(SCHEDULER_WORKER *pWorker);
+	void	RunTask(SCHEDULER_WORKER *pWorker, SCHEDULER_TASK *pTask);
+	void	ReleaseTask(SCHEDULER_TASK *pTask);
+	DWORD	GetCurrentWorker();
+
+	static HRESULT PushTask(SCHEDULER_DEQUE *pDeque, SCHEDULER_TASK *pTask);
+	static SCHEDULER_TASK* PopNewest(SCHEDULER_DEQUE *pDeque);
+	static SCHEDULER_TASK* PopOldest(SCHEDULER_DEQUE *pDeque);
+
+	CRITICAL_SECTION		m_cs;					// Guards the pending count and the idle event
+	SessionPool				*m_pSessionPool;		// NULL if the tasks use no session
+	SCHEDULER_WORKER		m_rgWorker[SCHEDULER_MAX_WORKERS];
+	DWORD					m_cWorkers;
+	HANDLE					m_hWork;				// Counts the queued tasks
+	HANDLE					m_hIdle;				// Set when no task is queued or running
+	DWORD					m_cPending;				// Tasks queued or running
+	volatile LONG			m_iNextWorker;			// Next worker of tasks without affinity
+	volatile LONG			m_fStop;
+};
+
+extern TaskScheduler	g_TaskScheduler;
+
+#endif // !defined(AFX_TASKSCHEDULER_H__0B7D4E62_93A1_4F58_BC26_E85A1D3F7C09__INCLUDED_)
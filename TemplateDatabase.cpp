@@ -0,0 +1,440 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: TemplateDatabase
+//
+// File: TemplateDatabase.cpp
+//
+// Comment: Schema versioning and first-run cloning of a prebuilt database.
+//
+// Functions:
+//			1. Read, record and upgrade the schema version of a database
+//			2. Clone the template database on first run
+//			3. Build a template from a database created by the application
+//
+// Notes:
+//			On first run, copying the template replaces creating the schema
+//			and inserting every employee and photo. Creating the database
+//			stays the default: the template is used only when one was
+//			installed next to the executable. The copy is made under
+//			a temporary name and checked before it is renamed into place, so
+//			an interrupted clone never leaves a partial database behind.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "Employees.h"
+#include "dbcommon.h"
+#include "sqlce_sync.h"
+#include "DbHelpers.h"
+#include "ChangeLog.h"
+#include "RowVersion.h"
+#include "TemplateDatabase.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetSchemaVersion
+//
+// Description: Returns the schema version recorded in SchemaInfo.
+//
+// Parameters
+//		pIDBCreateSession	- the database
+//		plVersion			- receives the version, 1 without SchemaInfo
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT GetSchemaVersion(IDBCreateSession *pIDBCreateSession, LONG *plVersion)
+{
+	HRESULT		hr			= NOERROR;
+	IOpenRowset	*pISession	= NULL;			// Provider Interface Pointer
+	IRowset		*pIRowset	= NULL;			// Provider Interface Pointer
+	BOOL		fNull;
+
+	if (NULL == pIDBCreateSession || NULL == plVersion)
+	{
+		return E_INVALIDARG;
+	}
+
+	*plVersion = 1;
+
+	hr = pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pISession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = OpenTableRowset(pISession, TABLE_SCHEMA_INFO, NULL, 0, IID_IRowset, (IUnknown**)&pIRowset);
+	if (DB_E_NOTABLE == hr)
+	{
+		hr = NOERROR;
+		goto Exit;
+	}
+
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	pIRowset->Release();
+	pIRowset = NULL;
+
+	hr = ExecuteScalar(pISession, L"SELECT MAX(Version) FROM SchemaInfo", plVersion, &fNull);
+	if (SUCCEEDED(hr) && fNull)
+	{
+		*plVersion = 1;
+	}
+
+Exit:
+	if (pISession)
+	{
+		pISession->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: SetSchemaVersion
+//
+// Description: Record the schema version, creating SchemaInfo if needed.
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT SetSchemaVersion(IDBCreateSession *pIDBCreateSession, LONG lVersion)
+{
+	HRESULT				hr			= NOERROR;
+	IOpenRowset			*pISession	= NULL;			// Provider Interface Pointer
+	IRowset				*pIRowset	= NULL;			// Provider Interface Pointer
+	ITransactionLocal	*pITxnLocal	= NULL;			// Provider Interface Pointer
+	WCHAR				wszQuery[64];
+
+	if (NULL == pIDBCreateSession)
+	{
+		return E_INVALIDARG;
+	}
+
+	hr = pIDBCreateSession->CreateSession(NULL, IID_IOpenRowset, (IUnknown**)&pISession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = OpenTableRowset(pISession, TABLE_SCHEMA_INFO, NULL, 0, IID_IRowset, (IUnknown**)&pIRowset);
+	if (DB_E_NOTABLE == hr)
+	{
+		hr = ExecuteCommand(pISession, SQL_CREATE_SCHEMA_INFO_TABLE);
+	}
+
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	if (pIRowset)
+	{
+		pIRowset->Release();
+		pIRowset = NULL;
+	}
+
+	hr = pISession->QueryInterface(IID_ITransactionLocal, (void**)&pITxnLocal);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pITxnLocal->StartTransaction(ISOLATIONLEVEL_READCOMMITTED | ISOLATIONLEVEL_CURSORSTABILITY, 0, NULL, NULL);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = ExecuteCommand(pISession, L"DELETE FROM SchemaInfo");
+	if(FAILED(hr))
+	{
+		goto Abort;
+	}
+
+	wsprintf(wszQuery, L"INSERT INTO SchemaInfo (Version) VALUES (%d)", lVersion);
+
+	hr = ExecuteCommand(pISession, wszQuery);
+	if(FAILED(hr))
+	{
+		goto Abort;
+	}
+
+	hr = pITxnLocal->Commit(FALSE, XACTTC_SYNC, 0);
+	goto Exit;
+
+Abort:
+	pITxnLocal->Abort(NULL, FALSE, FALSE);
+
+Exit:
+	if (pITxnLocal)
+	{
+		pITxnLocal->Release();
+	}
+
+	if (pIRowset)
+	{
+		pIRowset->Release();
+	}
+
+	if (pISession)
+	{
+		pISession->Release();
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: UpgradeSchema
+//
+// Description: Bring an existing database to DATABASE_SCHEMA_VERSION.
+//
+// Returns: NOERROR if succesfull, E_FAIL for a database of a newer version
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT UpgradeSchema(IDBCreateSession *pIDBCreateSession)
+{
+	HRESULT	hr;
+	LONG	lVersion;
+
+	hr = GetSchemaVersion(pIDBCreateSession, &lVersion);
+	if(FAILED(hr))
+	{
+		return hr;
+	}
+
+	if (DATABASE_SCHEMA_VERSION == lVersion)
+	{
+		return NOERROR;
+	}
+
+	if (lVersion > DATABASE_SCHEMA_VERSION)
+	{
+		return E_FAIL;
+	}
+
+	// Version 2 adds the change log
+	//
+	if (lVersion < 2)
+	{
+		hr = EnsureChangeLogTable(pIDBCreateSession);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+	}
+
+	// Version 3 adds the row version
+	//
+	if (lVersion < 3)
+	{
+		hr = EnsureRowVersionColumn(pIDBCreateSession);
+		if(FAILED(hr))
+		{
+			return hr;
+		}
+	}
+
+	return SetSchemaVersion(pIDBCreateSession, DATABASE_SCHEMA_VERSION);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: GetTemplateDatabasePath
+//
+// Description: Returns the path of the template database, in the directory
+//				of the executable.
+//
+////////////////////////////////////////////////////////////////////////////////
+BOOL GetTemplateDatabasePath(WCHAR *pwszPath, DWORD cchPath)
+{
+	DWORD	cchModule;
+	WCHAR	*pwszName;
+
+	cchModule = GetModuleFileName(NULL, pwszPath, cchPath);
+	if (0 == cchModule || cchModule >= cchPath)
+	{
+		return FALSE;
+	}
+
+	pwszName = wcsrchr(pwszPath, WCHAR('\\'));
+	pwszName = pwszName ? pwszName + 1 : pwszPath;
+
+	if ((DWORD)(pwszName - pwszPath) + wcslen(DATABASE_TEMPLATE_NAME) >= cchPath)
+	{
+		return FALSE;
+	}
+
+	wcscpy(pwszName, DATABASE_TEMPLATE_NAME);
+
+	return TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: CloneTemplateDatabase
+//
+// Description: Put a copy of the template database at pwszDatabase.
+//
+// Parameters
+//		pwszDatabase	- path of the database to create, must not exist
+//
+// Returns: NOERROR if the database was cloned, S_FALSE if there is no
+//			template of the current schema version
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT CloneTemplateDatabase(LPCWSTR pwszDatabase)
+{
+	HRESULT				hr					= NOERROR;
+	IDBCreateSession	*pIDBCreateSession	= NULL;		// The copy
+	WCHAR				wszTemplate[MAX_PATH];
+	WCHAR				wszClone[MAX_PATH];
+	ULONGLONG			cbSize;
+	LONG				lVersion			= 0;
+
+	if (NULL == pwszDatabase || wcslen(pwszDatabase) + wcslen(DATABASE_CLONE_SUFFIX) >= MAX_PATH)
+	{
+		return E_INVALIDARG;
+	}
+
+	if (!GetTemplateDatabasePath(wszTemplate, MAX_PATH) || FAILED(GetDatabaseFileSize(wszTemplate, &cbSize)))
+	{
+		return S_FALSE;
+	}
+
+	wsprintf(wszClone, L"%s%s", pwszDatabase, DATABASE_CLONE_SUFFIX);
+
+	// Leftover of an interrupted clone
+	//
+	DeleteFile(wszClone);
+
+	if (!CopyFile(wszTemplate, wszClone, FALSE))
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto Exit;
+	}
+
+	// The copy must open and be of the schema this build expects
+	//
+	hr = OpenDataSource(wszClone, &pIDBCreateSession);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = GetSchemaVersion(pIDBCreateSession, &lVersion);
+
+	ReleaseDataSource(&pIDBCreateSession);
+
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	if (DATABASE_SCHEMA_VERSION != lVersion)
+	{
+		hr = S_FALSE;
+		goto Exit;
+	}
+
+	if (!MoveFile(wszClone, pwszDatabase))
+	{
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		goto Exit;
+	}
+
+Exit:
+	ReleaseDataSource(&pIDBCreateSession);
+
+	if (NOERROR != hr)
+	{
+		DeleteFile(wszClone);
+	}
+
+	return hr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Function: BuildTemplateDatabase
+//
+// Description: Write a compacted copy of a database as a template and
+//				verify it. The source must be closed.
+//
+// Parameters
+//		pwszDatabase	- database created by the application
+//		pwszTemplate	- template to write, replaced if it exists
+//
+// Returns: NOERROR if succesfull
+//
+////////////////////////////////////////////////////////////////////////////////
+HRESULT BuildTemplateDatabase(LPCWSTR pwszDatabase, LPCWSTR pwszTemplate)
+{
+	HRESULT		hr				= NOERROR;
+	ISSCEEngine	*pISSCEEngine	= NULL;			// Engine object
+	BSTR		bstrSource		= NULL;
+	BSTR		bstrTemplate	= NULL;
+	WCHAR		wszConnect[MAX_PATH + 32];
+
+	if (NULL == pwszDatabase || NULL == pwszTemplate ||
+		wcslen(pwszDatabase) >= MAX_PATH || wcslen(pwszTemplate) >= MAX_PATH)
+	{
+		return E_INVALIDARG;
+	}
+
+	wsprintf(wszConnect, L"Data Source=%s", pwszDatabase);
+	bstrSource = SysAllocString(wszConnect);
+
+	wsprintf(wszConnect, L"Data Source=%s", pwszTemplate);
+	bstrTemplate = SysAllocString(wszConnect);
+
+	if (NULL == bstrSource || NULL == bstrTemplate)
+	{
+		hr = E_OUTOFMEMORY;
+		goto Exit;
+	}
+
+	hr = CoCreateInstance(CLSID_Engine, NULL, CLSCTX_INPROC_SERVER, IID_ISSCEEngine, (void**)&pISSCEEngine);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	DeleteFile(pwszTemplate);
+
+	hr = pISSCEEngine->CompactDatabase(bstrSource, bstrTemplate);
+	if(FAILED(hr))
+	{
+		goto Exit;
+	}
+
+	hr = pISSCEEngine->Verify(bstrTemplate);
+	if (S_OK != hr)
+	{
+		hr = FAILED(hr) ? hr : E_FAIL;
+		DeleteFile(pwszTemplate);
+	}
+
+Exit:
+	if (pISSCEEngine)
+	{
+		pISSCEEngine->Release();
+	}
+
+	if (bstrSource)
+	{
+		SysFreeString(bstrSource);
+	}
+
+	if (bstrTemplate)
+	{
+		SysFreeString(bstrTemplate);
+	}
+
+	return hr;
+}
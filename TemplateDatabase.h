@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microsoft SQL Server Everywhere Sample Code
+//
+// Microsoft Confidential
+//
+// Copyright 1999 - 2002 Microsoft Corporation.  All Rights Reserved.
+//
+// Component: TemplateDatabase
+//
+// File: TemplateDatabase.h
+//
+// Comment: Schema versioning and first-run cloning of a prebuilt database.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(AFX_TEMPLATEDATABASE_H__E07B2C45_9F18_4A6D_B3C2_5D8A41F06E93__INCLUDED_)
+#define AFX_TEMPLATEDATABASE_H__E07B2C45_9F18_4A6D_B3C2_5D8A41F06E93__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+////////////////////////////////////////////////////////////////////////////////
+// Schema version
+//
+// 1 - Employees
+// 2 - EmployeeChanges change log
+// 3 - Employees.RowVersion
+//
+// Databases without the SchemaInfo table are version 1.
+//
+#define DATABASE_SCHEMA_VERSION			3
+
+#define TABLE_SCHEMA_INFO				L"SchemaInfo"
+#define SQL_CREATE_SCHEMA_INFO_TABLE	L"CREATE TABLE SchemaInfo (Version INT NOT NULL)"
+
+////////////////////////////////////////////////////////////////////////////////
+// Template database, optional, next to the executable. Built from a
+// database created by the application with the template batch command and
+// copied to the device by hand; the project does not deploy one. Without
+// it, the first run creates the database and inserts the sample data.
+//
+#define DATABASE_TEMPLATE_NAME			L"NorthwindTemplate.sdf"
+#define DATABASE_CLONE_SUFFIX			L".clone"		// Copy being checked
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns the schema version of a database
+//
+HRESULT GetSchemaVersion(IDBCreateSession *pIDBCreateSession, LONG *plVersion);
+
+////////////////////////////////////////////////////////////////////////////////
+// Record the schema version of a database
+//
+HRESULT SetSchemaVersion(IDBCreateSession *pIDBCreateSession, LONG lVersion);
+
+////////////////////////////////////////////////////////////////////////////////
+// Bring an existing database to DATABASE_SCHEMA_VERSION
+//
+HRESULT UpgradeSchema(IDBCreateSession *pIDBCreateSession);
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns the path of DATABASE_TEMPLATE_NAME in the directory of the
+// executable
+//
+BOOL GetTemplateDatabasePath(WCHAR *pwszPath, DWORD cchPath);
+
+////////////////////////////////////////////////////////////////////////////////
+// Put a copy of the template database at pwszDatabase. Returns S_FALSE,
+// leaving nothing behind, when there is no template of the current schema
+// version.
+//
+HRESULT CloneTemplateDatabase(LPCWSTR pwszDatabase);
+
+////////////////////////////////////////////////////////////////////////////////
+// Write a compacted, verified copy of a closed database as a template
+//
+HRESULT BuildTemplateDatabase(LPCWSTR pwszDatabase, LPCWSTR pwszTemplate);
+
+#endif // !defined(AFX_TEMPLATEDATABASE_H__E07B2C45_9F18_4A6D_B3C2_5D8A41F06E93__INCLUDED_)
@@ -30,6 +30,7 @@
 #include <sipapi.h>
 #include "Common.h"
 #include "Employees.h"
+#include "StartupLoader.h"
 
 // Global Variables:
 //
@@ -300,6 +301,43 @@ LRESULT CALLBACK EmployeesDlgProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lP
 			}
 			break;
 
+		case WM_STARTUP_NAMES:
+			{
+				BOOL fFirst = ((STARTUP_NAME_PAGE*)lParam)->fFirst;
+
+				AddStartupNames(hWnd, (STARTUP_NAME_PAGE*)lParam);
+
+				// Display the first employee as soon as the first names arrive
+				//
+				if (fFirst && g_pEmployees &&
+					CB_ERR != SendDlgItemMessage(hWnd, IDC_COMBO_NAME, CB_SETCURSEL, 0, 0))
+				{
+					HRESULT hr = NOERROR;
+					DWORD	dwEmployeeID;
+
+					dwEmployeeID = SendDlgItemMessage(hWnd, IDC_COMBO_NAME, CB_GETITEMDATA, 0, 0);
+					hr = g_pEmployees->LoadEmployeeInfo(dwEmployeeID);
+					if (FAILED(hr))
+					{
+						MessageBox(NULL, L"Error - Update employee info", L"Northwind Oledb sample", MB_OK);
+						break;
+					}
+					g_pEmployees->ShowEmployeePhoto();
+
+					g_StartupLoader.MarkStage(STARTUP_STAGE_FIRST_EMPLOYEE);
+				}
+			}
+			break;
+
+		case WM_STARTUP_DONE:
+			g_StartupLoader.ReportTimes();
+
+			if (FAILED((HRESULT)wParam) && E_ABORT != (HRESULT)wParam)
+			{
+				MessageBox(NULL, L"Error - Retrive employee name list", L"Northwind Oledb sample", MB_OK);
+			}
+			break;
+
 		case WM_COMMAND:
 			switch(LOWORD(wParam)) 
 			{
@@ -348,6 +386,18 @@ LRESULT CALLBACK EmployeesDlgProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lP
 							//
 							dwEmployeeID = SendDlgItemMessage(hWnd, IDC_COMBO_NAME, CB_GETITEMDATA, dwCurSel, 0);
 							hr = g_pEmployees->SaveEmployeeInfo(dwEmployeeID);
+							if (DB_E_CONCURRENCYVIOLATION == hr)
+							{
+								// Someone else saved the employee since it was displayed
+								//
+								MessageBox(NULL, L"Employee info was changed by another user, the current info is displayed", L"Northwind Oledb sample", MB_OK);
+								if (SUCCEEDED(g_pEmployees->LoadEmployeeInfo(dwEmployeeID)))
+								{
+									g_pEmployees->ShowEmployeePhoto();
+								}
+								break;
+							}
+
 							if (FAILED(hr))
 							{
 								MessageBox(NULL, L"Error - Save employee info", L"Northwind Oledb sample", MB_OK);